@@ -0,0 +1,481 @@
+/** @file
+ *
+ *  @ingroup bench_module
+ *
+ *  @brief Connection scale soak: opens many TCP connections through @c net_ip connectors
+ *  and acceptors, holds them with light traffic, churns them, and reports memory and CPU
+ *  per connection as JSON.
+ *
+ *  The phases are:
+ *  - Connect: connectors are started in batches (so the listen backlog is not overrun)
+ *    against one or more acceptors on loopback, one acceptor per 20,000 connections so
+ *    the ephemeral ports of a single destination are not exhausted. Connect latency is
+ *    measured from the connector @c start to its IO state change callback, accept latency
+ *    from the connector @c start to the acceptor IO state change callback for the same
+ *    connection.
+ *  - Hold: each client connection sends a small message once a second, echoed by the
+ *    acceptor side. The CPU time of each IO thread is measured over the phase.
+ *  - Churn: in each round a tenth of the connectors are stopped and removed, then
+ *    replaced. The memory growth over the rounds and the number of IO handlers reported
+ *    by the acceptors are checks on the acceptor and connector bookkeeping.
+ *  - Teardown: all entities are stopped and removed.
+ *
+ *  Resident memory is read from @c /proc, so the per connection number covers both ends
+ *  of a connection (a connector, two @c tcp_io objects and the kernel is not included),
+ *  and freed memory kept by the allocator shows up as growth. Each connection uses two
+ *  file descriptors, the descriptor limit is raised to the hard limit if needed.
+ *
+ *  Usage: @c conn_soak @c [num_conns @c [hold_secs @c [churn_rounds @c [output_file]]]],
+ *  defaults are 10,000 connections, 10 seconds and 5 rounds, results go to @c stdout if
+ *  no file is given.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include <experimental/internet>
+#include <experimental/socket>
+#include <experimental/io_context>
+#include <experimental/executor>
+
+#include <cstddef> // std::size_t
+#include <cstdlib> // std::atoi
+#include <memory> // std::make_shared, std::unique_ptr
+#include <algorithm> // std::sort, std::min
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <string_view>
+#include <system_error>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <ostream>
+
+#include <time.h> // clock_gettime
+#include <unistd.h> // sysconf
+#include <sys/resource.h> // getrlimit, setrlimit
+
+#include "net_ip/net_ip.hpp"
+#include "net_ip/net_entity.hpp"
+#include "net_ip/io_interface.hpp"
+#include "net_ip/net_ip_error.hpp"
+#include "net_ip/component/worker_pool.hpp"
+
+#include "net_ip/shared_utility_test.hpp"
+
+using namespace std::experimental::net;
+using namespace chops::test;
+
+using clock_type = std::chrono::steady_clock;
+
+const char*              soak_addr = "127.0.0.1";
+constexpr unsigned short soak_base_port = 30931;
+constexpr std::size_t    conns_per_acceptor = 20000u;
+constexpr std::size_t    connect_batch = 1000u;
+constexpr std::size_t    server_threads = 4u;
+constexpr std::size_t    client_threads = 2u;
+constexpr auto           batch_timeout = std::chrono::seconds(20);
+
+// process and thread measurements
+
+std::size_t rss_bytes() {
+  std::ifstream ifs("/proc/self/statm");
+  std::size_t total = 0u;
+  std::size_t resident = 0u;
+  ifs >> total >> resident;
+  return resident * static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+}
+
+// CPU seconds used by each thread of a pool, one context per thread
+std::vector<double> io_thread_cpu_secs(chops::net::worker_pool& wp) {
+  std::vector<std::future<double> > futs;
+  for (std::size_t i = 0u; i < wp.num_threads(); ++i) {
+    auto prom = std::make_shared<std::promise<double> >();
+    futs.push_back(prom->get_future());
+    post(wp.get_io_context(i), [prom] () {
+        ::timespec ts { };
+        ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        prom->set_value(static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) * 1.0e-9);
+      }
+    );
+  }
+  std::vector<double> secs;
+  for (auto& f : futs) {
+    secs.push_back(f.get());
+  }
+  return secs;
+}
+
+std::size_t raise_fd_limit(std::size_t wanted) {
+  ::rlimit lim { };
+  if (::getrlimit(RLIMIT_NOFILE, &lim) != 0) {
+    return 0u;
+  }
+  if (lim.rlim_cur < wanted) {
+    lim.rlim_cur = (lim.rlim_max == RLIM_INFINITY || lim.rlim_max >= wanted) ? wanted : lim.rlim_max;
+    ::setrlimit(RLIMIT_NOFILE, &lim);
+    ::getrlimit(RLIMIT_NOFILE, &lim);
+  }
+  return static_cast<std::size_t>(lim.rlim_cur);
+}
+
+// connection state, the IO state change callbacks write a slot before bumping a counter,
+// the main thread reads it after waiting on the counter
+
+struct soak_counters {
+  std::atomic_size_t  cli_ready { 0u };
+  std::atomic_size_t  cli_closed { 0u };
+  std::atomic_size_t  srv_ready { 0u };
+  std::atomic_size_t  srv_closed { 0u };
+  std::atomic_size_t  connect_errors { 0u };
+  test_counter        cli_msgs { 0u };
+  test_counter        srv_msgs { 0u };
+};
+
+struct conn_slot {
+  std::size_t                           acc_idx = 0u;
+  clock_type::time_point                start;
+  clock_type::time_point                ready;
+  unsigned short                        local_port = 0u;
+  chops::net::tcp_connector_net_entity  ent;
+  chops::net::tcp_io_interface          io;
+};
+
+// accept times indexed by acceptor and client port, written by the acceptor callbacks
+struct accept_times {
+  std::vector<std::vector<clock_type::time_point> > times;
+  std::vector<std::atomic_size_t>                   handlers;
+
+  explicit accept_times(std::size_t num_acc) :
+    times(num_acc, std::vector<clock_type::time_point>(65536u)), handlers(num_acc) { }
+
+  std::size_t total_handlers() const {
+    std::size_t tot = 0u;
+    for (const auto& h : handlers) {
+      tot += h.load();
+    }
+    return tot;
+  }
+};
+
+bool wait_until(const std::atomic_size_t& cnt, std::size_t target) {
+  auto deadline = clock_type::now() + batch_timeout;
+  while (cnt.load() < target) {
+    if (clock_type::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+void start_conn(conn_slot& s, chops::net::net_ip& nip, const ip::tcp::endpoint& endp,
+                soak_counters& cnts) {
+  s.ent = nip.make_tcp_connector(endp);
+  s.start = clock_type::now();
+  s.ent.start(
+    [&s, &cnts] (chops::net::tcp_io_interface io, std::size_t, bool starting) {
+      if (!starting) {
+        ++cnts.cli_closed;
+        return;
+      }
+      s.ready = clock_type::now();
+      s.local_port = io.get_socket().local_endpoint().port();
+      s.io = io;
+      tcp_start_io(io, false, std::string_view(), cnts.cli_msgs);
+      ++cnts.cli_ready;
+    },
+    [&cnts] (chops::net::tcp_io_interface io, std::error_code err) {
+      if (!io.is_valid() && err != chops::net::net_ip_errc::tcp_connector_stopped) {
+        ++cnts.connect_errors;
+      }
+    }
+  );
+}
+
+void start_acceptor(chops::net::tcp_acceptor_net_entity& acc, std::size_t idx,
+                    accept_times& acc_times, soak_counters& cnts) {
+  acc.start(
+    [idx, &acc_times, &cnts] (chops::net::tcp_io_interface io, std::size_t num, bool starting) {
+      acc_times.handlers[idx] = num;
+      if (!starting) {
+        ++cnts.srv_closed;
+        return;
+      }
+      acc_times.times[idx][io.get_socket().remote_endpoint().port()] = clock_type::now();
+      tcp_start_io(io, true, std::string_view(), cnts.srv_msgs);
+      ++cnts.srv_ready;
+    },
+    [] (chops::net::tcp_io_interface, std::error_code) { }
+  );
+}
+
+double usec(clock_type::duration d) {
+  return std::chrono::duration<double, std::micro>(d).count();
+}
+
+// start the connectors of slots [beg, end) in batches, collecting latencies, false if
+// a batch did not complete in time
+bool connect_slots(std::vector<conn_slot>& slots, std::size_t beg, std::size_t end,
+                   std::vector<std::unique_ptr<chops::net::net_ip> >& cli_nips,
+                   const std::vector<ip::tcp::endpoint>& acc_endps, soak_counters& cnts,
+                   const accept_times& acc_times, std::vector<double>& conn_lat,
+                   std::vector<double>& acc_lat) {
+  bool ok = true;
+  for (std::size_t b = beg; b < end; b += connect_batch) {
+    std::size_t e = std::min(b + connect_batch, end);
+    std::size_t cli_target = cnts.cli_ready.load() + (e - b);
+    std::size_t srv_target = cnts.srv_ready.load() + (e - b);
+    for (std::size_t i = b; i < e; ++i) {
+      slots[i].acc_idx = i % acc_endps.size();
+      start_conn(slots[i], *cli_nips[i % cli_nips.size()], acc_endps[slots[i].acc_idx], cnts);
+    }
+    ok = wait_until(cnts.cli_ready, cli_target) && wait_until(cnts.srv_ready, srv_target) && ok;
+    for (std::size_t i = b; i < e; ++i) {
+      const auto& s = slots[i];
+      if (s.local_port == 0u) {
+        continue;
+      }
+      conn_lat.push_back(usec(s.ready - s.start));
+      auto acc_tp = acc_times.times[s.acc_idx][s.local_port];
+      if (acc_tp >= s.start) {
+        acc_lat.push_back(usec(acc_tp - s.start));
+      }
+    }
+  }
+  return ok;
+}
+
+void stop_slots(std::vector<conn_slot>& slots, std::size_t beg, std::size_t end,
+                std::vector<std::unique_ptr<chops::net::net_ip> >& cli_nips) {
+  for (std::size_t i = beg; i < end; ++i) {
+    auto& s = slots[i];
+    s.ent.stop();
+    cli_nips[i % cli_nips.size()]->remove(s.ent);
+    s.local_port = 0u;
+    s.io = chops::net::tcp_io_interface();
+  }
+}
+
+// JSON output
+
+double percentile(const std::vector<double>& sorted, double p) {
+  if (sorted.empty()) {
+    return 0.0;
+  }
+  auto idx = static_cast<std::size_t>(p * static_cast<double>(sorted.size()));
+  return sorted[std::min(idx, sorted.size() - 1u)];
+}
+
+void write_latency(std::ostream& os, std::vector<double>& lat) {
+  std::sort(lat.begin(), lat.end());
+  os << "{ \"p50\": " << percentile(lat, 0.5) << ", \"p99\": " << percentile(lat, 0.99) <<
+        ", \"p999\": " << percentile(lat, 0.999) << ", \"max\": " <<
+        (lat.empty() ? 0.0 : lat.back()) << " }";
+}
+
+void write_cpu(std::ostream& os, const std::vector<double>& beg, const std::vector<double>& end,
+               double secs) {
+  os << "[";
+  for (std::size_t i = 0u; i < beg.size(); ++i) {
+    os << (100.0 * (end[i] - beg[i]) / secs) << (i + 1u < beg.size() ? ", " : "");
+  }
+  os << "]";
+}
+
+double sum_diff(const std::vector<double>& beg, const std::vector<double>& end) {
+  double tot = 0.0;
+  for (std::size_t i = 0u; i < beg.size(); ++i) {
+    tot += end[i] - beg[i];
+  }
+  return tot;
+}
+
+int main(int argc, char* argv[]) {
+
+  std::size_t num_conns = argc > 1 ? static_cast<std::size_t>(std::atoi(argv[1])) : 10000u;
+  int hold_secs = argc > 2 ? std::atoi(argv[2]) : 10;
+  int churn_rounds = argc > 3 ? std::atoi(argv[3]) : 5;
+
+  std::size_t fd_limit = raise_fd_limit(2u * num_conns + 256u);
+  if (fd_limit < 2u * num_conns + 256u) {
+    num_conns = fd_limit > 512u ? (fd_limit - 256u) / 2u : 128u;
+    std::cerr << "descriptor limit " << fd_limit << ", connections reduced to " <<
+                 num_conns << std::endl;
+  }
+  std::size_t num_acc = (num_conns + conns_per_acceptor - 1u) / conns_per_acceptor;
+
+  chops::net::worker_pool srv_wp(server_threads);
+  chops::net::worker_pool cli_wp(client_threads);
+  srv_wp.start();
+  cli_wp.start();
+
+  soak_counters cnts;
+  accept_times acc_times(num_acc);
+  std::vector<conn_slot> slots(num_conns);
+  std::vector<double> conn_lat;
+  std::vector<double> acc_lat;
+  conn_lat.reserve(num_conns);
+  acc_lat.reserve(num_conns);
+
+  // accepted connections are spread over the server contexts, connectors over one
+  // net_ip per client context
+  chops::net::net_ip srv_nip(srv_wp.get_io_context(0), srv_wp.make_io_context_selector());
+  std::vector<std::unique_ptr<chops::net::net_ip> > cli_nips;
+  for (std::size_t i = 0u; i < cli_wp.num_threads(); ++i) {
+    cli_nips.push_back(std::make_unique<chops::net::net_ip>(cli_wp.get_io_context(i)));
+  }
+  std::vector<ip::tcp::endpoint> acc_endps;
+  std::vector<chops::net::tcp_acceptor_net_entity> accs;
+  for (std::size_t i = 0u; i < num_acc; ++i) {
+    acc_endps.emplace_back(ip::make_address(soak_addr),
+                           static_cast<unsigned short>(soak_base_port + i));
+    accs.push_back(srv_nip.make_tcp_acceptor(acc_endps.back()));
+    start_acceptor(accs.back(), i, acc_times, cnts);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(100)); // let the acceptors listen
+
+  std::size_t rss_base = rss_bytes();
+
+  // connect phase
+  auto conn_start = clock_type::now();
+  bool conn_ok = connect_slots(slots, 0u, num_conns, cli_nips, acc_endps, cnts, acc_times,
+                               conn_lat, acc_lat);
+  double conn_secs = std::chrono::duration<double>(clock_type::now() - conn_start).count();
+  std::size_t num_connected = cnts.cli_ready.load();
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  std::size_t rss_conn = rss_bytes();
+  std::cerr << "connected " << num_connected << " of " << num_conns << " in " <<
+               conn_secs << " seconds" << std::endl;
+
+  // hold phase, each connection sends once a second, spread over 100 ticks
+  auto cpu_srv_beg = io_thread_cpu_secs(srv_wp);
+  auto cpu_cli_beg = io_thread_cpu_secs(cli_wp);
+  std::size_t echoed_beg = cnts.cli_msgs.load();
+  auto hold_start = clock_type::now();
+  auto tick_time = hold_start;
+  std::size_t num_sends = 0u;
+  auto hb_msg = make_variable_len_msg(make_body_buf("hb", 'a', 30u));
+  for (int t = 0; t < hold_secs * 100; ++t) {
+    std::size_t beg = (static_cast<std::size_t>(t % 100) * num_conns) / 100u;
+    std::size_t end = (static_cast<std::size_t>(t % 100 + 1) * num_conns) / 100u;
+    for (std::size_t i = beg; i < end; ++i) {
+      try {
+        slots[i].io.send(hb_msg);
+        ++num_sends;
+      }
+      catch (const chops::net::net_ip_exception&) { } // not connected
+    }
+    tick_time += std::chrono::milliseconds(10);
+    std::this_thread::sleep_until(tick_time);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(200)); // last echoes
+  double hold_elapsed = std::chrono::duration<double>(clock_type::now() - hold_start).count();
+  auto cpu_srv_end = io_thread_cpu_secs(srv_wp);
+  auto cpu_cli_end = io_thread_cpu_secs(cli_wp);
+  std::size_t num_echoed = cnts.cli_msgs.load() - echoed_beg;
+  std::size_t rss_hold = rss_bytes();
+  std::cerr << "hold done, " << num_echoed << " echoes" << std::endl;
+
+  // churn phase
+  std::size_t per_round = std::max<std::size_t>(num_conns / 10u, 1u);
+  std::vector<double> churn_conn_lat;
+  std::vector<double> churn_acc_lat;
+  bool churn_ok = true;
+  auto churn_start = clock_type::now();
+  for (int r = 0; r < churn_rounds; ++r) {
+    std::size_t beg = (static_cast<std::size_t>(r) * per_round) % num_conns;
+    std::size_t end = std::min(beg + per_round, num_conns);
+    std::size_t closed_target = cnts.srv_closed.load() + (end - beg);
+    stop_slots(slots, beg, end, cli_nips);
+    churn_ok = wait_until(cnts.srv_closed, closed_target) && churn_ok;
+    churn_ok = connect_slots(slots, beg, end, cli_nips, acc_endps, cnts, acc_times,
+                             churn_conn_lat, churn_acc_lat) && churn_ok;
+  }
+  double churn_secs = std::chrono::duration<double>(clock_type::now() - churn_start).count();
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  std::size_t rss_churn = rss_bytes();
+  std::size_t churn_handlers = acc_times.total_handlers();
+  std::cerr << "churn done, " << churn_handlers << " acceptor IO handlers" << std::endl;
+
+  // teardown
+  auto down_start = clock_type::now();
+  for (auto& n : cli_nips) {
+    n->stop_all();
+  }
+  bool down_ok = wait_until(cnts.srv_closed, cnts.srv_ready.load());
+  double down_secs = std::chrono::duration<double>(clock_type::now() - down_start).count();
+  std::size_t down_handlers = acc_times.total_handlers();
+  for (auto& n : cli_nips) {
+    n->remove_all();
+  }
+  srv_nip.stop_all();
+  srv_nip.remove_all();
+  for (auto& s : slots) {
+    s.io = chops::net::tcp_io_interface();
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  std::size_t rss_down = rss_bytes();
+
+  cli_wp.reset();
+  srv_wp.reset();
+
+  std::ofstream ofs;
+  if (argc > 4) {
+    ofs.open(argv[4]);
+  }
+  std::ostream& os = (argc > 4) ? static_cast<std::ostream&>(ofs) : std::cout;
+  double conns = static_cast<double>(num_connected > 0u ? num_connected : 1u);
+  double hold_secs_d = hold_elapsed > 0.0 ? hold_elapsed : 1.0e-9;
+  os << "{\n  \"soak\": {\n" <<
+        "    \"connections\": " << num_conns << ", \"connected\": " << num_connected <<
+        ", \"acceptors\": " << num_acc << ", \"server_threads\": " << srv_wp.num_threads() <<
+        ", \"client_threads\": " << cli_wp.num_threads() <<
+        ", \"sizeof_tcp_io\": " << sizeof(chops::net::detail::tcp_io) << ",\n" <<
+        "    \"connect\": { \"seconds\": " << conn_secs <<
+        ", \"connects_per_sec\": " << static_cast<double>(num_connected) / (conn_secs > 0.0 ? conn_secs : 1.0e-9) <<
+        ", \"complete\": " << (conn_ok ? "true" : "false") <<
+        ", \"connect_errors\": " << cnts.connect_errors.load() <<
+        ",\n      \"connect_latency_usec\": ";
+  write_latency(os, conn_lat);
+  os << ",\n      \"accept_latency_usec\": ";
+  write_latency(os, acc_lat);
+  os << " },\n" <<
+        "    \"memory\": { \"rss_baseline_bytes\": " << rss_base <<
+        ", \"rss_connected_bytes\": " << rss_conn <<
+        ", \"rss_bytes_per_conn\": " << (static_cast<double>(rss_conn) - static_cast<double>(rss_base)) / conns <<
+        ", \"rss_after_hold_bytes\": " << rss_hold <<
+        ", \"rss_after_churn_bytes\": " << rss_churn <<
+        ", \"rss_churn_growth_bytes\": " << (static_cast<double>(rss_churn) - static_cast<double>(rss_hold)) <<
+        ", \"rss_after_teardown_bytes\": " << rss_down << " },\n" <<
+        "    \"hold\": { \"seconds\": " << hold_elapsed << ", \"msgs_sent\": " << num_sends <<
+        ", \"msgs_echoed\": " << num_echoed <<
+        ",\n      \"server_io_cpu_pct\": ";
+  write_cpu(os, cpu_srv_beg, cpu_srv_end, hold_secs_d);
+  os << ", \"client_io_cpu_pct\": ";
+  write_cpu(os, cpu_cli_beg, cpu_cli_end, hold_secs_d);
+  os << ",\n      \"server_cpu_usec_per_conn_sec\": " <<
+        1.0e6 * sum_diff(cpu_srv_beg, cpu_srv_end) / hold_secs_d / conns << " },\n" <<
+        "    \"churn\": { \"rounds\": " << churn_rounds << ", \"conns_per_round\": " << per_round <<
+        ", \"seconds\": " << churn_secs << ", \"complete\": " << (churn_ok ? "true" : "false") <<
+        ", \"acceptor_io_handlers\": " << churn_handlers <<
+        ", \"expected_io_handlers\": " << num_connected <<
+        ",\n      \"connect_latency_usec\": ";
+  write_latency(os, churn_conn_lat);
+  os << ",\n      \"accept_latency_usec\": ";
+  write_latency(os, churn_acc_lat);
+  os << " },\n" <<
+        "    \"teardown\": { \"seconds\": " << down_secs <<
+        ", \"complete\": " << (down_ok ? "true" : "false") <<
+        ", \"acceptor_io_handlers\": " << down_handlers << " }\n" <<
+        "  }\n}\n";
+  return 0;
+}
+
@@ -0,0 +1,412 @@
+/** @file
+ *
+ *  @ingroup bench_module
+ *
+ *  @brief Throughput and latency benchmarks for TCP and UDP, written as JSON so results
+ *  can be tracked per release.
+ *
+ *  The benchmarks are:
+ *  - TCP echo, variable length (header) framing and LF delimiter framing: each connection
+ *    keeps a window of messages outstanding, the acceptor side echoes with the test
+ *    @c msg_hdlr, and the round trip latency is measured.
+ *  - UDP blast: datagrams are sent as fast as possible to a receiver, the received rate,
+ *    loss, and one-way latency are measured.
+ *  - @c send_to_all fan-out: messages are sent from the acceptor side to all connections,
+ *    the delivery rate and the latency to each connection are measured.
+ *
+ *  Each message body starts with the send time (16 hex characters of the steady clock),
+ *  so latency is measured within the process. Message sizes are body sizes.
+ *
+ *  Usage: @c net_ip_bench @c [output_file], results go to @c stdout if no file is given.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include <experimental/internet>
+#include <experimental/socket>
+#include <experimental/buffer>
+#include <experimental/io_context>
+
+#include <cstddef> // std::size_t, std::byte
+#include <cstdint> // std::uint64_t
+#include <cstdio> // std::snprintf
+#include <memory> // std::make_shared, std::unique_ptr
+#include <algorithm> // std::sort, std::min
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <ostream>
+
+#include "net_ip/detail/tcp_io.hpp"
+#include "net_ip/detail/udp_entity_io.hpp"
+#include "net_ip/component/worker_pool.hpp"
+#include "net_ip/component/send_to_all.hpp"
+#include "net_ip/io_interface.hpp"
+
+#include "utility/shared_buffer.hpp"
+#include "utility/repeat.hpp"
+
+#include "net_ip/shared_utility_test.hpp"
+
+using namespace std::experimental::net;
+using namespace chops::test;
+
+using clock_type = std::chrono::steady_clock;
+
+const char*              bench_addr = "127.0.0.1";
+constexpr unsigned short tcp_bench_port = 30901;
+constexpr unsigned short udp_bench_port = 30911;
+constexpr std::size_t    time_chars = 16u;
+constexpr std::size_t    echo_window = 16u;
+
+enum class framing { header, delimiter, datagram };
+
+const char* framing_name(framing fr) {
+  switch (fr) {
+    case framing::header: return "variable_len";
+    case framing::delimiter: return "lf_delimiter";
+    default: return "datagram";
+  }
+}
+
+struct bench_result {
+  std::string         name;
+  framing             fr;
+  std::size_t         msg_size;
+  int                 num_conns;
+  std::size_t         msgs_sent;
+  std::size_t         msgs_received;
+  std::size_t         wire_size;
+  double              secs;
+  std::vector<double> latencies; // usec
+};
+
+// message building and latency decoding
+
+std::string encode_time(clock_type::time_point tp) {
+  char buf[time_chars + 1];
+  std::snprintf(buf, sizeof(buf), "%016llx",
+      static_cast<unsigned long long>(tp.time_since_epoch().count()));
+  return std::string(buf, time_chars);
+}
+
+double latency_usec(const std::byte* body, clock_type::time_point now) {
+  std::uint64_t ticks = 0u;
+  for (std::size_t i = 0u; i < time_chars; ++i) {
+    char c = static_cast<char>(body[i]);
+    ticks = (ticks << 4) | static_cast<std::uint64_t>(c <= '9' ? c - '0' : c - 'a' + 10);
+  }
+  clock_type::time_point sent { clock_type::duration(ticks) };
+  return std::chrono::duration<double, std::micro>(now - sent).count();
+}
+
+chops::const_shared_buffer make_msg(framing fr, std::size_t msg_size) {
+  auto body = make_body_buf(encode_time(clock_type::now()), 'a',
+                            msg_size > time_chars ? msg_size - time_chars : 0u);
+  switch (fr) {
+    case framing::header: return make_variable_len_msg(body);
+    case framing::delimiter: return make_lf_text_msg(body);
+    default: return chops::const_shared_buffer(std::move(body));
+  }
+}
+
+// offset of the body within a message given to a message handler
+std::size_t body_offset(framing fr) { return fr == framing::header ? 2u : 0u; }
+
+bool start_client_io(chops::net::tcp_io_interface io, framing fr,
+                     std::function<bool (const_buffer, chops::net::tcp_io_ref)> hdlr) {
+  auto mh = [hdlr] (const_buffer buf, chops::net::tcp_io_ref io, ip::tcp::endpoint) {
+    return hdlr(buf, io);
+  };
+  if (fr == framing::header) {
+    return io.start_io(2, mh, chops::net::make_simple_variable_len_msg_frame(decode_variable_len_msg_hdr));
+  }
+  return io.start_io(std::string_view("\n"), mh);
+}
+
+// connected pairs of tcp_io objects, clients on one io_context and the acceptor side on another
+
+struct tcp_conns {
+  std::vector<chops::net::detail::tcp_io_ptr> clients;
+  std::vector<chops::net::detail::tcp_io_ptr> servers;
+
+  tcp_conns(chops::net::worker_pool& wp, int num_conns) {
+    ip::tcp::endpoint endp(ip::make_address(bench_addr), tcp_bench_port);
+    ip::tcp::acceptor acc(wp.get_io_context(0), endp, true);
+    auto notifier = [] (std::error_code, chops::net::detail::tcp_io_ptr p) { p->close(); };
+    chops::repeat(num_conns, [&] () {
+        ip::tcp::socket sock(wp.get_io_context(1));
+        sock.connect(endp);
+        sock.set_option(ip::tcp::no_delay(true));
+        clients.push_back(std::make_shared<chops::net::detail::tcp_io>(std::move(sock), notifier));
+        auto srv_sock = acc.accept();
+        srv_sock.set_option(ip::tcp::no_delay(true));
+        servers.push_back(std::make_shared<chops::net::detail::tcp_io>(std::move(srv_sock), notifier));
+      }
+    );
+  }
+
+  ~tcp_conns() {
+    for (auto& p : clients) {
+      p->close();
+    }
+    for (auto& p : servers) {
+      p->close();
+    }
+  }
+};
+
+// per connection client state, only accessed within the connection handlers
+
+struct client_state {
+  std::size_t          to_send;
+  std::size_t          sent = 0u;
+  std::size_t          received = 0u;
+  std::vector<double>  latencies;
+};
+
+bench_result tcp_echo_bench(chops::net::worker_pool& wp, framing fr, std::size_t msg_size,
+                            int num_conns, std::size_t total_msgs) {
+
+  tcp_conns conns(wp, num_conns);
+  std::size_t per_conn = total_msgs / num_conns;
+  std::atomic_int conns_done = 0;
+  std::promise<void> done_prom;
+  auto done_fut = done_prom.get_future();
+
+  test_counter srv_cnt = 0;
+  for (auto& p : conns.servers) {
+    tcp_start_io(chops::net::tcp_io_interface(p), true,
+                 fr == framing::delimiter ? std::string_view("\n") : std::string_view(), srv_cnt);
+  }
+
+  std::vector<std::unique_ptr<client_state> > states;
+  auto start = clock_type::now();
+  for (auto& p : conns.clients) {
+    states.push_back(std::make_unique<client_state>());
+    auto st = states.back().get();
+    st->to_send = per_conn;
+    st->latencies.reserve(per_conn);
+    start_client_io(chops::net::tcp_io_interface(p), fr,
+      [st, fr, msg_size, num_conns, &conns_done, &done_prom] (const_buffer buf, chops::net::tcp_io_ref io) {
+        st->latencies.push_back(latency_usec(static_cast<const std::byte*>(buf.data()) + body_offset(fr),
+                                             clock_type::now()));
+        if (st->sent < st->to_send) {
+          io.send(make_msg(fr, msg_size));
+          ++st->sent;
+        }
+        if (++st->received == st->to_send && ++conns_done == num_conns) {
+          done_prom.set_value();
+        }
+        return true;
+      }
+    );
+    chops::net::tcp_io_interface io(p);
+    for (std::size_t i = 0u; i < std::min(echo_window, per_conn); ++i) {
+      io.send(make_msg(fr, msg_size));
+      ++st->sent;
+    }
+  }
+  done_fut.get();
+  double secs = std::chrono::duration<double>(clock_type::now() - start).count();
+
+  bench_result res { "tcp_echo", fr, msg_size, num_conns, per_conn * num_conns, 0u,
+                     make_msg(fr, msg_size).size(), secs, { } };
+  for (auto& st : states) {
+    res.msgs_received += st->received;
+    res.latencies.insert(res.latencies.end(), st->latencies.cbegin(), st->latencies.cend());
+  }
+  return res;
+}
+
+bench_result send_to_all_bench(chops::net::worker_pool& wp, std::size_t msg_size,
+                               int num_conns, std::size_t num_msgs) {
+
+  constexpr framing fr = framing::header;
+  tcp_conns conns(wp, num_conns);
+  std::atomic_int conns_done = 0;
+  std::promise<void> done_prom;
+  auto done_fut = done_prom.get_future();
+
+  chops::net::send_to_all<chops::net::tcp_io> sta { };
+  for (auto& p : conns.servers) {
+    chops::net::tcp_io_interface io(p);
+    io.start_io();
+    sta.add_io_interface(io);
+  }
+  std::vector<std::unique_ptr<client_state> > states;
+  for (auto& p : conns.clients) {
+    states.push_back(std::make_unique<client_state>());
+    auto st = states.back().get();
+    st->to_send = num_msgs;
+    st->latencies.reserve(num_msgs);
+    start_client_io(chops::net::tcp_io_interface(p), fr,
+      [st, num_conns, &conns_done, &done_prom] (const_buffer buf, chops::net::tcp_io_ref) {
+        st->latencies.push_back(latency_usec(static_cast<const std::byte*>(buf.data()) + body_offset(fr),
+                                             clock_type::now()));
+        if (++st->received == st->to_send && ++conns_done == num_conns) {
+          done_prom.set_value();
+        }
+        return true;
+      }
+    );
+  }
+  auto start = clock_type::now();
+  chops::repeat(static_cast<int>(num_msgs), [&sta, msg_size] () { sta.send(make_msg(fr, msg_size)); } );
+  done_fut.get();
+  double secs = std::chrono::duration<double>(clock_type::now() - start).count();
+
+  bench_result res { "send_to_all", fr, msg_size, num_conns, num_msgs * num_conns, 0u,
+                     make_msg(fr, msg_size).size(), secs, { } };
+  for (auto& st : states) {
+    res.msgs_received += st->received;
+    res.latencies.insert(res.latencies.end(), st->latencies.cbegin(), st->latencies.cend());
+  }
+  return res;
+}
+
+bench_result udp_blast_bench(chops::net::worker_pool& wp, std::size_t msg_size, std::size_t num_msgs) {
+
+  ip::udp::endpoint recv_endp(ip::make_address(bench_addr), udp_bench_port);
+  auto recv_ptr = std::make_shared<chops::net::detail::udp_entity_io>(wp.get_io_context(0), recv_endp);
+  auto send_ptr = std::make_shared<chops::net::detail::udp_entity_io>(wp.get_io_context(1),
+                                                                      ip::udp::endpoint());
+  // only accessed within the receiver handler, on the receiver io_context thread, then
+  // published to this thread through the drained promise after the receiver is stopped
+  std::vector<double> latencies;
+  latencies.reserve(num_msgs);
+  std::atomic_size_t received = 0u;
+  clock_type::time_point last_recv = clock_type::now();
+
+  recv_ptr->start(
+    [&] (chops::net::udp_io_interface io, std::size_t, bool starting) {
+      if (starting) {
+        io.get_socket().set_option(socket_base::receive_buffer_size(8 * 1024 * 1024));
+        io.start_io(udp_max_buf_size, [&] (const_buffer buf, chops::net::udp_io_ref, ip::udp::endpoint) {
+            last_recv = clock_type::now();
+            latencies.push_back(latency_usec(static_cast<const std::byte*>(buf.data()), last_recv));
+            ++received;
+            return true;
+          }
+        );
+      }
+    },
+    [] (chops::net::udp_io_interface, std::error_code) { }
+  );
+  send_ptr->start(
+    [&recv_endp] (chops::net::udp_io_interface io, std::size_t, bool starting) {
+      if (starting) {
+        io.start_io(recv_endp);
+      }
+    },
+    [] (chops::net::udp_io_interface, std::error_code) { }
+  );
+
+  chops::net::udp_io_interface send_io(send_ptr);
+  auto start = clock_type::now();
+  chops::repeat(static_cast<int>(num_msgs), [&send_io, msg_size] () {
+      send_io.send(make_msg(framing::datagram, msg_size));
+    }
+  );
+  // wait for all datagrams, or until nothing has arrived for a while (loss)
+  std::size_t prev = 0u;
+  do {
+    prev = received;
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  } while (received < num_msgs && received != prev);
+
+  recv_ptr->stop();
+  send_ptr->stop();
+  std::this_thread::sleep_for(std::chrono::milliseconds(50)); // let the handlers drain
+  // the receiver io_context is run by one thread, so this runs after the last handler
+  std::promise<void> drained;
+  post(wp.get_io_context(0), [&drained] { drained.set_value(); } );
+  drained.get_future().get();
+
+  double secs = std::chrono::duration<double>(last_recv - start).count();
+  return bench_result { "udp_blast", framing::datagram, msg_size, 1, num_msgs, received,
+                        make_msg(framing::datagram, msg_size).size(), secs, std::move(latencies) };
+}
+
+// JSON output
+
+double percentile(const std::vector<double>& sorted, double p) {
+  if (sorted.empty()) {
+    return 0.0;
+  }
+  auto idx = static_cast<std::size_t>(p * static_cast<double>(sorted.size()));
+  return sorted[std::min(idx, sorted.size() - 1u)];
+}
+
+void write_json(std::ostream& os, std::vector<bench_result>& results) {
+  os << "{\n  \"benchmarks\": [\n";
+  for (std::size_t i = 0u; i < results.size(); ++i) {
+    auto& r = results[i];
+    std::sort(r.latencies.begin(), r.latencies.end());
+    double secs = r.secs > 0.0 ? r.secs : 1.0e-9;
+    os << "    { \"name\": \"" << r.name << "\", \"framing\": \"" << framing_name(r.fr) <<
+          "\", \"msg_size\": " << r.msg_size << ", \"connections\": " << r.num_conns <<
+          ", \"msgs_sent\": " << r.msgs_sent << ", \"msgs_received\": " << r.msgs_received <<
+          ", \"seconds\": " << r.secs <<
+          ", \"msgs_per_sec\": " << static_cast<double>(r.msgs_received) / secs <<
+          ", \"bytes_per_sec\": " << static_cast<double>(r.msgs_received * r.wire_size) / secs <<
+          ", \"latency_usec\": { \"p50\": " << percentile(r.latencies, 0.5) <<
+          ", \"p99\": " << percentile(r.latencies, 0.99) <<
+          ", \"p999\": " << percentile(r.latencies, 0.999) << " } }" <<
+          (i + 1u < results.size() ? ",\n" : "\n");
+  }
+  os << "  ]\n}\n";
+}
+
+int main(int argc, char* argv[]) {
+
+  chops::net::worker_pool wp(2);
+  wp.start();
+
+  std::vector<bench_result> results;
+
+  for (auto fr : { framing::header, framing::delimiter }) {
+    for (std::size_t sz : { 32u, 512u, 4096u }) {
+      for (int conns : { 1, 8 }) {
+        results.push_back(tcp_echo_bench(wp, fr, sz, conns, 40000u));
+        std::cerr << "tcp_echo " << framing_name(fr) << ", size " << sz <<
+                     ", connections " << conns << " done" << std::endl;
+      }
+    }
+  }
+  for (std::size_t sz : { 32u, 512u, 1400u }) {
+    results.push_back(udp_blast_bench(wp, sz, 50000u));
+    std::cerr << "udp_blast, size " << sz << " done" << std::endl;
+  }
+  for (std::size_t sz : { 32u, 512u }) {
+    for (int conns : { 8, 64 }) {
+      results.push_back(send_to_all_bench(wp, sz, conns, 2000u));
+      std::cerr << "send_to_all, size " << sz << ", connections " << conns << " done" << std::endl;
+    }
+  }
+
+  wp.reset();
+
+  if (argc > 1) {
+    std::ofstream ofs(argv[1]);
+    write_json(ofs, results);
+  }
+  else {
+    write_json(std::cout, results);
+  }
+  return 0;
+}
+
@@ -0,0 +1,128 @@
+/** @file
+ *
+ *  @ingroup bench_module
+ *
+ *  @brief Benchmark of the @c tcp_io read loop, measuring message delivery rate for 
+ *  header framed (two reads per message), read-ahead and delimiter framed input.
+ *
+ *  A client writes all of the messages as one large buffer over loopback, so the 
+ *  time measured is dominated by the read completion handlers and message framing.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0. 
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include <experimental/internet>
+#include <experimental/socket>
+#include <experimental/buffer>
+#include <experimental/io_context>
+
+#include <cstddef> // std::size_t
+#include <memory> // std::make_shared
+#include <future>
+#include <chrono>
+#include <iostream>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "net_ip/detail/tcp_io.hpp"
+#include "net_ip/component/worker.hpp"
+#include "net_ip/component/simple_variable_len_msg_frame.hpp"
+#include "net_ip/io_interface.hpp"
+
+#include "utility/repeat.hpp"
+
+#include "net_ip/shared_utility_test.hpp"
+
+using namespace std::experimental::net;
+using namespace chops::test;
+
+constexpr int num_msgs = 500000;
+constexpr unsigned short bench_port = 30999;
+
+enum class framing { header, read_ahead, delimiter };
+
+std::vector<std::byte> make_stream(framing fr, std::size_t body_size) {
+  auto body = make_body_buf("", 'a', body_size);
+  auto msg = (fr == framing::delimiter) ? make_lf_text_msg(body) : make_variable_len_msg(body);
+  std::vector<std::byte> stream;
+  chops::repeat(num_msgs, [&stream, &msg] () {
+      stream.insert(stream.end(), msg.data(), msg.data() + msg.size());
+    }
+  );
+  return stream;
+}
+
+double run_bench(io_context& ioc, framing fr, std::size_t body_size) {
+
+  auto stream = make_stream(fr, body_size);
+  ip::tcp::endpoint endp(ip::make_address("127.0.0.1"), bench_port);
+  ip::tcp::acceptor acc(ioc, endp, true);
+
+  auto writer = std::async(std::launch::async, [&ioc, &endp, &stream] {
+      ip::tcp::socket sock(ioc);
+      sock.connect(endp);
+      write(sock, buffer(stream.data(), stream.size()));
+      char c;
+      std::error_code ec;
+      sock.read_some(buffer(&c, 1), ec); // wait for the reading side to close
+    }
+  );
+
+  std::promise<void> done_prom;
+  auto done_fut = done_prom.get_future();
+  std::size_t cnt = 0u;
+  auto iohp = std::make_shared<chops::net::detail::tcp_io>(acc.accept(), 
+                       [] (std::error_code, chops::net::detail::tcp_io_ptr p) { p->close(); } );
+
+  auto start = std::chrono::steady_clock::now();
+  auto mh = [&cnt, &done_prom] (const_buffer, chops::net::tcp_io_interface, ip::tcp::endpoint) {
+    if (++cnt == static_cast<std::size_t>(num_msgs)) {
+      done_prom.set_value();
+    }
+    return true;
+  };
+  chops::net::tcp_io_interface io(iohp);
+  switch (fr) {
+    case framing::header:
+      io.start_io(2, mh, chops::net::make_simple_variable_len_msg_frame(decode_variable_len_msg_hdr));
+      break;
+    case framing::read_ahead:
+      io.start_io(2, 16384, mh, 
+                  chops::net::make_simple_variable_len_msg_frame(decode_variable_len_msg_hdr));
+      break;
+    case framing::delimiter:
+      io.start_io(std::string_view("\n"), mh);
+      break;
+  }
+  done_fut.get();
+  auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  io.stop_io();
+  writer.get();
+  return num_msgs / elapsed;
+}
+
+int main() {
+
+  chops::net::worker wk;
+  wk.start();
+
+  const char* names[] = { "header", "read_ahead", "delimiter" };
+  for (auto fr : { framing::header, framing::read_ahead, framing::delimiter }) {
+    for (std::size_t body_size : { 16u, 256u }) {
+      auto rate = run_bench(wk.get_io_context(), fr, body_size);
+      std::cout << names[static_cast<int>(fr)] << ", body size " << body_size << 
+                   ": " << static_cast<long>(rate) << " msgs/sec" << std::endl;
+    }
+  }
+
+  wk.reset();
+  return 0;
+}
+
@@ -22,18 +22,17 @@
 #include <cassert>
 #include <limits>
 
-#include <boost/endian/conversion.hpp>
+#include "net_ip/component/length_field_msg_frame.hpp"
 
 namespace chops {
 namespace example {
 
+// 2 byte big endian body length, use with make_length_field_msg_frame<var_len_hdr>()
+using var_len_hdr = chops::net::length_field<0, 2>;
+
 inline std::size_t decode_variable_len_msg_hdr(const std::byte* buf_ptr, std::size_t sz) {
   assert (sz == 2);
-  std::uint16_t hdr;
-  std::byte* hdr_ptr = static_cast<std::byte*>(static_cast<void*>(&hdr));
-  *(hdr_ptr+0) = *(buf_ptr+0);
-  *(hdr_ptr+1) = *(buf_ptr+1);
-  return boost::endian::big_to_native(hdr);
+  return static_cast<std::size_t>(chops::net::decode_uint<2>(buf_ptr));
 }
 
 template <typename IOT>
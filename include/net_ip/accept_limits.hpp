@@ -0,0 +1,65 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Structures for TCP acceptor connection limits and accept statistics.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef ACCEPT_LIMITS_HPP_INCLUDED
+#define ACCEPT_LIMITS_HPP_INCLUDED
+
+#include <cstddef> // std::size_t
+
+namespace chops {
+namespace net {
+
+/**
+ *  @brief @c accept_limits bound the rate at which a TCP acceptor creates connections
+ *  (see @c net_ip @c make_tcp_acceptor).
+ *
+ *  A limit of 0 means no limit. When a limit is reached the acceptor stops accepting,
+ *  and pending connections wait in the listen backlog of the kernel (where further
+ *  connection attempts are refused or dropped once the backlog is full). Accepting
+ *  resumes when a connection closes (for @c max_connections) or when the rate allows
+ *  (for @c max_accepts_per_sec, which allows a burst of up to one second's worth of
+ *  accepts).
+ *
+ *  After each accept completion up to @c max_batch - 1 further pending connections are
+ *  accepted without waiting, which reduces the number of wakeups during connection bursts.
+ *
+ *  For a sharded acceptor each listener has an outstanding accept, so the connection
+ *  count may exceed @c max_connections by up to the number of listeners minus one.
+ */
+struct accept_limits {
+  std::size_t max_connections = 0;
+  std::size_t max_accepts_per_sec = 0;
+  std::size_t max_batch = 16;
+};
+
+/**
+ *  @brief @c accept_stats provides counts of the connections accepted by a TCP acceptor.
+ *
+ *  @c num_batched is the number of connections accepted without waiting (see
+ *  @c accept_limits @c max_batch), and is included in @c num_accepted. @c num_deferred
+ *  is the number of times accepting was paused because of a limit.
+ */
+struct accept_stats {
+  std::size_t num_accepted = 0;
+  std::size_t num_batched = 0;
+  std::size_t num_deferred = 0;
+  bool        paused = false;
+};
+
+} // end net namespace
+} // end chops namespace
+
+#endif
+
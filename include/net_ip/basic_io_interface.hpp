@@ -21,11 +21,20 @@
 #include <system_error>
 #include <cstddef> // std::size_t, std::byte
 #include <utility> // std::forward, std::move
+#include <chrono>
 
 #include "utility/shared_buffer.hpp"
 
 #include "net_ip/net_ip_error.hpp"
 #include "net_ip/queue_stats.hpp"
+#include "net_ip/io_handler_id.hpp"
+#include "net_ip/output_queue_limits.hpp"
+#include "net_ip/idle_timeouts.hpp"
+#include "net_ip/read_buffer_policy.hpp"
+#include "net_ip/send_priority.hpp"
+#include "net_ip/file_segment.hpp"
+#include "net_ip/pooled_buffer.hpp"
+#include "net_ip/receive_timestamp.hpp"
 
 namespace chops {
 namespace net {
@@ -145,9 +154,28 @@ public:
     throw net_ip_exception(std::make_error_code(net_ip_errc::weak_ptr_expired));
   }
 
+/**
+ *  @brief Return the identifier of the associated IO handler within its net entity.
+ *
+ *  The identifier is assigned to each connection of a TCP acceptor (see 
+ *  @c io_handler_id) and is stable for the lifetime of the connection. It is not valid
+ *  (@c is_valid returns @c false) for TCP connector and UDP IO handlers.
+ *
+ *  @return @c io_handler_id if network IO handler is available.
+ *
+ *  @throw A @c net_ip_exception is thrown if there is not an associated IO handler.
+ */
+  io_handler_id get_handler_id() const {
+    if (auto p = m_ioh_wptr.lock()) {
+      return p->get_handler_id();
+    }
+    throw net_ip_exception(std::make_error_code(net_ip_errc::weak_ptr_expired));
+  }
+
 /**
  *  @brief Return output queue statistics, allowing application monitoring of output queue
- *  sizes.
+ *  sizes, as well as send and receive totals, queue high-water marks, and a queue latency
+ *  histogram for capacity planning (see @c output_queue_stats).
  *
  *  @return @c queue_status if network IO handler is available.
  *
@@ -160,6 +188,26 @@ public:
     throw net_ip_exception(std::make_error_code(net_ip_errc::weak_ptr_expired));
   }
 
+/**
+ *  @brief Return the statistics of one output queue lane.
+ *
+ *  The queue sizes, sent totals and latency histogram are those of the buffers sent with
+ *  the priority. Received totals and the queued while busy and dropped counts are only
+ *  kept for the whole output queue, and are zero.
+ *
+ *  @param pri Priority class of the lane.
+ *
+ *  @return @c queue_status of the lane if network IO handler is available.
+ *
+ *  @throw A @c net_ip_exception is thrown if there is not an associated IO handler.
+ */
+  output_queue_stats get_output_queue_stats(send_priority pri) const {
+    if (auto p = m_ioh_wptr.lock()) {
+      return p->get_output_queue_stats(pri);
+    }
+    throw net_ip_exception(std::make_error_code(net_ip_errc::weak_ptr_expired));
+  }
+
 /**
  *  @brief Send a buffer of data through the associated network IO handler.
  *
@@ -185,7 +233,7 @@ public:
  */
   void send(chops::const_shared_buffer buf) const {
     if (auto p = m_ioh_wptr.lock()) {
-      p->send(buf);
+      p->send(std::move(buf));
       return;
     }
     throw net_ip_exception(std::make_error_code(net_ip_errc::weak_ptr_expired));
@@ -215,6 +263,106 @@ public:
     send(chops::const_shared_buffer(std::move(buf)));
   }
 
+/**
+ *  @brief Send a reference counted buffer through an output queue lane of the associated
+ *  network IO handler.
+ *
+ *  Each send priority has its own lane in the output queue, so a @c high priority buffer
+ *  (e.g. a heartbeat or an acknowledgement) is not queued behind a @c bulk backlog (see
+ *  @c set_send_lane_policy for how the lanes are drained). Buffers of the same priority
+ *  are sent in order. The output queue limits apply to all lanes together, and the 
+ *  overflow policies discard buffers from the lowest priority lane first.
+ *
+ *  This is a non-blocking call.
+ *
+ *  @param buf @c chops::const_shared_buffer containing data.
+ *
+ *  @param pri Priority class of the buffer.
+ *
+ *  @throw A @c net_ip_exception is thrown if there is not an associated IO handler.
+ */
+  void send(chops::const_shared_buffer buf, send_priority pri) const {
+    if (auto p = m_ioh_wptr.lock()) {
+      p->send(std::move(buf), pri);
+      return;
+    }
+    throw net_ip_exception(std::make_error_code(net_ip_errc::weak_ptr_expired));
+  }
+
+/**
+ *  @brief Send a segment of a file through the associated network IO handler, implemented
+ *  only for TCP IO handlers.
+ *
+ *  The segment is queued in order with the other buffers and the file contents are 
+ *  transmitted by the kernel (@c sendfile on Linux), without reading the file into a 
+ *  buffer. The file is kept open until the segment has been sent. If the file cannot 
+ *  be read (e.g. it has been truncated), the IO handler is shut down and the error is
+ *  reported through the error callback.
+ *
+ *  This is a non-blocking call.
+ *
+ *  @param seg @c file_segment, created with @c make_file_segment.
+ *
+ *  @param pri Priority class of the segment.
+ *
+ *  @throw A @c net_ip_exception is thrown if there is not an associated IO handler.
+ */
+  void send(file_segment seg, send_priority pri = send_priority::normal) const {
+    if (auto p = m_ioh_wptr.lock()) {
+      p->send(std::move(seg), pri);
+      return;
+    }
+    throw net_ip_exception(std::make_error_code(net_ip_errc::weak_ptr_expired));
+  }
+
+/**
+ *  @brief Send a memory mapped file region through the associated network IO handler,
+ *  implemented only for TCP IO handlers.
+ *
+ *  The region is queued like a reference counted buffer, without copying it, and the 
+ *  mapping is kept until the region has been sent. The same region can be sent through
+ *  many IO handlers.
+ *
+ *  This is a non-blocking call.
+ *
+ *  @param reg @c mapped_region, created with @c make_mapped_region.
+ *
+ *  @param pri Priority class of the region.
+ *
+ *  @throw A @c net_ip_exception is thrown if there is not an associated IO handler.
+ */
+  void send(mapped_region reg, send_priority pri = send_priority::normal) const {
+    if (auto p = m_ioh_wptr.lock()) {
+      p->send(std::move(reg), pri);
+      return;
+    }
+    throw net_ip_exception(std::make_error_code(net_ip_errc::weak_ptr_expired));
+  }
+
+/**
+ *  @brief Send a pooled buffer through the associated network IO handler, implemented
+ *  only for TCP IO handlers.
+ *
+ *  The buffer is queued like a reference counted buffer, without copying it, and its
+ *  storage goes back to the @c buffer_pool when the last reference (including the one
+ *  in the output queue) drops. The same buffer can be sent through many IO handlers.
+ *
+ *  This is a non-blocking call.
+ *
+ *  @param buf @c pooled_buffer, created with @c buffer_pool @c make_pooled_buffer.
+ *
+ *  @param pri Priority class of the buffer.
+ *
+ *  @throw A @c net_ip_exception is thrown if there is not an associated IO handler.
+ */
+  void send(pooled_buffer buf, send_priority pri = send_priority::normal) const {
+    if (auto p = m_ioh_wptr.lock()) {
+      p->send(std::move(buf), pri);
+      return;
+    }
+    throw net_ip_exception(std::make_error_code(net_ip_errc::weak_ptr_expired));
+  }
+
 /**
  *  @brief Send a buffer to a specific destination endpoint (address and port), implemented
  *  only for UDP IO handlers.
@@ -250,7 +398,30 @@ public:
  */
   void send(chops::const_shared_buffer buf, const endpoint_type& endp) const {
     if (auto p = m_ioh_wptr.lock()) {
-      p->send(buf, endp);
+      p->send(std::move(buf), endp);
+      return;
+    }
+    throw net_ip_exception(std::make_error_code(net_ip_errc::weak_ptr_expired));
+  }
+
+/**
+ *  @brief Send a reference counted buffer to a specific destination endpoint through an
+ *  output queue lane, implemented only for UDP IO handlers.
+ *
+ *  See documentation for @c send with a @c send_priority. This is a non-blocking call.
+ *
+ *  @param buf @c chops::const_shared_buffer containing data.
+ *
+ *  @param endp Destination @c std::experimental::net::ip::udp::endpoint for the buffer.
+ *
+ *  @param pri Priority class of the buffer.
+ *
+ *  @throw A @c net_ip_exception is thrown if there is not an associated IO handler.
+ */
+  void send(chops::const_shared_buffer buf, const endpoint_type& endp, 
+            send_priority pri) const {
+    if (auto p = m_ioh_wptr.lock()) {
+      p->send(std::move(buf), endp, pri);
       return;
     }
     throw net_ip_exception(std::make_error_code(net_ip_errc::weak_ptr_expired));
@@ -274,6 +445,356 @@ public:
   }
 
 
+/**
+ *  @brief Bound the output queue of the associated network IO handler, with an overflow
+ *  policy and optional watermark notifications.
+ *
+ *  By default there is no limit on the output queue, so a slow receiver (e.g. one TCP 
+ *  connection of many in a @c send_to_all broadcast) can make its queue grow without 
+ *  bound. With limits set, a @c send call that would exceed the buffer count or byte
+ *  limit applies the @c overflow_policy (see @c output_queue_limits). Buffers discarded 
+ *  by the policy are counted in the @c output_queue_stats @c num_dropped field.
+ *
+ *  The queue event function object is called (within the IO handler's strand, not from 
+ *  the @c send caller) with a @c net_ip_errc::output_queue_high_watermark or 
+ *  @c net_ip_errc::output_queue_low_watermark error code when a watermark is crossed.
+ *  A disconnect overflow shuts down the IO handler and reports 
+ *  @c net_ip_errc::output_queue_overflow through the net entity error function object.
+ *
+ *  This is a non-blocking call, and the limits are used for the next @c send.
+ *
+ *  @param lim Output queue limits and overflow policy.
+ *
+ *  @param queue_event_func A function object with the following signature:
+ *  @code
+ *    void (chops::net::basic_io_interface<IOT>, std::error_code);
+ *  @endcode
+ *  The function object must be copyable (it will be stored in a @c std::function).
+ *
+ *  @throw A @c net_ip_exception is thrown if there is not an associated IO handler.
+ */
+  template <typename F>
+  void set_output_queue_limits(const output_queue_limits& lim, F&& queue_event_func) const {
+    if (auto p = m_ioh_wptr.lock()) {
+      p->set_output_queue_limits(lim, std::forward<F>(queue_event_func));
+      return;
+    }
+    throw net_ip_exception(std::make_error_code(net_ip_errc::weak_ptr_expired));
+  }
+
+/**
+ *  @brief Bound the output queue of the associated network IO handler, without 
+ *  watermark notifications.
+ *
+ *  @param lim Output queue limits and overflow policy.
+ *
+ *  @throw A @c net_ip_exception is thrown if there is not an associated IO handler.
+ */
+  void set_output_queue_limits(const output_queue_limits& lim) const {
+    set_output_queue_limits(lim, [] (basic_io_interface<IOT>, std::error_code) { } );
+  }
+
+/**
+ *  @brief Set how the output queue lanes of the associated network IO handler are 
+ *  drained.
+ *
+ *  The default is strict priority. Weighted round robin bounds the starvation of lower
+ *  priority lanes (see @c send_lane_policy). This is a non-blocking call, and the policy
+ *  is used for the next buffer taken from the output queue.
+ *
+ *  @param pol Lane scheduling and weights.
+ *
+ *  @throw A @c net_ip_exception is thrown if there is not an associated IO handler.
+ */
+  void set_send_lane_policy(const send_lane_policy& pol) const {
+    if (auto p = m_ioh_wptr.lock()) {
+      p->set_send_lane_policy(pol);
+      return;
+    }
+    throw net_ip_exception(std::make_error_code(net_ip_errc::weak_ptr_expired));
+  }
+
+/**
+ *  @brief Set read and write idle timeouts, and a heartbeat, for the associated network
+ *  IO handler.
+ *
+ *  Dead peers are detected without an application timer per connection; the timeouts of
+ *  all IO handlers of an @c io_context share one timer wheel, and each read or send is a
+ *  constant time (lock-free) reset. Expirations are reported through the net entity error
+ *  function object with a @c net_ip_errc::read_idle_timeout or 
+ *  @c net_ip_errc::write_idle_timeout error code (see @c idle_timeouts for details,
+ *  including which errors shut down the IO handler).
+ *
+ *  This is a non-blocking call, the timeouts start when the call is processed by the IO
+ *  handler. Calling it again restarts the timeouts, and a timeout of 0 disables it.
+ *
+ *  @param to Read and write idle timeouts, and an optional heartbeat buffer.
+ *
+ *  @throw A @c net_ip_exception is thrown if there is not an associated IO handler.
+ */
+  void set_idle_timeouts(const idle_timeouts& to) const {
+    if (auto p = m_ioh_wptr.lock()) {
+      p->set_idle_timeouts(to);
+      return;
+    }
+    throw net_ip_exception(std::make_error_code(net_ip_errc::weak_ptr_expired));
+  }
+
+/**
+ *  @brief Bound the read buffer memory of the associated network IO handler.
+ *
+ *  By default a TCP read buffer keeps the capacity of the largest message received and a
+ *  UDP read buffer is always the max datagram size, so many mostly idle IO handlers hold
+ *  worst case memory. With a shrink size, read buffers only grow above it while a large
+ *  message is received, optionally borrowing the large buffers from a shared pool (see
+ *  @c read_buffer_policy and @c make_pooled_read_buffer_policy). The read buffer 
+ *  capacity is reported in the @c output_queue_stats @c read_buffer_bytes field.
+ *
+ *  This is a non-blocking call, the policy is used from the next message on.
+ *
+ *  @param pol Read buffer policy.
+ *
+ *  @throw A @c net_ip_exception is thrown if there is not an associated IO handler.
+ */
+  void set_read_buffer_policy(const read_buffer_policy& pol) const {
+    if (auto p = m_ioh_wptr.lock()) {
+      p->set_read_buffer_policy(pol);
+      return;
+    }
+    throw net_ip_exception(std::make_error_code(net_ip_errc::weak_ptr_expired));
+  }
+
+/**
+ *  @brief Coalesce small sends of the associated TCP IO handler, bounded by a byte count
+ *  and a latency.
+ *
+ *  Many small sends each become a separate write (and typically a separate TCP segment).
+ *  With coalescing enabled, a send that follows an idle period (no write in progress) is
+ *  held until @c flush_bytes are queued or @c max_delay expires, and the held buffers are
+ *  written with a single write. Sends made while a write is in progress are written as
+ *  soon as the write completes, so a buffer is never held longer than @c max_delay past
+ *  an idle period.
+ *
+ *  This is a non-blocking call, and only applies to TCP IO handlers. A @c flush_bytes of
+ *  0 disables coalescing and writes any held buffers.
+ *
+ *  @param flush_bytes Number of queued bytes that triggers a write.
+ *
+ *  @param max_delay Maximum time a buffer is held.
+ *
+ *  @throw A @c net_ip_exception is thrown if there is not an associated IO handler.
+ */
+  void set_send_coalescing(std::size_t flush_bytes, std::chrono::microseconds max_delay) const {
+    if (auto p = m_ioh_wptr.lock()) {
+      p->set_send_coalescing(flush_bytes, max_delay);
+      return;
+    }
+    throw net_ip_exception(std::make_error_code(net_ip_errc::weak_ptr_expired));
+  }
+
+/**
+ *  @brief Query whether the output queue is congested, meaning above the high watermark
+ *  (and not yet back to the low watermark) or at its limit.
+ *
+ *  @return @c true if congested, always @c false if no limits are set.
+ *
+ *  @throw A @c net_ip_exception is thrown if there is not an associated IO handler.
+ */
+  bool is_output_congested() const {
+    if (auto p = m_ioh_wptr.lock()) {
+      return p->is_output_congested();
+    }
+    throw net_ip_exception(std::make_error_code(net_ip_errc::weak_ptr_expired));
+  }
+
+/**
+ *  @brief Enable or disable write batching of queued buffers.
+ *
+ *  By default each outgoing buffer is written with a separate write operation. When 
+ *  batching is enabled and buffers have queued up while a write is in progress, up to
+ *  @c max_bufs queued buffers (limited to @c max_bytes total) are written together. 
+ *  For TCP IO handlers this is one scatter / gather write operation. For UDP IO handlers
+ *  each buffer is still a separate datagram, but the datagrams are sent with one 
+ *  @c sendmmsg system call; this is only implemented on Linux and the limits are 
+ *  ignored on other platforms. Batching reduces system calls for applications that 
+ *  send many small messages. The @c output_queue_stats write batch counts can be used 
+ *  to tune the limits.
+ *
+ *  This is a non-blocking call, and the new limits are used for the next write.
+ *
+ *  @param max_bufs Maximum number of buffers in one write; 0 or 1 disables batching.
+ *
+ *  @param max_bytes Maximum number of bytes in one write, although the first buffer of 
+ *  a batch is always written regardless of size; 0 means no byte limit.
+ *
+ *  @throw A @c net_ip_exception is thrown if there is not an associated IO handler.
+ */
+  void set_write_batch_limits(std::size_t max_bufs, std::size_t max_bytes) const {
+    if (auto p = m_ioh_wptr.lock()) {
+      p->set_write_batch_limits(max_bufs, max_bytes);
+      return;
+    }
+    throw net_ip_exception(std::make_error_code(net_ip_errc::weak_ptr_expired));
+  }
+
+/**
+ *  @brief Enable or disable zero copy sends of large buffers, implemented only for TCP
+ *  IO handlers on Linux (the value is ignored on other platforms).
+ *
+ *  When enabled, a write of at least @c min_bytes (for a write batch, the total of the
+ *  batch) is sent with @c MSG_ZEROCOPY, so the kernel transmits directly from the
+ *  @c const_shared_buffer instead of copying it. The buffer is kept alive until the
+ *  kernel reports (through the socket error queue) that the transmit is complete, so
+ *  buffers are released later than with normal writes. Smaller writes use the normal
+ *  path, since the page pinning and notification overhead only pays off for large
+ *  buffers (the kernel documentation suggests around 10 KB). If the kernel runs out of
+ *  notification memory the rest of the write falls back to a normal write. Loopback
+ *  and some other devices always copy, in which case there is no benefit.
+ *
+ *  This is a non-blocking call, and the threshold is used for the next write. If the
+ *  @c SO_ZEROCOPY socket option cannot be set the threshold is ignored. It is also
+ *  ignored for a TLS connection, since kernel TLS does not accept @c MSG_ZEROCOPY 
+ *  sends (see @c tls_context).
+ *
+ *  @param min_bytes Minimum write size for a zero copy send; 0 disables zero copy sends.
+ *
+ *  @throw A @c net_ip_exception is thrown if there is not an associated IO handler.
+ */
+  void set_zero_copy_threshold(std::size_t min_bytes) const {
+    if (auto p = m_ioh_wptr.lock()) {
+      p->set_zero_copy_threshold(min_bytes);
+      return;
+    }
+    throw net_ip_exception(std::make_error_code(net_ip_errc::weak_ptr_expired));
+  }
+
+/**
+ *  @brief Enable or disable batched reads of incoming datagrams, implemented only for 
+ *  UDP IO handlers on Linux (the value is ignored on other platforms).
+ *
+ *  By default each incoming datagram is read with a separate read operation. When 
+ *  batching is enabled, all datagrams available when the socket becomes readable (up to
+ *  @c max_msgs) are read with one @c recvmmsg system call, and the message handler is
+ *  called for each of them, in the order received.
+ *
+ *  A read buffer of the @c start_io max size is allocated for each datagram of a batch,
+ *  so memory use grows with the batch size.
+ *
+ *  This is a non-blocking call, and the new size is used for the next read.
+ *
+ *  @param max_msgs Maximum number of datagrams in one read; 0 or 1 disables batching.
+ *
+ *  @throw A @c net_ip_exception is thrown if there is not an associated IO handler.
+ */
+  void set_read_batch_size(std::size_t max_msgs) const {
+    if (auto p = m_ioh_wptr.lock()) {
+      p->set_read_batch_size(max_msgs);
+      return;
+    }
+    throw net_ip_exception(std::make_error_code(net_ip_errc::weak_ptr_expired));
+  }
+
+/**
+ *  @brief Enable or disable @c io_uring reads of incoming datagrams, implemented only for
+ *  UDP IO handlers on Linux 6.0 or later (the value is ignored elsewhere).
+ *
+ *  A multishot receive is submitted once to an @c io_uring, and the kernel places each
+ *  incoming datagram directly in one of @c num_bufs registered buffers, so no read system
+ *  call is made per datagram (or per batch). The message handler is called for each 
+ *  datagram, in the order received, and the buffer is given back to the kernel when the
+ *  message handler returns; a message handler taking a shared buffer gets a copy.
+ *
+ *  When the datagrams arrive faster than the message handler processes them, they stay in
+ *  the socket receive buffer until a registered buffer is free. If the ring cannot be 
+ *  set up, the error is reported through the error callback and the normal read path
+ *  is used. Multicast entities always use the normal read path.
+ *
+ *  This is a non-blocking call, and the value is used by the next @c start_io.
+ *
+ *  @param num_bufs Number of registered read buffers (rounded up to a power of 2), each
+ *  of the @c start_io max size; 0 disables @c io_uring reads.
+ *
+ *  @throw A @c net_ip_exception is thrown if there is not an associated IO handler.
+ */
+  void set_io_uring_read(std::size_t num_bufs) const {
+    if (auto p = m_ioh_wptr.lock()) {
+      p->set_io_uring_read(num_bufs);
+      return;
+    }
+    throw net_ip_exception(std::make_error_code(net_ip_errc::weak_ptr_expired));
+  }
+
+/**
+ *  @brief Enable or disable UDP segmentation offload, implemented only for UDP IO 
+ *  handlers on Linux (the values are ignored elsewhere).
+ *
+ *  With send offload, consecutive datagrams of a write (batch) with the same destination
+ *  and the same size (the last one may be shorter) are passed to the kernel as one 
+ *  buffer with the @c UDP_SEGMENT size, up to @c max_segments datagrams and 64 KB, and
+ *  are split into datagrams by the kernel or the network device. One system call then
+ *  carries many datagrams, in addition to the @c sendmmsg batching. Queued datagrams
+ *  are taken as a batch for this even if write batching is disabled. The datagram size
+ *  must fit in the path MTU. If the kernel or device does not support send offload, 
+ *  the error is reported through the error callback, send offload is disabled and the
+ *  datagrams are sent separately.
+ *
+ *  With receive offload (@c UDP_GRO), the kernel can deliver several datagrams of the 
+ *  same flow in one read, with the segment size; they are split before the message 
+ *  handler is called, so the message handler still sees one datagram per call (a 
+ *  message handler taking a shared buffer gets a copy of each datagram of a coalesced
+ *  read). Reads use @c recvmmsg with a 64 KB buffer for each datagram of a read batch.
+ *
+ *  This is a non-blocking call. Receive offload should be set before @c start_io, since
+ *  a read already started uses the previous setting.
+ *
+ *  @param max_segments Maximum number of datagrams in one send offload buffer (at most
+ *  64); 0 or 1 disables send offload.
+ *
+ *  @param receive_offload If @c true, receive offload is enabled.
+ *
+ *  @throw A @c net_ip_exception is thrown if there is not an associated IO handler.
+ */
+  void set_segmentation_offload(std::size_t max_segments, bool receive_offload) const {
+    if (auto p = m_ioh_wptr.lock()) {
+      p->set_segmentation_offload(max_segments, receive_offload);
+      return;
+    }
+    throw net_ip_exception(std::make_error_code(net_ip_errc::weak_ptr_expired));
+  }
+
+/**
+ *  @brief Enable or disable kernel and network device receive timestamps 
+ *  (@c SO_TIMESTAMPING), implemented only on Linux (the value is ignored elsewhere).
+ *
+ *  The timestamps are passed to message handlers taking a @c receive_timestamp as the
+ *  fourth parameter (see @c receive_timestamp for the clocks), so the time a message
+ *  spent in the socket receive queue and the IO handler can be told apart from the time
+ *  on the wire. Other message handlers are not affected, other than by the read path.
+ *
+ *  UDP IO handlers read with @c recvmmsg (io_uring reads are not used), and each 
+ *  datagram has its own timestamps. TCP IO handlers wait for the socket to be readable
+ *  and then read with @c recvmsg; the timestamps are of the most recent segment of the
+ *  read that completed the message, since a message can span segments (and a segment
+ *  can hold several messages). For a UDP IO handler an error setting the socket option
+ *  is reported through the error callback, for a TCP IO handler the setting is then
+ *  ignored.
+ *
+ *  This is a non-blocking call. It should be called before @c start_io, since a read 
+ *  already started uses the previous setting.
+ *
+ *  @param enable If @c true, receive timestamps are enabled.
+ *
+ *  @throw A @c net_ip_exception is thrown if there is not an associated IO handler.
+ */
+  void set_receive_timestamps(bool enable) const {
+    if (auto p = m_ioh_wptr.lock()) {
+      p->set_receive_timestamps(enable);
+      return;
+    }
+    throw net_ip_exception(std::make_error_code(net_ip_errc::weak_ptr_expired));
+  }
+
+
 /**
  *  @brief Enable IO processing for the associated network IO handler with message 
  *  frame logic.
@@ -307,6 +828,31 @@ public:
  *  @c basic_io_interface can be used for sending a reply. The endpoint is the remote 
  *  endpoint that sent the data (not used in the @c send method call, but may be
  *  useful for other purposes). 
+ *
+ *  Alternatively the message handler can take a @c chops::const_shared_buffer
+ *  as the first parameter:
+ *
+ *  @code
+ *    bool (chops::const_shared_buffer,
+ *          chops::net::tcp_io_interface, // basic_io_interface<tcp_io>
+ *          std::experimental::net::ip::tcp::endpoint);
+ *  @endcode
+ *
+ *  In this case the ownership of the message bytes is passed to the message handler
+ *  (the IO handler starts the next read in a new buffer), so the buffer can be kept, 
+ *  queued to another thread, or passed to @c send without a copy. The signature is
+ *  detected at compile time and is available for every @c start_io overload that 
+ *  takes a message handler, for both TCP and UDP. A UDP datagram using less than half 
+ *  of the read buffer (the max datagram size) is copied into a right sized buffer, so
+ *  held or queued datagrams do not each keep a max size read buffer.
+ *
+ *  Similarly, the second parameter can be a @c basic_io_ref (e.g. @c tcp_io_ref) instead
+ *  of a @c basic_io_interface, avoiding the reference count operations of creating and 
+ *  using a @c basic_io_interface for each message (see @c basic_io_ref).
+ *
+ *  A message handler can also take a @c const @c chops::net::receive_timestamp& as a
+ *  fourth parameter, for the kernel and network device receive times of the message
+ *  (see @c set_receive_timestamps).
 
  *  Returning @c false from the message handler callback causes the connection to be 
  *  closed.
@@ -350,6 +896,47 @@ public:
     throw net_ip_exception(std::make_error_code(net_ip_errc::weak_ptr_expired));
   }
 
+/**
+ *  @brief Enable IO processing for the associated network IO handler with message 
+ *  frame logic, reading ahead into a large buffer.
+ *
+ *  This method is not implemented for UDP IO handlers.
+ *
+ *  The message handler and message frame callbacks are the same as in the @c start_io 
+ *  method without the read ahead size, and the message frame callback is invoked with 
+ *  the same sequence of buffers. Instead of a read for each header and each message body, 
+ *  each read requests up to @c read_ahead_size bytes of whatever is available, and all 
+ *  complete messages in the buffered bytes are framed and delivered before the next 
+ *  read is started. When many messages are queued in the kernel this greatly reduces 
+ *  the number of reads (system calls) and completion handlers.
+ *
+ *  The buffer passed to a @c const_buffer message handler references the internal read 
+ *  ahead buffer (valid only for the duration of the call); a @c chops::const_shared_buffer 
+ *  message handler is given a copy of the message.
+ *
+ *  @param header_size The initial read size (in bytes) of each incoming message.
+ *
+ *  @param read_ahead_size The maximum number of bytes requested in each read. The buffer
+ *  is grown if a single message is larger.
+ *
+ *  @param msg_handler A message handler function object callback.
+ *
+ *  @param msg_frame A message frame function object callback.
+ *
+ *  @return @c false if already started, otherwise @c true.
+ *
+ *  @throw A @c net_ip_exception is thrown if there is not an associated IO handler.
+ */
+  template <typename MH, typename MF>
+  bool start_io(std::size_t header_size, std::size_t read_ahead_size, 
+                MH&& msg_handler, MF&& msg_frame) {
+    if (auto p = m_ioh_wptr.lock()) {
+      return p->start_io(header_size, read_ahead_size, 
+                         std::forward<MH>(msg_handler), std::forward<MF>(msg_frame));
+    }
+    throw net_ip_exception(std::make_error_code(net_ip_errc::weak_ptr_expired));
+  }
+
 /**
  *  @brief Enable IO processing for the associated network IO handler with delimeter 
  *  logic.
@@ -364,7 +951,15 @@ public:
  *  match" (which are usually "end-of-line" sequences). The message handler function 
  *  object callback is then invoked.
  *
- *  @param delimiter Delimiter characters denoting end of each message.
+ *  Each read requests whatever is available into a read ahead buffer (grown as needed
+ *  for long messages), and all complete messages in the buffered bytes are delivered 
+ *  before the next read. Bytes are searched for the delimiter only once, even when a 
+ *  message spans many reads. As with the read ahead message frame @c start_io, a 
+ *  @c const_buffer message handler references the read ahead buffer and a 
+ *  @c chops::const_shared_buffer message handler is given a copy of the message.
+ *
+ *  @param delimiter Delimiter characters denoting end of each message, which must not be
+ *  empty.
  *
  *  @param msg_handler A message handler function object callback. The signature of
  *  the callback is:
@@ -378,12 +973,13 @@ public:
  *  The buffer points to the complete message including the delimiter sequence. The 
  *  @c basic_io_interface can be used for sending a reply, and the endpoint is the remote 
  *  endpoint that sent the data. Returning @c false from the message handler callback 
- *  causes the connection to be closed.
+ *  causes the connection to be closed. A @c chops::const_shared_buffer first parameter
+ *  can be used instead of the @c const_buffer.
  *
  *  The message handler function object is moved if possible, otherwise it is copied. 
  *  State data should be movable or copyable.
  *
- *  @return @c false if already started, otherwise @c true.
+ *  @return @c false if already started or the delimiter is empty, otherwise @c true.
  *
  *  @throw A @c net_ip_exception is thrown if there is not an associated IO handler.
  *
@@ -428,7 +1024,11 @@ public:
  *  @endcode
  *
  *  Returning @c false from the message handler callback causes the TCP connection or UDP socket to 
- *  be closed.
+ *  be closed. A @c chops::const_shared_buffer first parameter can be used instead of the 
+ *  @c const_buffer, as described in the message frame @c start_io method. For UDP a
+ *  datagram of at least half the @c read_size is moved into the shared buffer (which
+ *  retains the capacity of the read buffer), a smaller datagram is copied into a right
+ *  sized shared buffer.
  *
  *  The message handler function object is moved if possible, otherwise it is copied. 
  *  State data should be movable or copyable.
@@ -0,0 +1,176 @@
+/** @file 
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief @c basic_io_ref class template, a borrowed reference to an IO handler for use
+ *  within message handler callbacks.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0. 
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef BASIC_IO_REF_HPP_INCLUDED
+#define BASIC_IO_REF_HPP_INCLUDED
+
+#include <cstddef> // std::size_t
+#include <utility> // std::move
+
+#include "utility/shared_buffer.hpp"
+
+#include "net_ip/basic_io_interface.hpp"
+#include "net_ip/queue_stats.hpp"
+#include "net_ip/send_priority.hpp"
+
+namespace chops {
+namespace net {
+
+/**
+ *  @brief The @c basic_io_ref class template provides unchecked access to an IO handler 
+ *  that is known to be alive, without the reference count operations of a 
+ *  @c basic_io_interface.
+ *
+ *  Each @c basic_io_interface method locks a @c std::weak_ptr (an atomic increment and 
+ *  decrement), and creating the @c basic_io_interface passed to a message handler copies
+ *  one (another atomic increment and decrement). With many connections on many cores 
+ *  these contended atomics become significant for small messages.
+ *
+ *  A message handler can instead declare a @c basic_io_ref as its second parameter, 
+ *  for example:
+ *
+ *  @code
+ *    bool (std::experimental::net::const_buffer, 
+ *          chops::net::tcp_io_ref, // basic_io_ref<tcp_io>
+ *          std::experimental::net::ip::tcp::endpoint);
+ *  @endcode
+ *
+ *  This is detected at compile time (the same as a @c chops::const_shared_buffer first 
+ *  parameter), and the message handler is given a @c basic_io_ref holding a plain pointer 
+ *  to the IO handler, which is guaranteed to be alive for the duration of the callback. 
+ *  A reply sent through it (moving the buffer in) does not touch a reference count, other
+ *  than when the writer is idle and a write is started.
+ *
+ *  @note A @c basic_io_ref must not be stored or used outside of the callback it was 
+ *  given to, since nothing keeps the IO handler alive. Use @c make_io_interface to obtain 
+ *  a @c basic_io_interface for use elsewhere.
+ *
+ */
+
+template <typename IOT>
+class basic_io_ref {
+private:
+  IOT*    m_ioh;
+
+public:
+  using endpoint_type = typename IOT::endpoint_type;
+
+public:
+
+/**
+ *  @brief Construct from an IO handler, this is an internal constructor only and not 
+ *  to be used by application code.
+ */
+  explicit basic_io_ref(IOT& ioh) noexcept : m_ioh(&ioh) { }
+
+/**
+ *  @brief Query whether @c start_io on the IO handler has been called or not.
+ */
+  bool is_io_started() const { return m_ioh->is_io_started(); }
+
+/**
+ *  @brief Return a reference to the underlying socket.
+ */
+  typename IOT::socket_type& get_socket() const { return m_ioh->get_socket(); }
+
+/**
+ *  @brief Return output queue statistics, see @c basic_io_interface.
+ */
+  output_queue_stats get_output_queue_stats() const { return m_ioh->get_output_queue_stats(); }
+
+/**
+ *  @brief Query whether the output queue is congested, see @c basic_io_interface.
+ */
+  bool is_output_congested() const { return m_ioh->is_output_congested(); }
+
+/**
+ *  @brief Copy the bytes into a reference counted buffer and send it.
+ */
+  void send(const void* buf, std::size_t sz) const { send(chops::const_shared_buffer(buf, sz)); }
+
+/**
+ *  @brief Send a reference counted buffer, moving it into the output queue.
+ *
+ *  Pass the buffer with @c std::move to avoid a reference count increment.
+ */
+  void send(chops::const_shared_buffer buf) const { m_ioh->send(std::move(buf)); }
+
+/**
+ *  @brief Send a reference counted buffer through an output queue lane, see 
+ *  @c basic_io_interface.
+ */
+  void send(chops::const_shared_buffer buf, send_priority pri) const { 
+    m_ioh->send(std::move(buf), pri);
+  }
+
+/**
+ *  @brief Move a writable reference counted buffer into an immutable one and send it.
+ */
+  void send(chops::mutable_shared_buffer&& buf) const { 
+    send(chops::const_shared_buffer(std::move(buf)));
+  }
+
+/**
+ *  @brief Copy the bytes into a reference counted buffer and send it to an endpoint.
+ */
+  void send(const void* buf, std::size_t sz, const endpoint_type& endp) const {
+    send(chops::const_shared_buffer(buf, sz), endp);
+  }
+
+/**
+ *  @brief Send a reference counted buffer to an endpoint, moving it into the output queue.
+ */
+  void send(chops::const_shared_buffer buf, const endpoint_type& endp) const {
+    m_ioh->send(std::move(buf), endp);
+  }
+
+/**
+ *  @brief Send a reference counted buffer to an endpoint through an output queue lane,
+ *  see @c basic_io_interface.
+ */
+  void send(chops::const_shared_buffer buf, const endpoint_type& endp, 
+            send_priority pri) const {
+    m_ioh->send(std::move(buf), endp, pri);
+  }
+
+/**
+ *  @brief Move a writable reference counted buffer into an immutable one and send it 
+ *  to an endpoint.
+ */
+  void send(chops::mutable_shared_buffer&& buf, const endpoint_type& endp) const { 
+    send(chops::const_shared_buffer(std::move(buf)), endp);
+  }
+
+/**
+ *  @brief Stop IO processing, see @c basic_io_interface.
+ */
+  bool stop_io() const { return m_ioh->stop_io(); }
+
+/**
+ *  @brief Create a @c basic_io_interface for the IO handler, which can be stored and used
+ *  outside of the callback.
+ */
+  basic_io_interface<IOT> make_io_interface() const {
+    return basic_io_interface<IOT>(m_ioh->weak_from_this());
+  }
+
+};
+
+} // end net namespace
+} // end chops namespace
+
+#endif
+
@@ -22,7 +22,11 @@
 #include <utility> // std::move, std::forward
 #include <system_error> // std::make_error, std::error_code
 
+#include <experimental/internet>
+
 #include "net_ip/net_ip_error.hpp"
+#include "net_ip/multicast.hpp"
+#include "net_ip/accept_limits.hpp"
 
 #include "net_ip/basic_io_interface.hpp"
 
@@ -256,6 +260,75 @@ public:
     }
     throw net_ip_exception(std::make_error_code(net_ip_errc::weak_ptr_expired));
   }
+
+/**
+ *  @brief Join a multicast group, implemented only for UDP multicast entities (see 
+ *  @c net_ip @c make_udp_multicast).
+ *
+ *  The group is joined on the interface from the @c multicast_options. If the entity is
+ *  not started, the group is joined when @c start is called. Joining a group that has 
+ *  already been joined has no effect. This method does not block; a failure to join is 
+ *  reported through the error function object, and the entity stays started.
+ *
+ *  @param group Multicast group address.
+ *
+ *  @throw A @c net_ip_exception is thrown if there is not an associated net entity.
+ */
+  void join_group(const std::experimental::net::ip::address& group) const {
+    if (auto p = m_eh_wptr.lock()) {
+      p->join_group(group);
+      return;
+    }
+    throw net_ip_exception(std::make_error_code(net_ip_errc::weak_ptr_expired));
+  }
+
+/**
+ *  @brief Leave a multicast group, implemented only for UDP multicast entities.
+ *
+ *  See @c join_group. The statistics for the group are discarded.
+ *
+ *  @param group Multicast group address.
+ *
+ *  @throw A @c net_ip_exception is thrown if there is not an associated net entity.
+ */
+  void leave_group(const std::experimental::net::ip::address& group) const {
+    if (auto p = m_eh_wptr.lock()) {
+      p->leave_group(group);
+      return;
+    }
+    throw net_ip_exception(std::make_error_code(net_ip_errc::weak_ptr_expired));
+  }
+
+/**
+ *  @brief Return incoming datagram statistics for each joined group, implemented only
+ *  for UDP entities (the statistics are empty for a UDP unicast entity).
+ *
+ *  @return @c multicast_stats object.
+ *
+ *  @throw A @c net_ip_exception is thrown if there is not an associated net entity.
+ */
+  multicast_stats get_multicast_stats() const {
+    if (auto p = m_eh_wptr.lock()) {
+      return p->get_multicast_stats();
+    }
+    throw net_ip_exception(std::make_error_code(net_ip_errc::weak_ptr_expired));
+  }
+
+/**
+ *  @brief Return accept statistics, implemented only for TCP acceptor entities (see 
+ *  @c accept_limits).
+ *
+ *  @return @c accept_stats object.
+ *
+ *  @throw A @c net_ip_exception is thrown if there is not an associated net entity.
+ */
+  accept_stats get_accept_stats() const {
+    if (auto p = m_eh_wptr.lock()) {
+      return p->get_accept_stats();
+    }
+    throw net_ip_exception(std::make_error_code(net_ip_errc::weak_ptr_expired));
+  }
+
 /**
  *  @brief Compare two @c basic_net_entity objects for equality.
  *
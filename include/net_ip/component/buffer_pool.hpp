@@ -0,0 +1,355 @@
+/** @file
+ *
+ *  @ingroup net_ip_component_module
+ *
+ *  @brief A size-classed pool of buffer storage for creating @c chops::mutable_shared_buffer
+ *  and @c chops::const_shared_buffer objects without a heap allocation for the bytes.
+ *
+ *  The pool recycles vector storage: buffers are created from a cached vector (with 
+ *  enough capacity). A @c pooled_buffer gives its storage back to the pool when the last
+ *  reference drops (e.g. after it has been sent), through the deleter of its shared
+ *  pointer. The shared buffer classes own a @c std::vector<std::byte>, with no allocator
+ *  or deleter customization point, so their storage is given back to the pool through 
+ *  an explicit @c release call; shared buffers that are not released are freed normally
+ *  when the last reference drops, which is always safe.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef BUFFER_POOL_HPP_INCLUDED
+#define BUFFER_POOL_HPP_INCLUDED
+
+#include <vector>
+#include <array>
+#include <memory> // std::unique_ptr, std::shared_ptr
+#include <mutex>
+#include <thread> // std::this_thread::get_id, std::thread::hardware_concurrency
+#include <functional> // std::hash
+#include <atomic>
+#include <cstddef> // std::size_t, std::byte
+#include <utility> // std::move
+
+#include "utility/shared_buffer.hpp"
+
+#include "net_ip/read_buffer_policy.hpp"
+#include "net_ip/pooled_buffer.hpp"
+
+namespace chops {
+namespace net {
+
+/**
+ *  @brief Statistics for a @c buffer_pool, all values are accumulated since the pool
+ *  was constructed.
+ */
+struct buffer_pool_stats {
+  // number of buffers created from cached storage
+  std::size_t    num_hits = 0;
+  // number of buffers created with newly allocated storage
+  std::size_t    num_misses = 0;
+  // number of releases (calls, or pooled buffers dropped) where the storage was cached
+  std::size_t    num_released = 0;
+  // number of releases where the storage was freed (cache full or size not pooled)
+  std::size_t    num_dropped = 0;
+};
+
+/**
+ *  @brief Size-classed buffer storage pool with per thread caching.
+ *
+ *  Storage is kept in power of two size classes, from @c min_size up to the max size
+ *  given in the constructor. Requests larger than the max size are allocated normally and
+ *  are never cached.
+ *
+ *  The cache is split into shards, each with its own lock, and a thread always uses the
+ *  shard selected by its thread id. With the default shard count (one per hardware thread)
+ *  threads rarely contend, giving most of the benefit of a thread local cache while still
+ *  allowing multiple independent pools and storage to be released from any thread.
+ *
+ *  All methods can be called concurrently from multiple threads.
+ *
+ *  @note This class is not a necessary dependency of the @c net_ip library, but
+ *  is provided for convenience in many use cases. Shared buffers created by the pool are
+ *  ordinary shared buffers and can be passed unchanged to any @c send method, a 
+ *  @c pooled_buffer can be sent through a TCP IO handler.
+ */
+class buffer_pool {
+public:
+  using byte_vec = chops::mutable_shared_buffer::byte_vec;
+
+  static constexpr std::size_t min_size = 64u;
+  static constexpr std::size_t max_size_classes = 20u;
+
+private:
+
+  struct shard {
+    std::mutex                                          m_mutex;
+    std::array<std::vector<byte_vec>, max_size_classes> m_free;
+  };
+
+  // the caches are shared with the pooled buffers, which may outlive the pool object
+  struct pool_state {
+    std::size_t                          m_num_classes;
+    std::size_t                          m_max_cached;
+    std::vector<std::unique_ptr<shard> > m_shards;
+    std::atomic_size_t                   m_hits;
+    std::atomic_size_t                   m_misses;
+    std::atomic_size_t                   m_released;
+    std::atomic_size_t                   m_dropped;
+
+    pool_state(std::size_t max_size, std::size_t max_cached, std::size_t num_shards) :
+        m_num_classes(1u), m_max_cached(max_cached), m_shards(),
+        m_hits(0u), m_misses(0u), m_released(0u), m_dropped(0u) {
+      while (class_size(m_num_classes - 1u) < max_size && m_num_classes < max_size_classes) {
+        ++m_num_classes;
+      }
+      if (num_shards == 0u) {
+        num_shards = std::thread::hardware_concurrency();
+      }
+      num_shards = (num_shards == 0u) ? 1u : num_shards;
+      for (std::size_t i = 0u; i < num_shards; ++i) {
+        m_shards.push_back(std::make_unique<shard>());
+      }
+    }
+
+    std::size_t max_pooled_size() const noexcept { return class_size(m_num_classes - 1u); }
+
+    shard& select_shard() noexcept {
+      return *m_shards[std::hash<std::thread::id>()(std::this_thread::get_id()) % m_shards.size()];
+    }
+
+    byte_vec acquire(std::size_t sz) {
+      if (sz > max_pooled_size()) {
+        ++m_misses;
+        return byte_vec { };
+      }
+      std::size_t idx = 0u;
+      while (class_size(idx) < sz) {
+        ++idx;
+      }
+      auto& sh = select_shard();
+      {
+        std::lock_guard<std::mutex> lk(sh.m_mutex);
+        auto& fl = sh.m_free[idx];
+        if (!fl.empty()) {
+          byte_vec bv { std::move(fl.back()) };
+          fl.pop_back();
+          ++m_hits;
+          return bv;
+        }
+      }
+      ++m_misses;
+      byte_vec bv { };
+      bv.reserve(class_size(idx));
+      return bv;
+    }
+
+    void release(byte_vec&& bv) {
+      auto cap = bv.capacity();
+      if (cap < min_size || cap > max_pooled_size()) {
+        ++m_dropped;
+        return;
+      }
+      // largest size class that fits within the capacity
+      std::size_t idx = 0u;
+      while (idx + 1u < m_num_classes && class_size(idx + 1u) <= cap) {
+        ++idx;
+      }
+      auto& sh = select_shard();
+      {
+        std::lock_guard<std::mutex> lk(sh.m_mutex);
+        auto& fl = sh.m_free[idx];
+        if (fl.size() < m_max_cached) {
+          bv.clear();
+          fl.push_back(std::move(bv));
+          ++m_released;
+          return;
+        }
+      }
+      ++m_dropped;
+    }
+  };
+
+  // deleter of the pooled buffer storage
+  struct storage_return {
+    std::shared_ptr<pool_state> m_state;
+
+    void operator()(byte_vec* p) const noexcept {
+      try {
+        m_state->release(std::move(*p));
+      }
+      catch (...) { // out of memory for the cache entry, the storage is freed
+        ++m_state->m_dropped;
+      }
+      delete p;
+    }
+  };
+
+private:
+
+  std::shared_ptr<pool_state> m_state;
+
+public:
+
+/**
+ *  @brief Construct a @c buffer_pool.
+ *
+ *  @param max_size Largest buffer size that is pooled, rounded up to a power of two.
+ *
+ *  @param max_cached Maximum number of cached buffers per size class in each shard.
+ *
+ *  @param num_shards Number of cache shards, 0 means one per hardware thread.
+ */
+  explicit buffer_pool(std::size_t max_size = 65536u, std::size_t max_cached = 256u,
+                       std::size_t num_shards = 0u) :
+      m_state(std::make_shared<pool_state>(max_size, max_cached, num_shards)) { }
+
+  buffer_pool(const buffer_pool&) = delete;
+  buffer_pool& operator=(const buffer_pool&) = delete;
+
+/**
+ *  @brief Largest buffer size that is pooled.
+ */
+  std::size_t max_pooled_size() const noexcept { return m_state->max_pooled_size(); }
+
+/**
+ *  @brief Create a @c pooled_buffer of a given size, using cached storage if available.
+ *
+ *  The storage goes back to the pool when the last reference to the buffer drops, 
+ *  including the references held by the output queues of the IO handlers it has been
+ *  sent through, so no @c release call is needed. The pool object may be destroyed
+ *  before the buffer.
+ *
+ *  The contents of the buffer are zeroed, as with a newly constructed 
+ *  @c mutable_shared_buffer.
+ *
+ *  @param sz Size of the buffer.
+ */
+  pooled_buffer make_pooled_buffer(std::size_t sz) {
+    byte_vec bv = m_state->acquire(sz);
+    bv.resize(sz);
+    return make_pooled(std::move(bv));
+  }
+
+/**
+ *  @brief Create a @c pooled_buffer by copying bytes into pooled storage.
+ *
+ *  @param buf Pointer to the bytes to copy.
+ *
+ *  @param sz Number of bytes.
+ */
+  pooled_buffer make_pooled_buffer(const void* buf, std::size_t sz) {
+    byte_vec bv = m_state->acquire(sz);
+    auto p = static_cast<const std::byte*>(buf);
+    bv.assign(p, p + sz);
+    return make_pooled(std::move(bv));
+  }
+
+/**
+ *  @brief Create a @c chops::mutable_shared_buffer of a given size, using cached storage
+ *  if available.
+ *
+ *  The shared buffer classes do not allow a custom deleter, so the storage only goes 
+ *  back to the pool through @c release; use @c make_pooled_buffer for buffers that are
+ *  sent.
+ *
+ *  The contents of the buffer are zeroed, as with a newly constructed 
+ *  @c mutable_shared_buffer; the pool saves the allocation, not the fill.
+ *
+ *  @param sz Size of the buffer.
+ */
+  chops::mutable_shared_buffer make_mutable_buffer(std::size_t sz) {
+    byte_vec bv = m_state->acquire(sz);
+    bv.resize(sz);
+    return chops::mutable_shared_buffer(std::move(bv));
+  }
+
+/**
+ *  @brief Create a @c chops::const_shared_buffer by copying bytes into pooled storage.
+ *
+ *  The storage is not returned to the pool, use @c make_pooled_buffer for buffers that
+ *  are sent.
+ *
+ *  @param buf Pointer to the bytes to copy.
+ *
+ *  @param sz Number of bytes.
+ */
+  chops::const_shared_buffer make_const_buffer(const void* buf, std::size_t sz) {
+    byte_vec bv = m_state->acquire(sz);
+    auto p = static_cast<const std::byte*>(buf);
+    bv.assign(p, p + sz);
+    return chops::const_shared_buffer(chops::mutable_shared_buffer(std::move(bv)));
+  }
+
+/**
+ *  @brief Give the storage of a @c chops::mutable_shared_buffer back to the pool.
+ *
+ *  The storage is moved out of the buffer, which is left empty. Other copies of the
+ *  buffer (which share the storage) will also see an empty buffer, so this should only
+ *  be called when no other references are in use.
+ */
+  void release(chops::mutable_shared_buffer& buf) {
+    byte_vec bv { };
+    bv.swap(buf.get_byte_vec());
+    release(std::move(bv));
+  }
+
+/**
+ *  @brief Give a @c std::vector<std::byte> back to the pool.
+ *
+ *  The vector is cached by its capacity, so any vector can be released, not only ones
+ *  created from the pool.
+ */
+  void release(byte_vec&& bv) { m_state->release(std::move(bv)); }
+
+/**
+ *  @brief Return the accumulated pool statistics.
+ */
+  buffer_pool_stats get_stats() const noexcept {
+    return buffer_pool_stats { m_state->m_hits, m_state->m_misses, m_state->m_released, 
+                               m_state->m_dropped };
+  }
+
+private:
+
+  static constexpr std::size_t class_size(std::size_t idx) noexcept { return min_size << idx; }
+
+  pooled_buffer make_pooled(byte_vec&& bv) {
+    return pooled_buffer(std::shared_ptr<byte_vec>(new byte_vec(std::move(bv)), 
+                                                   storage_return { m_state }));
+  }
+
+};
+
+/**
+ *  @brief Create a @c read_buffer_policy where the large read buffers of IO handlers are
+ *  borrowed from a shared @c buffer_pool.
+ *
+ *  @param pool Buffer pool, shared by all IO handlers using the policy.
+ *
+ *  @param shrink_size Read buffers above this size are borrowed from the pool while a 
+ *  large message is received, and given back when it has been delivered.
+ */
+inline read_buffer_policy make_pooled_read_buffer_policy(std::shared_ptr<buffer_pool> pool,
+                                                         std::size_t shrink_size) {
+  read_buffer_policy pol;
+  pol.shrink_size = shrink_size;
+  pol.acquire = [pool] (std::size_t sz) {
+    auto mb = pool->make_mutable_buffer(sz);
+    buffer_pool::byte_vec bv { };
+    bv.swap(mb.get_byte_vec());
+    return bv;
+  };
+  pol.release = [pool] (buffer_pool::byte_vec&& bv) { pool->release(std::move(bv)); };
+  return pol;
+}
+
+} // end net namespace
+} // end chops namespace
+
+#endif
+
@@ -0,0 +1,431 @@
+/** @file
+ *
+ *  @ingroup net_ip_component_module
+ *
+ *  @brief A group of TCP connectors to replicated endpoints, with each send routed to
+ *  one live connection, chosen by output queue depth or by key.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef CONNECTOR_GROUP_HPP_INCLUDED
+#define CONNECTOR_GROUP_HPP_INCLUDED
+
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint64_t
+#include <utility> // std::move, std::forward, std::pair
+#include <algorithm> // std::lower_bound, std::sort
+#include <string_view>
+#include <mutex>
+#include <vector>
+
+#include "net_ip/basic_io_interface.hpp"
+#include "net_ip/queue_stats.hpp"
+#include "net_ip/net_ip_error.hpp"
+
+#include "utility/erase_where.hpp"
+#include "utility/shared_buffer.hpp"
+
+namespace chops {
+namespace net {
+
+/**
+ *  @brief How an unkeyed @c connector_group @c send chooses a connection.
+ *
+ *  @c least_loaded compares the output queue bytes (then the output queue size) of every
+ *  live connection. @c power_of_two_choices compares two live connections chosen at
+ *  random, which costs two output queue statistics queries per send independent of the
+ *  group size, and avoids every sender piling onto the same momentarily idle connection.
+ */
+enum class lb_policy { least_loaded, power_of_two_choices };
+
+/**
+ *  @brief Manage a group of connections (one per connector, typically several connectors
+ *  for each of several replicated endpoints) and route each send to one of them.
+ *
+ *  Each connector added with @c add_connector owns a slot in the group. The slot is live
+ *  while the connector has a connection; while the connector is (re)connecting the slot
+ *  is skipped, and when the connection comes back the slot is used again without any
+ *  application involvement (an idle reconnected connection has an empty output queue, so
+ *  it immediately attracts traffic).
+ *
+ *  An unkeyed @c send uses the @c lb_policy of the group. A keyed @c send uses a
+ *  consistent hash ring of all slots (with @c vnodes points per slot), routing the key to
+ *  the first live slot at or after the key's hash; all messages with the same key go to
+ *  the same connection while it is up, and keys only move when their connection is down,
+ *  returning once it reconnects.
+ *
+ *  Typical usage with a @c net_ip object:
+ *
+ *  @code
+ *    chops::net::connector_group<chops::net::tcp_io> grp;
+ *    for (const auto& host : hosts) {
+ *      for (int i = 0; i < conns_per_host; ++i) {
+ *        grp.add_connector(nip.make_tcp_connector(port, host, opts),
+ *          [] (chops::net::tcp_io_interface io) { io.start_io(2, msg_hdlr, msg_frame); },
+ *          err_func);
+ *      }
+ *    }
+ *    grp.send(buf);               // least loaded connection
+ *    grp.send(session_id, buf);   // consistent hashing by key
+ *  @endcode
+ *
+ *  The group must outlive the connectors added to it (stop them, or the @c net_ip object,
+ *  first), since their IO state change callbacks refer to the group.
+ *
+ *  A connection can go away before its connector reports it; a send that finds the IO
+ *  handler of a slot gone marks the slot down and chooses another connection.
+ *
+ *  This class is thread-safe for concurrent access.
+ *
+ */
+template <typename IOT>
+class connector_group {
+private:
+  using lock_guard = std::lock_guard<std::mutex>;
+  using io_intf    = basic_io_interface<IOT>;
+  using ring_point = std::pair<std::uint64_t, std::size_t>; // hash, slot index
+
+  struct slot {
+    io_intf   m_io;
+    bool      m_live = false;
+  };
+
+private:
+  mutable std::mutex        m_mutex;
+  // a (const) send marks down a slot whose IO handler is gone
+  mutable std::vector<slot>         m_slots;
+  mutable std::vector<std::size_t>  m_live; // indices of the live slots
+  std::vector<ring_point>   m_ring; // sorted by hash
+  lb_policy                 m_policy;
+  std::size_t               m_vnodes;
+  mutable std::uint64_t     m_rand;
+  mutable std::size_t       m_num_unrouted = 0;
+
+public:
+
+/**
+ *  @brief Construct an empty group.
+ *
+ *  @param policy Connection choice for unkeyed sends.
+ *
+ *  @param vnodes Number of consistent hash ring points per slot, more points spread the
+ *  keys of a down connection more evenly over the others.
+ */
+  explicit connector_group(lb_policy policy = lb_policy::least_loaded,
+                           std::size_t vnodes = 64u) :
+      m_mutex(), m_slots(), m_live(), m_ring(), m_policy(policy),
+      m_vnodes(vnodes == 0u ? 1u : vnodes), m_rand(0x9E3779B97F4A7C15ull) { }
+
+/**
+ *  @brief Add a slot, not yet live, to the group.
+ *
+ *  @return Slot index, used with @c make_io_state_change.
+ */
+  std::size_t add_slot() {
+    lock_guard gd { m_mutex };
+    std::size_t idx = m_slots.size();
+    m_slots.push_back(slot());
+    for (std::size_t v = 0u; v < m_vnodes; ++v) {
+      m_ring.emplace_back(mix((static_cast<std::uint64_t>(idx) << 32u) | v), idx);
+    }
+    std::sort(m_ring.begin(), m_ring.end());
+    return idx;
+  }
+
+/**
+ *  @brief Create an IO state change function object for a slot, for the @c start method
+ *  of a connector.
+ *
+ *  @param idx Slot index returned from @c add_slot.
+ *
+ *  @param start_io_func Function object called with the @c basic_io_interface of each
+ *  new connection, typically calling @c start_io; the slot is live once it returns.
+ */
+  template <typename SF>
+  auto make_io_state_change(std::size_t idx, SF&& start_io_func) {
+    return [this, idx, sf = std::forward<SF>(start_io_func)]
+                  (io_intf io, std::size_t, bool starting) mutable {
+      if (starting) {
+        sf(io);
+        set_live(idx, io);
+      }
+      else {
+        set_down(idx);
+      }
+    };
+  }
+
+/**
+ *  @brief Add a connector (any @c basic_net_entity that creates a connection) to the
+ *  group and start it.
+ *
+ *  @param ent Connector, e.g. returned from @c net_ip @c make_tcp_connector.
+ *
+ *  @param start_io_func Function object called with each new connection, see
+ *  @c make_io_state_change.
+ *
+ *  @param err_func Error callback for the connector.
+ *
+ *  @return Slot index of the connector.
+ */
+  template <typename E, typename SF, typename EF>
+  std::size_t add_connector(E ent, SF&& start_io_func, EF&& err_func) {
+    auto idx = add_slot();
+    ent.start(make_io_state_change(idx, std::forward<SF>(start_io_func)),
+              std::forward<EF>(err_func));
+    return idx;
+  }
+
+/**
+ *  @brief Mark a slot live with a connection.
+ */
+  void set_live(std::size_t idx, io_intf io) {
+    lock_guard gd { m_mutex };
+    auto& s = m_slots[idx];
+    s.m_io = io;
+    if (!s.m_live) {
+      s.m_live = true;
+      m_live.push_back(idx);
+    }
+  }
+
+/**
+ *  @brief Mark a slot down, e.g. while its connector is reconnecting.
+ */
+  void set_down(std::size_t idx) {
+    lock_guard gd { m_mutex };
+    mark_down(idx);
+  }
+
+/**
+ *  @brief Send a reference counted buffer to one live connection, chosen by the
+ *  @c lb_policy of the group.
+ *
+ *  @return @c false if there is no live connection.
+ */
+  bool send(chops::const_shared_buffer buf) const {
+    lock_guard gd { m_mutex };
+    for (;;) {
+      auto idx = choose();
+      if (idx == m_slots.size()) {
+        ++m_num_unrouted;
+        return false;
+      }
+      if (send_to_slot(idx, buf)) {
+        return true;
+      }
+    }
+  }
+
+/**
+ *  @brief Copy the bytes, create a reference counted buffer, then send it.
+ */
+  bool send(const void* buf, std::size_t sz) const {
+    return send(chops::const_shared_buffer(buf, sz));
+  }
+
+/**
+ *  @brief Move the buffer from a writable reference counted buffer to a
+ *  immutable reference counted buffer, then send it.
+ */
+  bool send(chops::mutable_shared_buffer&& buf) const {
+    return send(chops::const_shared_buffer(std::move(buf)));
+  }
+
+/**
+ *  @brief Send a reference counted buffer to the live connection of a key on the
+ *  consistent hash ring.
+ *
+ *  @return @c false if there is no live connection.
+ */
+  bool send(std::uint64_t key, chops::const_shared_buffer buf) const {
+    lock_guard gd { m_mutex };
+    auto h = mix(key);
+    for (;;) {
+      auto idx = slot_by_hash(h);
+      if (idx == m_slots.size()) {
+        ++m_num_unrouted;
+        return false;
+      }
+      if (send_to_slot(idx, buf)) {
+        return true;
+      }
+    }
+  }
+
+/**
+ *  @brief Send a reference counted buffer to the live connection of a string key on the
+ *  consistent hash ring.
+ */
+  bool send(std::string_view key, chops::const_shared_buffer buf) const {
+    return send(fnv1a(key), std::move(buf));
+  }
+
+/**
+ *  @brief Return the slot index a key is currently routed to, or the number of slots if
+ *  there is no live connection.
+ */
+  std::size_t slot_of(std::uint64_t key) const {
+    lock_guard gd { m_mutex };
+    return slot_by_hash(mix(key));
+  }
+
+  std::size_t slot_of(std::string_view key) const { return slot_of(fnv1a(key)); }
+
+/**
+ *  @brief Return the number of slots (connectors) in the group.
+ */
+  std::size_t size() const noexcept {
+    lock_guard gd { m_mutex };
+    return m_slots.size();
+  }
+
+/**
+ *  @brief Return the number of slots with a live connection.
+ */
+  std::size_t num_live() const noexcept {
+    lock_guard gd { m_mutex };
+    return m_live.size();
+  }
+
+/**
+ *  @brief Return the number of sends that were not routed since there was no live
+ *  connection.
+ */
+  std::size_t get_num_unrouted() const noexcept {
+    lock_guard gd { m_mutex };
+    return m_num_unrouted;
+  }
+
+private:
+
+  static std::uint64_t mix(std::uint64_t x) noexcept { // splitmix64 finalizer
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30u)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27u)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31u);
+  }
+
+  static std::uint64_t fnv1a(std::string_view key) noexcept {
+    std::uint64_t h = 0xCBF29CE484222325ull;
+    for (char c : key) {
+      h = (h ^ static_cast<unsigned char>(c)) * 0x100000001B3ull;
+    }
+    return h;
+  }
+
+  std::size_t next_rand(std::size_t n) const noexcept { // xorshift64
+    m_rand ^= m_rand << 13u;
+    m_rand ^= m_rand >> 7u;
+    m_rand ^= m_rand << 17u;
+    return static_cast<std::size_t>(m_rand % n);
+  }
+
+  // called with the lock held
+  void mark_down(std::size_t idx) const {
+    auto& s = m_slots[idx];
+    s.m_io = io_intf();
+    if (s.m_live) {
+      s.m_live = false;
+      chops::erase_where(m_live, idx);
+    }
+  }
+
+  // false if the IO handler is gone, the slot is then marked down
+  bool send_to_slot(std::size_t idx, const chops::const_shared_buffer& buf) const {
+    try {
+      m_slots[idx].m_io.send(buf);
+      return true;
+    }
+    catch (const net_ip_exception&) {
+      mark_down(idx);
+      return false;
+    }
+  }
+
+  // smaller is less loaded; false if the IO handler is gone, the slot is then marked down
+  bool load_of(std::size_t idx, std::pair<std::size_t, std::size_t>& ld) const {
+    try {
+      auto qs = m_slots[idx].m_io.get_output_queue_stats();
+      ld = { qs.bytes_in_output_queue, qs.output_queue_size };
+      return true;
+    }
+    catch (const net_ip_exception&) {
+      mark_down(idx);
+      return false;
+    }
+  }
+
+  // the number of slots if there is no live connection; each pass either chooses a slot
+  // or marks one down
+  std::size_t choose() const {
+    for (;;) {
+      if (m_live.empty()) {
+        return m_slots.size();
+      }
+      if (m_live.size() == 1u) {
+        return m_live.front();
+      }
+      if (m_policy == lb_policy::power_of_two_choices) {
+        auto a = next_rand(m_live.size());
+        auto b = next_rand(m_live.size() - 1u);
+        b = (b >= a) ? b + 1u : b; // distinct from a
+        auto ia = m_live[a];
+        auto ib = m_live[b];
+        std::pair<std::size_t, std::size_t> lda { };
+        std::pair<std::size_t, std::size_t> ldb { };
+        if (!load_of(ia, lda) || !load_of(ib, ldb)) {
+          continue;
+        }
+        return (ldb < lda) ? ib : ia;
+      }
+      std::size_t best = m_slots.size();
+      std::pair<std::size_t, std::size_t> best_load { };
+      bool gone = false;
+      for (std::size_t i = 0u; i < m_live.size() && !gone; ++i) {
+        auto idx = m_live[i];
+        std::pair<std::size_t, std::size_t> ld { };
+        if (!load_of(idx, ld)) {
+          gone = true; // m_live changed
+        }
+        else if (best == m_slots.size() || ld < best_load) {
+          best = idx;
+          best_load = ld;
+        }
+      }
+      if (!gone) {
+        return best;
+      }
+    }
+  }
+
+  std::size_t slot_by_hash(std::uint64_t h) const {
+    if (m_live.empty()) {
+      return m_slots.size();
+    }
+    auto it = std::lower_bound(m_ring.cbegin(), m_ring.cend(), ring_point(h, 0u));
+    for (std::size_t i = 0u; i < m_ring.size(); ++i, ++it) {
+      if (it == m_ring.cend()) {
+        it = m_ring.cbegin();
+      }
+      if (m_slots[it->second].m_live) {
+        return it->second;
+      }
+    }
+    return m_slots.size();
+  }
+
+};
+
+} // end net namespace
+} // end chops namespace
+
+#endif
+
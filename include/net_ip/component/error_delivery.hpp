@@ -27,6 +27,8 @@
 #include "net_ip/basic_io_interface.hpp"
 #include "net_ip/io_interface.hpp"
 
+#include "net_ip/component/ring_queue.hpp"
+
 #include "queue/wait_queue.hpp"
 
 
@@ -127,6 +129,74 @@ inline std::size_t ostream_error_sink_with_wait_queue (err_wait_q& wq, std::ostr
   return cnt;
 }
 
+/**
+ *  @brief @c ring_queue declaration that provides error data.
+ */
+using err_ring_q = ring_queue<error_data>;
+
+/**
+ *  @brief Create an error function object that uses a @c ring_queue for error data.
+ *
+ *  The error function never blocks the IO thread; when the @c ring_queue is full the
+ *  error data is dropped and counted by the queue.
+ */
+template <typename IOT>
+auto make_error_func_with_ring_queue(err_ring_q& rq) {
+  return [&rq] (basic_io_interface<IOT> io, std::error_code e) {
+    rq.try_emplace_push(static_cast<const void *>(io.get_shared_ptr().get()), e);
+  };
+}
+
+/**
+ *  @brief A sink function that drains a @c ring_queue of error data in batches and 
+ *  streams the data into an @c std::ostream.
+ *
+ *  The output format is the same as @c ostream_error_sink_with_wait_queue. In addition,
+ *  when entries were dropped since the previous batch (because the sink did not keep up
+ *  with the error functions), a line with the number of dropped entries is streamed.
+ *  This function exits when the @c ring_queue is closed and empty.
+ *
+ *  @c std::async can be used to invoke this function in a separate thread.
+ *
+ *  @param rq A reference to a @c err_ring_q object.
+ *
+ *  @param os A reference to a @c std::ostream, such as @c std::cerr.
+ *
+ *  @param max_batch Maximum number of entries streamed between drop count checks.
+ *
+ *  @return The total number of entries processed by the function before the queue is 
+ *  closed, not including dropped entries.
+ */
+inline std::size_t ostream_error_sink_with_ring_queue (err_ring_q& rq, std::ostream& os,
+                                                       std::size_t max_batch = 64u) {
+  std::size_t cnt = 0;
+  std::size_t reported_drops = 0;
+  auto report_drops = [&rq, &os, &reported_drops] {
+    auto drops = rq.num_dropped();
+    if (drops != reported_drops) {
+      os << "error entries dropped: " << (drops - reported_drops) << '\n';
+      reported_drops = drops;
+    }
+  };
+  while (true) {
+    auto num = rq.wait_and_pop_batch([&os] (error_data&& elem) {
+        auto t =
+          std::chrono::duration_cast<std::chrono::milliseconds>(elem.time_p.time_since_epoch()).count();
+
+        os << '[' << t << "] io_addr: " << elem.io_intf_ptr << " err: " << 
+              elem.err << ", " << elem.err.message() << '\n';
+      }, max_batch);
+    if (num == 0u) {
+      break;
+    }
+    cnt += num;
+    report_drops();
+  }
+  report_drops();
+  os.flush();
+  return cnt;
+}
+
 } // end net namespace
 } // end chops namespace
 
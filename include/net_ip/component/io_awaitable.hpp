@@ -0,0 +1,436 @@
+/** @file
+ *
+ *  @ingroup net_ip_component_module
+ *
+ *  @brief C++20 coroutine awaitables for IO state changes, incoming messages, and
+ *  sends, so that protocol logic can be written as straight-line code.
+ *
+ *  The core of this header is @c awaitable_channel, a queue with a single consumer
+ *  coroutine. When a value is pushed and the coroutine is waiting, the coroutine is
+ *  resumed inline, on the thread that pushed the value. Since IO state change callbacks
+ *  and message handlers are invoked within the IO handler (or net entity) executor, a
+ *  coroutine awaiting on a channel runs on that executor as well, without a thread
+ *  handoff, a @c std::promise, or a @c wait_queue condition variable.
+ *
+ *  The coroutine return type is left to the application (or a coroutine library),
+ *  nothing in this header depends on it.
+ *
+ *  A typical TCP session:
+ *
+ *  @code
+ *    chops::net::tcp_io_state_chg_channel io_ch;
+ *    chops::net::tcp_io_msg_channel msg_ch;
+ *    chops::net::start_with_channel(connector,
+ *        chops::net::make_simple_variable_len_msg_frame_io_state_change(2, decoder,
+ *                                 chops::net::make_channel_msg_hdlr(msg_ch)),
+ *        io_ch, chops::net::tcp_empty_error_func);
+ *    // within a coroutine
+ *    auto chg = co_await io_ch.next(); // std::optional<io_state_chg_data<tcp_io>>
+ *    while (auto msg = co_await msg_ch.next()) {
+ *      // process msg->buf, reply with msg->io.send( ... )
+ *    }
+ *  @endcode
+ *
+ *  Nothing in this header is available unless the compiler supports coroutines
+ *  (C++20), the rest of the library only needs C++17.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef IO_AWAITABLE_HPP_INCLUDED
+#define IO_AWAITABLE_HPP_INCLUDED
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <coroutine>
+#include <cstddef> // std::size_t
+#include <utility> // std::move, std::forward
+#include <system_error>
+#include <memory> // std::shared_ptr
+#include <mutex>
+#include <deque>
+#include <optional>
+
+#include "net_ip/net_entity.hpp"
+#include "net_ip/io_interface.hpp"
+#include "net_ip/net_ip_error.hpp"
+#include "net_ip/output_queue_limits.hpp"
+
+#include "net_ip/component/io_interface_delivery.hpp" // io_state_chg_data
+
+#include "utility/shared_buffer.hpp"
+
+namespace chops {
+namespace net {
+
+/**
+ *  @brief A queue of values awaited by a single coroutine, values can be pushed from
+ *  any thread.
+ *
+ *  @c co_await on @c next returns a @c std::optional, which is empty when the channel is
+ *  closed and all values have been consumed. If a value is available the coroutine is
+ *  not suspended. Otherwise it is resumed by the next @c push (or @c close), within
+ *  that call.
+ *
+ *  Copies of an @c awaitable_channel refer to the same queue, so a channel can be
+ *  captured by value in function objects passed to the library.
+ *
+ *  @note Only one coroutine can be waiting at a time. The consumer coroutine must not
+ *  be destroyed while it is waiting.
+ */
+template <typename T>
+class awaitable_channel {
+private:
+  struct state {
+    std::mutex              mutex;
+    std::deque<T>           values;
+    std::coroutine_handle<> waiter;
+    bool                    closed = false;
+  };
+
+  std::shared_ptr<state>    m_state;
+
+public:
+
+  class awaiter {
+  private:
+    state* m_st;
+
+  public:
+    explicit awaiter(state* st) noexcept : m_st(st) { }
+
+    bool await_ready() const {
+      std::lock_guard<std::mutex> lk(m_st->mutex);
+      return !m_st->values.empty() || m_st->closed;
+    }
+
+    // a value may have arrived since await_ready, in which case the coroutine continues
+    bool await_suspend(std::coroutine_handle<> h) {
+      std::lock_guard<std::mutex> lk(m_st->mutex);
+      if (!m_st->values.empty() || m_st->closed) {
+        return false;
+      }
+      m_st->waiter = h;
+      return true;
+    }
+
+    std::optional<T> await_resume() {
+      std::lock_guard<std::mutex> lk(m_st->mutex);
+      if (m_st->values.empty()) {
+        return std::optional<T> { };
+      }
+      std::optional<T> val { std::move(m_st->values.front()) };
+      m_st->values.pop_front();
+      return val;
+    }
+  };
+
+public:
+
+  awaitable_channel() : m_state(std::make_shared<state>()) { }
+
+/**
+ *  @brief Return an awaitable for the next value.
+ */
+  awaiter next() const noexcept { return awaiter(m_state.get()); }
+
+/**
+ *  @brief Add a value, resuming the waiting coroutine (if any) before returning.
+ *
+ *  @return @c false if the channel is closed, in which case the value is discarded.
+ */
+  template <typename... Args>
+  bool push(Args&&... args) {
+    std::coroutine_handle<> h;
+    {
+      std::lock_guard<std::mutex> lk(m_state->mutex);
+      if (m_state->closed) {
+        return false;
+      }
+      m_state->values.emplace_back(std::forward<Args>(args)...);
+      h = std::exchange(m_state->waiter, nullptr);
+    }
+    if (h) {
+      h.resume();
+    }
+    return true;
+  }
+
+/**
+ *  @brief Close the channel, the waiting coroutine (if any) is resumed once the
+ *  remaining values are consumed.
+ */
+  void close() {
+    std::coroutine_handle<> h;
+    {
+      std::lock_guard<std::mutex> lk(m_state->mutex);
+      m_state->closed = true;
+      h = std::exchange(m_state->waiter, nullptr);
+    }
+    if (h) {
+      h.resume();
+    }
+  }
+
+  bool is_closed() const {
+    std::lock_guard<std::mutex> lk(m_state->mutex);
+    return m_state->closed;
+  }
+
+  std::size_t size() const {
+    std::lock_guard<std::mutex> lk(m_state->mutex);
+    return m_state->values.size();
+  }
+};
+
+/**
+ *  @brief @c awaitable_channel that provides IO state change data.
+ */
+template <typename IOT>
+using io_state_chg_channel = awaitable_channel<io_state_chg_data<IOT> >;
+
+/**
+ *  @brief @c io_state_chg_channel for TCP IO handlers.
+ */
+using tcp_io_state_chg_channel = io_state_chg_channel<tcp_io>;
+/**
+ *  @brief @c io_state_chg_channel for UDP IO handlers.
+ */
+using udp_io_state_chg_channel = io_state_chg_channel<udp_io>;
+
+/**
+ *  @brief Start the entity with an IO state change function object that calls
+ *  @c start_io and also passes the IO state change data to an @c io_state_chg_channel.
+ *
+ *  This is the coroutine equivalent of @c start_with_wait_queue, and is appropriate for
+ *  all entity types, including a TCP acceptor. The channel is closed when the entity
+ *  is stopped, which means an empty @c std::optional to the awaiting coroutine once all
+ *  state changes are consumed (state changes delivered after the close are discarded).
+ *
+ *  @param entity A @c basic_net_entity object, @c start is immediately called.
+ *
+ *  @param io_start A function object which will invoke @c start_io on an
+ *  @c io_interface object.
+ *
+ *  @param ch An @c io_state_chg_channel which is used to pass the IO state change data.
+ *
+ *  @param err_func Error function object.
+ *
+ */
+template <typename IOT, typename ET, typename IOS, typename EF>
+void start_with_channel (basic_net_entity<ET> entity,
+                         IOS&& io_start,
+                         io_state_chg_channel<IOT> ch,
+                         EF&& err_func) {
+  entity.start( [ios = std::move(io_start), ch]
+                   (basic_io_interface<IOT> io, std::size_t num, bool starting) mutable {
+      if (starting) {
+        ios(io, num, starting);
+      }
+      ch.push(io, num, starting);
+    },
+    [ef = std::forward<EF>(err_func), ch] (basic_io_interface<IOT> io, std::error_code e) mutable {
+      ef(io, e);
+      if (e == std::make_error_code(net_ip_errc::tcp_acceptor_stopped) ||
+          e == std::make_error_code(net_ip_errc::tcp_connector_stopped) ||
+          e == std::make_error_code(net_ip_errc::udp_entity_stopped)) {
+        ch.close();
+      }
+    }
+  );
+}
+
+/**
+ *  @brief A message delivered through an @c io_msg_channel.
+ */
+template <typename IOT>
+struct io_msg {
+  chops::const_shared_buffer    buf;
+  basic_io_interface<IOT>       io;
+  typename IOT::endpoint_type   endp;
+
+  io_msg(chops::const_shared_buffer b, basic_io_interface<IOT> i,
+         const typename IOT::endpoint_type& e) :
+      buf(std::move(b)), io(std::move(i)), endp(e) { }
+};
+
+/**
+ *  @brief @c awaitable_channel that provides incoming messages.
+ */
+template <typename IOT>
+using io_msg_channel = awaitable_channel<io_msg<IOT> >;
+
+/**
+ *  @brief @c io_msg_channel for TCP IO handlers.
+ */
+using tcp_io_msg_channel = io_msg_channel<tcp_io>;
+/**
+ *  @brief @c io_msg_channel for UDP IO handlers.
+ */
+using udp_io_msg_channel = io_msg_channel<udp_io>;
+
+/**
+ *  @brief Create a message handler that passes each incoming message to an
+ *  @c io_msg_channel.
+ *
+ *  The message handler takes a shared buffer, so the read buffer is moved into the
+ *  message without a copy. Closing the channel shuts down the IO handler on the next
+ *  incoming message (the message handler returns @c false).
+ *
+ *  @note The channel is not closed when the IO handler stops, an application awaiting
+ *  messages typically also awaits IO state changes and closes the message channel when
+ *  the IO handler stops.
+ *
+ *  @param ch An @c io_msg_channel, which is copied into the message handler.
+ *
+ *  @return A function object that can be used as a message handler in the @c start_io
+ *  methods.
+ */
+template <typename IOT>
+auto make_channel_msg_hdlr(io_msg_channel<IOT> ch) {
+  return [ch] (chops::const_shared_buffer buf, basic_io_interface<IOT> io,
+               typename IOT::endpoint_type endp) mutable {
+    return ch.push(std::move(buf), std::move(io), endp);
+  };
+}
+
+/**
+ *  @brief Send gate, a coroutine awaiting a send is suspended while the output queue of
+ *  the IO handler is congested, and resumed when the queue drains to the low watermark.
+ *
+ *  The gate uses the queue event function object of @c set_output_queue_limits, which
+ *  is set by the @c set_limits method of the gate. Without limits (or with a high
+ *  watermark of 0) the output queue is never congested, and a send never suspends.
+ *
+ *  @note Only one coroutine can be waiting at a time. Closing the gate (typically when
+ *  the IO handler stops) resumes a waiting coroutine, and the send is not performed.
+ */
+template <typename IOT>
+class output_gate {
+private:
+  struct state {
+    std::mutex              mutex;
+    std::coroutine_handle<> waiter;
+    bool                    closed = false;
+  };
+
+  std::shared_ptr<state>    m_state;
+
+  static void resume_waiter(state& st, bool close) {
+    std::coroutine_handle<> h;
+    {
+      std::lock_guard<std::mutex> lk(st.mutex);
+      st.closed = st.closed || close;
+      h = std::exchange(st.waiter, nullptr);
+    }
+    if (h) {
+      h.resume();
+    }
+  }
+
+public:
+
+  class awaiter {
+  private:
+    std::shared_ptr<state>     m_st;
+    basic_io_interface<IOT>    m_io;
+    chops::const_shared_buffer m_buf;
+
+  public:
+    awaiter(std::shared_ptr<state> st, basic_io_interface<IOT> io, 
+            chops::const_shared_buffer buf) :
+        m_st(std::move(st)), m_io(std::move(io)), m_buf(std::move(buf)) { }
+
+    bool await_ready() const {
+      return is_closed() || !m_io.is_valid() || !m_io.is_output_congested();
+    }
+
+    // congestion is decided under the gate lock, which the low watermark event takes to
+    // resume the waiter, so the event is not missed; once the handle is published the
+    // coroutine may be resumed (and the awaiter destroyed) by another thread, so nothing
+    // of the awaiter is used afterwards
+    bool await_suspend(std::coroutine_handle<> h) {
+      std::lock_guard<std::mutex> lk(m_st->mutex);
+      if (m_st->closed || !m_io.is_valid() || !m_io.is_output_congested()) {
+        return false;
+      }
+      m_st->waiter = h;
+      return true;
+    }
+
+    // false if the gate is closed or the IO handler is gone, otherwise the buffer is queued
+    bool await_resume() {
+      if (is_closed() || !m_io.is_valid()) {
+        return false;
+      }
+      m_io.send(std::move(m_buf));
+      return true;
+    }
+
+  private:
+    bool is_closed() const {
+      std::lock_guard<std::mutex> lk(m_st->mutex);
+      return m_st->closed;
+    }
+  };
+
+public:
+
+  output_gate() : m_state(std::make_shared<state>()) { }
+
+/**
+ *  @brief Set the output queue limits of the IO handler, with a queue event function
+ *  object that opens the gate on the low watermark notification.
+ *
+ *  @param io IO interface of the IO handler.
+ *
+ *  @param lim Output queue limits, the watermarks are used for the gate.
+ *
+ *  @throw A @c net_ip_exception is thrown if there is not an associated IO handler.
+ */
+  void set_limits(basic_io_interface<IOT> io, const output_queue_limits& lim) const {
+    io.set_output_queue_limits(lim, [st = m_state] (basic_io_interface<IOT>, std::error_code e) {
+        if (e == std::make_error_code(net_ip_errc::output_queue_low_watermark)) {
+          resume_waiter(*st, false);
+        }
+      }
+    );
+  }
+
+/**
+ *  @brief Return an awaitable that sends the buffer once the output queue is not
+ *  congested; the @c co_await result is @c true if the buffer is queued, @c false if the
+ *  gate was closed or there is not an associated IO handler.
+ */
+  awaiter send(basic_io_interface<IOT> io, chops::const_shared_buffer buf) const {
+    return awaiter(m_state, std::move(io), std::move(buf));
+  }
+
+/**
+ *  @brief Close the gate, resuming a waiting coroutine.
+ */
+  void close() const { resume_waiter(*m_state, true); }
+};
+
+/**
+ *  @brief @c output_gate for TCP IO handlers.
+ */
+using tcp_output_gate = output_gate<tcp_io>;
+/**
+ *  @brief @c output_gate for UDP IO handlers.
+ */
+using udp_output_gate = output_gate<udp_io>;
+
+} // end net namespace
+} // end chops namespace
+
+#endif
+
+#endif
+
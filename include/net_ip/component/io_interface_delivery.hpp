@@ -27,7 +27,8 @@
  *  during the lifetime of the acceptor and futures are single use. For a TCP acceptor the state 
  *  change data is delivered through a @c wait_queue. Obviously a TCP connector or UDP entity 
  *  can also use the @c wait_queue delivery mechanism, which may be more appropriate than futures 
- *  for many use cases.
+ *  for many use cases. A bounded, lock-free @c ring_queue can be used instead of a @c wait_queue
+ *  when the IO threads must never block on the delivery.
  *
  *  @author Cliff Green
  *
@@ -51,6 +52,8 @@
 #include "net_ip/net_entity.hpp"
 #include "net_ip/io_interface.hpp"
 
+#include "net_ip/component/ring_queue.hpp"
+
 #include "queue/wait_queue.hpp"
 
 namespace chops {
@@ -115,6 +118,57 @@ void start_with_wait_queue (basic_net_entity<ET> entity,
   );
 }
 
+/**
+ *  @brief @c ring_queue declaration that provides IO state change data.
+ */
+template <typename IOT>
+using io_ring_q = ring_queue<io_state_chg_data<IOT> >;
+
+/**
+ *  @brief @c io_ring_q for @c tcp_io_interface objects.
+ */
+using tcp_io_ring_q = io_ring_q<chops::net::tcp_io>;
+/**
+ *  @brief @c io_ring_q for @c udp_io_interface objects.
+ */
+using udp_io_ring_q = io_ring_q<chops::net::udp_io>;
+
+/**
+ *  @brief Start the entity with an IO state change function object that
+ *  calls @c start_io and also passes @c io_interface data through a 
+ *  @c ring_queue.
+ *
+ *  This is the non-blocking equivalent of @c start_with_wait_queue. If the @c ring_queue
+ *  is full the state change data is dropped (and counted by the queue), @c start_io 
+ *  is still called; the queue capacity should cover the expected burst of connects
+ *  and disconnects.
+ *
+ *  @param entity A @c basic_net_entity object, @c start is immediately called.
+ *
+ *  @param io_start A function object which will invoke @c start_io on an 
+ *  @c io_interface object.
+ *
+ *  @param rq A @c ring_queue which is used to pass the IO state change data.
+ *
+ *  @param err_func Error function object.
+ *
+ */
+template <typename IOT, typename ET, typename IOS, typename EF>
+void start_with_ring_queue (basic_net_entity<ET> entity, 
+                            IOS&& io_start,
+                            io_ring_q<IOT>& rq, 
+                            EF&& err_func) {
+  entity.start( [ios = std::move(io_start), &rq]
+                   (basic_io_interface<IOT> io, std::size_t num, bool starting) mutable {
+      if (starting) {
+        ios(io, num, starting);
+      }
+      rq.try_emplace_push(io, num, starting);
+    },
+    std::forward<EF>(err_func)
+  );
+}
+
 /**
  *  @brief An alias for a @c std::future containing an @c basic_io_interface.
  */
@@ -0,0 +1,191 @@
+/** @file
+ *
+ *  @ingroup net_ip_component_module
+ *
+ *  @brief Message frame function objects for variable length messages where the header
+ *  decoding is resolved at compile time.
+ *
+ *  The @c make_simple_variable_len_msg_frame function calls the header decoder through a
+ *  function pointer for every message. The message frames in this file are class
+ *  templates, so the TCP IO handler (which stores the message frame by type) inlines
+ *  the header decoding into its read processing.
+ *
+ *  A @c length_field describes the common case, an unsigned length field at a byte
+ *  offset in a fixed size header, with a width of 1 to 8 bytes, big or little endian,
+ *  and optionally counting the header bytes in the length. For example, a 2 byte big
+ *  endian length:
+ *
+ *  @code
+ *    io.start_io(2, msg_hdlr, chops::net::make_length_field_msg_frame<0, 2>());
+ *  @endcode
+ *
+ *  A type and length header (e.g. TLV, a 1 byte type followed by a 4 byte little endian
+ *  length):
+ *
+ *  @code
+ *    using tlv_hdr = chops::net::length_field<1, 4, chops::net::byte_order::little>;
+ *    io.start_io(tlv_hdr::hdr_size, msg_hdlr, chops::net::make_length_field_msg_frame<tlv_hdr>());
+ *  @endcode
+ *
+ *  Multi-stage headers (e.g. a fixed prefix followed by an extended length whose size
+ *  depends on the prefix) are handled by a @c staged_msg_frame, where each stage decodes
+ *  one part of the header and returns the size of the next part; the last stage returns
+ *  the body size. A stage is any type with an
+ *  @c std::size_t @c operator()(const std::byte*, std::size_t) member, and the stage
+ *  dispatch is also resolved at compile time.
+ *
+ *  A body size of 0 (any stage returning 0) ends the message at the end of the header.
+ *
+ *  @note These functions are not a necessary dependency of the @c net_ip library,
+ *  but are useful components in many use cases.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef LENGTH_FIELD_MSG_FRAME_HPP_INCLUDED
+#define LENGTH_FIELD_MSG_FRAME_HPP_INCLUDED
+
+#include <cstddef> // std::size_t, std::byte
+#include <cstdint> // std::uint64_t
+#include <tuple>
+#include <utility> // std::index_sequence, std::move
+
+#include <experimental/buffer>
+
+namespace chops {
+namespace net {
+
+enum class byte_order { big, little };
+
+/**
+ *  @brief Decode an unsigned integer of @c Width bytes (1 to 8) in the given byte order.
+ *
+ *  The bytes are assembled individually, so there are no alignment requirements and the
+ *  result does not depend on the native byte order.
+ */
+template <std::size_t Width, byte_order Order = byte_order::big>
+constexpr std::uint64_t decode_uint(const std::byte* p) noexcept {
+  static_assert(Width >= 1u && Width <= 8u, "Width must be 1 to 8 bytes");
+  std::uint64_t val = 0u;
+  for (std::size_t i = 0u; i < Width; ++i) {
+    auto b = static_cast<std::uint64_t>(p[Order == byte_order::big ? i : (Width - 1u - i)]);
+    val = (val << 8u) | b;
+  }
+  return val;
+}
+
+/**
+ *  @brief Header decoder for an unsigned length field in a fixed size header.
+ *
+ *  @tparam Offset Byte offset of the length field in the header.
+ *
+ *  @tparam Width Width of the length field in bytes, 1 to 8.
+ *
+ *  @tparam Order Byte order of the length field.
+ *
+ *  @tparam IncludesHdr The length counts the header bytes as well as the body; a length
+ *  smaller than the header is a body size of 0.
+ *
+ *  @tparam HdrSize Total header size, by default the end of the length field.
+ */
+template <std::size_t Offset, std::size_t Width, byte_order Order = byte_order::big,
+          bool IncludesHdr = false, std::size_t HdrSize = Offset + Width>
+struct length_field {
+  static_assert(Offset + Width <= HdrSize, "length field must be within the header");
+
+  static constexpr std::size_t hdr_size = HdrSize;
+
+  constexpr std::size_t operator()(const std::byte* p, std::size_t) const noexcept {
+    auto len = static_cast<std::size_t>(decode_uint<Width, Order>(p + Offset));
+    if constexpr (IncludesHdr) {
+      return len > HdrSize ? len - HdrSize : 0u;
+    }
+    else {
+      return len;
+    }
+  }
+};
+
+/**
+ *  @brief Message frame function object with one or more header stages.
+ *
+ *  The first stage is called with the header (of the size given to @c start_io), each
+ *  following stage with the number of bytes returned by the previous stage, and the
+ *  message is complete after the body (the size returned by the last stage) has been
+ *  read.
+ */
+template <typename... Stages>
+class staged_msg_frame {
+private:
+  static_assert(sizeof...(Stages) >= 1u, "at least one header stage is needed");
+
+  static constexpr std::size_t body_stage = sizeof...(Stages);
+
+  std::tuple<Stages...> m_stages;
+  std::size_t           m_next;
+
+  template <std::size_t... Is>
+  std::size_t call_stage(const std::byte* p, std::size_t sz, std::index_sequence<Is...>) {
+    std::size_t ret = 0u;
+    ((m_next == Is ? (ret = std::get<Is>(m_stages)(p, sz), true) : false) || ...);
+    return ret;
+  }
+
+public:
+  staged_msg_frame() : m_stages(), m_next(0u) { }
+
+  explicit staged_msg_frame(Stages... stages) : m_stages(std::move(stages)...), m_next(0u) { }
+
+  std::size_t operator()(std::experimental::net::mutable_buffer buf) {
+    if (m_next == body_stage) {
+      m_next = 0u;
+      return 0u;
+    }
+    std::size_t ret = call_stage(static_cast<const std::byte*>(buf.data()), buf.size(),
+                                 std::index_sequence_for<Stages...>());
+    m_next = (ret == 0u) ? 0u : m_next + 1u;
+    return ret;
+  }
+};
+
+/**
+ *  @brief Create a message frame function object for a header described by a
+ *  @c length_field (or any other default constructible header decoder type).
+ */
+template <typename Decoder>
+staged_msg_frame<Decoder> make_length_field_msg_frame() {
+  return staged_msg_frame<Decoder>();
+}
+
+/**
+ *  @brief Create a message frame function object for a header with a length field,
+ *  see @c length_field for the template parameters.
+ */
+template <std::size_t Offset, std::size_t Width, byte_order Order = byte_order::big,
+          bool IncludesHdr = false, std::size_t HdrSize = Offset + Width>
+staged_msg_frame<length_field<Offset, Width, Order, IncludesHdr, HdrSize> >
+                                make_length_field_msg_frame() {
+  return staged_msg_frame<length_field<Offset, Width, Order, IncludesHdr, HdrSize> >();
+}
+
+/**
+ *  @brief Create a message frame function object for a multi-stage header.
+ *
+ *  @param stages Header stage decoders, in header order.
+ */
+template <typename... Stages>
+staged_msg_frame<Stages...> make_staged_msg_frame(Stages... stages) {
+  return staged_msg_frame<Stages...>(std::move(stages)...);
+}
+
+} // end net namespace
+} // end chops namespace
+
+#endif
+
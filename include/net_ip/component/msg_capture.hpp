@@ -0,0 +1,545 @@
+/** @file
+ *
+ *  @ingroup net_ip_component_module
+ *
+ *  @brief Capture of the messages delivered to message handlers into a memory mapped,
+ *  append-only file, and replay of a capture file at original, scaled or maximum speed.
+ *
+ *  A @c capture_writer maps a preallocated file; a message handler created with
+ *  @c make_capture_msg_hdlr appends each message (with a timestamp and the remote
+ *  endpoint) before calling the application message handler. Appending reserves space
+ *  with one atomic compare and exchange and copies the message into the mapping, without
+ *  a lock, a system call or an allocation, so any number of IO handlers (on any threads)
+ *  can share one writer. When the file is full further messages are counted as dropped.
+ *
+ *  A @c capture_reader maps a capture file read-only and iterates the records, and a
+ *  @c capture_replayer calls a function object with each record from an @c io_context,
+ *  paced by the recorded timestamps. The function object can drive the same message
+ *  handler (see @c make_replay_msg_hdlr_func) or resend the message, e.g. through a
+ *  @c basic_io_interface @c send to a target endpoint.
+ *
+ *  File layout: a @c capture_file_header, then records, each a @c capture_record_header
+ *  followed by the message bytes, padded to 8 bytes. The size of a record is stored last,
+ *  so a file that was not closed (e.g. after a crash) is readable up to the last complete
+ *  record.
+ *
+ *  @note These classes use POSIX @c mmap and are not a necessary dependency of the
+ *  @c net_ip library, but are useful components in many use cases.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef MSG_CAPTURE_HPP_INCLUDED
+#define MSG_CAPTURE_HPP_INCLUDED
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstddef> // std::size_t, std::byte
+#include <cstdint> // std::uint64_t, std::uint32_t, std::uint16_t, std::uint8_t
+#include <cstring> // std::memcpy, std::memcmp
+#include <cerrno>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <memory> // std::shared_ptr, std::enable_shared_from_this
+#include <functional> // std::function
+#include <system_error>
+#include <utility> // std::move
+
+#include <experimental/buffer>
+#include <experimental/internet>
+#include <experimental/io_context>
+#include <experimental/executor>
+#include <experimental/timer>
+
+#include "net_ip/basic_io_interface.hpp"
+
+namespace chops {
+namespace net {
+
+struct capture_file_header {
+  char          magic[8];       // "CHOPSCAP"
+  std::uint32_t version;
+  std::uint32_t hdr_size;       // size of this header, records start after it
+  std::uint64_t start_time_ns;  // system clock, nanoseconds since the epoch
+  std::uint64_t end_offset;     // set when the writer is closed, 0 while writing
+};
+
+struct capture_record_header {
+  std::uint32_t stored_size;    // message size plus one, written last, 0 if incomplete
+  std::uint16_t port;
+  std::uint8_t  family;         // 4 or 6, 0 if no endpoint
+  std::uint8_t  reserved;
+  std::uint64_t timestamp_ns;   // steady clock, from the start of the capture
+  std::uint8_t  addr[16];
+};
+
+inline constexpr char capture_magic[8] { 'C', 'H', 'O', 'P', 'S', 'C', 'A', 'P' };
+inline constexpr std::uint32_t capture_version = 1u;
+
+namespace detail {
+
+constexpr std::size_t capture_align(std::size_t sz) noexcept { return (sz + 7u) & ~std::size_t(7u); }
+
+[[noreturn]] inline void throw_capture_errno() {
+  throw std::system_error(errno, std::system_category());
+}
+
+} // end detail namespace
+
+/**
+ *  @brief Append-only writer of a memory mapped capture file, thread-safe for concurrent
+ *  appends.
+ */
+class capture_writer {
+private:
+  using clock_type = std::chrono::steady_clock;
+
+  int                        m_fd;
+  std::byte*                 m_base;
+  std::size_t                m_capacity;
+  clock_type::time_point     m_start;
+  std::atomic<std::uint64_t> m_next;
+  std::atomic<std::uint64_t> m_num_records;
+  std::atomic<std::uint64_t> m_num_dropped;
+
+public:
+
+/**
+ *  @brief Create (or truncate) and map a capture file.
+ *
+ *  @param path Capture file path.
+ *
+ *  @param capacity Maximum file size in bytes, allocated up front; the file is truncated
+ *  to the used size by @c close.
+ *
+ *  @throw @c std::system_error if the file cannot be created or mapped.
+ */
+  capture_writer(const std::string& path, std::size_t capacity) :
+      m_fd(-1), m_base(nullptr), m_capacity(capacity), m_start(clock_type::now()),
+      m_next(sizeof(capture_file_header)), m_num_records(0u), m_num_dropped(0u) {
+    if (m_capacity < sizeof(capture_file_header)) {
+      m_capacity = sizeof(capture_file_header);
+    }
+    m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (m_fd < 0) {
+      detail::throw_capture_errno();
+    }
+    if (::ftruncate(m_fd, static_cast<off_t>(m_capacity)) != 0) {
+      int e = errno;
+      ::close(m_fd);
+      throw std::system_error(e, std::system_category());
+    }
+    void* p = ::mmap(nullptr, m_capacity, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (p == MAP_FAILED) {
+      int e = errno;
+      ::close(m_fd);
+      throw std::system_error(e, std::system_category());
+    }
+    m_base = static_cast<std::byte*>(p);
+    capture_file_header hdr { };
+    std::memcpy(hdr.magic, capture_magic, sizeof(hdr.magic));
+    hdr.version = capture_version;
+    hdr.hdr_size = sizeof(capture_file_header);
+    hdr.start_time_ns = static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+    hdr.end_offset = 0u;
+    std::memcpy(m_base, &hdr, sizeof(hdr));
+  }
+
+  ~capture_writer() { close(); }
+
+private:
+  capture_writer(const capture_writer&) = delete;
+  capture_writer& operator=(const capture_writer&) = delete;
+
+public:
+
+/**
+ *  @brief Append a message, with the remote endpoint.
+ *
+ *  @return @c false if the file is full (or closed), the message is counted as dropped.
+ */
+  template <typename Endpoint>
+  bool append(const void* data, std::size_t sz, const Endpoint& endp) noexcept {
+    capture_record_header rec { };
+    auto addr = endp.address();
+    if (addr.is_v4()) {
+      auto b = addr.to_v4().to_bytes();
+      rec.family = 4u;
+      std::memcpy(rec.addr, b.data(), b.size());
+    }
+    else {
+      auto b = addr.to_v6().to_bytes();
+      rec.family = 6u;
+      std::memcpy(rec.addr, b.data(), b.size());
+    }
+    rec.port = endp.port();
+    return append_record(rec, data, sz);
+  }
+
+  bool append(const void* data, std::size_t sz) noexcept {
+    capture_record_header rec { };
+    return append_record(rec, data, sz);
+  }
+
+/**
+ *  @brief Store the used size in the file header, truncate the file to it and unmap.
+ *
+ *  Appends must not be in progress; later appends are dropped.
+ */
+  void close() noexcept {
+    if (!m_base) {
+      return;
+    }
+    // no further reservations can succeed once the offset is past the capacity
+    std::uint64_t end = m_next.exchange(m_capacity + 1u);
+    if (end > m_capacity) {
+      end = m_capacity;
+    }
+    reinterpret_cast<capture_file_header*>(m_base)->end_offset = end;
+    ::munmap(m_base, m_capacity);
+    m_base = nullptr;
+    (void) ::ftruncate(m_fd, static_cast<off_t>(end));
+    ::close(m_fd);
+    m_fd = -1;
+  }
+
+  std::size_t num_records() const noexcept { return m_num_records.load(); }
+
+  std::size_t num_dropped() const noexcept { return m_num_dropped.load(); }
+
+  std::size_t bytes_used() const noexcept {
+    auto n = m_next.load();
+    return n > m_capacity ? m_capacity : n;
+  }
+
+private:
+
+  bool append_record(capture_record_header& rec, const void* data, std::size_t sz) noexcept {
+    auto total = detail::capture_align(sizeof(capture_record_header) + sz);
+    std::uint64_t off = m_next.load(std::memory_order_relaxed);
+    do {
+      if (sz >= 0xFFFFFFFFu || off + total > m_capacity) {
+        m_num_dropped.fetch_add(1u, std::memory_order_relaxed);
+        return false;
+      }
+    } while (!m_next.compare_exchange_weak(off, off + total, std::memory_order_relaxed));
+    rec.timestamp_ns = static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - m_start).count());
+    auto* p = m_base + off;
+    std::memcpy(p + sizeof(capture_record_header), data, sz);
+    std::uint32_t stored = static_cast<std::uint32_t>(sz + 1u);
+    rec.stored_size = 0u;
+    std::memcpy(p, &rec, sizeof(rec));
+    // the size is published last, after the record contents
+    reinterpret_cast<std::atomic<std::uint32_t>*>(p)->store(stored, std::memory_order_release);
+    m_num_records.fetch_add(1u, std::memory_order_relaxed);
+    return true;
+  }
+
+};
+
+using capture_writer_ptr = std::shared_ptr<capture_writer>;
+
+/**
+ *  @brief Create a message handler that appends each message to a capture file, then
+ *  calls the application message handler.
+ *
+ *  @param cap Capture writer, shared by any number of message handlers.
+ *
+ *  @param msg_hdlr Application message handler, taking a @c const_buffer, a
+ *  @c basic_io_interface and an endpoint, as in @c start_io.
+ */
+template <typename IOT, typename MH>
+auto make_capture_msg_hdlr(capture_writer_ptr cap, MH&& msg_hdlr) {
+  return [cap = std::move(cap), mh = std::forward<MH>(msg_hdlr)]
+      (std::experimental::net::const_buffer buf, basic_io_interface<IOT> io,
+       typename IOT::endpoint_type endp) mutable -> bool {
+    cap->append(buf.data(), buf.size(), endp);
+    return mh(buf, io, endp);
+  };
+}
+
+/**
+ *  @brief A record read from a capture file; the data refers into the file mapping.
+ */
+struct capture_record {
+  std::chrono::nanoseconds             timestamp { };
+  std::experimental::net::const_buffer data;
+  std::uint16_t                        port = 0u;
+  std::uint8_t                         family = 0u;
+  std::uint8_t                         addr[16] { };
+
+  template <typename Protocol>
+  typename Protocol::endpoint get_endpoint() const {
+    using namespace std::experimental::net;
+    if (family == 4u) {
+      ip::address_v4::bytes_type b;
+      std::memcpy(b.data(), addr, b.size());
+      return typename Protocol::endpoint(ip::make_address_v4(b), port);
+    }
+    if (family == 6u) {
+      ip::address_v6::bytes_type b;
+      std::memcpy(b.data(), addr, b.size());
+      return typename Protocol::endpoint(ip::make_address_v6(b), port);
+    }
+    return typename Protocol::endpoint();
+  }
+};
+
+/**
+ *  @brief Read-only memory mapped view of a capture file.
+ */
+class capture_reader {
+private:
+  const std::byte* m_base;
+  std::size_t      m_size;
+  std::size_t      m_end;
+  std::size_t      m_pos;
+  std::size_t      m_first;
+  std::uint64_t    m_start_time_ns;
+
+public:
+
+/**
+ *  @brief Map a capture file.
+ *
+ *  @throw @c std::system_error if the file cannot be opened or mapped, or is not a
+ *  capture file (@c std::errc::invalid_argument).
+ */
+  explicit capture_reader(const std::string& path) :
+      m_base(nullptr), m_size(0u), m_end(0u), m_pos(0u), m_first(0u), m_start_time_ns(0u) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      detail::throw_capture_errno();
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+      int e = errno;
+      ::close(fd);
+      throw std::system_error(e, std::system_category());
+    }
+    m_size = static_cast<std::size_t>(st.st_size);
+    if (m_size < sizeof(capture_file_header)) {
+      ::close(fd);
+      throw std::system_error(std::make_error_code(std::errc::invalid_argument));
+    }
+    void* p = ::mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    int e = errno;
+    ::close(fd);
+    if (p == MAP_FAILED) {
+      throw std::system_error(e, std::system_category());
+    }
+    m_base = static_cast<const std::byte*>(p);
+    capture_file_header hdr;
+    std::memcpy(&hdr, m_base, sizeof(hdr));
+    if (std::memcmp(hdr.magic, capture_magic, sizeof(hdr.magic)) != 0 ||
+        hdr.version != capture_version || hdr.hdr_size < sizeof(capture_file_header) ||
+        hdr.hdr_size > m_size) {
+      ::munmap(const_cast<std::byte*>(m_base), m_size);
+      throw std::system_error(std::make_error_code(std::errc::invalid_argument));
+    }
+    // 0 if the writer was not closed, records are then read up to the first incomplete one
+    m_end = (hdr.end_offset == 0u || hdr.end_offset > m_size) ? m_size :
+                                                               static_cast<std::size_t>(hdr.end_offset);
+    m_first = hdr.hdr_size;
+    m_pos = m_first;
+    m_start_time_ns = hdr.start_time_ns;
+  }
+
+  ~capture_reader() {
+    if (m_base) {
+      ::munmap(const_cast<std::byte*>(m_base), m_size);
+    }
+  }
+
+private:
+  capture_reader(const capture_reader&) = delete;
+  capture_reader& operator=(const capture_reader&) = delete;
+
+public:
+
+  std::chrono::system_clock::time_point start_time() const noexcept {
+    return std::chrono::system_clock::time_point(
+      std::chrono::duration_cast<std::chrono::system_clock::duration>(
+        std::chrono::nanoseconds(m_start_time_ns)));
+  }
+
+/**
+ *  @brief Read the next record.
+ *
+ *  @return @c false at the end of the records.
+ */
+  bool next(capture_record& rec) noexcept {
+    if (m_pos + sizeof(capture_record_header) > m_end) {
+      return false;
+    }
+    capture_record_header hdr;
+    std::memcpy(&hdr, m_base + m_pos, sizeof(hdr));
+    if (hdr.stored_size == 0u) {
+      return false;
+    }
+    std::size_t sz = hdr.stored_size - 1u;
+    auto total = detail::capture_align(sizeof(capture_record_header) + sz);
+    if (m_pos + sizeof(capture_record_header) + sz > m_end) {
+      return false;
+    }
+    rec.timestamp = std::chrono::nanoseconds(hdr.timestamp_ns);
+    rec.data = std::experimental::net::const_buffer(m_base + m_pos + sizeof(capture_record_header), sz);
+    rec.port = hdr.port;
+    rec.family = hdr.family;
+    std::memcpy(rec.addr, hdr.addr, sizeof(rec.addr));
+    m_pos += total;
+    return true;
+  }
+
+  // back to the first record
+  void rewind() noexcept { m_pos = m_first; }
+
+};
+
+using capture_reader_ptr = std::shared_ptr<capture_reader>;
+
+/**
+ *  @brief Replays the records of a capture file, calling a function object with each
+ *  record from an @c io_context.
+ *
+ *  With a speed of 1.0 records are replayed at their original spacing, with a speed of
+ *  2.0 twice as fast, and with a speed of 0 (or less) as fast as possible, posting to the
+ *  @c io_context after each batch of records so other handlers are not starved. The
+ *  record function object returns @c false to stop the replay.
+ */
+class capture_replayer : public std::enable_shared_from_this<capture_replayer> {
+public:
+  using record_func = std::function<bool (const capture_record&)>;
+  // called with the number of records replayed
+  using done_func = std::function<void (std::size_t)>;
+
+  static constexpr std::size_t max_speed_batch = 64u;
+
+private:
+  using clock_type = std::chrono::steady_clock;
+
+  std::experimental::net::io_context&  m_ioc;
+  capture_reader_ptr                   m_reader;
+  double                               m_speed;
+  std::experimental::net::steady_timer m_timer;
+  record_func                          m_func;
+  done_func                            m_done;
+  capture_record                       m_rec;
+  bool                                 m_have_rec;
+  clock_type::time_point               m_start;
+  std::chrono::nanoseconds             m_first_ts;
+  std::size_t                          m_count;
+  std::atomic<bool>                    m_stopped;
+
+public:
+  capture_replayer(std::experimental::net::io_context& ioc, capture_reader_ptr reader,
+                   double speed = 1.0) :
+    m_ioc(ioc), m_reader(std::move(reader)), m_speed(speed), m_timer(ioc), m_func(),
+    m_done(), m_rec(), m_have_rec(false), m_start(), m_first_ts(), m_count(0u),
+    m_stopped(false) { }
+
+private:
+  capture_replayer(const capture_replayer&) = delete;
+  capture_replayer& operator=(const capture_replayer&) = delete;
+
+public:
+
+/**
+ *  @brief Start replaying from the current position of the reader.
+ *
+ *  @param func Function object called with each record.
+ *
+ *  @param done Function object called when the replay ends or is stopped.
+ */
+  void start(record_func func, done_func done = done_func()) {
+    m_func = std::move(func);
+    m_done = std::move(done);
+    auto self = shared_from_this();
+    std::experimental::net::post(m_ioc, [this, self] {
+        m_have_rec = m_reader->next(m_rec);
+        m_start = clock_type::now();
+        m_first_ts = m_have_rec ? m_rec.timestamp : std::chrono::nanoseconds();
+        replay_next();
+      }
+    );
+  }
+
+  // the done function object is still called
+  void stop() {
+    m_stopped = true;
+    auto self = shared_from_this();
+    std::experimental::net::post(m_ioc, [this, self] { m_timer.cancel(); } );
+  }
+
+  std::size_t num_replayed() const noexcept { return m_count; }
+
+private:
+
+  void replay_next() {
+    std::size_t batch = 0u;
+    while (m_have_rec && !m_stopped) {
+      if (m_speed > 0.0) {
+        auto due = m_start + std::chrono::duration_cast<clock_type::duration>(
+                     (m_rec.timestamp - m_first_ts) / m_speed);
+        if (due > clock_type::now()) {
+          m_timer.expires_at(due);
+          auto self = shared_from_this();
+          m_timer.async_wait([this, self] (const std::error_code&) { replay_next(); } );
+          return;
+        }
+      }
+      else if (batch == max_speed_batch) {
+        auto self = shared_from_this();
+        std::experimental::net::post(m_ioc, [this, self] { replay_next(); } );
+        return;
+      }
+      ++batch;
+      ++m_count;
+      if (!m_func(m_rec)) {
+        break;
+      }
+      m_have_rec = m_reader->next(m_rec);
+    }
+    m_have_rec = false;
+    if (m_done) {
+      auto done = std::move(m_done);
+      m_done = done_func();
+      done(m_count);
+    }
+  }
+
+};
+
+using capture_replayer_ptr = std::shared_ptr<capture_replayer>;
+
+/**
+ *  @brief Create a replay record function object that calls a message handler, with a
+ *  (possibly empty) @c basic_io_interface and the recorded remote endpoint.
+ */
+template <typename IOT, typename MH>
+auto make_replay_msg_hdlr_func(MH&& msg_hdlr,
+                               basic_io_interface<IOT> io = basic_io_interface<IOT>()) {
+  using protocol_type = typename IOT::endpoint_type::protocol_type;
+  return [mh = std::forward<MH>(msg_hdlr), io] (const capture_record& rec) mutable -> bool {
+    return mh(rec.data, io, rec.get_endpoint<protocol_type>());
+  };
+}
+
+} // end net namespace
+} // end chops namespace
+
+#endif
+
@@ -0,0 +1,420 @@
+/** @file
+ *
+ *  @ingroup net_ip_component_module
+ *
+ *  @brief Optional per-message compression for TCP connections, negotiated when IO is
+ *  started.
+ *
+ *  Each application message is carried in a small compression envelope: a one byte
+ *  message type and a four byte (big endian) envelope body length, where a compressed
+ *  body starts with the four byte original message length. Messages smaller than the
+ *  configured minimum size, or that do not shrink, are sent uncompressed, so the only
+ *  per-message cost for small messages is the envelope header.
+ *
+ *  The @c make_compression_io_state_change function creates an IO state change function
+ *  object which starts IO with the envelope message frame (bounded by the maximum message
+ *  size) and a message handler that decompresses before calling the application message
+ *  handler, then sends a hello message with the local codec id. A side only compresses
+ *  after the hello from the other side names the same codec, so each side can have
+ *  compression enabled or not (and messages sent before the hello arrives are simply
+ *  uncompressed). The application sends through the @c msg_compressor passed to its IO
+ *  state change function object.
+ *
+ *  Each connection has its own codec object, created when IO is started, holding the
+ *  compression contexts and the work buffers, so nothing is allocated per message beyond
+ *  the reference counted buffer of each send.
+ *
+ *  A codec class provides an @c id, @c max_compressed_size, @c compress and
+ *  @c decompress (see @c lz4_codec and @c zstd_codec); @c compress and @c decompress
+ *  may be called concurrently, but each only from one thread at a time. The LZ4 codec
+ *  is available when @c CHOPS_NET_LZ4 is defined (link with @c liblz4), the Zstandard
+ *  codec when @c CHOPS_NET_ZSTD is defined (link with @c libzstd).
+ *
+ *  @note These functions are not a necessary dependency of the @c net_ip library,
+ *  but are useful components in many use cases.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef MSG_COMPRESSION_HPP_INCLUDED
+#define MSG_COMPRESSION_HPP_INCLUDED
+
+#include <cstddef> // std::size_t, std::byte
+#include <cstdint> // std::uint8_t, std::uint32_t
+#include <cstring> // std::memcpy
+#include <memory> // std::shared_ptr, std::unique_ptr
+#include <new> // std::bad_alloc
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <utility> // std::move
+
+#include <experimental/buffer>
+
+#ifdef CHOPS_NET_LZ4
+#include <lz4.h>
+#endif
+
+#ifdef CHOPS_NET_ZSTD
+#include <zstd.h>
+#endif
+
+#include "net_ip/basic_io_interface.hpp"
+#include "net_ip/io_interface.hpp"
+#include "net_ip/send_priority.hpp"
+#include "net_ip/net_ip_error.hpp"
+
+#include "utility/shared_buffer.hpp"
+
+namespace chops {
+namespace net {
+
+/**
+ *  @brief Compression envelope message types, the first byte of the envelope header.
+ */
+enum class compression_msg_type : std::uint8_t { plain = 0, compressed = 1, hello = 2 };
+
+inline constexpr std::size_t compression_hdr_size = 5u;
+
+/**
+ *  @brief Options for @c make_compression_io_state_change.
+ *
+ *  Messages smaller than @c min_size are sent uncompressed. A received envelope with a
+ *  body length, or a compressed message with an original length, greater than
+ *  @c max_msg_size is treated as a protocol error and the connection is failed, which
+ *  bounds both the read buffer and the work buffer.
+ */
+struct compression_options {
+  std::size_t min_size = 256u;
+  std::size_t max_msg_size = 16u * 1024u * 1024u;
+};
+
+/**
+ *  @brief Decode the compression envelope header, returning the envelope body length.
+ */
+inline std::size_t decode_compression_hdr(const std::byte* ptr, std::size_t sz) {
+  if (sz < compression_hdr_size) {
+    return 0u;
+  }
+  return (static_cast<std::size_t>(ptr[1]) << 24) | (static_cast<std::size_t>(ptr[2]) << 16) |
+         (static_cast<std::size_t>(ptr[3]) << 8) | static_cast<std::size_t>(ptr[4]);
+}
+
+/**
+ *  @brief Create the message frame for the compression envelope, bounding the envelope
+ *  body length.
+ *
+ *  A header with a body length greater than @c max_body_sz ends the message at the
+ *  header, so the next read is never sized from an unchecked length field. The
+ *  decompressing message handler then finds the body missing and returns @c false, which
+ *  fails the connection.
+ *
+ *  @param max_body_sz Maximum envelope body length, in bytes.
+ *
+ *  @return A function object that can be used with the @c start_io method.
+ */
+inline auto make_compression_msg_frame(std::size_t max_body_sz) {
+  bool hdr_processed = false;
+  return [hdr_processed, max_body_sz]
+      (std::experimental::net::mutable_buffer buf) mutable -> std::size_t {
+    if (hdr_processed) {
+      hdr_processed = false;
+      return 0u;
+    }
+    auto body_sz = decode_compression_hdr(static_cast<const std::byte*>(buf.data()), buf.size());
+    if (body_sz > max_body_sz) {
+      return 0u;
+    }
+    hdr_processed = (body_sz != 0u);
+    return body_sz;
+  };
+}
+
+namespace detail {
+
+inline void put_be32(std::byte* ptr, std::size_t val) noexcept {
+  ptr[0] = static_cast<std::byte>((val >> 24) & 0xFFu);
+  ptr[1] = static_cast<std::byte>((val >> 16) & 0xFFu);
+  ptr[2] = static_cast<std::byte>((val >> 8) & 0xFFu);
+  ptr[3] = static_cast<std::byte>(val & 0xFFu);
+}
+
+inline std::size_t get_be32(const std::byte* ptr) noexcept {
+  return (static_cast<std::size_t>(ptr[0]) << 24) | (static_cast<std::size_t>(ptr[1]) << 16) |
+         (static_cast<std::size_t>(ptr[2]) << 8) | static_cast<std::size_t>(ptr[3]);
+}
+
+inline void put_compression_hdr(std::byte* ptr, compression_msg_type t, std::size_t body_sz) noexcept {
+  ptr[0] = static_cast<std::byte>(t);
+  put_be32(ptr + 1, body_sz);
+}
+
+// per connection state, the send side is used from any thread (serialized by the mutex)
+// and the receive side only from the message handler, within the IO handler
+template <typename Codec>
+class compression_state {
+public:
+  compression_options     m_opts;
+  Codec                   m_codec;
+  std::atomic<bool>       m_peer_accepts;
+  std::mutex              m_send_mutex;
+  std::vector<std::byte>  m_send_buf;
+  std::vector<std::byte>  m_recv_buf;
+
+  explicit compression_state(const compression_options& opts) :
+    m_opts(opts), m_codec(), m_peer_accepts(false), m_send_mutex(), m_send_buf(),
+    m_recv_buf() { }
+};
+
+} // end detail namespace
+
+#ifdef CHOPS_NET_LZ4
+/**
+ *  @brief LZ4 block compression, keeping one compression state per connection.
+ */
+class lz4_codec {
+private:
+  std::vector<char> m_state;
+
+public:
+  static constexpr std::uint8_t id = 1u;
+
+  lz4_codec() : m_state(static_cast<std::size_t>(LZ4_sizeofState())) { }
+
+  std::size_t max_compressed_size(std::size_t sz) const noexcept {
+    return static_cast<std::size_t>(LZ4_compressBound(static_cast<int>(sz)));
+  }
+
+  // returns 0 if the output does not fit
+  std::size_t compress(const std::byte* src, std::size_t sz, std::byte* dst, std::size_t cap) {
+    int r = LZ4_compress_fast_extState(m_state.data(), reinterpret_cast<const char*>(src),
+                                       reinterpret_cast<char*>(dst), static_cast<int>(sz),
+                                       static_cast<int>(cap), 1);
+    return r > 0 ? static_cast<std::size_t>(r) : 0u;
+  }
+
+  bool decompress(const std::byte* src, std::size_t sz, std::byte* dst, std::size_t orig_sz) {
+    int r = LZ4_decompress_safe(reinterpret_cast<const char*>(src), reinterpret_cast<char*>(dst),
+                                static_cast<int>(sz), static_cast<int>(orig_sz));
+    return r >= 0 && static_cast<std::size_t>(r) == orig_sz;
+  }
+};
+#endif
+
+#ifdef CHOPS_NET_ZSTD
+/**
+ *  @brief Zstandard compression, keeping one compression and one decompression context
+ *  per connection.
+ */
+class zstd_codec {
+private:
+  struct cctx_deleter {
+    void operator()(ZSTD_CCtx* p) const noexcept { ZSTD_freeCCtx(p); }
+  };
+  struct dctx_deleter {
+    void operator()(ZSTD_DCtx* p) const noexcept { ZSTD_freeDCtx(p); }
+  };
+
+  std::unique_ptr<ZSTD_CCtx, cctx_deleter> m_cctx;
+  std::unique_ptr<ZSTD_DCtx, dctx_deleter> m_dctx;
+  int                                      m_level;
+
+public:
+  static constexpr std::uint8_t id = 2u;
+
+  explicit zstd_codec(int level = 1) : m_cctx(ZSTD_createCCtx()), m_dctx(ZSTD_createDCtx()),
+      m_level(level) {
+    if (!m_cctx || !m_dctx) {
+      throw std::bad_alloc();
+    }
+  }
+
+  std::size_t max_compressed_size(std::size_t sz) const noexcept {
+    return ZSTD_compressBound(sz);
+  }
+
+  // returns 0 if the output does not fit
+  std::size_t compress(const std::byte* src, std::size_t sz, std::byte* dst, std::size_t cap) {
+    auto r = ZSTD_compressCCtx(m_cctx.get(), dst, cap, src, sz, m_level);
+    return ZSTD_isError(r) ? 0u : r;
+  }
+
+  bool decompress(const std::byte* src, std::size_t sz, std::byte* dst, std::size_t orig_sz) {
+    auto r = ZSTD_decompressDCtx(m_dctx.get(), dst, orig_sz, src, sz);
+    return !ZSTD_isError(r) && r == orig_sz;
+  }
+};
+#endif
+
+/**
+ *  @brief Send side of the compression stage for one connection.
+ *
+ *  A @c msg_compressor is a copyable handle, passed to the IO state change function object
+ *  of @c make_compression_io_state_change, and is thread-safe for concurrent sends.
+ */
+template <typename Codec, typename IOT = tcp_io>
+class msg_compressor {
+private:
+  using state_ptr = std::shared_ptr<detail::compression_state<Codec> >;
+
+  state_ptr               m_state;
+  basic_io_interface<IOT> m_io;
+
+public:
+  msg_compressor() = default;
+
+  msg_compressor(state_ptr st, basic_io_interface<IOT> io) noexcept :
+    m_state(std::move(st)), m_io(std::move(io)) { }
+
+  bool is_valid() const noexcept { return m_state && m_io.is_valid(); }
+
+/**
+ *  @brief Query whether the other side accepted compression (its hello message has
+ *  arrived, naming the same codec).
+ */
+  bool is_compressing() const noexcept {
+    return m_state && m_state->m_peer_accepts.load(std::memory_order_acquire);
+  }
+
+  basic_io_interface<IOT> get_io_interface() const noexcept { return m_io; }
+
+/**
+ *  @brief Send a message, compressed if the other side accepts compression and the
+ *  message is at least the minimum size and shrinks.
+ *
+ *  @throw A @c net_ip_exception if the compressor or the IO handler is not valid.
+ */
+  void send(const void* buf, std::size_t sz) const {
+    m_io.send(make_envelope(static_cast<const std::byte*>(buf), sz));
+  }
+
+  void send(const void* buf, std::size_t sz, send_priority pri) const {
+    m_io.send(make_envelope(static_cast<const std::byte*>(buf), sz), pri);
+  }
+
+private:
+
+  chops::const_shared_buffer make_envelope(const std::byte* buf, std::size_t sz) const {
+    if (!m_state) {
+      throw net_ip_exception(std::make_error_code(net_ip_errc::weak_ptr_expired));
+    }
+    auto& st = *m_state;
+    if (is_compressing() && sz >= st.m_opts.min_size) {
+      std::lock_guard<std::mutex> g(st.m_send_mutex);
+      auto cap = st.m_codec.max_compressed_size(sz);
+      auto hdr_end = compression_hdr_size + 4u;
+      st.m_send_buf.resize(hdr_end + cap); // only grows, the capacity is kept
+      auto* dst = st.m_send_buf.data();
+      auto csz = st.m_codec.compress(buf, sz, dst + hdr_end, cap);
+      if (csz > 0u && (csz + 4u) < sz) {
+        detail::put_compression_hdr(dst, compression_msg_type::compressed, csz + 4u);
+        detail::put_be32(dst + compression_hdr_size, sz);
+        return chops::const_shared_buffer(dst, hdr_end + csz);
+      }
+    }
+    chops::mutable_shared_buffer mb(compression_hdr_size + sz);
+    detail::put_compression_hdr(mb.data(), compression_msg_type::plain, sz);
+    std::memcpy(mb.data() + compression_hdr_size, buf, sz);
+    return chops::const_shared_buffer(std::move(mb));
+  }
+
+};
+
+/**
+ *  @brief Create a message handler that handles the compression envelope and calls the
+ *  application message handler with each (decompressed) application message.
+ *
+ *  The application message handler takes a @c const_buffer, a @c basic_io_interface and
+ *  an endpoint, as in @c start_io. A malformed envelope (including a body that does not
+ *  match the header length), or a compressed message that does not decompress, returns
+ *  @c false from the message handler.
+ */
+template <typename Codec, typename IOT, typename MH>
+auto make_decompressing_msg_hdlr(std::shared_ptr<detail::compression_state<Codec> > st,
+                                 MH msg_hdlr) {
+  return [st = std::move(st), mh = std::move(msg_hdlr)]
+      (std::experimental::net::const_buffer buf, basic_io_interface<IOT> io,
+       typename IOT::endpoint_type endp) mutable -> bool {
+    auto* ptr = static_cast<const std::byte*>(buf.data());
+    if (buf.size() < compression_hdr_size) {
+      return false;
+    }
+    auto body = ptr + compression_hdr_size;
+    auto body_sz = buf.size() - compression_hdr_size;
+    if (detail::get_be32(ptr + 1) != body_sz) { // framed length was over the maximum
+      return false;
+    }
+    switch (static_cast<compression_msg_type>(ptr[0])) {
+    case compression_msg_type::plain:
+      return mh(std::experimental::net::const_buffer(body, body_sz), io, endp);
+    case compression_msg_type::hello:
+      st->m_peer_accepts.store(body_sz == 1u &&
+                               static_cast<std::uint8_t>(body[0]) == Codec::id,
+                               std::memory_order_release);
+      return true;
+    case compression_msg_type::compressed: {
+      if (body_sz < 4u) {
+        return false;
+      }
+      auto orig_sz = detail::get_be32(body);
+      if (orig_sz > st->m_opts.max_msg_size) {
+        return false;
+      }
+      st->m_recv_buf.resize(orig_sz);
+      if (!st->m_codec.decompress(body + 4u, body_sz - 4u, st->m_recv_buf.data(), orig_sz)) {
+        return false;
+      }
+      return mh(std::experimental::net::const_buffer(st->m_recv_buf.data(), orig_sz), io, endp);
+    }
+    }
+    return false;
+  };
+}
+
+/**
+ *  @brief Create an IO state change function object that starts IO with the compression
+ *  stage, and sends the hello message that negotiates compression.
+ *
+ *  @param opts Compression options.
+ *
+ *  @param msg_hdlr Application message handler, copied for each connection.
+ *
+ *  @param io_state_chg Application function object, called with the @c basic_io_interface,
+ *  a @c msg_compressor for sending, the number of connections and the starting flag. On IO
+ *  stop the @c msg_compressor is empty (not valid).
+ *
+ *  @return A function object that can be used with the @c start method.
+ *
+ *  @note This is implemented only for TCP connections.
+ */
+template <typename Codec, typename MH, typename F>
+auto make_compression_io_state_change (const compression_options& opts, MH&& msg_hdlr,
+                                       F&& io_state_chg) {
+  return [opts, mh = std::forward<MH>(msg_hdlr), chg = std::forward<F>(io_state_chg)]
+                  (tcp_io_interface io, std::size_t num, bool starting) mutable {
+    if (!starting) {
+      chg(io, msg_compressor<Codec>(), num, false);
+      return;
+    }
+    auto st = std::make_shared<detail::compression_state<Codec> >(opts);
+    io.start_io(compression_hdr_size, make_decompressing_msg_hdlr<Codec, tcp_io>(st, mh),
+                make_compression_msg_frame(opts.max_msg_size));
+    std::byte hello[compression_hdr_size + 1u];
+    detail::put_compression_hdr(hello, compression_msg_type::hello, 1u);
+    hello[compression_hdr_size] = static_cast<std::byte>(Codec::id);
+    io.send(chops::const_shared_buffer(hello, sizeof(hello)), send_priority::high);
+    chg(io, msg_compressor<Codec>(std::move(st), io), num, true);
+  };
+}
+
+} // end net namespace
+} // end chops namespace
+
+#endif
+
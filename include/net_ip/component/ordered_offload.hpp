@@ -0,0 +1,306 @@
+/** @file
+ *
+ *  @ingroup net_ip_component_module
+ *
+ *  @brief Offload message handling from the IO threads to worker threads, keeping the
+ *  message order of each connection.
+ *
+ *  A message handler runs within the IO handler, on an IO thread, so a slow handler
+ *  (parsing, a database lookup, a risk check) delays the reads of every connection of
+ *  the @c io_context. The message handler created by @c ordered_offload
+ *  @c make_msg_hdlr only passes each complete message (the read buffer moved into a
+ *  shared buffer, without a copy) to a single producer, single consumer ring of the
+ *  connection. The application message handler is called by a worker thread, typically
+ *  one of a @c worker_pool.
+ *
+ *  At most one worker drains the ring of a connection at a time, so messages of a
+ *  connection are handled in order, one after another, while different connections are
+ *  handled in parallel. A drain is posted to the worker @c io_context of the connection
+ *  when the ring goes from idle to non-empty, and handles at most a batch of messages
+ *  before being reposted, so one busy connection does not starve the others of the same
+ *  worker thread. Each connection is assigned a worker @c io_context by the selector
+ *  (e.g. round-robin over the contexts of a @c worker_pool).
+ *
+ *  When the ring of a connection is full the IO thread does not block: the message is
+ *  appended to an overflow queue of the connection (counted as spilled), and later
+ *  messages follow it there until the worker has drained it, so the order is kept.
+ *  Output queue limits or an application level window are the place to bound the
+ *  amount of unhandled data.
+ *
+ *  The application message handler has the shared buffer message handler signature,
+ *  with a @c basic_io_interface (the IO handler may be gone by the time the worker
+ *  runs, in which case a send or other call throws, which stops the delivery for the
+ *  connection):
+ *
+ *  @code
+ *    bool heavy_hdlr(chops::const_shared_buffer msg, chops::net::tcp_io_interface io,
+ *                    std::experimental::net::ip::tcp::endpoint endp);
+ *
+ *    chops::net::worker_pool wp(4);
+ *    wp.start();
+ *    chops::net::ordered_offload<chops::net::tcp_io> off(wp.make_io_context_selector());
+ *    // in the IO state change callback, one message handler per connection
+ *    io.start_io(2, off.make_msg_hdlr(heavy_hdlr), msg_frame);
+ *  @endcode
+ *
+ *  A @c false return from the application message handler stops the IO handler (through
+ *  @c stop_io) and discards the remaining messages of the connection, as a @c false
+ *  return from a message handler does within the IO handler.
+ *
+ *  @note This class is not a necessary dependency of the @c net_ip library, but is
+ *  provided for convenience in many use cases.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef ORDERED_OFFLOAD_HPP_INCLUDED
+#define ORDERED_OFFLOAD_HPP_INCLUDED
+
+#include <experimental/io_context>
+#include <experimental/executor>
+
+#include <cstddef> // std::size_t
+#include <atomic>
+#include <deque>
+#include <functional> // std::function
+#include <memory> // std::shared_ptr, std::enable_shared_from_this
+#include <mutex>
+#include <type_traits> // std::decay_t
+#include <utility> // std::move, std::forward
+
+#include "net_ip/basic_io_interface.hpp"
+#include "net_ip/net_ip_error.hpp"
+#include "net_ip/detail/spsc_ring.hpp"
+
+#include "utility/shared_buffer.hpp"
+
+namespace chops {
+namespace net {
+
+/**
+ *  @brief Create message handlers that pass messages to worker threads, in order per
+ *  connection, see the file documentation.
+ *
+ *  Copies of an @c ordered_offload share the same selector and counters. This class is
+ *  thread-safe for concurrent access.
+ */
+template <typename IOT>
+class ordered_offload {
+public:
+  using io_context_selector = std::function<std::experimental::net::io_context& ()>;
+
+private:
+  using io_intf   = basic_io_interface<IOT>;
+  using endp_type = typename IOT::endpoint_type;
+
+  struct shared_state {
+    io_context_selector   m_selector;
+    std::size_t           m_ring_size;
+    std::size_t           m_batch_size;
+    std::atomic_size_t    m_num_handled { 0u };
+    std::atomic_size_t    m_num_spilled { 0u };
+    std::atomic_size_t    m_num_drains { 0u };
+
+    shared_state(io_context_selector sel, std::size_t ring_size, std::size_t batch_size) :
+      m_selector(std::move(sel)), m_ring_size(ring_size), m_batch_size(batch_size) { }
+  };
+
+  struct msg {
+    chops::const_shared_buffer  m_buf;
+    io_intf                     m_io;
+    endp_type                   m_endp;
+  };
+
+  // one per connection, the message handler (IO thread) is the producer and the posted
+  // drain (worker thread) is the consumer
+  template <typename MH>
+  class conn_state : public std::enable_shared_from_this<conn_state<MH> > {
+  private:
+    std::shared_ptr<shared_state>       m_shared;
+    std::experimental::net::io_context& m_ioc;
+    MH                                  m_hdlr;
+    detail::spsc_ring<msg>              m_ring;
+    std::mutex                          m_spill_mutex;
+    std::deque<msg>                     m_spill;
+    std::atomic_size_t                  m_spill_size;
+    std::atomic_bool                    m_scheduled;
+    std::atomic_bool                    m_done;
+
+  public:
+    conn_state(std::shared_ptr<shared_state> sh, MH hdlr) :
+        m_shared(std::move(sh)), m_ioc(m_shared->m_selector()), m_hdlr(std::move(hdlr)),
+        m_ring(m_shared->m_ring_size), m_spill_mutex(), m_spill(), m_spill_size(0u),
+        m_scheduled(false), m_done(false) { }
+
+    // IO thread
+    bool push(msg&& m) {
+      if (m_done.load(std::memory_order_relaxed)) {
+        return false;
+      }
+      if (m_spill_size.load(std::memory_order_acquire) != 0u || !m_ring.try_push(std::move(m))) {
+        std::lock_guard<std::mutex> lk(m_spill_mutex);
+        m_spill.push_back(std::move(m));
+        m_spill_size.store(m_spill.size(), std::memory_order_release);
+        m_shared->m_num_spilled.fetch_add(1u, std::memory_order_relaxed);
+      }
+      schedule();
+      return true;
+    }
+
+  private:
+    void schedule() {
+      if (!m_scheduled.exchange(true, std::memory_order_seq_cst)) {
+        auto self { this->shared_from_this() };
+        std::experimental::net::post(m_ioc.get_executor(), [self] { self->drain(); } );
+      }
+    }
+
+    // worker thread, a message is taken from the overflow queue only when the ring is
+    // empty, since spilled messages are newer than any message in the ring
+    bool take_spill(std::deque<msg>& sp) {
+      std::lock_guard<std::mutex> lk(m_spill_mutex);
+      if (m_spill.empty() || !m_ring.empty()) {
+        return false;
+      }
+      sp.swap(m_spill);
+      m_spill_size.store(0u, std::memory_order_release);
+      return true;
+    }
+
+    bool handle(msg& m) {
+      if (m_done.load(std::memory_order_relaxed)) {
+        return false;
+      }
+      bool ret = false;
+      try {
+        ret = m_hdlr(std::move(m.m_buf), m.m_io, m.m_endp);
+      }
+      catch (const net_ip_exception&) {
+        ret = false; // the IO handler is gone
+      }
+      // release, so a reader of the count also sees the effects of the handler
+      m_shared->m_num_handled.fetch_add(1u, std::memory_order_release);
+      if (!ret) {
+        m_done.store(true);
+        try {
+          m.m_io.stop_io();
+        }
+        catch (const net_ip_exception&) { }
+      }
+      return ret;
+    }
+
+    void drain() {
+      m_shared->m_num_drains.fetch_add(1u, std::memory_order_relaxed);
+      std::size_t n = 0u;
+      std::deque<msg> sp;
+      while (n < m_shared->m_batch_size) {
+        if (auto m = m_ring.try_pop()) {
+          handle(*m);
+          ++n;
+          continue;
+        }
+        if (!take_spill(sp)) {
+          if (m_ring.empty()) {
+            break;
+          }
+          continue;
+        }
+        for (auto& m : sp) {
+          handle(m);
+          ++n;
+        }
+        sp.clear();
+      }
+      m_scheduled.store(false, std::memory_order_seq_cst);
+      // a push may have seen the drain still scheduled
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (!m_ring.empty() || m_spill_size.load(std::memory_order_acquire) != 0u) {
+        schedule();
+      }
+    }
+  };
+
+private:
+  std::shared_ptr<shared_state>  m_shared;
+
+public:
+
+/**
+ *  @brief Construct an @c ordered_offload.
+ *
+ *  @param selector Function object returning the worker @c io_context of each new
+ *  connection, e.g. from @c worker_pool @c make_io_context_selector.
+ *
+ *  @param ring_size Capacity of the message ring of each connection.
+ *
+ *  @param batch_size Max number of messages handled by one drain of a connection
+ *  before it is reposted.
+ */
+  explicit ordered_offload(io_context_selector selector, std::size_t ring_size = 1024u,
+                           std::size_t batch_size = 64u) :
+      m_shared(std::make_shared<shared_state>(std::move(selector), ring_size,
+                                              batch_size == 0u ? 1u : batch_size)) { }
+
+/**
+ *  @brief Construct an @c ordered_offload where all connections are handled by the
+ *  threads of one worker @c io_context (which must outlive the message handlers).
+ */
+  explicit ordered_offload(std::experimental::net::io_context& ioc,
+                           std::size_t ring_size = 1024u, std::size_t batch_size = 64u) :
+      ordered_offload([&ioc] () -> std::experimental::net::io_context& { return ioc; },
+                      ring_size, batch_size) { }
+
+/**
+ *  @brief Create the message handler for one connection, to be passed to @c start_io.
+ *
+ *  @param msg_hdlr Application message handler, called by worker threads with a
+ *  @c const_shared_buffer, a @c basic_io_interface and the remote endpoint. A copy is
+ *  made for each connection.
+ *
+ *  @return Message handler taking a shared buffer, so the IO handler moves the read
+ *  buffer into the message without a copy.
+ */
+  template <typename MH>
+  auto make_msg_hdlr(MH&& msg_hdlr) const {
+    auto st = std::make_shared<conn_state<std::decay_t<MH> > >(m_shared,
+                                                              std::forward<MH>(msg_hdlr));
+    return [st] (chops::const_shared_buffer buf, io_intf io, endp_type endp) {
+      return st->push(msg { std::move(buf), std::move(io), endp });
+    };
+  }
+
+/**
+ *  @brief Return the number of messages handled by worker threads.
+ */
+  std::size_t get_num_handled() const noexcept {
+    return m_shared->m_num_handled.load(std::memory_order_acquire);
+  }
+
+/**
+ *  @brief Return the number of messages that did not fit in the ring of their
+ *  connection.
+ */
+  std::size_t get_num_spilled() const noexcept {
+    return m_shared->m_num_spilled.load(std::memory_order_relaxed);
+  }
+
+/**
+ *  @brief Return the number of drains posted to the worker threads.
+ */
+  std::size_t get_num_drains() const noexcept {
+    return m_shared->m_num_drains.load(std::memory_order_relaxed);
+  }
+};
+
+} // end net namespace
+} // end chops namespace
+
+#endif
+
@@ -0,0 +1,538 @@
+/** @file
+ *
+ *  @ingroup net_ip_component_module
+ *
+ *  @brief Pipelined request / reply correlation over one connection, with many requests
+ *  in flight, replies matched by a correlation id, and request timeouts.
+ *
+ *  Waiting for each reply before sending the next request costs a round trip per
+ *  request. A @c request_correlator instead sends each request as soon as it is made
+ *  (it is queued in the output queue of the IO handler, so the connection stays busy)
+ *  and keeps the pending requests in a table keyed by correlation id. The message
+ *  handler created by @c make_msg_handler extracts the id of each incoming message (with
+ *  an application supplied function object) and completes the matching request.
+ *
+ *  The pending requests are preallocated records (up to the max in flight), indexed by
+ *  an open addressing table with linear probing, so a request or reply performs no
+ *  allocation and no more than a few cache line accesses. Request timeouts are kept in a
+ *  @c timer_wheel, advanced by one periodic entry in the shared idle timer service of the
+ *  @c io_context (the same service that drives the IO handler idle timeouts), so the
+ *  number of requests in flight does not add timers to the reactor. The timeout
+ *  resolution is the tick interval of the service (100 milliseconds).
+ *
+ *  A typical client, where the id is the first 4 bytes of a 2 byte length header
+ *  message body:
+ *
+ *  @code
+ *    auto corr = chops::net::make_request_correlator<chops::net::tcp_io>(ioc,
+ *        [] (std::experimental::net::const_buffer buf) {
+ *          return chops::net::decode_uint<4>(static_cast<const std::byte*>(buf.data()) + 2);
+ *        }, std::chrono::seconds(2));
+ *    // in the IO state change callback
+ *    if (starting) {
+ *      io.start_io(2, corr->make_msg_handler(), chops::net::make_length_field_msg_frame<0, 2>());
+ *      corr->set_io_interface(io);
+ *    }
+ *    else {
+ *      corr->cancel_all();
+ *    }
+ *    // anywhere
+ *    corr->send_request(id, req_buf, [] (std::error_code err,
+ *                                        std::experimental::net::const_buffer reply) {
+ *        // reply is only valid within the callback
+ *      }
+ *    );
+ *  @endcode
+ *
+ *  The completion callback is called once per request: within the IO handler (from the
+ *  message handler) with the reply, with a @c net_ip_errc::request_timeout error from
+ *  the @c io_context (not the IO handler strand) on timeout, or with a
+ *  @c net_ip_errc::request_cancelled error by @c cancel_all. Callbacks are called without
+ *  any lock held, and can make new requests.
+ *
+ *  With C++20 coroutines, @c async_request returns an awaitable that suspends until the
+ *  request completes, returning the error and a copy of the reply.
+ *
+ *  @note These components are not a necessary dependency of the @c net_ip library,
+ *  but are useful in many use cases.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef REQUEST_CORRELATOR_HPP_INCLUDED
+#define REQUEST_CORRELATOR_HPP_INCLUDED
+
+#include <experimental/buffer>
+#include <experimental/io_context>
+
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint64_t
+#include <atomic>
+#include <chrono>
+#include <functional> // std::function, std::hash
+#include <memory> // std::shared_ptr, std::enable_shared_from_this, std::unique_ptr
+#include <mutex>
+#include <system_error>
+#include <type_traits> // std::decay_t, std::invoke_result_t
+#include <utility> // std::move, std::forward
+#include <vector>
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#endif
+
+#include "net_ip/basic_io_interface.hpp"
+#include "net_ip/basic_io_ref.hpp"
+#include "net_ip/net_ip_error.hpp"
+#include "net_ip/detail/timer_wheel.hpp"
+
+#include "utility/shared_buffer.hpp"
+
+namespace chops {
+namespace net {
+
+/**
+ *  @brief Correlate replies to pipelined requests on one connection, see the file
+ *  documentation.
+ *
+ *  @tparam IOT IO handler type, e.g. @c tcp_io.
+ *
+ *  @tparam ID Correlation id type, hashable with @c std::hash and equality comparable.
+ *
+ *  @tparam IdExtract Function object type returning the @c ID of an incoming message,
+ *  called with a @c std::experimental::net::const_buffer.
+ *
+ *  This class is thread-safe for concurrent access, and is always created with
+ *  @c make_request_correlator.
+ */
+template <typename IOT, typename ID, typename IdExtract>
+class request_correlator :
+    public std::enable_shared_from_this<request_correlator<IOT, ID, IdExtract> > {
+public:
+  using completion_cb =
+    std::function<void (std::error_code, std::experimental::net::const_buffer)>;
+  using unmatched_func = std::function<bool (std::experimental::net::const_buffer)>;
+
+private:
+  using lock_guard = std::lock_guard<std::mutex>;
+  using io_intf    = basic_io_interface<IOT>;
+  using entry      = detail::timer_wheel::entry;
+
+  struct record {
+    ID             m_id { };
+    completion_cb  m_cb { };
+  };
+
+  static constexpr std::size_t no_rec = static_cast<std::size_t>(-1);
+
+private:
+  mutable std::mutex                      m_mutex;
+  std::experimental::net::io_context&     m_ioc;
+  IdExtract                               m_id_extract;
+  std::uint64_t                           m_timeout_ticks;
+  // the records and timer entries are never reallocated, the entries are intrusively
+  // linked in the wheel
+  std::vector<record>                     m_recs;
+  std::unique_ptr<entry[]>                m_entries;
+  std::vector<std::size_t>                m_free;
+  // record index + 1, 0 is an empty slot
+  std::vector<std::size_t>                m_table;
+  std::size_t                             m_mask;
+  detail::timer_wheel                     m_wheel;
+  detail::idle_timer                      m_tick;
+  bool                                    m_ticking;
+  io_intf                                 m_io;
+  unmatched_func                          m_unmatched;
+  std::size_t                             m_num_unmatched;
+  std::size_t                             m_num_timeouts;
+
+public:
+
+  // use make_request_correlator
+  request_correlator(std::experimental::net::io_context& ioc, IdExtract id_extract,
+                     std::chrono::milliseconds timeout, std::size_t max_in_flight) :
+      m_mutex(), m_ioc(ioc), m_id_extract(std::move(id_extract)),
+      m_timeout_ticks(detail::idle_timer_service::to_ticks(timeout)),
+      m_recs(max_in_flight == 0u ? 1u : max_in_flight),
+      m_entries(std::make_unique<entry[]>(m_recs.size())), m_free(),
+      m_table(), m_mask(0u), m_wheel(), m_tick(), m_ticking(false), m_io(),
+      m_unmatched(), m_num_unmatched(0u), m_num_timeouts(0u) {
+    std::size_t tsz = 16u;
+    while (tsz < m_recs.size() * 2u) { // load factor of at most one half
+      tsz <<= 1u;
+    }
+    m_table.resize(tsz, 0u);
+    m_mask = tsz - 1u;
+    m_free.reserve(m_recs.size());
+    for (std::size_t i = m_recs.size(); i > 0u; --i) {
+      m_free.push_back(i - 1u);
+    }
+  }
+
+  ~request_correlator() { m_tick.stop(); }
+
+private:
+  request_correlator(const request_correlator&) = delete;
+  request_correlator& operator=(const request_correlator&) = delete;
+
+public:
+
+/**
+ *  @brief Set the IO interface that requests are sent through, typically in the IO
+ *  state change callback once @c start_io has been called.
+ */
+  void set_io_interface(io_intf io) {
+    lock_guard gd { m_mutex };
+    m_io = io;
+  }
+
+/**
+ *  @brief Set a function object for incoming messages that do not match a pending
+ *  request (e.g. a reply after its timeout, or an unsolicited message); its return value
+ *  is the message handler return value. By default they are counted and ignored.
+ */
+  void set_unmatched_func(unmatched_func func) {
+    lock_guard gd { m_mutex };
+    m_unmatched = std::move(func);
+  }
+
+/**
+ *  @brief Send a request and register its completion callback.
+ *
+ *  @param id Correlation id of the request, not already in flight.
+ *
+ *  @param req Request message.
+ *
+ *  @param cb Completion callback.
+ *
+ *  @param timeout Request timeout, a timeout of 0 (the default) is the timeout given to
+ *  @c make_request_correlator.
+ *
+ *  @return @c false (the callback is not called) if the id is already in flight, the max
+ *  in flight has been reached, or there is no valid IO interface.
+ */
+  bool send_request(const ID& id, chops::const_shared_buffer req, completion_cb cb,
+                    std::chrono::milliseconds timeout = std::chrono::milliseconds { 0 }) {
+    io_intf io;
+    {
+      lock_guard gd { m_mutex };
+      if (m_free.empty() || !m_io.is_valid() || find(id) != no_rec) {
+        return false;
+      }
+      start_ticking();
+      std::size_t idx = m_free.back();
+      m_free.pop_back();
+      m_recs[idx].m_id = id;
+      m_recs[idx].m_cb = std::move(cb);
+      insert(idx);
+      if (m_wheel.empty()) {
+        m_wheel.reset(current_tick());
+      }
+      m_wheel.insert(m_entries[idx], m_wheel.now() +
+        (timeout.count() > 0 ? detail::idle_timer_service::to_ticks(timeout) : m_timeout_ticks));
+      io = m_io;
+    }
+    // sent after the request is registered, so the reply cannot arrive first
+    try {
+      io.send(std::move(req));
+    }
+    catch (const net_ip_exception&) {
+      lock_guard gd { m_mutex };
+      auto idx = find(id);
+      if (idx != no_rec) {
+        release(idx);
+      }
+      return false;
+    }
+    return true;
+  }
+
+/**
+ *  @brief Complete every pending request with a @c net_ip_errc::request_cancelled
+ *  error, typically when the IO handler stops.
+ */
+  void cancel_all() {
+    std::vector<completion_cb> cbs;
+    {
+      lock_guard gd { m_mutex };
+      for (std::size_t i = 0u; i < m_table.size(); ++i) {
+        if (m_table[i] != 0u) {
+          cbs.push_back(std::move(m_recs[m_table[i] - 1u].m_cb));
+        }
+      }
+      for (std::size_t i = 0u; i < m_table.size(); ++i) {
+        if (m_table[i] != 0u) {
+          auto idx = m_table[i] - 1u;
+          m_wheel.erase(m_entries[idx]);
+          m_recs[idx].m_cb = completion_cb { };
+          m_free.push_back(idx);
+          m_table[i] = 0u;
+        }
+      }
+    }
+    for (auto& cb : cbs) {
+      cb(std::make_error_code(net_ip_errc::request_cancelled),
+         std::experimental::net::const_buffer());
+    }
+  }
+
+/**
+ *  @brief Create the message handler for @c start_io, which completes the pending
+ *  request matching each incoming message.
+ *
+ *  The message handler refers to the correlator through a @c std::shared_ptr.
+ */
+  auto make_msg_handler() {
+    return [self = this->shared_from_this()] (std::experimental::net::const_buffer buf,
+                                               basic_io_ref<IOT>,
+                                               typename IOT::endpoint_type) {
+      return self->reply_received(buf);
+    };
+  }
+
+/**
+ *  @brief Complete the pending request matching an incoming message, called by the
+ *  message handler of @c make_msg_handler.
+ *
+ *  @return The unmatched message function object return value, or @c true.
+ */
+  bool reply_received(std::experimental::net::const_buffer buf) {
+    completion_cb cb;
+    unmatched_func um;
+    {
+      auto id = m_id_extract(buf);
+      lock_guard gd { m_mutex };
+      auto idx = find(id);
+      if (idx == no_rec) {
+        ++m_num_unmatched;
+        if (!m_unmatched) {
+          return true;
+        }
+        um = m_unmatched;
+      }
+      else {
+        cb = std::move(m_recs[idx].m_cb);
+        release(idx);
+      }
+    }
+    if (um) {
+      return um(buf);
+    }
+    cb(std::error_code(), buf);
+    return true;
+  }
+
+/**
+ *  @brief Return the number of requests in flight.
+ */
+  std::size_t in_flight() const noexcept {
+    lock_guard gd { m_mutex };
+    return m_recs.size() - m_free.size();
+  }
+
+/**
+ *  @brief Return the number of requests that timed out.
+ */
+  std::size_t get_num_timeouts() const noexcept {
+    lock_guard gd { m_mutex };
+    return m_num_timeouts;
+  }
+
+/**
+ *  @brief Return the number of incoming messages that did not match a pending request.
+ */
+  std::size_t get_num_unmatched() const noexcept {
+    lock_guard gd { m_mutex };
+    return m_num_unmatched;
+  }
+
+/**
+ *  @brief Expire the requests whose timeout has passed, called on each tick of the idle
+ *  timer service (public for testing, with an explicit tick).
+ */
+  void expire_requests(std::uint64_t tick) {
+    std::vector<completion_cb> cbs;
+    {
+      lock_guard gd { m_mutex };
+      m_wheel.advance(tick, [this, &cbs] (entry& e) {
+          auto idx = static_cast<std::size_t>(&e - m_entries.get());
+          cbs.push_back(std::move(m_recs[idx].m_cb));
+          ++m_num_timeouts;
+          release(idx);
+        }
+      );
+    }
+    for (auto& cb : cbs) {
+      cb(std::make_error_code(net_ip_errc::request_timeout),
+         std::experimental::net::const_buffer());
+    }
+  }
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+  struct request_result {
+    std::error_code               err;
+    chops::mutable_shared_buffer  reply;
+  };
+
+  class request_awaiter {
+  private:
+    std::shared_ptr<request_correlator> m_corr;
+    ID                                  m_id;
+    chops::const_shared_buffer          m_req;
+    std::chrono::milliseconds           m_timeout;
+    request_result                      m_result;
+    std::atomic_bool                    m_done;
+
+  public:
+    request_awaiter(std::shared_ptr<request_correlator> corr, const ID& id,
+                    chops::const_shared_buffer req, std::chrono::milliseconds timeout) :
+        m_corr(std::move(corr)), m_id(id), m_req(std::move(req)), m_timeout(timeout),
+        m_result(), m_done(false) { }
+
+    bool await_ready() const noexcept { return false; }
+
+    // the reply may arrive before the request call returns, in which case the coroutine
+    // is not suspended
+    bool await_suspend(std::coroutine_handle<> h) {
+      bool sent = m_corr->send_request(m_id, std::move(m_req),
+        [this, h] (std::error_code err, std::experimental::net::const_buffer buf) {
+          m_result.err = err;
+          m_result.reply = chops::mutable_shared_buffer(buf.data(), buf.size());
+          if (m_done.exchange(true)) {
+            h.resume();
+          }
+        }, m_timeout);
+      if (!sent) {
+        m_result.err = std::make_error_code(net_ip_errc::request_cancelled);
+        return false;
+      }
+      return m_done.exchange(true) == false;
+    }
+
+    request_result await_resume() { return std::move(m_result); }
+  };
+
+/**
+ *  @brief Send a request and return an awaitable for its completion, @c co_await
+ *  returns a @c request_result (a @c net_ip_errc::request_cancelled error if the
+ *  request could not be sent).
+ */
+  request_awaiter async_request(const ID& id, chops::const_shared_buffer req,
+                                std::chrono::milliseconds timeout =
+                                  std::chrono::milliseconds { 0 }) {
+    return request_awaiter(this->shared_from_this(), id, std::move(req), timeout);
+  }
+
+#endif
+
+private:
+
+  std::uint64_t current_tick() {
+    return std::experimental::net::use_service<detail::idle_timer_service>(m_ioc).current_tick();
+  }
+
+  // the tick entry fires every tick interval, it is started once and runs until the
+  // correlator is destroyed
+  void start_ticking() {
+    if (m_ticking) {
+      return;
+    }
+    m_ticking = true;
+    std::weak_ptr<request_correlator> wp = this->shared_from_this();
+    m_tick.start(m_ioc, detail::idle_timer_service::tick_interval, [wp] {
+        if (auto p = wp.lock()) {
+          p->expire_requests(p->current_tick());
+        }
+      }
+    );
+  }
+
+  // Fibonacci hashing of the std::hash value
+  std::size_t home(const ID& id) const noexcept {
+    std::uint64_t h = static_cast<std::uint64_t>(std::hash<ID>{}(id)) * 0x9E3779B97F4A7C15ull;
+    return static_cast<std::size_t>(h >> 32u) & m_mask;
+  }
+
+  std::size_t find(const ID& id) const noexcept {
+    for (std::size_t i = home(id); m_table[i] != 0u; i = (i + 1u) & m_mask) {
+      if (m_recs[m_table[i] - 1u].m_id == id) {
+        return m_table[i] - 1u;
+      }
+    }
+    return no_rec;
+  }
+
+  void insert(std::size_t idx) noexcept {
+    std::size_t i = home(m_recs[idx].m_id);
+    while (m_table[i] != 0u) {
+      i = (i + 1u) & m_mask;
+    }
+    m_table[i] = idx + 1u;
+  }
+
+  // removes the record from the table (backward shift deletion, so there are no
+  // tombstones) and the wheel, and frees it
+  void release(std::size_t idx) noexcept {
+    std::size_t i = home(m_recs[idx].m_id);
+    while (m_table[i] != idx + 1u) {
+      i = (i + 1u) & m_mask;
+    }
+    std::size_t j = i;
+    for (;;) {
+      j = (j + 1u) & m_mask;
+      if (m_table[j] == 0u) {
+        break;
+      }
+      std::size_t k = home(m_recs[m_table[j] - 1u].m_id);
+      // the entry at j can move to i if its home is not cyclically within (i, j]
+      bool in_range = (i <= j) ? (i < k && k <= j) : (i < k || k <= j);
+      if (!in_range) {
+        m_table[i] = m_table[j];
+        i = j;
+      }
+    }
+    m_table[i] = 0u;
+    m_wheel.erase(m_entries[idx]);
+    m_recs[idx].m_cb = completion_cb { };
+    m_free.push_back(idx);
+  }
+
+};
+
+/**
+ *  @brief Create a @c request_correlator.
+ *
+ *  @param ioc The @c io_context of the IO handler, for the request timeouts.
+ *
+ *  @param id_extract Function object returning the correlation id of an incoming
+ *  message, called with a @c std::experimental::net::const_buffer.
+ *
+ *  @param timeout Default request timeout.
+ *
+ *  @param max_in_flight Max number of pending requests.
+ *
+ *  @return @c std::shared_ptr to the correlator.
+ */
+template <typename IOT, typename IdExtract>
+auto make_request_correlator(std::experimental::net::io_context& ioc, IdExtract&& id_extract,
+                             std::chrono::milliseconds timeout,
+                             std::size_t max_in_flight = 1024u) {
+  using id_type = std::decay_t<std::invoke_result_t<std::decay_t<IdExtract>&,
+                                                  std::experimental::net::const_buffer> >;
+  using corr_type = request_correlator<IOT, id_type, std::decay_t<IdExtract> >;
+  return std::make_shared<corr_type>(ioc, std::forward<IdExtract>(id_extract), timeout,
+                                     max_in_flight);
+}
+
+} // end net namespace
+} // end chops namespace
+
+#endif
+
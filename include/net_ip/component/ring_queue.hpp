@@ -0,0 +1,249 @@
+/** @file
+ *
+ *  @ingroup net_ip_component_module
+ *
+ *  @brief A bounded, lock-free queue, an alternative to @c wait_queue for delivering
+ *  error and IO state change data from IO handler threads.
+ *
+ *  A @c wait_queue push locks a mutex and notifies a condition variable, so an IO thread
+ *  can block behind a slow consumer (e.g. a sink thread formatting to a @c std::ostream).
+ *  A @c ring_queue push never blocks: each slot of a fixed size ring has a sequence
+ *  counter, and producers and consumers claim slots with a compare and swap on the
+ *  enqueue or dequeue position. When the ring is full the value is dropped and a drop
+ *  counter is incremented, which the consumer can report.
+ *
+ *  Consumers drain values in batches. Since there is no condition variable, a waiting
+ *  consumer polls the ring at an interval, which only adds latency when the ring is
+ *  empty.
+ *
+ *  Any number of producers and consumers are supported.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef RING_QUEUE_HPP_INCLUDED
+#define RING_QUEUE_HPP_INCLUDED
+
+#include <cstddef> // std::size_t, std::ptrdiff_t
+#include <atomic>
+#include <memory> // std::unique_ptr
+#include <new> // placement new, std::launder
+#include <utility> // std::move, std::forward
+#include <optional>
+#include <chrono>
+#include <thread> // std::this_thread::sleep_for
+
+namespace chops {
+namespace net {
+
+template <typename T>
+class ring_queue {
+private:
+
+  // the sequence value tells whether the slot is free for the enqueue position, or
+  // holds a value for the dequeue position
+  struct slot {
+    std::atomic_size_t    seq;
+    alignas(T) unsigned char storage[sizeof(T)];
+  };
+
+  std::unique_ptr<slot[]> m_slots;
+  std::size_t             m_mask;
+  // producer and consumer positions on separate cache lines
+  alignas(64) std::atomic_size_t m_enq_pos;
+  alignas(64) std::atomic_size_t m_deq_pos;
+  alignas(64) std::atomic_size_t m_num_dropped;
+  std::atomic_bool        m_closed;
+
+public:
+
+  using size_type = std::size_t;
+  using value_type = T;
+
+/**
+ *  @brief Construct a @c ring_queue.
+ *
+ *  @param capacity Maximum number of queued values, rounded up to a power of 2 (and at
+ *  least 2).
+ */
+  explicit ring_queue(std::size_t capacity) :
+      m_slots(), m_mask(0), m_enq_pos(0), m_deq_pos(0), m_num_dropped(0), m_closed(false) {
+    std::size_t sz = 2u;
+    while (sz < capacity) {
+      sz <<= 1u;
+    }
+    m_slots = std::make_unique<slot[]>(sz);
+    m_mask = sz - 1u;
+    for (std::size_t i = 0u; i < sz; ++i) {
+      m_slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  ~ring_queue() {
+    while (try_pop()) { }
+  }
+
+private:
+  ring_queue(const ring_queue&) = delete;
+  ring_queue(ring_queue&&) = delete;
+  ring_queue& operator=(const ring_queue&) = delete;
+  ring_queue& operator=(ring_queue&&) = delete;
+
+public:
+
+/**
+ *  @brief Construct a value in place at the end of the queue, without blocking.
+ *
+ *  @return @c false if the queue is closed, or if it is full, in which case the drop
+ *  count is incremented.
+ */
+  template <typename... Args>
+  bool try_emplace_push(Args&&... args) {
+    if (m_closed.load(std::memory_order_relaxed)) {
+      return false;
+    }
+    std::size_t pos = m_enq_pos.load(std::memory_order_relaxed);
+    slot* s = nullptr;
+    while (true) {
+      s = &m_slots[pos & m_mask];
+      std::size_t seq = s->seq.load(std::memory_order_acquire);
+      auto diff = static_cast<std::ptrdiff_t>(seq - pos);
+      if (diff == 0) {
+        if (m_enq_pos.compare_exchange_weak(pos, pos + 1u, std::memory_order_relaxed)) {
+          break;
+        }
+      }
+      else if (diff < 0) { // full
+        m_num_dropped.fetch_add(1u, std::memory_order_relaxed);
+        return false;
+      }
+      else {
+        pos = m_enq_pos.load(std::memory_order_relaxed);
+      }
+    }
+    ::new (static_cast<void*>(s->storage)) T(std::forward<Args>(args)...);
+    s->seq.store(pos + 1u, std::memory_order_release);
+    return true;
+  }
+
+  bool try_push(const T& val) { return try_emplace_push(val); }
+  bool try_push(T&& val) { return try_emplace_push(std::move(val)); }
+
+/**
+ *  @brief Pop a value from the front of the queue, without blocking.
+ *
+ *  @return An empty @c std::optional if the queue is empty.
+ */
+  std::optional<T> try_pop() {
+    std::size_t pos = m_deq_pos.load(std::memory_order_relaxed);
+    slot* s = nullptr;
+    while (true) {
+      s = &m_slots[pos & m_mask];
+      std::size_t seq = s->seq.load(std::memory_order_acquire);
+      auto diff = static_cast<std::ptrdiff_t>(seq - (pos + 1u));
+      if (diff == 0) {
+        if (m_deq_pos.compare_exchange_weak(pos, pos + 1u, std::memory_order_relaxed)) {
+          break;
+        }
+      }
+      else if (diff < 0) { // empty
+        return std::optional<T> { };
+      }
+      else {
+        pos = m_deq_pos.load(std::memory_order_relaxed);
+      }
+    }
+    T* p = std::launder(reinterpret_cast<T*>(s->storage));
+    std::optional<T> val { std::move(*p) };
+    p->~T();
+    s->seq.store(pos + m_mask + 1u, std::memory_order_release);
+    return val;
+  }
+
+/**
+ *  @brief Pop up to @c max_vals values, calling a function object with each, without
+ *  blocking.
+ *
+ *  @return Number of values popped.
+ */
+  template <typename F>
+  std::size_t pop_batch(F&& func, std::size_t max_vals) {
+    std::size_t cnt = 0u;
+    while (cnt < max_vals) {
+      auto val = try_pop();
+      if (!val) {
+        break;
+      }
+      func(std::move(*val));
+      ++cnt;
+    }
+    return cnt;
+  }
+
+/**
+ *  @brief Wait until values are available, then pop up to @c max_vals values, calling a
+ *  function object with each.
+ *
+ *  The queue is polled at @c poll_interval while it is empty.
+ *
+ *  @return Number of values popped, 0 only when the queue is closed and empty.
+ */
+  template <typename F>
+  std::size_t wait_and_pop_batch(F&& func, std::size_t max_vals,
+                                 std::chrono::microseconds poll_interval =
+                                   std::chrono::microseconds(500)) {
+    while (true) {
+      // the closed flag is read first, values pushed before the close are still popped
+      bool closed = is_closed();
+      std::size_t cnt = pop_batch(func, max_vals);
+      if (cnt > 0u || closed) {
+        return cnt;
+      }
+      std::this_thread::sleep_for(poll_interval);
+    }
+  }
+
+/**
+ *  @brief Close the queue, further pushes fail (without counting as drops), values
+ *  already queued can still be popped.
+ */
+  void close() noexcept { m_closed.store(true, std::memory_order_release); }
+
+  void open() noexcept { m_closed.store(false, std::memory_order_release); }
+
+  bool is_closed() const noexcept { return m_closed.load(std::memory_order_acquire); }
+
+/**
+ *  @brief Number of values dropped because the queue was full, since construction.
+ */
+  std::size_t num_dropped() const noexcept {
+    return m_num_dropped.load(std::memory_order_relaxed);
+  }
+
+  std::size_t capacity() const noexcept { return m_mask + 1u; }
+
+/**
+ *  @brief Approximate number of queued values, exact when there are no concurrent pushes
+ *  or pops.
+ */
+  std::size_t size() const noexcept {
+    std::size_t enq = m_enq_pos.load(std::memory_order_acquire);
+    std::size_t deq = m_deq_pos.load(std::memory_order_acquire);
+    return (enq > deq) ? enq - deq : 0u;
+  }
+
+  bool empty() const noexcept { return size() == 0u; }
+
+};
+
+} // end net namespace
+} // end chops namespace
+
+#endif
+
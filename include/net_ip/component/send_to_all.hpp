@@ -45,6 +45,10 @@ namespace net {
  *  connections or UDP sockets will shared the same reference counted buffer, saving buffer 
  *  copies across all of the connections or UDP sockets.
  *
+ *  Congested @c basic_io_interface objects (see @c basic_io_interface @c is_output_congested
+ *  and @c set_output_queue_limits) can optionally be skipped when sending, so that one slow
+ *  receiver does not accumulate a growing queue of broadcast buffers.
+ *
  *  A function object operator overload is provided so that a @c std::ref to a @c send_to_all
  *  object can be used in composing function objects for @c io_state_change calls.
  *
@@ -61,6 +65,8 @@ private:
 private:
   mutable std::mutex    m_mutex;
   io_intfs              m_io_intfs;
+  bool                  m_skip_congested = false;
+  mutable std::size_t   m_num_skipped = 0;
 
 public:
 /**
@@ -99,6 +105,10 @@ public:
   void send(chops::const_shared_buffer buf) const {
     lock_guard gd { m_mutex };
     for (const auto& io : m_io_intfs) {
+      if (m_skip_congested && io.is_output_congested()) {
+        ++m_num_skipped;
+        continue;
+      }
       io.send(buf);
     }
   }
@@ -116,6 +126,23 @@ public:
   void send(chops::mutable_shared_buffer&& buf) const { 
     send(chops::const_shared_buffer(std::move(buf)));
   }
+/**
+ *  @brief Skip congested @c basic_io_interface objects in @c send calls, or not (the
+ *  default is to send to all).
+ */
+  void set_skip_congested(bool skip) {
+    lock_guard gd { m_mutex };
+    m_skip_congested = skip;
+  }
+
+/**
+ *  @brief Return the number of sends that were skipped due to congestion.
+ */
+  std::size_t get_num_skipped() const {
+    lock_guard gd { m_mutex };
+    return m_num_skipped;
+  }
+
 /**
  *  @brief Return the number of @c basic_io_interface objects in the collection.
  */
@@ -127,15 +154,15 @@ public:
 /**
  *  @brief Return the sum total of output queue statistics.
  *
- *  @return @c output_queue_stats object containing total counts.
+ *  @return @c output_queue_stats object containing total counts and a combined latency
+ *  histogram, except for the maximum values (write batch size, high-water marks, latency)
+ *  which are the largest of all the @c basic_io_interface objects.
  */
   auto get_total_output_queue_stats() const noexcept {
     chops::net::output_queue_stats tot { };
     lock_guard gd { m_mutex };
     for (const auto& io : m_io_intfs) {
-      auto qs = io.get_output_queue_stats();
-      tot.output_queue_size += qs.output_queue_size;
-      tot.bytes_in_output_queue += qs.bytes_in_output_queue;
+      accumulate_output_queue_stats(tot, io.get_output_queue_stats());
     }
     return tot;
   }
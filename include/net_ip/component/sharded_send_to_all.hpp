@@ -0,0 +1,241 @@
+/** @file
+ *
+ *  @ingroup net_ip_component_module
+ *
+ *  @brief Send to all for large fan-out, with a lock-free subscriber snapshot and the 
+ *  sends performed on the executors of the subscribers.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef SHARDED_SEND_TO_ALL_HPP_INCLUDED
+#define SHARDED_SEND_TO_ALL_HPP_INCLUDED
+
+#include <cstddef> // std::size_t
+#include <utility> // std::move
+#include <memory> // std::shared_ptr, std::atomic_load, std::atomic_store
+#include <algorithm> // std::find, std::max
+#include <mutex>
+#include <vector>
+
+#include <experimental/executor>
+#include <experimental/io_context>
+
+#include "net_ip/basic_io_interface.hpp"
+#include "net_ip/queue_stats.hpp"
+#include "net_ip/net_ip_error.hpp"
+
+#include "utility/shared_buffer.hpp"
+
+namespace chops {
+namespace net {
+
+/**
+ *  @brief Manage a (potentially very large) collection of @c basic_io_interface objects 
+ *  and send data to all of them without blocking on a lock.
+ *
+ *  @c send_to_all holds a lock while it loops over every @c basic_io_interface, which 
+ *  for tens of thousands of subscribers blocks other senders as well as adds and removes 
+ *  for a long time. This class instead keeps an immutable snapshot of the subscribers, 
+ *  replaced (copy-on-write) on each add or remove, so a @c send only loads the current 
+ *  snapshot and never takes a lock.
+ *
+ *  Subscribers are grouped by the @c io_context of their IO handler, and each group is 
+ *  split into chunks of at most @c max_chunk_size subscribers. A @c send posts one handler
+ *  per chunk to the chunk's @c io_context (through a strand, so buffers are delivered in 
+ *  @c send order), and the handler passes the buffer to each subscriber of the chunk. When 
+ *  the IO handlers are spread across the contexts of a @c worker_pool, the fan-out work is 
+ *  therefore sharded across the pool threads, and the @c send caller only pays for one 
+ *  post per chunk. Only the chunk that changes is copied on an add or remove.
+ *
+ *  Since delivery is asynchronous, a @c send may still reach a subscriber that is removed
+ *  right after the call; subscribers whose IO handler has gone away are skipped.
+ *
+ *  This class is thread-safe for concurrent access.
+ *
+ */
+template <typename IOT>
+class sharded_send_to_all {
+private:
+  using lock_guard = std::lock_guard<std::mutex>;
+  using io_intf    = basic_io_interface<IOT>;
+  using strand_type = 
+    std::experimental::net::strand<std::experimental::net::io_context::executor_type>;
+
+  // a copied chunk keeps the original strand (copies share the strand state), so 
+  // delivery order is preserved across snapshot changes
+  struct chunk {
+    std::experimental::net::io_context* m_ioc;
+    strand_type                         m_strand;
+    std::vector<io_intf>                m_io_intfs;
+  };
+
+  using chunk_ptr = std::shared_ptr<const chunk>;
+  using snapshot = std::vector<chunk_ptr>;
+  using snapshot_ptr = std::shared_ptr<const snapshot>;
+
+private:
+  std::size_t           m_max_chunk_size;
+  std::mutex            m_mutex; // serializes snapshot replacement only
+  snapshot_ptr          m_snapshot;
+
+public:
+/**
+ *  @brief Construct a @c sharded_send_to_all object.
+ *
+ *  @param max_chunk_size Maximum number of subscribers delivered to by one posted 
+ *  handler; smaller chunks spread the work over more threads when multiple threads run 
+ *  one @c io_context.
+ */
+  explicit sharded_send_to_all(std::size_t max_chunk_size = 256u) :
+    m_max_chunk_size(std::max(max_chunk_size, std::size_t(1u))), m_mutex(), 
+    m_snapshot(std::make_shared<const snapshot>()) { }
+
+  sharded_send_to_all(const sharded_send_to_all&) = delete;
+  sharded_send_to_all& operator=(const sharded_send_to_all&) = delete;
+
+/**
+ *  @brief Add a @c basic_io_interface object to the collection.
+ *
+ *  @throw A @c net_ip_exception is thrown if there is not an associated IO handler.
+ */
+  void add_io_interface(io_intf io) {
+    auto& ioc = io.get_socket().get_executor().context();
+    lock_guard gd { m_mutex };
+    auto snap = std::make_shared<snapshot>(*m_snapshot);
+    auto it = std::find_if(snap->begin(), snap->end(), [this, &ioc] (const chunk_ptr& c) {
+        return c->m_ioc == &ioc && c->m_io_intfs.size() < m_max_chunk_size;
+      }
+    );
+    if (it == snap->end()) {
+      snap->push_back(std::make_shared<const chunk>(chunk { &ioc, strand_type(ioc.get_executor()), 
+                                                            std::vector<io_intf> { io } }));
+    }
+    else {
+      auto c = std::make_shared<chunk>(**it);
+      c->m_io_intfs.push_back(io);
+      *it = c;
+    }
+    std::atomic_store(&m_snapshot, snapshot_ptr(std::move(snap)));
+  }
+
+/**
+ *  @brief Remove a @c basic_io_interface object from the collection.
+ */
+  void remove_io_interface(io_intf io) {
+    lock_guard gd { m_mutex };
+    auto snap = std::make_shared<snapshot>(*m_snapshot);
+    for (auto it = snap->begin(); it != snap->end(); ++it) {
+      auto f = std::find((*it)->m_io_intfs.cbegin(), (*it)->m_io_intfs.cend(), io);
+      if (f == (*it)->m_io_intfs.cend()) {
+        continue;
+      }
+      if ((*it)->m_io_intfs.size() == 1u) {
+        snap->erase(it);
+      }
+      else {
+        auto c = std::make_shared<chunk>(**it);
+        c->m_io_intfs.erase(c->m_io_intfs.begin() + (f - (*it)->m_io_intfs.cbegin()));
+        *it = c;
+      }
+      std::atomic_store(&m_snapshot, snapshot_ptr(std::move(snap)));
+      return;
+    }
+  }
+
+/**
+ *  @brief Interface for @c io_state_change parameter of @c start method.
+ */
+  void operator() (io_intf io, std::size_t, bool starting) {
+    if (starting) {
+      add_io_interface(io);
+    }
+    else {
+      remove_io_interface(io);
+    }
+  }
+
+/**
+ *  @brief Send a reference counted buffer to all @c basic_io_interface objects, 
+ *  without blocking.
+ */
+  void send(chops::const_shared_buffer buf) const {
+    auto snap = std::atomic_load(&m_snapshot);
+    for (const auto& c : *snap) {
+      std::experimental::net::post(c->m_strand, [c, buf] {
+          for (const auto& io : c->m_io_intfs) {
+            try {
+              io.send(buf);
+            }
+            catch (const net_ip_exception&) { } // IO handler has gone away
+          }
+        }
+      );
+    }
+  }
+
+/**
+ *  @brief Copy the bytes, create a reference counted buffer, then send it to
+ *  all @c basic_io_interface objects.
+ */
+  void send(const void* buf, std::size_t sz) const {
+    send(chops::const_shared_buffer(buf, sz));
+  }
+
+/**
+ *  @brief Move the buffer from a writable reference counted buffer to a 
+ *  immutable reference counted buffer, then send it.
+ */
+  void send(chops::mutable_shared_buffer&& buf) const { 
+    send(chops::const_shared_buffer(std::move(buf)));
+  }
+
+/**
+ *  @brief Return the number of @c basic_io_interface objects in the collection.
+ */
+  std::size_t size() const noexcept {
+    auto snap = std::atomic_load(&m_snapshot);
+    std::size_t sz = 0u;
+    for (const auto& c : *snap) {
+      sz += c->m_io_intfs.size();
+    }
+    return sz;
+  }
+
+/**
+ *  @brief Return the number of chunks, which is the number of handlers posted for 
+ *  each @c send.
+ */
+  std::size_t num_chunks() const noexcept {
+    return std::atomic_load(&m_snapshot)->size();
+  }
+
+/**
+ *  @brief Return the sum total of output queue statistics, see @c send_to_all.
+ */
+  auto get_total_output_queue_stats() const {
+    chops::net::output_queue_stats tot { };
+    auto snap = std::atomic_load(&m_snapshot);
+    for (const auto& c : *snap) {
+      for (const auto& io : c->m_io_intfs) {
+        if (!io.is_valid()) {
+          continue;
+        }
+        accumulate_output_queue_stats(tot, io.get_output_queue_stats());
+      }
+    }
+    return tot;
+  }
+};
+
+} // end net namespace
+} // end chops namespace
+
+#endif
+
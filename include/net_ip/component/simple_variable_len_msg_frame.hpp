@@ -10,6 +10,9 @@
  *  application provides a function that decodes the message header and returns the size 
  *  of the following message body. 
  *
+ *  The decoder is called through a function pointer; @c length_field_msg_frame.hpp has 
+ *  message frames where the header decoding is resolved at compile time.
+ *
  *  @note These functions are not a necessary dependency of the @c net_ip library,
  *  but are useful components in many use cases.
  *
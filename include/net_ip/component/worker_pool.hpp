@@ -0,0 +1,238 @@
+/** @file
+ *
+ *  @ingroup net_ip_component_module
+ *
+ *  @brief Multi-threaded executor and work guard class, the multiple thread
+ *  counterpart of @c worker.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef WORKER_POOL_HPP_INCLUDED
+#define WORKER_POOL_HPP_INCLUDED
+
+#include <thread>
+#include <vector>
+#include <memory> // std::unique_ptr
+#include <atomic>
+#include <functional> // std::function
+#include <cstddef> // std::size_t
+
+#include <exception>
+#include <iostream>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <experimental/io_context>
+#include <experimental/executor>
+
+namespace chops {
+namespace net {
+
+/**
+ *  @brief Convenience class that runs asynchronous operations on multiple threads,
+ *  in one of two modes.
+ *
+ *  In @c context_per_thread mode each thread runs its own @c io_context. Network
+ *  entities are created on one of the contexts (through @c get_io_context or
+ *  @c get_next_io_context), and a TCP acceptor can place each accepted connection on
+ *  the next context (round-robin) by constructing the @c net_ip object with the
+ *  selector from @c make_io_context_selector. Threads can optionally be pinned to CPUs
+ *  (thread @c i to CPU @c i, modulo the hardware concurrency), which is only supported
+ *  on Linux.
+ *
+ *  In @c shared_context mode one @c io_context is run by all of the threads. The
+ *  Chops Net IP IO handlers serialize their handlers with a strand, so any handler
+ *  can run on any thread of the pool.
+ *
+ *  @note This class is not a necessary dependency of the @c net_ip library, but
+ *  is provided for convenience in many use cases.
+ */
+class worker_pool {
+public:
+  enum class mode { context_per_thread, shared_context };
+
+  using io_context_selector = std::function<std::experimental::net::io_context& ()>;
+
+private:
+  using work_guard =
+    std::experimental::net::executor_work_guard<std::experimental::net::io_context::executor_type>;
+
+private:
+  std::vector<std::unique_ptr<std::experimental::net::io_context> >  m_iocs;
+  std::vector<work_guard>                                             m_wgs;
+  std::vector<std::thread>                                            m_run_thrs;
+  std::size_t                                                         m_num_threads;
+  bool                                                                m_pin_threads;
+  std::atomic_size_t                                                  m_next;
+
+public:
+
+/**
+ *  @brief Construct a @c worker_pool, without starting the threads.
+ *
+ *  @param num_threads Number of threads, 0 means one per hardware thread.
+ *
+ *  @param m Mode, either an @c io_context per thread or one shared @c io_context.
+ *
+ *  @param pin_threads If @c true, pin each thread to a CPU when started.
+ */
+  explicit worker_pool(std::size_t num_threads, mode m = mode::context_per_thread,
+                       bool pin_threads = false) :
+      m_iocs(), m_wgs(), m_run_thrs(), m_num_threads(num_threads), m_pin_threads(pin_threads),
+      m_next(0u) {
+    if (m_num_threads == 0u) {
+      m_num_threads = std::thread::hardware_concurrency();
+    }
+    m_num_threads = (m_num_threads == 0u) ? 1u : m_num_threads;
+    std::size_t num_iocs = (m == mode::context_per_thread) ? m_num_threads : 1u;
+    for (std::size_t i = 0u; i < num_iocs; ++i) {
+      m_iocs.push_back(std::make_unique<std::experimental::net::io_context>());
+      m_wgs.push_back(std::experimental::net::make_work_guard(*m_iocs.back()));
+    }
+  }
+
+  worker_pool(const worker_pool&) = delete;
+  worker_pool& operator=(const worker_pool&) = delete;
+
+/**
+ *  @brief Number of @c io_context objects, one for a shared context pool.
+ */
+  std::size_t size() const noexcept { return m_iocs.size(); }
+
+/**
+ *  @brief Number of threads.
+ */
+  std::size_t num_threads() const noexcept { return m_num_threads; }
+
+/**
+ *  @brief Provide access to a specific @c io_context.
+ *
+ *  @param idx Index of the @c io_context, modulo the number of contexts.
+ */
+  std::experimental::net::io_context& get_io_context(std::size_t idx = 0u) {
+    return *m_iocs[idx % m_iocs.size()];
+  }
+
+/**
+ *  @brief Provide access to all of the @c io_context objects, e.g. for the @c net_ip 
+ *  @c make_tcp_acceptor_sharded method.
+ */
+  std::vector<std::experimental::net::io_context*> get_io_contexts() {
+    std::vector<std::experimental::net::io_context*> iocs;
+    for (auto& ioc : m_iocs) {
+      iocs.push_back(ioc.get());
+    }
+    return iocs;
+  }
+
+/**
+ *  @brief Provide access to the next @c io_context, in round-robin order. This method
+ *  can be called concurrently.
+ */
+  std::experimental::net::io_context& get_next_io_context() {
+    return get_io_context(m_next++);
+  }
+
+/**
+ *  @brief Create a function object that returns the next @c io_context, for use with
+ *  the @c net_ip constructor that distributes accepted TCP connections.
+ *
+ *  The @c worker_pool must outlive any use of the function object.
+ */
+  io_context_selector make_io_context_selector() {
+    return [this] () -> std::experimental::net::io_context& { return get_next_io_context(); };
+  }
+
+/**
+ *  @brief Start the threads that invoke the underlying asynchronous operations.
+ */
+  void start() {
+    for (std::size_t i = 0u; i < m_num_threads; ++i) {
+      auto& ioc = get_io_context(i);
+      m_run_thrs.push_back(std::thread([&ioc] () {
+          try {
+            ioc.run();
+          }
+          catch (const std::exception& e) {
+            std::cerr << "std::exception caught in worker_pool::start: " << e.what() << std::endl;
+          }
+          catch (...) {
+            std::cerr << "Unknown exception caught in worker_pool::start" << std::endl;
+          }
+        }
+      ));
+      if (m_pin_threads) {
+        pin_thread(m_run_thrs.back(), i);
+      }
+    }
+  }
+
+/**
+ *  @brief Shutdown the executors and join the threads, abandoning any outstanding
+ *  operations or handlers.
+ */
+  void stop() {
+    for (auto& ioc : m_iocs) {
+      ioc->stop();
+    }
+    join();
+  }
+
+/**
+ *  @brief Reset the internal work guards and join the threads, waiting for outstanding
+ *  operations or handlers to complete.
+ */
+  void reset() {
+    for (auto& wg : m_wgs) {
+      wg.reset();
+    }
+    join();
+  }
+
+/**
+ *  @brief Pin a thread to a CPU.
+ *
+ *  @param thr Thread to pin.
+ *
+ *  @param cpu CPU index, modulo the hardware concurrency.
+ *
+ *  @return @c true if successful, @c false if it failed or is not supported on this platform.
+ */
+  static bool pin_thread(std::thread& thr, std::size_t cpu) {
+#ifdef __linux__
+    auto num_cpus = std::thread::hardware_concurrency();
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(static_cast<int>(num_cpus == 0u ? 0u : cpu % num_cpus), &cpus);
+    return pthread_setaffinity_np(thr.native_handle(), sizeof(cpu_set_t), &cpus) == 0;
+#else
+    return false;
+#endif
+  }
+
+private:
+
+  void join() {
+    for (auto& thr : m_run_thrs) {
+      thr.join();
+    }
+    m_run_thrs.clear();
+  }
+
+};
+
+}  // end net namespace
+}  // end chops namespace
+
+#endif
+
@@ -0,0 +1,109 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Delimiter search for delimiter based TCP message framing, resumable across
+ *  reads so buffered bytes are only searched once.
+ *
+ *  @note For internal use only.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef DELIMITER_SCANNER_HPP_INCLUDED
+#define DELIMITER_SCANNER_HPP_INCLUDED
+
+#include <cstddef> // std::size_t, std::byte
+#include <cstring> // std::memchr, std::memcmp
+#include <string>
+#include <string_view>
+
+namespace chops {
+namespace net {
+namespace detail {
+
+// find the first occurrence of a (non-empty) delimiter in a byte range, returning last if
+// not found; the first delimiter byte is found with memchr, which the standard libraries
+// implement with vectorized (SSE2 / AVX2 / NEON) compares, and any remaining delimiter bytes
+// are compared at each candidate
+inline const std::byte* find_delimiter(const std::byte* first, const std::byte* last,
+                                       std::string_view delim) noexcept {
+  const std::size_t delim_size = delim.size();
+  if (delim_size == 0u) {
+    return last;
+  }
+  while (static_cast<std::size_t>(last - first) >= delim_size) {
+    // candidates are only where the whole delimiter fits
+    auto p = static_cast<const std::byte*>(std::memchr(first, static_cast<unsigned char>(delim[0]),
+                    static_cast<std::size_t>(last - first) - delim_size + 1));
+    if (p == nullptr) {
+      return last;
+    }
+    if (delim_size == 1 || std::memcmp(p + 1, delim.data() + 1, delim_size - 1) == 0) {
+      return p;
+    }
+    first = p + 1;
+  }
+  return last;
+}
+
+// searches for the end of the current message, remembering how far the message has been
+// searched so that bytes are not searched again when more bytes arrive; a partial delimiter
+// at the end of the buffered bytes is searched again; an empty delimiter is rejected by
+// reset, and never matches
+class delimiter_scanner {
+private:
+  std::string    m_delim;
+  std::size_t    m_scanned;
+
+public:
+  delimiter_scanner() : m_delim(), m_scanned(0u) { }
+
+  explicit delimiter_scanner(std::string_view delim) : m_delim(delim), m_scanned(0u) { }
+
+  // false if the delimiter is empty, the previous delimiter is kept
+  bool reset(std::string_view delim) {
+    if (delim.empty()) {
+      return false;
+    }
+    m_delim = delim;
+    m_scanned = 0u;
+    return true;
+  }
+
+  const std::string& delimiter() const noexcept { return m_delim; }
+
+  // number of bytes of the current message already searched
+  std::size_t scanned() const noexcept { return m_scanned; }
+
+  // msg is the start of the current message, with num_bytes buffered; the return value is
+  // the size of the message including the delimiter, or 0 if the delimiter has not been found
+  // in which case the following call is for the same message, with at least as many bytes
+  std::size_t scan(const std::byte* msg, std::size_t num_bytes) noexcept {
+    const std::byte* last = msg + num_bytes;
+    const std::byte* p = find_delimiter(msg + m_scanned, last, m_delim);
+    if (p == last) {
+      if (m_delim.empty()) {
+        return 0u;
+      }
+      const std::size_t partial = m_delim.size() - 1u;
+      m_scanned = (num_bytes > partial) ? num_bytes - partial : m_scanned;
+      return 0u;
+    }
+    m_scanned = 0u;
+    return static_cast<std::size_t>(p - msg) + m_delim.size();
+  }
+};
+
+} // end detail namespace
+} // end net namespace
+} // end chops namespace
+
+#endif
+
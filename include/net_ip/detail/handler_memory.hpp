@@ -0,0 +1,161 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Recycled storage for asynchronous operations, attached to completion handlers 
+ *  as their associated allocator.
+ *
+ *  @note For internal use only.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef HANDLER_MEMORY_HPP_INCLUDED
+#define HANDLER_MEMORY_HPP_INCLUDED
+
+#include <cstddef> // std::size_t, std::max_align_t, std::byte
+#include <new> // operator new, operator delete
+#include <utility> // std::forward, std::move
+#include <type_traits> // std::decay_t
+
+namespace chops {
+namespace net {
+namespace detail {
+
+// storage for one chain of asynchronous operations (e.g. the read loop of an IO handler),
+// where at most one operation of the chain is outstanding at a time; the executor frees
+// the storage of a completed operation before its handler is invoked, so the next 
+// operation reuses the same slots and steady state reads or writes do not allocate
+//
+// a few slots are needed since dispatching a completion through a strand holds two 
+// allocations at once (the strand operation and the invoker posted to the io_context);
+// an allocation that is too large, or made while all slots are in use, falls back to 
+// the heap
+//
+// not thread-safe, all operations of a chain must be serialized (e.g. through a strand)
+class handler_memory {
+public:
+  static constexpr std::size_t slot_size = 320u;
+  static constexpr std::size_t num_slots = 3u;
+
+private:
+  struct slot {
+    alignas(std::max_align_t) std::byte m_storage[slot_size];
+  };
+
+private:
+  slot          m_slots[num_slots];
+  bool          m_in_use[num_slots];
+  std::size_t   m_num_heap; // allocations that fell back to the heap
+
+public:
+  handler_memory() noexcept : m_in_use(), m_num_heap(0u) { }
+
+  handler_memory(const handler_memory&) = delete;
+  handler_memory& operator=(const handler_memory&) = delete;
+
+  void* allocate(std::size_t sz) {
+    if (sz <= slot_size) {
+      for (std::size_t i = 0u; i < num_slots; ++i) {
+        if (!m_in_use[i]) {
+          m_in_use[i] = true;
+          return m_slots[i].m_storage;
+        }
+      }
+    }
+    ++m_num_heap;
+    return ::operator new(sz);
+  }
+
+  void deallocate(void* p) noexcept {
+    for (std::size_t i = 0u; i < num_slots; ++i) {
+      if (p == m_slots[i].m_storage) {
+        m_in_use[i] = false;
+        return;
+      }
+    }
+    ::operator delete(p);
+  }
+
+  std::size_t num_in_use() const noexcept {
+    std::size_t n = 0u;
+    for (auto b : m_in_use) {
+      n += b ? 1u : 0u;
+    }
+    return n;
+  }
+
+  std::size_t num_heap_allocations() const noexcept { return m_num_heap; }
+};
+
+// minimal allocator using a handler_memory, meets the Networking TS ProtoAllocator
+// requirements
+template <typename T>
+class handler_allocator {
+public:
+  using value_type = T;
+
+private:
+  handler_memory*  m_mem;
+
+  template <typename> friend class handler_allocator;
+
+public:
+  explicit handler_allocator(handler_memory& mem) noexcept : m_mem(&mem) { }
+
+  template <typename U>
+  handler_allocator(const handler_allocator<U>& other) noexcept : m_mem(other.m_mem) { }
+
+  T* allocate(std::size_t n) {
+    return static_cast<T*>(m_mem->allocate(sizeof(T) * n));
+  }
+
+  void deallocate(T* p, std::size_t) noexcept {
+    m_mem->deallocate(p);
+  }
+
+  template <typename U>
+  bool operator==(const handler_allocator<U>& rhs) const noexcept { return m_mem == rhs.m_mem; }
+
+  template <typename U>
+  bool operator!=(const handler_allocator<U>& rhs) const noexcept { return m_mem != rhs.m_mem; }
+};
+
+// completion handler wrapper providing the associated allocator
+template <typename H>
+class alloc_handler {
+public:
+  using allocator_type = handler_allocator<H>;
+
+private:
+  handler_memory*  m_mem;
+  H                m_handler;
+
+public:
+  alloc_handler(handler_memory& mem, H h) : m_mem(&mem), m_handler(std::move(h)) { }
+
+  allocator_type get_allocator() const noexcept { return allocator_type(*m_mem); }
+
+  template <typename ... Args>
+  void operator()(Args&& ... args) {
+    m_handler(std::forward<Args>(args)...);
+  }
+};
+
+template <typename H>
+alloc_handler<std::decay_t<H> > make_alloc_handler(handler_memory& mem, H&& h) {
+  return alloc_handler<std::decay_t<H> >(mem, std::forward<H>(h));
+}
+
+} // end detail namespace
+} // end net namespace
+} // end chops namespace
+
+#endif
+
@@ -0,0 +1,108 @@
+/** @file 
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Slot map of IO handlers with constant time insert and erase, for internal use.
+ *
+ *  @note For internal use only.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0. 
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef HANDLER_REGISTRY_HPP_INCLUDED
+#define HANDLER_REGISTRY_HPP_INCLUDED
+
+#include <vector>
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint32_t
+#include <utility> // std::move
+
+#include "net_ip/io_handler_id.hpp"
+
+namespace chops {
+namespace net {
+namespace detail {
+
+// P is a (shared) pointer type; not thread-safe, the owner serializes access
+template <typename P>
+class handler_registry {
+private:
+  struct slot {
+    P             m_ptr;
+    std::uint32_t m_generation;
+  };
+
+  std::vector<slot>          m_slots;
+  std::vector<std::uint32_t> m_free; // indices of empty slots, reused most recent first
+  std::size_t                m_size = 0;
+
+public:
+
+  io_handler_id insert(P ptr) {
+    std::uint32_t idx;
+    if (m_free.empty()) {
+      idx = static_cast<std::uint32_t>(m_slots.size());
+      m_slots.push_back(slot { P(), 0u });
+    }
+    else {
+      idx = m_free.back();
+      m_free.pop_back();
+    }
+    slot& s = m_slots[idx];
+    s.m_ptr = std::move(ptr);
+    if (++s.m_generation == 0u) { // 0 is reserved for no identifier
+      s.m_generation = 1u;
+    }
+    ++m_size;
+    return io_handler_id { idx, s.m_generation };
+  }
+
+  // false if the id is stale (already erased)
+  bool erase(const io_handler_id& id) {
+    if (!contains(id)) {
+      return false;
+    }
+    m_slots[id.index].m_ptr = P();
+    m_free.push_back(id.index);
+    --m_size;
+    return true;
+  }
+
+  bool contains(const io_handler_id& id) const noexcept {
+    return id.is_valid() && id.index < m_slots.size() && 
+           m_slots[id.index].m_generation == id.generation && m_slots[id.index].m_ptr;
+  }
+
+  P find(const io_handler_id& id) const {
+    return contains(id) ? m_slots[id.index].m_ptr : P();
+  }
+
+  std::size_t size() const noexcept { return m_size; }
+
+  bool empty() const noexcept { return m_size == 0u; }
+
+  // the function object may erase entries (including the current one) while iterating,
+  // entries inserted during the iteration may or may not be visited
+  template <typename F>
+  void for_each(F&& func) const {
+    for (std::size_t i = 0u; i < m_slots.size(); ++i) {
+      if (P p = m_slots[i].m_ptr) {
+        func(p);
+      }
+    }
+  }
+
+};
+
+} // end detail namespace
+} // end net namespace
+} // end chops namespace
+
+#endif
+
@@ -22,41 +22,215 @@
 #include <system_error>
 #include <functional> // std::function, used for type erased notifications to net_entity objects
 #include <memory> // std::shared_ptr
+#include <vector>
+#include <cstddef> // std::size_t
+#include <cstdint> // std::int64_t
+#include <type_traits> // std::is_invocable_r_v, std::decay_t, std::conditional_t
+#include <utility> // std::move, std::forward
 
 #include <experimental/internet>
 #include <experimental/buffer>
 
 #include "net_ip/detail/output_queue.hpp"
 #include "net_ip/queue_stats.hpp"
+#include "net_ip/basic_io_interface.hpp"
+#include "net_ip/basic_io_ref.hpp"
+#include "net_ip/output_queue_limits.hpp"
+#include "net_ip/send_priority.hpp"
+#include "net_ip/instrumentation.hpp"
+#include "net_ip/receive_timestamp.hpp"
+#include "net_ip/net_ip_metrics.hpp"
+#include "net_ip/net_ip_error.hpp"
 #include "utility/shared_buffer.hpp"
 
 namespace chops {
 namespace net {
 namespace detail {
 
+// a message handler is called with the buffer, the IO handler and the endpoint, and 
+// optionally a receive_timestamp as a fourth parameter
+template <typename MH, typename B, typename IO, typename E>
+constexpr bool msg_hdlr_invocable = 
+  std::is_invocable_r_v<bool, std::decay_t<MH>&, B, IO, E> ||
+  std::is_invocable_r_v<bool, std::decay_t<MH>&, B, IO, E, const receive_timestamp&>;
+
+// message handlers that take a basic_io_ref as the second parameter (instead of a 
+// basic_io_interface) are given a borrowed reference to the IO handler, with no 
+// reference count operations per message
+template <typename MH, typename IOT>
+constexpr bool msg_hdlr_takes_io_ref = 
+  msg_hdlr_invocable<MH, std::experimental::net::const_buffer, 
+                     basic_io_ref<IOT>, typename IOT::endpoint_type> ||
+  msg_hdlr_invocable<MH, chops::const_shared_buffer, 
+                     basic_io_ref<IOT>, typename IOT::endpoint_type>;
+
+template <typename MH, typename IOT>
+using msg_hdlr_io_type = std::conditional_t<msg_hdlr_takes_io_ref<MH, IOT>, 
+                                            basic_io_ref<IOT>, basic_io_interface<IOT> >;
+
+// message handlers that take a chops::const_shared_buffer as the first parameter (instead of
+// a const_buffer) are given ownership of the incoming message bytes, so replies, forwarding,
+// or queueing to other threads do not need a copy
+template <typename MH, typename IOT>
+constexpr bool msg_hdlr_takes_shared_buffer = 
+  msg_hdlr_invocable<MH, chops::const_shared_buffer, 
+                     msg_hdlr_io_type<MH, IOT>, typename IOT::endpoint_type>;
+
+// message handlers that take a receive_timestamp as the fourth parameter are given the 
+// kernel and network device receive times of the message
+template <typename MH, typename IOT>
+constexpr bool msg_hdlr_takes_timestamp = 
+  std::is_invocable_r_v<bool, std::decay_t<MH>&, 
+                        std::conditional_t<msg_hdlr_takes_shared_buffer<MH, IOT>,
+                                           chops::const_shared_buffer, 
+                                           std::experimental::net::const_buffer>,
+                        msg_hdlr_io_type<MH, IOT>, typename IOT::endpoint_type,
+                        const receive_timestamp&>;
+
+// the second message handler argument, called within the IO handler so a borrowed
+// reference is safe
+template <typename MH, typename IOT>
+msg_hdlr_io_type<MH, IOT> make_msg_hdlr_io(IOT& ioh) {
+  if constexpr (msg_hdlr_takes_io_ref<MH, IOT>) {
+    return basic_io_ref<IOT>(ioh);
+  }
+  else {
+    return basic_io_interface<IOT>(ioh.weak_from_this());
+  }
+}
+
+// the message handler call, with the timestamp only if the message handler takes one
+template <typename MH, typename IOT, typename B>
+bool call_msg_hdlr(MH& msg_hdlr, B&& buf, IOT& ioh, const typename IOT::endpoint_type& endp,
+                   const receive_timestamp& ts) {
+  if constexpr (msg_hdlr_takes_timestamp<MH, IOT>) {
+    return msg_hdlr(std::forward<B>(buf), make_msg_hdlr_io<MH>(ioh), endp, ts);
+  }
+  else {
+    return msg_hdlr(std::forward<B>(buf), make_msg_hdlr_io<MH>(ioh), endp);
+  }
+}
+
+// move the read buffer into a shared buffer without copying the message bytes; bytes 
+// past num_bytes (already read but belonging to the next message) are kept in the 
+// read buffer
+inline chops::const_shared_buffer 
+    move_to_shared_buffer(chops::mutable_shared_buffer::byte_vec& bv, std::size_t num_bytes) {
+  chops::mutable_shared_buffer mb(std::move(bv));
+  bv.clear();
+  if (num_bytes < mb.size()) {
+    bv.assign(mb.data() + num_bytes, mb.data() + mb.size());
+    mb.resize(num_bytes);
+  }
+  return chops::const_shared_buffer(std::move(mb));
+}
+
+// the output queue buffer type, a chops::const_shared_buffer unless the IO handler 
+// declares an out_buffer_type (e.g. to also queue file segments)
+template <typename IOT, typename = void>
+struct out_buffer_of {
+  using type = chops::const_shared_buffer;
+};
+
+template <typename IOT>
+struct out_buffer_of<IOT, std::void_t<typename IOT::out_buffer_type> > {
+  using type = typename IOT::out_buffer_type;
+};
+
 template <typename IOT>
 class io_common {
 private:
   using endp_type = typename IOT::endpoint_type;
 
 public:
-  using outq_type = output_queue<typename IOT::endpoint_type>;
+  using out_buf_type = typename out_buffer_of<IOT>::type;
+  using outq_type = output_lanes<typename IOT::endpoint_type, out_buf_type>;
+  using outq_el = typename outq_type::queue_element;
   using outq_opt_el = typename outq_type::opt_queue_element;
   using queue_stats = chops::net::output_queue_stats;
 
 private:
 
   std::atomic_bool     m_io_started; // may be called from multiple threads concurrently
-  bool                 m_write_in_progress; // internal only, doesn't need to be atomic
+  std::atomic_bool     m_write_in_progress; // claimed by producers, released by the io handler
   outq_type            m_outq;
+  std::atomic_size_t   m_queued_while_busy;
+  std::atomic_size_t   m_msgs_received;
+  std::atomic_size_t   m_bytes_received;
+  std::atomic_size_t   m_read_buf_bytes;
+  std::atomic_size_t   m_max_read_buf_bytes;
+  // output queue limits, read by producers
+  std::atomic_size_t               m_max_bufs;
+  std::atomic_size_t               m_max_bytes;
+  std::atomic_size_t               m_high_watermark;
+  std::atomic_size_t               m_low_watermark;
+  std::atomic<overflow_policy>     m_policy;
+  std::atomic_size_t               m_num_dropped;
+  // set by producers, the io handler performs the overflow policy or notification
+  std::atomic_bool                 m_overflow;
+  std::atomic_bool                 m_notify_high;
+  std::atomic_bool                 m_above_high;
+  std::atomic_bool                 m_events_posted;
+  // only accessed by the io handler; the buffers taken for the current write, and the
+  // output queue depth last added to the metrics registry gauges
+  std::size_t                      m_taken_bufs;
+  std::size_t                      m_taken_bytes;
+  std::int64_t                     m_metric_bufs;
+  std::int64_t                     m_metric_bytes;
 
 public:
 
   explicit io_common() noexcept :
-    m_io_started(false), m_write_in_progress(false), m_outq() { }
+    m_io_started(false), m_write_in_progress(false), m_outq(), 
+    m_queued_while_busy(0), m_msgs_received(0), m_bytes_received(0),
+    m_read_buf_bytes(0), m_max_read_buf_bytes(0),
+    m_max_bufs(0), m_max_bytes(0), m_high_watermark(0), m_low_watermark(0),
+    m_policy(overflow_policy::drop_newest), m_num_dropped(0), 
+    m_overflow(false), m_notify_high(false), m_above_high(false), m_events_posted(false),
+    m_taken_bufs(0), m_taken_bytes(0), m_metric_bufs(0), m_metric_bytes(0) { }
+
+  ~io_common() {
+    record_metric(net_metric::output_queue_bufs, -m_metric_bufs);
+    record_metric(net_metric::output_queue_bytes, -m_metric_bytes);
+  }
+
+  io_common(const io_common&) = delete;
+  io_common& operator=(const io_common&) = delete;
+
+  // the following methods can be called concurrently
+  queue_stats get_output_queue_stats() const noexcept { 
+    auto qs = m_outq.get_queue_stats();
+    qs.num_queued_while_busy = m_queued_while_busy;
+    qs.total_msgs_received = m_msgs_received;
+    qs.total_bytes_received = m_bytes_received;
+    qs.num_dropped = m_num_dropped;
+    qs.read_buffer_bytes = m_read_buf_bytes;
+    qs.max_read_buffer_bytes = m_max_read_buf_bytes;
+    return qs;
+  }
 
-  // the following four methods can be called concurrently
-  queue_stats get_output_queue_stats() const noexcept { return m_outq.get_queue_stats(); }
+  // stats of one lane, the received totals and the busy and dropped counts are only 
+  // kept in the aggregate stats
+  queue_stats get_output_queue_stats(send_priority pri) const noexcept { 
+    return m_outq.get_lane_stats(pri);
+  }
+
+  void set_send_lane_policy(const send_lane_policy& pol) noexcept { 
+    m_outq.set_lane_policy(pol);
+  }
+
+  void set_output_queue_limits(const output_queue_limits& lim) noexcept {
+    m_max_bufs = lim.max_bufs;
+    m_max_bytes = lim.max_bytes;
+    m_high_watermark = lim.high_watermark;
+    m_low_watermark = lim.low_watermark;
+    m_policy = lim.policy;
+  }
+
+  bool is_output_congested() const noexcept { return m_above_high || would_exceed_limits(0); }
+
+  // can also be called concurrently, bytes in the output queue (not yet handed to a write)
+  std::size_t num_queued_bytes() const noexcept { return m_outq.num_bytes(); }
 
   bool is_io_started() const noexcept { return m_io_started; }
 
@@ -70,53 +244,272 @@ public:
     return m_io_started.compare_exchange_strong(expected, false); 
   }
 
+  // enqueue from any thread, true is returned if the caller claimed the (idle) writer, 
+  // in which case the caller must post a handler that starts the write from the queue
+  bool enqueue_element(out_buf_type, send_priority = send_priority::normal);
+  bool enqueue_element(out_buf_type, const endp_type&, 
+                       send_priority = send_priority::normal);
+
+  // true if the caller (a producer that did not claim the writer) must post a handler 
+  // that calls process_queue_events
+  bool claim_queue_events() noexcept {
+    return (m_overflow || m_notify_high) && !m_events_posted.exchange(true);
+  }
+
   // rest of these method called only from within run thread
   bool is_write_in_progress() const noexcept { return m_write_in_progress; }
 
-  bool start_write_setup(const chops::const_shared_buffer&);
-  bool start_write_setup(const chops::const_shared_buffer&, const endp_type&);
+  // performs the overflow policy and calls the notify function object (taking a 
+  // std::error_code) for watermark crossings; false is returned if the io handler is 
+  // to be shut down (disconnect policy)
+  template <typename F>
+  bool process_queue_events(F&& notify);
+
+  bool start_write_setup(const out_buf_type&);
+  bool start_write_setup(const out_buf_type&, const endp_type&);
 
   outq_opt_el get_next_element();
 
+  template <typename T>
+  std::size_t get_next_elements(std::vector<T>&, std::size_t, std::size_t);
+
+  // called when the write of the previously returned element or elements completes
+  void write_complete() {
+    m_outq.write_complete();
+    if (m_taken_bufs != 0) {
+      record_metric(net_metric::bufs_sent, static_cast<std::int64_t>(m_taken_bufs));
+      record_metric(net_metric::bytes_sent, static_cast<std::int64_t>(m_taken_bytes));
+      m_taken_bufs = 0;
+      m_taken_bytes = 0;
+    }
+  }
+
+  // called for each message passed to the message handler
+  void msg_received(std::size_t num_bytes) noexcept {
+    ++m_msgs_received;
+    m_bytes_received += num_bytes;
+    record_metric(net_metric::msgs_received);
+    record_metric(net_metric::bytes_received, static_cast<std::int64_t>(num_bytes));
+  }
+
+  // called by the io handler when the capacity of its read buffers changes
+  void read_buffer_changed(std::size_t num_bytes) noexcept {
+    m_read_buf_bytes.store(num_bytes, std::memory_order_relaxed);
+    if (num_bytes > m_max_read_buf_bytes.load(std::memory_order_relaxed)) {
+      m_max_read_buf_bytes.store(num_bytes, std::memory_order_relaxed);
+    }
+  }
+
+private:
+
+  bool claim_writer() noexcept { return !m_write_in_progress.exchange(true); }
+
+  static std::size_t elem_size(const out_buf_type& buf) noexcept { return buf.size(); }
+  static std::size_t elem_size(const outq_el& elem) noexcept { return elem.first.size(); }
+
+  void buf_taken(std::size_t num_bytes) noexcept {
+    ++m_taken_bufs;
+    m_taken_bytes += num_bytes;
+  }
+
+  // the gauges are updated by the change since the previous update, only by the io
+  // handler, so producers do not touch the metrics registry when queueing
+  void update_queue_metrics() noexcept {
+    auto bufs = static_cast<std::int64_t>(m_outq.size());
+    auto bytes = static_cast<std::int64_t>(m_outq.num_bytes());
+    if (bufs != m_metric_bufs || bytes != m_metric_bytes) {
+      record_metric(net_metric::output_queue_bufs, bufs - m_metric_bufs);
+      record_metric(net_metric::output_queue_bytes, bytes - m_metric_bytes);
+      m_metric_bufs = bufs;
+      m_metric_bytes = bytes;
+    }
+  }
+
+  bool would_exceed_limits(std::size_t buf_size) const noexcept {
+    std::size_t mb = m_max_bufs;
+    std::size_t mx = m_max_bytes;
+    return (mb != 0 && m_outq.size() >= mb) || (mx != 0 && (m_outq.num_bytes() + buf_size) > mx);
+  }
+
+  bool exceeds_limits() const noexcept {
+    std::size_t mb = m_max_bufs;
+    std::size_t mx = m_max_bytes;
+    return (mb != 0 && m_outq.size() > mb) || (mx != 0 && m_outq.num_bytes() > mx);
+  }
+
+  // false if the buf is to be dropped
+  bool check_limits(std::size_t) noexcept;
+
+  bool claim_after_add() noexcept;
+
+  bool release_writer() noexcept;
+
 };
 
 template <typename IOT>
-bool io_common<IOT>::start_write_setup(const chops::const_shared_buffer& buf) {
+bool io_common<IOT>::enqueue_element(out_buf_type buf, send_priority pri) {
+  if (!m_io_started) {
+    return false; // shutdown happening or not io_started, don't queue
+  }
+  if (!check_limits(buf.size())) {
+    return false;
+  }
+  instrument(io_event::write_queued, buf.size());
+  // must be visible before the claim, see release_writer
+  m_outq.add_element(std::move(buf), pri);
+  return claim_after_add();
+}
+
+template <typename IOT>
+bool io_common<IOT>::enqueue_element(out_buf_type buf, 
+                                     const endp_type& endp, send_priority pri) {
+  if (!m_io_started) {
+    return false; // shutdown happening or not io_started, don't queue
+  }
+  if (!check_limits(buf.size())) {
+    return false;
+  }
+  instrument(io_event::write_queued, buf.size());
+  m_outq.add_element(std::move(buf), endp, pri);
+  return claim_after_add();
+}
+
+template <typename IOT>
+bool io_common<IOT>::check_limits(std::size_t buf_size) noexcept {
+  if (!would_exceed_limits(buf_size)) {
+    return true;
+  }
+  if (m_policy == overflow_policy::drop_newest) {
+    ++m_num_dropped;
+    record_metric(net_metric::bufs_dropped);
+    return false;
+  }
+  m_overflow = true; // rest of the policies are performed by the io handler
+  return true;
+}
+
+template <typename IOT>
+bool io_common<IOT>::claim_after_add() noexcept {
+  std::size_t hw = m_high_watermark;
+  if (hw != 0 && !m_above_high && m_outq.num_bytes() >= hw && !m_above_high.exchange(true)) {
+    m_notify_high = true;
+  }
+  if (claim_writer()) {
+    return true;
+  }
+  ++m_queued_while_busy;
+  return false;
+}
+
+template <typename IOT>
+template <typename F>
+bool io_common<IOT>::process_queue_events(F&& notify) {
+  m_events_posted = false;
+  if (m_overflow.exchange(false)) {
+    switch (m_policy.load()) {
+    case overflow_policy::drop_oldest:
+      while (exceeds_limits() && m_outq.drop_next_element()) {
+        ++m_num_dropped;
+        record_metric(net_metric::bufs_dropped);
+      }
+      break;
+    case overflow_policy::coalesce:
+      while (m_outq.size() > 1 && m_outq.drop_next_element()) {
+        ++m_num_dropped;
+        record_metric(net_metric::bufs_dropped);
+      }
+      break;
+    case overflow_policy::disconnect:
+      return false;
+    default:
+      break;
+    }
+  }
+  if (m_notify_high.exchange(false)) {
+    notify(std::make_error_code(net_ip_errc::output_queue_high_watermark));
+  }
+  if (m_above_high && m_outq.num_bytes() <= m_low_watermark && m_above_high.exchange(false)) {
+    notify(std::make_error_code(net_ip_errc::output_queue_low_watermark));
+  }
+  return true;
+}
+
+// called when the queue has been found empty; the flag is cleared then the queue is 
+// checked again, since a producer may have enqueued after the empty check but seen the 
+// flag still set; sequentially consistent ordering on both sides guarantees that either 
+// the producer claims the writer or this check sees the element; true is returned if 
+// the writer was reclaimed and the queue is to be serviced again
+template <typename IOT>
+bool io_common<IOT>::release_writer() noexcept {
+  m_write_in_progress = false;
+  return !m_outq.empty() && claim_writer();
+}
+
+template <typename IOT>
+bool io_common<IOT>::start_write_setup(const out_buf_type& buf) {
   if (!m_io_started) {
     return false; // shutdown happening or not io_started, don't start a write
   }
-  if (m_write_in_progress) { // queue buffer
+  if (!claim_writer()) { // queue buffer
+    ++m_queued_while_busy;
     m_outq.add_element(buf);
     return false;
   }
-  m_write_in_progress = true;
   return true;
 }
 
 template <typename IOT>
-bool io_common<IOT>::start_write_setup(const chops::const_shared_buffer& buf, 
+bool io_common<IOT>::start_write_setup(const out_buf_type& buf, 
                                        const endp_type& endp) {
   if (!m_io_started) {
     return false; // shutdown happening or not io_started, don't start a write
   }
-  if (m_write_in_progress) { // queue buffer
+  if (!claim_writer()) { // queue buffer
+    ++m_queued_while_busy;
     m_outq.add_element(buf, endp);
     return false;
   }
-  m_write_in_progress = true;
   return true;
 }
 
 template <typename IOT>
 typename io_common<IOT>::outq_opt_el io_common<IOT>::get_next_element() {
   if (!m_io_started) { // shutting down
+    m_write_in_progress = false;
     return outq_opt_el { };
   }
   auto elem = m_outq.get_next_element();
-  m_write_in_progress = elem.has_value();
+  if (!elem && release_writer()) {
+    elem = m_outq.get_next_element();
+  }
+  if (elem) {
+    buf_taken(elem->first.size());
+  }
+  update_queue_metrics();
   return elem;
 }
 
+// T is either the buffer type or a queue element (buffer and endpoint)
+template <typename IOT>
+template <typename T>
+std::size_t io_common<IOT>::get_next_elements(std::vector<T>& bufs,
+                                              std::size_t max_bufs, std::size_t max_bytes) {
+  if (!m_io_started) { // shutting down
+    m_write_in_progress = false;
+    return 0;
+  }
+  auto first = bufs.size();
+  auto cnt = m_outq.get_next_elements(bufs, max_bufs, max_bytes);
+  if (cnt == 0 && release_writer()) {
+    cnt = m_outq.get_next_elements(bufs, max_bufs, max_bytes);
+  }
+  for (auto i = first; i < bufs.size(); ++i) {
+    buf_taken(elem_size(bufs[i]));
+  }
+  update_queue_metrics();
+  return cnt;
+}
+
 } // end detail namespace
 } // end net namespace
 } // end chops namespace
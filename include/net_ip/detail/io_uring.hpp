@@ -0,0 +1,391 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Minimal Linux @c io_uring wrapper for multishot datagram receives, for
+ *  internal use.
+ *
+ *  The ring is set up with the raw system calls (no @c liburing dependency). A single
+ *  multishot @c recvmsg request is kept armed on a registered (fixed) socket, and the
+ *  kernel picks the receive buffers from a registered buffer ring, so one submission
+ *  delivers any number of datagrams without further system calls. The ring file
+ *  descriptor is readable when completions are available, which allows it to be
+ *  waited on through the Networking TS reactor.
+ *
+ *  The completion queue has room for a completion per buffer plus the final completion
+ *  of the request. Completions that still do not fit are kept by the kernel and flushed
+ *  into the queue while draining; if the kernel had to drop a completion (which may be
+ *  the one ending the request) the receive is cancelled and armed again.
+ *
+ *  Multishot receives need Linux 6.0 or later. Everything in this file is only
+ *  available when @c IORING_RECV_MULTISHOT is defined by the kernel headers.
+ *
+ *  @note For internal use only.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef IO_URING_HPP_INCLUDED
+#define IO_URING_HPP_INCLUDED
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+
+#ifdef IORING_RECV_MULTISHOT
+
+#include <system_error>
+#include <vector>
+#include <cstddef> // std::size_t, std::byte
+#include <cstdint> // std::uint64_t
+#include <cerrno>
+#include <utility> // std::forward
+
+#include <unistd.h> // syscall, close
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/socket.h> // msghdr
+#include <netinet/in.h> // sockaddr_in6
+
+namespace chops {
+namespace net {
+namespace detail {
+
+class uring_multishot_recv {
+private:
+  // room for both IPv4 and IPv6 sender addresses
+  static constexpr unsigned int name_size = sizeof(::sockaddr_in6);
+  static constexpr unsigned int sq_entries = 4u;
+  static constexpr unsigned short buf_group = 0u;
+  static constexpr unsigned int max_bufs = 32768u;
+
+  int                  m_ring_fd = -1;
+  ::io_uring_params    m_params { };
+  void*                m_sq_ptr = MAP_FAILED;
+  std::size_t          m_sq_size = 0u;
+  void*                m_cq_ptr = MAP_FAILED;
+  std::size_t          m_cq_size = 0u;
+  ::io_uring_sqe*      m_sqes = static_cast<::io_uring_sqe*>(MAP_FAILED);
+  std::size_t          m_sqes_size = 0u;
+  // the buffer ring entries are accessed directly, the io_uring_buf_ring flexible array
+  // member is not at offset 0 when the kernel header is compiled as C++; the ring tail
+  // overlaps the reserved field of the first entry
+  ::io_uring_buf*      m_buf_ring = static_cast<::io_uring_buf*>(MAP_FAILED);
+  std::size_t          m_buf_ring_size = 0u;
+  unsigned int         m_num_bufs = 0u;
+  std::size_t          m_buf_size = 0u;
+  std::vector<std::byte> m_bufs;
+  unsigned short       m_buf_tail = 0u;
+  // read by the kernel when the multishot request is armed
+  ::msghdr             m_msg { };
+  // user data of the armed request, completions of an earlier (cancelled) request are
+  // delivered but do not end or re-arm the receive; 0 is used for cancel requests
+  std::uint64_t        m_gen = 0u;
+  // completions dropped by the kernel, as last seen
+  unsigned int         m_dropped = 0u;
+
+public:
+  // num_bufs is rounded up to a power of 2, each buffer holds a datagram of max_size
+  // bytes plus the sender address; throws a std::system_error if the ring cannot be set up
+  uring_multishot_recv(int sock_fd, std::size_t num_bufs, std::size_t max_size) {
+    try {
+      m_num_bufs = 1u;
+      while (m_num_bufs < num_bufs && m_num_bufs < max_bufs) {
+        m_num_bufs <<= 1u;
+      }
+      setup_ring();
+      register_socket(sock_fd);
+      setup_bufs(max_size);
+    }
+    catch (...) {
+      release();
+      throw;
+    }
+    m_msg.msg_namelen = name_size;
+  }
+
+  ~uring_multishot_recv() { release(); }
+
+private:
+  uring_multishot_recv(const uring_multishot_recv&) = delete;
+  uring_multishot_recv(uring_multishot_recv&&) = delete;
+  uring_multishot_recv& operator=(const uring_multishot_recv&) = delete;
+  uring_multishot_recv& operator=(uring_multishot_recv&&) = delete;
+
+public:
+
+  // readable when completions are available
+  int ring_fd() const noexcept { return m_ring_fd; }
+
+  // including completions that did not fit in the completion queue
+  bool has_completions() const noexcept {
+    return load_acquire(cq_field(m_params.cq_off.tail)) != *cq_field(m_params.cq_off.head) ||
+           (load_acquire(sq_field(m_params.sq_off.flags)) & IORING_SQ_CQ_OVERFLOW);
+  }
+
+  // submit the multishot receive, also needed after the kernel ends it (e.g. when all
+  // buffers are in use)
+  std::error_code arm() noexcept {
+    push_recv();
+    return enter(1u);
+  }
+
+  // process the available completions; for each datagram f is called with
+  // (const std::byte* data, std::size_t size, const void* name, std::size_t name_size)
+  // and returns false to stop processing; the buffer is given back to the kernel after
+  // f returns, and the receive is re-armed if needed; returns false if f returned false,
+  // ec is set for a receive error
+  template <typename F>
+  bool drain(F&& func, std::error_code& ec) {
+    auto* head_ptr = cq_field(m_params.cq_off.head);
+    unsigned int mask = *cq_field(m_params.cq_off.ring_mask);
+    auto* cqes = reinterpret_cast<::io_uring_cqe*>(static_cast<char*>(m_cq_ptr) +
+                                                    m_params.cq_off.cqes);
+    bool rearm = false;
+    ec.clear();
+    for (;;) {
+      unsigned int head = *head_ptr;
+      unsigned int tail = load_acquire(cq_field(m_params.cq_off.tail));
+      while (head != tail) {
+        ::io_uring_cqe cqe = cqes[head & mask];
+        ++head;
+        bool current = (cqe.user_data == m_gen);
+        if (current && !(cqe.flags & IORING_CQE_F_MORE)) {
+          rearm = true;
+        }
+        if (cqe.res < 0) {
+          // ENOBUFS, all buffers are in use until this drain; an earlier request ends 
+          // with ECANCELED
+          if (current && cqe.res != -ENOBUFS) {
+            store_release(head_ptr, head);
+            ec = std::error_code(-cqe.res, std::system_category());
+            return true;
+          }
+          continue;
+        }
+        if (!(cqe.flags & IORING_CQE_F_BUFFER)) {
+          continue;
+        }
+        unsigned short bid = static_cast<unsigned short>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+        std::byte* buf = m_bufs.data() + bid * m_buf_size;
+        bool ok = deliver(buf, static_cast<std::size_t>(cqe.res), func);
+        recycle_buf(bid);
+        if (!ok) {
+          store_release(head_ptr, head);
+          return false;
+        }
+      }
+      store_release(head_ptr, head);
+      // completions that did not fit are flushed into the queue by an enter
+      if (!(load_acquire(sq_field(m_params.sq_off.flags)) & IORING_SQ_CQ_OVERFLOW)) {
+        break;
+      }
+      ec = enter(0u);
+      if (ec) {
+        return true;
+      }
+    }
+    unsigned int dropped = load_acquire(cq_field(m_params.cq_off.overflow));
+    if (dropped != m_dropped && !rearm) {
+      // the completion ending the request may be lost, a new request replaces it
+      m_dropped = dropped;
+      push_cancel();
+      push_recv();
+      ec = enter(2u);
+      return true;
+    }
+    m_dropped = dropped;
+    if (rearm) {
+      ec = arm();
+    }
+    return true;
+  }
+
+private:
+
+  ::io_uring_sqe& push_sqe() noexcept {
+    unsigned int tail = *sq_field(m_params.sq_off.tail);
+    unsigned int idx = tail & *sq_field(m_params.sq_off.ring_mask);
+    ::io_uring_sqe& sqe = m_sqes[idx];
+    sqe = ::io_uring_sqe { };
+    sq_field(m_params.sq_off.array)[idx] = idx;
+    store_release(sq_field(m_params.sq_off.tail), tail + 1u);
+    return sqe;
+  }
+
+  void push_recv() noexcept {
+    ::io_uring_sqe& sqe = push_sqe();
+    sqe.opcode = IORING_OP_RECVMSG;
+    sqe.fd = 0; // index into the registered file table
+    sqe.flags = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+    sqe.ioprio = IORING_RECV_MULTISHOT;
+    sqe.addr = reinterpret_cast<std::uint64_t>(&m_msg);
+    sqe.len = 1u;
+    sqe.buf_group = buf_group;
+    sqe.user_data = ++m_gen;
+  }
+
+  void push_cancel() noexcept {
+    ::io_uring_sqe& sqe = push_sqe();
+    sqe.opcode = IORING_OP_ASYNC_CANCEL;
+    sqe.fd = -1;
+    sqe.addr = m_gen;
+    sqe.user_data = 0u;
+  }
+
+  // submits the pushed entries, without waiting; the get events flag also flushes 
+  // completions that did not fit in the completion queue
+  std::error_code enter(unsigned int num) noexcept {
+    while (::syscall(__NR_io_uring_enter, m_ring_fd, num, 0u, IORING_ENTER_GETEVENTS, 
+                     nullptr, 0u) < 0) {
+      if (errno != EINTR) {
+        return std::error_code(errno, std::system_category());
+      }
+    }
+    return std::error_code();
+  }
+
+  // the kernel places an io_uring_recvmsg_out header, the name area and the payload
+  // in each buffer; a truncated datagram is delivered as received
+  template <typename F>
+  bool deliver(std::byte* buf, std::size_t res, F& func) {
+    constexpr std::size_t hdr_size = sizeof(::io_uring_recvmsg_out) + name_size;
+    if (res < hdr_size) {
+      return true;
+    }
+    auto* out = reinterpret_cast<::io_uring_recvmsg_out*>(buf);
+    std::size_t nlen = (out->namelen < name_size) ? out->namelen : name_size;
+    return func(static_cast<const std::byte*>(buf + hdr_size), res - hdr_size,
+                static_cast<const void*>(buf + sizeof(::io_uring_recvmsg_out)), nlen);
+  }
+
+  void recycle_buf(unsigned short bid) noexcept {
+    ::io_uring_buf& b = m_buf_ring[m_buf_tail & (m_num_bufs - 1u)];
+    b.addr = reinterpret_cast<std::uint64_t>(m_bufs.data() + bid * m_buf_size);
+    b.len = static_cast<unsigned int>(m_buf_size);
+    b.bid = bid;
+    ++m_buf_tail;
+    store_release(&m_buf_ring[0].resv, m_buf_tail);
+  }
+
+  static void throw_errno() {
+    throw std::system_error(std::error_code(errno, std::system_category()));
+  }
+
+  void* map_ring(std::size_t sz, std::uint64_t off) {
+    void* p = ::mmap(nullptr, sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     m_ring_fd, static_cast<off_t>(off));
+    if (p == MAP_FAILED) {
+      throw_errno();
+    }
+    return p;
+  }
+
+  // a completion per buffer, plus the one ending the request
+  void setup_ring() {
+    m_params.flags = IORING_SETUP_CQSIZE;
+    m_params.cq_entries = m_num_bufs + 1u;
+    int fd = static_cast<int>(::syscall(__NR_io_uring_setup, sq_entries, &m_params));
+    if (fd < 0) {
+      throw_errno();
+    }
+    m_ring_fd = fd;
+    m_sq_size = m_params.sq_off.array + m_params.sq_entries * sizeof(unsigned int);
+    m_cq_size = m_params.cq_off.cqes + m_params.cq_entries * sizeof(::io_uring_cqe);
+    if (m_params.features & IORING_FEAT_SINGLE_MMAP) {
+      m_sq_size = m_cq_size = (m_sq_size > m_cq_size) ? m_sq_size : m_cq_size;
+    }
+    m_sq_ptr = map_ring(m_sq_size, IORING_OFF_SQ_RING);
+    if (m_params.features & IORING_FEAT_SINGLE_MMAP) {
+      m_cq_ptr = m_sq_ptr;
+    }
+    else {
+      m_cq_ptr = map_ring(m_cq_size, IORING_OFF_CQ_RING);
+    }
+    m_sqes_size = m_params.sq_entries * sizeof(::io_uring_sqe);
+    m_sqes = static_cast<::io_uring_sqe*>(map_ring(m_sqes_size, IORING_OFF_SQES));
+  }
+
+  // a fixed file avoids the file table lookup and reference counting per receive
+  void register_socket(int sock_fd) {
+    if (::syscall(__NR_io_uring_register, m_ring_fd, IORING_REGISTER_FILES, &sock_fd, 1u) < 0) {
+      throw_errno();
+    }
+  }
+
+  void setup_bufs(std::size_t max_size) {
+    m_buf_size = sizeof(::io_uring_recvmsg_out) + name_size + max_size;
+    m_buf_ring_size = m_num_bufs * sizeof(::io_uring_buf); // mmap is page aligned
+    void* p = ::mmap(nullptr, m_buf_ring_size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+      throw_errno();
+    }
+    m_buf_ring = static_cast<::io_uring_buf*>(p);
+    ::io_uring_buf_reg reg { };
+    reg.ring_addr = reinterpret_cast<std::uint64_t>(m_buf_ring);
+    reg.ring_entries = m_num_bufs;
+    reg.bgid = buf_group;
+    if (::syscall(__NR_io_uring_register, m_ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1u) < 0) {
+      throw_errno();
+    }
+    m_bufs.resize(m_num_bufs * m_buf_size);
+    for (unsigned int i = 0u; i < m_num_bufs; ++i) {
+      recycle_buf(static_cast<unsigned short>(i));
+    }
+  }
+
+  // closing the ring cancels the receive and releases the registered socket and buffers
+  void release() noexcept {
+    if (m_sqes != MAP_FAILED) {
+      ::munmap(m_sqes, m_sqes_size);
+    }
+    if (m_cq_ptr != MAP_FAILED && m_cq_ptr != m_sq_ptr) {
+      ::munmap(m_cq_ptr, m_cq_size);
+    }
+    if (m_sq_ptr != MAP_FAILED) {
+      ::munmap(m_sq_ptr, m_sq_size);
+    }
+    if (m_ring_fd >= 0) {
+      ::close(m_ring_fd);
+    }
+    if (m_buf_ring != MAP_FAILED) {
+      ::munmap(m_buf_ring, m_buf_ring_size);
+    }
+    m_ring_fd = -1;
+    m_sqes = static_cast<::io_uring_sqe*>(MAP_FAILED);
+    m_cq_ptr = m_sq_ptr = MAP_FAILED;
+    m_buf_ring = static_cast<::io_uring_buf*>(MAP_FAILED);
+  }
+
+  unsigned int* sq_field(unsigned int off) const noexcept {
+    return reinterpret_cast<unsigned int*>(static_cast<char*>(m_sq_ptr) + off);
+  }
+
+  unsigned int* cq_field(unsigned int off) const noexcept {
+    return reinterpret_cast<unsigned int*>(static_cast<char*>(m_cq_ptr) + off);
+  }
+
+  // the ring indices are shared with the kernel
+  template <typename T>
+  static T load_acquire(const T* p) noexcept { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+
+  template <typename T>
+  static void store_release(T* p, T val) noexcept { __atomic_store_n(p, val, __ATOMIC_RELEASE); }
+
+};
+
+} // end detail namespace
+} // end net namespace
+} // end chops namespace
+
+#endif
+
+#endif
+
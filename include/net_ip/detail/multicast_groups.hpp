@@ -0,0 +1,153 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Internal class that keeps the joined groups and incoming datagram counts
+ *  of a UDP multicast entity.
+ *
+ *  @note For internal use only.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef MULTICAST_GROUPS_HPP_INCLUDED
+#define MULTICAST_GROUPS_HPP_INCLUDED
+
+#include <vector>
+#include <memory> // std::unique_ptr
+#include <mutex>
+#include <atomic>
+#include <algorithm> // std::find_if
+#include <cstddef> // std::size_t
+
+#include <experimental/internet>
+
+#include "net_ip/multicast.hpp"
+
+namespace chops {
+namespace net {
+namespace detail {
+
+// the group list is only modified by the io handler (within its strand), so lookups 
+// by the io handler don't need the lock; the lock protects concurrent stats queries
+class multicast_groups {
+public:
+  using address = std::experimental::net::ip::address;
+
+private:
+  struct group {
+    address            m_addr;
+    std::atomic_size_t m_packets;
+    std::atomic_size_t m_bytes;
+
+    explicit group(const address& addr) : m_addr(addr), m_packets(0), m_bytes(0) { }
+  };
+
+private:
+  std::vector<std::unique_ptr<group> > m_groups;
+  group*                               m_last; // most recently matched group
+  std::atomic_size_t                   m_unmatched;
+  std::atomic_size_t                   m_dropped;
+  mutable std::mutex                   m_mutex;
+
+public:
+
+  explicit multicast_groups(const std::vector<address>& addrs) : 
+      m_groups(), m_last(nullptr), m_unmatched(0), m_dropped(0), m_mutex() {
+    for (const auto& a : addrs) {
+      add(a);
+    }
+  }
+
+  multicast_groups(const multicast_groups&) = delete;
+  multicast_groups& operator=(const multicast_groups&) = delete;
+
+  // the following methods are only called by the io handler
+
+  // returns false if already joined
+  bool add(const address& addr) {
+    if (find(addr)) {
+      return false;
+    }
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_groups.push_back(std::make_unique<group>(addr));
+    return true;
+  }
+
+  // returns false if not joined
+  bool remove(const address& addr) {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    auto it = std::find_if(m_groups.begin(), m_groups.end(), 
+                           [&addr] (const auto& g) { return g->m_addr == addr; } );
+    if (it == m_groups.end()) {
+      return false;
+    }
+    if (m_last == it->get()) {
+      m_last = nullptr;
+    }
+    m_groups.erase(it);
+    return true;
+  }
+
+  std::vector<address> addresses() const {
+    std::vector<address> addrs;
+    for (const auto& g : m_groups) {
+      addrs.push_back(g->m_addr);
+    }
+    return addrs;
+  }
+
+  void count(const address& dest, std::size_t num_bytes) noexcept {
+    if (!m_last || m_last->m_addr != dest) {
+      m_last = find(dest);
+    }
+    if (!m_last) {
+      ++m_unmatched;
+      return;
+    }
+    ++(m_last->m_packets);
+    m_last->m_bytes += num_bytes;
+  }
+
+  void count_unmatched() noexcept { ++m_unmatched; }
+
+  // the kernel provides a running total
+  void set_dropped(std::size_t num_dropped) noexcept { m_dropped = num_dropped; }
+
+  // can be called concurrently
+  multicast_stats get_stats() const {
+    multicast_stats st { };
+    std::lock_guard<std::mutex> lk(m_mutex);
+    for (const auto& g : m_groups) {
+      st.groups.push_back(multicast_group_stats { g->m_addr, g->m_packets, g->m_bytes });
+    }
+    st.num_unmatched = m_unmatched;
+    st.num_dropped = m_dropped;
+    return st;
+  }
+
+private:
+
+  group* find(const address& addr) const noexcept {
+    for (const auto& g : m_groups) {
+      if (g->m_addr == addr) {
+        return g.get();
+      }
+    }
+    return nullptr;
+  }
+
+};
+
+} // end detail namespace
+} // end net namespace
+} // end chops namespace
+
+#endif
+
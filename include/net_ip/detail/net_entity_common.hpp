@@ -27,6 +27,7 @@
 #include <cstddef> // std::size_t
 
 #include "net_ip/basic_io_interface.hpp"
+#include "net_ip/net_ip_metrics.hpp"
 
 namespace chops {
 namespace net {
@@ -69,10 +70,12 @@ public:
   }
 
   void call_io_state_chg_cb(std::shared_ptr<IOT> p, std::size_t sz, bool starting) {
+    record_metric(starting ? net_metric::io_handlers_opened : net_metric::io_handlers_closed);
     m_io_state_chg_cb(basic_io_interface<IOT>(p), sz, starting);
   }
 
   void call_error_cb(std::shared_ptr<IOT> p, const std::error_code& err) {
+    record_error_metric(err);
     m_error_cb(basic_io_interface<IOT>(p), err);
   }
 
@@ -0,0 +1,76 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Output queue buffer of a TCP IO handler, either a reference counted buffer, a
+ *  pooled buffer, a memory mapped region or a file segment, for internal use.
+ *
+ *  @note For internal use only.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef OUT_BUFFER_HPP_INCLUDED
+#define OUT_BUFFER_HPP_INCLUDED
+
+#include <cstddef> // std::size_t, std::byte
+#include <variant>
+#include <utility> // std::move
+
+#include "net_ip/file_segment.hpp"
+#include "net_ip/pooled_buffer.hpp"
+#include "utility/shared_buffer.hpp"
+
+namespace chops {
+namespace net {
+namespace detail {
+
+// memory buffers (shared buffers, pooled buffers and mapped regions) have data, file 
+// segments are written by the kernel from the file
+class out_buffer {
+private:
+  std::variant<chops::const_shared_buffer, pooled_buffer, mapped_region, file_segment> m_buf;
+
+public:
+  out_buffer(chops::const_shared_buffer buf) noexcept : m_buf(std::move(buf)) { }
+  out_buffer(pooled_buffer buf) noexcept : m_buf(std::move(buf)) { }
+  out_buffer(mapped_region reg) noexcept : m_buf(std::move(reg)) { }
+  out_buffer(file_segment seg) noexcept : m_buf(std::move(seg)) { }
+
+  bool is_file() const noexcept { return m_buf.index() == 3u; }
+
+  std::size_t size() const noexcept {
+    switch (m_buf.index()) {
+    case 0u: return std::get_if<0>(&m_buf)->size();
+    case 1u: return std::get_if<1>(&m_buf)->size();
+    case 2u: return std::get_if<2>(&m_buf)->size();
+    default: return std::get_if<3>(&m_buf)->size();
+    }
+  }
+
+  // nullptr for a file segment
+  const std::byte* data() const noexcept {
+    switch (m_buf.index()) {
+    case 0u: return std::get_if<0>(&m_buf)->data();
+    case 1u: return std::get_if<1>(&m_buf)->data();
+    case 2u: return std::get_if<2>(&m_buf)->data();
+    default: return nullptr;
+    }
+  }
+
+  // only for a file segment
+  const file_segment& get_file_segment() const noexcept { return *std::get_if<3>(&m_buf); }
+};
+
+} // end detail namespace
+} // end net namespace
+} // end chops namespace
+
+#endif
+
@@ -4,8 +4,19 @@
  *
  *  @brief Utility class to manage output data queueing.
  *
- *  The @c std::atomic counters allow the IO handler to update
- *  while the application queries the stats.
+ *  The queue is a lock-free multi-producer / single-consumer linked list 
+ *  (the node based design by Dmitry Vyukov), allowing application threads
+ *  to enqueue buffers directly while the IO handler (the single consumer)
+ *  dequeues from within the run thread. The @c std::atomic counters allow 
+ *  the IO handler to update while the application queries the stats.
+ *
+ *  The @c output_lanes class holds one queue per send priority, and drains them by 
+ *  strict priority or weighted round robin; aggregate stats are provided as well as 
+ *  the stats of each lane.
+ *
+ *  The buffer type is a template parameter, a @c chops::const_shared_buffer unless the
+ *  IO handler queues other kinds of buffers (e.g. file segments); it only needs a 
+ *  @c size method.
  *
  *  @note For internal use only.
  *
@@ -21,76 +32,529 @@
 #ifndef OUTPUT_QUEUE_HPP_INCLUDED
 #define OUTPUT_QUEUE_HPP_INCLUDED
 
-#include <queue>
+#include <vector>
 #include <atomic>
+#include <thread> // std::this_thread::yield
 #include <cstddef> // std::size_t
-#include <utility> // std::pair
-#include <optional>
+#include <utility> // std::pair, std::move
+#include <optional> // std::optional, std::in_place
+#include <array>
+#include <chrono>
+#include <algorithm> // std::min, std::max
 
 #include "net_ip/queue_stats.hpp"
+#include "net_ip/send_priority.hpp"
 #include "utility/shared_buffer.hpp"
 
 namespace chops {
 namespace net {
 namespace detail {
 
-template <typename E>
+template <typename E, typename B = chops::const_shared_buffer>
 class output_queue {
 private:
 
   using opt_endpoint = std::optional<E>;
-  using queue_element = std::pair<chops::const_shared_buffer, opt_endpoint>;
+
+public:
+  using buffer_type = B;
+  using queue_element = std::pair<B, opt_endpoint>;
+  using opt_queue_element = std::optional<queue_element>;
+
+private:
+
+  using clock = std::chrono::steady_clock;
+
+  // the element is optional since the dummy node doesn't hold one
+  struct node {
+    std::atomic<node*>           m_next;
+    std::optional<queue_element> m_elem;
+    clock::time_point            m_enq_time;
+
+    node() : m_next(nullptr), m_elem(), m_enq_time() { }
+    node(B&& buf, opt_endpoint&& opt_endp) :
+      m_next(nullptr), m_elem(std::in_place, std::move(buf), std::move(opt_endp)), 
+      m_enq_time(clock::now()) { }
+  };
+
+  using latency_hist = std::array<std::atomic_size_t, 
+                                  chops::net::output_queue_stats::num_latency_buckets>;
 
 private:
 
-  std::queue<queue_element> m_output_queue;
+  // producers push at m_head, the consumer pops at m_tail, m_tail always points 
+  // to a dummy node whose successor (if any) holds the front element
+  std::atomic<node*>        m_head;
+  node*                     m_tail;
   std::atomic_size_t        m_queue_size;
   std::atomic_size_t        m_current_num_bytes;
-  // std::size_t               m_total_bufs_sent;
-  // std::size_t               m_total_bytes_sent;
+  std::atomic_size_t        m_num_batches;
+  std::atomic_size_t        m_bufs_in_batches;
+  std::atomic_size_t        m_max_bufs_in_batch;
+  std::atomic_size_t        m_total_bufs_sent;
+  std::atomic_size_t        m_total_bytes_sent;
+  std::atomic_size_t        m_max_queue_size;
+  std::atomic_size_t        m_max_num_bytes;
+  std::atomic_size_t        m_max_latency;
+  latency_hist              m_latency_hist;
+  // bufs taken by the consumer whose write has not completed, consumer access only
+  std::vector<clock::time_point> m_in_flight;
+  std::size_t                    m_in_flight_bytes;
 
 public:
-  using opt_queue_element = std::optional<queue_element>;
 
-public:
+  output_queue() : m_head(nullptr), m_tail(new node()), m_queue_size(0), m_current_num_bytes(0),
+    m_num_batches(0), m_bufs_in_batches(0), m_max_bufs_in_batch(0),
+    m_total_bufs_sent(0), m_total_bytes_sent(0), m_max_queue_size(0), m_max_num_bytes(0),
+    m_max_latency(0), m_latency_hist(), m_in_flight(), m_in_flight_bytes(0) {
+    m_head = m_tail;
+    for (auto& b : m_latency_hist) {
+      b = 0;
+    }
+  }
+
+  ~output_queue() {
+    while (m_tail) {
+      node* nxt = m_tail->m_next.load(std::memory_order_relaxed);
+      delete m_tail;
+      m_tail = nxt;
+    }
+  }
+
+  output_queue(const output_queue&) = delete;
+  output_queue& operator=(const output_queue&) = delete;
+
+  // the following methods are called only by the consumer (io handler)
 
-  output_queue() noexcept : m_output_queue(), m_queue_size(0), m_current_num_bytes(0) { }
+  // an element may be in the middle of being pushed, so this can return false before
+  // the element is visible through get_next_element, which will then wait for it
+  bool empty() const noexcept { return m_head.load() == m_tail; }
 
   // io handlers call this method to get next buffer of data, can be empty
   opt_queue_element get_next_element() {
-    if (m_output_queue.empty()) {
+    node* nxt = front_node();
+    if (!nxt) {
       return opt_queue_element { };
     }
-    queue_element e = m_output_queue.front();
-    m_output_queue.pop();
+    opt_queue_element e { std::move(nxt->m_elem) };
+    m_in_flight.push_back(nxt->m_enq_time);
+    m_in_flight_bytes += e->first.size();
+    pop_front(nxt);
+    --m_queue_size;
+    m_current_num_bytes -= e->first.size();
+    return e;
+  }
+
+  // size of the front buffer, 0 if empty
+  std::size_t front_size() const noexcept {
+    node* nxt = front_node();
+    return nxt ? nxt->m_elem->first.size() : 0u;
+  }
+
+  // discard the front element, used by the overflow policies; false if empty
+  bool drop_next_element() {
+    node* nxt = front_node();
+    if (!nxt) {
+      return false;
+    }
+    auto sz = nxt->m_elem->first.size();
+    pop_front(nxt);
     --m_queue_size;
-    m_current_num_bytes -= e.first.size();
-    return opt_queue_element {e};
+    m_current_num_bytes -= sz;
+    return true;
+  }
+
+  // io handlers call this method when the write of the bufs taken since the previous 
+  // call has completed, updating the sent totals and the latency histogram
+  void write_complete() {
+    if (m_in_flight.empty()) {
+      return;
+    }
+    auto now = clock::now();
+    for (auto t : m_in_flight) {
+      auto usec = static_cast<std::size_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(now - t).count());
+      std::size_t b = 0;
+      while ((b + 1) < m_latency_hist.size() && (usec >> b) != 0) {
+        ++b;
+      }
+      ++m_latency_hist[b];
+      if (usec > m_max_latency) { // only modified by the io handler, no CAS needed
+        m_max_latency = usec;
+      }
+    }
+    m_total_bufs_sent += m_in_flight.size();
+    m_total_bytes_sent += m_in_flight_bytes;
+    m_in_flight.clear();
+    m_in_flight_bytes = 0;
+  }
+
+  // io handlers call this method to get a batch of buffers for a gather write; at most
+  // max_bufs buffers are appended, stopping before max_bytes would be exceeded (the first
+  // buffer is always taken); endpoints are ignored since a gather write is only used for 
+  // stream IO; returns the number of buffers appended
+  std::size_t get_next_elements(std::vector<B>& bufs, 
+                                std::size_t max_bufs, std::size_t max_bytes) {
+    return take_elements(max_bufs, max_bytes, 
+                         [&bufs] (queue_element& e) { bufs.push_back(std::move(e.first)); } );
+  }
+
+  // same as above, but the endpoints are kept, for batched datagram sends
+  std::size_t get_next_elements(std::vector<queue_element>& elems, 
+                                std::size_t max_bufs, std::size_t max_bytes) {
+    return take_elements(max_bufs, max_bytes, 
+                         [&elems] (queue_element& e) { elems.push_back(std::move(e)); } );
+  }
+
+  // the following methods can be called concurrently from multiple threads
+
+  std::size_t size() const noexcept { return m_queue_size; }
+
+  std::size_t num_bytes() const noexcept { return m_current_num_bytes; }
+
+  // the buffer is taken by value so callers can move it in without a reference count
+  // increment
+  void add_element(B buf) {
+    add_element(std::move(buf), opt_endpoint());
+  }
+
+  void add_element(B buf, const E& endp) {
+    add_element(std::move(buf), opt_endpoint(endp));
+  }
+
+  // received totals and the queued while busy count are not known to the queue, 
+  // and are left at zero
+  chops::net::output_queue_stats get_queue_stats() const noexcept {
+    chops::net::output_queue_stats qs { };
+    qs.output_queue_size = m_queue_size;
+    qs.bytes_in_output_queue = m_current_num_bytes;
+    qs.num_write_batches = m_num_batches;
+    qs.bufs_in_write_batches = m_bufs_in_batches;
+    qs.max_bufs_in_write_batch = m_max_bufs_in_batch;
+    qs.total_bufs_sent = m_total_bufs_sent;
+    qs.total_bytes_sent = m_total_bytes_sent;
+    qs.max_output_queue_size = m_max_queue_size;
+    qs.max_bytes_in_output_queue = m_max_num_bytes;
+    qs.max_latency_usec = m_max_latency;
+    for (std::size_t i = 0; i < m_latency_hist.size(); ++i) {
+      qs.latency_histogram[i] = m_latency_hist[i];
+    }
+    return qs;
+  }
+
+private:
+
+  void add_element(B&& buf, opt_endpoint&& opt_endp) {
+    auto sz = buf.size();
+    node* n = new node(std::move(buf), std::move(opt_endp));
+    // counters are updated first so the consumer never decrements below zero
+    update_max(m_max_queue_size, ++m_queue_size);
+    update_max(m_max_num_bytes, m_current_num_bytes += sz); // note - possible integer overflow
+    node* prev = m_head.exchange(n); // linearization point for producers
+    prev->m_next.store(n, std::memory_order_release);
+  }
+
+  template <typename F>
+  std::size_t take_elements(std::size_t max_bufs, std::size_t max_bytes, F&& func) {
+    std::size_t cnt = 0;
+    std::size_t num_bytes = 0;
+    node* nxt = nullptr;
+    while (cnt < max_bufs && (nxt = front_node())) {
+      auto sz = nxt->m_elem->first.size();
+      if (cnt > 0 && (num_bytes + sz) > max_bytes) {
+        break;
+      }
+      func(*(nxt->m_elem));
+      m_in_flight.push_back(nxt->m_enq_time);
+      pop_front(nxt);
+      ++cnt;
+      num_bytes += sz;
+    }
+    if (cnt == 0) {
+      return 0;
+    }
+    m_queue_size -= cnt;
+    m_current_num_bytes -= num_bytes;
+    m_in_flight_bytes += num_bytes;
+    ++m_num_batches;
+    m_bufs_in_batches += cnt;
+    if (cnt > m_max_bufs_in_batch) { // only modified by the io handler, no CAS needed
+      m_max_bufs_in_batch = cnt;
+    }
+    return cnt;
+  }
+
+  // multiple producers, so a CAS loop is needed
+  static void update_max(std::atomic_size_t& mx, std::size_t val) noexcept {
+    auto cur = mx.load();
+    while (val > cur && !mx.compare_exchange_weak(cur, val)) { }
+  }
+
+  // returns the node holding the front element, or nullptr if empty; if a producer
+  // has swapped the head but not yet linked its node, wait for the (very short) link
+  node* front_node() const noexcept {
+    node* nxt = m_tail->m_next.load(std::memory_order_acquire);
+    while (!nxt) {
+      if (m_head.load() == m_tail) {
+        return nullptr;
+      }
+      std::this_thread::yield();
+      nxt = m_tail->m_next.load(std::memory_order_acquire);
+    }
+    return nxt;
+  }
+
+  // the front node becomes the new dummy node
+  void pop_front(node* nxt) noexcept {
+    delete m_tail;
+    m_tail = nxt;
+    m_tail->m_elem.reset();
+  }
+
+};
+
+// one output_queue per send priority, with the same interface as output_queue (plus 
+// the priority when adding); the consumer methods pick the lane from the policy
+template <typename E, typename B = chops::const_shared_buffer>
+class output_lanes {
+public:
+  using lane_type = output_queue<E, B>;
+  using buffer_type = B;
+  using queue_element = typename lane_type::queue_element;
+  using opt_queue_element = typename lane_type::opt_queue_element;
+
+  static constexpr std::size_t num_lanes = chops::net::num_send_priorities;
+
+private:
+
+  static constexpr std::size_t no_lane = num_lanes;
+
+  std::array<lane_type, num_lanes>          m_lanes;
+  std::atomic_size_t                        m_max_queue_size;
+  std::atomic_size_t                        m_max_num_bytes;
+  std::atomic_size_t                        m_num_batches;
+  std::atomic_size_t                        m_bufs_in_batches;
+  std::atomic_size_t                        m_max_bufs_in_batch;
+  // lane policy, set from any thread
+  std::atomic_bool                          m_weighted;
+  std::array<std::atomic_size_t, num_lanes> m_weights;
+  // round robin position, consumer access only
+  std::size_t                               m_cur_lane;
+  std::size_t                               m_credit;
+
+public:
+
+  output_lanes() : m_lanes(), m_max_queue_size(0), m_max_num_bytes(0), m_num_batches(0),
+    m_bufs_in_batches(0), m_max_bufs_in_batch(0), m_weighted(false), m_weights(),
+    m_cur_lane(num_lanes - 1u), m_credit(0) {
+    set_lane_policy(chops::net::send_lane_policy { });
+  }
+
+  output_lanes(const output_lanes&) = delete;
+  output_lanes& operator=(const output_lanes&) = delete;
+
+  // the following methods are called only by the consumer (io handler)
+
+  bool empty() const noexcept {
+    for (const auto& lane : m_lanes) {
+      if (!lane.empty()) {
+        return false;
+      }
+    }
+    return true;
   }
 
-  void add_element(const chops::const_shared_buffer& buf) {
-    add_element(buf, opt_endpoint());
+  opt_queue_element get_next_element() {
+    bool weighted = m_weighted.load(std::memory_order_relaxed);
+    auto l = next_lane(weighted);
+    if (l == no_lane) {
+      return opt_queue_element { };
+    }
+    taken(weighted, 1u);
+    return m_lanes[l].get_next_element();
+  }
+
+  // the lowest priority lane is discarded from first
+  bool drop_next_element() {
+    for (std::size_t l = num_lanes; l > 0u; --l) {
+      if (m_lanes[l - 1u].drop_next_element()) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void write_complete() {
+    for (auto& lane : m_lanes) {
+      lane.write_complete();
+    }
+  }
+
+  // same limits as output_queue get_next_elements, the batch may span lanes; T is 
+  // either the buffer type or a queue element
+  template <typename T>
+  std::size_t get_next_elements(std::vector<T>& bufs, 
+                                std::size_t max_bufs, std::size_t max_bytes) {
+    bool weighted = m_weighted.load(std::memory_order_relaxed);
+    std::size_t cnt = 0;
+    std::size_t num_bytes = 0;
+    while (cnt < max_bufs) {
+      auto l = next_lane(weighted);
+      if (l == no_lane) {
+        break;
+      }
+      auto& lane = m_lanes[l];
+      if (cnt > 0 && (num_bytes + lane.front_size()) > max_bytes) {
+        break;
+      }
+      auto start = bufs.size();
+      auto n = lane.get_next_elements(bufs, std::min(max_bufs - cnt, turn_left(weighted)),
+                                      max_bytes - std::min(num_bytes, max_bytes));
+      if (n == 0) {
+        break;
+      }
+      taken(weighted, n);
+      cnt += n;
+      for (auto i = start; i < bufs.size(); ++i) {
+        num_bytes += elem_size(bufs[i]);
+      }
+    }
+    if (cnt == 0) {
+      return 0;
+    }
+    ++m_num_batches;
+    m_bufs_in_batches += cnt;
+    if (cnt > m_max_bufs_in_batch) { // only modified by the io handler, no CAS needed
+      m_max_bufs_in_batch = cnt;
+    }
+    return cnt;
   }
 
-  void add_element(const chops::const_shared_buffer& buf, const E& endp) {
-    add_element(buf, opt_endpoint(endp));
+  // the following methods can be called concurrently from multiple threads
+
+  std::size_t size() const noexcept {
+    std::size_t sz = 0;
+    for (const auto& lane : m_lanes) {
+      sz += lane.size();
+    }
+    return sz;
   }
 
+  std::size_t num_bytes() const noexcept {
+    std::size_t nb = 0;
+    for (const auto& lane : m_lanes) {
+      nb += lane.num_bytes();
+    }
+    return nb;
+  }
+
+  void add_element(B buf, 
+                   chops::net::send_priority pri = chops::net::send_priority::normal) {
+    lane(pri).add_element(std::move(buf));
+    update_maxes();
+  }
+
+  void add_element(B buf, const E& endp,
+                   chops::net::send_priority pri = chops::net::send_priority::normal) {
+    lane(pri).add_element(std::move(buf), endp);
+    update_maxes();
+  }
+
+  void set_lane_policy(const chops::net::send_lane_policy& pol) noexcept {
+    for (std::size_t l = 0u; l < num_lanes; ++l) {
+      m_weights[l].store(std::max(pol.weights[l], std::size_t(1u)), std::memory_order_relaxed);
+    }
+    m_weighted.store(pol.schedule == chops::net::lane_schedule::weighted_round_robin,
+                     std::memory_order_relaxed);
+  }
+
+  // the write batch counts are for batches from any lane
   chops::net::output_queue_stats get_queue_stats() const noexcept {
-    return chops::net::output_queue_stats { m_queue_size, m_current_num_bytes };
-    // return chops::net::output_queue_stats {
-    //   m_queue_size, m_current_num_bytes, m_total_bufs_sent, m_total_bytes_sent 
-    // };
+    chops::net::output_queue_stats qs { };
+    for (const auto& lane : m_lanes) {
+      auto ls = lane.get_queue_stats();
+      qs.output_queue_size += ls.output_queue_size;
+      qs.bytes_in_output_queue += ls.bytes_in_output_queue;
+      qs.total_bufs_sent += ls.total_bufs_sent;
+      qs.total_bytes_sent += ls.total_bytes_sent;
+      qs.max_latency_usec = std::max(qs.max_latency_usec, ls.max_latency_usec);
+      for (std::size_t i = 0; i < qs.latency_histogram.size(); ++i) {
+        qs.latency_histogram[i] += ls.latency_histogram[i];
+      }
+    }
+    qs.num_write_batches = m_num_batches;
+    qs.bufs_in_write_batches = m_bufs_in_batches;
+    qs.max_bufs_in_write_batch = m_max_bufs_in_batch;
+    qs.max_output_queue_size = m_max_queue_size;
+    qs.max_bytes_in_output_queue = m_max_num_bytes;
+    return qs;
+  }
+
+  // the write batch counts of a lane count each batch that took buffers from the lane
+  chops::net::output_queue_stats get_lane_stats(chops::net::send_priority pri) const noexcept {
+    return lane(pri).get_queue_stats();
   }
 
 private:
 
-  void add_element(const chops::const_shared_buffer& buf, opt_endpoint&& opt_endp) {
-    m_output_queue.push(queue_element(buf, opt_endp));
-    ++m_queue_size;
-    m_current_num_bytes += buf.size(); // note - possible integer overflow
-    // ++m_total_bufs_sent;
-    // m_total_bytes_sent += buf.size();
+  lane_type& lane(chops::net::send_priority pri) noexcept {
+    return m_lanes[static_cast<std::size_t>(pri)];
+  }
+
+  const lane_type& lane(chops::net::send_priority pri) const noexcept {
+    return m_lanes[static_cast<std::size_t>(pri)];
+  }
+
+  // approximate with concurrent producers, as for a single output_queue
+  void update_maxes() noexcept {
+    update_max(m_max_queue_size, size());
+    update_max(m_max_num_bytes, num_bytes());
+  }
+
+  static void update_max(std::atomic_size_t& mx, std::size_t val) noexcept {
+    auto cur = mx.load();
+    while (val > cur && !mx.compare_exchange_weak(cur, val)) { }
+  }
+
+  static std::size_t elem_size(const B& buf) noexcept {
+    return buf.size();
+  }
+
+  static std::size_t elem_size(const queue_element& e) noexcept { return e.first.size(); }
+
+  // the lane to take the next buffer from, no_lane if all are empty; with round robin 
+  // an empty lane gives up the rest of its turn
+  std::size_t next_lane(bool weighted) noexcept {
+    if (!weighted) {
+      for (std::size_t l = 0u; l < num_lanes; ++l) {
+        if (!m_lanes[l].empty()) {
+          return l;
+        }
+      }
+      return no_lane;
+    }
+    for (std::size_t i = 0u; i <= num_lanes; ++i) {
+      if (m_credit == 0u) {
+        m_cur_lane = (m_cur_lane + 1u) % num_lanes;
+        m_credit = m_weights[m_cur_lane].load(std::memory_order_relaxed);
+      }
+      if (!m_lanes[m_cur_lane].empty()) {
+        return m_cur_lane;
+      }
+      m_credit = 0u;
+    }
+    return no_lane;
+  }
+
+  // buffers left in the turn of the lane returned by next_lane
+  std::size_t turn_left(bool weighted) const noexcept {
+    return weighted ? m_credit : static_cast<std::size_t>(-1);
+  }
+
+  void taken(bool weighted, std::size_t n) noexcept {
+    if (weighted) {
+      m_credit -= std::min(n, m_credit);
+    }
   }
 
 };
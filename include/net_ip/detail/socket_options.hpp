@@ -0,0 +1,316 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Socket option classes not provided by the Networking TS, usable with the
+ *  @c set_option and @c get_option socket methods, and applying a @c socket_profile.
+ *
+ *  @note For internal use only.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef SOCKET_OPTIONS_HPP_INCLUDED
+#define SOCKET_OPTIONS_HPP_INCLUDED
+
+#include <experimental/internet>
+#include <experimental/socket>
+
+#include <system_error>
+#include <type_traits> // std::is_same_v
+#include <cstddef> // std::size_t
+#include <cstring> // std::memcpy
+#include <chrono>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netinet/udp.h>
+#include <time.h> // timespec
+#endif
+
+#ifdef __linux__
+#include <linux/net_tstamp.h> // SOF_TIMESTAMPING_*
+#endif
+
+#include "net_ip/socket_profile.hpp"
+#include "net_ip/receive_timestamp.hpp"
+
+namespace chops {
+namespace net {
+namespace detail {
+
+// boolean option, meets the Networking TS GettableSocketOption and SettableSocketOption
+// requirements
+template <int Level, int Name>
+class boolean_socket_option {
+private:
+  int   m_value;
+
+public:
+  boolean_socket_option() noexcept : m_value(0) { }
+  explicit boolean_socket_option(bool v) noexcept : m_value(v ? 1 : 0) { }
+
+  bool value() const noexcept { return m_value != 0; }
+  explicit operator bool() const noexcept { return value(); }
+
+  template <typename Protocol>
+  int level(const Protocol&) const noexcept { return Level; }
+
+  template <typename Protocol>
+  int name(const Protocol&) const noexcept { return Name; }
+
+  template <typename Protocol>
+  int* data(const Protocol&) noexcept { return &m_value; }
+
+  template <typename Protocol>
+  const int* data(const Protocol&) const noexcept { return &m_value; }
+
+  template <typename Protocol>
+  std::size_t size(const Protocol&) const noexcept { return sizeof(m_value); }
+
+  template <typename Protocol>
+  void resize(const Protocol&, std::size_t) noexcept { }
+};
+
+// integer option, same requirements as the boolean option
+template <int Level, int Name>
+class integer_socket_option {
+private:
+  int   m_value;
+
+public:
+  integer_socket_option() noexcept : m_value(0) { }
+  explicit integer_socket_option(int v) noexcept : m_value(v) { }
+
+  int value() const noexcept { return m_value; }
+
+  template <typename Protocol>
+  int level(const Protocol&) const noexcept { return Level; }
+
+  template <typename Protocol>
+  int name(const Protocol&) const noexcept { return Name; }
+
+  template <typename Protocol>
+  int* data(const Protocol&) noexcept { return &m_value; }
+
+  template <typename Protocol>
+  const int* data(const Protocol&) const noexcept { return &m_value; }
+
+  template <typename Protocol>
+  std::size_t size(const Protocol&) const noexcept { return sizeof(m_value); }
+
+  template <typename Protocol>
+  void resize(const Protocol&, std::size_t) noexcept { }
+};
+
+// type of service byte, IP_TOS or IPV6_TCLASS depending on the protocol family
+#if defined(IP_TOS) && defined(IPV6_TCLASS)
+constexpr bool tos_supported = true;
+
+class type_of_service {
+private:
+  int   m_value;
+
+public:
+  type_of_service() noexcept : m_value(0) { }
+  explicit type_of_service(int v) noexcept : m_value(v) { }
+
+  int value() const noexcept { return m_value; }
+
+  template <typename Protocol>
+  int level(const Protocol& p) const noexcept { 
+    return p.family() == AF_INET6 ? IPPROTO_IPV6 : IPPROTO_IP;
+  }
+
+  template <typename Protocol>
+  int name(const Protocol& p) const noexcept { 
+    return p.family() == AF_INET6 ? IPV6_TCLASS : IP_TOS;
+  }
+
+  template <typename Protocol>
+  int* data(const Protocol&) noexcept { return &m_value; }
+
+  template <typename Protocol>
+  const int* data(const Protocol&) const noexcept { return &m_value; }
+
+  template <typename Protocol>
+  std::size_t size(const Protocol&) const noexcept { return sizeof(m_value); }
+
+  template <typename Protocol>
+  void resize(const Protocol&, std::size_t) noexcept { }
+};
+#else
+constexpr bool tos_supported = false;
+#endif
+
+#ifdef SO_REUSEPORT
+constexpr bool reuse_port_supported = true;
+using reuse_port = boolean_socket_option<SOL_SOCKET, SO_REUSEPORT>;
+#else
+constexpr bool reuse_port_supported = false;
+#endif
+
+// destination address and socket drop count of incoming datagrams, delivered as 
+// control messages (Linux)
+#if defined(IP_PKTINFO) && defined(IPV6_RECVPKTINFO) && defined(SO_RXQ_OVFL)
+constexpr bool recv_pktinfo_supported = true;
+using ipv4_recv_pktinfo = boolean_socket_option<IPPROTO_IP, IP_PKTINFO>;
+using ipv6_recv_pktinfo = boolean_socket_option<IPPROTO_IPV6, IPV6_RECVPKTINFO>;
+using recv_queue_overflow = boolean_socket_option<SOL_SOCKET, SO_RXQ_OVFL>;
+#else
+constexpr bool recv_pktinfo_supported = false;
+#endif
+
+// UDP receive offload, coalesced datagrams are delivered with the segment size as a
+// control message; send offload is requested per send with a UDP_SEGMENT control message
+#if defined(UDP_SEGMENT) && defined(UDP_GRO)
+constexpr bool udp_offload_supported = true;
+using udp_gro = boolean_socket_option<SOL_UDP, UDP_GRO>;
+#else
+constexpr bool udp_offload_supported = false;
+#endif
+
+// receive timestamps, kernel (software) and network device (raw hardware) times are 
+// delivered as a SCM_TIMESTAMPING control message with each datagram, or for TCP with
+// each read
+#if defined(__linux__) && defined(SO_TIMESTAMPING)
+constexpr bool receive_timestamps_supported = true;
+using timestamping = integer_socket_option<SOL_SOCKET, SO_TIMESTAMPING>;
+constexpr int receive_timestamping_flags = 
+  SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE |
+  SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+
+// the kernel scm_timestamping layout, [0] is the software time and [2] the raw hardware
+// time ([1] is no longer used)
+struct scm_timestamps {
+  ::timespec m_ts[3];
+};
+
+// the timestamps are left unchanged if there is no timestamping control message
+inline void read_receive_timestamp(const ::msghdr& hdr, receive_timestamp& ts) noexcept {
+  auto to_ns = [] (const ::timespec& t) {
+    return std::chrono::seconds(t.tv_sec) + std::chrono::nanoseconds(t.tv_nsec);
+  };
+  for (auto* c = CMSG_FIRSTHDR(&hdr); c; c = CMSG_NXTHDR(const_cast<::msghdr*>(&hdr), c)) {
+    if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMPING &&
+        c->cmsg_len >= CMSG_LEN(sizeof(scm_timestamps))) {
+      scm_timestamps st;
+      std::memcpy(&st, CMSG_DATA(c), sizeof(st));
+      ts.software = to_ns(st.m_ts[0]);
+      ts.hardware = to_ns(st.m_ts[2]);
+      return;
+    }
+  }
+}
+#else
+constexpr bool receive_timestamps_supported = false;
+#endif
+
+#ifdef TCP_QUICKACK
+using tcp_quick_ack = boolean_socket_option<IPPROTO_TCP, TCP_QUICKACK>;
+#endif
+
+#ifdef SO_BUSY_POLL
+using busy_poll = integer_socket_option<SOL_SOCKET, SO_BUSY_POLL>;
+#endif
+
+#ifdef TCP_USER_TIMEOUT
+using tcp_user_timeout = integer_socket_option<IPPROTO_TCP, TCP_USER_TIMEOUT>;
+#endif
+
+#if defined(TCP_KEEPIDLE) && defined(TCP_KEEPINTVL) && defined(TCP_KEEPCNT)
+using tcp_keep_idle = integer_socket_option<IPPROTO_TCP, TCP_KEEPIDLE>;
+using tcp_keep_interval = integer_socket_option<IPPROTO_TCP, TCP_KEEPINTVL>;
+using tcp_keep_count = integer_socket_option<IPPROTO_TCP, TCP_KEEPCNT>;
+#endif
+
+#ifdef SO_ZEROCOPY
+constexpr bool zero_copy_supported = true;
+using zero_copy = boolean_socket_option<SOL_SOCKET, SO_ZEROCOPY>;
+#else
+constexpr bool zero_copy_supported = false;
+#endif
+
+// applies the options of a socket profile to an open socket, all of the options are 
+// attempted and the first error (if any) is returned
+template <typename Socket>
+void apply_socket_profile(Socket& sock, const socket_profile& prof, std::error_code& ec) {
+  using sb = std::experimental::net::socket_base;
+  constexpr bool is_tcp = 
+    std::is_same_v<typename Socket::protocol_type, std::experimental::net::ip::tcp>;
+
+  ec.clear();
+  auto set = [&sock, &ec] (const auto& opt) {
+    std::error_code e;
+    sock.set_option(opt, e);
+    if (e && !ec) {
+      ec = e;
+    }
+  };
+
+  if (prof.send_buffer_size > 0) {
+    set(sb::send_buffer_size(prof.send_buffer_size));
+  }
+  if (prof.receive_buffer_size > 0) {
+    set(sb::receive_buffer_size(prof.receive_buffer_size));
+  }
+#ifdef SO_BUSY_POLL
+  if (prof.busy_poll > 0) {
+    set(busy_poll(prof.busy_poll));
+  }
+#endif
+#if defined(IP_TOS) && defined(IPV6_TCLASS)
+  if (prof.tos > 0) {
+    set(type_of_service(prof.tos));
+  }
+#endif
+#ifdef SO_ZEROCOPY
+  if (prof.zero_copy) {
+    set(zero_copy(true));
+  }
+#endif
+  if constexpr (is_tcp) {
+    if (prof.no_delay) {
+      set(std::experimental::net::ip::tcp::no_delay(true));
+    }
+#ifdef TCP_QUICKACK
+    if (prof.quick_ack) {
+      set(tcp_quick_ack(true));
+    }
+#endif
+#ifdef TCP_USER_TIMEOUT
+    if (prof.user_timeout.count() > 0) {
+      set(tcp_user_timeout(static_cast<int>(prof.user_timeout.count())));
+    }
+#endif
+    if (prof.keep_alive) {
+      set(sb::keep_alive(true));
+#if defined(TCP_KEEPIDLE) && defined(TCP_KEEPINTVL) && defined(TCP_KEEPCNT)
+      if (prof.keep_alive_idle.count() > 0) {
+        set(tcp_keep_idle(static_cast<int>(prof.keep_alive_idle.count())));
+      }
+      if (prof.keep_alive_interval.count() > 0) {
+        set(tcp_keep_interval(static_cast<int>(prof.keep_alive_interval.count())));
+      }
+      if (prof.keep_alive_count > 0) {
+        set(tcp_keep_count(prof.keep_alive_count));
+      }
+#endif
+    }
+  }
+}
+
+} // end detail namespace
+} // end net namespace
+} // end chops namespace
+
+#endif
+
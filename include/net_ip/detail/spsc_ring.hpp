@@ -0,0 +1,123 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Bounded single producer, single consumer lock-free ring, for internal use.
+ *
+ *  With one producer and one consumer the positions need no compare and swap: the
+ *  producer alone writes the tail and the consumer alone writes the head, each
+ *  publishing with a release store. Each side keeps a cached copy of the other side's
+ *  position, so the shared cache line is only read when the ring looks full (or empty).
+ *
+ *  @note For internal use only.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef SPSC_RING_HPP_INCLUDED
+#define SPSC_RING_HPP_INCLUDED
+
+#include <cstddef> // std::size_t
+#include <atomic>
+#include <memory> // std::unique_ptr
+#include <new> // placement new, std::launder
+#include <optional>
+#include <utility> // std::move
+
+namespace chops {
+namespace net {
+namespace detail {
+
+template <typename T>
+class spsc_ring {
+private:
+  struct slot {
+    alignas(T) unsigned char storage[sizeof(T)];
+  };
+
+  std::unique_ptr<slot[]>         m_slots;
+  std::size_t                     m_mask;
+  // producer and consumer positions (and cached copies) on separate cache lines
+  alignas(64) std::atomic_size_t  m_tail;
+  std::size_t                     m_head_cache;
+  alignas(64) std::atomic_size_t  m_head;
+  std::size_t                     m_tail_cache;
+
+public:
+
+  // the capacity is rounded up to a power of 2, at least 2
+  explicit spsc_ring(std::size_t capacity) :
+      m_slots(), m_mask(0u), m_tail(0u), m_head_cache(0u), m_head(0u), m_tail_cache(0u) {
+    std::size_t sz = 2u;
+    while (sz < capacity) {
+      sz <<= 1u;
+    }
+    m_slots = std::make_unique<slot[]>(sz);
+    m_mask = sz - 1u;
+  }
+
+  ~spsc_ring() {
+    while (try_pop()) { }
+  }
+
+private:
+  spsc_ring(const spsc_ring&) = delete;
+  spsc_ring& operator=(const spsc_ring&) = delete;
+
+public:
+
+  std::size_t capacity() const noexcept { return m_mask + 1u; }
+
+  // producer only, false if full
+  bool try_push(T&& val) {
+    std::size_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_head_cache > m_mask) {
+      m_head_cache = m_head.load(std::memory_order_acquire);
+      if (tail - m_head_cache > m_mask) {
+        return false;
+      }
+    }
+    ::new (static_cast<void*>(m_slots[tail & m_mask].storage)) T(std::move(val));
+    m_tail.store(tail + 1u, std::memory_order_release);
+    return true;
+  }
+
+  // consumer only
+  std::optional<T> try_pop() {
+    std::size_t head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail_cache) {
+      m_tail_cache = m_tail.load(std::memory_order_acquire);
+      if (head == m_tail_cache) {
+        return std::optional<T> { };
+      }
+    }
+    T* p = std::launder(reinterpret_cast<T*>(m_slots[head & m_mask].storage));
+    std::optional<T> val { std::move(*p) };
+    p->~T();
+    m_head.store(head + 1u, std::memory_order_release);
+    return val;
+  }
+
+  // approximate unless called by the consumer with no concurrent push
+  bool empty() const noexcept {
+    return m_head.load(std::memory_order_seq_cst) == m_tail.load(std::memory_order_seq_cst);
+  }
+
+  std::size_t size() const noexcept {
+    return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+  }
+
+};
+
+} // end detail namespace
+} // end net namespace
+} // end chops namespace
+
+#endif
+
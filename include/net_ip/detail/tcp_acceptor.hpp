@@ -4,6 +4,12 @@
  *
  *  @brief TCP acceptor, for internal use.
  *
+ *  The acceptor is a class template on the stream protocol, instantiated for TCP and for
+ *  local (Unix domain) stream sockets. TLS and sharding (@c SO_REUSEPORT) are only used
+ *  for TCP. A local acceptor is bound to a socket file; the reuse address flag removes a
+ *  file left in place (e.g. by a previous run) before the bind, and the file is removed
+ *  when the acceptor is stopped. An abstract (Linux) endpoint has no file.
+ *
  *  @note For internal use only.
  *
  *  @author Cliff Green
@@ -21,55 +27,181 @@
 #include <experimental/internet>
 #include <experimental/io_context>
 #include <experimental/executor>
+#include <experimental/timer>
 
 #include <system_error>
 #include <memory>
 #include <vector>
 #include <utility> // std::move, std::forward
 #include <cstddef> // for std::size_t
-#include <functional> // std::bind
+#include <functional> // std::bind, std::function
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <algorithm> // std::min
+#include <type_traits> // std::is_same_v
+
+#include <unistd.h> // unlink
 
 #include "net_ip/detail/tcp_io.hpp"
+#include "net_ip/local_protocol.hpp"
 #include "net_ip/detail/net_entity_common.hpp"
+#include "net_ip/detail/socket_options.hpp"
+#include "net_ip/detail/handler_memory.hpp"
+#include "net_ip/detail/handler_registry.hpp"
+#ifdef CHOPS_NET_TLS
+#include "net_ip/detail/tls_handshake.hpp"
+#include "net_ip/tls_context.hpp"
+#endif
 
 #include "net_ip/io_interface.hpp"
-
-#include "utility/erase_where.hpp"
+#include "net_ip/instrumentation.hpp"
+#include "net_ip/net_ip_metrics.hpp"
+#include "net_ip/socket_profile.hpp"
+#include "net_ip/accept_limits.hpp"
 
 namespace chops {
 namespace net {
 namespace detail {
 
-class tcp_acceptor : public std::enable_shared_from_this<tcp_acceptor> {
+template <typename Protocol>
+class basic_stream_acceptor : public std::enable_shared_from_this<basic_stream_acceptor<Protocol> > {
 public:
-  using socket_type = std::experimental::net::ip::tcp::acceptor;
-  using endpoint_type = std::experimental::net::ip::tcp::endpoint;
+  using socket_type = typename Protocol::acceptor;
+  using endpoint_type = typename Protocol::endpoint;
+  using io_type = basic_stream_io<Protocol>;
+  using io_ptr = std::shared_ptr<io_type>;
+  // if set, called for each accept to choose the io_context of the new connection
+  using io_context_selector = std::function<std::experimental::net::io_context& ()>;
+
+private:
+  using strand_type = std::experimental::net::strand<typename socket_type::executor_type>;
+  using stream_socket_type = typename Protocol::socket;
+
+  static constexpr bool is_tcp = std::is_same_v<Protocol, std::experimental::net::ip::tcp>;
+  static constexpr bool is_local = std::is_same_v<Protocol, chops::net::local::stream_protocol>;
+
+  // a listening socket, with a strand on the io_context of the socket (the primary 
+  // listener shares the acceptor strand); the accept completions of a listener run on its
+  // strand, and the pending handlers own the listener, so a completion after a stop (or 
+  // a restart) only uses its own listener
+  struct listener {
+    socket_type       m_acc;
+    strand_type       m_strand;
+    // recycled accept operation storage, a listener has one outstanding accept
+    handler_memory    m_mem;
+    std::atomic_bool  m_closed;
+
+    listener(socket_type acc, const strand_type& st) : 
+      m_acc(std::move(acc)), m_strand(st), m_mem(), m_closed(false) { }
+  };
+  using listener_ptr = std::shared_ptr<listener>;
 
 private:
-  net_entity_common<tcp_io>  m_entity_common;
-  socket_type                m_acceptor;
-  std::vector<tcp_io_ptr>    m_io_handlers;
+  net_entity_common<io_type> m_entity_common;
+  std::experimental::net::io_context& m_ioc;
+  // the handler container and the callbacks are serialized through the acceptor strand
+  strand_type                m_strand;
+  // constant time insert and erase, the handler id is the registry slot
+  handler_registry<io_ptr>   m_io_handlers;
   endpoint_type              m_acceptor_endp;
   bool                       m_reuse_addr;
+  io_context_selector        m_ioc_selector;
+  // applied to each accepted socket
+  socket_profile             m_sock_prof;
+
+  // sharded acceptor, one additional listening socket (bound to the same endpoint 
+  // with SO_REUSEPORT) per additional io_context, the kernel spreads incoming 
+  // connections across the listeners; the first listener is the primary listener,
+  // the listeners are created at each start
+  std::vector<std::experimental::net::io_context*> m_shard_iocs;
+  std::vector<listener_ptr>                        m_listeners;
+
+  // the limit state is shared by the listeners, guarded by the mutex; listeners without
+  // an outstanding accept while a limit is reached are parked, the timer resumes them 
+  // when the accept rate allows
+  accept_limits                                    m_limits;
+  std::mutex                                       m_limit_mutex;
+  std::vector<listener_ptr>                        m_paused;
+  std::experimental::net::steady_timer             m_resume_timer;
+  bool                                             m_timer_armed;
+  // token bucket for the accept rate, refilled at max_accepts_per_sec
+  double                                           m_tokens;
+  std::chrono::steady_clock::time_point            m_token_time;
+  // accepted connections not yet closed, including handshakes and connections on their
+  // way to the handler container
+  std::atomic_size_t                               m_num_conns;
+
+  std::atomic_size_t                               m_num_accepted;
+  std::atomic_size_t                               m_num_batched;
+  std::atomic_size_t                               m_num_deferred;
+  std::atomic_bool                                 m_is_paused;
+  // a local acceptor removes the socket file at stop only if it was bound by this start
+  bool                                             m_owns_file;
+
+#ifdef CHOPS_NET_TLS
+  // if set, each accepted connection performs a TLS handshake before the IO handler is
+  // created; handshakes in progress count towards the connection limit
+  tls_context_ptr                                  m_tls;
+  handler_registry<tls_handshake_ptr>              m_handshakes;
+#endif
 
 public:
-  tcp_acceptor(std::experimental::net::io_context& ioc, const endpoint_type& endp,
-               bool reuse_addr) :
-    m_entity_common(), m_acceptor(ioc), m_io_handlers(), m_acceptor_endp(endp), 
-    m_reuse_addr(reuse_addr) { }
+  basic_stream_acceptor(std::experimental::net::io_context& ioc, const endpoint_type& endp,
+               bool reuse_addr, io_context_selector sel = io_context_selector(),
+               const socket_profile& prof = socket_profile(),
+               const accept_limits& lim = accept_limits()) :
+    m_entity_common(), m_ioc(ioc), m_strand(ioc.get_executor()), 
+    m_io_handlers(), m_acceptor_endp(endp), m_reuse_addr(reuse_addr), 
+    m_ioc_selector(std::move(sel)), m_sock_prof(prof), m_shard_iocs(), 
+    m_listeners(1u, std::make_shared<listener>(socket_type(ioc), m_strand)), m_limits(lim), 
+    m_limit_mutex(), m_paused(), m_resume_timer(ioc), m_timer_armed(false), m_tokens(0.0),
+    m_token_time(), m_num_conns(0), m_num_accepted(0), m_num_batched(0), m_num_deferred(0),
+    m_is_paused(false), m_owns_file(false) { }
+
+  // the first io_context is used for the primary listener and the acceptor strand; if 
+  // SO_REUSEPORT is not supported only the first io_context is used
+  basic_stream_acceptor(const std::vector<std::experimental::net::io_context*>& iocs, 
+               const endpoint_type& endp, bool reuse_addr,
+               const socket_profile& prof = socket_profile(),
+               const accept_limits& lim = accept_limits()) :
+    m_entity_common(), m_ioc(*iocs.at(0)), m_strand(m_ioc.get_executor()), 
+    m_io_handlers(), m_acceptor_endp(endp), m_reuse_addr(reuse_addr), 
+    m_ioc_selector(), m_sock_prof(prof), m_shard_iocs(), 
+    m_listeners(1u, std::make_shared<listener>(socket_type(m_ioc), m_strand)), m_limits(lim), 
+    m_limit_mutex(), m_paused(), m_resume_timer(m_ioc), m_timer_armed(false), m_tokens(0.0),
+    m_token_time(), m_num_conns(0), m_num_accepted(0), m_num_batched(0), m_num_deferred(0),
+    m_is_paused(false), m_owns_file(false) {
+    if (reuse_port_supported) {
+      m_shard_iocs.assign(iocs.cbegin()+1, iocs.cend());
+    }
+  }
 
 private:
   // no copy or assignment semantics for this class
-  tcp_acceptor(const tcp_acceptor&) = delete;
-  tcp_acceptor(tcp_acceptor&&) = delete;
-  tcp_acceptor& operator=(const tcp_acceptor&) = delete;
-  tcp_acceptor& operator=(tcp_acceptor&&) = delete;
+  basic_stream_acceptor(const basic_stream_acceptor&) = delete;
+  basic_stream_acceptor(basic_stream_acceptor&&) = delete;
+  basic_stream_acceptor& operator=(const basic_stream_acceptor&) = delete;
+  basic_stream_acceptor& operator=(basic_stream_acceptor&&) = delete;
 
 public:
 
   bool is_started() const noexcept { return m_entity_common.is_started(); }
 
-  socket_type& get_socket() noexcept { return m_acceptor; }
+  // for a sharded acceptor this is the primary listener
+  socket_type& get_socket() noexcept { return m_listeners.front()->m_acc; }
+
+  std::size_t num_shards() const noexcept { return m_shard_iocs.size() + 1u; }
+
+#ifdef CHOPS_NET_TLS
+  // called before start
+  void set_tls(tls_context_ptr ctx) { m_tls = std::move(ctx); }
+#endif
+
+  accept_stats get_accept_stats() const noexcept {
+    return accept_stats { m_num_accepted.load(), m_num_batched.load(), 
+                          m_num_deferred.load(), m_is_paused.load() };
+  }
 
   template <typename F1, typename F2>
   bool start(F1&& io_state_chg, F2&& err_func) {
@@ -78,15 +210,48 @@ public:
       return false;
     }
     try {
-      m_acceptor = socket_type(m_acceptor.get_executor().context(), m_acceptor_endp,
-                               m_reuse_addr);
+      if constexpr (is_local) {
+        if (m_reuse_addr) {
+          remove_stale_socket_file();
+        }
+      }
+      // a completion of a previous start still owns its (closed) listener
+      std::vector<listener_ptr> listeners;
+      if (m_shard_iocs.empty()) {
+        listeners.push_back(std::make_shared<listener>(socket_type(m_ioc, m_acceptor_endp,
+                                                                   m_reuse_addr), m_strand));
+      }
+      else {
+        listeners.push_back(std::make_shared<listener>(make_shard_acceptor(m_ioc), m_strand));
+        for (auto ioc : m_shard_iocs) {
+          auto acc = make_shard_acceptor(*ioc);
+          strand_type st(acc.get_executor());
+          listeners.push_back(std::make_shared<listener>(std::move(acc), st));
+        }
+      }
+      m_listeners = std::move(listeners);
+      m_owns_file = is_local;
+      // the batched accepts after each completion must not block
+      for (auto& l : m_listeners) {
+        l->m_acc.native_non_blocking(true);
+      }
     }
     catch (const std::system_error& se) {
-      m_entity_common.call_error_cb(tcp_io_ptr(), se.code());
+      m_entity_common.call_error_cb(io_ptr(), se.code());
       stop();
       return false;
     }
-    start_accept();
+    {
+      std::lock_guard<std::mutex> lk(m_limit_mutex);
+      m_paused.clear();
+      m_is_paused = false;
+      m_timer_armed = false;
+      m_tokens = static_cast<double>(m_limits.max_accepts_per_sec);
+      m_token_time = std::chrono::steady_clock::now();
+    }
+    for (auto& l : m_listeners) {
+      rearm_accept(l);
+    }
     return true;
   }
 
@@ -94,50 +259,348 @@ public:
     if (!m_entity_common.stop()) {
       return false; // stop already called
     }
-    auto iohs = m_io_handlers;
-    for (auto i : iohs) {
-      i->stop_io();
+    // the stop_io on each tcp_io handler erases it from the registry, which is safe 
+    // while iterating
+    m_io_handlers.for_each([] (const io_ptr& i) { i->stop_io(); } );
+#ifdef CHOPS_NET_TLS
+    // the handshake completions are in the acceptor strand, and only erase their 
+    // entries; each handshake is cancelled in its own strand
+    auto self = this->shared_from_this();
+    dispatch(m_strand, [this, self] {
+        m_handshakes.for_each([] (const tls_handshake_ptr& h) { h->post_cancel(); } );
+      }
+    );
+#endif
+    m_entity_common.call_error_cb(io_ptr(), std::make_error_code(net_ip_errc::tcp_acceptor_stopped));
+    {
+      // a parked listener is not resumed, and is released with the pending accepts
+      std::lock_guard<std::mutex> lk(m_limit_mutex);
+      m_paused.clear();
+      m_is_paused = false;
+      m_resume_timer.cancel();
     }
-    // m_io_handlers.clear(); // the stop_io on each tcp_io handler should clear the container
-    m_entity_common.call_error_cb(tcp_io_ptr(), std::make_error_code(net_ip_errc::tcp_acceptor_stopped));
     std::error_code ec;
-    m_acceptor.close(ec);
+    for (auto& l : m_listeners) {
+      l->m_closed = true;
+      l->m_acc.close(ec);
+    }
+    if (m_owns_file) {
+      m_owns_file = false;
+      remove_socket_file();
+    }
     return true;
   }
 
 private:
 
-  void start_accept() {
-    using namespace std::placeholders;
+  void remove_socket_file() noexcept {
+    if constexpr (is_local) {
+      if (!m_acceptor_endp.is_abstract() && !m_acceptor_endp.path().empty()) {
+        ::unlink(m_acceptor_endp.path().c_str());
+      }
+    }
+  }
+
+  // the path is probed with a connect, a live server accepts it and its socket file is
+  // kept (the bind then fails); only a refused connect means the file is stale
+  void remove_stale_socket_file() {
+    if constexpr (is_local) {
+      if (m_acceptor_endp.is_abstract() || m_acceptor_endp.path().empty()) {
+        return;
+      }
+      stream_socket_type probe(m_ioc);
+      std::error_code ec;
+      probe.connect(m_acceptor_endp, ec);
+      if (ec == std::errc::connection_refused) {
+        remove_socket_file();
+      }
+    }
+  }
+
+  socket_type make_shard_acceptor(std::experimental::net::io_context& ioc) {
+    socket_type acc(ioc);
+    acc.open(m_acceptor_endp.protocol());
+    if (m_reuse_addr) {
+      acc.set_option(std::experimental::net::socket_base::reuse_address(true));
+    }
+#ifdef SO_REUSEPORT
+    acc.set_option(reuse_port(true));
+#endif
+    acc.bind(m_acceptor_endp);
+    acc.listen();
+    return acc;
+  }
+
+  // refills the token bucket, and returns the time until an accept is allowed by the
+  // rate, zero if allowed now; called with the limit mutex held
+  std::chrono::steady_clock::duration rate_wait() {
+    if (m_limits.max_accepts_per_sec == 0u) {
+      return std::chrono::steady_clock::duration::zero();
+    }
+    auto now = std::chrono::steady_clock::now();
+    double rate = static_cast<double>(m_limits.max_accepts_per_sec);
+    std::chrono::duration<double> elapsed = now - m_token_time;
+    m_token_time = now;
+    m_tokens = std::min(rate, m_tokens + elapsed.count() * rate);
+    if (m_tokens >= 1.0) {
+      return std::chrono::steady_clock::duration::zero();
+    }
+    return std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+               std::chrono::duration<double>((1.0 - m_tokens) / rate)) +
+           std::chrono::steady_clock::duration(1);
+  }
+
+  bool below_max_connections() const noexcept {
+    return m_limits.max_connections == 0u || m_num_conns < m_limits.max_connections;
+  }
+
+  // called with the limit mutex held
+  bool accept_allowed() {
+    return below_max_connections() && rate_wait() == std::chrono::steady_clock::duration::zero();
+  }
 
-    auto self = shared_from_this();
-    m_acceptor.async_accept( [this, self] 
-            (const std::error_code& err, std::experimental::net::ip::tcp::socket sock) mutable {
-        if (err) {
-          m_entity_common.call_error_cb(tcp_io_ptr(), err);
-          stop(); // is this the right thing to do? what are possible causes of errors?
+  // counts an accepted connection against the limits; with several listeners a 
+  // connection may be accepted while the limit is reached (see accept_limits)
+  void count_accept() {
+    instrument(io_event::accepted);
+    record_metric(net_metric::accepts);
+    ++m_num_accepted;
+    ++m_num_conns;
+    if (m_limits.max_accepts_per_sec != 0u) {
+      std::lock_guard<std::mutex> lk(m_limit_mutex);
+      m_tokens -= 1.0;
+    }
+  }
+
+  bool batch_accept_allowed() {
+    std::lock_guard<std::mutex> lk(m_limit_mutex);
+    return accept_allowed();
+  }
+
+  // the listener is parked if a limit is reached, resumed by resume_accepts; called in
+  // the listener strand (or before the first accept)
+  void rearm_accept(const listener_ptr& lp) {
+    if (!m_entity_common.is_started()) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lk(m_limit_mutex);
+      if (!accept_allowed()) {
+        if (!lp->m_closed) {
+          m_paused.push_back(lp);
+          ++m_num_deferred;
+          m_is_paused = true;
+          start_resume_timer();
+        }
+        return;
+      }
+    }
+    start_accept(lp);
+  }
+
+  // back to accepting when every limit allows it; the timer is only needed for the rate,
+  // a connection close resumes when the connection limit was reached
+  void resume_accepts() {
+    std::vector<listener_ptr> paused;
+    {
+      std::lock_guard<std::mutex> lk(m_limit_mutex);
+      if (m_paused.empty() || !m_entity_common.is_started() || !below_max_connections()) {
+        return;
+      }
+      if (rate_wait() != std::chrono::steady_clock::duration::zero()) {
+        start_resume_timer();
+        return;
+      }
+      paused = std::move(m_paused);
+      m_paused.clear();
+      m_is_paused = false;
+    }
+    auto self = this->shared_from_this();
+    for (auto& lp : paused) {
+      dispatch(lp->m_strand, [this, self, lp] { start_accept(lp); } );
+    }
+  }
+
+  // called with the limit mutex held
+  void start_resume_timer() {
+    auto wait = rate_wait();
+    if (m_timer_armed || wait == std::chrono::steady_clock::duration::zero()) {
+      return;
+    }
+    m_timer_armed = true;
+    m_resume_timer.expires_after(wait);
+    auto self = this->shared_from_this();
+    m_resume_timer.async_wait(std::experimental::net::bind_executor(m_strand,
+          [this, self] (const std::error_code& err) {
+        {
+          std::lock_guard<std::mutex> lk(m_limit_mutex);
+          m_timer_armed = false;
+        }
+        if (err) { // cancelled by stop
           return;
         }
-        tcp_io_ptr iop = std::make_shared<tcp_io>(std::move(sock), 
-          tcp_io::entity_notifier_cb(std::bind(&tcp_acceptor::notify_me, shared_from_this(), _1, _2)));
-        m_io_handlers.push_back(iop);
-        m_entity_common.call_io_state_chg_cb(iop, m_io_handlers.size(), true);
-        start_accept();
+        resume_accepts();
+      }
+    ));
+  }
+
+  void start_accept(const listener_ptr& lp) {
+    if (lp->m_closed) {
+      return;
+    }
+    auto self = this->shared_from_this();
+    auto hdlr = std::experimental::net::bind_executor(lp->m_strand, make_alloc_handler(lp->m_mem, 
+          [this, self, lp] 
+            (const std::error_code& err, stream_socket_type sock) mutable {
+        handle_accept(lp, err, std::move(sock));
+      }
+    ));
+    if (m_ioc_selector) {
+      lp->m_acc.async_accept(m_ioc_selector(), std::move(hdlr));
+      return;
+    }
+    lp->m_acc.async_accept(std::move(hdlr));
+  }
+
+  // in the listener strand, the accepted connections are handed to the acceptor strand
+  void handle_accept(const listener_ptr& lp, const std::error_code& err, 
+                     stream_socket_type sock) {
+    auto self = this->shared_from_this();
+    if (err) {
+      dispatch(m_strand, [this, self, lp, err] {
+          m_entity_common.call_error_cb(io_ptr(), err);
+          if (!lp->m_closed) {
+            stop(); // is this the right thing to do? what are possible causes of errors?
+          }
+        }
+      );
+      return;
+    }
+    count_accept();
+    add_connection(std::move(sock));
+    // drain pending connections without waiting, the acceptor is non-blocking; any error
+    // (normally would_block) ends the batch, the next async accept reports real errors
+    for (std::size_t i = 1u; i < m_limits.max_batch && m_entity_common.is_started() && 
+                             batch_accept_allowed(); ++i) {
+      std::error_code ec;
+      auto next = m_ioc_selector ? lp->m_acc.accept(m_ioc_selector(), ec) : 
+                                   lp->m_acc.accept(ec);
+      if (ec) {
+        break;
+      }
+      ++m_num_batched;
+      count_accept();
+      add_connection(std::move(next));
+    }
+    rearm_accept(lp);
+  }
+
+  // in the listener strand
+  void add_connection(stream_socket_type sock) {
+    std::error_code ec;
+    apply_socket_profile(sock, m_sock_prof, ec);
+    auto self = this->shared_from_this();
+    if (ec) { // not fatal, the connection is still usable
+      dispatch(m_strand, [this, self, ec] { m_entity_common.call_error_cb(io_ptr(), ec); } );
+    }
+#ifdef CHOPS_NET_TLS
+    if constexpr (is_tcp) { // TLS is only layered over TCP
+      if (m_tls) {
+        dispatch(m_strand, [this, self, s = std::move(sock)] () mutable {
+            start_tls(std::move(s));
+          }
+        );
+        return;
+      }
+    }
+#endif
+    dispatch(m_strand, [this, self, s = std::move(sock)] () mutable {
+        add_io_handler(std::move(s));
       }
     );
   }
 
-  void notify_me(std::error_code err, tcp_io_ptr iop) {
+  // closes a connection that is not handed to an IO handler, in the acceptor strand
+  void drop_connection() {
+    --m_num_conns;
+    resume_accepts();
+  }
+
+  // in the acceptor strand; ktls is set if the connection completed a TLS handshake
+  void add_io_handler(stream_socket_type sock, bool ktls = false) {
+    using namespace std::placeholders;
+
+    if (!m_entity_common.is_started()) {
+      std::error_code ec;
+      sock.close(ec);
+      drop_connection();
+      return;
+    }
+    io_ptr iop = std::make_shared<io_type>(std::move(sock), 
+      typename io_type::entity_notifier_cb(std::bind(&basic_stream_acceptor::notify_me, this->shared_from_this(), _1, _2)));
+    iop->set_handler_id(m_io_handlers.insert(iop));
+    if (ktls) {
+      iop->set_kernel_tls();
+    }
+    m_entity_common.call_io_state_chg_cb(iop, m_io_handlers.size(), true);
+  }
+
+#ifdef CHOPS_NET_TLS
+  // a failed handshake is reported through the error callback, and the socket is closed;
+  // the handshake runs in a strand on the io_context of the connection (chosen by the
+  // io_context selector or the listener shard), only the completion is serialized 
+  // through the acceptor strand
+  void start_tls(stream_socket_type sock) {
+    strand_type st(sock.get_executor());
+    auto hs = std::make_shared<tls_handshake>(std::move(sock), m_tls, st);
+    auto id = m_handshakes.insert(hs);
+    auto self = this->shared_from_this();
+    hs->start([this, self, id] 
+                (std::error_code err, stream_socket_type sock) {
+        dispatch(m_strand, [this, self, id, err, s = std::move(sock)] () mutable {
+            m_handshakes.erase(id);
+            if (!m_entity_common.is_started()) {
+              drop_connection();
+              return;
+            }
+            if (err) {
+              m_entity_common.call_error_cb(io_ptr(), err);
+              drop_connection();
+              return;
+            }
+            add_io_handler(std::move(s), true);
+          }
+        );
+      }
+    );
+  }
+#endif
+
+  // called from the tcp_io handler, which may be running on a different thread 
+  // (or io_context); the close is performed immediately, the handler container and
+  // callbacks are serialized through the acceptor strand (invoked inline if possible)
+  void notify_me(std::error_code err, io_ptr iop) {
     iop->close();
-    m_entity_common.call_error_cb(iop, err);
-    chops::erase_where(m_io_handlers, iop);
-    m_entity_common.call_io_state_chg_cb(iop, m_io_handlers.size(), false);
+    auto self = this->shared_from_this();
+    dispatch(m_strand, [this, self, err, iop] {
+        m_entity_common.call_error_cb(iop, err);
+        if (m_io_handlers.erase(iop->get_handler_id())) {
+          --m_num_conns;
+        }
+        m_entity_common.call_io_state_chg_cb(iop, m_io_handlers.size(), false);
+        resume_accepts();
+      }
+    );
   }
 
 };
 
+using tcp_acceptor = basic_stream_acceptor<std::experimental::net::ip::tcp>;
 using tcp_acceptor_ptr = std::shared_ptr<tcp_acceptor>;
 
+using local_stream_acceptor = basic_stream_acceptor<chops::net::local::stream_protocol>;
+using local_stream_acceptor_ptr = std::shared_ptr<local_stream_acceptor>;
+
 } // end detail namespace
 } // end net namespace
 } // end chops namespace
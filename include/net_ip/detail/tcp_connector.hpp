@@ -4,6 +4,12 @@
  *
  *  @brief TCP connector class, for internal use.
  *
+ *  The connector is a class template on the stream protocol, instantiated for TCP and
+ *  for local (Unix domain) stream sockets. Name resolution, the endpoints cache, address
+ *  family interleaving and TLS are only used for TCP, a local connector is given its
+ *  endpoint (the socket file path or abstract name). Reconnects (with backoff) are the
+ *  same for both, e.g. while the local acceptor process is restarting.
+ *
  *  @note For internal use only.
  *
  *  @author Cliff Green
@@ -28,14 +34,30 @@
 #include <vector>
 #include <memory>
 #include <chrono>
+#include <random>
+#include <string>
+#include <string_view>
 
 #include <cstddef> // for std::size_t
+#include <type_traits> // std::conditional_t, std::is_same_v
 
 #include "net_ip/detail/tcp_io.hpp"
+#include "net_ip/local_protocol.hpp"
 #include "net_ip/detail/net_entity_common.hpp"
+#include "net_ip/detail/socket_options.hpp"
+#ifdef CHOPS_NET_TLS
+#include "net_ip/detail/tls_handshake.hpp"
+#include "net_ip/tls_context.hpp"
+#endif
 
 #include "net_ip/endpoints_resolver.hpp"
+#include "net_ip/endpoints_cache.hpp"
 #include "net_ip/io_interface.hpp"
+#include "net_ip/instrumentation.hpp"
+#include "net_ip/net_ip_metrics.hpp"
+#include "net_ip/tcp_connect_options.hpp"
+#include "net_ip/socket_profile.hpp"
+#include "net_ip/net_ip_error.hpp"
 
 #include <cassert>
 
@@ -43,29 +65,76 @@ namespace chops {
 namespace net {
 namespace detail {
 
-class tcp_connector : public std::enable_shared_from_this<tcp_connector> {
+template <typename Protocol>
+class basic_stream_connector : public std::enable_shared_from_this<basic_stream_connector<Protocol> > {
 public:
-  using socket_type = std::experimental::net::ip::tcp::socket;
-  using endpoint_type = std::experimental::net::ip::tcp::endpoint;
+  using socket_type = typename Protocol::socket;
+  using endpoint_type = typename Protocol::endpoint;
+  using io_type = basic_stream_io<Protocol>;
+  using io_ptr = std::shared_ptr<io_type>;
 
 private:
-  using resolver_type = chops::net::endpoints_resolver<std::experimental::net::ip::tcp>;
-  using resolver_results = 
-    std::experimental::net::ip::basic_resolver_results<std::experimental::net::ip::tcp>;
+  static constexpr bool is_tcp = std::is_same_v<Protocol, std::experimental::net::ip::tcp>;
+
+  // names are only resolved for TCP, a local connector is given its endpoint
+  struct no_resolver {
+    explicit no_resolver(std::experimental::net::io_context&) noexcept { }
+    void cancel() noexcept { }
+  };
+
+  using resolver_type = std::conditional_t<is_tcp, 
+                                           chops::net::endpoints_resolver<Protocol>, no_resolver>;
+  using endpoints_cache_ptr = std::shared_ptr<chops::net::endpoints_cache<Protocol> >;
+  using resolver_results = std::experimental::net::ip::basic_resolver_results<Protocol>;
   using endpoints = std::vector<endpoint_type>;
-  using endpoints_iter = endpoints::const_iterator;
+  using strand_type = std::experimental::net::strand<typename socket_type::executor_type>;
+
+  // one connect attempt of a connect round, several may be in flight
+  struct connect_attempt {
+    socket_type                           m_socket;
+    std::experimental::net::steady_timer  m_timer;
+    bool                                  m_timed_out;
+
+    explicit connect_attempt(std::experimental::net::io_context& ioc) :
+      m_socket(ioc), m_timer(ioc), m_timed_out(false) { }
+  };
 
 private:
-  net_entity_common<tcp_io>             m_entity_common;
+  std::experimental::net::io_context&   m_ioc;
+  net_entity_common<io_type>            m_entity_common;
   socket_type                           m_socket;
-  tcp_io_ptr                            m_io_handler;
+  // connect round handlers run through the strand, since attempts complete independently
+  strand_type                           m_strand;
+  io_ptr                                m_io_handler;
   resolver_type                         m_resolver;
+  endpoints_cache_ptr                   m_endpoints_cache;
   endpoints                             m_endpoints;
   std::experimental::net::steady_timer  m_timer;
-  std::chrono::milliseconds             m_reconn_time;
+  tcp_connect_options                   m_opts;
+  // applied to each socket before the connect
+  socket_profile                        m_sock_prof;
+  std::chrono::milliseconds             m_backoff;
+  std::minstd_rand                      m_rand;
   std::string                           m_remote_host;
   std::string                           m_remote_port;
 
+  // state of the current connect round, a new round invalidates outstanding handlers
+  std::vector<std::unique_ptr<connect_attempt> > m_attempts;
+  endpoints                             m_round_endpoints;
+  std::size_t                           m_next_endp;
+  std::size_t                           m_pending;
+  std::size_t                           m_round;
+  std::error_code                       m_last_err;
+  // a wait that completed before it was cancelled or re-armed is ignored by its sequence
+  std::experimental::net::steady_timer  m_delay_timer;
+  std::size_t                           m_delay_seq;
+
+#ifdef CHOPS_NET_TLS
+  // if set, each connection performs a TLS handshake before the IO handler is created
+  tls_context_ptr                       m_tls;
+  tls_handshake_ptr                     m_handshake;
+#endif
+
   // TODO: currently this flag is needed to distinguish whether a connect
   // handler can't connect or whether the operation is cancelled and it's
   // time to shutdown
@@ -73,41 +142,77 @@ private:
 
 public:
   template <typename Iter>
-  tcp_connector(std::experimental::net::io_context& ioc, 
-                Iter beg, Iter end, std::chrono::milliseconds reconn_time) :
-      m_entity_common(),
-      m_socket(ioc),
-      m_io_handler(),
-      m_resolver(ioc),
-      m_endpoints(beg, end),
-      m_timer(ioc),
-      m_reconn_time(reconn_time),
-      m_remote_host(),
-      m_remote_port(),
-      m_shutting_down(false)
-    { }
+  basic_stream_connector(std::experimental::net::io_context& ioc, 
+                Iter beg, Iter end, std::chrono::milliseconds reconn_time,
+                const socket_profile& prof = socket_profile()) :
+      basic_stream_connector(ioc, beg, end, fixed_reconn(reconn_time), prof) { }
+
+  template <typename Iter>
+  basic_stream_connector(std::experimental::net::io_context& ioc, 
+                Iter beg, Iter end, const tcp_connect_options& opts,
+                const socket_profile& prof = socket_profile()) :
+      basic_stream_connector(ioc, endpoints(beg, end), std::string_view(), std::string_view(), 
+                    opts, endpoints_cache_ptr(), prof) { }
 
-  tcp_connector(std::experimental::net::io_context& ioc,
+  basic_stream_connector(std::experimental::net::io_context& ioc,
                 std::string_view remote_port, std::string_view remote_host, 
-                std::chrono::milliseconds reconn_time) :
+                std::chrono::milliseconds reconn_time,
+                endpoints_cache_ptr endp_cache = endpoints_cache_ptr(),
+                const socket_profile& prof = socket_profile()) :
+      basic_stream_connector(ioc, endpoints(), remote_port, remote_host, fixed_reconn(reconn_time),
+                    std::move(endp_cache), prof) { }
+
+  basic_stream_connector(std::experimental::net::io_context& ioc,
+                std::string_view remote_port, std::string_view remote_host, 
+                const tcp_connect_options& opts,
+                endpoints_cache_ptr endp_cache = endpoints_cache_ptr(),
+                const socket_profile& prof = socket_profile()) :
+      basic_stream_connector(ioc, endpoints(), remote_port, remote_host, opts, std::move(endp_cache),
+                    prof) { }
+
+private:
+  basic_stream_connector(std::experimental::net::io_context& ioc, endpoints endps,
+                std::string_view remote_port, std::string_view remote_host, 
+                const tcp_connect_options& opts, endpoints_cache_ptr endp_cache,
+                const socket_profile& prof) :
+      m_ioc(ioc),
       m_entity_common(),
       m_socket(ioc),
+      m_strand(m_socket.get_executor()),
       m_io_handler(),
       m_resolver(ioc),
-      m_endpoints(),
+      m_endpoints_cache(std::move(endp_cache)),
+      m_endpoints(std::move(endps)),
       m_timer(ioc),
-      m_reconn_time(reconn_time),
+      m_opts(opts),
+      m_sock_prof(prof),
+      m_backoff(opts.reconn_time),
+      m_rand(std::random_device()()),
       m_remote_host(remote_host),
       m_remote_port(remote_port),
+      m_attempts(),
+      m_round_endpoints(),
+      m_next_endp(0u),
+      m_pending(0u),
+      m_round(0u),
+      m_last_err(),
+      m_delay_timer(ioc),
+      m_delay_seq(0u),
       m_shutting_down(false)
     { }
 
+  static tcp_connect_options fixed_reconn(std::chrono::milliseconds reconn_time) {
+    tcp_connect_options opts;
+    opts.reconn_time = reconn_time;
+    return opts;
+  }
+
 private:
   // no copy or assignment semantics for this class
-  tcp_connector(const tcp_connector&) = delete;
-  tcp_connector(tcp_connector&&) = delete;
-  tcp_connector& operator=(const tcp_connector&) = delete;
-  tcp_connector& operator=(tcp_connector&&) = delete;
+  basic_stream_connector(const basic_stream_connector&) = delete;
+  basic_stream_connector(basic_stream_connector&&) = delete;
+  basic_stream_connector& operator=(const basic_stream_connector&) = delete;
+  basic_stream_connector& operator=(basic_stream_connector&&) = delete;
 
 public:
 
@@ -115,41 +220,95 @@ public:
 
   socket_type& get_socket() noexcept { return m_socket; }
 
+#ifdef CHOPS_NET_TLS
+  // called before start
+  void set_tls(tls_context_ptr ctx) { m_tls = std::move(ctx); }
+#endif
+
   template <typename F1, typename F2>
   bool start(F1&& io_state_chg, F2&& err_cb) {
     if (!m_entity_common.start(std::forward<F1>(io_state_chg), std::forward<F2>(err_cb))) {
       // already started
       return false;
     }
-    m_shutting_down = false;
+    // the connector state is only changed within the strand, after the teardown of a 
+    // previous stop
+    auto self = this->shared_from_this();
+    post(m_strand, [this, self] {
+        m_shutting_down = false;
+        m_backoff = m_opts.reconn_time;
+        if constexpr (is_tcp) {
+          if (start_resolve()) {
+            return;
+          }
+        }
+        start_connect();
+      }
+    );
+    return true;
+  }
+
+private:
+
+  // true if the endpoints are obtained first, the connect is then started in the strand
+  // when they are available; called within the strand
+  bool start_resolve() {
+    // with a cache the endpoints are obtained on every start, picking up refreshed entries
+    if (m_endpoints_cache) {
+      auto self = this->shared_from_this();
+      // the cache calls back from its own io_context, not through the associated executor
+      m_endpoints_cache->make_endpoints(false, m_remote_host, m_remote_port,
+        [this, self] 
+             (std::error_code err, endpoints endps) mutable {
+          post(m_strand, [this, self, err, endps = std::move(endps)] () mutable {
+              if (!is_started() || m_shutting_down) {
+                return; // stopped while waiting on the cache, a shared resolve is not cancelled
+              }
+              if (err) {
+                m_entity_common.call_error_cb(io_ptr(), err);
+                m_entity_common.stop();
+                return;
+              }
+              m_endpoints = std::move(endps);
+              start_connect();
+            }
+          );
+        }
+      );
+      return true;
+    }
     // empty endpoints container is the flag that a resolve is needed
     if (m_endpoints.empty()) {
-      auto self = shared_from_this();
+      auto self = this->shared_from_this();
       m_resolver.make_endpoints(false, m_remote_host, m_remote_port,
-        [this, self] 
+        std::experimental::net::bind_executor(m_strand, [this, self] 
              (std::error_code err, resolver_results res) mutable {
           if (err) {
-            m_entity_common.call_error_cb(tcp_io_ptr(), err);
+            m_entity_common.call_error_cb(io_ptr(), err);
             m_entity_common.stop();
             return;
           }
+          if (m_shutting_down) {
+            return;
+          }
           for (const auto& e : res) {
             m_endpoints.push_back(e.endpoint());
           }
           start_connect();
-        }
+        } )
       );
       return true;
     }
-    start_connect();
-    return true;
+    return false;
   }
 
+public:
+
   bool stop() {
     if (!close()) {
       return false;
     }
-    m_entity_common.call_error_cb(tcp_io_ptr(), std::make_error_code(net_ip_errc::tcp_connector_stopped));
+    m_entity_common.call_error_cb(io_ptr(), std::make_error_code(net_ip_errc::tcp_connector_stopped));
     return true;
   }
 
@@ -160,8 +319,18 @@ private:
     if (!m_entity_common.stop()) {
       return false; // stop already called
     }
+    // the resolver, timer, socket and IO handler are used by the strand handlers, so 
+    // they are torn down within the strand
+    auto self = this->shared_from_this();
+    post(m_strand, [this, self] { shut_down(); } );
+    return true;
+  }
+
+  // following methods are only called within the strand
+
+  void shut_down() {
     m_shutting_down = true;
-    if (m_endpoints.empty()) { // may be in middle of resolve
+    if (m_endpoints.empty() && !m_endpoints_cache) { // may be in middle of resolve
       m_resolver.cancel();
     }
     if (m_io_handler) {
@@ -172,57 +341,252 @@ private:
     }
     else {
       // IO handler not created, may be waiting on timer
-      // or in middle of an async connect
+      // or in middle of a connect round
       m_timer.cancel();
+      end_round();
     }
     std::error_code ec;
     m_socket.close(ec);
-    return true;
   }
 
   void start_connect() {
-    auto self = shared_from_this();
-    std::experimental::net::async_connect(m_socket, m_endpoints.cbegin(), m_endpoints.cend(),
-          [this, self] 
-                (const std::error_code& err, endpoints_iter iter) mutable {
-        handle_connect(err, iter);
+    if (m_shutting_down) {
+      return;
+    }
+    instrument(io_event::connect_attempt);
+    record_metric(net_metric::connect_attempts);
+    end_round();
+    m_round_endpoints = m_endpoints;
+    if constexpr (is_tcp) {
+      if (m_opts.attempt_delay.count() > 0) {
+        m_round_endpoints = interleave_families(m_endpoints);
       }
-    );
+    }
+    m_last_err = std::make_error_code(std::errc::host_unreachable); // if no endpoints
+    start_attempt();
   }
 
-  void handle_connect (const std::error_code& err, endpoints_iter /* iter */) {
-    using namespace std::placeholders;
+  // invalidates outstanding handlers of the current round, destroying the attempt sockets
+  // and timers cancels their operations
+  void end_round() {
+    ++m_round;
+    m_attempts.clear();
+    m_next_endp = 0u;
+    m_pending = 0u;
+    m_delay_timer.cancel();
+    ++m_delay_seq;
+#ifdef CHOPS_NET_TLS
+    if (m_handshake) {
+      m_handshake->cancel();
+      m_handshake.reset();
+    }
+#endif
+  }
 
-    if (err) {
-      m_entity_common.call_error_cb(tcp_io_ptr(), err);
-      if (!is_started() || m_shutting_down ) {
-//      if (!is_started() || err.value() == something) {
-        return;
+  // IPv6 first, then alternating address families (RFC 8305)
+  static endpoints interleave_families(const endpoints& endps) {
+    endpoints v6;
+    endpoints v4;
+    for (const auto& e : endps) {
+      (e.address().is_v6() ? v6 : v4).push_back(e);
+    }
+    endpoints res;
+    for (std::size_t i = 0u; i < v6.size() || i < v4.size(); ++i) {
+      if (i < v6.size()) {
+        res.push_back(v6[i]);
       }
-      try {
-        m_timer.expires_after(m_reconn_time);
+      if (i < v4.size()) {
+        res.push_back(v4[i]);
       }
-      catch (const std::system_error& se) {
-        m_entity_common.call_error_cb(tcp_io_ptr(), se.code());
-        m_entity_common.stop();
-        return;
+    }
+    return res;
+  }
+
+  void start_attempt() {
+    if (m_next_endp >= m_round_endpoints.size()) {
+      if (m_pending == 0u) {
+        end_round(); // the round failed, a pending delay wait must not report it again
+        handle_connect_failure(m_last_err);
       }
-      auto self = shared_from_this();
-      m_timer.async_wait( [this, self] 
-                          (const std::error_code& err) mutable {
-          if (!err) {
-            start_connect();
-          }
+      return;
+    }
+    // an attempt started by a failure replaces the delay wait of the previous attempt
+    m_delay_timer.cancel();
+    ++m_delay_seq;
+    auto self = this->shared_from_this();
+    auto round = m_round;
+    auto idx = m_attempts.size();
+    m_attempts.push_back(std::make_unique<connect_attempt>(m_ioc));
+    auto& att = *m_attempts.back();
+    ++m_pending;
+    const auto& endp = m_round_endpoints[m_next_endp++];
+    std::error_code ec;
+    att.m_socket.open(endp.protocol(), ec);
+    if (!ec) {
+      apply_socket_profile(att.m_socket, m_sock_prof, ec);
+    }
+    if (ec) { // not fatal, a failed open is also reported by the connect
+      m_entity_common.call_error_cb(io_ptr(), ec);
+    }
+    att.m_socket.async_connect(endp,
+      std::experimental::net::bind_executor(m_strand, 
+          [this, self, round, idx] (const std::error_code& err) {
+        handle_attempt(round, idx, err);
+      } )
+    );
+    if (m_opts.attempt_timeout.count() > 0) {
+      att.m_timer.expires_after(m_opts.attempt_timeout);
+      att.m_timer.async_wait(std::experimental::net::bind_executor(m_strand,
+          [this, self, round, idx] (const std::error_code& err) {
+        if (err || round != m_round) {
+          return;
         }
+        auto& a = *m_attempts[idx];
+        a.m_timed_out = true;
+        std::error_code ec;
+        a.m_socket.close(ec); // the connect completes with an error
+      } )
       );
+    }
+    // the next attempt starts when the delay expires or this attempt fails
+    if (m_opts.attempt_delay.count() > 0 && m_next_endp < m_round_endpoints.size()) {
+      auto seq = m_delay_seq;
+      m_delay_timer.expires_after(m_opts.attempt_delay);
+      m_delay_timer.async_wait(std::experimental::net::bind_executor(m_strand,
+          [this, self, round, seq] (const std::error_code& err) {
+        if (!err && round == m_round && seq == m_delay_seq && !m_shutting_down) {
+          start_attempt();
+        }
+      } )
+      );
+    }
+  }
+
+  void handle_attempt(std::size_t round, std::size_t idx, const std::error_code& err) {
+    if (round != m_round || m_shutting_down) {
+      return;
+    }
+    auto& att = *m_attempts[idx];
+    att.m_timer.cancel();
+    --m_pending;
+    if (err) {
+      m_last_err = att.m_timed_out ? 
+        std::make_error_code(net_ip_errc::tcp_connect_timeout) : err;
+      start_attempt();
       return;
     }
-    m_io_handler = std::make_shared<tcp_io>(std::move(m_socket), 
-      tcp_io::entity_notifier_cb(std::bind(&tcp_connector::notify_me, shared_from_this(), _1, _2)));
+    socket_type sock(std::move(att.m_socket));
+    end_round(); // cancels the other attempts
+#ifdef CHOPS_NET_TLS
+    if constexpr (is_tcp) { // TLS is only layered over TCP
+      if (m_tls) {
+        start_tls(std::move(sock));
+        return;
+      }
+    }
+#endif
+    connected(std::move(sock));
+  }
+
+  // ktls is set if the connection completed a TLS handshake
+  void connected(socket_type sock, bool ktls = false) {
+    using namespace std::placeholders;
+
+    m_backoff = m_opts.reconn_time;
+    record_metric(net_metric::connects);
+    m_io_handler = std::make_shared<io_type>(std::move(sock), 
+      typename io_type::entity_notifier_cb(std::bind(&basic_stream_connector::notify_me, this->shared_from_this(), _1, _2)));
+    if (ktls) {
+      m_io_handler->set_kernel_tls();
+    }
     m_entity_common.call_io_state_chg_cb(m_io_handler, 1, true);
   }
 
-  void notify_me(std::error_code err, tcp_io_ptr iop) {
+#ifdef CHOPS_NET_TLS
+  // the handshake belongs to the current round, a failure is handled as a connect 
+  // failure (reconnecting after the backoff time); sessions are cached by remote host 
+  // (or address) and port
+  void start_tls(socket_type sock) {
+    std::error_code ec;
+    auto endp = sock.remote_endpoint(ec);
+    std::string host = m_remote_host.empty() ? endp.address().to_string() : m_remote_host;
+    std::string key = host + ':' + std::to_string(endp.port());
+    std::string sni = m_tls->get_config().server_name.empty() ? m_remote_host :
+                        m_tls->get_config().server_name;
+    m_handshake = std::make_shared<tls_handshake>(std::move(sock), m_tls, m_strand,
+                                                  std::move(key), std::move(sni));
+    auto self = this->shared_from_this();
+    auto round = m_round;
+    m_handshake->start([this, self, round] (std::error_code err, socket_type sock) {
+        if (round != m_round || m_shutting_down) {
+          return;
+        }
+        m_handshake.reset();
+        if (err) {
+          handle_connect_failure(err);
+          return;
+        }
+        connected(std::move(sock), true);
+      }
+    );
+  }
+#endif
+
+  // next reconnect wait, with exponential backoff and jitter
+  std::chrono::milliseconds next_reconn_time() {
+    auto wait = m_backoff;
+    if (m_opts.max_reconn_time > m_opts.reconn_time) {
+      auto next = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    m_backoff * m_opts.backoff_multiplier);
+      m_backoff = (next > m_opts.max_reconn_time || next < m_backoff) ? 
+                    m_opts.max_reconn_time : next;
+    }
+    if (m_opts.jitter > 0.0 && wait.count() > 0) {
+      double frac = (m_opts.jitter > 1.0 ? 1.0 : m_opts.jitter) * 
+                      std::uniform_real_distribution<double>(0.0, 1.0)(m_rand);
+      wait -= std::chrono::duration_cast<std::chrono::milliseconds>(wait * frac);
+    }
+    return wait;
+  }
+
+  void handle_connect_failure(const std::error_code& err) {
+    m_entity_common.call_error_cb(io_ptr(), err);
+    if (!is_started() || m_shutting_down ) {
+      return;
+    }
+    try {
+      m_timer.expires_after(next_reconn_time());
+    }
+    catch (const std::system_error& se) {
+      m_entity_common.call_error_cb(io_ptr(), se.code());
+      m_entity_common.stop();
+      return;
+    }
+    instrument(io_event::connect_retry);
+    record_metric(net_metric::reconnects);
+    if constexpr (is_tcp) {
+      if (m_endpoints_cache) {
+        // the endpoints may be out of date, refresh while waiting for the retry
+        m_endpoints_cache->refresh(false, m_remote_host, m_remote_port);
+      }
+    }
+    auto self = this->shared_from_this();
+    m_timer.async_wait(std::experimental::net::bind_executor(m_strand, 
+                        [this, self] (const std::error_code& err) mutable {
+        if (!err) {
+          if constexpr (is_tcp) {
+            if (m_endpoints_cache) { // never blocks, keeps the current endpoints if no entry
+              m_endpoints_cache->cached_endpoints(false, m_remote_host, m_remote_port, 
+                                                  m_endpoints);
+            }
+          }
+          start_connect();
+        }
+      } )
+    );
+  }
+
+  void notify_me(std::error_code err, io_ptr iop) {
     assert (iop == m_io_handler);
 
     iop->close();
@@ -233,8 +597,12 @@ private:
 
 };
 
+using tcp_connector = basic_stream_connector<std::experimental::net::ip::tcp>;
 using tcp_connector_ptr = std::shared_ptr<tcp_connector>;
 
+using local_stream_connector = basic_stream_connector<chops::net::local::stream_protocol>;
+using local_stream_connector_ptr = std::shared_ptr<local_stream_connector>;
+
 } // end detail namespace
 } // end net namespace
 } // end chops namespace
@@ -4,6 +4,16 @@
  *
  *  @brief Internal handler class for TCP stream input and output.
  *
+ *  The handler is a class template on the stream protocol, instantiated for TCP and for
+ *  local (Unix domain) stream sockets, so framing, output queueing and the rest of the
+ *  IO handler behavior are the same for both. Zero copy sends (@c SO_ZEROCOPY) are not
+ *  supported by local sockets, the threshold is then ignored.
+ *
+ *  With receive timestamps enabled (Linux @c SO_TIMESTAMPING), each read waits for the
+ *  socket to be readable and then receives with @c recvmsg, so the timestamps control
+ *  message (of the most recent segment in the read) is available to message handlers
+ *  taking a @c receive_timestamp.
+ *
  *  @note For internal use only.
  *
  *  @author Cliff Green
@@ -21,20 +31,61 @@
 #include <experimental/executor>
 #include <experimental/internet>
 #include <experimental/buffer>
+#include <experimental/timer>
 
 #include <memory> // std::shared_ptr, std::enable_shared_from_this
 #include <system_error>
 
-#include <cstddef> // std::size_t
+#include <cstddef> // std::size_t, std::nullptr_t
+#include <type_traits> // std::decay_t
 #include <utility> // std::forward, std::move
 #include <string>
 #include <string_view>
 #include <functional>
+#include <vector>
+#include <limits>
+#include <algorithm> // std::max
+#include <cstring> // std::memmove
+#include <cstdint> // std::uint32_t
+#include <deque>
+#include <optional>
+#include <atomic>
+#include <chrono>
+
+#if defined(__linux__) && defined(MSG_ZEROCOPY)
+#include <cerrno>
+#include <climits> // IOV_MAX
+#include <sys/socket.h> // sendmsg, recvmsg
+#include <sys/uio.h> // iovec
+#include <linux/errqueue.h> // sock_extended_err
+#endif
+
+#if defined(__linux__)
+#include <cerrno>
+#include <sys/sendfile.h>
+#include <sys/socket.h> // recvmsg
+#include <sys/uio.h> // iovec
+#else
+#include <unistd.h> // pread
+#endif
 
 #include "net_ip/detail/output_queue.hpp"
+#include "net_ip/detail/out_buffer.hpp"
 #include "net_ip/detail/io_common.hpp"
+#include "net_ip/detail/handler_memory.hpp"
+#include "net_ip/detail/delimiter_scanner.hpp"
+#include "net_ip/detail/socket_options.hpp"
+#include "net_ip/detail/timer_wheel.hpp"
 #include "net_ip/queue_stats.hpp"
+#include "net_ip/idle_timeouts.hpp"
+#include "net_ip/read_buffer_policy.hpp"
+#include "net_ip/send_priority.hpp"
+#include "net_ip/io_handler_id.hpp"
+#include "net_ip/instrumentation.hpp"
 #include "net_ip/net_ip_error.hpp"
+#include "net_ip/file_segment.hpp"
+#include "net_ip/local_protocol.hpp"
+#include "net_ip/receive_timestamp.hpp"
 #include "net_ip/basic_io_interface.hpp"
 #include "utility/shared_buffer.hpp"
 
@@ -44,19 +95,32 @@ namespace detail {
 
 std::size_t null_msg_frame (std::experimental::net::mutable_buffer) noexcept;
 
-class tcp_io : public std::enable_shared_from_this<tcp_io> {
+template <typename Protocol>
+class basic_stream_io : public std::enable_shared_from_this<basic_stream_io<Protocol> > {
 public:
-  using socket_type = std::experimental::net::ip::tcp::socket;
-  using endpoint_type = std::experimental::net::ip::tcp::endpoint;
-  using entity_notifier_cb = std::function<void (std::error_code, std::shared_ptr<tcp_io>)>;
+  using socket_type = typename Protocol::socket;
+  using endpoint_type = typename Protocol::endpoint;
+  using entity_notifier_cb = std::function<void (std::error_code, std::shared_ptr<basic_stream_io>)>;
+  using queue_event_cb = std::function<void (basic_io_interface<basic_stream_io>, std::error_code)>;
+  // the output queue holds shared buffers, memory mapped regions and file segments
+  using out_buffer_type = out_buffer;
 
 private:
   using byte_vec = chops::mutable_shared_buffer::byte_vec;
+  using strand_type = std::experimental::net::strand<typename socket_type::executor_type>;
+
+  // initial read-ahead buffer size for delimiter framing, doubled as needed for long messages
+  static constexpr std::size_t delimiter_read_size = 4096u;
+  // maximum number of buffers copied into the coalescing staging buffer for one write
+  static constexpr std::size_t cork_max_bufs = 1024u;
 
 private:
 
+  // all handlers run through the strand, so the "only called within the run thread" 
+  // logic holds even when multiple threads run the io_context
   socket_type            m_socket;
-  io_common<tcp_io>      m_io_common;
+  strand_type            m_strand;
+  io_common<basic_stream_io>      m_io_common;
   entity_notifier_cb     m_notifier_cb;
   endpoint_type          m_remote_endp;
 
@@ -65,21 +129,127 @@ private:
   // copying or moving
   byte_vec               m_byte_vec;
   std::size_t            m_read_size;
-  std::string            m_delimiter;
+  delimiter_scanner      m_delim_scanner;
+  // m_byte_vec goes back to m_base_read_size (the header, read-ahead or delimiter read
+  // size) after a message above the shrink size; m_read_buf_cap is the last capacity
+  // reported in the stats
+  read_buffer_policy     m_rb_policy;
+  std::size_t            m_base_read_size;
+  std::size_t            m_read_buf_cap;
+
+  // read-ahead processing (also used for delimiter framing), m_byte_vec holds the buffered
+  // bytes; m_ra_begin is the start of the current (partial) message, m_ra_end is the end 
+  // of the buffered bytes, m_ra_framed is the number of message bytes already passed to the
+  // message frame, and m_ra_next is the size of the next chunk for the message frame
+  std::size_t            m_ra_begin;
+  std::size_t            m_ra_end;
+  std::size_t            m_ra_framed;
+  std::size_t            m_ra_next;
+
+  // receive timestamps, reads use recvmsg when enabled; m_rx_stamp is from the read that
+  // completed the message being delivered
+  bool                   m_rx_ts;
+  receive_timestamp      m_rx_stamp;
+  // requested from any thread, applied by start_io before the first read, or within the
+  // strand if the IO is already started
+  std::atomic_bool       m_rx_ts_req;
+
+  // the following members are only used for write processing; the buffer being written
+  // (or the buffers in a gather write batch) must stay alive until the write completes
+  std::size_t                                       m_max_batch_bufs;
+  std::size_t                                       m_max_batch_bytes;
+  std::vector<out_buffer>                           m_batch_bufs;
+  std::vector<std::experimental::net::const_buffer> m_batch_seq;
+  queue_event_cb                                    m_queue_event_cb;
+  event_timer                                       m_write_timer;
+
+  // recycled operation storage, one for the read chain and one for the write chain 
+  // (each has at most one outstanding operation), so steady state reads and writes 
+  // do not allocate
+  handler_memory                                    m_read_mem;
+  handler_memory                                    m_write_mem;
+
+  // zero copy sends (Linux only), a threshold of 0 is the normal write path; the buffers
+  // of a zero copy write stay alive until the kernel reports (through the socket error 
+  // queue) that it no longer references them; each successful zero copy sendmsg call 
+  // uses the next sequence number, and a pending entry covers the sequence numbers 
+  // [m_first_seq, m_last_seq] of one write
+  std::size_t                                       m_zc_threshold;
+  // kernel TLS rejects MSG_ZEROCOPY sends, so the zero copy threshold is ignored
+  bool                                              m_ktls;
+  // assigned by a TCP acceptor before the IO state change callback
+  io_handler_id                                     m_handler_id;
+  // idle timeouts share the timer wheel of the io_context, reads and sends only touch
+  // the timers; the heartbeat is only accessed within the strand
+  idle_timer                                        m_read_idle;
+  idle_timer                                        m_write_idle;
+  std::optional<chops::const_shared_buffer>         m_heartbeat;
+
+  // send coalescing (corking), a flush size of 0 disables; after an idle period the 
+  // writer holds queued buffers until the flush size is reached or the delay expires,
+  // then copies them into the staging buffer for one write; buffers queued while a 
+  // write is in progress are written when it completes (they have already waited); the
+  // cork timer wait can be outstanding at the same time as a write, so it has its own
+  // operation storage, and a flush by size cancels it
+  std::atomic_size_t                                m_cork_bytes;
+  std::atomic_bool                                  m_corked; // set within the strand
+  std::chrono::microseconds                         m_cork_delay;
+  std::experimental::net::steady_timer              m_cork_timer;
+  bool                                              m_cork_timer_armed;
+  bool                                              m_cork_flush; // held buffers have waited
+  byte_vec                                          m_cork_buf;
+  handler_memory                                    m_cork_mem;
+  // a batch with file segments is written one run at a time, consecutive memory buffers
+  // as one gather write and each file segment by the kernel; m_seg_sent is the number of
+  // bytes of the current file segment already sent
+  std::size_t                                       m_seg_next;
+  std::size_t                                       m_seg_sent;
+  std::size_t                                       m_seg_total;
+#if defined(__linux__) && defined(MSG_ZEROCOPY)
+  struct zc_pending {
+    std::uint32_t                           m_first_seq;
+    std::uint32_t                           m_last_seq;
+    std::uint32_t                           m_num_done;
+    std::vector<out_buffer>                 m_bufs;
+  };
+
+  std::vector<::iovec>                              m_zc_iovs;
+  std::size_t                                       m_zc_iov_next; // first iovec not fully sent
+  std::size_t                                       m_zc_sent; // bytes sent in current write
+  std::uint32_t                                     m_zc_next_seq;
+  std::uint32_t                                     m_zc_write_seqs; // seqs used in current write
+  std::deque<zc_pending>                            m_zc_pending;
+  bool                                              m_zc_err_wait;
+  handler_memory                                    m_zc_mem;
+#endif
 
 public:
 
-  tcp_io(socket_type sock, entity_notifier_cb cb) noexcept : 
-    m_socket(std::move(sock)), m_io_common(), 
+  basic_stream_io(socket_type sock, entity_notifier_cb cb) noexcept : 
+    m_socket(std::move(sock)), m_strand(m_socket.get_executor()), m_io_common(), 
     m_notifier_cb(cb), m_remote_endp(),
-    m_byte_vec(), m_read_size(0), m_delimiter() { }
+    m_byte_vec(), m_read_size(0), m_delim_scanner(), m_rb_policy(), m_base_read_size(0),
+    m_read_buf_cap(0),
+    m_ra_begin(0), m_ra_end(0), m_ra_framed(0), m_ra_next(0), m_rx_ts(false), m_rx_stamp(),
+    m_rx_ts_req(false),
+    m_max_batch_bufs(1), m_max_batch_bytes(0), m_batch_bufs(), m_batch_seq(),
+    m_queue_event_cb(), m_write_timer(), m_read_mem(), m_write_mem(), m_zc_threshold(0), m_ktls(false),
+    m_handler_id(), m_read_idle(), m_write_idle(), m_heartbeat(),
+    m_cork_bytes(0), m_corked(false), m_cork_delay(0), 
+    m_cork_timer(m_socket.get_executor().context()), m_cork_timer_armed(false),
+    m_cork_flush(false), m_cork_buf(), m_cork_mem(), m_seg_next(0), m_seg_sent(0), m_seg_total(0)
+#if defined(__linux__) && defined(MSG_ZEROCOPY)
+    , m_zc_iovs(), m_zc_iov_next(0), m_zc_sent(0), m_zc_next_seq(0), m_zc_write_seqs(0),
+    m_zc_pending(), m_zc_err_wait(false), m_zc_mem()
+#endif
+    { }
 
 private:
   // no copy or assignment semantics for this class
-  tcp_io(const tcp_io&) = delete;
-  tcp_io(tcp_io&&) = delete;
-  tcp_io& operator=(const tcp_io&) = delete;
-  tcp_io& operator=(tcp_io&&) = delete;
+  basic_stream_io(const basic_stream_io&) = delete;
+  basic_stream_io(basic_stream_io&&) = delete;
+  basic_stream_io& operator=(const basic_stream_io&) = delete;
+  basic_stream_io& operator=(basic_stream_io&&) = delete;
 
 public:
   // all of the methods in this public section can be called through an basic_io_interface
@@ -89,27 +259,61 @@ public:
     return m_io_common.get_output_queue_stats();
   }
 
+  output_queue_stats get_output_queue_stats(send_priority pri) const noexcept {
+    return m_io_common.get_output_queue_stats(pri);
+  }
+
   bool is_io_started() const noexcept { return m_io_common.is_io_started(); }
 
+  io_handler_id get_handler_id() const noexcept { return m_handler_id; }
+
   template <typename MH, typename MF>
   bool start_io(std::size_t header_size, MH&& msg_handler, MF&& msg_frame) {
     if (!start_io_setup()) {
       return false;
     }
     m_read_size = header_size;
+    m_base_read_size = header_size;
     m_byte_vec.resize(m_read_size);
+    read_buffer_changed();
     start_read(std::experimental::net::mutable_buffer(m_byte_vec.data(), m_byte_vec.size()),
-               std::forward<MH>(msg_handler), std::forward<MF>(msg_frame));
+               make_read_state(std::forward<MH>(msg_handler), std::forward<MF>(msg_frame)));
+    return true;
+  }
+
+  // read-ahead variant of the message frame start_io, each read is an async_read_some of
+  // up to the read ahead size, and all complete messages in the buffered bytes are framed
+  // and delivered before the next read
+  template <typename MH, typename MF>
+  bool start_io(std::size_t header_size, std::size_t read_ahead_size, 
+                MH&& msg_handler, MF&& msg_frame) {
+    if (!start_io_setup()) {
+      return false;
+    }
+    m_read_size = header_size;
+    m_base_read_size = std::max(header_size, read_ahead_size);
+    m_byte_vec.resize(m_base_read_size);
+    read_buffer_changed();
+    m_ra_begin = 0;
+    m_ra_end = 0;
+    m_ra_framed = 0;
+    m_ra_next = header_size;
+    start_read_some(make_read_state(std::forward<MH>(msg_handler), std::forward<MF>(msg_frame)));
     return true;
   }
 
   template <typename MH>
   bool start_io(std::string_view delimiter, MH&& msg_handler) {
-    if (!start_io_setup()) {
+    if (delimiter.empty() || !start_io_setup()) {
       return false;
     }
-    m_delimiter = delimiter;
-    start_read_until(std::forward<MH>(msg_handler));
+    m_delim_scanner.reset(delimiter);
+    m_base_read_size = delimiter_read_size;
+    m_byte_vec.resize(m_base_read_size);
+    read_buffer_changed();
+    m_ra_begin = 0;
+    m_ra_end = 0;
+    start_read_until(make_read_state(std::forward<MH>(msg_handler), nullptr));
     return true;
   }
 
@@ -120,8 +324,8 @@ public:
 
   bool start_io() {
     return start_io(1, 
-                    [] (std::experimental::net::const_buffer, basic_io_interface<tcp_io>, 
-                        std::experimental::net::ip::tcp::endpoint) mutable {
+                    [] (std::experimental::net::const_buffer, basic_io_interface<basic_stream_io>, 
+                        endpoint_type) mutable {
                           return true;
                     }, 
                     null_msg_frame
@@ -133,26 +337,152 @@ public:
     if (is_io_started()) {
       // causes net entity to eventually call close
       m_notifier_cb(std::make_error_code(net_ip_errc::tcp_io_handler_stopped), 
-                    shared_from_this());
+                    this->shared_from_this());
       return true;
     }
     return false;
   }
 
-  // use post for thread safety, multiple threads can call this method
-  void send(chops::const_shared_buffer buf) {
-    auto self { shared_from_this() };
-    post(m_socket.get_executor(), [this, self, buf] {
-        if (!m_io_common.start_write_setup(buf)) {
-          return; // buf queued or shutdown happening
+  // multiple threads can call this method; the buf is queued directly (lock-free) and a 
+  // handler is posted only when the writer is idle; a mapped region or file segment is
+  // queued in order with the other buffers, without copying its contents
+  void send(out_buffer buf, send_priority pri = send_priority::normal) {
+    m_write_idle.touch();
+    if (!m_io_common.enqueue_element(std::move(buf), pri)) {
+      // the writer may be holding buffers for coalescing, flush when the size is reached
+      std::size_t cb = m_cork_bytes.load(std::memory_order_relaxed);
+      if (cb != 0 && m_corked && m_io_common.num_queued_bytes() >= cb && 
+          m_corked.exchange(false)) {
+        auto self { this->shared_from_this() };
+        post(m_strand, [this, self] () mutable { start_write_from_queue(std::move(self)); } );
+        return;
+      }
+      // write in progress will pick up the buf, or shutdown happening, or the buf was
+      // dropped; overflow or watermark processing may still be needed
+      if (m_io_common.claim_queue_events()) {
+        auto self { this->shared_from_this() };
+        post(m_strand, [this, self] { handle_queue_events(); } );
+      }
+      return;
+    }
+    // the writer was idle and is now claimed, so no write chain operation is outstanding;
+    // the shared_ptr is moved through the write chain until the queue is empty
+    post(m_strand, make_alloc_handler(m_write_mem, 
+                     [this, self = this->shared_from_this()] () mutable {
+        start_write_from_queue(std::move(self));
+      }
+    ));
+  }
+
+  void send(out_buffer buf, const endpoint_type&,
+            send_priority pri = send_priority::normal) {
+    send(std::move(buf), pri);
+  }
+
+  // used for the next buffer taken from the output queue
+  void set_send_lane_policy(const send_lane_policy& pol) noexcept {
+    m_io_common.set_send_lane_policy(pol);
+  }
+
+  // limits are used for the next send, the queue event function object is set within
+  // the strand
+  template <typename F>
+  void set_output_queue_limits(const output_queue_limits& lim, F&& func) {
+    m_io_common.set_output_queue_limits(lim);
+    auto self { this->shared_from_this() };
+    post(m_strand, [this, self, f = queue_event_cb(std::forward<F>(func))] () mutable {
+        m_queue_event_cb = std::move(f);
+      }
+    );
+  }
+
+  bool is_output_congested() const noexcept { return m_io_common.is_output_congested(); }
+
+  // a flush_bytes value of 0 disables coalescing, which is the default; buffers held by
+  // the writer are flushed when coalescing is disabled
+  void set_send_coalescing(std::size_t flush_bytes, std::chrono::microseconds max_delay) {
+    auto self { this->shared_from_this() };
+    post(m_strand, [this, self, flush_bytes, max_delay] () mutable {
+        m_cork_delay = max_delay;
+        m_cork_bytes = flush_bytes;
+        if (flush_bytes == 0 && m_corked.exchange(false)) {
+          start_write_from_queue(std::move(self));
         }
-        start_write(buf);
       }
     );
   }
 
-  void send(const chops::const_shared_buffer& buf, const endpoint_type&) {
-    send(buf);
+  // the timers are (re)started within the strand, a timeout of 0 stops a timer
+  void set_idle_timeouts(const idle_timeouts& to) {
+    auto self { this->shared_from_this() };
+    post(m_strand, [this, self, to] {
+        m_heartbeat = to.heartbeat;
+        std::weak_ptr<basic_stream_io> wp = self;
+        auto& ioc = m_socket.get_executor().context();
+        m_read_idle.start(ioc, to.read_timeout, [wp] {
+            if (auto p = wp.lock()) {
+              p->post_idle_expired(true);
+            }
+          }
+        );
+        m_write_idle.start(ioc, to.write_timeout, [wp] {
+            if (auto p = wp.lock()) {
+              p->post_idle_expired(false);
+            }
+          }
+        );
+      }
+    );
+  }
+
+  // a max_bufs value of 0 or 1 disables batching, which is the default; a max_bytes 
+  // value of 0 means no byte limit
+  void set_write_batch_limits(std::size_t max_bufs, std::size_t max_bytes) {
+    auto self { this->shared_from_this() };
+    post(m_strand, [this, self, max_bufs, max_bytes] {
+        m_max_batch_bufs = (max_bufs == 0) ? 1 : max_bufs;
+        m_max_batch_bytes = (max_bytes == 0) ? std::numeric_limits<std::size_t>::max() : max_bytes;
+      }
+    );
+  }
+
+  // applied within the strand, from the next message on
+  void set_read_buffer_policy(const read_buffer_policy& pol) {
+    auto self { this->shared_from_this() };
+    post(m_strand, [this, self, pol] { m_rb_policy = pol; } );
+  }
+
+  // writes of at least min_bytes (the total of a gather write batch) are sent with 
+  // MSG_ZEROCOPY, 0 disables; only implemented on Linux, and if the SO_ZEROCOPY socket 
+  // option cannot be set (or the connection is kernel TLS) the threshold is ignored
+  void set_zero_copy_threshold(std::size_t min_bytes) {
+    auto self { this->shared_from_this() };
+    post(m_strand, [this, self, min_bytes] {
+#if defined(__linux__) && defined(MSG_ZEROCOPY)
+        if (m_ktls) {
+          return;
+        }
+        if (min_bytes != 0) {
+          std::error_code ec;
+          m_socket.set_option(zero_copy(true), ec);
+          if (ec) {
+            return;
+          }
+        }
+        m_zc_threshold = min_bytes;
+#endif
+      }
+    );
+  }
+
+  // Linux only, ignored otherwise; a read already started uses the previous setting
+  void set_receive_timestamps(bool on) {
+    m_rx_ts_req = on;
+    if (!is_io_started()) {
+      return; // applied by start_io
+    }
+    auto self { this->shared_from_this() };
+    post(m_strand, [this, self] { apply_receive_timestamps(); } );
   }
 
 public:
@@ -162,19 +492,46 @@ public:
     if (!m_io_common.stop()) {
       return; // already stopped
     }
-//    auto self { shared_from_this() };
+    m_read_idle.stop();
+    m_write_idle.stop();
+//    auto self { this->shared_from_this() };
 //    post(m_socket.get_executor(), [this, self] {
     // attempt graceful shutdown
     std::error_code ec;
-    m_socket.shutdown(std::experimental::net::ip::tcp::socket::shutdown_both, ec);
-//    auto self { shared_from_this() };
+    m_socket.shutdown(socket_type::shutdown_both, ec);
+//    auto self { this->shared_from_this() };
 //  post(m_socket.get_executor(), [this, self, ec] () mutable { 
     m_socket.close(ec); 
 //    } );
   }
 
+  // this method can only be called through a net entity, before the IO state change 
+  // callback
+  void set_handler_id(const io_handler_id& id) noexcept { m_handler_id = id; }
+
+  // as with set_handler_id, for a connection whose record layer is kernel TLS
+  void set_kernel_tls() noexcept { m_ktls = true; }
+
 private:
 
+  // called from the timer wheel, the expiration is handled within the strand; a read 
+  // timeout or a write timeout without a heartbeat shuts down the IO handler
+  void post_idle_expired(bool read) {
+    auto self { this->shared_from_this() };
+    post(m_strand, [this, self, read] {
+        if (!is_io_started()) {
+          return;
+        }
+        if (!read && m_heartbeat) {
+          send(*m_heartbeat);
+          return;
+        }
+        m_notifier_cb(std::make_error_code(read ? net_ip_errc::read_idle_timeout :
+                                                  net_ip_errc::write_idle_timeout), self);
+      }
+    );
+  }
+
   bool start_io_setup() {
     if (!m_io_common.set_io_started()) { // concurrency protected
       return false;
@@ -182,126 +539,954 @@ private:
     std::error_code ec;
     m_remote_endp = m_socket.remote_endpoint(ec);
     if (ec) {
-      m_notifier_cb(ec, shared_from_this());
+      m_notifier_cb(ec, this->shared_from_this());
       return false;
     }
+    apply_receive_timestamps();
     return true;
   }
 
+  // called by start_io before the first read, or within the strand
+  void apply_receive_timestamps() {
+#if defined(__linux__) && defined(SO_TIMESTAMPING)
+    bool on = m_rx_ts_req;
+    if (!on && !m_rx_ts) {
+      return;
+    }
+    std::error_code ec;
+    m_socket.set_option(timestamping(on ? receive_timestamping_flags : 0), ec);
+    m_rx_ts = on && !ec;
+    m_rx_stamp = receive_timestamp { };
+#endif
+  }
+
+  // read loop state, created once in start_io and owned by the outstanding read 
+  // completion handler; each read moves one pointer instead of moving the message 
+  // handler and message frame function objects and copying the shared_ptr to this 
+  // object, and the handler and frame calls are resolved at compile time
+  template <typename MH, typename MF>
+  struct read_state {
+    std::shared_ptr<basic_stream_io> m_self;
+    MH                      m_msg_hdlr;
+    MF                      m_msg_frame;
+  };
+
+  template <typename MH, typename MF>
+  using read_state_ptr = std::unique_ptr<read_state<MH, MF> >;
+
+  template <typename MH, typename MF>
+  auto make_read_state(MH&& msg_hdlr, MF&& msg_frame) {
+    using rs_type = read_state<std::decay_t<MH>, std::decay_t<MF> >;
+    return read_state_ptr<std::decay_t<MH>, std::decay_t<MF> >(new rs_type { this->shared_from_this(), 
+                          std::forward<MH>(msg_hdlr), std::forward<MF>(msg_frame) });
+  }
+
   template <typename MH, typename MF>
-  void start_read(std::experimental::net::mutable_buffer mbuf, MH&& msg_hdlr, MF&& msg_frame) {
-    // std::move in lambda instead of std::forward since an explicit copy or move of the function
-    // object is desired so there are no dangling references
-    auto self { shared_from_this() };
+  void start_read(std::experimental::net::mutable_buffer mbuf, read_state_ptr<MH, MF> rs) {
+#if defined(__linux__) && defined(SO_TIMESTAMPING)
+    if (m_rx_ts) {
+      start_read_stamped(mbuf, 0u, std::move(rs));
+      return;
+    }
+#endif
     std::experimental::net::async_read(m_socket, mbuf,
-      [this, self, mbuf, mh = std::move(msg_hdlr), mf = std::move(msg_frame)]
-            (const std::error_code& err, std::size_t nb) mutable {
-        handle_read(mbuf, err, nb, std::move(mh), std::move(mf));
-      }
+      std::experimental::net::bind_executor(m_strand, make_alloc_handler(m_read_mem,
+        [this, mbuf, rs = std::move(rs)] (const std::error_code& err, std::size_t nb) mutable {
+          handle_read(mbuf, err, nb, std::move(rs));
+        }
+      ))
     );
   }
 
   template <typename MH, typename MF>
   void handle_read(std::experimental::net::mutable_buffer, 
-                   const std::error_code&, std::size_t, MH&&, MF&&);
+                   const std::error_code&, std::size_t, read_state_ptr<MH, MF>);
+
+  template <typename MH, typename MF>
+  void start_read_some(read_state_ptr<MH, MF> rs) {
+#if defined(__linux__) && defined(SO_TIMESTAMPING)
+    if (m_rx_ts) {
+      read_some_stamped(std::experimental::net::mutable_buffer(m_byte_vec.data() + m_ra_end, 
+                                                               m_byte_vec.size() - m_ra_end),
+        [this, rs = std::move(rs)] (const std::error_code& err, std::size_t nb) mutable {
+          handle_read_some(err, nb, std::move(rs));
+        }
+      );
+      return;
+    }
+#endif
+    m_socket.async_read_some(
+      std::experimental::net::mutable_buffer(m_byte_vec.data() + m_ra_end, 
+                                             m_byte_vec.size() - m_ra_end),
+      std::experimental::net::bind_executor(m_strand, make_alloc_handler(m_read_mem,
+        [this, rs = std::move(rs)] (const std::error_code& err, std::size_t nb) mutable {
+          handle_read_some(err, nb, std::move(rs));
+        }
+      ))
+    );
+  }
+
+  template <typename MH, typename MF>
+  void handle_read_some(const std::error_code&, std::size_t, read_state_ptr<MH, MF>);
 
+  // delimiter framing reads into the read-ahead buffer, the delimiter scanner remembers
+  // how far the current message has been searched
   template <typename MH>
-  void start_read_until(MH&& msg_hdlr) {
-    auto self { shared_from_this() };
-    std::experimental::net::async_read_until(m_socket, 
-                                             std::experimental::net::dynamic_buffer(m_byte_vec), 
-                                             m_delimiter,
-      [this, self, mh = std::move(msg_hdlr)] (const std::error_code& err, std::size_t nb) mutable {
-        handle_read_until(err, nb, std::move(mh));
+  void start_read_until(read_state_ptr<MH, std::nullptr_t> rs) {
+#if defined(__linux__) && defined(SO_TIMESTAMPING)
+    if (m_rx_ts) {
+      read_some_stamped(std::experimental::net::mutable_buffer(m_byte_vec.data() + m_ra_end, 
+                                                               m_byte_vec.size() - m_ra_end),
+        [this, rs = std::move(rs)] (const std::error_code& err, std::size_t nb) mutable {
+          handle_read_until(err, nb, std::move(rs));
+        }
+      );
+      return;
+    }
+#endif
+    m_socket.async_read_some(
+      std::experimental::net::mutable_buffer(m_byte_vec.data() + m_ra_end, 
+                                             m_byte_vec.size() - m_ra_end),
+      std::experimental::net::bind_executor(m_strand, make_alloc_handler(m_read_mem,
+        [this, rs = std::move(rs)] (const std::error_code& err, std::size_t nb) mutable {
+          handle_read_until(err, nb, std::move(rs));
+        }
+      ))
+    );
+  }
+
+  template <typename MH>
+  void handle_read_until(const std::error_code&, std::size_t, read_state_ptr<MH, std::nullptr_t>);
+
+#if defined(__linux__) && defined(SO_TIMESTAMPING)
+  // wait for the socket to be readable, then receive what is available with the 
+  // timestamps control message; the completion is called as for async_read_some
+  template <typename F>
+  void read_some_stamped(std::experimental::net::mutable_buffer mbuf, F&& func) {
+    m_socket.async_wait(socket_type::wait_read,
+      std::experimental::net::bind_executor(m_strand, make_alloc_handler(m_read_mem,
+        [this, mbuf, f = std::forward<F>(func)] (const std::error_code& err) mutable {
+          if (err) {
+            f(err, 0u);
+            return;
+          }
+          std::error_code ec;
+          std::size_t nb = receive_stamped(mbuf, ec);
+          if (ec == std::errc::operation_would_block || 
+              ec == std::errc::resource_unavailable_try_again) {
+            read_some_stamped(mbuf, std::move(f)); // spurious wakeup
+            return;
+          }
+          f(ec, nb);
+        }
+      ))
+    );
+  }
+
+  // the exact size read of the message frame path, as with async_read
+  template <typename MH, typename MF>
+  void start_read_stamped(std::experimental::net::mutable_buffer mbuf, std::size_t done,
+                          read_state_ptr<MH, MF> rs) {
+    read_some_stamped(mbuf + done,
+      [this, mbuf, done, rs = std::move(rs)] (const std::error_code& err, std::size_t nb) mutable {
+        if (!err && done + nb < mbuf.size()) {
+          start_read_stamped(mbuf, done + nb, std::move(rs));
+          return;
+        }
+        handle_read(mbuf, err, done + nb, std::move(rs));
       }
     );
   }
 
+  std::size_t receive_stamped(std::experimental::net::mutable_buffer, std::error_code&);
+#endif
+
+  // the first num_bytes of m_byte_vec is a complete message
   template <typename MH>
-  void handle_read_until(const std::error_code&, std::size_t, MH&&);
+  bool invoke_msg_hdlr(MH& msg_hdlr, std::size_t num_bytes) {
+    m_io_common.msg_received(num_bytes);
+    event_timer timer;
+    timer.start();
+    bool ret = false;
+    if constexpr (msg_hdlr_takes_shared_buffer<MH, basic_stream_io>) {
+      ret = call_msg_hdlr(msg_hdlr, move_to_shared_buffer(m_byte_vec, num_bytes),
+                          *this, m_remote_endp, m_rx_stamp);
+    }
+    else {
+      ret = call_msg_hdlr(msg_hdlr, std::experimental::net::const_buffer(m_byte_vec.data(), num_bytes), 
+                          *this, m_remote_endp, m_rx_stamp);
+    }
+    instrument(io_event::handler_invoked, num_bytes, timer);
+    return ret;
+  }
+
+  // the message is a view into the read-ahead buffer, a shared buffer message handler 
+  // is given a copy since the buffer is reused
+  template <typename MH>
+  bool invoke_msg_hdlr(MH& msg_hdlr, const std::byte* msg, std::size_t num_bytes) {
+    m_io_common.msg_received(num_bytes);
+    event_timer timer;
+    timer.start();
+    bool ret = false;
+    if constexpr (msg_hdlr_takes_shared_buffer<MH, basic_stream_io>) {
+      ret = call_msg_hdlr(msg_hdlr, chops::const_shared_buffer(msg, num_bytes),
+                          *this, m_remote_endp, m_rx_stamp);
+    }
+    else {
+      ret = call_msg_hdlr(msg_hdlr, std::experimental::net::const_buffer(msg, num_bytes), 
+                          *this, m_remote_endp, m_rx_stamp);
+    }
+    instrument(io_event::handler_invoked, num_bytes, timer);
+    return ret;
+  }
+
+  // move the partial message at the end of the read-ahead buffer to the front, once per
+  // read rather than once per message
+  void shift_partial_msg() {
+    std::size_t partial = m_ra_end - m_ra_begin;
+    if (m_ra_begin != 0 && partial != 0) {
+      std::memmove(m_byte_vec.data(), m_byte_vec.data() + m_ra_begin, partial);
+    }
+    m_ra_begin = 0;
+    m_ra_end = partial;
+  }
+
+  void read_buffer_changed() noexcept {
+    if (m_byte_vec.capacity() != m_read_buf_cap) {
+      m_read_buf_cap = m_byte_vec.capacity();
+      m_io_common.read_buffer_changed(m_read_buf_cap);
+    }
+  }
 
-  void start_write(chops::const_shared_buffer);
+  void release_read_buf(byte_vec&& bv) {
+    if (m_rb_policy.release) {
+      m_rb_policy.release(std::move(bv));
+    }
+  }
 
-  void handle_write(const std::error_code&, std::size_t);
+  // resize the read buffer to sz bytes, keeping the first keep bytes; growing above the
+  // shrink size uses a buffer from the policy acquire function object, if any
+  void grow_read_buf(std::size_t sz, std::size_t keep) {
+    if (sz > m_byte_vec.capacity() && m_rb_policy.shrink_size != 0 && 
+        sz > m_rb_policy.shrink_size && m_rb_policy.acquire) {
+      byte_vec bv = m_rb_policy.acquire(sz);
+      bv.assign(m_byte_vec.begin(), m_byte_vec.begin() + keep);
+      bv.resize(sz);
+      bv.swap(m_byte_vec);
+      release_read_buf(std::move(bv));
+    }
+    else {
+      m_byte_vec.resize(sz);
+    }
+    read_buffer_changed();
+  }
+
+  // a read buffer above the shrink size is replaced by one of sz bytes (keeping the 
+  // first keep bytes) once the large message has been delivered
+  void trim_read_buf(std::size_t sz, std::size_t keep) {
+    if (m_rb_policy.shrink_size == 0 || m_byte_vec.capacity() <= m_rb_policy.shrink_size ||
+        sz > m_rb_policy.shrink_size || keep > sz) {
+      return;
+    }
+    byte_vec bv { };
+    bv.reserve(sz);
+    bv.assign(m_byte_vec.begin(), m_byte_vec.begin() + keep);
+    bv.resize(sz);
+    bv.swap(m_byte_vec);
+    release_read_buf(std::move(bv));
+    read_buffer_changed();
+  }
+
+  bool handle_queue_events();
+
+  // the write chain methods pass along the shared_ptr to this object, so there are no
+  // reference count operations per write
+  void start_write(const out_buffer&, std::shared_ptr<basic_stream_io>);
+
+  void start_write_batch(std::shared_ptr<basic_stream_io>);
+
+  void start_write_from_queue(std::shared_ptr<basic_stream_io>);
+
+  void handle_write(const std::error_code&, std::size_t, std::shared_ptr<basic_stream_io>);
+
+  void start_write_corked(std::shared_ptr<basic_stream_io>);
+  void start_cork_timer(std::shared_ptr<basic_stream_io>);
+  void flush_corked(std::shared_ptr<basic_stream_io>);
+
+  bool batch_has_file() const noexcept;
+  void start_write_segments(std::shared_ptr<basic_stream_io>);
+  void write_next_segment(std::shared_ptr<basic_stream_io>);
+  void send_file_segment(std::shared_ptr<basic_stream_io>);
+
+#if defined(__linux__) && defined(MSG_ZEROCOPY)
+  void start_write_zero_copy(std::shared_ptr<basic_stream_io>);
+
+  void send_zero_copy(std::shared_ptr<basic_stream_io>);
+
+  void start_zero_copy_wait();
+
+  void handle_zero_copy_completions();
+#endif
 
 };
 
 // method implementations, just to make the class declaration a little more readable
 
+template <typename Protocol>
 template <typename MH, typename MF>
-void tcp_io::handle_read(std::experimental::net::mutable_buffer mbuf, 
+void basic_stream_io<Protocol>::handle_read(std::experimental::net::mutable_buffer mbuf, 
                          const std::error_code& err, std::size_t /* num_bytes */,
-                         MH&& msg_hdlr, MF&& msg_frame) {
+                         read_state_ptr<MH, MF> rs) {
 
   if (err) {
-    m_notifier_cb(err, shared_from_this());
+    m_notifier_cb(err, this->shared_from_this());
     return;
   }
   // assert num_bytes == mbuf.size()
-  std::size_t next_read_size = msg_frame(mbuf);
+  m_read_idle.touch();
+  instrument(io_event::read_completed, mbuf.size());
+  std::size_t next_read_size = rs->m_msg_frame(mbuf);
+  instrument(io_event::frame_decoded, mbuf.size());
   if (next_read_size == 0) { // msg fully received, now invoke message handler
-    if (!msg_hdlr(std::experimental::net::const_buffer(m_byte_vec.data(), m_byte_vec.size()), 
-                  basic_io_interface<tcp_io>(weak_from_this()), m_remote_endp)) {
+    if (!invoke_msg_hdlr(rs->m_msg_hdlr, m_byte_vec.size())) {
       // message handler not happy, tear everything down
       m_notifier_cb(std::make_error_code(net_ip_errc::message_handler_terminated), 
-                    shared_from_this());
+                    this->shared_from_this());
       return;
     }
     m_byte_vec.resize(m_read_size);
+    trim_read_buf(m_read_size, 0);
+    read_buffer_changed(); // a shared buffer message handler may have taken the buffer
     mbuf = std::experimental::net::mutable_buffer(m_byte_vec.data(), m_byte_vec.size());
   }
   else {
     std::size_t old_size = m_byte_vec.size();
-    m_byte_vec.resize(old_size + next_read_size);
+    grow_read_buf(old_size + next_read_size, old_size);
     mbuf = std::experimental::net::mutable_buffer(m_byte_vec.data() + old_size, next_read_size);
   }
-  start_read(mbuf, std::forward<MH>(msg_hdlr), std::forward<MF>(msg_frame));
+  start_read(mbuf, std::move(rs));
 }
 
-template <typename MH>
-void tcp_io::handle_read_until(const std::error_code& err, std::size_t num_bytes, MH&& msg_hdlr) {
+template <typename Protocol>
+template <typename MH, typename MF>
+void basic_stream_io<Protocol>::handle_read_some(const std::error_code& err, std::size_t num_bytes,
+                              read_state_ptr<MH, MF> rs) {
 
   if (err) {
-    m_notifier_cb(err, shared_from_this());
+    m_notifier_cb(err, this->shared_from_this());
     return;
   }
-  // beginning of m_byte_vec to num_bytes is buf, includes delimiter bytes
-  if (!msg_hdlr(std::experimental::net::const_buffer(m_byte_vec.data(), num_bytes),
-                basic_io_interface<tcp_io>(weak_from_this()), m_remote_endp)) {
+  m_ra_end += num_bytes;
+  m_read_idle.touch();
+  instrument(io_event::read_completed, num_bytes);
+  // frame and deliver every complete message in the buffered bytes
+  while ((m_ra_end - m_ra_begin - m_ra_framed) >= m_ra_next) {
+    std::size_t next_read_size = rs->m_msg_frame(std::experimental::net::mutable_buffer(
+                    m_byte_vec.data() + m_ra_begin + m_ra_framed, m_ra_next));
+    instrument(io_event::frame_decoded, m_ra_next);
+    m_ra_framed += m_ra_next;
+    if (next_read_size != 0) {
+      m_ra_next = next_read_size;
+      continue;
+    }
+    if (!invoke_msg_hdlr(rs->m_msg_hdlr, m_byte_vec.data() + m_ra_begin, m_ra_framed)) {
       m_notifier_cb(std::make_error_code(net_ip_errc::message_handler_terminated), 
-                    shared_from_this());
+                    this->shared_from_this());
+      return;
+    }
+    m_ra_begin += m_ra_framed;
+    m_ra_framed = 0;
+    m_ra_next = m_read_size;
+  }
+  // grow the buffer if the rest of the partial message will not fit, or shrink it after
+  // a large message
+  shift_partial_msg();
+  std::size_t needed = m_ra_framed + m_ra_next;
+  trim_read_buf(std::max(m_base_read_size, needed), m_ra_end);
+  if (needed > m_byte_vec.size()) {
+    grow_read_buf(needed, m_ra_end);
+  }
+  start_read_some(std::move(rs));
+}
+
+template <typename Protocol>
+template <typename MH>
+void basic_stream_io<Protocol>::handle_read_until(const std::error_code& err, std::size_t num_bytes, 
+                               read_state_ptr<MH, std::nullptr_t> rs) {
+
+  if (err) {
+    m_notifier_cb(err, this->shared_from_this());
     return;
   }
-  m_byte_vec.erase(m_byte_vec.begin(), m_byte_vec.begin() + num_bytes);
-  start_read_until(std::forward<MH>(msg_hdlr));
+  m_ra_end += num_bytes;
+  m_read_idle.touch();
+  instrument(io_event::read_completed, num_bytes);
+  // deliver every complete message in the buffered bytes, each includes the delimiter bytes
+  std::size_t msg_size = 0;
+  while ((msg_size = m_delim_scanner.scan(m_byte_vec.data() + m_ra_begin, 
+                                          m_ra_end - m_ra_begin)) != 0) {
+    instrument(io_event::frame_decoded, msg_size);
+    if (!invoke_msg_hdlr(rs->m_msg_hdlr, m_byte_vec.data() + m_ra_begin, msg_size)) {
+      m_notifier_cb(std::make_error_code(net_ip_errc::message_handler_terminated), 
+                    this->shared_from_this());
+      return;
+    }
+    m_ra_begin += msg_size;
+  }
+  // double the buffer if the partial message fills it, or shrink it after a large message
+  shift_partial_msg();
+  if (m_ra_end < m_base_read_size) {
+    trim_read_buf(m_base_read_size, m_ra_end);
+  }
+  if (m_ra_end == m_byte_vec.size()) {
+    grow_read_buf(2 * m_byte_vec.size(), m_ra_end);
+  }
+  start_read_until(std::move(rs));
+}
+
+#if defined(__linux__) && defined(SO_TIMESTAMPING)
+
+// a non-blocking recvmsg, the timestamps are kept from the previous read if the kernel 
+// did not deliver a control message; a closed connection is reported as end of file, 
+// as with async_read_some
+template <typename Protocol>
+std::size_t basic_stream_io<Protocol>::receive_stamped(std::experimental::net::mutable_buffer mbuf,
+                                                       std::error_code& ec) {
+  ec.clear();
+  ::iovec iov { mbuf.data(), mbuf.size() };
+  alignas(::cmsghdr) unsigned char ctrl[CMSG_SPACE(sizeof(scm_timestamps))];
+  ::msghdr msg { };
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = ctrl;
+  msg.msg_controllen = sizeof(ctrl);
+  ::ssize_t nb = 0;
+  while ((nb = ::recvmsg(m_socket.native_handle(), &msg, MSG_DONTWAIT)) < 0) {
+    if (errno != EINTR) {
+      ec = std::error_code(errno, std::system_category());
+      return 0u;
+    }
+  }
+  if (nb == 0 && mbuf.size() != 0) {
+    ec = std::experimental::net::make_error_code(std::experimental::net::stream_errc::eof);
+    return 0u;
+  }
+  read_receive_timestamp(msg, m_rx_stamp);
+  return static_cast<std::size_t>(nb);
 }
 
+#endif
+
 
-inline void tcp_io::start_write(chops::const_shared_buffer buf) {
-  auto self { shared_from_this() };
+template <typename Protocol>
+void basic_stream_io<Protocol>::start_write(const out_buffer& buf, 
+                                std::shared_ptr<basic_stream_io> self) {
+  m_write_timer.start();
   std::experimental::net::async_write(m_socket, 
           std::experimental::net::const_buffer(buf.data(), buf.size()),
-            [this, self] (const std::error_code& err, std::size_t nb) {
-      handle_write(err, nb);
-    }
+    std::experimental::net::bind_executor(m_strand, make_alloc_handler(m_write_mem,
+            [this, self = std::move(self)] (const std::error_code& err, std::size_t nb) mutable {
+        handle_write(err, nb, std::move(self));
+      }
+    ))
+  );
+}
+
+template <typename Protocol>
+void basic_stream_io<Protocol>::start_write_batch(std::shared_ptr<basic_stream_io> self) {
+  m_write_timer.start();
+  m_batch_seq.clear();
+  for (const auto& buf : m_batch_bufs) {
+    m_batch_seq.push_back(std::experimental::net::const_buffer(buf.data(), buf.size()));
+  }
+  std::experimental::net::async_write(m_socket, m_batch_seq,
+    std::experimental::net::bind_executor(m_strand, make_alloc_handler(m_write_mem,
+            [this, self = std::move(self)] (const std::error_code& err, std::size_t nb) mutable {
+        handle_write(err, nb, std::move(self));
+      }
+    ))
   );
 }
 
-inline void tcp_io::handle_write(const std::error_code& err, std::size_t /* num_bytes */) {
+template <typename Protocol>
+void basic_stream_io<Protocol>::handle_write(const std::error_code& err, std::size_t num_bytes,
+                                 std::shared_ptr<basic_stream_io> self) {
+  m_batch_bufs.clear(); // release previous write, if any
   if (err) {
     // read pops first, so usually no error is needed in write handlers
-    // m_notifier_cb(err, shared_from_this());
+    // m_notifier_cb(err, this->shared_from_this());
+    return;
+  }
+  instrument(io_event::write_completed, num_bytes, m_write_timer);
+  m_io_common.write_complete();
+  m_cork_flush = true;
+  start_write_from_queue(std::move(self));
+}
+
+// the writer is claimed; after an idle period the queued buffers are held until the
+// flush size is reached or the delay expires
+template <typename Protocol>
+void basic_stream_io<Protocol>::start_write_corked(std::shared_ptr<basic_stream_io> self) {
+  bool flush = m_cork_flush;
+  m_cork_flush = false;
+  std::size_t cb = m_cork_bytes.load(std::memory_order_relaxed);
+  std::size_t queued = m_io_common.num_queued_bytes();
+  if (queued == 0 || flush || queued >= cb) {
+    if (m_cork_timer_armed) {
+      m_cork_timer.cancel();
+    }
+    flush_corked(std::move(self));
+    return;
+  }
+  m_corked = true;
+  if (!m_cork_timer_armed) {
+    start_cork_timer(self);
+  }
+  // a producer may have queued after the size check but before the flag was set
+  if (m_io_common.num_queued_bytes() >= cb && m_corked.exchange(false)) {
+    m_cork_timer.cancel();
+    flush_corked(std::move(self));
+  }
+}
+
+// a cancelled wait belongs to buffers that were already flushed by size; if a newer
+// batch is being held by then, it gets a full delay of its own
+template <typename Protocol>
+void basic_stream_io<Protocol>::start_cork_timer(std::shared_ptr<basic_stream_io> self) {
+  m_cork_timer_armed = true;
+  m_cork_timer.expires_after(m_cork_delay);
+  m_cork_timer.async_wait(std::experimental::net::bind_executor(m_strand, 
+    make_alloc_handler(m_cork_mem, [this, self] (const std::error_code& err) mutable {
+        m_cork_timer_armed = false;
+        if (err == std::errc::operation_canceled) {
+          if (m_corked) {
+            start_cork_timer(std::move(self));
+          }
+          return;
+        }
+        if (m_corked.exchange(false)) {
+          m_cork_flush = true;
+          start_write_from_queue(std::move(self));
+        }
+      }
+    )
+  ));
+}
+
+// a single buffer is written directly, otherwise the buffers are copied into the 
+// staging buffer so small buffers become one contiguous write
+template <typename Protocol>
+void basic_stream_io<Protocol>::flush_corked(std::shared_ptr<basic_stream_io> self) {
+  if (m_io_common.get_next_elements(m_batch_bufs, cork_max_bufs,
+                                    std::numeric_limits<std::size_t>::max()) == 0) {
+    return;
+  }
+  if (batch_has_file()) {
+    start_write_segments(std::move(self));
+    return;
+  }
+  if (m_batch_bufs.size() == 1u) {
+    start_write(m_batch_bufs.back(), std::move(self));
+    return;
+  }
+  m_cork_buf.clear();
+  for (const auto& buf : m_batch_bufs) {
+    m_cork_buf.insert(m_cork_buf.end(), buf.data(), buf.data() + buf.size());
+  }
+  m_batch_bufs.clear();
+  m_write_timer.start();
+  std::experimental::net::async_write(m_socket, 
+          std::experimental::net::const_buffer(m_cork_buf.data(), m_cork_buf.size()),
+    std::experimental::net::bind_executor(m_strand, make_alloc_handler(m_write_mem,
+            [this, self = std::move(self)] (const std::error_code& err, std::size_t nb) mutable {
+        handle_write(err, nb, std::move(self));
+      }
+    ))
+  );
+}
+
+// false if the io handler is shut down by the disconnect overflow policy
+template <typename Protocol>
+bool basic_stream_io<Protocol>::handle_queue_events() {
+  if (m_io_common.process_queue_events([this] (std::error_code e) {
+        if (m_queue_event_cb) {
+          m_queue_event_cb(basic_io_interface<basic_stream_io>(this->weak_from_this()), e);
+        }
+      } )) {
+    return true;
+  }
+  m_notifier_cb(std::make_error_code(net_ip_errc::output_queue_overflow), this->shared_from_this());
+  return false;
+}
+
+template <typename Protocol>
+void basic_stream_io<Protocol>::start_write_from_queue(std::shared_ptr<basic_stream_io> self) {
+  if (!handle_queue_events()) {
+    return;
+  }
+  if (m_cork_bytes.load(std::memory_order_relaxed) != 0) {
+    start_write_corked(std::move(self));
+    return;
+  }
+  m_cork_flush = false;
+  if (m_max_batch_bufs > 1) {
+    if (m_io_common.get_next_elements(m_batch_bufs, m_max_batch_bufs, m_max_batch_bytes) == 0) {
+      return;
+    }
+    if (batch_has_file()) {
+      start_write_segments(std::move(self));
+      return;
+    }
+#if defined(__linux__) && defined(MSG_ZEROCOPY)
+    if (m_zc_threshold != 0) {
+      std::size_t total = 0;
+      for (const auto& buf : m_batch_bufs) {
+        total += buf.size();
+      }
+      if (total >= m_zc_threshold) {
+        start_write_zero_copy(std::move(self));
+        return;
+      }
+    }
+#endif
+    start_write_batch(std::move(self));
     return;
   }
   auto elem = m_io_common.get_next_element();
   if (!elem) {
     return;
   }
-  start_write(elem->first);
+  // the buffer must stay alive until the write completes
+  m_batch_bufs.push_back(std::move(elem->first));
+  if (m_batch_bufs.back().is_file()) {
+    start_write_segments(std::move(self));
+    return;
+  }
+#if defined(__linux__) && defined(MSG_ZEROCOPY)
+  if (m_zc_threshold != 0 && m_batch_bufs.back().size() >= m_zc_threshold) {
+    start_write_zero_copy(std::move(self));
+    return;
+  }
+#endif
+  start_write(m_batch_bufs.back(), std::move(self));
 }
 
+template <typename Protocol>
+bool basic_stream_io<Protocol>::batch_has_file() const noexcept {
+  for (const auto& buf : m_batch_bufs) {
+    if (buf.is_file()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename Protocol>
+void basic_stream_io<Protocol>::start_write_segments(std::shared_ptr<basic_stream_io> self) {
+  m_write_timer.start();
+  m_seg_next = 0;
+  m_seg_sent = 0;
+  m_seg_total = 0;
+  write_next_segment(std::move(self));
+}
+
+// the memory buffers up to the next file segment are one gather write
+template <typename Protocol>
+void basic_stream_io<Protocol>::write_next_segment(std::shared_ptr<basic_stream_io> self) {
+  if (m_seg_next == m_batch_bufs.size()) {
+    handle_write(std::error_code(), m_seg_total, std::move(self));
+    return;
+  }
+  if (m_batch_bufs[m_seg_next].is_file()) {
+    send_file_segment(std::move(self));
+    return;
+  }
+  m_batch_seq.clear();
+  while (m_seg_next < m_batch_bufs.size() && !m_batch_bufs[m_seg_next].is_file()) {
+    const auto& buf = m_batch_bufs[m_seg_next];
+    m_batch_seq.push_back(std::experimental::net::const_buffer(buf.data(), buf.size()));
+    ++m_seg_next;
+  }
+  std::experimental::net::async_write(m_socket, m_batch_seq,
+    std::experimental::net::bind_executor(m_strand, make_alloc_handler(m_write_mem,
+            [this, self = std::move(self)] (const std::error_code& err, std::size_t nb) mutable {
+        if (err) {
+          handle_write(err, 0, std::move(self));
+          return;
+        }
+        m_seg_total += nb;
+        write_next_segment(std::move(self));
+      }
+    ))
+  );
+}
+
+#if defined(__linux__)
+
+// sendfile until the segment is sent, waiting for the socket to be writable as needed;
+// the socket is non-blocking (the async operations are not affected); a file that is 
+// shorter than the segment (or cannot be read) leaves the stream incomplete, so the
+// IO handler is shut down
+template <typename Protocol>
+void basic_stream_io<Protocol>::send_file_segment(std::shared_ptr<basic_stream_io> self) {
+  const auto& seg = m_batch_bufs[m_seg_next].get_file_segment();
+  std::error_code ec;
+  m_socket.native_non_blocking(true, ec);
+  while (m_seg_sent < seg.size()) {
+    auto off = static_cast<off_t>(seg.offset() + m_seg_sent);
+    auto nb = ::sendfile(m_socket.native_handle(), seg.native_handle(), &off, 
+                         seg.size() - m_seg_sent);
+    if (nb < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        m_socket.async_wait(socket_type::wait_write,
+          std::experimental::net::bind_executor(m_strand, make_alloc_handler(m_write_mem,
+            [this, self = std::move(self)] (const std::error_code& err) mutable {
+              if (err) {
+                handle_write(err, 0, std::move(self));
+                return;
+              }
+              send_file_segment(std::move(self));
+            }
+          ))
+        );
+        return;
+      }
+      ec = std::error_code(errno, std::system_category());
+      if (errno == EPIPE || errno == ECONNRESET) {
+        handle_write(ec, 0, std::move(self)); // reported by the read side
+        return;
+      }
+      m_batch_bufs.clear();
+      m_notifier_cb(ec, std::move(self));
+      return;
+    }
+    if (nb == 0) {
+      m_batch_bufs.clear();
+      m_notifier_cb(std::make_error_code(std::errc::io_error), std::move(self));
+      return;
+    }
+    m_seg_sent += static_cast<std::size_t>(nb);
+    m_seg_total += static_cast<std::size_t>(nb);
+  }
+  m_seg_sent = 0;
+  ++m_seg_next;
+  write_next_segment(std::move(self));
+}
+
+#else
+
+// no sendfile, the segment is read into the staging buffer and written in chunks
+template <typename Protocol>
+void basic_stream_io<Protocol>::send_file_segment(std::shared_ptr<basic_stream_io> self) {
+  constexpr std::size_t chunk_size = 65536u;
+  const auto& seg = m_batch_bufs[m_seg_next].get_file_segment();
+  if (m_seg_sent == seg.size()) {
+    m_seg_sent = 0;
+    ++m_seg_next;
+    write_next_segment(std::move(self));
+    return;
+  }
+  m_cork_buf.resize(std::min(chunk_size, seg.size() - m_seg_sent));
+  auto nb = ::pread(seg.native_handle(), m_cork_buf.data(), m_cork_buf.size(),
+                    static_cast<off_t>(seg.offset() + m_seg_sent));
+  if (nb <= 0) {
+    m_batch_bufs.clear();
+    m_notifier_cb(nb < 0 ? std::error_code(errno, std::system_category()) :
+                           std::make_error_code(std::errc::io_error), std::move(self));
+    return;
+  }
+  std::experimental::net::async_write(m_socket, 
+          std::experimental::net::const_buffer(m_cork_buf.data(), static_cast<std::size_t>(nb)),
+    std::experimental::net::bind_executor(m_strand, make_alloc_handler(m_write_mem,
+            [this, self = std::move(self)] (const std::error_code& err, std::size_t n) mutable {
+        if (err) {
+          handle_write(err, 0, std::move(self));
+          return;
+        }
+        m_seg_sent += n;
+        m_seg_total += n;
+        send_file_segment(std::move(self));
+      }
+    ))
+  );
+}
+
+#endif
+
+#if defined(__linux__) && defined(MSG_ZEROCOPY)
+
+template <typename Protocol>
+void basic_stream_io<Protocol>::start_write_zero_copy(std::shared_ptr<basic_stream_io> self) {
+  m_write_timer.start();
+  m_zc_iovs.clear();
+  for (const auto& buf : m_batch_bufs) {
+    m_zc_iovs.push_back(::iovec { const_cast<std::byte*>(buf.data()), buf.size() });
+  }
+  m_zc_iov_next = 0;
+  m_zc_sent = 0;
+  m_zc_write_seqs = 0;
+  send_zero_copy(std::move(self));
+}
+
+// sendmsg until the whole write is sent, waiting for the socket to be writable as needed
+template <typename Protocol>
+void basic_stream_io<Protocol>::send_zero_copy(std::shared_ptr<basic_stream_io> self) {
+  while (m_zc_iov_next < m_zc_iovs.size()) {
+    ::msghdr msg { };
+    msg.msg_iov = m_zc_iovs.data() + m_zc_iov_next;
+    msg.msg_iovlen = std::min<std::size_t>(m_zc_iovs.size() - m_zc_iov_next, IOV_MAX);
+    auto nb = ::sendmsg(m_socket.native_handle(), &msg, 
+                        MSG_ZEROCOPY | MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (nb < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        m_socket.async_wait(socket_type::wait_write,
+          std::experimental::net::bind_executor(m_strand, make_alloc_handler(m_write_mem,
+            [this, self = std::move(self)] (const std::error_code& err) mutable {
+              if (err) {
+                handle_write(err, 0, std::move(self));
+                return;
+              }
+              send_zero_copy(std::move(self));
+            }
+          ))
+        );
+        return;
+      }
+      if (errno != ENOBUFS) {
+        handle_write(std::error_code(errno, std::system_category()), 0, std::move(self));
+        return;
+      }
+      // out of socket option memory for notifications, the rest is written normally; the
+      // buffers stay alive for the part already sent without a copy
+      if (m_zc_write_seqs != 0) {
+        m_zc_pending.push_back(zc_pending { m_zc_next_seq - m_zc_write_seqs, 
+                                            m_zc_next_seq - 1, 0u, m_batch_bufs });
+        start_zero_copy_wait();
+      }
+      m_batch_seq.clear();
+      for (auto i = m_zc_iov_next; i < m_zc_iovs.size(); ++i) {
+        m_batch_seq.push_back(std::experimental::net::const_buffer(m_zc_iovs[i].iov_base, 
+                                                                   m_zc_iovs[i].iov_len));
+      }
+      std::experimental::net::async_write(m_socket, m_batch_seq,
+        std::experimental::net::bind_executor(m_strand, make_alloc_handler(m_write_mem,
+          [this, self = std::move(self)] (const std::error_code& err, std::size_t nb) mutable {
+            handle_write(err, m_zc_sent + nb, std::move(self));
+          }
+        ))
+      );
+      return;
+    }
+    ++m_zc_next_seq;
+    ++m_zc_write_seqs;
+    m_zc_sent += static_cast<std::size_t>(nb);
+    // advance past the bytes sent, a partially sent iovec is adjusted in place
+    auto rem = static_cast<std::size_t>(nb);
+    while (m_zc_iov_next < m_zc_iovs.size() && rem >= m_zc_iovs[m_zc_iov_next].iov_len) {
+      rem -= m_zc_iovs[m_zc_iov_next].iov_len;
+      ++m_zc_iov_next;
+    }
+    if (rem != 0) {
+      auto& iov = m_zc_iovs[m_zc_iov_next];
+      iov.iov_base = static_cast<std::byte*>(iov.iov_base) + rem;
+      iov.iov_len -= rem;
+    }
+  }
+  m_zc_pending.push_back(zc_pending { m_zc_next_seq - m_zc_write_seqs, m_zc_next_seq - 1, 
+                                      0u, std::move(m_batch_bufs) });
+  m_batch_bufs.clear();
+  start_zero_copy_wait();
+  handle_write(std::error_code(), m_zc_sent, std::move(self));
+}
+
+// completion notifications are queued on the socket error queue, which makes the socket
+// report an error condition; the wait holds a shared_ptr, so the buffers (and this 
+// object) stay alive until the last notification or until the socket is closed
+template <typename Protocol>
+void basic_stream_io<Protocol>::start_zero_copy_wait() {
+  if (m_zc_err_wait || m_zc_pending.empty()) {
+    return;
+  }
+  m_zc_err_wait = true;
+  m_socket.async_wait(socket_type::wait_error,
+    std::experimental::net::bind_executor(m_strand, make_alloc_handler(m_zc_mem,
+      [this, self = this->shared_from_this()] (const std::error_code& err) {
+        m_zc_err_wait = false;
+        if (err) {
+          return;
+        }
+        handle_zero_copy_completions();
+        start_zero_copy_wait();
+      }
+    ))
+  );
+}
+
+template <typename Protocol>
+void basic_stream_io<Protocol>::handle_zero_copy_completions() {
+  alignas(::cmsghdr) unsigned char ctrl[CMSG_SPACE(sizeof(::sock_extended_err) + 
+                                                   sizeof(::sockaddr_in6))];
+  for (;;) {
+    ::msghdr msg { };
+    msg.msg_control = ctrl;
+    msg.msg_controllen = sizeof(ctrl);
+    if (::recvmsg(m_socket.native_handle(), &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break; // EAGAIN, the error queue is empty
+    }
+    for (auto cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+      if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+            (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))) {
+        continue;
+      }
+      ::sock_extended_err serr;
+      std::memcpy(&serr, CMSG_DATA(cm), sizeof(serr));
+      if (serr.ee_errno != 0 || serr.ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+        continue;
+      }
+      // the range [ee_info, ee_data] is complete, ranges are usually (but not always) in 
+      // order; sequence numbers wrap, so the comparisons are done on differences
+      for (auto& p : m_zc_pending) {
+        std::uint32_t lo = serr.ee_info - p.m_first_seq;
+        std::uint32_t hi = serr.ee_data - p.m_first_seq;
+        std::uint32_t last = p.m_last_seq - p.m_first_seq;
+        if (static_cast<std::int32_t>(hi) < 0 || static_cast<std::int32_t>(lo - last) > 0) {
+          continue; // no overlap
+        }
+        if (static_cast<std::int32_t>(lo) < 0) {
+          lo = 0;
+        }
+        if (static_cast<std::int32_t>(hi - last) > 0) {
+          hi = last;
+        }
+        p.m_num_done += (hi - lo + 1);
+      }
+    }
+  }
+  // the buffers are released in write order
+  while (!m_zc_pending.empty() && 
+         m_zc_pending.front().m_num_done > (m_zc_pending.front().m_last_seq - 
+                                            m_zc_pending.front().m_first_seq)) {
+    m_zc_pending.pop_front();
+  }
+}
+
+#endif
+
+using tcp_io = basic_stream_io<std::experimental::net::ip::tcp>;
 using tcp_io_ptr = std::shared_ptr<tcp_io>;
 
+using local_stream_io = basic_stream_io<chops::net::local::stream_protocol>;
+using local_stream_io_ptr = std::shared_ptr<local_stream_io>;
+
 inline std::size_t null_msg_frame (std::experimental::net::mutable_buffer) noexcept {
   return 0;
 }
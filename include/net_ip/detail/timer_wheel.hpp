@@ -0,0 +1,383 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Hierarchical timer wheel, shared by the idle timeouts of the IO handlers of an
+ *  @c io_context, for internal use.
+ *
+ *  A @c steady_timer per connection puts one entry per connection in the reactor timer
+ *  heap, and every reset is a heap update. Instead each @c io_context has one
+ *  @c idle_timer_service (a Networking TS execution context service), with one
+ *  @c steady_timer that ticks while any idle timer is active, and a timer wheel of four
+ *  levels of 64 slots; scheduling and cancelling are constant time list operations.
+ *
+ *  Activity (e.g. a read completion) only stores the current tick in the entry, without
+ *  a lock. The entry stays in its slot, and when the slot expires the entry is either
+ *  fired (no activity for the timeout) or rescheduled for the last activity plus the
+ *  timeout.
+ *
+ *  @note For internal use only.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef TIMER_WHEEL_HPP_INCLUDED
+#define TIMER_WHEEL_HPP_INCLUDED
+
+#include <experimental/io_context>
+#include <experimental/executor>
+#include <experimental/timer>
+
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint64_t
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <memory> // std::unique_ptr
+#include <functional> // std::function
+#include <vector>
+#include <system_error>
+#include <utility> // std::forward
+
+namespace chops {
+namespace net {
+namespace detail {
+
+// not thread-safe, the idle_timer_service serializes access
+class timer_wheel {
+public:
+
+  static constexpr std::size_t num_levels = 4u;
+  static constexpr std::size_t slot_bits = 6u;
+  static constexpr std::size_t num_slots = 1u << slot_bits;
+  static constexpr std::uint64_t max_ticks = (std::uint64_t(1u) << (slot_bits * num_levels)) - 1u;
+
+  // intrusive list node, owned by the user of the wheel (e.g. an idle_timer)
+  struct entry {
+    entry*                     m_prev = nullptr;
+    entry*                     m_next = nullptr;
+    std::uint64_t              m_expire = 0u;
+    std::uint64_t              m_timeout = 0u; // in ticks
+    std::atomic<std::uint64_t> m_last { 0u }; // tick of the last activity
+    std::function<void ()>     m_on_expire;
+    entry**                    m_head = nullptr; // slot list while linked
+    bool                       m_linked = false;
+  };
+
+private:
+  entry*        m_slots[num_levels][num_slots] { };
+  std::uint64_t m_now = 0u;
+  std::size_t   m_size = 0u;
+
+public:
+
+  std::uint64_t now() const noexcept { return m_now; }
+
+  std::size_t size() const noexcept { return m_size; }
+
+  bool empty() const noexcept { return m_size == 0u; }
+
+  // only used when the wheel is empty
+  void reset(std::uint64_t now) noexcept { m_now = now; }
+
+  // an expire tick not in the future expires on the next tick, the delay is limited to
+  // max_ticks
+  void insert(entry& e, std::uint64_t expire) noexcept {
+    if (expire <= m_now) {
+      expire = m_now + 1u;
+    }
+    else if (expire - m_now > max_ticks) {
+      expire = m_now + max_ticks;
+    }
+    e.m_expire = expire;
+    place(e);
+  }
+
+  void erase(entry& e) noexcept {
+    if (!e.m_linked) {
+      return;
+    }
+    unlink(e, *e.m_head);
+    --m_size;
+  }
+
+  // the function object is called with each expired entry, already removed, and may
+  // insert it again
+  template <typename F>
+  void advance(std::uint64_t to, F&& func) {
+    while (m_now < to) {
+      if (m_size == 0u) {
+        m_now = to;
+        return;
+      }
+      ++m_now;
+      // when the lower levels wrap, the next slot of each higher level is redistributed,
+      // highest level first
+      std::size_t cascade = 0u;
+      while ((cascade + 1u) < num_levels &&
+             (m_now & ((std::uint64_t(1u) << (slot_bits * (cascade + 1u))) - 1u)) == 0u) {
+        ++cascade;
+      }
+      for (std::size_t level = cascade; level > 0u; --level) {
+        entry* e = detach(m_slots[level][(m_now >> (slot_bits * level)) & (num_slots - 1u)]);
+        while (e) {
+          entry* next = e->m_next;
+          e->m_linked = false;
+          --m_size;
+          place(*e); // may expire on this tick
+          e = next;
+        }
+      }
+      entry* e = detach(m_slots[0u][m_now & (num_slots - 1u)]);
+      while (e) {
+        entry* next = e->m_next;
+        e->m_linked = false;
+        --m_size;
+        func(*e);
+        e = next;
+      }
+    }
+  }
+
+  // removes every entry, without calling any function object
+  void clear() noexcept {
+    for (auto& level : m_slots) {
+      for (auto& head : level) {
+        entry* e = detach(head);
+        while (e) {
+          e->m_linked = false;
+          e = e->m_next;
+        }
+      }
+    }
+    m_size = 0u;
+  }
+
+private:
+
+  void place(entry& e) noexcept {
+    // the highest 6 bit group where the expire tick differs from now selects the level
+    std::uint64_t diff = e.m_expire ^ m_now;
+    std::size_t level = 0u;
+    while (level < (num_levels - 1u) && (diff >> (slot_bits * (level + 1u))) != 0u) {
+      ++level;
+    }
+    link(e, m_slots[level][(e.m_expire >> (slot_bits * level)) & (num_slots - 1u)]);
+    ++m_size;
+  }
+
+  static void link(entry& e, entry*& head) noexcept {
+    e.m_prev = nullptr;
+    e.m_next = head;
+    if (head) {
+      head->m_prev = &e;
+    }
+    head = &e;
+    e.m_head = &head;
+    e.m_linked = true;
+  }
+
+  static void unlink(entry& e, entry*& head) noexcept {
+    if (e.m_prev) {
+      e.m_prev->m_next = e.m_next;
+    }
+    else {
+      head = e.m_next;
+    }
+    if (e.m_next) {
+      e.m_next->m_prev = e.m_prev;
+    }
+    e.m_prev = nullptr;
+    e.m_next = nullptr;
+    e.m_head = nullptr;
+    e.m_linked = false;
+  }
+
+  static entry* detach(entry*& head) noexcept {
+    entry* e = head;
+    head = nullptr;
+    return e;
+  }
+
+};
+
+// one per io_context, created on first use through use_service
+class idle_timer_service : public std::experimental::net::execution_context::service {
+public:
+  using key_type = idle_timer_service;
+  using entry = timer_wheel::entry;
+
+  static constexpr std::chrono::milliseconds tick_interval { 100 };
+
+private:
+  using clock_type = std::chrono::steady_clock;
+  using lg = std::lock_guard<std::mutex>;
+
+  std::mutex                           m_mutex;
+  timer_wheel                          m_wheel;
+  // released in shutdown, while the timer queue of the io_context still exists
+  std::unique_ptr<std::experimental::net::steady_timer> m_timer;
+  clock_type::time_point               m_epoch;
+  std::atomic<std::uint64_t>           m_cur_tick;
+  bool                                 m_ticking;
+  bool                                 m_shut;
+
+public:
+
+  // services of this type are only created for an io_context
+  explicit idle_timer_service(std::experimental::net::execution_context& ctx) :
+    service(ctx), m_mutex(), m_wheel(),
+    m_timer(std::make_unique<std::experimental::net::steady_timer>(
+              static_cast<std::experimental::net::io_context&>(ctx))),
+    m_epoch(clock_type::now()), m_cur_tick(0u), m_ticking(false), m_shut(false) { }
+
+  // current tick, updated on each tick while any entry is scheduled
+  std::uint64_t current_tick() const noexcept {
+    return m_cur_tick.load(std::memory_order_relaxed);
+  }
+
+  static std::uint64_t to_ticks(std::chrono::milliseconds timeout) noexcept {
+    auto t = (timeout.count() + tick_interval.count() - 1) / tick_interval.count();
+    return t > 0 ? static_cast<std::uint64_t>(t) : 1u;
+  }
+
+  // the entry is scheduled for its timeout from now, rescheduled if already scheduled
+  void schedule(entry& e) {
+    lg g(m_mutex);
+    if (m_shut) {
+      return;
+    }
+    m_wheel.erase(e);
+    if (!m_ticking && m_wheel.empty()) {
+      m_wheel.reset(clock_tick());
+      m_cur_tick.store(m_wheel.now(), std::memory_order_relaxed);
+    }
+    e.m_last.store(m_wheel.now(), std::memory_order_relaxed);
+    m_wheel.insert(e, m_wheel.now() + e.m_timeout);
+    if (!m_ticking) {
+      m_ticking = true;
+      start_timer();
+    }
+  }
+
+  void cancel(entry& e) {
+    lg g(m_mutex);
+    m_wheel.erase(e);
+  }
+
+private:
+
+  void shutdown() noexcept override {
+    lg g(m_mutex);
+    m_shut = true;
+    m_wheel.clear();
+    m_timer.reset();
+  }
+
+  std::uint64_t clock_tick() const {
+    return static_cast<std::uint64_t>((clock_type::now() - m_epoch) / tick_interval);
+  }
+
+  void start_timer() {
+    m_timer->expires_at(m_epoch + tick_interval * (m_wheel.now() + 1u));
+    m_timer->async_wait([this] (const std::error_code& err) { handle_tick(err); } );
+  }
+
+  void handle_tick(const std::error_code& err) {
+    std::vector<std::function<void ()> > fired;
+    {
+      lg g(m_mutex);
+      if (err || m_shut) {
+        m_ticking = false;
+        return;
+      }
+      m_wheel.advance(clock_tick(), [this, &fired] (entry& e) {
+          auto now = m_wheel.now();
+          auto last = e.m_last.load(std::memory_order_relaxed);
+          if ((now - last) >= e.m_timeout) {
+            fired.push_back(e.m_on_expire);
+            e.m_last.store(now, std::memory_order_relaxed);
+            m_wheel.insert(e, now + e.m_timeout);
+            return;
+          }
+          m_wheel.insert(e, last + e.m_timeout);
+        }
+      );
+      m_cur_tick.store(m_wheel.now(), std::memory_order_relaxed);
+      if (m_wheel.empty()) {
+        m_ticking = false;
+      }
+      else {
+        start_timer();
+      }
+    }
+    // called without the lock, so the function objects can schedule or cancel entries
+    for (auto& f : fired) {
+      f();
+    }
+  }
+
+};
+
+// an idle timeout, the function object is called (from the io_context, not from an IO
+// handler strand) each time there is no activity for the timeout; periodic until stopped
+class idle_timer {
+private:
+  std::atomic<idle_timer_service*> m_svc;
+  timer_wheel::entry               m_entry;
+
+public:
+  idle_timer() noexcept : m_svc(nullptr), m_entry() { }
+
+  ~idle_timer() { stop(); }
+
+private:
+  idle_timer(const idle_timer&) = delete;
+  idle_timer(idle_timer&&) = delete;
+  idle_timer& operator=(const idle_timer&) = delete;
+  idle_timer& operator=(idle_timer&&) = delete;
+
+public:
+
+  // a timeout of 0 only stops the timer
+  template <typename F>
+  void start(std::experimental::net::io_context& ioc, std::chrono::milliseconds timeout,
+             F&& func) {
+    stop();
+    if (timeout.count() <= 0) {
+      return;
+    }
+    auto& svc = std::experimental::net::use_service<idle_timer_service>(ioc);
+    m_entry.m_timeout = idle_timer_service::to_ticks(timeout);
+    m_entry.m_on_expire = std::forward<F>(func);
+    m_svc.store(&svc);
+    svc.schedule(m_entry);
+  }
+
+  void stop() {
+    if (auto svc = m_svc.load()) {
+      svc->cancel(m_entry);
+    }
+  }
+
+  // constant time and lock-free, called on each read (or send)
+  void touch() noexcept {
+    if (auto svc = m_svc.load(std::memory_order_relaxed)) {
+      m_entry.m_last.store(svc->current_tick(), std::memory_order_relaxed);
+    }
+  }
+
+};
+
+} // end detail namespace
+} // end net namespace
+} // end chops namespace
+
+#endif
+
@@ -0,0 +1,237 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Asynchronous TLS handshake on a connected TCP socket, followed by the hand off
+ *  of the record layer to kernel TLS, for internal use.
+ *
+ *  OpenSSL reads and writes the socket directly (a socket BIO), and the non-blocking
+ *  handshake is resumed when the socket is readable or writable. With
+ *  @c SSL_OP_ENABLE_KTLS OpenSSL installs the session keys in the kernel when the
+ *  handshake switches ciphers; once both directions are in the kernel the OpenSSL
+ *  connection object is released (without a TLS shutdown) and the socket is passed on.
+ *
+ *  @note For internal use only.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef TLS_HANDSHAKE_HPP_INCLUDED
+#define TLS_HANDSHAKE_HPP_INCLUDED
+
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+
+#include <experimental/internet>
+#include <experimental/socket>
+#include <experimental/executor>
+#include <experimental/timer>
+
+#include <system_error>
+#include <memory>
+#include <functional> // std::function
+#include <string>
+#include <utility> // std::move
+
+#include "net_ip/tls_context.hpp"
+#include "net_ip/net_ip_error.hpp"
+
+namespace chops {
+namespace net {
+namespace detail {
+
+class tls_handshake : public std::enable_shared_from_this<tls_handshake> {
+public:
+  using socket_type = std::experimental::net::ip::tcp::socket;
+  using strand_type = std::experimental::net::strand<socket_type::executor_type>;
+  // called within the strand, with the socket (kTLS enabled if no error)
+  using done_cb = std::function<void (std::error_code, socket_type)>;
+
+private:
+  struct ssl_deleter {
+    void operator()(SSL* p) const noexcept { SSL_free(p); }
+  };
+
+  socket_type                           m_socket;
+  tls_context_ptr                       m_ctx;
+  strand_type                           m_strand;
+  std::unique_ptr<SSL, ssl_deleter>     m_ssl;
+  // client side only, the session cache key and the SNI and verified host name
+  std::string                           m_session_key;
+  std::string                           m_server_name;
+  std::experimental::net::steady_timer  m_timer;
+  done_cb                               m_done;
+  bool                                  m_non_blocking;
+  bool                                  m_timed_out;
+  bool                                  m_cancelled;
+  bool                                  m_finished;
+
+public:
+  tls_handshake(socket_type sock, tls_context_ptr ctx, const strand_type& strand,
+                std::string session_key = std::string(),
+                std::string server_name = std::string()) :
+    m_socket(std::move(sock)), m_ctx(std::move(ctx)), m_strand(strand), m_ssl(),
+    m_session_key(std::move(session_key)), m_server_name(std::move(server_name)),
+    m_timer(m_socket.get_executor().context()), m_done(), m_non_blocking(false),
+    m_timed_out(false), m_cancelled(false), m_finished(false) { }
+
+private:
+  tls_handshake(const tls_handshake&) = delete;
+  tls_handshake& operator=(const tls_handshake&) = delete;
+
+public:
+
+  // the function object is always called asynchronously, exactly once
+  void start(done_cb func) {
+    m_done = std::move(func);
+    auto self = shared_from_this();
+    post(m_strand, [this, self] { begin(); } );
+  }
+
+  // called within the strand, the handshake completes with an operation_canceled error
+  void cancel() {
+    m_cancelled = true;
+    std::error_code ec;
+    m_socket.cancel(ec);
+    m_timer.cancel();
+  }
+
+  // called from any thread, the cancel is performed within the strand
+  void post_cancel() {
+    auto self = shared_from_this();
+    post(m_strand, [this, self] { cancel(); } );
+  }
+
+private:
+
+  void begin() {
+    if (m_finished) {
+      return;
+    }
+    if (m_cancelled) {
+      finish(std::make_error_code(std::errc::operation_canceled));
+      return;
+    }
+    std::error_code ec;
+    m_non_blocking = m_socket.native_non_blocking();
+    m_socket.native_non_blocking(true, ec);
+    if (ec) {
+      finish(ec);
+      return;
+    }
+    m_ssl.reset(SSL_new(m_ctx->native_handle()));
+    if (!m_ssl || SSL_set_fd(m_ssl.get(), m_socket.native_handle()) != 1) {
+      finish(std::make_error_code(net_ip_errc::tls_handshake_failed));
+      return;
+    }
+    if (m_ctx->is_server()) {
+      SSL_set_accept_state(m_ssl.get());
+    }
+    else {
+      SSL_set_connect_state(m_ssl.get());
+      if (!m_server_name.empty()) {
+        SSL_set_tlsext_host_name(m_ssl.get(), m_server_name.c_str());
+        if (m_ctx->get_config().verify_peer) {
+          SSL_set1_host(m_ssl.get(), m_server_name.c_str());
+        }
+      }
+      if (auto sess = m_ctx->find_session(m_session_key)) {
+        SSL_set_session(m_ssl.get(), sess.get()); // takes its own reference
+      }
+    }
+    auto to = m_ctx->get_config().handshake_timeout;
+    if (to.count() > 0) {
+      m_timer.expires_after(to);
+      auto self = shared_from_this();
+      m_timer.async_wait(std::experimental::net::bind_executor(m_strand,
+            [this, self] (const std::error_code& err) {
+          if (err || m_finished) {
+            return;
+          }
+          m_timed_out = true;
+          std::error_code ec;
+          m_socket.cancel(ec); // the outstanding wait completes with an error
+        }
+      ));
+    }
+    step();
+  }
+
+  void step() {
+    ERR_clear_error();
+    int r = SSL_do_handshake(m_ssl.get());
+    if (r == 1) {
+      handshake_done();
+      return;
+    }
+    switch (SSL_get_error(m_ssl.get(), r)) {
+    case SSL_ERROR_WANT_READ:
+      wait(std::experimental::net::socket_base::wait_read);
+      break;
+    case SSL_ERROR_WANT_WRITE:
+      wait(std::experimental::net::socket_base::wait_write);
+      break;
+    default:
+      ERR_clear_error();
+      finish(std::make_error_code(net_ip_errc::tls_handshake_failed));
+      break;
+    }
+  }
+
+  void wait(std::experimental::net::socket_base::wait_type w) {
+    auto self = shared_from_this();
+    m_socket.async_wait(w, std::experimental::net::bind_executor(m_strand,
+          [this, self] (const std::error_code& err) {
+        if (m_finished) {
+          return;
+        }
+        if (err) {
+          finish(m_timed_out ? std::make_error_code(net_ip_errc::tls_handshake_timeout) : err);
+          return;
+        }
+        step();
+      }
+    ));
+  }
+
+  void handshake_done() {
+    // the kernel only holds the keys if both directions were offloaded
+    if (BIO_ctrl(SSL_get_wbio(m_ssl.get()), BIO_CTRL_GET_KTLS_SEND, 0, nullptr) <= 0 ||
+        BIO_ctrl(SSL_get_rbio(m_ssl.get()), BIO_CTRL_GET_KTLS_RECV, 0, nullptr) <= 0) {
+      finish(std::make_error_code(net_ip_errc::tls_ktls_unavailable));
+      return;
+    }
+    if (!m_ctx->is_server()) {
+      m_ctx->save_session(m_session_key, 
+                          tls_context::session_ptr(SSL_get1_session(m_ssl.get())));
+    }
+    finish(std::error_code());
+  }
+
+  void finish(const std::error_code& err) {
+    m_finished = true;
+    m_timer.cancel();
+    // the socket BIO does not own the descriptor, and no close_notify is sent
+    m_ssl.reset();
+    std::error_code ec;
+    m_socket.native_non_blocking(m_non_blocking, ec);
+    auto func = std::move(m_done);
+    func(err, std::move(m_socket));
+  }
+
+};
+
+using tls_handshake_ptr = std::shared_ptr<tls_handshake>;
+
+} // end detail namespace
+} // end net namespace
+} // end chops namespace
+
+#endif
+
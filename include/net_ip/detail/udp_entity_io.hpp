@@ -4,6 +4,23 @@
  *
  *  @brief Internal class that combines a UDP entity and UDP io handler.
  *
+ *  The class is a class template on the datagram protocol, instantiated for UDP and for
+ *  local (Unix domain) datagram sockets, with the same output queueing, batching and
+ *  read buffer handling. Multicast and io_uring reads are only used for UDP. A local 
+ *  entity that receives (or is sent replies) is bound to a socket file path or abstract 
+ *  name, and a socket file it bound is removed when its socket is closed.
+ *
+ *  On Linux UDP entities can use segmentation offload. When sending, consecutive queued
+ *  datagrams of a write batch with the same destination and size (the last one may be
+ *  shorter) are passed to the kernel as one buffer with a @c UDP_SEGMENT control 
+ *  message, and split into datagrams by the kernel or the network device. When 
+ *  receiving with @c UDP_GRO, a read can hold several coalesced datagrams, which are 
+ *  split on the segment size control message before the message handler is called.
+ *
+ *  With receive timestamps enabled (Linux @c SO_TIMESTAMPING), reads use @c recvmmsg and
+ *  the kernel and network device times of each datagram are taken from its control 
+ *  messages, for message handlers taking a @c receive_timestamp.
+ *
  *  @note For internal use only.
  *
  *  @author Cliff Green
@@ -25,59 +42,213 @@
 
 #include <memory> // std::shared_ptr, std::enable_shared_from_this
 #include <system_error>
+#include <atomic>
+#include <vector>
+#include <limits> // std::numeric_limits
+#include <cstring> // std::memcpy
+#include <cstdint> // std::uint32_t
 
 #include <cstddef> // std::size_t
 #include <utility> // std::forward, std::move
+#include <functional> // std::function
+#include <optional>
+#include <type_traits> // std::is_same_v
+#include <algorithm> // std::min, std::max
+
+#ifdef __linux__
+#include <cerrno>
+#include <sys/socket.h> // recvmmsg, sendmmsg
+#include <sys/uio.h> // iovec
+#include <netinet/in.h> // in_pktinfo, in6_pktinfo
+#include <netinet/udp.h> // UDP_SEGMENT, UDP_GRO
+#include <unistd.h> // dup
+#endif
+
+#include <unistd.h> // unlink
 
 #include "net_ip/detail/io_common.hpp"
+#include "net_ip/detail/handler_memory.hpp"
 #include "net_ip/detail/net_entity_common.hpp"
 #include "net_ip/detail/output_queue.hpp"
+#include "net_ip/detail/multicast_groups.hpp"
+#include "net_ip/detail/socket_options.hpp"
+#include "net_ip/detail/io_uring.hpp"
+#include "net_ip/detail/timer_wheel.hpp"
+#include "net_ip/instrumentation.hpp"
+#include "net_ip/read_buffer_policy.hpp"
 
 #include "net_ip/queue_stats.hpp"
+#include "net_ip/io_handler_id.hpp"
 #include "net_ip/net_ip_error.hpp"
 #include "net_ip/basic_io_interface.hpp"
+#include "net_ip/multicast.hpp"
+#include "net_ip/local_protocol.hpp"
+#include "net_ip/socket_profile.hpp"
+#include "net_ip/idle_timeouts.hpp"
+#include "net_ip/send_priority.hpp"
 #include "utility/shared_buffer.hpp"
 
 namespace chops {
 namespace net {
 namespace detail {
 
-class udp_entity_io : public std::enable_shared_from_this<udp_entity_io> {
+template <typename Protocol>
+class basic_datagram_entity_io : 
+    public std::enable_shared_from_this<basic_datagram_entity_io<Protocol> > {
 public:
-  using socket_type = std::experimental::net::ip::udp::socket;
-  using endpoint_type = std::experimental::net::ip::udp::endpoint;
+  using socket_type = typename Protocol::socket;
+  using endpoint_type = typename Protocol::endpoint;
 
 private:
+  static constexpr bool is_udp = std::is_same_v<Protocol, std::experimental::net::ip::udp>;
+  static constexpr bool is_local = 
+    std::is_same_v<Protocol, chops::net::local::datagram_protocol>;
+
   using byte_vec = chops::mutable_shared_buffer::byte_vec;
+  using strand_type = std::experimental::net::strand<typename socket_type::executor_type>;
+  using outq_el = typename io_common<basic_datagram_entity_io>::outq_el;
+  using outq_opt_el = typename io_common<basic_datagram_entity_io>::outq_opt_el;
+  using address = std::experimental::net::ip::address;
+  using queue_event_cb = std::function<void (basic_io_interface<basic_datagram_entity_io>, std::error_code)>;
+
+#ifdef __linux__
+  // room for a packet info, a drop count, a receive offload segment size and a receive
+  // timestamps control message
+  struct ctrl_buf {
+    alignas(::cmsghdr) unsigned char m_data[CMSG_SPACE(sizeof(::in6_pktinfo)) + 
+                                            CMSG_SPACE(sizeof(std::uint32_t)) +
+                                            CMSG_SPACE(sizeof(int)) +
+                                            CMSG_SPACE(3 * sizeof(::timespec))];
+  };
+  // send offload segment size control message
+  struct gso_ctrl_buf {
+    alignas(::cmsghdr) unsigned char m_data[CMSG_SPACE(sizeof(std::uint16_t))];
+  };
+  // kernel limits for one send offload buffer, and the read buffer size with receive
+  // offload enabled
+  static constexpr std::size_t gso_max_segs = 64u;
+  static constexpr std::size_t gso_max_bytes = 65507u;
+  static constexpr std::size_t gro_read_size = 65535u;
+#endif
 
 private:
 
-  io_common<udp_entity_io>          m_io_common;
-  net_entity_common<udp_entity_io>  m_entity_common;
+  io_common<basic_datagram_entity_io>          m_io_common;
+  net_entity_common<basic_datagram_entity_io>  m_entity_common;
   socket_type                       m_socket;
+  strand_type                       m_strand; // serializes handlers when multiple threads run
   endpoint_type                     m_local_endp;
   endpoint_type                     m_default_dest_endp;
-  // TODO: multicast stuff
+  // only set for a multicast entity
+  std::unique_ptr<multicast_groups> m_mcast_groups;
+  multicast_options                 m_mcast_opts;
+  // applied before the socket is bound
+  socket_profile                    m_sock_prof;
+  // a bound local socket file is removed when the socket is closed
+  bool                              m_owns_file;
 
   // following members could be passed through handler, but are members for 
   // simplicity and less copying
   byte_vec                          m_byte_vec;
   std::size_t                       m_max_size;
   endpoint_type                     m_sender_endp;
+  // with a shrink size below the max size, m_byte_vec is only held while a datagram is
+  // received and handled
+  read_buffer_policy                m_rb_policy;
+
+  // batched IO, one recvmmsg or sendmmsg call for multiple datagrams (Linux only, the 
+  // batch sizes are ignored on other platforms); a value of 1 is the non-batched path
+  std::size_t                       m_max_read_batch;
+  std::size_t                       m_max_write_batch;
+  std::size_t                       m_max_write_batch_bytes;
+  queue_event_cb                    m_queue_event_cb;
+  // the datagram being sent (non-batched) must stay alive until the send completes
+  outq_opt_el                       m_write_elem;
+  event_timer                       m_write_timer;
+  // recycled operation storage for the read chain and the write chain
+  handler_memory                    m_read_mem;
+  handler_memory                    m_write_mem;
+  // idle timeouts share the timer wheel of the io_context, the heartbeat is only 
+  // accessed within the strand
+  idle_timer                        m_read_idle;
+  idle_timer                        m_write_idle;
+  std::optional<chops::const_shared_buffer> m_heartbeat;
+#ifdef __linux__
+  std::vector<byte_vec>             m_read_bufs;
+  std::vector<endpoint_type>        m_read_endps;
+  std::vector<::iovec>              m_read_iovs;
+  std::vector<::mmsghdr>            m_read_hdrs;
+  std::vector<ctrl_buf>             m_read_ctrls; // multicast, receive offload or timestamps
+  // write batch must stay alive until sent
+  std::vector<outq_el>              m_write_elems;
+  std::vector<::iovec>              m_write_iovs;
+  std::vector<::mmsghdr>            m_write_hdrs;
+  std::size_t                       m_write_next; // first datagram of the batch not yet sent
+  // segmentation offload, a write header can hold multiple datagrams (elements), so the
+  // first element of each header is kept
+  std::size_t                       m_gso_segs; // 0 or 1 is no send offload
+  bool                              m_gro;
+  std::vector<gso_ctrl_buf>         m_write_ctrls;
+  std::vector<std::size_t>          m_write_firsts;
+  bool                              m_rx_ts;
+#endif
+  // timestamps of the datagram being delivered, only set with receive timestamps enabled
+  receive_timestamp                 m_rx_stamp;
+  // io_uring multishot reads (Linux 6.0 or later, ignored otherwise), the number of 
+  // kernel selected read buffers, 0 is the reactor read path; set from any thread, used
+  // by the next start_io
+  std::atomic_size_t                m_uring_bufs;
+  // receive timestamps requested from any thread, applied to the socket by the next
+  // start_io (before the first read), or within the strand if the IO is already started
+  std::atomic_bool                  m_rx_ts_req;
+  // segmentation offload, requested and applied the same way
+  std::atomic_size_t                m_gso_req;
+  std::atomic_bool                  m_gro_req;
+#ifdef IORING_RECV_MULTISHOT
+  std::unique_ptr<uring_multishot_recv> m_uring;
+  // a duplicate of the ring descriptor, waited on for readability when completions
+  // are available
+  socket_type                       m_uring_wait;
+#endif
 
 public:
-  udp_entity_io(std::experimental::net::io_context& ioc, 
-                const endpoint_type& local_endp) noexcept : 
+  basic_datagram_entity_io(std::experimental::net::io_context& ioc, 
+                const endpoint_type& local_endp,
+                const socket_profile& prof = socket_profile()) noexcept : 
     m_io_common(), m_entity_common(), 
-    m_socket(ioc), m_local_endp(local_endp), m_default_dest_endp(), 
-    m_byte_vec(), m_max_size(0), m_sender_endp() { }
+    m_socket(ioc), m_strand(m_socket.get_executor()), m_local_endp(local_endp), m_default_dest_endp(), 
+    m_mcast_groups(), m_mcast_opts(), m_sock_prof(prof), m_owns_file(false),
+    m_byte_vec(), m_max_size(0), m_sender_endp(), m_rb_policy(),
+    m_max_read_batch(1), m_max_write_batch(1), m_max_write_batch_bytes(0), m_queue_event_cb(),
+    m_write_elem(), m_write_timer(), m_read_mem(), m_write_mem(),
+    m_read_idle(), m_write_idle(), m_heartbeat()
+#ifdef __linux__
+    , m_read_bufs(), m_read_endps(), m_read_iovs(), m_read_hdrs(), m_read_ctrls(),
+    m_write_elems(), m_write_iovs(), m_write_hdrs(), m_write_next(0),
+    m_gso_segs(0), m_gro(false), m_write_ctrls(), m_write_firsts(), m_rx_ts(false)
+#endif
+    , m_rx_stamp(), m_uring_bufs(0), m_rx_ts_req(false), m_gso_req(0), m_gro_req(false)
+#ifdef IORING_RECV_MULTISHOT
+    , m_uring(), m_uring_wait(ioc)
+#endif
+    { }
+
+  // multicast entity, the groups are joined when started
+  basic_datagram_entity_io(std::experimental::net::io_context& ioc, 
+                const endpoint_type& local_endp, const std::vector<address>& groups,
+                const multicast_options& opts, 
+                const socket_profile& prof = socket_profile()) : 
+      basic_datagram_entity_io(ioc, local_endp, prof) {
+    m_mcast_groups = std::make_unique<multicast_groups>(groups);
+    m_mcast_opts = opts;
+  }
 
 private:
   // no copy or assignment semantics for this class
-  udp_entity_io(const udp_entity_io&) = delete;
-  udp_entity_io(udp_entity_io&&) = delete;
-  udp_entity_io& operator=(const udp_entity_io&) = delete;
-  udp_entity_io& operator=(udp_entity_io&&) = delete;
+  basic_datagram_entity_io(const basic_datagram_entity_io&) = delete;
+  basic_datagram_entity_io(basic_datagram_entity_io&&) = delete;
+  basic_datagram_entity_io& operator=(const basic_datagram_entity_io&) = delete;
+  basic_datagram_entity_io& operator=(basic_datagram_entity_io&&) = delete;
 
 public:
 
@@ -90,10 +261,17 @@ public:
 
   socket_type& get_socket() noexcept { return m_socket; }
 
+  // UDP entities are not in a registry
+  io_handler_id get_handler_id() const noexcept { return io_handler_id(); }
+
   output_queue_stats get_output_queue_stats() const noexcept {
     return m_io_common.get_output_queue_stats();
   }
 
+  output_queue_stats get_output_queue_stats(send_priority pri) const noexcept {
+    return m_io_common.get_output_queue_stats(pri);
+  }
+
   template <typename F1, typename F2>
   bool start(F1&& io_state_chg, F2&& err_cb) {
     if (!m_entity_common.start(std::forward<F1>(io_state_chg), std::forward<F2>(err_cb))) {
@@ -102,12 +280,24 @@ public:
     }
     try {
       // assume default constructed endpoints compare equal
-      if (m_local_endp == endpoint_type()) {
+      if (m_mcast_groups) {
+        open_multicast();
+      }
+      else if (m_local_endp == endpoint_type()) {
+        if constexpr (is_udp) {
 // TODO: this needs to be changed, doesn't allow sending to an ipV6 endpoint
-        m_socket.open(std::experimental::net::ip::udp::v4());
+          m_socket.open(std::experimental::net::ip::udp::v4());
+        }
+        else { // an unbound local socket can send, but receives no replies
+          m_socket.open(m_local_endp.protocol());
+        }
+        apply_profile();
       }
       else {
-        m_socket = socket_type(m_socket.get_executor().context(), m_local_endp);
+        m_socket.open(m_local_endp.protocol());
+        apply_profile();
+        m_socket.bind(m_local_endp);
+        m_owns_file = is_local;
       }
     }
     catch (const std::system_error& se) {
@@ -115,7 +305,7 @@ public:
       stop();
       return false;
     }
-    m_entity_common.call_io_state_chg_cb(shared_from_this(), 1, true);
+    m_entity_common.call_io_state_chg_cb(this->shared_from_this(), 1, true);
     return true;
   }
 
@@ -125,6 +315,8 @@ public:
       return false;
     }
     m_max_size = max_size;
+    apply_segmentation_offload();
+    apply_receive_timestamps();
     start_read(std::forward<MH>(msg_handler));
     return true;
   }
@@ -136,6 +328,8 @@ public:
     }
     m_max_size = max_size;
     m_default_dest_endp = endp;
+    apply_segmentation_offload();
+    apply_receive_timestamps();
     start_read(std::forward<MH>(msg_handler));
     return true;
   }
@@ -144,6 +338,7 @@ public:
     if (!m_io_common.set_io_started()) { // concurrency protected
       return false;
     }
+    apply_segmentation_offload();
     return true;
   }
 
@@ -152,6 +347,7 @@ public:
       return false;
     }
     m_default_dest_endp = endp;
+    apply_segmentation_offload();
     return true;
   }
 
@@ -159,10 +355,19 @@ public:
     if (!m_io_common.stop()) {
       return false;
     }
+    m_read_idle.stop();
+    m_write_idle.stop();
     std::error_code ec;
     m_socket.close(ec);
+    if (m_owns_file) {
+      m_owns_file = false;
+      remove_socket_file();
+    }
+#ifdef IORING_RECV_MULTISHOT
+    m_uring_wait.close(ec); // the ring itself is released in the read handler
+#endif
     err_notify(std::make_error_code(net_ip_errc::udp_io_handler_stopped));
-    m_entity_common.call_io_state_chg_cb(shared_from_this(), 0, false);
+    m_entity_common.call_io_state_chg_cb(this->shared_from_this(), 0, false);
     return true;
   }
 
@@ -175,52 +380,450 @@ public:
     return true;
   }
 
-  void send(chops::const_shared_buffer buf) {
-    auto self { shared_from_this() };
-    post(m_socket.get_executor(), [this, self, buf] {
-        if (!m_io_common.start_write_setup(buf)) {
-          return; // buf queued or shutdown happening
+  // bufs are queued directly (lock-free), a handler is posted only when the writer is idle
+  void send(chops::const_shared_buffer buf, send_priority pri = send_priority::normal) {
+    post_after_enqueue(m_io_common.enqueue_element(std::move(buf), pri));
+  }
+
+  void send(chops::const_shared_buffer buf, const endpoint_type& endp,
+            send_priority pri = send_priority::normal) {
+    post_after_enqueue(m_io_common.enqueue_element(std::move(buf), endp, pri));
+  }
+
+  // used for the next buffer taken from the output queue
+  void set_send_lane_policy(const send_lane_policy& pol) noexcept {
+    m_io_common.set_send_lane_policy(pol);
+  }
+
+  // the timers are (re)started within the strand, a timeout of 0 stops a timer
+  void set_idle_timeouts(const idle_timeouts& to) {
+    auto self { this->shared_from_this() };
+    post(m_strand, [this, self, to] {
+        m_heartbeat = to.heartbeat;
+        std::weak_ptr<basic_datagram_entity_io> wp = self;
+        auto& ioc = m_socket.get_executor().context();
+        m_read_idle.start(ioc, to.read_timeout, [wp] {
+            if (auto p = wp.lock()) {
+              p->post_idle_expired(true);
+            }
+          }
+        );
+        m_write_idle.start(ioc, to.write_timeout, [wp] {
+            if (auto p = wp.lock()) {
+              p->post_idle_expired(false);
+            }
+          }
+        );
+      }
+    );
+  }
+
+  // limits are used for the next send, the queue event function object is set within
+  // the strand
+  template <typename F>
+  void set_output_queue_limits(const output_queue_limits& lim, F&& func) {
+    m_io_common.set_output_queue_limits(lim);
+    auto self { this->shared_from_this() };
+    post(m_strand, [this, self, f = queue_event_cb(std::forward<F>(func))] () mutable {
+        m_queue_event_cb = std::move(f);
+      }
+    );
+  }
+
+  bool is_output_congested() const noexcept { return m_io_common.is_output_congested(); }
+
+  // the multicast methods are ignored if this is not a multicast entity; a group can
+  // be joined or left before or after the entity is started
+  void join_group(const address& addr) {
+    auto self { this->shared_from_this() };
+    post(m_strand, [this, self, addr] {
+        if (m_mcast_groups && m_mcast_groups->add(addr) && m_socket.is_open()) {
+          std::error_code ec;
+          set_group_membership(addr, true, ec);
+          if (ec) {
+            err_notify(ec);
+          }
         }
-        start_write(buf, m_default_dest_endp);
       }
     );
   }
 
-  void send(chops::const_shared_buffer buf, const endpoint_type& endp) {
-    auto self { shared_from_this() };
-    post(m_socket.get_executor(), [this, self, buf, endp] {
-        if (!m_io_common.start_write_setup(buf, endp)) {
-          return; // buf queued or shutdown happening
+  void leave_group(const address& addr) {
+    auto self { this->shared_from_this() };
+    post(m_strand, [this, self, addr] {
+        if (m_mcast_groups && m_mcast_groups->remove(addr) && m_socket.is_open()) {
+          std::error_code ec;
+          set_group_membership(addr, false, ec);
+          if (ec) {
+            err_notify(ec);
+          }
         }
-        start_write(buf, endp);
       }
     );
   }
 
+  multicast_stats get_multicast_stats() const {
+    return m_mcast_groups ? m_mcast_groups->get_stats() : multicast_stats { };
+  }
+
+  // a max_bufs value of 0 or 1 disables batching, which is the default; a max_bytes 
+  // value of 0 means no byte limit
+  void set_write_batch_limits(std::size_t max_bufs, std::size_t max_bytes) {
+    auto self { this->shared_from_this() };
+    post(m_strand, [this, self, max_bufs, max_bytes] {
+        m_max_write_batch = (max_bufs == 0) ? 1 : max_bufs;
+        m_max_write_batch_bytes = (max_bytes == 0) ? std::numeric_limits<std::size_t>::max() : max_bytes;
+      }
+    );
+  }
+
+  // a value of 0 or 1 disables batching, which is the default
+  void set_read_batch_size(std::size_t max_msgs) {
+    auto self { this->shared_from_this() };
+    post(m_strand, [this, self, max_msgs] {
+        m_max_read_batch = (max_msgs == 0) ? 1 : max_msgs;
+      }
+    );
+  }
+
+  // applied within the strand, from the next read on
+  void set_read_buffer_policy(const read_buffer_policy& pol) {
+    auto self { this->shared_from_this() };
+    post(m_strand, [this, self, pol] { m_rb_policy = pol; } );
+  }
+
+  // a value of 0 disables io_uring reads, which is the default
+  void set_io_uring_read(std::size_t num_bufs) noexcept {
+    m_uring_bufs = num_bufs;
+  }
+
+  // a max_segs value of 0 or 1 disables send offload, which is the default; UDP on 
+  // Linux only, ignored otherwise; the setting is kept across a stop and start, and a 
+  // read already started uses the previous receive offload setting
+  void set_segmentation_offload(std::size_t max_segs, bool gro) {
+    m_gso_req = max_segs;
+    m_gro_req = gro;
+    if (!m_io_common.is_io_started()) {
+      return; // applied by start_io
+    }
+    auto self { this->shared_from_this() };
+    post(m_strand, [this, self] { apply_segmentation_offload(); } );
+  }
+
+  // Linux only, ignored otherwise; the setting is kept across a stop and start
+  void set_receive_timestamps(bool on) {
+    m_rx_ts_req = on;
+    if (!m_io_common.is_io_started()) {
+      return; // applied by start_io
+    }
+    auto self { this->shared_from_this() };
+    post(m_strand, [this, self] { apply_receive_timestamps(); } );
+  }
+
 private:
 
+  // called by start_io before the first read or write, or within the strand
+  void apply_segmentation_offload() {
+#if defined(__linux__) && defined(UDP_SEGMENT) && defined(UDP_GRO)
+    if constexpr (is_udp) {
+      m_gso_segs = std::min(m_gso_req.load(), gso_max_segs);
+      bool gro = m_gro_req;
+      if (!gro && !m_gro) {
+        return;
+      }
+      std::error_code ec;
+      m_socket.set_option(udp_gro(gro), ec);
+      m_gro = gro && !ec;
+      if (ec) {
+        err_notify(ec);
+      }
+    }
+#endif
+  }
+
+  // called by start_io before the first read, or within the strand
+  void apply_receive_timestamps() {
+#if defined(__linux__) && defined(SO_TIMESTAMPING)
+    bool on = m_rx_ts_req;
+    if (!on && !m_rx_ts) {
+      return;
+    }
+    std::error_code ec;
+    m_socket.set_option(timestamping(on ? receive_timestamping_flags : 0), ec);
+    m_rx_ts = on && !ec;
+    m_rx_stamp = receive_timestamp { };
+    if (ec) {
+      err_notify(ec);
+    }
+#endif
+  }
+
   template <typename MH>
   void start_read(MH&& msg_hdlr) {
-    auto self { shared_from_this() };
+#ifdef IORING_RECV_MULTISHOT
+    // multicast reads need the destination address control message, not available
+    // through the io_uring read path (nor are the offload or timestamp control messages);
+    // the ring name area is sized for IP endpoints
+    if constexpr (is_udp) {
+      if (m_uring_bufs > 0 && !m_mcast_groups && !m_gro && !m_rx_ts && 
+          start_read_uring(msg_hdlr)) {
+        return;
+      }
+    }
+#endif
+#ifdef __linux__
+    // multicast, receive offload and timestamp reads always use recvmmsg, for the 
+    // control messages
+    if (m_max_read_batch > 1 || m_mcast_groups || m_gro || m_rx_ts) {
+      start_read_batch(std::forward<MH>(msg_hdlr));
+      return;
+    }
+#endif
+    if (m_rb_policy.shrink_size != 0 && m_max_size > m_rb_policy.shrink_size) {
+      start_read_when_ready(std::forward<MH>(msg_hdlr));
+      return;
+    }
+    auto self { this->shared_from_this() };
     m_byte_vec.resize(m_max_size);
+    m_io_common.read_buffer_changed(m_byte_vec.capacity());
     m_socket.async_receive_from(
               std::experimental::net::mutable_buffer(m_byte_vec.data(), m_byte_vec.size()),
               m_sender_endp,
+      std::experimental::net::bind_executor(m_strand, make_alloc_handler(m_read_mem,
                 [this, self, mh = std::move(msg_hdlr)] 
                   (const std::error_code& err, std::size_t nb) mutable {
-        handle_read(err, nb, mh);
+          handle_read(err, nb, mh);
+        }
+      ))
+    );
+  }
+
+  // wait for a datagram without a read buffer, then receive it into a max size buffer
+  // (from the policy acquire function object, if any) which is released after the
+  // message handler returns
+  template <typename MH>
+  void start_read_when_ready(MH&& msg_hdlr) {
+    if (m_byte_vec.capacity() != 0) {
+      byte_vec bv { };
+      bv.swap(m_byte_vec);
+      if (m_rb_policy.release) {
+        m_rb_policy.release(std::move(bv));
       }
+    }
+    m_io_common.read_buffer_changed(0u);
+    auto self { this->shared_from_this() };
+    m_socket.async_wait(socket_type::wait_read,
+      std::experimental::net::bind_executor(m_strand, make_alloc_handler(m_read_mem,
+                [this, self, mh = std::move(msg_hdlr)] (const std::error_code& err) mutable {
+          if (err) {
+            handle_read(err, 0, mh);
+            return;
+          }
+          if (m_rb_policy.acquire) {
+            m_byte_vec = m_rb_policy.acquire(m_max_size);
+          }
+          m_byte_vec.resize(m_max_size);
+          m_io_common.read_buffer_changed(m_byte_vec.capacity());
+          std::error_code ec;
+          m_socket.non_blocking(true, ec);
+          std::size_t nb = m_socket.receive_from(
+                  std::experimental::net::mutable_buffer(m_byte_vec.data(), m_byte_vec.size()),
+                  m_sender_endp, ec);
+          if (ec == std::errc::operation_would_block || 
+              ec == std::errc::resource_unavailable_try_again) {
+            start_read(mh); // spurious wakeup
+            return;
+          }
+          handle_read(ec, nb, mh);
+        }
+      ))
     );
   }
 
+  void open_multicast();
+
+  void remove_socket_file() noexcept {
+    if constexpr (is_local) {
+      if (!m_local_endp.is_abstract() && !m_local_endp.path().empty()) {
+        ::unlink(m_local_endp.path().c_str());
+      }
+    }
+  }
+
+  // a socket option failure is reported but is not fatal
+  void apply_profile() {
+    std::error_code ec;
+    apply_socket_profile(m_socket, m_sock_prof, ec);
+    if (ec) {
+      err_notify(ec);
+    }
+  }
+
+  void set_group_membership(const address&, bool, std::error_code&);
+
   void err_notify (const std::error_code& err) {
-    m_entity_common.call_error_cb(shared_from_this(), err);
+    m_entity_common.call_error_cb(this->shared_from_this(), err);
   }
 
   template <typename MH>
   void handle_read(const std::error_code&, std::size_t, MH&&);
 
-  void start_write(chops::const_shared_buffer, const endpoint_type&);
+  // a moved read buffer keeps its (max size) capacity, so a datagram using less than 
+  // half of the read buffer is copied into a right sized shared buffer instead, and the 
+  // read buffer is reused (held or queued messages do not each pin a max size buffer)
+  template <typename MH>
+  bool invoke_msg_hdlr(MH& msg_hdlr, byte_vec& bv, std::size_t num_bytes) {
+    m_io_common.msg_received(num_bytes);
+    event_timer timer;
+    timer.start();
+    bool ret = false;
+    if constexpr (msg_hdlr_takes_shared_buffer<MH, basic_datagram_entity_io>) {
+      if (num_bytes < bv.capacity() / 2u) {
+        ret = call_msg_hdlr(msg_hdlr, chops::const_shared_buffer(bv.data(), num_bytes),
+                            *this, m_sender_endp, m_rx_stamp);
+      }
+      else {
+        bv.resize(num_bytes); // rest of the read buffer is not part of the datagram
+        ret = call_msg_hdlr(msg_hdlr, move_to_shared_buffer(bv, num_bytes),
+                            *this, m_sender_endp, m_rx_stamp);
+      }
+    }
+    else {
+      ret = call_msg_hdlr(msg_hdlr, std::experimental::net::const_buffer(bv.data(), num_bytes), 
+                          *this, m_sender_endp, m_rx_stamp);
+    }
+    instrument(io_event::handler_invoked, num_bytes, timer);
+    return ret;
+  }
+
+  // the datagram is in a buffer owned by the io_uring read path, and is copied if the 
+  // message handler takes a shared buffer
+  template <typename MH>
+  bool invoke_msg_hdlr(MH& msg_hdlr, const std::byte* data, std::size_t num_bytes) {
+    m_io_common.msg_received(num_bytes);
+    event_timer timer;
+    timer.start();
+    bool ret = false;
+    if constexpr (msg_hdlr_takes_shared_buffer<MH, basic_datagram_entity_io>) {
+      ret = call_msg_hdlr(msg_hdlr, chops::const_shared_buffer(data, num_bytes),
+                          *this, m_sender_endp, m_rx_stamp);
+    }
+    else {
+      ret = call_msg_hdlr(msg_hdlr, std::experimental::net::const_buffer(data, num_bytes), 
+                          *this, m_sender_endp, m_rx_stamp);
+    }
+    instrument(io_event::handler_invoked, num_bytes, timer);
+    return ret;
+  }
+
+#ifdef __linux__
+  // the socket is waited on for readability, then all available datagrams (up to the
+  // batch size) are received with one recvmmsg call and delivered in order
+  template <typename MH>
+  void start_read_batch(MH&& msg_hdlr) {
+    auto self { this->shared_from_this() };
+    m_socket.async_wait(socket_type::wait_read,
+      std::experimental::net::bind_executor(m_strand, make_alloc_handler(m_read_mem,
+                [this, self, mh = std::move(msg_hdlr)] (const std::error_code& err) mutable {
+          handle_read_batch(err, mh);
+        }
+      ))
+    );
+  }
+
+  template <typename MH>
+  void handle_read_batch(const std::error_code&, MH&&);
+
+  void setup_read_batch();
+
+#ifdef IORING_RECV_MULTISHOT
+  // false if the ring cannot be set up (e.g. an older kernel), the error is reported and
+  // the reactor read path is used
+  template <typename MH>
+  bool start_read_uring(MH&);
+
+  // the ring is waited on for completions, each one holds a datagram, and the message 
+  // handler is called without any read system calls
+  template <typename MH>
+  void wait_read_uring(MH&& msg_hdlr) {
+    auto self { this->shared_from_this() };
+    m_uring_wait.async_wait(socket_type::wait_read,
+      std::experimental::net::bind_executor(m_strand, make_alloc_handler(m_read_mem,
+                [this, self, mh = std::move(msg_hdlr)] (const std::error_code& err) mutable {
+          handle_read_uring(err, mh);
+        }
+      ))
+    );
+  }
+
+  template <typename MH>
+  void handle_read_uring(const std::error_code&, MH&&);
+#endif
+
+  void count_multicast(const ::msghdr&, std::size_t);
+
+  // 0 if the datagram was not coalesced by receive offload
+  std::size_t gro_segment_size(const ::msghdr&) const;
+
+  template <typename MH>
+  bool deliver_datagram(MH&, std::size_t);
+
+  endpoint_type& write_dest(std::size_t idx) {
+    return m_write_elems[idx].second ? *(m_write_elems[idx].second) : m_default_dest_endp;
+  }
+
+  std::size_t gso_group_size(std::size_t);
+
+  void setup_write_batch();
+
+  void setup_write_hdrs(std::size_t);
+
+  void write_batch();
+
+  void wait_write_batch();
+#endif
+
+  void start_write(const chops::const_shared_buffer&, const endpoint_type&);
+
+  // called from the timer wheel, the expiration is reported within the strand and the 
+  // entity keeps running; a heartbeat needs a default destination endpoint
+  void post_idle_expired(bool read) {
+    auto self { this->shared_from_this() };
+    post(m_strand, [this, self, read] {
+        if (!is_io_started()) {
+          return;
+        }
+        if (!read && m_heartbeat && m_default_dest_endp != endpoint_type()) {
+          send(*m_heartbeat, m_default_dest_endp);
+          return;
+        }
+        err_notify(std::make_error_code(read ? net_ip_errc::read_idle_timeout : 
+                                               net_ip_errc::write_idle_timeout));
+      }
+    );
+  }
+
+  // overflow or watermark processing may be needed even if the writer is busy
+  void post_after_enqueue(bool claimed) {
+    m_write_idle.touch();
+    if (claimed) {
+      post_write_from_queue();
+    }
+    else if (m_io_common.claim_queue_events()) {
+      auto self { this->shared_from_this() };
+      post(m_strand, [this, self] { handle_queue_events(); } );
+    }
+  }
+
+  bool handle_queue_events();
+
+  // only called by the thread that claimed the writer, or within the write chain
+  void post_write_from_queue() {
+    auto self { this->shared_from_this() };
+    post(m_strand, make_alloc_handler(m_write_mem, [this, self] { start_write_from_queue(); } ));
+  }
+
+  void start_write_from_queue();
 
   void handle_write(const std::error_code&, std::size_t);
 
@@ -228,16 +831,21 @@ private:
 
 // method implementations, just to make the class declaration a little more readable
 
+template <typename Protocol>
 template <typename MH>
-void udp_entity_io::handle_read(const std::error_code& err, std::size_t num_bytes, MH&& msg_hdlr) {
+void basic_datagram_entity_io<Protocol>::handle_read(const std::error_code& err, std::size_t num_bytes, MH&& msg_hdlr) {
 
   if (err) {
     err_notify(err);
     stop();
     return;
   }
-  if (!msg_hdlr(std::experimental::net::const_buffer(m_byte_vec.data(), num_bytes), 
-                basic_io_interface<udp_entity_io>(weak_from_this()), m_sender_endp)) {
+  m_read_idle.touch();
+  instrument(io_event::read_completed, num_bytes);
+  if (m_mcast_groups) {
+    m_mcast_groups->count_unmatched(); // no destination address available
+  }
+  if (!invoke_msg_hdlr(msg_hdlr, m_byte_vec, num_bytes)) {
     // message handler not happy, tear everything down
     err_notify(std::make_error_code(net_ip_errc::message_handler_terminated));
     stop();
@@ -246,30 +854,521 @@ void udp_entity_io::handle_read(const std::error_code& err, std::size_t num_byte
   start_read(std::forward<MH>(msg_hdlr));
 }
 
-inline void udp_entity_io::start_write(chops::const_shared_buffer buf, const endpoint_type& endp) {
-  auto self { shared_from_this() };
+#ifdef __linux__
+
+template <typename Protocol>
+template <typename MH>
+void basic_datagram_entity_io<Protocol>::handle_read_batch(const std::error_code& err, MH&& msg_hdlr) {
+
+  if (err) {
+    err_notify(err);
+    stop();
+    return;
+  }
+  setup_read_batch();
+  int num = ::recvmmsg(m_socket.native_handle(), m_read_hdrs.data(), 
+                       static_cast<unsigned int>(m_read_hdrs.size()), MSG_DONTWAIT, nullptr);
+  if (num < 0) {
+    int e = errno;
+    if (e != EAGAIN && e != EWOULDBLOCK && e != EINTR) {
+      err_notify(std::error_code(e, std::system_category()));
+      stop();
+      return;
+    }
+    num = 0; // spurious wakeup, wait again
+  }
+  if (num > 0) {
+    m_read_idle.touch();
+  }
+  if constexpr (io_instrumentation::enabled) {
+    std::size_t batch_bytes = 0;
+    for (int i = 0; i < num; ++i) {
+      batch_bytes += m_read_hdrs[i].msg_len;
+    }
+    instrument(io_event::read_completed, batch_bytes);
+  }
+  for (int i = 0; i < num; ++i) {
+    m_read_endps[i].resize(m_read_hdrs[i].msg_hdr.msg_namelen);
+    m_sender_endp = m_read_endps[i];
+    if (!deliver_datagram(msg_hdlr, static_cast<std::size_t>(i))) {
+      // message handler not happy, tear everything down
+      err_notify(std::make_error_code(net_ip_errc::message_handler_terminated));
+      stop();
+      return;
+    }
+  }
+  start_read(std::forward<MH>(msg_hdlr));
+}
+
+// a read coalesced by receive offload is split into its datagrams, each the segment
+// size except for a shorter last one (all with the timestamps of the coalesced read)
+template <typename Protocol>
+template <typename MH>
+bool basic_datagram_entity_io<Protocol>::deliver_datagram(MH& msg_hdlr, std::size_t idx) {
+  const auto& hdr = m_read_hdrs[idx];
+  std::size_t len = hdr.msg_len;
+#ifdef SO_TIMESTAMPING
+  if (m_rx_ts) {
+    m_rx_stamp = receive_timestamp { };
+    read_receive_timestamp(hdr.msg_hdr, m_rx_stamp);
+  }
+#endif
+  std::size_t seg = m_gro ? gro_segment_size(hdr.msg_hdr) : 0u;
+  if (seg == 0u || seg >= len) {
+    if (m_mcast_groups) {
+      count_multicast(hdr.msg_hdr, len);
+    }
+    return invoke_msg_hdlr(msg_hdlr, m_read_bufs[idx], len);
+  }
+  for (std::size_t off = 0u; off < len; off += seg) {
+    std::size_t sz = std::min(seg, len - off);
+    if (m_mcast_groups) {
+      count_multicast(hdr.msg_hdr, sz);
+    }
+    if (!invoke_msg_hdlr(msg_hdlr, m_read_bufs[idx].data() + off, sz)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+#ifdef IORING_RECV_MULTISHOT
+
+template <typename Protocol>
+template <typename MH>
+bool basic_datagram_entity_io<Protocol>::start_read_uring(MH& msg_hdlr) {
+  std::error_code ec;
+  try {
+    m_uring = std::make_unique<uring_multishot_recv>(m_socket.native_handle(), 
+                                                     m_uring_bufs, m_max_size);
+    int fd = ::dup(m_uring->ring_fd());
+    if (fd < 0) {
+      throw std::system_error(std::error_code(errno, std::system_category()));
+    }
+    m_uring_wait = socket_type(m_uring_wait.get_executor().context());
+    m_uring_wait.assign(m_local_endp.protocol(), fd, ec);
+    if (ec) {
+      ::close(fd);
+    }
+    else {
+      ec = m_uring->arm();
+    }
+  }
+  catch (const std::system_error& se) {
+    ec = se.code();
+  }
+  if (ec) {
+    std::error_code close_ec;
+    m_uring_wait.close(close_ec);
+    m_uring.reset();
+    m_uring_bufs = 0;
+    err_notify(ec);
+    return false;
+  }
+  wait_read_uring(std::move(msg_hdlr));
+  return true;
+}
+
+template <typename Protocol>
+template <typename MH>
+void basic_datagram_entity_io<Protocol>::handle_read_uring(const std::error_code& err, MH&& msg_hdlr) {
+
+  if (err) {
+    m_uring.reset(); // releases the socket registered with the ring
+    err_notify(err);
+    stop();
+    return;
+  }
+  std::error_code ec;
+  bool ok = true;
+  // completions arriving while draining are processed before waiting again
+  do {
+    ok = m_uring->drain([this, &msg_hdlr] (const std::byte* data, std::size_t num_bytes,
+                                           const void* name, std::size_t name_size) {
+        std::memcpy(m_sender_endp.data(), name, name_size);
+        m_sender_endp.resize(name_size);
+        m_read_idle.touch();
+        instrument(io_event::read_completed, num_bytes);
+        return invoke_msg_hdlr(msg_hdlr, data, num_bytes);
+      }, ec);
+  } while (ok && !ec && m_uring->has_completions());
+  if (!ok) {
+    // message handler not happy, tear everything down
+    m_uring.reset();
+    err_notify(std::make_error_code(net_ip_errc::message_handler_terminated));
+    stop();
+    return;
+  }
+  if (ec) {
+    m_uring.reset();
+    err_notify(ec);
+    stop();
+    return;
+  }
+  wait_read_uring(std::forward<MH>(msg_hdlr));
+}
+
+#endif
+
+// buffers moved into shared buffers for the message handler are re-allocated here
+template <typename Protocol>
+void basic_datagram_entity_io<Protocol>::setup_read_batch() {
+  // a coalesced read can be larger than the max size of a datagram
+  std::size_t read_size = m_gro ? std::max(m_max_size, gro_read_size) : m_max_size;
+  bool ctrl = m_mcast_groups || m_gro || m_rx_ts;
+  m_read_bufs.resize(m_max_read_batch);
+  m_read_endps.resize(m_max_read_batch);
+  m_read_iovs.resize(m_max_read_batch);
+  m_read_hdrs.resize(m_max_read_batch);
+  if (ctrl) {
+    m_read_ctrls.resize(m_max_read_batch);
+  }
+  m_io_common.read_buffer_changed(m_max_read_batch * read_size);
+  for (std::size_t i = 0; i < m_max_read_batch; ++i) {
+    m_read_bufs[i].resize(read_size);
+    m_read_iovs[i] = ::iovec { m_read_bufs[i].data(), m_read_bufs[i].size() };
+    m_read_hdrs[i] = ::mmsghdr { };
+    m_read_hdrs[i].msg_hdr.msg_name = m_read_endps[i].data();
+    m_read_hdrs[i].msg_hdr.msg_namelen = static_cast<socklen_t>(m_read_endps[i].capacity());
+    m_read_hdrs[i].msg_hdr.msg_iov = &m_read_iovs[i];
+    m_read_hdrs[i].msg_hdr.msg_iovlen = 1;
+    if (ctrl) {
+      m_read_hdrs[i].msg_hdr.msg_control = m_read_ctrls[i].m_data;
+      m_read_hdrs[i].msg_hdr.msg_controllen = sizeof(m_read_ctrls[i].m_data);
+    }
+  }
+}
+
+// the destination address of a multicast datagram is the group address
+template <typename Protocol>
+void basic_datagram_entity_io<Protocol>::count_multicast(const ::msghdr& hdr, std::size_t num_bytes) {
+  bool found = false;
+  for (auto* c = CMSG_FIRSTHDR(&hdr); c; c = CMSG_NXTHDR(const_cast<::msghdr*>(&hdr), c)) {
+    if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SO_RXQ_OVFL) {
+      std::uint32_t num_dropped;
+      std::memcpy(&num_dropped, CMSG_DATA(c), sizeof(num_dropped));
+      m_mcast_groups->set_dropped(num_dropped);
+    }
+    else if (c->cmsg_level == IPPROTO_IP && c->cmsg_type == IP_PKTINFO) {
+      ::in_pktinfo pi;
+      std::memcpy(&pi, CMSG_DATA(c), sizeof(pi));
+      m_mcast_groups->count(std::experimental::net::ip::address_v4(ntohl(pi.ipi_addr.s_addr)), 
+                            num_bytes);
+      found = true;
+    }
+    else if (c->cmsg_level == IPPROTO_IPV6 && c->cmsg_type == IPV6_PKTINFO) {
+      ::in6_pktinfo pi;
+      std::memcpy(&pi, CMSG_DATA(c), sizeof(pi));
+      std::experimental::net::ip::address_v6::bytes_type b;
+      std::memcpy(b.data(), pi.ipi6_addr.s6_addr, b.size());
+      m_mcast_groups->count(std::experimental::net::ip::address_v6(b), num_bytes);
+      found = true;
+    }
+  }
+  if (!found) {
+    m_mcast_groups->count_unmatched();
+  }
+}
+
+template <typename Protocol>
+std::size_t basic_datagram_entity_io<Protocol>::gro_segment_size(const ::msghdr& hdr) const {
+#ifdef UDP_GRO
+  for (auto* c = CMSG_FIRSTHDR(&hdr); c; c = CMSG_NXTHDR(const_cast<::msghdr*>(&hdr), c)) {
+    if (c->cmsg_level == SOL_UDP && c->cmsg_type == UDP_GRO) {
+      int seg = 0;
+      std::memcpy(&seg, CMSG_DATA(c), sizeof(seg));
+      return seg > 0 ? static_cast<std::size_t>(seg) : 0u;
+    }
+  }
+#endif
+  return 0u;
+}
+
+// number of elements, starting at idx, sent as one send offload buffer: the same 
+// destination and segment size (a shorter segment ends the buffer), within the kernel
+// limits
+template <typename Protocol>
+std::size_t basic_datagram_entity_io<Protocol>::gso_group_size(std::size_t idx) {
+  std::size_t seg = m_write_elems[idx].first.size();
+  if (m_gso_segs < 2u || seg == 0u) {
+    return 1u;
+  }
+  const auto& endp = write_dest(idx);
+  std::size_t cnt = 1u;
+  std::size_t total = seg;
+  while (idx + cnt < m_write_elems.size() && cnt < m_gso_segs) {
+    std::size_t sz = m_write_elems[idx + cnt].first.size();
+    if (sz == 0u || sz > seg || total + sz > gso_max_bytes || write_dest(idx + cnt) != endp) {
+      break;
+    }
+    ++cnt;
+    total += sz;
+    if (sz < seg) {
+      break;
+    }
+  }
+  return cnt;
+}
+
+template <typename Protocol>
+void basic_datagram_entity_io<Protocol>::setup_write_batch() {
+  auto num = m_write_elems.size();
+  m_write_iovs.resize(num);
+  for (std::size_t i = 0; i < num; ++i) {
+    const auto& buf = m_write_elems[i].first;
+    m_write_iovs[i] = ::iovec { const_cast<std::byte*>(buf.data()), buf.size() };
+  }
+  setup_write_hdrs(0u);
+  m_write_timer.start();
+}
+
+// one header per datagram, or per group of datagrams with send offload, starting at 
+// element first
+template <typename Protocol>
+void basic_datagram_entity_io<Protocol>::setup_write_hdrs(std::size_t first) {
+  auto num = m_write_elems.size();
+  m_write_hdrs.clear();
+  m_write_firsts.clear();
+  m_write_ctrls.resize(num);
+  std::size_t i = first;
+  while (i < num) {
+    std::size_t cnt = gso_group_size(i);
+    auto& endp = write_dest(i);
+    ::mmsghdr h { };
+    h.msg_hdr.msg_name = endp.data();
+    h.msg_hdr.msg_namelen = static_cast<socklen_t>(endp.size());
+    h.msg_hdr.msg_iov = &m_write_iovs[i];
+    h.msg_hdr.msg_iovlen = cnt;
+#ifdef UDP_SEGMENT
+    if (cnt > 1u) {
+      auto& ctrl = m_write_ctrls[m_write_hdrs.size()];
+      h.msg_hdr.msg_control = ctrl.m_data;
+      h.msg_hdr.msg_controllen = sizeof(ctrl.m_data);
+      auto* c = CMSG_FIRSTHDR(&h.msg_hdr);
+      c->cmsg_level = SOL_UDP;
+      c->cmsg_type = UDP_SEGMENT;
+      c->cmsg_len = CMSG_LEN(sizeof(std::uint16_t));
+      auto seg = static_cast<std::uint16_t>(m_write_iovs[i].iov_len);
+      std::memcpy(CMSG_DATA(c), &seg, sizeof(seg));
+    }
+#endif
+    m_write_hdrs.push_back(h);
+    m_write_firsts.push_back(i);
+    i += cnt;
+  }
+  m_write_next = 0;
+}
+
+// sendmmsg can send fewer datagrams than requested, in which case the rest of the
+// batch is sent when the socket is writable again
+template <typename Protocol>
+void basic_datagram_entity_io<Protocol>::write_batch() {
+  while (m_write_next < m_write_hdrs.size()) {
+    int num = ::sendmmsg(m_socket.native_handle(), m_write_hdrs.data() + m_write_next,
+                         static_cast<unsigned int>(m_write_hdrs.size() - m_write_next), 
+                         MSG_DONTWAIT);
+    if (num < 0) {
+      int e = errno;
+      if (e == EINTR) {
+        continue;
+      }
+      if (e == EAGAIN || e == EWOULDBLOCK) {
+        wait_write_batch();
+        return;
+      }
+      if (m_write_hdrs[m_write_next].msg_hdr.msg_iovlen > 1u && e == EINVAL) {
+        // usually a segment too large for the route (e.g. over the path MTU), so send
+        // offload stays enabled and only the rest of this batch is sent as separate
+        // datagrams (a datagram that is still too large is reported below)
+        auto segs = m_gso_segs;
+        m_gso_segs = 0u;
+        setup_write_hdrs(m_write_firsts[m_write_next]);
+        m_gso_segs = segs;
+        continue;
+      }
+      if (m_write_hdrs[m_write_next].msg_hdr.msg_iovlen > 1u && 
+          (e == EIO || e == ENOPROTOOPT)) {
+        // send offload not supported by the kernel or device, reported and disabled, 
+        // and the rest of the batch is sent as separate datagrams
+        err_notify(std::error_code(e, std::system_category()));
+        m_gso_segs = 0u;
+        setup_write_hdrs(m_write_firsts[m_write_next]);
+        continue;
+      }
+      err_notify(std::error_code(e, std::system_category()));
+      stop();
+      return;
+    }
+    m_write_next += static_cast<std::size_t>(num);
+  }
+  if constexpr (io_instrumentation::enabled) {
+    std::size_t batch_bytes = 0;
+    for (const auto& iov : m_write_iovs) {
+      batch_bytes += iov.iov_len;
+    }
+    instrument(io_event::write_completed, batch_bytes, m_write_timer);
+  }
+  m_io_common.write_complete();
+  post_write_from_queue();
+}
+
+template <typename Protocol>
+void basic_datagram_entity_io<Protocol>::wait_write_batch() {
+  auto self { this->shared_from_this() };
+  m_socket.async_wait(socket_type::wait_write,
+    std::experimental::net::bind_executor(m_strand, make_alloc_handler(m_write_mem,
+            [this, self] (const std::error_code& err) {
+        if (err) {
+          err_notify(err);
+          stop();
+          return;
+        }
+        write_batch();
+      }
+    ))
+  );
+}
+
+#endif
+
+template <typename Protocol>
+void basic_datagram_entity_io<Protocol>::open_multicast() {
+  // multicast entities are only created for UDP
+  if constexpr (is_udp) {
+    namespace mc = std::experimental::net::ip::multicast;
+    bool v4 = (m_local_endp.protocol() == std::experimental::net::ip::udp::v4());
+    m_socket.open(m_local_endp.protocol());
+    m_socket.set_option(std::experimental::net::socket_base::reuse_address(
+                          m_mcast_opts.reuse_addr));
+    if (m_mcast_opts.receive_buffer_size > 0) {
+      m_socket.set_option(std::experimental::net::socket_base::receive_buffer_size(
+                            m_mcast_opts.receive_buffer_size));
+    }
+    m_socket.set_option(mc::enable_loopback(m_mcast_opts.loopback));
+    m_socket.set_option(mc::hops(m_mcast_opts.hops));
+    if (v4 && !m_mcast_opts.interface_addr.is_unspecified()) {
+      m_socket.set_option(mc::outbound_interface(m_mcast_opts.interface_addr));
+    }
+    if (!v4 && m_mcast_opts.interface_index != 0) {
+      m_socket.set_option(mc::outbound_interface(m_mcast_opts.interface_index));
+    }
+#ifdef __linux__
+    if (v4) {
+      m_socket.set_option(ipv4_recv_pktinfo(true));
+    }
+    else {
+      m_socket.set_option(ipv6_recv_pktinfo(true));
+    }
+    m_socket.set_option(recv_queue_overflow(true));
+#endif
+    apply_profile(); // after the multicast options, a profile buffer size takes precedence
+    m_socket.bind(m_local_endp);
+    for (const auto& addr : m_mcast_groups->addresses()) {
+      std::error_code ec;
+      set_group_membership(addr, true, ec);
+      if (ec) {
+        throw std::system_error(ec);
+      }
+    }
+  }
+}
+
+template <typename Protocol>
+void basic_datagram_entity_io<Protocol>::set_group_membership(const address& addr, bool join, 
+                                                std::error_code& ec) {
+  namespace mc = std::experimental::net::ip::multicast;
+  if (addr.is_v4()) {
+    if (join) {
+      m_socket.set_option(mc::join_group(addr.to_v4(), m_mcast_opts.interface_addr), ec);
+    }
+    else {
+      m_socket.set_option(mc::leave_group(addr.to_v4(), m_mcast_opts.interface_addr), ec);
+    }
+    return;
+  }
+  if (join) {
+    m_socket.set_option(mc::join_group(addr.to_v6(), m_mcast_opts.interface_index), ec);
+  }
+  else {
+    m_socket.set_option(mc::leave_group(addr.to_v6(), m_mcast_opts.interface_index), ec);
+  }
+}
+
+template <typename Protocol>
+void basic_datagram_entity_io<Protocol>::start_write(const chops::const_shared_buffer& buf, 
+                                       const endpoint_type& endp) {
+  auto self { this->shared_from_this() };
+  m_write_timer.start();
   m_socket.async_send_to(std::experimental::net::const_buffer(buf.data(), buf.size()), endp,
+    std::experimental::net::bind_executor(m_strand, make_alloc_handler(m_write_mem,
             [this, self] (const std::error_code& err, std::size_t nb) {
-      handle_write(err, nb);
-    }
+        handle_write(err, nb);
+      }
+    ))
   );
 }
 
-inline void udp_entity_io::handle_write(const std::error_code& err, std::size_t /* num_bytes */) {
+template <typename Protocol>
+void basic_datagram_entity_io<Protocol>::handle_write(const std::error_code& err, std::size_t num_bytes) {
+  m_write_elem.reset();
   if (err) {
     err_notify(err);
     stop();
     return;
   }
-  auto elem = m_io_common.get_next_element();
-  if (!elem) {
+  instrument(io_event::write_completed, num_bytes, m_write_timer);
+  m_io_common.write_complete();
+  start_write_from_queue();
+}
+
+// false if the entity is stopped by the disconnect overflow policy
+template <typename Protocol>
+bool basic_datagram_entity_io<Protocol>::handle_queue_events() {
+  if (m_io_common.process_queue_events([this] (std::error_code e) {
+        if (m_queue_event_cb) {
+          m_queue_event_cb(basic_io_interface<basic_datagram_entity_io>(this->weak_from_this()), e);
+        }
+      } )) {
+    return true;
+  }
+  err_notify(std::make_error_code(net_ip_errc::output_queue_overflow));
+  stop();
+  return false;
+}
+
+template <typename Protocol>
+void basic_datagram_entity_io<Protocol>::start_write_from_queue() {
+  if (!handle_queue_events()) {
+    return;
+  }
+#ifdef __linux__
+  // send offload needs queued datagrams, taken as a batch even if batching is disabled
+  if (m_max_write_batch > 1 || m_gso_segs > 1) {
+    m_write_elems.clear(); // release previous batch, if any
+    if (m_io_common.get_next_elements(m_write_elems, std::max(m_max_write_batch, m_gso_segs), 
+                                      m_max_write_batch > 1 ? m_max_write_batch_bytes : 
+                                        std::numeric_limits<std::size_t>::max()) == 0) {
+      return;
+    }
+    setup_write_batch();
+    write_batch();
     return;
   }
-  start_write(elem->first, elem->second ? *(elem->second) : m_default_dest_endp);
+#endif
+  m_write_elem = m_io_common.get_next_element();
+  if (!m_write_elem) {
+    return;
+  }
+  start_write(m_write_elem->first, 
+              m_write_elem->second ? *(m_write_elem->second) : m_default_dest_endp);
 }
 
+using udp_entity_io = basic_datagram_entity_io<std::experimental::net::ip::udp>;
 using udp_entity_io_ptr = std::shared_ptr<udp_entity_io>;
 
+using local_datagram_entity_io = basic_datagram_entity_io<chops::net::local::datagram_protocol>;
+using local_datagram_entity_io_ptr = std::shared_ptr<local_datagram_entity_io>;
+
 } // end detail namespace
 } // end net namespace
 } // end chops namespace
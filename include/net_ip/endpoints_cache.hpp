@@ -0,0 +1,343 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Shared name resolution cache, converting network host names and ports into
+ *  C++ Networking TS endpoint objects with one resolve per host and port for many users.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef ENDPOINTS_CACHE_HPP_INCLUDED
+#define ENDPOINTS_CACHE_HPP_INCLUDED
+
+#include <experimental/internet>
+#include <experimental/io_context>
+#include <experimental/executor>
+
+#include <string_view>
+#include <string>
+#include <vector>
+#include <map>
+#include <tuple>
+#include <memory> // std::shared_ptr, std::make_shared, std::enable_shared_from_this
+#include <mutex>
+#include <functional> // std::function
+#include <chrono>
+#include <system_error>
+#include <cstddef> // std::size_t
+#include <utility> // std::move
+
+#include "net_ip/endpoints_resolver.hpp"
+
+namespace chops {
+namespace net {
+
+/**
+ *  @brief Name resolution cache, shared by the network entities of a @c net_ip object
+ *  (or by any application code needing resolved endpoints).
+ *
+ *  Entries are keyed by host (or interface) name, service (or port), and the "local"
+ *  (passive) flag. An entry is fresh for the time to live period after its resolve
+ *  completes, and stale afterwards. Name resolution through @c getaddrinfo does not
+ *  supply the DNS record time to live, so the period is set by the application
+ *  (default 60 seconds).
+ *
+ *  Asynchronous lookups for the same key are coalesced: while a resolve is in flight,
+ *  further lookups wait for the same resolve instead of starting another one. A lookup
+ *  of a stale entry is immediately answered with the stale endpoints, and a background
+ *  resolve refreshes the entry. A failed resolve does not replace an entry's endpoints,
+ *  and failures are not cached (the next lookup resolves again).
+ *
+ *  Function object callbacks are always posted to (or invoked within) the @c io_context
+ *  passed in to the constructor, never from within the calling function.
+ *
+ *  All methods are safe to call concurrently from multiple threads. An @c endpoints_cache
+ *  object must be managed by a @c std::shared_ptr, since outstanding resolves keep the
+ *  object alive.
+ *
+ */
+
+template <typename Protocol>
+class endpoints_cache : public std::enable_shared_from_this<endpoints_cache<Protocol> > {
+public:
+  using endpoint_type = typename Protocol::endpoint;
+  using endpoints = std::vector<endpoint_type>;
+  using endpoints_cb = std::function<void (std::error_code, endpoints)>;
+
+private:
+  using resolver_type = endpoints_resolver<Protocol>;
+  using resolver_results = std::experimental::net::ip::basic_resolver_results<Protocol>;
+  using clock_type = std::chrono::steady_clock;
+  using key_type = std::tuple<std::string, std::string, bool>;
+
+  struct entry {
+    endpoints                 m_endpoints;
+    clock_type::time_point    m_expiry;
+    clock_type::time_point    m_resolved;
+    bool                      m_resolving = false;
+    std::vector<endpoints_cb> m_waiters;
+  };
+
+private:
+  std::experimental::net::io_context&  m_ioc;
+  mutable std::mutex                   m_mutex;
+  std::map<key_type, entry>            m_entries;
+  std::chrono::milliseconds            m_ttl;
+  std::chrono::milliseconds            m_min_refresh;
+  std::size_t                          m_num_resolves;
+
+private:
+  using lg = std::lock_guard<std::mutex>;
+
+public:
+
+/**
+ *  @brief Construct with an @c io_context and a time to live period.
+ *
+ *  @param ioc @c std::experimental::net::io_context used for resolves and callbacks.
+ *
+ *  @param ttl Time period an entry is fresh after its resolve completes.
+ *
+ *  @param min_refresh Minimum time period between the completion of a resolve and a 
+ *  resolve started by @c refresh, so that many users refreshing the same entry (e.g. TCP 
+ *  connectors retrying after a network outage) do not repeatedly resolve.
+ */
+  explicit endpoints_cache(std::experimental::net::io_context& ioc,
+                           std::chrono::milliseconds ttl = std::chrono::seconds(60),
+                           std::chrono::milliseconds min_refresh = std::chrono::seconds(1)) :
+    m_ioc(ioc), m_mutex(), m_entries(), m_ttl(ttl), m_min_refresh(min_refresh), 
+    m_num_resolves(0u) { }
+
+private:
+  endpoints_cache(const endpoints_cache&) = delete;
+  endpoints_cache& operator=(const endpoints_cache&) = delete;
+
+public:
+
+/**
+ *  @brief Provide a sequence of endpoints through a function object callback, resolving
+ *  the name only if there is no cached entry.
+ *
+ *  This method always returns before the function object callback is invoked.
+ *
+ *  @param local If @c true, endpoints are for a local endpoint (the "passive" flag is set).
+ *
+ *  @param host_or_intf_name A host or interface name, as in @c endpoints_resolver.
+ *
+ *  @param service_or_port A service name or port number, as in @c endpoints_resolver.
+ *
+ *  @param func Function object which will be invoked with the endpoints. The signature
+ *  of the callback:
+ *
+ *  @code
+ *    void (std::error_code err, std::vector<Protocol::endpoint> endps);
+ *  @endcode
+ *
+ *  If an error occurs, the error code is set accordingly and the endpoint container is empty.
+ */
+  template <typename F>
+  void make_endpoints(bool local, std::string_view host_or_intf_name,
+                      std::string_view service_or_port, F&& func) {
+    key_type key(std::string(host_or_intf_name), std::string(service_or_port), local);
+    bool start = false;
+    {
+      lg g(m_mutex);
+      auto& ent = m_entries[key];
+      if (ent.m_endpoints.empty()) {
+        ent.m_waiters.push_back(endpoints_cb(std::forward<F>(func)));
+        start = claim_resolve(ent);
+      }
+      else {
+        if (clock_type::now() >= ent.m_expiry) {
+          start = claim_resolve(ent); // stale, answer now and refresh in the background
+        }
+        std::experimental::net::post(m_ioc,
+            [f = endpoints_cb(std::forward<F>(func)), endps = ent.m_endpoints] () mutable {
+          f(std::error_code(), std::move(endps));
+        } );
+      }
+    }
+    if (start) {
+      start_resolve(std::move(key));
+    }
+  }
+
+/**
+ *  @brief Return a sequence of endpoints immediately, performing a synchronous (blocking)
+ *  resolve if there is no fresh cached entry.
+ *
+ *  A blocking resolve is not coalesced with in flight asynchronous resolves.
+ *
+ *  @return @c std::vector of @c Protocol::endpoint objects, not empty.
+ *
+ *  @throw @c std::system_error on failure.
+ */
+  endpoints make_endpoints(bool local, std::string_view host_or_intf_name,
+                           std::string_view service_or_port) {
+    key_type key(std::string(host_or_intf_name), std::string(service_or_port), local);
+    {
+      lg g(m_mutex);
+      auto iter = m_entries.find(key);
+      if (iter != m_entries.end() && !iter->second.m_endpoints.empty() &&
+          clock_type::now() < iter->second.m_expiry) {
+        return iter->second.m_endpoints;
+      }
+      ++m_num_resolves;
+    }
+    resolver_type resolver(m_ioc);
+    auto endps = to_endpoints(resolver.make_endpoints(local, host_or_intf_name, service_or_port));
+    lg g(m_mutex);
+    auto& ent = m_entries[key];
+    ent.m_endpoints = endps;
+    ent.m_resolved = clock_type::now();
+    ent.m_expiry = ent.m_resolved + m_ttl;
+    return endps;
+  }
+
+/**
+ *  @brief Copy the cached endpoints, fresh or stale, without resolving or blocking.
+ *
+ *  @return @c true if there is a cached entry with endpoints, @c false otherwise (the
+ *  container is not modified).
+ */
+  bool cached_endpoints(bool local, std::string_view host_or_intf_name,
+                        std::string_view service_or_port, endpoints& endps) const {
+    lg g(m_mutex);
+    auto iter = m_entries.find(key_type(std::string(host_or_intf_name),
+                                        std::string(service_or_port), local));
+    if (iter == m_entries.end() || iter->second.m_endpoints.empty()) {
+      return false;
+    }
+    endps = iter->second.m_endpoints;
+    return true;
+  }
+
+/**
+ *  @brief Start a background resolve for an entry, unless one is already in flight or
+ *  the entry was resolved within the minimum refresh period.
+ *
+ *  This is typically called when the cached endpoints are suspect, for example after
+ *  connect failures. The cached endpoints (if any) are kept until the resolve succeeds.
+ */
+  void refresh(bool local, std::string_view host_or_intf_name,
+               std::string_view service_or_port) {
+    key_type key(std::string(host_or_intf_name), std::string(service_or_port), local);
+    {
+      lg g(m_mutex);
+      auto& ent = m_entries[key];
+      if (!ent.m_endpoints.empty() && clock_type::now() < ent.m_resolved + m_min_refresh) {
+        return;
+      }
+      if (!claim_resolve(ent)) {
+        return;
+      }
+    }
+    start_resolve(std::move(key));
+  }
+
+/**
+ *  @brief Remove all entries that do not have a resolve in flight.
+ */
+  void clear() {
+    lg g(m_mutex);
+    for (auto iter = m_entries.begin(); iter != m_entries.end(); ) {
+      iter = iter->second.m_resolving ? ++iter : m_entries.erase(iter);
+    }
+  }
+
+/**
+ *  @brief Set the time to live period, used for resolves completing after this call.
+ */
+  void set_time_to_live(std::chrono::milliseconds ttl) {
+    lg g(m_mutex);
+    m_ttl = ttl;
+  }
+
+/**
+ *  @brief Number of entries, including entries waiting on a first resolve.
+ */
+  std::size_t size() const {
+    lg g(m_mutex);
+    return m_entries.size();
+  }
+
+/**
+ *  @brief Number of resolves started (asynchronous and synchronous), for a cache
+ *  effectiveness measure.
+ */
+  std::size_t num_resolves() const {
+    lg g(m_mutex);
+    return m_num_resolves;
+  }
+
+private:
+
+  // lock must be held
+  bool claim_resolve(entry& ent) {
+    if (ent.m_resolving) {
+      return false;
+    }
+    ent.m_resolving = true;
+    ++m_num_resolves;
+    return true;
+  }
+
+  static endpoints to_endpoints(const resolver_results& res) {
+    endpoints endps;
+    for (const auto& e : res) {
+      endps.push_back(e.endpoint());
+    }
+    return endps;
+  }
+
+  void start_resolve(key_type key) {
+    auto resolver = std::make_shared<resolver_type>(m_ioc);
+    auto self = this->shared_from_this();
+    bool local = std::get<2>(key);
+    std::string host = std::get<0>(key);
+    std::string service = std::get<1>(key);
+    resolver->make_endpoints(local, host, service,
+      [self, resolver, k = std::move(key)] (std::error_code err, resolver_results res) mutable {
+        self->resolve_complete(k, err, to_endpoints(res));
+      }
+    );
+  }
+
+  void resolve_complete(const key_type& key, std::error_code err, endpoints endps) {
+    std::vector<endpoints_cb> waiters;
+    {
+      lg g(m_mutex);
+      auto& ent = m_entries[key];
+      ent.m_resolving = false;
+      waiters.swap(ent.m_waiters);
+      if (!err && !endps.empty()) {
+        ent.m_endpoints = endps;
+        ent.m_resolved = clock_type::now();
+        ent.m_expiry = ent.m_resolved + m_ttl;
+      }
+      else {
+        if (!err) {
+          err = std::make_error_code(std::errc::address_not_available);
+        }
+        endps.clear();
+      }
+    }
+    for (auto& w : waiters) {
+      w(err, endps);
+    }
+  }
+
+};
+
+}  // end net namespace
+}  // end chops namespace
+
+#endif
+
@@ -0,0 +1,244 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief File segments and memory mapped file regions, which can be passed to the
+ *  @c basic_io_interface @c send method of a TCP IO handler without reading the file
+ *  into a buffer.
+ *
+ *  A @c file_segment (a file descriptor, offset and length) is queued in order with the
+ *  other buffers and is transmitted by the kernel (@c sendfile on Linux), without a user
+ *  space copy. A @c mapped_region is a read-only memory mapping of a file region, queued
+ *  like a normal buffer (including gather writes and zero copy sends) without copying
+ *  it; many connections can send the same region.
+ *
+ *  Both classes are reference counted handles, the file (or mapping) is released when
+ *  the last handle (including the handles in output queues) is destroyed.
+ *
+ *  @note The file contents must not be modified or truncated while a segment or region
+ *  is queued or being sent.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef FILE_SEGMENT_HPP_INCLUDED
+#define FILE_SEGMENT_HPP_INCLUDED
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstddef> // std::size_t, std::byte
+#include <cstdint> // std::uint64_t
+#include <cerrno>
+#include <memory> // std::shared_ptr, std::make_shared
+#include <string>
+#include <system_error>
+#include <utility> // std::move
+
+namespace chops {
+namespace net {
+
+namespace detail {
+
+// closes the descriptor, unless borrowed from the application
+class file_handle {
+private:
+  int  m_fd;
+  bool m_owned;
+
+public:
+  file_handle(int fd, bool owned) noexcept : m_fd(fd), m_owned(owned) { }
+
+  ~file_handle() {
+    if (m_owned && m_fd >= 0) {
+      ::close(m_fd);
+    }
+  }
+
+  file_handle(const file_handle&) = delete;
+  file_handle& operator=(const file_handle&) = delete;
+
+  int native_handle() const noexcept { return m_fd; }
+};
+
+class file_mapping {
+private:
+  void*       m_addr;
+  std::size_t m_len;
+
+public:
+  file_mapping(void* addr, std::size_t len) noexcept : m_addr(addr), m_len(len) { }
+
+  ~file_mapping() {
+    if (m_addr) {
+      ::munmap(m_addr, m_len);
+    }
+  }
+
+  file_mapping(const file_mapping&) = delete;
+  file_mapping& operator=(const file_mapping&) = delete;
+};
+
+[[noreturn]] inline void throw_file_errno(int e) {
+  throw std::system_error(e, std::system_category());
+}
+
+inline int open_read_only(const std::string& path) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    throw_file_errno(errno);
+  }
+  return fd;
+}
+
+// a length of 0 is the rest of the file; the range must be within the file
+inline std::size_t file_range(int fd, std::uint64_t offset, std::size_t len) {
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    throw_file_errno(errno);
+  }
+  auto fsize = static_cast<std::uint64_t>(st.st_size);
+  if (offset > fsize || (len != 0u && len > (fsize - offset))) {
+    throw_file_errno(EINVAL);
+  }
+  return len != 0u ? len : static_cast<std::size_t>(fsize - offset);
+}
+
+} // end detail namespace
+
+/**
+ *  @brief A segment of a file, sent by the kernel from the file to the socket.
+ */
+class file_segment {
+private:
+  std::shared_ptr<const detail::file_handle> m_file;
+  std::uint64_t                              m_offset;
+  std::size_t                                m_size;
+
+public:
+  file_segment() noexcept : m_file(), m_offset(0u), m_size(0u) { }
+
+  file_segment(std::shared_ptr<const detail::file_handle> f, std::uint64_t offset,
+               std::size_t sz) noexcept :
+    m_file(std::move(f)), m_offset(offset), m_size(sz) { }
+
+  int native_handle() const noexcept { return m_file ? m_file->native_handle() : -1; }
+
+  std::uint64_t offset() const noexcept { return m_offset; }
+
+  std::size_t size() const noexcept { return m_size; }
+
+  bool empty() const noexcept { return m_size == 0u; }
+};
+
+/**
+ *  @brief Open a file and create a @c file_segment, the file is closed when the last
+ *  copy of the segment is destroyed.
+ *
+ *  @param path File path.
+ *
+ *  @param offset Offset of the segment in the file.
+ *
+ *  @param len Length of the segment, 0 for the rest of the file.
+ *
+ *  @throw @c std::system_error if the file cannot be opened, or the segment is not within
+ *  the file.
+ */
+inline file_segment make_file_segment(const std::string& path, std::uint64_t offset = 0u,
+                                      std::size_t len = 0u) {
+  auto f = std::make_shared<const detail::file_handle>(detail::open_read_only(path), true);
+  auto sz = detail::file_range(f->native_handle(), offset, len);
+  return file_segment(std::move(f), offset, sz);
+}
+
+/**
+ *  @brief Create a @c file_segment from an open file descriptor, which stays owned by
+ *  the application and must stay open until the segment has been sent.
+ *
+ *  @throw @c std::system_error if the segment is not within the file.
+ */
+inline file_segment make_file_segment(int fd, std::uint64_t offset, std::size_t len) {
+  auto sz = detail::file_range(fd, offset, len);
+  return file_segment(std::make_shared<const detail::file_handle>(fd, false), offset, sz);
+}
+
+/**
+ *  @brief A read-only memory mapped file region, sent like a buffer without copying.
+ */
+class mapped_region {
+private:
+  std::shared_ptr<const detail::file_mapping> m_map;
+  const std::byte*                            m_data;
+  std::size_t                                 m_size;
+
+public:
+  mapped_region() noexcept : m_map(), m_data(nullptr), m_size(0u) { }
+
+  mapped_region(std::shared_ptr<const detail::file_mapping> m, const std::byte* data,
+                std::size_t sz) noexcept :
+    m_map(std::move(m)), m_data(data), m_size(sz) { }
+
+  const std::byte* data() const noexcept { return m_data; }
+
+  std::size_t size() const noexcept { return m_size; }
+
+  bool empty() const noexcept { return m_size == 0u; }
+
+/**
+ *  @brief Return a part of the region, sharing the mapping.
+ *
+ *  @throw @c std::system_error (invalid argument) if the part is not within the region.
+ */
+  mapped_region subregion(std::size_t offset, std::size_t len) const {
+    if (offset > m_size || len > (m_size - offset)) {
+      detail::throw_file_errno(EINVAL);
+    }
+    return mapped_region(m_map, m_data + offset, len);
+  }
+};
+
+/**
+ *  @brief Map a file region read-only.
+ *
+ *  @param path File path.
+ *
+ *  @param offset Offset of the region in the file (need not be page aligned).
+ *
+ *  @param len Length of the region, 0 for the rest of the file.
+ *
+ *  @throw @c std::system_error if the file cannot be opened or mapped, or the region is
+ *  not within the file.
+ */
+inline mapped_region make_mapped_region(const std::string& path, std::uint64_t offset = 0u,
+                                        std::size_t len = 0u) {
+  detail::file_handle f(detail::open_read_only(path), true);
+  auto sz = detail::file_range(f.native_handle(), offset, len);
+  if (sz == 0u) {
+    return mapped_region();
+  }
+  auto page = static_cast<std::uint64_t>(::sysconf(_SC_PAGESIZE));
+  auto base = offset - (offset % page);
+  auto map_len = static_cast<std::size_t>(offset - base) + sz;
+  void* p = ::mmap(nullptr, map_len, PROT_READ, MAP_SHARED, f.native_handle(),
+                   static_cast<off_t>(base));
+  if (p == MAP_FAILED) {
+    detail::throw_file_errno(errno);
+  }
+  // the mapping stays valid after the descriptor is closed
+  return mapped_region(std::make_shared<const detail::file_mapping>(p, map_len),
+                       static_cast<const std::byte*>(p) + (offset - base), sz);
+}
+
+} // end net namespace
+} // end chops namespace
+
+#endif
+
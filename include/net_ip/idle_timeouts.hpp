@@ -0,0 +1,53 @@
+/** @file 
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Read and write idle timeouts, with heartbeat sends, for an IO handler.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0. 
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef IDLE_TIMEOUTS_HPP_INCLUDED
+#define IDLE_TIMEOUTS_HPP_INCLUDED
+
+#include <chrono>
+#include <optional>
+
+#include "utility/shared_buffer.hpp"
+
+namespace chops {
+namespace net {
+
+/**
+ *  @brief @c idle_timeouts detect dead peers and keep quiet connections alive (see 
+ *  @c basic_io_interface @c set_idle_timeouts).
+ *
+ *  A timeout of 0 disables it. The timeouts of all IO handlers of an @c io_context share
+ *  one timer wheel with a resolution of 100 milliseconds, so a timeout expires up to one
+ *  resolution late (and is rounded up to a multiple of the resolution).
+ *
+ *  When nothing is read for @c read_timeout a @c net_ip_errc::read_idle_timeout error is
+ *  reported. When nothing is sent for @c write_timeout the @c heartbeat buffer is sent,
+ *  or if there is none a @c net_ip_errc::write_idle_timeout error is reported. For a
+ *  TCP IO handler the error shuts down the connection (as any TCP IO handler error does);
+ *  for a UDP IO handler the error is reported through the error function object and the UDP 
+ *  entity keeps running, with another report after each further timeout. A UDP heartbeat
+ *  is sent to the default destination endpoint.
+ */
+struct idle_timeouts {
+  std::chrono::milliseconds                 read_timeout { 0 };
+  std::chrono::milliseconds                 write_timeout { 0 };
+  std::optional<chops::const_shared_buffer> heartbeat { };
+};
+
+} // end net namespace
+} // end chops namespace
+
+#endif
+
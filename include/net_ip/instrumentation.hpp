@@ -0,0 +1,293 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Compile-time selected instrumentation of the IO handler, acceptor, and
+ *  connector hot paths.
+ *
+ *  By default the instrumentation policy is @c null_instrumentation and every hook
+ *  compiles away, including the clock reads. Defining @c CHOPS_NET_IP_INSTRUMENTATION
+ *  selects @c counting_instrumentation, which maintains per-thread counters and
+ *  duration histograms, aggregated on demand with @c counting_instrumentation::snapshot.
+ *  Alternatively, defining @c CHOPS_NET_IP_INSTRUMENTATION_POLICY as the name of an
+ *  application class selects that class (its declaration must be visible before this
+ *  header is included).
+ *
+ *  A policy class provides:
+ *
+ *  @code
+ *    static constexpr bool enabled = true;
+ *    static void record(chops::net::io_event ev, std::size_t num_bytes,
+ *                       std::chrono::steady_clock::time_point timestamp,
+ *                       std::chrono::nanoseconds duration) noexcept;
+ *  @endcode
+ *
+ *  The @c record function is called on the thread where the event happens, within IO
+ *  handler strands or acceptor and connector handlers, so it must be cheap and must not
+ *  block. The duration is zero for events without a duration.
+ *
+ *  @note The policy selection must be the same for every translation unit of an
+ *  application.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef INSTRUMENTATION_HPP_INCLUDED
+#define INSTRUMENTATION_HPP_INCLUDED
+
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint64_t
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory> // std::shared_ptr, std::make_shared
+#include <mutex>
+#include <vector>
+
+namespace chops {
+namespace net {
+
+/**
+ *  @brief Instrumented events.
+ *
+ *  - @c read_completed: a TCP or UDP read completed, with the number of bytes read (for
+ *    a UDP batched read, the number of bytes in the batch).
+ *  - @c frame_decoded: a TCP message frame callback was invoked, or a delimiter was found,
+ *    with the number of bytes framed.
+ *  - @c handler_invoked: a message handler returned, with the message size and the time
+ *    spent in the message handler.
+ *  - @c write_queued: a buffer was passed to @c send, with the buffer size.
+ *  - @c write_completed: a write (or gather write batch) completed, with the number of
+ *    bytes and the time from the start of the write.
+ *  - @c accepted: a TCP acceptor accepted a connection.
+ *  - @c connect_attempt: a TCP connector started a connect.
+ *  - @c connect_retry: a TCP connector connect failed and a retry is scheduled.
+ */
+enum class io_event : std::size_t {
+  read_completed = 0,
+  frame_decoded,
+  handler_invoked,
+  write_queued,
+  write_completed,
+  accepted,
+  connect_attempt,
+  connect_retry
+};
+
+constexpr std::size_t num_io_events = static_cast<std::size_t>(io_event::connect_retry) + 1u;
+
+inline const char* io_event_name(io_event ev) noexcept {
+  constexpr std::array<const char*, num_io_events> names { {
+    "read_completed", "frame_decoded", "handler_invoked", "write_queued",
+    "write_completed", "accepted", "connect_attempt", "connect_retry" } };
+  return names[static_cast<std::size_t>(ev)];
+}
+
+/**
+ *  @brief Aggregated statistics for one event type.
+ *
+ *  The duration histogram counts events by duration, only for events that have a duration.
+ *  Bucket 0 counts durations under 1 nanosecond, bucket @c i counts durations from
+ *  2^(i-1) up to 2^i nanoseconds, and the last bucket counts everything from 2^(i-1)
+ *  nanoseconds up.
+ */
+struct io_event_stats {
+
+  static constexpr std::size_t num_duration_buckets = 32;
+
+  std::uint64_t count = 0;
+  std::uint64_t total_bytes = 0;
+  std::uint64_t total_duration_nsec = 0;
+  std::uint64_t max_duration_nsec = 0;
+  std::array<std::uint64_t, num_duration_buckets> duration_histogram { };
+};
+
+/**
+ *  @brief Statistics for all event types, indexed by @c io_event.
+ */
+struct instrumentation_snapshot {
+  std::array<io_event_stats, num_io_events> events { };
+
+  const io_event_stats& operator[](io_event ev) const noexcept {
+    return events[static_cast<std::size_t>(ev)];
+  }
+};
+
+/**
+ *  @brief Instrumentation policy that does nothing, the default.
+ */
+struct null_instrumentation {
+  static constexpr bool enabled = false;
+
+  static void record(io_event, std::size_t, std::chrono::steady_clock::time_point,
+                     std::chrono::nanoseconds) noexcept { }
+};
+
+/**
+ *  @brief Instrumentation policy maintaining per-thread counters and histograms.
+ *
+ *  Each thread that records events has its own block of counters, only written by that
+ *  thread (relaxed loads and stores, no atomic read-modify-write operations or locks).
+ *  A block is registered (under a mutex) the first time a thread records an event, and
+ *  is kept after the thread exits so its counts remain in snapshots.
+ */
+class counting_instrumentation {
+private:
+
+  struct event_counters {
+    std::atomic<std::uint64_t> m_count { 0u };
+    std::atomic<std::uint64_t> m_bytes { 0u };
+    std::atomic<std::uint64_t> m_duration_nsec { 0u };
+    std::atomic<std::uint64_t> m_max_duration_nsec { 0u };
+    std::array<std::atomic<std::uint64_t>, io_event_stats::num_duration_buckets> m_hist { };
+  };
+
+  using thread_block = std::array<event_counters, num_io_events>;
+
+  struct registry {
+    std::mutex                                  m_mutex;
+    std::vector<std::shared_ptr<thread_block> > m_blocks;
+  };
+
+public:
+  static constexpr bool enabled = true;
+
+  static void record(io_event ev, std::size_t num_bytes, std::chrono::steady_clock::time_point,
+                     std::chrono::nanoseconds duration) noexcept {
+    auto& ctrs = local_block()[static_cast<std::size_t>(ev)];
+    // only this thread writes the counters, so a load and store is sufficient
+    add(ctrs.m_count, 1u);
+    add(ctrs.m_bytes, num_bytes);
+    if (duration.count() <= 0) {
+      return;
+    }
+    auto nsec = static_cast<std::uint64_t>(duration.count());
+    add(ctrs.m_duration_nsec, nsec);
+    if (nsec > ctrs.m_max_duration_nsec.load(std::memory_order_relaxed)) {
+      ctrs.m_max_duration_nsec.store(nsec, std::memory_order_relaxed);
+    }
+    std::size_t b = 0u;
+    while ((b + 1u) < io_event_stats::num_duration_buckets && (nsec >> b) != 0u) {
+      ++b;
+    }
+    add(ctrs.m_hist[b], 1u);
+  }
+
+/**
+ *  @brief Aggregate the counters of all threads. This method can be called concurrently
+ *  with event recording, from any thread.
+ */
+  static instrumentation_snapshot snapshot() {
+    instrumentation_snapshot snap { };
+    auto& reg = get_registry();
+    std::lock_guard<std::mutex> lk(reg.m_mutex);
+    for (const auto& blk : reg.m_blocks) {
+      for (std::size_t i = 0u; i < num_io_events; ++i) {
+        const auto& ctrs = (*blk)[i];
+        auto& st = snap.events[i];
+        st.count += ctrs.m_count.load(std::memory_order_relaxed);
+        st.total_bytes += ctrs.m_bytes.load(std::memory_order_relaxed);
+        st.total_duration_nsec += ctrs.m_duration_nsec.load(std::memory_order_relaxed);
+        auto mx = ctrs.m_max_duration_nsec.load(std::memory_order_relaxed);
+        st.max_duration_nsec = (mx > st.max_duration_nsec) ? mx : st.max_duration_nsec;
+        for (std::size_t b = 0u; b < io_event_stats::num_duration_buckets; ++b) {
+          st.duration_histogram[b] += ctrs.m_hist[b].load(std::memory_order_relaxed);
+        }
+      }
+    }
+    return snap;
+  }
+
+/**
+ *  @brief Number of threads that have recorded events.
+ */
+  static std::size_t num_threads() {
+    auto& reg = get_registry();
+    std::lock_guard<std::mutex> lk(reg.m_mutex);
+    return reg.m_blocks.size();
+  }
+
+private:
+
+  static void add(std::atomic<std::uint64_t>& ctr, std::uint64_t val) noexcept {
+    ctr.store(ctr.load(std::memory_order_relaxed) + val, std::memory_order_relaxed);
+  }
+
+  static registry& get_registry() {
+    static registry reg;
+    return reg;
+  }
+
+  static thread_block& local_block() {
+    thread_local std::shared_ptr<thread_block> blk = [] () {
+      auto p = std::make_shared<thread_block>();
+      auto& reg = get_registry();
+      std::lock_guard<std::mutex> lk(reg.m_mutex);
+      reg.m_blocks.push_back(p);
+      return p;
+    } ();
+    return *blk;
+  }
+};
+
+#if defined(CHOPS_NET_IP_INSTRUMENTATION_POLICY)
+using io_instrumentation = CHOPS_NET_IP_INSTRUMENTATION_POLICY;
+#elif defined(CHOPS_NET_IP_INSTRUMENTATION)
+using io_instrumentation = counting_instrumentation;
+#else
+using io_instrumentation = null_instrumentation;
+#endif
+
+namespace detail {
+
+// start time of an operation with a duration, empty when instrumentation is compiled out
+template <bool Enabled>
+struct basic_event_timer {
+  void start() noexcept { }
+
+  std::chrono::nanoseconds elapsed(std::chrono::steady_clock::time_point) const noexcept {
+    return std::chrono::nanoseconds(0);
+  }
+};
+
+template <>
+struct basic_event_timer<true> {
+  std::chrono::steady_clock::time_point m_start;
+
+  void start() noexcept { m_start = std::chrono::steady_clock::now(); }
+
+  std::chrono::nanoseconds elapsed(std::chrono::steady_clock::time_point now) const noexcept {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_start);
+  }
+};
+
+using event_timer = basic_event_timer<io_instrumentation::enabled>;
+
+inline void instrument(io_event ev, std::size_t num_bytes = 0u) noexcept {
+  if constexpr (io_instrumentation::enabled) {
+    io_instrumentation::record(ev, num_bytes, std::chrono::steady_clock::now(),
+                               std::chrono::nanoseconds(0));
+  }
+}
+
+inline void instrument(io_event ev, std::size_t num_bytes,
+                       const event_timer& timer) noexcept {
+  if constexpr (io_instrumentation::enabled) {
+    auto now = std::chrono::steady_clock::now();
+    io_instrumentation::record(ev, num_bytes, now, timer.elapsed(now));
+  }
+}
+
+} // end detail namespace
+
+} // end net namespace
+} // end chops namespace
+
+#endif
+
@@ -0,0 +1,58 @@
+/** @file 
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Identifier of an IO handler within its net entity.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0. 
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef IO_HANDLER_ID_HPP_INCLUDED
+#define IO_HANDLER_ID_HPP_INCLUDED
+
+#include <cstdint> // std::uint32_t
+
+namespace chops {
+namespace net {
+
+/**
+ *  @brief @c io_handler_id identifies a TCP connection of a TCP acceptor, and is 
+ *  stable for the lifetime of the connection (see @c basic_io_interface 
+ *  @c get_handler_id).
+ *
+ *  The @c index is a slot in the acceptor connection registry. Slots are reused after 
+ *  a connection closes, so indices stay dense (below the peak number of connections),
+ *  and per-connection application state can be kept in a @c std::vector indexed by 
+ *  @c index instead of a hash map. The @c generation changes each time a slot is 
+ *  reused, so a stale identifier of a closed connection never compares equal to the
+ *  identifier of a new connection.
+ *
+ *  A @c generation of 0 means no identifier, which is the case for IO handlers not 
+ *  created by a TCP acceptor.
+ */
+struct io_handler_id {
+  std::uint32_t index = 0;
+  std::uint32_t generation = 0;
+
+  bool is_valid() const noexcept { return generation != 0; }
+};
+
+inline bool operator==(const io_handler_id& lhs, const io_handler_id& rhs) noexcept {
+  return lhs.index == rhs.index && lhs.generation == rhs.generation;
+}
+
+inline bool operator!=(const io_handler_id& lhs, const io_handler_id& rhs) noexcept {
+  return !(lhs == rhs);
+}
+
+} // end net namespace
+} // end chops namespace
+
+#endif
+
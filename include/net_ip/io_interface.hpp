@@ -18,6 +18,7 @@
 #define IO_INTERFACE_HPP_INCLUDED
 
 #include "net_ip/basic_io_interface.hpp"
+#include "net_ip/basic_io_ref.hpp"
 
 #include "net_ip/detail/tcp_io.hpp"
 #include "net_ip/detail/udp_entity_io.hpp"
@@ -55,6 +56,66 @@ using tcp_io_interface = basic_io_interface<tcp_io>;
  */
 using udp_io_interface = basic_io_interface<udp_io>;
 
+/**
+ *  @brief Using declaration for a TCP based @c basic_io_ref type, for message handlers.
+ *
+ *  @relates basic_io_ref
+ */
+using tcp_io_ref = basic_io_ref<tcp_io>;
+
+/**
+ *  @brief Using declaration for a UDP based @c basic_io_ref type, for message handlers.
+ *
+ *  @relates basic_io_ref
+ */
+using udp_io_ref = basic_io_ref<udp_io>;
+
+/**
+ *  @brief Using declaration for local (Unix domain) stream based io, used to instantiate
+ *  a @c basic_io_interface type.
+ *
+ *  @relates basic_io_interface
+ */
+using local_stream_io = detail::local_stream_io;
+
+/**
+ *  @brief Using declaration for local (Unix domain) datagram based io, used to 
+ *  instantiate a @c basic_io_interface type.
+ *
+ *  @relates basic_io_interface
+ */
+using local_datagram_io = detail::local_datagram_entity_io;
+
+/**
+ *  @brief Using declaration for a local stream based @c basic_io_interface type.
+ *
+ *  @relates basic_io_interface
+ */
+using local_stream_io_interface = basic_io_interface<local_stream_io>;
+
+/**
+ *  @brief Using declaration for a local datagram based @c basic_io_interface type.
+ *
+ *  @relates basic_io_interface
+ */
+using local_datagram_io_interface = basic_io_interface<local_datagram_io>;
+
+/**
+ *  @brief Using declaration for a local stream based @c basic_io_ref type, for message 
+ *  handlers.
+ *
+ *  @relates basic_io_ref
+ */
+using local_stream_io_ref = basic_io_ref<local_stream_io>;
+
+/**
+ *  @brief Using declaration for a local datagram based @c basic_io_ref type, for message
+ *  handlers.
+ *
+ *  @relates basic_io_ref
+ */
+using local_datagram_io_ref = basic_io_ref<local_datagram_io>;
+
 } // end net namespace
 } // end chops namespace
 
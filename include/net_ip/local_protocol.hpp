@@ -0,0 +1,297 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Local (Unix domain, @c AF_UNIX) stream and datagram protocols, meeting the
+ *  Networking TS protocol and endpoint requirements, and file descriptor passing.
+ *
+ *  Processes on the same host can use a local socket in place of loopback TCP or UDP,
+ *  avoiding the IP stack (no checksums, congestion control or loopback routing). The
+ *  Networking TS only specifies the internet protocols, so the local protocols are
+ *  provided here, in the same form as @c std::experimental::net::ip::tcp and @c udp.
+ *  The @c net_ip class has @c make_local_* methods using these protocols, with the same
+ *  IO handlers (framing, output queue stats, @c send_to_all and so forth) as the TCP and
+ *  UDP entities.
+ *
+ *  An endpoint is a file system path, or on Linux a name in the abstract namespace,
+ *  given as a path starting with a NUL character (the abstract name is not a file and
+ *  goes away with the last socket using it).
+ *
+ *  @code
+ *    chops::net::local::stream_protocol::endpoint endp("/tmp/feed.sock");
+ *    chops::net::local::datagram_protocol::endpoint abs(std::string_view("\0feed", 5));
+ *  @endcode
+ *
+ *  Open file descriptors (e.g. an accepted TCP socket, for handing a connection off to
+ *  another process) can be passed over a connected local stream socket with
+ *  @c send_native_handle and @c receive_native_handle (@c SCM_RIGHTS).
+ *
+ *  @note Local sockets are a POSIX facility.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef LOCAL_PROTOCOL_HPP_INCLUDED
+#define LOCAL_PROTOCOL_HPP_INCLUDED
+
+#include <experimental/socket>
+
+#include <cstddef> // std::size_t, offsetof
+#include <cstring> // std::memcpy, std::memcmp, std::memset
+#include <cerrno>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include <sys/socket.h> // AF_UNIX, sendmsg, recvmsg
+#include <sys/un.h> // sockaddr_un
+#include <sys/uio.h> // iovec
+
+namespace chops {
+namespace net {
+namespace local {
+
+/**
+ *  @brief Endpoint of a local protocol, a file system path or (Linux) an abstract name.
+ *
+ *  An unnamed endpoint (empty path) is the remote endpoint of a socket that was not
+ *  bound, e.g. the connecting side of a local stream connection.
+ */
+template <typename Protocol>
+class basic_endpoint {
+public:
+  using protocol_type = Protocol;
+
+private:
+  union {
+    ::sockaddr     m_base;
+    ::sockaddr_un  m_local;
+  } m_data;
+  std::size_t      m_path_len;
+
+  static constexpr std::size_t path_offset = offsetof(::sockaddr_un, sun_path);
+
+public:
+
+  basic_endpoint() noexcept : m_data(), m_path_len(0u) {
+    m_data.m_local.sun_family = AF_UNIX;
+  }
+
+/**
+ *  @brief Construct from a path, a leading NUL character is an abstract name.
+ *
+ *  @throw @c std::system_error (@c filename_too_long) if the path does not fit in
+ *  a @c sockaddr_un.
+ */
+  basic_endpoint(std::string_view path) : basic_endpoint() {
+    // room is needed for the terminating NUL of a file system path
+    std::size_t max_len = sizeof(m_data.m_local.sun_path) -
+                            ((!path.empty() && path[0] == '\0') ? 0u : 1u);
+    if (path.size() > max_len) {
+      throw std::system_error(std::make_error_code(std::errc::filename_too_long));
+    }
+    std::memcpy(m_data.m_local.sun_path, path.data(), path.size());
+    m_path_len = path.size();
+  }
+
+  basic_endpoint(const char* path) : basic_endpoint(std::string_view(path)) { }
+
+  basic_endpoint(const std::string& path) : basic_endpoint(std::string_view(path)) { }
+
+  constexpr protocol_type protocol() const noexcept { return protocol_type(); }
+
+  std::string path() const { return std::string(m_data.m_local.sun_path, m_path_len); }
+
+  bool is_abstract() const noexcept {
+    return m_path_len != 0u && m_data.m_local.sun_path[0] == '\0';
+  }
+
+  // the following methods are used by the Networking TS socket classes
+
+  void* data() noexcept { return &m_data.m_base; }
+  const void* data() const noexcept { return &m_data.m_base; }
+
+  // a file system path includes the terminating NUL, an abstract name does not
+  std::size_t size() const noexcept {
+    return path_offset + m_path_len + ((m_path_len == 0u || is_abstract()) ? 0u : 1u);
+  }
+
+  std::size_t capacity() const noexcept { return sizeof(m_data.m_local); }
+
+  void resize(std::size_t sz) {
+    if (sz > capacity()) {
+      throw std::system_error(std::make_error_code(std::errc::invalid_argument));
+    }
+    m_path_len = (sz > path_offset) ? (sz - path_offset) : 0u;
+    if (m_path_len != 0u && !is_abstract()) {
+      // the kernel may or may not count the terminating NUL
+      m_path_len = ::strnlen(m_data.m_local.sun_path, m_path_len);
+    }
+  }
+
+  friend bool operator==(const basic_endpoint& lhs, const basic_endpoint& rhs) noexcept {
+    return lhs.m_path_len == rhs.m_path_len &&
+           std::memcmp(lhs.m_data.m_local.sun_path, rhs.m_data.m_local.sun_path,
+                       lhs.m_path_len) == 0;
+  }
+
+  friend bool operator!=(const basic_endpoint& lhs, const basic_endpoint& rhs) noexcept {
+    return !(lhs == rhs);
+  }
+
+  friend bool operator<(const basic_endpoint& lhs, const basic_endpoint& rhs) noexcept {
+    return std::string_view(lhs.m_data.m_local.sun_path, lhs.m_path_len) <
+           std::string_view(rhs.m_data.m_local.sun_path, rhs.m_path_len);
+  }
+
+};
+
+/**
+ *  @brief Local stream protocol (@c SOCK_STREAM), the same host counterpart of TCP.
+ */
+class stream_protocol {
+public:
+  using endpoint = basic_endpoint<stream_protocol>;
+  using socket = std::experimental::net::basic_stream_socket<stream_protocol>;
+  using acceptor = std::experimental::net::basic_socket_acceptor<stream_protocol>;
+
+  constexpr int family() const noexcept { return AF_UNIX; }
+  constexpr int type() const noexcept { return SOCK_STREAM; }
+  constexpr int protocol() const noexcept { return 0; }
+
+  friend constexpr bool operator==(const stream_protocol&, const stream_protocol&) noexcept {
+    return true;
+  }
+  friend constexpr bool operator!=(const stream_protocol&, const stream_protocol&) noexcept {
+    return false;
+  }
+};
+
+/**
+ *  @brief Local datagram protocol (@c SOCK_DGRAM), the same host counterpart of UDP.
+ *
+ *  Local datagrams are reliable and kept in order by the kernel, a sender blocks (or
+ *  gets @c would_block) instead of a datagram being dropped.
+ */
+class datagram_protocol {
+public:
+  using endpoint = basic_endpoint<datagram_protocol>;
+  using socket = std::experimental::net::basic_datagram_socket<datagram_protocol>;
+
+  constexpr int family() const noexcept { return AF_UNIX; }
+  constexpr int type() const noexcept { return SOCK_DGRAM; }
+  constexpr int protocol() const noexcept { return 0; }
+
+  friend constexpr bool operator==(const datagram_protocol&, const datagram_protocol&) noexcept {
+    return true;
+  }
+  friend constexpr bool operator!=(const datagram_protocol&, const datagram_protocol&) noexcept {
+    return false;
+  }
+};
+
+/**
+ *  @brief Send an open file descriptor over a connected local stream socket
+ *  (@c SCM_RIGHTS), with a one byte payload.
+ *
+ *  The receiving process gets its own descriptor for the same open file (or socket);
+ *  the sender still owns (and normally closes) its descriptor. This is a synchronous
+ *  call, meant for a control connection that is not read by an IO handler (descriptors
+ *  are not delivered through message handlers).
+ *
+ *  @param sock Connected local stream socket.
+ *
+ *  @param handle Descriptor to send.
+ *
+ *  @param ec Set on error, @c would_block if the socket is non-blocking and full.
+ */
+template <typename Socket>
+void send_native_handle(Socket& sock, int handle, std::error_code& ec) {
+  ec.clear();
+  char byte = 0;
+  ::iovec iov { &byte, 1u };
+  alignas(::cmsghdr) unsigned char ctrl[CMSG_SPACE(sizeof(int))];
+  std::memset(ctrl, 0, sizeof(ctrl));
+  ::msghdr msg { };
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = ctrl;
+  msg.msg_controllen = sizeof(ctrl);
+  auto* cm = CMSG_FIRSTHDR(&msg);
+  cm->cmsg_level = SOL_SOCKET;
+  cm->cmsg_type = SCM_RIGHTS;
+  cm->cmsg_len = CMSG_LEN(sizeof(int));
+  std::memcpy(CMSG_DATA(cm), &handle, sizeof(int));
+  while (::sendmsg(sock.native_handle(), &msg, MSG_NOSIGNAL) < 0) {
+    if (errno != EINTR) {
+      ec = std::error_code(errno, std::system_category());
+      return;
+    }
+  }
+}
+
+/**
+ *  @brief Receive a file descriptor sent with @c send_native_handle.
+ *
+ *  The descriptor is created close-on-exec where supported, the caller owns it (e.g.
+ *  to adopt an accepted TCP connection into a @c std::experimental::net::ip::tcp::socket
+ *  of this process).
+ *
+ *  @param sock Connected local stream socket.
+ *
+ *  @param ec Set on error, @c connection_reset if the peer closed the connection, or
+ *  @c bad_message if no descriptor came with the payload.
+ *
+ *  @return The received descriptor, -1 on error.
+ */
+template <typename Socket>
+int receive_native_handle(Socket& sock, std::error_code& ec) {
+  ec.clear();
+  char byte = 0;
+  ::iovec iov { &byte, 1u };
+  alignas(::cmsghdr) unsigned char ctrl[CMSG_SPACE(sizeof(int))];
+  ::msghdr msg { };
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = ctrl;
+  msg.msg_controllen = sizeof(ctrl);
+#ifdef MSG_CMSG_CLOEXEC
+  constexpr int flags = MSG_CMSG_CLOEXEC;
+#else
+  constexpr int flags = 0;
+#endif
+  ::ssize_t nb = 0;
+  while ((nb = ::recvmsg(sock.native_handle(), &msg, flags)) < 0) {
+    if (errno != EINTR) {
+      ec = std::error_code(errno, std::system_category());
+      return -1;
+    }
+  }
+  if (nb == 0) {
+    ec = std::make_error_code(std::errc::connection_reset);
+    return -1;
+  }
+  for (auto* cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+    if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS &&
+        cm->cmsg_len == CMSG_LEN(sizeof(int))) {
+      int handle = -1;
+      std::memcpy(&handle, CMSG_DATA(cm), sizeof(int));
+      return handle;
+    }
+  }
+  ec = std::make_error_code(std::errc::bad_message);
+  return -1;
+}
+
+} // end local namespace
+} // end net namespace
+} // end chops namespace
+
+#endif
+
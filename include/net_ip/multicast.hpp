@@ -0,0 +1,84 @@
+/** @file 
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Structures for UDP multicast entity options and statistics.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0. 
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef MULTICAST_HPP_INCLUDED
+#define MULTICAST_HPP_INCLUDED
+
+#include <cstddef> // std::size_t 
+#include <vector>
+
+#include <experimental/internet>
+
+namespace chops {
+namespace net {
+
+/**
+ *  @brief @c multicast_options are applied to a UDP multicast entity socket when the 
+ *  entity is started (see @c net_ip @c make_udp_multicast).
+ *
+ *  The default values are suited to receiving high rate feeds on the default interface. 
+ *  A receive buffer size of 0 leaves the system default in place. Note that the system
+ *  may limit (or double) the receive buffer size (e.g. @c net.core.rmem_max on Linux).
+ */
+
+struct multicast_options {
+  // IPv4 interface for group joins and outgoing datagrams, unspecified means the default 
+  std::experimental::net::ip::address_v4 interface_addr { };
+  // IPv6 interface index for group joins and outgoing datagrams, 0 means the default
+  unsigned int interface_index = 0;
+  bool loopback = true;
+  // time to live (hop limit) for outgoing datagrams
+  int hops = 1;
+  int receive_buffer_size = 8 * 1024 * 1024;
+  bool reuse_addr = true;
+};
+
+/**
+ *  @brief @c multicast_group_stats provides counts of incoming datagrams for one joined
+ *  multicast group.
+ */
+
+struct multicast_group_stats {
+  std::experimental::net::ip::address group { };
+  std::size_t num_packets = 0;
+  std::size_t num_bytes = 0;
+};
+
+/**
+ *  @brief @c multicast_stats provides information on the incoming datagrams of a UDP 
+ *  multicast entity, with counts for each joined group.
+ *
+ *  Per group counts require the destination address of each datagram, which is only
+ *  available on Linux (through @c IP_PKTINFO / @c IPV6_PKTINFO); on other platforms 
+ *  all datagrams are counted as unmatched.
+ *
+ *  The drop count is the number of datagrams dropped by the kernel because the socket 
+ *  receive buffer was full (Linux @c SO_RXQ_OVFL). The kernel does not know which group 
+ *  a dropped datagram belongs to, so this count is for the whole socket; a separate 
+ *  multicast entity (and socket) per group provides a per group drop count.
+ */
+
+struct multicast_stats {
+  std::vector<multicast_group_stats> groups;
+  // datagrams not addressed to a joined group (e.g. unicast), or of unknown destination
+  std::size_t num_unmatched = 0;
+  std::size_t num_dropped = 0;
+};
+
+} // end net namespace
+} // end chops namespace
+
+#endif
+
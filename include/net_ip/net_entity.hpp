@@ -47,6 +47,29 @@ using tcp_acceptor_net_entity = basic_net_entity<detail::tcp_acceptor>;
  */
 using udp_net_entity = basic_net_entity<detail::udp_entity_io>;
 
+/**
+ *  @brief Using declaration for a local (Unix domain) stream connector @c basic_net_entity
+ *  type.
+ *
+ *  @relates basic_net_entity
+ */
+using local_stream_connector_net_entity = basic_net_entity<detail::local_stream_connector>;
+
+/**
+ *  @brief Using declaration for a local (Unix domain) stream acceptor @c basic_net_entity
+ *  type.
+ *
+ *  @relates basic_net_entity
+ */
+using local_stream_acceptor_net_entity = basic_net_entity<detail::local_stream_acceptor>;
+
+/**
+ *  @brief Using declaration for a local (Unix domain) datagram @c basic_net_entity type.
+ *
+ *  @relates basic_net_entity
+ */
+using local_datagram_net_entity = basic_net_entity<detail::local_datagram_entity_io>;
+
 } // end net namespace
 } // end chops namespace
 
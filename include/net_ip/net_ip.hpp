@@ -25,6 +25,7 @@
 #include <chrono>
 
 #include <mutex>
+#include <utility> // std::move
 
 #include <experimental/io_context>
 #include <experimental/executor>
@@ -33,12 +34,23 @@
 #include "net_ip/net_ip_error.hpp"
 #include "net_ip/net_entity.hpp"
 #include "net_ip/endpoints_resolver.hpp"
+#include "net_ip/endpoints_cache.hpp"
+#include "net_ip/multicast.hpp"
+#include "net_ip/tcp_connect_options.hpp"
+#include "net_ip/socket_profile.hpp"
+#include "net_ip/accept_limits.hpp"
+#include "net_ip/net_ip_metrics.hpp"
+#include "net_ip/local_protocol.hpp"
 
 #include "net_ip/detail/tcp_connector.hpp"
 #include "net_ip/detail/tcp_acceptor.hpp"
 #include "net_ip/detail/udp_entity_io.hpp"
 #include "net_ip/detail/tcp_io.hpp"
 
+#ifdef CHOPS_NET_TLS
+#include "net_ip/tls_context.hpp"
+#endif
+
 #include "utility/erase_where.hpp"
 
 namespace chops {
@@ -80,6 +92,18 @@ namespace net {
  *  If this is not acceptable, the application can perform the lookup and the 
  *  endpoint (or endpoint sequence) can be passed in through the @c make method.
  *
+ *  Lookups go through a TCP and a UDP @c endpoints_cache, shared by all network 
+ *  entities of the @c net_ip object. Many TCP connectors to the same host and port 
+ *  share one resolve, and a restarted connector uses the cached endpoints. The caches
+ *  are available through @c get_tcp_endpoints_cache and @c get_udp_endpoints_cache,
+ *  for example to change the time to live period.
+ *
+ *  Processes on the same host can use local (Unix domain) stream and datagram entities
+ *  instead of loopback TCP and UDP, created through the @c make_local_* methods with a
+ *  file system path (or abstract name) as the endpoint. These have the same IO handlers,
+ *  message framing and state change callbacks as their TCP and UDP counterparts, without
+ *  name resolution, TLS or multicast.
+ *
  *  State change function objects are invoked when network IO can be started as
  *  well as when an error or shutdown occurs.
  *
@@ -105,6 +129,18 @@ namespace net {
  *    wk.reset(); // or wk.stop();
  *  @endcode
  *
+ *  The @c worker_pool component class runs multiple threads, either with an 
+ *  @c io_context per thread or with one shared @c io_context. For the first mode
+ *  accepted TCP connections can be distributed across the contexts:
+ *
+ *  @code
+ *    chops::net::worker_pool wp(8);
+ *    wp.start();
+ *    chops::net::net_ip my_nip(wp.get_io_context(), wp.make_io_context_selector());
+ *    // ...
+ *    wp.reset(); // or wp.stop();
+ *  @endcode
+ *
  *  The @c net_ip class is safe for multiple threads to use concurrently. 
  *
  *  It should be noted, however, that race conditions are possible, specially for 
@@ -114,14 +150,25 @@ namespace net {
  *
  */
 class net_ip {
+public:
+  using io_context_selector = detail::tcp_acceptor::io_context_selector;
+  using tcp_endpoints_cache = endpoints_cache<std::experimental::net::ip::tcp>;
+  using udp_endpoints_cache = endpoints_cache<std::experimental::net::ip::udp>;
+
 private:
 
   std::experimental::net::io_context&    m_ioc;
+  io_context_selector                    m_ioc_selector;
+  std::shared_ptr<tcp_endpoints_cache>   m_tcp_endp_cache;
+  std::shared_ptr<udp_endpoints_cache>   m_udp_endp_cache;
 
   mutable std::mutex                     m_mutex;
   std::vector<detail::tcp_acceptor_ptr>  m_acceptors;
   std::vector<detail::tcp_connector_ptr> m_connectors;
   std::vector<detail::udp_entity_io_ptr> m_udp_entities;
+  std::vector<detail::local_stream_acceptor_ptr>     m_local_acceptors;
+  std::vector<detail::local_stream_connector_ptr>    m_local_connectors;
+  std::vector<detail::local_datagram_entity_io_ptr>  m_local_datagram_entities;
 
 private:
   using lg = std::lock_guard<std::mutex>;
@@ -134,7 +181,28 @@ public:
  *  @param ioc IO context for asynchronous operations.
  */
   explicit net_ip(std::experimental::net::io_context& ioc) :
-    m_ioc(ioc), m_acceptors(), m_connectors(), m_udp_entities() { }
+    m_ioc(ioc), m_ioc_selector(), 
+    m_tcp_endp_cache(std::make_shared<tcp_endpoints_cache>(ioc)),
+    m_udp_endp_cache(std::make_shared<udp_endpoints_cache>(ioc)),
+    m_acceptors(), m_connectors(), m_udp_entities(),
+    m_local_acceptors(), m_local_connectors(), m_local_datagram_entities() { }
+
+/**
+ *  @brief Construct a @c net_ip object that places accepted TCP connections on
+ *  the IO context returned from a selector function object.
+ *
+ *  @param ioc IO context for the network entities (acceptors, connectors, and UDP 
+ *  entities).
+ *
+ *  @param sel Function object returning an @c io_context reference, called for each 
+ *  accepted TCP connection (e.g. @c worker_pool::make_io_context_selector).
+ */
+  net_ip(std::experimental::net::io_context& ioc, io_context_selector sel) :
+    m_ioc(ioc), m_ioc_selector(std::move(sel)), 
+    m_tcp_endp_cache(std::make_shared<tcp_endpoints_cache>(ioc)),
+    m_udp_endp_cache(std::make_shared<udp_endpoints_cache>(ioc)),
+    m_acceptors(), m_connectors(), m_udp_entities(),
+    m_local_acceptors(), m_local_connectors(), m_local_datagram_entities() { }
 
 private:
 
@@ -146,6 +214,16 @@ private:
 
 public:
 
+/**
+ *  @brief Access the name resolution cache used for TCP endpoints.
+ */
+  tcp_endpoints_cache& get_tcp_endpoints_cache() noexcept { return *m_tcp_endp_cache; }
+
+/**
+ *  @brief Access the name resolution cache used for UDP endpoints.
+ */
+  udp_endpoints_cache& get_udp_endpoints_cache() noexcept { return *m_udp_endp_cache; }
+
 /**
  *  @brief Create a TCP acceptor @c net_entity, which will listen on a port for incoming
  *  connections (once started).
@@ -160,6 +238,12 @@ public:
  *  @param reuse_addr If @c true (default), the @c reuse_address socket option is set upon 
  *  socket open.
  *
+ *  @param prof Socket options applied to each accepted socket (default is none, see
+ *  @c socket_profile).
+ *
+ *  @param lim Connection limits and accept batching (default is no limits, see
+ *  @c accept_limits).
+ *
  *  @return @c tcp_acceptor_net_entity object.
  *
  *  @throw @c std::system_error if there is a name lookup failure.
@@ -170,10 +254,11 @@ public:
  */
   tcp_acceptor_net_entity make_tcp_acceptor (std::string_view local_port_or_service, 
                                              std::string_view listen_intf = "",
-                                             bool reuse_addr = true) {
-    endpoints_resolver<std::experimental::net::ip::tcp> resolver(m_ioc);
-    auto results = resolver.make_endpoints(true, listen_intf, local_port_or_service);
-    return make_tcp_acceptor(results.cbegin()->endpoint(), reuse_addr);
+                                             bool reuse_addr = true,
+                                             const socket_profile& prof = socket_profile(),
+                                             const accept_limits& lim = accept_limits()) {
+    auto endps = m_tcp_endp_cache->make_endpoints(true, listen_intf, local_port_or_service);
+    return make_tcp_acceptor(endps.front(), reuse_addr, prof, lim);
   }
 
 /**
@@ -189,18 +274,143 @@ public:
  *  @param reuse_addr If @c true (default), the @c reuse_address socket option is set upon 
  *  socket open.
  *
+ *  @param prof Socket options applied to each accepted socket (default is none, see
+ *  @c socket_profile).
+ *
+ *  @param lim Connection limits and accept batching (default is no limits, see
+ *  @c accept_limits).
+ *
  *  @return @c tcp_acceptor_net_entity object.
  *
  */
   tcp_acceptor_net_entity make_tcp_acceptor (const std::experimental::net::ip::tcp::endpoint& endp,
-                                             bool reuse_addr = true) {
-    auto p = std::make_shared<detail::tcp_acceptor>(m_ioc, endp, reuse_addr);
+                                             bool reuse_addr = true,
+                                             const socket_profile& prof = socket_profile(),
+                                             const accept_limits& lim = accept_limits()) {
+    auto p = std::make_shared<detail::tcp_acceptor>(m_ioc, endp, reuse_addr, m_ioc_selector,
+                                                    prof, lim);
 //    std::experimental::net::post(m_ioc.get_executor(), [p, this] () { m_acceptors.push_back(p); } );
     lg g(m_mutex);
     m_acceptors.push_back(p);
     return tcp_acceptor_net_entity(p);
   }
 
+#ifdef CHOPS_NET_TLS
+/**
+ *  @brief Create a TLS TCP acceptor @c net_entity, which performs a TLS handshake on
+ *  each accepted connection before the IO handler is created.
+ *
+ *  The parameters are the same as the plain @c make_tcp_acceptor method. A connection
+ *  does not reach the IO state change callback until the handshake has completed and the
+ *  record layer is in the kernel (see @c tls_context); a handshake failure is reported
+ *  through the error callback. Connections in a handshake count against the accept
+ *  limits.
+ *
+ *  @param ctx A server side @c tls_context.
+ *
+ *  @return @c tcp_acceptor_net_entity object.
+ *
+ *  @throw @c std::system_error if there is a name lookup failure.
+ */
+  tcp_acceptor_net_entity make_tls_tcp_acceptor (tls_context_ptr ctx,
+                                                 std::string_view local_port_or_service, 
+                                                 std::string_view listen_intf = "",
+                                                 bool reuse_addr = true,
+                                                 const socket_profile& prof = socket_profile(),
+                                                 const accept_limits& lim = accept_limits()) {
+    auto endps = m_tcp_endp_cache->make_endpoints(true, listen_intf, local_port_or_service);
+    auto p = std::make_shared<detail::tcp_acceptor>(m_ioc, endps.front(), reuse_addr,
+                                                    m_ioc_selector, prof, lim);
+    p->set_tls(std::move(ctx));
+    lg g(m_mutex);
+    m_acceptors.push_back(p);
+    return tcp_acceptor_net_entity(p);
+  }
+#endif
+
+/**
+ *  @brief Create a sharded TCP acceptor @c net_entity, with one listening socket per
+ *  IO context.
+ *
+ *  Each listening socket is bound to the same endpoint with the @c SO_REUSEPORT socket 
+ *  option, so the kernel spreads incoming connections (and the accept processing) across 
+ *  the IO contexts, and each accepted connection runs on the IO context of its listener. 
+ *  This is useful for handling connection storms with multiple threads (e.g. with the
+ *  IO contexts of a @c worker_pool).
+ *
+ *  A single @c tcp_acceptor_net_entity is returned, and the IO state change callback
+ *  reports the combined number of connections across all of the listeners. The accept
+ *  completion handling (and callbacks) are serialized, so the callbacks are never
+ *  invoked concurrently.
+ *
+ *  If @c SO_REUSEPORT is not supported on the platform, only the first IO context is used.
+ *
+ *  @param local_port_or_service Port number or service name to bind to for incoming TCP 
+ *  connects.
+ *
+ *  @param iocs IO contexts, one listener is created for each; must not be empty.
+ *
+ *  @param listen_intf If this parameter is supplied, the bind will be performed on this 
+ *  specific interface. Otherwise, the bind is for "any" IP interface.
+ *
+ *  @param reuse_addr If @c true (default), the @c reuse_address socket option is set upon 
+ *  socket open.
+ *
+ *  @param prof Socket options applied to each accepted socket (default is none, see
+ *  @c socket_profile).
+ *
+ *  @param lim Connection limits and accept batching (default is no limits, see
+ *  @c accept_limits).
+ *
+ *  @return @c tcp_acceptor_net_entity object.
+ *
+ *  @throw @c std::system_error if there is a name lookup failure, @c std::out_of_range
+ *  if @c iocs is empty.
+ */
+  tcp_acceptor_net_entity make_tcp_acceptor_sharded (std::string_view local_port_or_service, 
+                             const std::vector<std::experimental::net::io_context*>& iocs,
+                             std::string_view listen_intf = "",
+                             bool reuse_addr = true,
+                             const socket_profile& prof = socket_profile(),
+                             const accept_limits& lim = accept_limits()) {
+    auto endps = m_tcp_endp_cache->make_endpoints(true, listen_intf, local_port_or_service);
+    return make_tcp_acceptor_sharded(endps.front(), iocs, reuse_addr, prof, lim);
+  }
+
+/**
+ *  @brief Create a sharded TCP acceptor @c net_entity, using an already created endpoint.
+ *
+ *  See the other @c make_tcp_acceptor_sharded method for details.
+ *
+ *  @param endp A @c std::experimental::net::ip::tcp::endpoint that each listener binds to.
+ *
+ *  @param iocs IO contexts, one listener is created for each; must not be empty.
+ *
+ *  @param reuse_addr If @c true (default), the @c reuse_address socket option is set upon 
+ *  socket open.
+ *
+ *  @param prof Socket options applied to each accepted socket (default is none, see
+ *  @c socket_profile).
+ *
+ *  @param lim Connection limits and accept batching (default is no limits, see
+ *  @c accept_limits).
+ *
+ *  @return @c tcp_acceptor_net_entity object.
+ *
+ *  @throw @c std::out_of_range if @c iocs is empty.
+ */
+  tcp_acceptor_net_entity make_tcp_acceptor_sharded (
+                             const std::experimental::net::ip::tcp::endpoint& endp,
+                             const std::vector<std::experimental::net::io_context*>& iocs,
+                             bool reuse_addr = true,
+                             const socket_profile& prof = socket_profile(),
+                             const accept_limits& lim = accept_limits()) {
+    auto p = std::make_shared<detail::tcp_acceptor>(iocs, endp, reuse_addr, prof, lim);
+    lg g(m_mutex);
+    m_acceptors.push_back(p);
+    return tcp_acceptor_net_entity(p);
+  }
+
 /**
  *  @brief Create a TCP connector @c net_entity, which will perform an active TCP
  *  connect to the specified host and port (once started).
@@ -221,10 +431,14 @@ public:
  *  @param reconn_time Time period in milliseconds between connect attempts. If 0, no
  *  reconnects are attempted (default is 0).
  *
+ *  @param prof Socket options applied to the socket before each connect (default is 
+ *  none, see @c socket_profile).
+ *
  *  @return @c tcp_connector_net_entity object.
  *
  *  @note The name and port lookup to create a sequence of remote TCP endpoints is not performed
- *  until the @c net_entity @c start method is called. If this is not acceptable, the
+ *  until the @c net_entity @c start method is called, through the shared TCP endpoints cache.
+ *  Connect failures refresh the cache entry in the background for the next attempt. If this is not acceptable, the
  *  endpoints can be looked up by the application and the alternate @c make_tcp_connector
  *  method called.
  *
@@ -232,10 +446,12 @@ public:
   tcp_connector_net_entity make_tcp_connector (std::string_view remote_port_or_service,
                                                std::string_view remote_host,
                                                std::chrono::milliseconds reconn_time = 
-                                                 std::chrono::milliseconds { } ) {
+                                                 std::chrono::milliseconds { },
+                                               const socket_profile& prof = socket_profile()) {
 
     auto p = std::make_shared<detail::tcp_connector>(m_ioc, remote_port_or_service, 
-                                                                  remote_host, reconn_time);
+                                                     remote_host, reconn_time, m_tcp_endp_cache,
+                                                     prof);
 //    std::experimental::net::post(m_ioc.get_executor(), [p, this] () { m_connectors.push_back(p); } );
     lg g(m_mutex);
     m_connectors.push_back(p);
@@ -246,12 +462,85 @@ public:
   tcp_connector_net_entity make_tcp_connector (const char* remote_port_or_service,
                                                const char* remote_host,
                                                std::chrono::milliseconds reconn_time =
-                                                 std::chrono::milliseconds { } ) {
+                                                 std::chrono::milliseconds { },
+                                               const socket_profile& prof = socket_profile()) {
     return make_tcp_connector(std::string_view(remote_port_or_service),
                               std::string_view(remote_host),
-                              reconn_time);
+                              reconn_time, prof);
+  }
+
+/**
+ *  @brief Create a TCP connector @c net_entity with connect and reconnect options, which 
+ *  will perform an active TCP connect to the specified host and port (once started).
+ *
+ *  This is the same as the @c make_tcp_connector method with a reconnect time, except
+ *  that the options allow staggered parallel connect attempts to the remote endpoints, a 
+ *  timeout for each connect attempt, and exponential backoff with jitter between 
+ *  reconnect attempts (see @c tcp_connect_options).
+ *
+ *  @param remote_port_or_service Port number or service name on remote host.
+ *
+ *  @param remote_host Remote host name or IP address.
+ *
+ *  @param opts Connect and reconnect options.
+ *
+ *  @param prof Socket options applied to the socket before each connect (default is 
+ *  none, see @c socket_profile).
+ *
+ *  @return @c tcp_connector_net_entity object.
+ */
+  tcp_connector_net_entity make_tcp_connector (std::string_view remote_port_or_service,
+                                               std::string_view remote_host,
+                                               const tcp_connect_options& opts,
+                                               const socket_profile& prof = socket_profile()) {
+
+    auto p = std::make_shared<detail::tcp_connector>(m_ioc, remote_port_or_service, 
+                                                     remote_host, opts, m_tcp_endp_cache, prof);
+    lg g(m_mutex);
+    m_connectors.push_back(p);
+    return tcp_connector_net_entity(p);
+  }
+
+  // match const char* to string_view instead of templated iterator
+  tcp_connector_net_entity make_tcp_connector (const char* remote_port_or_service,
+                                               const char* remote_host,
+                                               const tcp_connect_options& opts,
+                                               const socket_profile& prof = socket_profile()) {
+    return make_tcp_connector(std::string_view(remote_port_or_service),
+                              std::string_view(remote_host), opts, prof);
   }
 
+#ifdef CHOPS_NET_TLS
+/**
+ *  @brief Create a TLS TCP connector @c net_entity, which performs a TLS handshake after
+ *  each connect, before the IO handler is created.
+ *
+ *  The parameters are the same as the @c make_tcp_connector method with connect options.
+ *  The server name (for SNI and certificate verification) is the @c tls_config
+ *  @c server_name, or the remote host if empty. A handshake failure is handled as a
+ *  connect failure (reported through the error callback, then reconnect and backoff
+ *  apply), and a reconnect resumes the last session to the same host and port.
+ *
+ *  @param ctx A client side @c tls_context.
+ *
+ *  @return @c tcp_connector_net_entity object.
+ */
+  tcp_connector_net_entity make_tls_tcp_connector (tls_context_ptr ctx,
+                                                   std::string_view remote_port_or_service,
+                                                   std::string_view remote_host,
+                                                   const tcp_connect_options& opts =
+                                                     tcp_connect_options(),
+                                                   const socket_profile& prof = socket_profile()) {
+
+    auto p = std::make_shared<detail::tcp_connector>(m_ioc, remote_port_or_service, 
+                                                     remote_host, opts, m_tcp_endp_cache, prof);
+    p->set_tls(std::move(ctx));
+    lg g(m_mutex);
+    m_connectors.push_back(p);
+    return tcp_connector_net_entity(p);
+  }
+#endif
+
 /**
  *  @brief Create a TCP connector @c net_entity, using an already created sequence of 
  *  endpoints.
@@ -266,20 +555,51 @@ public:
  *  @param reconn_time Time period in milliseconds between connect attempts. If 0, no
  *  reconnects are attempted (default is 0).
  *
+ *  @param prof Socket options applied to the socket before each connect (default is 
+ *  none, see @c socket_profile).
+ *
  *  @return @c tcp_connector_net_entity object.
  *
  */
   template <typename Iter>
   tcp_connector_net_entity make_tcp_connector (Iter beg, Iter end,
                                                std::chrono::milliseconds reconn_time = 
-                                                 std::chrono::milliseconds { } ) {
-    auto p = std::make_shared<detail::tcp_connector>(m_ioc, beg, end, reconn_time);
+                                                 std::chrono::milliseconds { },
+                                               const socket_profile& prof = socket_profile()) {
+    auto p = std::make_shared<detail::tcp_connector>(m_ioc, beg, end, reconn_time, prof);
 //    std::experimental::net::post(m_ioc.get_executor(), [p, this] () { m_connectors.push_back(p); } );
     lg g(m_mutex);
     m_connectors.push_back(p);
     return tcp_connector_net_entity(p);
   }
 
+/**
+ *  @brief Create a TCP connector @c net_entity with connect and reconnect options, using 
+ *  an already created sequence of endpoints.
+ *
+ *  @param beg A begin iterator to a sequence of remote @c std::experimental::net::ip::tcp::endpoint
+ *  objects.
+ *
+ *  @param end An end iterator to the sequence of endpoints.
+ *
+ *  @param opts Connect and reconnect options, see @c tcp_connect_options.
+ *
+ *  @param prof Socket options applied to the socket before each connect (default is 
+ *  none, see @c socket_profile).
+ *
+ *  @return @c tcp_connector_net_entity object.
+ *
+ */
+  template <typename Iter>
+  tcp_connector_net_entity make_tcp_connector (Iter beg, Iter end, 
+                                               const tcp_connect_options& opts,
+                                               const socket_profile& prof = socket_profile()) {
+    auto p = std::make_shared<detail::tcp_connector>(m_ioc, beg, end, opts, prof);
+    lg g(m_mutex);
+    m_connectors.push_back(p);
+    return tcp_connector_net_entity(p);
+  }
+
 /**
  *  @brief Create a TCP connector @c net_entity using a single remote endpoint.
  *
@@ -289,14 +609,18 @@ public:
  *  @param reconn_time_millis Time period in milliseconds between connect attempts. If 0, no
  *  reconnects are attempted (default is 0).
  *
+ *  @param prof Socket options applied to the socket before each connect (default is 
+ *  none, see @c socket_profile).
+ *
  *  @return @c tcp_connector_net_entity object.
  *
  */
   tcp_connector_net_entity make_tcp_connector (const std::experimental::net::ip::tcp::endpoint& endp, 
                                                std::chrono::milliseconds reconn_time = 
-                                                 std::chrono::milliseconds { } ) {
+                                                 std::chrono::milliseconds { },
+                                               const socket_profile& prof = socket_profile()) {
     std::vector<std::experimental::net::ip::tcp::endpoint> vec { endp };
-    return make_tcp_connector(vec.cbegin(), vec.cend(), reconn_time);
+    return make_tcp_connector(vec.cbegin(), vec.cend(), reconn_time, prof);
   }
 
 /**
@@ -318,19 +642,23 @@ public:
  *
  *  @param local_intf Local interface name, otherwise the default is "any address".
  *
+ *  @param prof Socket options applied to the socket before the bind (default is none, 
+ *  see @c socket_profile).
+ *
  *  @throw @c std::system_error if there is a name lookup failure.
  *
  *  @note Common socket options on UDP datagram sockets, such as increasing the 
  *  "time to live" (hop limit), allowing UDP broadcast, or setting the socket 
  *  reuse flag can be set by using the @c net_entity @c get_socket method (or 
- *  @c io_interface @c get_socket method, which returns the same reference).
+ *  @c io_interface @c get_socket method, which returns the same reference). Buffer
+ *  sizes and other options in a @c socket_profile are applied by the library.
  *
  */
   udp_net_entity make_udp_unicast (std::string_view local_port_or_service, 
-                                   std::string_view local_intf = "") {
-    endpoints_resolver<std::experimental::net::ip::udp> resolver(m_ioc);
-    auto results = resolver.make_endpoints(true, local_intf, local_port_or_service);
-    return make_udp_unicast(results.cbegin()->endpoint());
+                                   std::string_view local_intf = "",
+                                   const socket_profile& prof = socket_profile()) {
+    auto endps = m_udp_endp_cache->make_endpoints(true, local_intf, local_port_or_service);
+    return make_udp_unicast(endps.front(), prof);
   }
 
 /**
@@ -343,11 +671,15 @@ public:
  *  @param endp A @c std::experimental::net::ip::udp::endpoint used for the local bind 
  *  (when @c start is called).
  *
+ *  @param prof Socket options applied to the socket before the bind (default is none, 
+ *  see @c socket_profile).
+ *
  *  @return @c udp_net_entity object.
  *
  */
-  udp_net_entity make_udp_unicast (const std::experimental::net::ip::udp::endpoint& endp) {
-    auto p = std::make_shared<detail::udp_entity_io>(m_ioc, endp);
+  udp_net_entity make_udp_unicast (const std::experimental::net::ip::udp::endpoint& endp,
+                                   const socket_profile& prof = socket_profile()) {
+    auto p = std::make_shared<detail::udp_entity_io>(m_ioc, endp, prof);
     std::experimental::net::post(m_ioc.get_executor(), [p, this] () { m_udp_entities.push_back(p); } );
     return udp_net_entity(p);
   }
@@ -357,14 +689,209 @@ public:
  *
  *  This @c make method is used when no UDP reads are desired, only sends.
  *
+ *  @param prof Socket options applied to the socket when it is opened (default is none, 
+ *  see @c socket_profile).
+ *
  *  @return @c udp_net_entity object.
  *
  */
-  udp_net_entity make_udp_sender () {
-    return make_udp_unicast(std::experimental::net::ip::udp::endpoint());
+  udp_net_entity make_udp_sender (const socket_profile& prof = socket_profile()) {
+    return make_udp_unicast(std::experimental::net::ip::udp::endpoint(), prof);
   }
 
-// TODO: multicast make methods 
+/**
+ *  @brief Create a UDP multicast @c net_entity for receiving multicast datagrams (sending
+ *  is also allowed, to a group or any other destination).
+ *
+ *  The socket is bound to the "any" address (IPv4 or IPv6, matching the first group) and 
+ *  the local port, with the @c multicast_options applied (address reuse, receive buffer 
+ *  size, loopback, time to live, outbound interface), and each group is joined on the
+ *  chosen interface. This is performed when the @c net_entity @c start method is 
+ *  called. Groups can be joined or left later through the @c net_entity @c join_group 
+ *  and @c leave_group methods, and per group statistics are available through 
+ *  @c get_multicast_stats.
+ *
+ *  Message handling and sending is the same as for a UDP unicast entity.
+ *
+ *  @param local_port_or_service Port number or service name for local binding.
+ *
+ *  @param groups Multicast group addresses, all IPv4 or all IPv6.
+ *
+ *  @param opts Multicast socket options.
+ *
+ *  @param prof Additional socket options, applied after the multicast options (default 
+ *  is none, see @c socket_profile).
+ *
+ *  @throw @c std::system_error if there is a name lookup failure.
+ *
+ */
+  udp_net_entity make_udp_multicast (std::string_view local_port_or_service,
+                   const std::vector<std::experimental::net::ip::address>& groups,
+                   const multicast_options& opts = multicast_options(),
+                   const socket_profile& prof = socket_profile()) {
+    auto port = m_udp_endp_cache->make_endpoints(true, "", local_port_or_service).front().port();
+    bool v6 = !groups.empty() && groups.front().is_v6();
+    return make_udp_multicast(std::experimental::net::ip::udp::endpoint(
+                                v6 ? std::experimental::net::ip::udp::v6() : 
+                                     std::experimental::net::ip::udp::v4(), port), 
+                              groups, opts, prof);
+  }
+
+/**
+ *  @brief Create a UDP multicast @c net_entity, using an already created endpoint for
+ *  the local bind.
+ *
+ *  @param endp A @c std::experimental::net::ip::udp::endpoint used for the local bind 
+ *  (when @c start is called), normally the "any" address and the group port.
+ *
+ *  @param groups Multicast group addresses, all IPv4 or all IPv6.
+ *
+ *  @param opts Multicast socket options.
+ *
+ *  @param prof Additional socket options, applied after the multicast options (default 
+ *  is none, see @c socket_profile).
+ *
+ *  @return @c udp_net_entity object.
+ *
+ */
+  udp_net_entity make_udp_multicast (const std::experimental::net::ip::udp::endpoint& endp,
+                   const std::vector<std::experimental::net::ip::address>& groups,
+                   const multicast_options& opts = multicast_options(),
+                   const socket_profile& prof = socket_profile()) {
+    auto p = std::make_shared<detail::udp_entity_io>(m_ioc, endp, groups, opts, prof);
+    std::experimental::net::post(m_ioc.get_executor(), [p, this] () { m_udp_entities.push_back(p); } );
+    return udp_net_entity(p);
+  }
+
+/**
+ *  @brief Create a local (Unix domain) stream acceptor @c net_entity, which will listen
+ *  on a path for incoming connections from the same host (once started).
+ *
+ *  The socket file is created by the bind when @c start is called and removed when the
+ *  acceptor is stopped. Accepted connections are placed on the IO context returned from
+ *  the @c net_ip selector, the same as for TCP acceptors.
+ *
+ *  @param endp A @c local::stream_protocol::endpoint (file system path, or a path 
+ *  starting with a NUL character for an abstract name) for the local bind.
+ *
+ *  @param reuse_addr If @c true (default), a stale socket file left at the path (e.g. 
+ *  by a process that was killed) is removed before the bind. The path is probed with a 
+ *  connect and the file is only removed if the connect is refused, so the socket file of 
+ *  a running server is never taken over (the start fails with @c address_in_use).
+ *
+ *  @param prof Socket options applied to each accepted socket; the TCP specific options 
+ *  are not applied (default is none, see @c socket_profile).
+ *
+ *  @param lim Connection limits and accept batching (default is no limits, see
+ *  @c accept_limits).
+ *
+ *  @return @c local_stream_acceptor_net_entity object.
+ *
+ */
+  local_stream_acceptor_net_entity make_local_stream_acceptor (
+                                             const local::stream_protocol::endpoint& endp,
+                                             bool reuse_addr = true,
+                                             const socket_profile& prof = socket_profile(),
+                                             const accept_limits& lim = accept_limits()) {
+    auto p = std::make_shared<detail::local_stream_acceptor>(m_ioc, endp, reuse_addr,
+                                                             m_ioc_selector, prof, lim);
+    lg g(m_mutex);
+    m_local_acceptors.push_back(p);
+    return local_stream_acceptor_net_entity(p);
+  }
+
+/**
+ *  @brief Create a local (Unix domain) stream connector @c net_entity.
+ *
+ *  @param endp Path (or abstract name) of a local stream acceptor.
+ *
+ *  @param reconn_time Time period in milliseconds between connect attempts. If 0, no
+ *  reconnects are attempted (default is 0).
+ *
+ *  @param prof Socket options applied to the socket before each connect (default is 
+ *  none, see @c socket_profile).
+ *
+ *  @return @c local_stream_connector_net_entity object.
+ *
+ */
+  local_stream_connector_net_entity make_local_stream_connector (
+                                             const local::stream_protocol::endpoint& endp, 
+                                             std::chrono::milliseconds reconn_time = 
+                                               std::chrono::milliseconds { },
+                                             const socket_profile& prof = socket_profile()) {
+    std::vector<local::stream_protocol::endpoint> vec { endp };
+    auto p = std::make_shared<detail::local_stream_connector>(m_ioc, vec.cbegin(), vec.cend(),
+                                                              reconn_time, prof);
+    lg g(m_mutex);
+    m_local_connectors.push_back(p);
+    return local_stream_connector_net_entity(p);
+  }
+
+/**
+ *  @brief Create a local (Unix domain) stream connector @c net_entity with connect and
+ *  reconnect options.
+ *
+ *  @param endp Path (or abstract name) of a local stream acceptor.
+ *
+ *  @param opts Connect and reconnect options, see @c tcp_connect_options (the address
+ *  family interleaving does not apply).
+ *
+ *  @param prof Socket options applied to the socket before each connect (default is 
+ *  none, see @c socket_profile).
+ *
+ *  @return @c local_stream_connector_net_entity object.
+ *
+ */
+  local_stream_connector_net_entity make_local_stream_connector (
+                                             const local::stream_protocol::endpoint& endp, 
+                                             const tcp_connect_options& opts,
+                                             const socket_profile& prof = socket_profile()) {
+    std::vector<local::stream_protocol::endpoint> vec { endp };
+    auto p = std::make_shared<detail::local_stream_connector>(m_ioc, vec.cbegin(), vec.cend(),
+                                                              opts, prof);
+    lg g(m_mutex);
+    m_local_connectors.push_back(p);
+    return local_stream_connector_net_entity(p);
+  }
+
+/**
+ *  @brief Create a local (Unix domain) datagram @c net_entity for receiving and sending.
+ *
+ *  The socket is bound to the path when @c start is called, and the socket file is 
+ *  removed when the entity is stopped. Local datagrams are not dropped by the kernel, 
+ *  and the remote endpoint passed to the message handler is the bound path of the 
+ *  sender (empty if the sender is not bound, in which case no reply can be sent).
+ *
+ *  @param endp A @c local::datagram_protocol::endpoint used for the local bind.
+ *
+ *  @param prof Socket options applied to the socket before the bind (default is none, 
+ *  see @c socket_profile).
+ *
+ *  @return @c local_datagram_net_entity object.
+ *
+ */
+  local_datagram_net_entity make_local_datagram (const local::datagram_protocol::endpoint& endp,
+                                                 const socket_profile& prof = socket_profile()) {
+    auto p = std::make_shared<detail::local_datagram_entity_io>(m_ioc, endp, prof);
+    lg g(m_mutex);
+    m_local_datagram_entities.push_back(p);
+    return local_datagram_net_entity(p);
+  }
+
+/**
+ *  @brief Create a local (Unix domain) datagram @c net_entity for sending only (no local
+ *  bind is performed).
+ *
+ *  @param prof Socket options applied to the socket when it is opened (default is none, 
+ *  see @c socket_profile).
+ *
+ *  @return @c local_datagram_net_entity object.
+ *
+ */
+  local_datagram_net_entity make_local_datagram_sender (const socket_profile& prof = 
+                                                          socket_profile()) {
+    return make_local_datagram(local::datagram_protocol::endpoint(), prof);
+  }
 
 /**
  *  @brief Remove a TCP acceptor @c net_entity from the internal list of TCP 
@@ -425,6 +952,51 @@ public:
     chops::erase_where(m_udp_entities, udp_ent.get_shared_ptr());
   }
 
+/**
+ *  @brief Remove a local stream acceptor @c net_entity from the internal list of local
+ *  stream acceptors.
+ *
+ *  @c stop should first be called by the application, or the @c stop_all 
+ *  method can be called to stop all net entities.
+ *
+ *  @param acc Local stream acceptor @c net_entity to be removed.
+ *
+ */
+  void remove(local_stream_acceptor_net_entity acc) {
+    lg g(m_mutex);
+    chops::erase_where(m_local_acceptors, acc.get_shared_ptr());
+  }
+
+/**
+ *  @brief Remove a local stream connector @c net_entity from the internal list of local
+ *  stream connectors.
+ *
+ *  @c stop should first be called by the application, or the @c stop_all 
+ *  method can be called to stop all net entities.
+ *
+ *  @param conn Local stream connector @c net_entity to be removed.
+ *
+ */
+  void remove(local_stream_connector_net_entity conn) {
+    lg g(m_mutex);
+    chops::erase_where(m_local_connectors, conn.get_shared_ptr());
+  }
+
+/**
+ *  @brief Remove a local datagram @c net_entity from the internal list of local datagram
+ *  entities.
+ *
+ *  @c stop should first be called by the application, or the @c stop_all 
+ *  method can be called to stop all net entities.
+ *
+ *  @param dg_ent Local datagram @c net_entity to be removed.
+ *
+ */
+  void remove(local_datagram_net_entity dg_ent) {
+    lg g(m_mutex);
+    chops::erase_where(m_local_datagram_entities, dg_ent.get_shared_ptr());
+  }
+
 /**
  *  @brief Remove all acceptors, connectors, and UDP entities.
  *
@@ -443,6 +1015,9 @@ public:
     m_udp_entities.clear();
     m_connectors.clear();
     m_acceptors.clear();
+    m_local_datagram_entities.clear();
+    m_local_connectors.clear();
+    m_local_acceptors.clear();
   }
 
 /**
@@ -462,6 +1037,9 @@ public:
     for (auto i : m_udp_entities) { i->stop(); }
     for (auto i : m_connectors) { i->stop(); }
     for (auto i : m_acceptors) { i->stop(); }
+    for (auto i : m_local_datagram_entities) { i->stop(); }
+    for (auto i : m_local_connectors) { i->stop(); }
+    for (auto i : m_local_acceptors) { i->stop(); }
   }
 
 };
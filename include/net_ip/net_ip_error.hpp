@@ -35,6 +35,18 @@ enum class net_ip_errc {
   tcp_acceptor_stopped = 5,
   tcp_connector_stopped = 6,
   udp_entity_stopped = 7,
+  output_queue_high_watermark = 8,
+  output_queue_low_watermark = 9,
+  output_queue_overflow = 10,
+  tcp_connect_timeout = 11,
+  read_idle_timeout = 12,
+  write_idle_timeout = 13,
+  tls_setup_failed = 14,
+  tls_handshake_failed = 15,
+  tls_handshake_timeout = 16,
+  tls_ktls_unavailable = 17,
+  request_timeout = 18,
+  request_cancelled = 19,
 };
 
 namespace detail {
@@ -59,6 +71,30 @@ struct net_ip_err_category : public std::error_category {
       return "tcp connector stopped";
     case net_ip_errc::udp_entity_stopped:
       return "udp entity stopped";
+    case net_ip_errc::output_queue_high_watermark:
+      return "output queue high watermark reached";
+    case net_ip_errc::output_queue_low_watermark:
+      return "output queue low watermark reached";
+    case net_ip_errc::output_queue_overflow:
+      return "output queue overflow";
+    case net_ip_errc::tcp_connect_timeout:
+      return "tcp connect attempt timed out";
+    case net_ip_errc::read_idle_timeout:
+      return "nothing read within the read idle timeout";
+    case net_ip_errc::write_idle_timeout:
+      return "nothing sent within the write idle timeout";
+    case net_ip_errc::tls_setup_failed:
+      return "tls context setup failed";
+    case net_ip_errc::tls_handshake_failed:
+      return "tls handshake failed";
+    case net_ip_errc::tls_handshake_timeout:
+      return "tls handshake timed out";
+    case net_ip_errc::tls_ktls_unavailable:
+      return "kernel tls could not be enabled for the connection";
+    case net_ip_errc::request_timeout:
+      return "no reply received within the request timeout";
+    case net_ip_errc::request_cancelled:
+      return "request cancelled before a reply was received";
     }
     return "(unknown error)";
   }
@@ -0,0 +1,273 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Process wide metrics registry, fed by every net entity and IO handler, with
+ *  lock-free snapshots and a Prometheus text format export.
+ *
+ *  The registry counts IO handlers (TCP connections and UDP entities) opened and closed,
+ *  accepts, connect attempts, successful connects and reconnect retries, messages and
+ *  bytes received, buffers and bytes sent, buffers dropped by output queue limits, errors
+ *  reported to error callbacks (by @c net_ip_errc, other errors are counted together) and
+ *  the total output queue depth of all IO handlers. Rates (e.g. accepts per second) are
+ *  derived by the reader from successive snapshots, as Prometheus does for counters.
+ *
+ *  Each thread that records a metric has its own block of counters, only written by that
+ *  thread with relaxed loads and stores (the same scheme as @c counting_instrumentation).
+ *  The blocks are preallocated and registered with an atomic counter, so neither
+ *  recording nor taking a snapshot ever locks, and a snapshot never stalls an IO thread.
+ *  Threads beyond @c metrics_registry::max_threads share one block, updated with atomic
+ *  read-modify-write operations. A snapshot is a sum of relaxed loads, so counters updated
+ *  during the snapshot may or may not be included.
+ *
+ *  Defining @c CHOPS_NET_IP_NO_METRICS compiles the recording out.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef NET_IP_METRICS_HPP_INCLUDED
+#define NET_IP_METRICS_HPP_INCLUDED
+
+#include <cstddef> // std::size_t
+#include <cstdint> // std::int64_t
+#include <array>
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include "net_ip/net_ip_error.hpp"
+
+namespace chops {
+namespace net {
+
+/**
+ *  @brief Metrics kept by the registry; the output queue values are gauges, the rest
+ *  are counters.
+ */
+enum class net_metric : std::size_t {
+  io_handlers_opened = 0,
+  io_handlers_closed,
+  accepts,
+  connect_attempts,
+  connects,
+  reconnects,
+  msgs_received,
+  bytes_received,
+  bufs_sent,
+  bytes_sent,
+  bufs_dropped,
+  output_queue_bufs,
+  output_queue_bytes
+};
+
+constexpr std::size_t num_net_metrics = 
+    static_cast<std::size_t>(net_metric::output_queue_bytes) + 1u;
+
+// slot 0 counts errors that are not a net_ip_errc
+constexpr std::size_t num_error_metrics = 
+    static_cast<std::size_t>(net_ip_errc::request_cancelled) + 1u;
+
+inline const char* net_metric_name(net_metric m) noexcept {
+  constexpr std::array<const char*, num_net_metrics> names { {
+    "io_handlers_opened_total", "io_handlers_closed_total", "accepts_total",
+    "connect_attempts_total", "connects_total", "reconnects_total", "msgs_received_total",
+    "bytes_received_total", "bufs_sent_total", "bytes_sent_total", "bufs_dropped_total",
+    "output_queue_bufs", "output_queue_bytes" } };
+  return names[static_cast<std::size_t>(m)];
+}
+
+inline const char* error_metric_name(std::size_t idx) noexcept {
+  constexpr std::array<const char*, num_error_metrics> names { {
+    "other", "message_handler_terminated", "weak_ptr_expired", "tcp_io_handler_stopped",
+    "udp_io_handler_stopped", "tcp_acceptor_stopped", "tcp_connector_stopped",
+    "udp_entity_stopped", "output_queue_high_watermark", "output_queue_low_watermark",
+    "output_queue_overflow", "tcp_connect_timeout", "read_idle_timeout",
+    "write_idle_timeout", "tls_setup_failed", "tls_handshake_failed",
+    "tls_handshake_timeout", "tls_ktls_unavailable", "request_timeout",
+    "request_cancelled" } };
+  return idx < num_error_metrics ? names[idx] : names[0];
+}
+
+/**
+ *  @brief Summed values of all threads, see @c metrics_registry::snapshot.
+ */
+struct metrics_snapshot {
+  std::array<std::int64_t, num_net_metrics>    values { };
+  // indexed by net_ip_errc value, index 0 is all other errors
+  std::array<std::int64_t, num_error_metrics>  errors { };
+
+  std::int64_t operator[](net_metric m) const noexcept {
+    return values[static_cast<std::size_t>(m)];
+  }
+
+  std::int64_t num_errors(net_ip_errc e) const noexcept {
+    return errors[static_cast<std::size_t>(e)];
+  }
+
+  // TCP connections and UDP entities currently open
+  std::int64_t open_io_handlers() const noexcept {
+    return (*this)[net_metric::io_handlers_opened] - (*this)[net_metric::io_handlers_closed];
+  }
+};
+
+/**
+ *  @brief Process wide metrics registry, all methods are static and can be called
+ *  concurrently from any thread.
+ */
+class metrics_registry {
+public:
+  static constexpr std::size_t max_threads = 256u;
+
+#if defined(CHOPS_NET_IP_NO_METRICS)
+  static constexpr bool enabled = false;
+#else
+  static constexpr bool enabled = true;
+#endif
+
+private:
+
+  struct thread_block {
+    std::array<std::atomic<std::int64_t>, num_net_metrics>   m_values { };
+    std::array<std::atomic<std::int64_t>, num_error_metrics> m_errors { };
+  };
+
+  struct registry {
+    std::array<thread_block, max_threads> m_blocks { };
+    thread_block                          m_shared { };
+    std::atomic_size_t                    m_num_blocks { 0u };
+  };
+
+  struct local_slot {
+    thread_block* m_block;
+    bool          m_shared;
+  };
+
+public:
+
+  static void record(net_metric m, std::int64_t val = 1) noexcept {
+    auto& slot = local();
+    add(slot, slot.m_block->m_values[static_cast<std::size_t>(m)], val);
+  }
+
+/**
+ *  @brief Count an error, by @c net_ip_errc or as an other error.
+ */
+  static void record_error(const std::error_code& err) noexcept {
+    std::size_t idx = 0u;
+    if (err.category() == get_err_category() && err.value() > 0 &&
+        static_cast<std::size_t>(err.value()) < num_error_metrics) {
+      idx = static_cast<std::size_t>(err.value());
+    }
+    auto& slot = local();
+    add(slot, slot.m_block->m_errors[idx], 1);
+  }
+
+/**
+ *  @brief Sum the values of all threads, without locking.
+ */
+  static metrics_snapshot snapshot() noexcept {
+    metrics_snapshot snap { };
+    auto& reg = get_registry();
+    std::size_t n = reg.m_num_blocks.load(std::memory_order_acquire);
+    n = (n < max_threads) ? n : max_threads;
+    for (std::size_t i = 0u; i <= n; ++i) {
+      const auto& blk = (i == n) ? reg.m_shared : reg.m_blocks[i];
+      for (std::size_t j = 0u; j < num_net_metrics; ++j) {
+        snap.values[j] += blk.m_values[j].load(std::memory_order_relaxed);
+      }
+      for (std::size_t j = 0u; j < num_error_metrics; ++j) {
+        snap.errors[j] += blk.m_errors[j].load(std::memory_order_relaxed);
+      }
+    }
+    return snap;
+  }
+
+private:
+
+  static void add(const local_slot& slot, std::atomic<std::int64_t>& ctr,
+                  std::int64_t val) noexcept {
+    if (slot.m_shared) {
+      ctr.fetch_add(val, std::memory_order_relaxed);
+      return;
+    }
+    // only this thread writes the counter, so a load and store is sufficient
+    ctr.store(ctr.load(std::memory_order_relaxed) + val, std::memory_order_relaxed);
+  }
+
+  static registry& get_registry() noexcept {
+    static registry reg;
+    return reg;
+  }
+
+  static local_slot& local() noexcept {
+    thread_local local_slot slot = [] () {
+      auto& reg = get_registry();
+      std::size_t idx = reg.m_num_blocks.fetch_add(1u, std::memory_order_acq_rel);
+      if (idx >= max_threads) {
+        return local_slot { &reg.m_shared, true };
+      }
+      return local_slot { &reg.m_blocks[idx], false };
+    } ();
+    return slot;
+  }
+};
+
+/**
+ *  @brief Format a snapshot in the Prometheus text exposition format.
+ *
+ *  @param snap Metrics snapshot.
+ *
+ *  @param prefix Metric name prefix.
+ *
+ *  @return Text with one sample per metric, errors are one sample per error name
+ *  (with an @c error label) of the @c errors_total metric.
+ */
+inline std::string metrics_to_prometheus(const metrics_snapshot& snap,
+                                         std::string_view prefix = "chops_net_ip_") {
+  std::string out;
+  auto sample = [&out, prefix] (const char* name, const char* type, std::int64_t val) {
+    out.append("# TYPE ").append(prefix).append(name).append(" ").append(type).append("\n");
+    out.append(prefix).append(name).append(" ").append(std::to_string(val)).append("\n");
+  };
+  for (std::size_t i = 0u; i < num_net_metrics; ++i) {
+    auto m = static_cast<net_metric>(i);
+    bool gauge = (m == net_metric::output_queue_bufs || m == net_metric::output_queue_bytes);
+    sample(net_metric_name(m), gauge ? "gauge" : "counter", snap.values[i]);
+  }
+  sample("io_handlers_open", "gauge", snap.open_io_handlers());
+  out.append("# TYPE ").append(prefix).append("errors_total counter\n");
+  for (std::size_t i = 0u; i < num_error_metrics; ++i) {
+    out.append(prefix).append("errors_total{error=\"").append(error_metric_name(i));
+    out.append("\"} ").append(std::to_string(snap.errors[i])).append("\n");
+  }
+  return out;
+}
+
+namespace detail {
+
+inline void record_metric(net_metric m, std::int64_t val = 1) noexcept {
+  if constexpr (metrics_registry::enabled) {
+    metrics_registry::record(m, val);
+  }
+}
+
+inline void record_error_metric(const std::error_code& err) noexcept {
+  if constexpr (metrics_registry::enabled) {
+    metrics_registry::record_error(err);
+  }
+}
+
+} // end detail namespace
+
+} // end net namespace
+} // end chops namespace
+
+#endif
+
@@ -0,0 +1,60 @@
+/** @file 
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Output queue limits and overflow policy for an IO handler.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0. 
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef OUTPUT_QUEUE_LIMITS_HPP_INCLUDED
+#define OUTPUT_QUEUE_LIMITS_HPP_INCLUDED
+
+#include <cstddef> // std::size_t 
+
+namespace chops {
+namespace net {
+
+/**
+ *  @brief Action taken when a buffer is sent and the output queue is at its limit.
+ *
+ *  @c drop_newest discards the buffer being sent. @c drop_oldest queues the buffer 
+ *  and discards the oldest queued buffers until the queue is within its limits. 
+ *  @c coalesce queues the buffer and discards every older queued buffer, which suits
+ *  streams where only the latest message (e.g. a state snapshot) matters. 
+ *  @c disconnect queues the buffer and shuts down the IO handler, reporting a 
+ *  @c net_ip_errc::output_queue_overflow error.
+ *
+ *  Buffers already handed to a write operation are never discarded.
+ */
+enum class overflow_policy { drop_newest, drop_oldest, coalesce, disconnect };
+
+/**
+ *  @brief @c output_queue_limits bound the output queue of an IO handler (see 
+ *  @c basic_io_interface @c set_output_queue_limits).
+ *
+ *  A limit of 0 means no limit. The watermarks are byte counts; when the bytes in the 
+ *  output queue reach the high watermark a @c net_ip_errc::output_queue_high_watermark
+ *  notification is delivered, and when they fall back to the low watermark (or below) 
+ *  a @c net_ip_errc::output_queue_low_watermark notification follows. A high watermark 
+ *  of 0 disables the notifications.
+ */
+struct output_queue_limits {
+  std::size_t     max_bufs = 0;
+  std::size_t     max_bytes = 0;
+  std::size_t     high_watermark = 0;
+  std::size_t     low_watermark = 0;
+  overflow_policy policy = overflow_policy::drop_newest;
+};
+
+} // end net namespace
+} // end chops namespace
+
+#endif
+
@@ -0,0 +1,66 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief A reference counted buffer with pooled storage, which can be passed to the
+ *  @c basic_io_interface @c send method of a TCP IO handler.
+ *
+ *  A @c pooled_buffer is created by a @c buffer_pool (see @c make_pooled_buffer). The
+ *  storage goes back to the pool when the last handle (including the handles in output
+ *  queues) is destroyed, so buffers that are sent are recycled without a @c release
+ *  call.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef POOLED_BUFFER_HPP_INCLUDED
+#define POOLED_BUFFER_HPP_INCLUDED
+
+#include <vector>
+#include <memory> // std::shared_ptr
+#include <cstddef> // std::size_t, std::byte
+#include <utility> // std::move
+
+namespace chops {
+namespace net {
+
+/**
+ *  @brief A reference counted byte buffer, where the storage is returned to its pool
+ *  when the last reference drops.
+ *
+ *  Copies share the storage. As with @c chops::mutable_shared_buffer the bytes can be
+ *  modified, which should only be done before the buffer is sent.
+ */
+class pooled_buffer {
+public:
+  using byte_vec = std::vector<std::byte>;
+
+private:
+  std::shared_ptr<byte_vec> m_data;
+
+public:
+  pooled_buffer() noexcept : m_data() { }
+
+  // the deleter of the shared pointer gives the storage back to the pool
+  explicit pooled_buffer(std::shared_ptr<byte_vec> p) noexcept : m_data(std::move(p)) { }
+
+  std::byte* data() noexcept { return m_data ? m_data->data() : nullptr; }
+
+  const std::byte* data() const noexcept { return m_data ? m_data->data() : nullptr; }
+
+  std::size_t size() const noexcept { return m_data ? m_data->size() : 0u; }
+
+  bool empty() const noexcept { return size() == 0u; }
+};
+
+} // end net namespace
+} // end chops namespace
+
+#endif
+
@@ -17,23 +17,91 @@
 #define QUEUE_STATS_HPP_INCLUDED
 
 #include <cstddef> // std::size_t 
+#include <array>
+#include <algorithm> // std::max
 
 namespace chops {
 namespace net {
 
 /**
  *  @brief @c output_queue_stats provides information on the internal output 
- *  queue.
+ *  queue, as well as send and receive totals for an IO handler.
+ *
+ *  The write batch counts are only updated when gather write batching is enabled 
+ *  on a TCP or UDP IO handler (see @c basic_io_interface @c set_write_batch_limits). The
+ *  average batch size is @c bufs_in_write_batches divided by @c num_write_batches.
+ *
+ *  Sent totals are updated when a write completes, and received totals when a message 
+ *  is passed to the message handler. The high-water marks are the largest queue size and
+ *  byte count since the IO handler was created. @c num_queued_while_busy counts
+ *  buffers that were queued because a write was already in progress, and 
+ *  @c num_dropped counts buffers discarded by the output queue overflow policy (see
+ *  @c output_queue_limits).
+ *
+ *  The latency histogram counts buffers by queue residency time, from the @c send call
+ *  until the write containing the buffer completed. Bucket 0 counts times under 1 
+ *  microsecond, bucket @c i counts times from 2^(i-1) up to 2^i microseconds, and the 
+ *  last bucket counts everything from 2^(i-1) microseconds up.
+ *
+ *  @c read_buffer_bytes is the current capacity of the IO handler read buffers, and
+ *  @c max_read_buffer_bytes the largest since the IO handler was created (see
+ *  @c read_buffer_policy).
  */
 
 struct output_queue_stats {
 
+  static constexpr std::size_t num_latency_buckets = 20;
+
   std::size_t output_queue_size = 0;
   std::size_t bytes_in_output_queue = 0;
-  // std::size_t total_bufs_sent;
-  // std::size_t total_bytes_sent;
+  std::size_t num_write_batches = 0;
+  std::size_t bufs_in_write_batches = 0;
+  std::size_t max_bufs_in_write_batch = 0;
+  std::size_t total_bufs_sent = 0;
+  std::size_t total_bytes_sent = 0;
+  std::size_t total_msgs_received = 0;
+  std::size_t total_bytes_received = 0;
+  std::size_t max_output_queue_size = 0;
+  std::size_t max_bytes_in_output_queue = 0;
+  std::size_t num_queued_while_busy = 0;
+  std::size_t num_dropped = 0;
+  std::size_t max_latency_usec = 0;
+  std::size_t read_buffer_bytes = 0;
+  std::size_t max_read_buffer_bytes = 0;
+  std::array<std::size_t, num_latency_buckets> latency_histogram { };
 };
 
+/**
+ *  @brief Add the statistics of one IO handler to a total, e.g. for all of the IO handlers
+ *  of a @c send_to_all collection.
+ *
+ *  Counts, totals, current sizes and the latency histogram are summed, high-water marks
+ *  are the largest of the IO handlers.
+ */
+inline void accumulate_output_queue_stats(output_queue_stats& tot, 
+                                          const output_queue_stats& qs) noexcept {
+  tot.output_queue_size += qs.output_queue_size;
+  tot.bytes_in_output_queue += qs.bytes_in_output_queue;
+  tot.num_write_batches += qs.num_write_batches;
+  tot.bufs_in_write_batches += qs.bufs_in_write_batches;
+  tot.max_bufs_in_write_batch = std::max(tot.max_bufs_in_write_batch, qs.max_bufs_in_write_batch);
+  tot.total_bufs_sent += qs.total_bufs_sent;
+  tot.total_bytes_sent += qs.total_bytes_sent;
+  tot.total_msgs_received += qs.total_msgs_received;
+  tot.total_bytes_received += qs.total_bytes_received;
+  tot.max_output_queue_size = std::max(tot.max_output_queue_size, qs.max_output_queue_size);
+  tot.max_bytes_in_output_queue = 
+    std::max(tot.max_bytes_in_output_queue, qs.max_bytes_in_output_queue);
+  tot.num_queued_while_busy += qs.num_queued_while_busy;
+  tot.num_dropped += qs.num_dropped;
+  tot.max_latency_usec = std::max(tot.max_latency_usec, qs.max_latency_usec);
+  tot.read_buffer_bytes += qs.read_buffer_bytes;
+  tot.max_read_buffer_bytes = std::max(tot.max_read_buffer_bytes, qs.max_read_buffer_bytes);
+  for (std::size_t i = 0; i < tot.latency_histogram.size(); ++i) {
+    tot.latency_histogram[i] += qs.latency_histogram[i];
+  }
+}
+
 } // end net namespace
 } // end chops namespace
 
@@ -0,0 +1,61 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Read buffer sizing policy for an IO handler.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef READ_BUFFER_POLICY_HPP_INCLUDED
+#define READ_BUFFER_POLICY_HPP_INCLUDED
+
+#include <cstddef> // std::size_t, std::byte
+#include <functional>
+#include <vector>
+
+namespace chops {
+namespace net {
+
+/**
+ *  @brief @c read_buffer_policy bounds the read buffer memory of an idle IO handler (see
+ *  @c basic_io_interface @c set_read_buffer_policy).
+ *
+ *  By default a TCP IO handler read buffer keeps the capacity of the largest message that
+ *  has been received, and a UDP IO handler read buffer is always the max datagram size.
+ *  With a non-zero @c shrink_size, a TCP read buffer that has grown above the shrink size
+ *  for a large message is shrunk back (to the header, read-ahead or delimiter read size)
+ *  once the message has been delivered, and a UDP IO handler only holds a max size buffer
+ *  while a datagram is being received (it waits for the socket to be readable first); the
+ *  non-batched UDP read path is the only one affected.
+ *
+ *  The optional @c acquire and @c release function objects supply the large buffers
+ *  (e.g. from a shared @c buffer_pool, see @c make_pooled_read_buffer_policy), so many
+ *  connections share a few large buffers, each borrowed only while a large message is in
+ *  flight. @c acquire returns a vector with at least the requested capacity (its
+ *  contents are overwritten), and @c release takes back a buffer that is no longer used.
+ *  Both are called within the IO handler strand, and are only used with a non-zero
+ *  shrink size.
+ *
+ *  A shared buffer message handler takes ownership of the read buffer of a message,
+ *  which is then not released.
+ */
+struct read_buffer_policy {
+  using byte_vec = std::vector<std::byte>;
+
+  std::size_t                            shrink_size = 0u;
+  std::function<byte_vec (std::size_t)>  acquire { };
+  std::function<void (byte_vec&&)>       release { };
+};
+
+} // end net namespace
+} // end chops namespace
+
+#endif
+
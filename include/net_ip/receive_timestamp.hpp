@@ -0,0 +1,70 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Kernel and hardware receive timestamps, passed to message handlers.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef RECEIVE_TIMESTAMP_HPP_INCLUDED
+#define RECEIVE_TIMESTAMP_HPP_INCLUDED
+
+#include <chrono>
+
+namespace chops {
+namespace net {
+
+/**
+ *  @brief @c receive_timestamp holds the times an incoming message was received by the
+ *  kernel and by the network device (see @c basic_io_interface @c set_receive_timestamps).
+ *
+ *  A message handler taking a @c receive_timestamp as a fourth parameter is given the
+ *  timestamps of the message:
+ *
+ *  @code
+ *    bool msg_hdlr(std::experimental::net::const_buffer buf, chops::net::udp_io_interface io,
+ *                  std::experimental::net::ip::udp::endpoint endp,
+ *                  const chops::net::receive_timestamp& ts) {
+ *      auto queued = std::chrono::system_clock::now() - ts.software_time();
+ *      // ...
+ *    }
+ *  @endcode
+ *
+ *  The @c software time is when the kernel received the packet, from the system real
+ *  time clock, so the difference with @c std::chrono::system_clock::now in the message
+ *  handler is the time spent in the socket receive queue and the IO handler. The
+ *  @c hardware time is from the clock of the network device, only available when the
+ *  device supports receive timestamps and they are enabled on the device (e.g. with
+ *  @c hwstamp_ctl or the @c SIOCSHWTSTAMP ioctl, which needs administrator privileges);
+ *  the device clock is not normally synchronized with the system clock.
+ *
+ *  A value of 0 means the timestamp is not available, e.g. when timestamps are not
+ *  enabled, or not supported by the platform or the device. For TCP the timestamps are
+ *  of the most recent segment of the read that completed the message.
+ */
+struct receive_timestamp {
+  // since the epoch of the clock
+  std::chrono::nanoseconds  software { 0 };
+  std::chrono::nanoseconds  hardware { 0 };
+
+  bool has_software() const noexcept { return software.count() != 0; }
+  bool has_hardware() const noexcept { return hardware.count() != 0; }
+
+  std::chrono::system_clock::time_point software_time() const noexcept {
+    return std::chrono::system_clock::time_point(
+                std::chrono::duration_cast<std::chrono::system_clock::duration>(software));
+  }
+};
+
+} // end net namespace
+} // end chops namespace
+
+#endif
+
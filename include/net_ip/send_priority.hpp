@@ -0,0 +1,62 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Send priority classes and the scheduling policy of the output queue lanes of
+ *  an IO handler.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef SEND_PRIORITY_HPP_INCLUDED
+#define SEND_PRIORITY_HPP_INCLUDED
+
+#include <cstddef> // std::size_t
+#include <array>
+
+namespace chops {
+namespace net {
+
+/**
+ *  @brief Priority class of a buffer passed to a @c send method.
+ *
+ *  Each priority class has its own lane in the output queue of an IO handler, so
+ *  latency critical messages (e.g. heartbeats or acknowledgements) are not queued behind
+ *  a bulk backlog. A @c send without a priority uses @c normal.
+ */
+enum class send_priority : std::size_t { high = 0, normal = 1, bulk = 2 };
+
+inline constexpr std::size_t num_send_priorities = 3u;
+
+/**
+ *  @brief How the IO handler drains the output queue lanes.
+ *
+ *  @c strict always takes the next buffer from the highest priority lane that is not
+ *  empty, so lower lanes can be starved. @c weighted_round_robin takes up to the lane
+ *  weight of buffers from each lane in turn, so every lane makes progress.
+ */
+enum class lane_schedule { strict, weighted_round_robin };
+
+/**
+ *  @brief @c send_lane_policy sets the scheduling of the output queue lanes (see
+ *  @c basic_io_interface @c set_send_lane_policy).
+ *
+ *  The weights are indexed by @c send_priority, and a weight of 0 is treated as 1. They
+ *  are only used for @c weighted_round_robin scheduling.
+ */
+struct send_lane_policy {
+  lane_schedule                                 schedule = lane_schedule::strict;
+  std::array<std::size_t, num_send_priorities> weights { { 8u, 4u, 1u } };
+};
+
+} // end net namespace
+} // end chops namespace
+
+#endif
+
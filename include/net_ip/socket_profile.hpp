@@ -0,0 +1,78 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Socket options profile applied to TCP and UDP sockets when they are created.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef SOCKET_PROFILE_HPP_INCLUDED
+#define SOCKET_PROFILE_HPP_INCLUDED
+
+#include <chrono>
+
+namespace chops {
+namespace net {
+
+/**
+ *  @brief A @c socket_profile is a set of socket options applied by the library to each
+ *  socket of a net entity, before the first read or write (see the @c net_ip @c make_*
+ *  methods).
+ *
+ *  For a TCP acceptor the options are applied to each accepted socket, for a TCP
+ *  connector they are applied to each socket before the connect (so buffer sizes are
+ *  in place for the TCP window negotiation), and for a UDP entity they are applied
+ *  before the socket is bound.
+ *
+ *  Each value of 0 (or @c false) leaves the system default in place. Options not
+ *  available on a platform are ignored, and TCP level options are ignored for UDP
+ *  sockets. A failure to set an option (e.g. @c busy_poll may need extra privileges)
+ *  is reported through the error callback and does not stop the entity.
+ *
+ *  Notes on some of the options (Linux names):
+ *  - @c quick_ack (@c TCP_QUICKACK) is not permanent, the system may turn it off again.
+ *  - @c busy_poll (@c SO_BUSY_POLL) is in microseconds.
+ *  - @c tos is @c IP_TOS for IPv4 and @c IPV6_TCLASS for IPv6 sockets.
+ *  - @c zero_copy (@c SO_ZEROCOPY) only allows zero copy sends, it does not change how
+ *  data is sent by itself.
+ *  - Note that the system may limit (or double) the buffer sizes.
+ */
+
+struct socket_profile {
+  bool                      no_delay = false;
+  int                       send_buffer_size = 0;
+  int                       receive_buffer_size = 0;
+  bool                      quick_ack = false;
+  int                       busy_poll = 0;
+  int                       tos = 0;
+  std::chrono::milliseconds user_timeout { };
+  bool                      keep_alive = false;
+  std::chrono::seconds      keep_alive_idle { };
+  std::chrono::seconds      keep_alive_interval { };
+  int                       keep_alive_count = 0;
+  bool                      zero_copy = false;
+};
+
+/**
+ *  @brief Return a @c socket_profile for low latency TCP messaging, with Nagle's
+ *  algorithm and delayed acks disabled.
+ */
+inline socket_profile make_low_latency_socket_profile() {
+  socket_profile prof;
+  prof.no_delay = true;
+  prof.quick_ack = true;
+  return prof;
+}
+
+} // end net namespace
+} // end chops namespace
+
+#endif
+
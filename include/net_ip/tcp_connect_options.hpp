@@ -0,0 +1,60 @@
+/** @file 
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief Structure for TCP connector connect and reconnect options.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0. 
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef TCP_CONNECT_OPTIONS_HPP_INCLUDED
+#define TCP_CONNECT_OPTIONS_HPP_INCLUDED
+
+#include <chrono>
+
+namespace chops {
+namespace net {
+
+/**
+ *  @brief @c tcp_connect_options control how a TCP connector tries its remote endpoints
+ *  and how it waits between connect rounds (see @c net_ip @c make_tcp_connector).
+ *
+ *  A connect round tries the remote endpoints, with IPv6 and IPv4 endpoints interleaved 
+ *  (IPv6 first, as in RFC 8305 "happy eyeballs"). With an @c attempt_delay of 0 the 
+ *  endpoints are tried one at a time. Otherwise the next endpoint is tried when the 
+ *  previous attempt fails or when the attempt delay expires, whichever is first, so 
+ *  several attempts may be in flight; the first to connect is used and the others are 
+ *  cancelled. With a non-zero @c attempt_timeout an attempt still in flight after the 
+ *  timeout is cancelled, instead of waiting out the system TCP connect timeout.
+ *
+ *  When a round fails the connector waits before the next round. The first wait is 
+ *  @c reconn_time, and each further wait is multiplied by @c backoff_multiplier, up 
+ *  to @c max_reconn_time (0 means the wait is always @c reconn_time). With a 
+ *  @c jitter fraction above 0 each wait is shortened by a random amount of up to that
+ *  fraction, so many connectors do not reconnect in lockstep (e.g. a jitter of 1.0 
+ *  waits a random time between 0 and the backoff time). The backoff is reset by a 
+ *  successful connect, and when the connector is started.
+ *
+ *  The default values match a connector created with a fixed reconnect time of 0.
+ */
+
+struct tcp_connect_options {
+  std::chrono::milliseconds reconn_time { };
+  std::chrono::milliseconds max_reconn_time { };
+  double                    backoff_multiplier = 2.0;
+  double                    jitter = 0.0;
+  std::chrono::milliseconds attempt_timeout { };
+  std::chrono::milliseconds attempt_delay { };
+};
+
+} // end net namespace
+} // end chops namespace
+
+#endif
+
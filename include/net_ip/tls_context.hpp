@@ -0,0 +1,253 @@
+/** @file
+ *
+ *  @ingroup net_ip_module
+ *
+ *  @brief TLS configuration and context, shared by the TLS TCP acceptors and connectors
+ *  created through @c net_ip @c make_tls_tcp_acceptor and @c make_tls_tcp_connector.
+ *
+ *  The TLS handshake is performed with OpenSSL on the connected socket, after which the
+ *  record layer is handed to the kernel (Linux kernel TLS, "kTLS"), which encrypts and
+ *  decrypts in the socket layer (or offloads to the NIC). The TCP IO handler then reads
+ *  and writes plain bytes, so message framing and gather writes are the same as for a
+ *  plain TCP connection, without a user space record copy. The kernel TLS socket layer
+ *  rejects @c MSG_ZEROCOPY sends, so the zero copy threshold of a TLS connection is
+ *  ignored and its writes use the normal write path.
+ *
+ *  This requires OpenSSL 3 built with kTLS support, the Linux @c tls kernel module, and
+ *  a cipher supported by kTLS (the default cipher list only has AES-GCM suites). TLS 1.2
+ *  is used, since TLS 1.3 post-handshake messages (e.g. session tickets) would arrive on
+ *  the kernel receive path as non-data records. A connection where kTLS cannot be
+ *  enabled fails with a @c net_ip_errc::tls_ktls_unavailable error; there is no user
+ *  space record layer fallback.
+ *
+ *  Session resumption keeps reconnect handshakes cheap: the server issues session
+ *  tickets (RFC 5077) and a client context keeps the last session of each remote host
+ *  and port, which a TCP connector offers on its next connect.
+ *
+ *  Available when @c CHOPS_NET_TLS is defined; the application links with @c libssl
+ *  and @c libcrypto.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#ifndef TLS_CONTEXT_HPP_INCLUDED
+#define TLS_CONTEXT_HPP_INCLUDED
+
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+
+#include <string>
+#include <memory> // std::unique_ptr, std::shared_ptr
+#include <mutex>
+#include <map>
+#include <deque>
+#include <chrono>
+#include <cstddef> // std::size_t
+#include <utility> // std::move
+
+#include "net_ip/net_ip_error.hpp"
+
+namespace chops {
+namespace net {
+
+/**
+ *  @brief @c tls_config holds the certificate, verification and session options of a
+ *  @c tls_context.
+ *
+ *  A server needs @c cert_file (a PEM certificate chain) and @c key_file. A client
+ *  verifies the server certificate against @c ca_file (or the system default paths if
+ *  empty) when @c verify_peer is set, and checks the host name against @c server_name,
+ *  which is also sent as the SNI name; if empty, a TCP connector uses its remote host
+ *  name.
+ *
+ *  A handshake not completed within @c handshake_timeout fails with a
+ *  @c net_ip_errc::tls_handshake_timeout error (0 means no timeout). A client context
+ *  keeps up to @c session_cache_size sessions for resumption (0 disables resumption).
+ */
+struct tls_config {
+  std::string               cert_file;
+  std::string               key_file;
+  std::string               ca_file;
+  bool                      verify_peer = true;
+  std::string               server_name;
+  std::string               cipher_list = "ECDHE+AESGCM";
+  std::chrono::milliseconds handshake_timeout { 10000 };
+  std::size_t               session_cache_size = 256u;
+};
+
+/**
+ *  @brief A @c tls_context wraps an OpenSSL @c SSL_CTX, for the client or the server
+ *  side, and the client session cache.
+ *
+ *  A context is shared (through a @c tls_context_ptr) by any number of acceptors or
+ *  connectors, and is safe to use from multiple threads.
+ */
+class tls_context {
+public:
+  enum class role { client, server };
+
+private:
+  struct ctx_deleter {
+    void operator()(SSL_CTX* p) const noexcept { SSL_CTX_free(p); }
+  };
+  struct session_deleter {
+    void operator()(SSL_SESSION* p) const noexcept { SSL_SESSION_free(p); }
+  };
+
+public:
+  using session_ptr = std::unique_ptr<SSL_SESSION, session_deleter>;
+
+private:
+  using lg = std::lock_guard<std::mutex>;
+
+  std::unique_ptr<SSL_CTX, ctx_deleter> m_ctx;
+  role                                  m_role;
+  tls_config                            m_cfg;
+  mutable std::mutex                    m_mutex;
+  std::map<std::string, session_ptr>    m_sessions;
+  std::deque<std::string>               m_session_order; // oldest first
+
+public:
+
+/**
+ *  @brief Construct a @c tls_context.
+ *
+ *  @param r Client or server side.
+ *
+ *  @param cfg Certificate, verification and session options.
+ *
+ *  @throw A @c net_ip_exception with a @c net_ip_errc::tls_setup_failed error if the
+ *  OpenSSL context cannot be created, or a certificate or key cannot be loaded.
+ */
+  tls_context(role r, const tls_config& cfg) :
+      m_ctx(SSL_CTX_new(r == role::server ? TLS_server_method() : TLS_client_method())),
+      m_role(r), m_cfg(cfg), m_mutex(), m_sessions(), m_session_order() {
+    if (!m_ctx) {
+      setup_failed();
+    }
+    SSL_CTX* ctx = m_ctx.get();
+    // the kernel record layer only carries TLS 1.2 application data, see file comment
+    SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+    SSL_CTX_set_max_proto_version(ctx, TLS1_2_VERSION);
+    SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS | SSL_OP_NO_RENEGOTIATION |
+                             SSL_OP_NO_COMPRESSION);
+    if (!m_cfg.cipher_list.empty() &&
+        SSL_CTX_set_cipher_list(ctx, m_cfg.cipher_list.c_str()) != 1) {
+      setup_failed();
+    }
+    if (r == role::server) {
+      if (SSL_CTX_use_certificate_chain_file(ctx, m_cfg.cert_file.c_str()) != 1 ||
+          SSL_CTX_use_PrivateKey_file(ctx, m_cfg.key_file.c_str(), SSL_FILETYPE_PEM) != 1 ||
+          SSL_CTX_check_private_key(ctx) != 1) {
+        setup_failed();
+      }
+      return;
+    }
+    if (m_cfg.verify_peer) {
+      SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, nullptr);
+      int ok = m_cfg.ca_file.empty() ? SSL_CTX_set_default_verify_paths(ctx) :
+                 SSL_CTX_load_verify_locations(ctx, m_cfg.ca_file.c_str(), nullptr);
+      if (ok != 1) {
+        setup_failed();
+      }
+    }
+    // sessions are kept by this object, keyed by remote host and port
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT |
+                                        SSL_SESS_CACHE_NO_INTERNAL_STORE);
+  }
+
+private:
+  tls_context(const tls_context&) = delete;
+  tls_context& operator=(const tls_context&) = delete;
+
+public:
+
+  bool is_server() const noexcept { return m_role == role::server; }
+
+  const tls_config& get_config() const noexcept { return m_cfg; }
+
+/**
+ *  @brief Return the OpenSSL context, for further application configuration (e.g.
+ *  ALPN or client certificates) before any handshake.
+ */
+  SSL_CTX* native_handle() const noexcept { return m_ctx.get(); }
+
+/**
+ *  @brief Keep a session for resumption, replacing the previous session for the key.
+ */
+  void save_session(const std::string& key, session_ptr sess) {
+    if (!sess || m_cfg.session_cache_size == 0u) {
+      return;
+    }
+    lg g(m_mutex);
+    auto it = m_sessions.find(key);
+    if (it != m_sessions.end()) {
+      it->second = std::move(sess);
+      return;
+    }
+    while (m_sessions.size() >= m_cfg.session_cache_size && !m_session_order.empty()) {
+      m_sessions.erase(m_session_order.front());
+      m_session_order.pop_front();
+    }
+    m_sessions.emplace(key, std::move(sess));
+    m_session_order.push_back(key);
+  }
+
+/**
+ *  @brief Return the saved session for the key (with its own reference), or an empty
+ *  pointer.
+ */
+  session_ptr find_session(const std::string& key) const {
+    lg g(m_mutex);
+    auto it = m_sessions.find(key);
+    if (it == m_sessions.end() || SSL_SESSION_up_ref(it->second.get()) != 1) {
+      return session_ptr();
+    }
+    return session_ptr(it->second.get());
+  }
+
+  std::size_t num_sessions() const {
+    lg g(m_mutex);
+    return m_sessions.size();
+  }
+
+private:
+
+  [[noreturn]] static void setup_failed() {
+    ERR_clear_error();
+    throw net_ip_exception(std::make_error_code(net_ip_errc::tls_setup_failed));
+  }
+
+};
+
+using tls_context_ptr = std::shared_ptr<tls_context>;
+
+/**
+ *  @brief Create a client side @c tls_context, for TLS TCP connectors.
+ *
+ *  @throw A @c net_ip_exception, see @c tls_context constructor.
+ */
+inline tls_context_ptr make_tls_client_context(const tls_config& cfg = tls_config()) {
+  return std::make_shared<tls_context>(tls_context::role::client, cfg);
+}
+
+/**
+ *  @brief Create a server side @c tls_context, for TLS TCP acceptors.
+ *
+ *  @throw A @c net_ip_exception, see @c tls_context constructor.
+ */
+inline tls_context_ptr make_tls_server_context(const tls_config& cfg) {
+  return std::make_shared<tls_context>(tls_context::role::server, cfg);
+}
+
+} // end net namespace
+} // end chops namespace
+
+#endif
+
@@ -32,6 +32,7 @@
 #define SHARED_UTILITY_TEST_HPP_INCLUDED
 
 #include <string_view>
+#include <chrono>
 #include <cstddef> // std::size_t, std::byte
 #include <cstdint> // std::uint16_t
 #include <vector>
@@ -40,6 +41,7 @@
 #include <memory> // std::shared_ptr
 #include <thread>
 #include <system_error>
+#include <functional> // std::function
 
 #include <cassert>
 #include <limits>
@@ -56,6 +58,7 @@
 #include "net_ip/io_interface.hpp"
 
 #include "net_ip/component/simple_variable_len_msg_frame.hpp"
+#include "net_ip/component/length_field_msg_frame.hpp"
 
 namespace chops {
 namespace test {
@@ -96,6 +99,9 @@ inline std::size_t decode_variable_len_msg_hdr(const std::byte* buf_ptr, std::si
   return boost::endian::big_to_native(hdr);
 }
 
+// the same header, decoded inline by the TCP IO handler
+using variable_len_hdr = chops::net::length_field<0, 2>;
+
 template <typename F>
 chops::const_shared_buffer make_empty_body_msg(F&& func) {
   return func( chops::mutable_shared_buffer{ } );
@@ -147,11 +153,86 @@ struct msg_hdlr {
 
 };
 
+// same logic as msg_hdlr, but takes ownership of the incoming buffer, replies without a copy
+template <typename IOT>
+struct shared_buf_msg_hdlr {
+  using endp_type = typename IOT::endpoint_type;
+
+  bool               reply;
+  test_counter&      cnt;
+
+  shared_buf_msg_hdlr(bool rep, test_counter& c) : reply(rep), cnt(c) { }
+
+  bool operator()(chops::const_shared_buffer sh_buf, chops::net::basic_io_interface<IOT> io_intf, 
+                  endp_type endp) {
+    bool not_shutdown = sh_buf.size() > 2;
+    if (not_shutdown) {
+      ++cnt;
+    }
+    if (reply) {
+      io_intf.send(sh_buf, endp);
+    }
+    return not_shutdown;
+  }
+
+};
+
+// same logic as shared_buf_msg_hdlr, but uses a borrowed io ref and moves the buffer into
+// the reply, so there are no reference count operations per message
+template <typename IOT>
+struct io_ref_msg_hdlr {
+  using endp_type = typename IOT::endpoint_type;
+
+  bool               reply;
+  test_counter&      cnt;
+
+  io_ref_msg_hdlr(bool rep, test_counter& c) : reply(rep), cnt(c) { }
+
+  bool operator()(chops::const_shared_buffer sh_buf, chops::net::basic_io_ref<IOT> io_ref, 
+                  endp_type endp) {
+    bool not_shutdown = sh_buf.size() > 2;
+    if (not_shutdown) {
+      ++cnt;
+    }
+    if (reply) {
+      io_ref.send(std::move(sh_buf), endp);
+    }
+    return not_shutdown;
+  }
+
+};
+
 using tcp_msg_hdlr = msg_hdlr<chops::net::tcp_io>;
 using udp_msg_hdlr = msg_hdlr<chops::net::udp_io>;
+using tcp_shared_buf_msg_hdlr = shared_buf_msg_hdlr<chops::net::tcp_io>;
+using udp_shared_buf_msg_hdlr = shared_buf_msg_hdlr<chops::net::udp_io>;
+using tcp_io_ref_msg_hdlr = io_ref_msg_hdlr<chops::net::tcp_io>;
 
 inline bool tcp_start_io (chops::net::tcp_io_interface io, bool reply, 
-                   std::string_view delim, test_counter& cnt) {
+                   std::string_view delim, test_counter& cnt, bool shared_buf = false,
+                   std::size_t read_ahead = 0, bool io_ref = false) {
+  if (io_ref) {
+    if (delim.empty()) {
+      return io.start_io(2, tcp_io_ref_msg_hdlr(reply, cnt), 
+                   chops::net::make_simple_variable_len_msg_frame(decode_variable_len_msg_hdr));
+    }
+    return io.start_io(delim, tcp_io_ref_msg_hdlr(reply, cnt)); 
+  }
+  if (read_ahead != 0 && delim.empty()) {
+    if (shared_buf) {
+      return io.start_io(2, read_ahead, tcp_shared_buf_msg_hdlr(reply, cnt), 
+                   chops::net::make_simple_variable_len_msg_frame(decode_variable_len_msg_hdr));
+    }
+    return io.start_io(2, read_ahead, tcp_msg_hdlr(reply, cnt), 
+                       chops::net::make_simple_variable_len_msg_frame(decode_variable_len_msg_hdr));
+  }
+  if (shared_buf) {
+    if (delim.empty()) {
+      return io.start_io(2, tcp_shared_buf_msg_hdlr(reply, cnt), 
+                   chops::net::make_simple_variable_len_msg_frame(decode_variable_len_msg_hdr));
+    }
+    return io.start_io(delim, tcp_shared_buf_msg_hdlr(reply, cnt));
+  }
   if (delim.empty()) {
     return io.start_io(2, tcp_msg_hdlr(reply, cnt), 
                        chops::net::make_simple_variable_len_msg_frame(decode_variable_len_msg_hdr));
@@ -159,6 +240,17 @@ inline bool tcp_start_io (chops::net::tcp_io_interface io, bool reply,
   return io.start_io(delim, tcp_msg_hdlr(reply, cnt));
 }
 
+// variable len msgs, framed by the compile time length field message frame
+inline bool tcp_start_io_length_field (chops::net::tcp_io_interface io, bool reply, 
+                   test_counter& cnt, std::size_t read_ahead = 0) {
+  if (read_ahead != 0) {
+    return io.start_io(variable_len_hdr::hdr_size, read_ahead, tcp_msg_hdlr(reply, cnt), 
+                       chops::net::make_length_field_msg_frame<variable_len_hdr>());
+  }
+  return io.start_io(variable_len_hdr::hdr_size, tcp_msg_hdlr(reply, cnt), 
+                     chops::net::make_length_field_msg_frame<variable_len_hdr>());
+}
+
 constexpr int udp_max_buf_size = 65507;
 
 inline bool udp_start_io (chops::net::udp_io_interface io, bool reply, test_counter& cnt) {
@@ -194,7 +286,73 @@ struct io_handler_mock {
   void send(chops::const_shared_buffer) { send_called = true; }
   void send(chops::const_shared_buffer, const endpoint_type&) { send_called = true; }
 
+  bool priority_send_called = false;
+
+  void send(chops::const_shared_buffer, chops::net::send_priority) { 
+    priority_send_called = true;
+  }
+  void send(chops::const_shared_buffer, const endpoint_type&, chops::net::send_priority) { 
+    priority_send_called = true;
+  }
+
+  chops::net::output_queue_stats get_output_queue_stats(chops::net::send_priority) const { 
+    return chops::net::output_queue_stats { qs_base + 2 };
+  }
+
+  bool lane_policy_set = false;
+
+  void set_send_lane_policy(const chops::net::send_lane_policy&) { lane_policy_set = true; }
+
+  bool batch_limits_set = false;
+
+  void set_write_batch_limits(std::size_t, std::size_t) { batch_limits_set = true; }
+
+  bool queue_limits_set = false;
+  bool congested = false;
+
+  // the queue event function object, called by a test to simulate a queue event
+  std::function<void (chops::net::basic_io_interface<io_handler_mock>, std::error_code)> queue_event;
+
+  template <typename F>
+  void set_output_queue_limits(const chops::net::output_queue_limits&, F&& func) {
+    queue_limits_set = true;
+    queue_event = std::forward<F>(func);
+  }
+
+  bool is_output_congested() const { return congested; }
+
+  bool read_batch_set = false;
+
+  void set_read_batch_size(std::size_t) { read_batch_set = true; }
+
+  bool uring_read_set = false;
+
+  void set_io_uring_read(std::size_t) { uring_read_set = true; }
+
+  bool seg_offload_set = false;
+
+  void set_segmentation_offload(std::size_t, bool) { seg_offload_set = true; }
+
+  bool rx_timestamps_set = false;
+
+  void set_receive_timestamps(bool) { rx_timestamps_set = true; }
+
+  bool idle_timeouts_set = false;
+
+  void set_idle_timeouts(const chops::net::idle_timeouts&) { idle_timeouts_set = true; }
+
+  bool read_buffer_policy_set = false;
+
+  void set_read_buffer_policy(const chops::net::read_buffer_policy&) { read_buffer_policy_set = true; }
+
+  bool send_coalescing_set = false;
+
+  void set_send_coalescing(std::size_t, std::chrono::microseconds) { send_coalescing_set = true; }
+
+  chops::net::io_handler_id get_handler_id() const { return chops::net::io_handler_id { 3u, 1u }; }
+
   bool mf_sio_called = false;
+  bool mf_ra_sio_called = false;
   bool delim_sio_called = false;
   bool rd_sio_called = false;
   bool rd_endp_sio_called = false;
@@ -206,6 +364,11 @@ struct io_handler_mock {
     return started ? false : started = true, mf_sio_called = true, true;
   }
 
+  template <typename MH, typename MF>
+  bool start_io(std::size_t, std::size_t, MH&&, MF&&) {
+    return started ? false : started = true, mf_ra_sio_called = true, true;
+  }
+
   template <typename MH>
   bool start_io(std::string_view, MH&&) {
     return started ? false : started = true, delim_sio_called = true, true;
@@ -18,8 +18,10 @@
 #include <memory> // std::shared_ptr
 #include <set>
 #include <cstddef> // std::size_t
+#include <chrono>
 
 #include "net_ip/queue_stats.hpp"
+#include "net_ip/send_priority.hpp"
 #include "net_ip/basic_io_interface.hpp"
 
 #include "net_ip/shared_utility_test.hpp"
@@ -54,8 +56,21 @@ void basic_io_interface_test_default_constructed() {
         REQUIRE_THROWS (io_intf.send(nullptr, 0, endp_t()));
         REQUIRE_THROWS (io_intf.send(buf, endp_t()));
         REQUIRE_THROWS (io_intf.send(chops::mutable_shared_buffer(), endp_t()));
+        REQUIRE_THROWS (io_intf.send(buf, chops::net::send_priority::high));
+        REQUIRE_THROWS (io_intf.send(buf, endp_t(), chops::net::send_priority::bulk));
+        REQUIRE_THROWS (io_intf.get_output_queue_stats(chops::net::send_priority::high));
+        REQUIRE_THROWS (io_intf.set_send_lane_policy(chops::net::send_lane_policy { }));
+
+        REQUIRE_THROWS (io_intf.set_write_batch_limits(0, 0));
+        REQUIRE_THROWS (io_intf.get_handler_id());
+        REQUIRE_THROWS (io_intf.set_idle_timeouts(chops::net::idle_timeouts { }));
+        REQUIRE_THROWS (io_intf.set_read_buffer_policy(chops::net::read_buffer_policy { }));
+        REQUIRE_THROWS (io_intf.set_send_coalescing(1024u, std::chrono::microseconds(200)));
+        REQUIRE_THROWS (io_intf.set_segmentation_offload(32u, true));
+        REQUIRE_THROWS (io_intf.set_receive_timestamps(true));
 
         REQUIRE_THROWS (io_intf.start_io(0, [] { }, [] { }));
+        REQUIRE_THROWS (io_intf.start_io(0, 0, [] { }, [] { }));
         REQUIRE_THROWS (io_intf.start_io("testing, hah!", [] { }));
         REQUIRE_THROWS (io_intf.start_io(0, [] { }));
         REQUIRE_THROWS (io_intf.start_io(endp_t(), 0, [] { }));
@@ -106,10 +121,42 @@ void basic_io_interface_test_methods() {
         io_intf.send(buf, endp_t());
         io_intf.send(chops::mutable_shared_buffer(), endp_t());
         REQUIRE(ioh->send_called);
+        io_intf.send(buf, chops::net::send_priority::high);
+        io_intf.send(buf, endp_t(), chops::net::send_priority::bulk);
+        REQUIRE(ioh->priority_send_called);
+        REQUIRE(io_intf.get_output_queue_stats(chops::net::send_priority::high).output_queue_size
+                == (chops::test::io_handler_mock::qs_base + 2));
+        io_intf.set_send_lane_policy(chops::net::send_lane_policy { });
+        REQUIRE(ioh->lane_policy_set);
+
+        io_intf.set_write_batch_limits(10, 1000);
+        REQUIRE(ioh->batch_limits_set);
+        io_intf.set_read_batch_size(16);
+        REQUIRE(ioh->read_batch_set);
+        io_intf.set_io_uring_read(64);
+        REQUIRE(ioh->uring_read_set);
+        io_intf.set_segmentation_offload(32, true);
+        REQUIRE(ioh->seg_offload_set);
+        io_intf.set_receive_timestamps(true);
+        REQUIRE(ioh->rx_timestamps_set);
+        REQUIRE(io_intf.get_handler_id().is_valid());
+        io_intf.set_idle_timeouts(chops::net::idle_timeouts { });
+        REQUIRE(ioh->idle_timeouts_set);
+        io_intf.set_read_buffer_policy(chops::net::read_buffer_policy { 4096u });
+        REQUIRE(ioh->read_buffer_policy_set);
+        io_intf.set_send_coalescing(1024u, std::chrono::microseconds(200));
+        REQUIRE(ioh->send_coalescing_set);
+        io_intf.set_output_queue_limits(chops::net::output_queue_limits { 10, 1000 });
+        REQUIRE(ioh->queue_limits_set);
+        REQUIRE_FALSE(io_intf.is_output_congested());
 
         REQUIRE (io_intf.start_io(0, [] { }, [] { }));
         REQUIRE (io_intf.is_io_started());
         REQUIRE (io_intf.stop_io());
+        REQUIRE (io_intf.start_io(0, 0, [] { }, [] { }));
+        REQUIRE (ioh->mf_ra_sio_called);
+        REQUIRE (io_intf.is_io_started());
+        REQUIRE (io_intf.stop_io());
         REQUIRE_FALSE (io_intf.is_io_started());
         REQUIRE (io_intf.start_io("testing, hah!", [] { }));
         REQUIRE (io_intf.is_io_started());
@@ -0,0 +1,85 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for @c basic_io_ref class template.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0. 
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch.hpp"
+
+#include <experimental/buffer>
+
+#include <memory> // std::make_shared
+
+#include "net_ip/queue_stats.hpp"
+#include "net_ip/basic_io_ref.hpp"
+#include "net_ip/io_interface.hpp"
+
+#include "net_ip/shared_utility_test.hpp"
+
+#include "utility/shared_buffer.hpp"
+
+// message handler signatures and the io argument given to them
+using const_buf = std::experimental::net::const_buffer;
+using tcp_endp = std::experimental::net::ip::tcp::endpoint;
+
+auto ref_hdlr = [] (const_buf, chops::net::tcp_io_ref, tcp_endp) { return true; };
+auto ref_sh_hdlr = [] (chops::const_shared_buffer, chops::net::tcp_io_ref, tcp_endp) { return true; };
+auto intf_hdlr = [] (const_buf, chops::net::tcp_io_interface, tcp_endp) { return true; };
+auto intf_sh_hdlr = [] (chops::const_shared_buffer, chops::net::tcp_io_interface, tcp_endp) { return true; };
+
+static_assert(chops::net::detail::msg_hdlr_takes_io_ref<decltype(ref_hdlr), chops::net::tcp_io>);
+static_assert(chops::net::detail::msg_hdlr_takes_io_ref<decltype(ref_sh_hdlr), chops::net::tcp_io>);
+static_assert(!chops::net::detail::msg_hdlr_takes_io_ref<decltype(intf_hdlr), chops::net::tcp_io>);
+static_assert(!chops::net::detail::msg_hdlr_takes_io_ref<decltype(intf_sh_hdlr), chops::net::tcp_io>);
+static_assert(chops::net::detail::msg_hdlr_takes_shared_buffer<decltype(ref_sh_hdlr), chops::net::tcp_io>);
+static_assert(!chops::net::detail::msg_hdlr_takes_shared_buffer<decltype(ref_hdlr), chops::net::tcp_io>);
+
+SCENARIO ( "Basic io ref test, methods forwarded to the IO handler",
+           "[basic_io_ref]" ) {
+
+  using namespace chops::test;
+
+  auto ioh = std::make_shared<io_handler_mock>();
+  chops::net::basic_io_ref<io_handler_mock> io_ref(*ioh);
+
+  GIVEN ("A basic_io_ref referring to a mock IO handler") {
+    WHEN ("the query methods are called") {
+      THEN ("the IO handler values are returned") {
+        REQUIRE_FALSE (io_ref.is_io_started());
+        REQUIRE (io_ref.get_socket() == 3);
+        REQUIRE (io_ref.get_output_queue_stats().output_queue_size == io_handler_mock::qs_base);
+        REQUIRE_FALSE (io_ref.is_output_congested());
+        ioh->congested = true;
+        REQUIRE (io_ref.is_output_congested());
+      }
+    }
+    AND_WHEN ("send is called") {
+      chops::const_shared_buffer buf(nullptr, 0);
+      io_ref.send(std::move(buf));
+      THEN ("the IO handler send is called") {
+        REQUIRE (ioh->send_called);
+        ioh->send_called = false;
+        io_ref.send(nullptr, 0, io_handler_mock::endpoint_type());
+        REQUIRE (ioh->send_called);
+      }
+    }
+    AND_WHEN ("stop_io is called after start_io") {
+      ioh->start_io();
+      THEN ("the IO handler is stopped") {
+        REQUIRE (io_ref.is_io_started());
+        REQUIRE (io_ref.stop_io());
+        REQUIRE_FALSE (io_ref.is_io_started());
+      }
+    }
+  } // end given
+}
+
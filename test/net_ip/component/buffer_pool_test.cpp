@@ -0,0 +1,181 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for @c buffer_pool class.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch.hpp"
+
+#include <cstddef> // std::size_t
+#include <memory> // std::make_shared
+#include <thread>
+#include <vector>
+
+#include "net_ip/component/buffer_pool.hpp"
+#include "net_ip/pooled_buffer.hpp"
+#include "net_ip/detail/out_buffer.hpp"
+
+#include "utility/shared_buffer.hpp"
+#include "utility/repeat.hpp"
+#include "utility/make_byte_array.hpp"
+
+#include "net_ip/shared_utility_test.hpp"
+
+SCENARIO ( "Buffer pool, creating and releasing buffers",
+           "[buffer_pool]" ) {
+
+  using namespace chops::test;
+
+  auto ba = chops::make_byte_array(0x20, 0x21, 0x22, 0x23, 0x24);
+
+  GIVEN ("A buffer pool with a max size of 1000 and one shard") {
+    chops::net::buffer_pool pool(1000u, 2u, 1u);
+    REQUIRE (pool.max_pooled_size() == 1024u);
+
+    WHEN ("a mutable buffer is created, released, then created again") {
+      auto mb = pool.make_mutable_buffer(100u);
+      REQUIRE (mb.size() == 100u);
+      REQUIRE (mb.get_byte_vec().capacity() >= 128u);
+      *(mb.data()) = std::byte(0x7F);
+      pool.release(mb);
+      auto mb2 = pool.make_mutable_buffer(90u);
+      THEN ("the second buffer uses the cached storage, with zeroed contents") {
+        REQUIRE (mb.size() == 0u);
+        REQUIRE (mb2.size() == 90u);
+        REQUIRE (*(mb2.data()) == std::byte(0x00));
+        auto st = pool.get_stats();
+        REQUIRE (st.num_misses == 1u);
+        REQUIRE (st.num_hits == 1u);
+        REQUIRE (st.num_released == 1u);
+        REQUIRE (st.num_dropped == 0u);
+      }
+    }
+
+    AND_WHEN ("a const buffer is created") {
+      auto cb = pool.make_const_buffer(ba.data(), ba.size());
+      THEN ("the contents match and it can be sent unchanged") {
+        REQUIRE (cb == chops::const_shared_buffer(ba.data(), ba.size()));
+        auto ioh = std::make_shared<io_handler_mock>();
+        io_interface_mock io_intf(ioh);
+        io_intf.send(cb);
+        REQUIRE (ioh->send_called);
+      }
+    }
+
+    AND_WHEN ("a pooled buffer is queued as an output buffer, then the references drop") {
+      auto pb = pool.make_pooled_buffer(ba.data(), ba.size());
+      REQUIRE (pb.size() == ba.size());
+      REQUIRE (*(pb.data()) == std::byte(0x20));
+      std::vector<chops::net::detail::out_buffer> queue;
+      queue.emplace_back(pb);
+      pb = chops::net::pooled_buffer();
+      REQUIRE (pool.get_stats().num_released == 0u);
+      REQUIRE (queue.front().size() == ba.size());
+      queue.clear();
+      auto pb2 = pool.make_pooled_buffer(10u);
+      THEN ("the storage is returned without a release call and used again, zeroed") {
+        REQUIRE (pb2.size() == 10u);
+        REQUIRE (*(pb2.data()) == std::byte(0x00));
+        auto st = pool.get_stats();
+        REQUIRE (st.num_misses == 1u);
+        REQUIRE (st.num_hits == 1u);
+        REQUIRE (st.num_released == 1u);
+      }
+    }
+
+    AND_WHEN ("buffers larger than the max size or beyond the cache limit are released") {
+      auto big = pool.make_mutable_buffer(5000u);
+      pool.release(big);
+      chops::repeat(3, [&pool] () {
+          pool.release(chops::mutable_shared_buffer::byte_vec(200u));
+        }
+      );
+      THEN ("the storage is dropped instead of cached") {
+        auto st = pool.get_stats();
+        REQUIRE (st.num_misses == 1u);
+        REQUIRE (st.num_released == 2u);
+        REQUIRE (st.num_dropped == 2u);
+      }
+    }
+  } // end given
+
+  GIVEN ("A read buffer policy using a shared buffer pool") {
+    auto pool = std::make_shared<chops::net::buffer_pool>(65536u, 4u, 1u);
+    auto pol = chops::net::make_pooled_read_buffer_policy(pool, 4096u);
+    REQUIRE (pol.shrink_size == 4096u);
+
+    WHEN ("a large read buffer is acquired, released, then acquired again") {
+      auto bv = pol.acquire(10000u);
+      REQUIRE (bv.capacity() >= 10000u);
+      pol.release(std::move(bv));
+      auto bv2 = pol.acquire(9000u);
+      THEN ("the second read buffer uses the pooled storage") {
+        REQUIRE (bv2.capacity() >= 9000u);
+        auto st = pool->get_stats();
+        REQUIRE (st.num_misses == 1u);
+        REQUIRE (st.num_hits == 1u);
+        REQUIRE (st.num_released == 1u);
+      }
+    }
+  } // end given
+
+  GIVEN ("A pooled buffer that outlives its pool") {
+    chops::net::pooled_buffer pb;
+    {
+      chops::net::buffer_pool pool(1000u, 2u, 1u);
+      pb = pool.make_pooled_buffer(100u);
+    }
+    WHEN ("the last reference drops") {
+      THEN ("the storage is released safely") {
+        REQUIRE (pb.size() == 100u);
+        pb = chops::net::pooled_buffer();
+        REQUIRE (pb.empty());
+      }
+    }
+  } // end given
+}
+
+SCENARIO ( "Buffer pool, concurrent use from multiple threads",
+           "[buffer_pool] [threads]" ) {
+
+  constexpr int num_thrs = 8;
+  constexpr int num_iters = 2000;
+
+  GIVEN ("A default constructed buffer pool") {
+    chops::net::buffer_pool pool { };
+
+    WHEN ("multiple threads create and release buffers") {
+      std::vector<std::thread> thrs;
+      chops::repeat(num_thrs, [&thrs, &pool] (int i) {
+          thrs.push_back(std::thread( [&pool, i] () {
+              chops::repeat(num_iters, [&pool, i] (int j) {
+                  auto mb = pool.make_mutable_buffer(static_cast<std::size_t>(64 + i * 100 + j % 500));
+                  pool.release(mb);
+                }
+              );
+            }
+          ));
+        }
+      );
+      for (auto& t : thrs) {
+        t.join();
+      }
+      THEN ("every buffer is accounted for") {
+        auto st = pool.get_stats();
+        REQUIRE ((st.num_hits + st.num_misses) == (num_thrs * num_iters));
+        REQUIRE ((st.num_released + st.num_dropped) == (num_thrs * num_iters));
+        REQUIRE (st.num_hits > st.num_misses);
+      }
+    }
+  } // end given
+}
+
@@ -0,0 +1,248 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for @c connector_group class template.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch.hpp"
+
+#include <experimental/internet>
+
+#include <cstddef> // std::size_t, std::byte
+#include <cstdint> // std::uint64_t
+#include <memory> // std::make_shared, std::shared_ptr
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "net_ip/component/connector_group.hpp"
+
+#include "net_ip/basic_io_interface.hpp"
+#include "net_ip/queue_stats.hpp"
+#include "utility/shared_buffer.hpp"
+
+namespace {
+
+// IO handler mock with a settable output queue depth
+struct lb_io_mock {
+  using socket_type = int;
+  using endpoint_type = std::experimental::net::ip::tcp::endpoint;
+
+  std::size_t q_bytes = 0u;
+  int         num_sends = 0;
+
+  chops::net::output_queue_stats get_output_queue_stats() const {
+    chops::net::output_queue_stats qs { };
+    qs.bytes_in_output_queue = q_bytes;
+    return qs;
+  }
+
+  void send(chops::const_shared_buffer buf) {
+    ++num_sends;
+    q_bytes += buf.size();
+  }
+};
+
+using lb_intf = chops::net::basic_io_interface<lb_io_mock>;
+
+// connector entity mock, starts by calling the IO state change with a connection
+struct connector_mock {
+  std::shared_ptr<lb_io_mock> ioh;
+
+  template <typename F1, typename F2>
+  bool start(F1&& io_state_chg, F2&&) {
+    io_state_chg(lb_intf(ioh), 1u, true);
+    return true;
+  }
+};
+
+}
+
+SCENARIO ( "Connector group, least loaded and power of two choices sends",
+           "[connector_group]" ) {
+
+  using namespace chops::net;
+
+  std::byte b(static_cast<std::byte>(0xFE));
+  chops::const_shared_buffer buf(&b, 1);
+
+  GIVEN ("A least loaded group with three connectors, one connected") {
+    connector_group<lb_io_mock> grp;
+    std::vector<std::shared_ptr<lb_io_mock> > iohs;
+    for (int i = 0; i < 3; ++i) {
+      iohs.push_back(std::make_shared<lb_io_mock>());
+      grp.add_slot();
+    }
+    int num_started = 0;
+    auto st_chg = grp.make_io_state_change(0u, [&num_started] (lb_intf) { ++num_started; } );
+    st_chg(lb_intf(iohs[0]), 1u, true);
+    REQUIRE (num_started == 1);
+    REQUIRE (grp.size() == 3u);
+    REQUIRE (grp.num_live() == 1u);
+
+    WHEN ("the other connectors connect and sends are made") {
+      grp.set_live(1u, lb_intf(iohs[1]));
+      grp.set_live(2u, lb_intf(iohs[2]));
+      iohs[0]->q_bytes = 10u;
+      for (int i = 0; i < 12; ++i) {
+        REQUIRE (grp.send(buf));
+      }
+      THEN ("the sends go to the least loaded connections") {
+        REQUIRE (iohs[0]->num_sends == 0);
+        REQUIRE (iohs[1]->num_sends == 6);
+        REQUIRE (iohs[2]->num_sends == 6);
+      }
+    }
+    AND_WHEN ("the connection goes down, sends are made, and it reconnects") {
+      st_chg(lb_intf(iohs[0]), 0u, false);
+      REQUIRE (grp.num_live() == 0u);
+      REQUIRE_FALSE (grp.send(buf));
+      REQUIRE_FALSE (grp.send(std::uint64_t(7u), buf));
+      st_chg(lb_intf(iohs[0]), 1u, true);
+      REQUIRE (grp.send(buf));
+      THEN ("the sends without a live connection are not routed") {
+        REQUIRE (grp.get_num_unrouted() == 2u);
+        REQUIRE (iohs[0]->num_sends == 1);
+        REQUIRE (num_started == 2);
+      }
+    }
+    AND_WHEN ("an IO handler goes away before its connector reports it") {
+      grp.set_live(1u, lb_intf(iohs[1]));
+      grp.set_live(2u, lb_intf(iohs[2]));
+      iohs[0].reset();
+      bool all_sent = true;
+      for (int i = 0; i < 4; ++i) {
+        REQUIRE_NOTHROW (all_sent = grp.send(buf) && all_sent);
+      }
+      std::size_t num_live = grp.num_live();
+      int num_sends = iohs[1]->num_sends + iohs[2]->num_sends;
+      iohs[1].reset();
+      iohs[2].reset();
+      THEN ("the slot is marked down and the sends go to the other connections") {
+        REQUIRE (all_sent);
+        REQUIRE (num_live == 2u);
+        REQUIRE (num_sends == 4);
+        REQUIRE_FALSE (grp.send(buf));
+        REQUIRE (grp.num_live() == 0u);
+        REQUIRE (grp.get_num_unrouted() == 1u);
+      }
+    }
+  } // end given
+
+  GIVEN ("A power of two choices group with connectors added and started") {
+    connector_group<lb_io_mock> grp(lb_policy::power_of_two_choices);
+    std::vector<std::shared_ptr<lb_io_mock> > iohs;
+    for (std::size_t i = 0u; i < 4u; ++i) {
+      iohs.push_back(std::make_shared<lb_io_mock>());
+      REQUIRE (grp.add_connector(connector_mock { iohs.back() },
+                                 [] (lb_intf) { }, [] (lb_intf, std::error_code) { }) == i);
+    }
+    REQUIRE (grp.num_live() == 4u);
+
+    WHEN ("one connection is heavily loaded and many sends are made") {
+      iohs[3]->q_bytes = 1000000u;
+      for (int i = 0; i < 400; ++i) {
+        grp.send(buf);
+      }
+      THEN ("the loaded connection is never chosen and the others share the sends") {
+        REQUIRE (iohs[3]->num_sends == 0);
+        REQUIRE ((iohs[0]->num_sends + iohs[1]->num_sends + iohs[2]->num_sends) == 400);
+        REQUIRE (iohs[0]->num_sends > 100);
+        REQUIRE (iohs[1]->num_sends > 100);
+        REQUIRE (iohs[2]->num_sends > 100);
+      }
+    }
+    AND_WHEN ("two IO handlers go away before their connectors report it") {
+      iohs[0].reset();
+      iohs[3].reset();
+      bool all_sent = true;
+      for (int i = 0; i < 40; ++i) {
+        all_sent = grp.send(buf) && all_sent;
+      }
+      THEN ("their slots are marked down and the others get all the sends") {
+        REQUIRE (all_sent);
+        REQUIRE (grp.num_live() == 2u);
+        REQUIRE ((iohs[1]->num_sends + iohs[2]->num_sends) == 40);
+      }
+    }
+  } // end given
+}
+
+SCENARIO ( "Connector group, consistent hashing by key", "[connector_group] [hash]" ) {
+
+  using namespace chops::net;
+
+  std::byte b(static_cast<std::byte>(0xFD));
+  chops::const_shared_buffer buf(&b, 1);
+  constexpr std::uint64_t num_keys = 1000u;
+
+  GIVEN ("A group with four live connections") {
+    connector_group<lb_io_mock> grp;
+    std::vector<std::shared_ptr<lb_io_mock> > iohs;
+    for (std::size_t i = 0u; i < 4u; ++i) {
+      iohs.push_back(std::make_shared<lb_io_mock>());
+      grp.add_connector(connector_mock { iohs.back() },
+                        [] (lb_intf) { }, [] (lb_intf, std::error_code) { });
+    }
+    std::vector<std::size_t> home;
+    for (std::uint64_t k = 0u; k < num_keys; ++k) {
+      home.push_back(grp.slot_of(k));
+    }
+
+    WHEN ("keyed sends are made") {
+      for (std::uint64_t k = 0u; k < num_keys; ++k) {
+        REQUIRE (grp.send(k, buf));
+      }
+      REQUIRE (grp.send(std::string_view("session-1"), buf));
+      REQUIRE (grp.send("session-1", buf));
+      THEN ("the keys are spread over all connections and string keys are stable") {
+        for (const auto& ioh : iohs) {
+          REQUIRE (ioh->num_sends > 100);
+        }
+        REQUIRE (grp.slot_of("session-1") == grp.slot_of(std::string_view("session-1")));
+      }
+    }
+    AND_WHEN ("one connection goes down and comes back") {
+      grp.set_down(2u);
+      bool moved_only_down_keys = true;
+      for (std::uint64_t k = 0u; k < num_keys; ++k) {
+        auto s = grp.slot_of(k);
+        if (s == 2u || (home[k] != 2u && s != home[k])) {
+          moved_only_down_keys = false;
+        }
+      }
+      grp.set_live(2u, lb_intf(iohs[2]));
+      bool all_home = true;
+      for (std::uint64_t k = 0u; k < num_keys; ++k) {
+        all_home = all_home && (grp.slot_of(k) == home[k]);
+      }
+      THEN ("only the keys of the down connection move, and they return") {
+        REQUIRE (moved_only_down_keys);
+        REQUIRE (all_home);
+      }
+    }
+    AND_WHEN ("an IO handler goes away before its connector reports it") {
+      iohs[2].reset();
+      bool all_sent = true;
+      for (std::uint64_t k = 0u; k < num_keys; ++k) {
+        all_sent = grp.send(k, buf) && all_sent;
+      }
+      THEN ("its keys move to the other connections") {
+        REQUIRE (all_sent);
+        REQUIRE (grp.num_live() == 3u);
+        REQUIRE ((iohs[0]->num_sends + iohs[1]->num_sends + iohs[3]->num_sends) == 
+                 static_cast<int>(num_keys));
+      }
+    }
+  } // end given
+}
+
@@ -23,12 +23,15 @@
 #include <chrono>
 
 #include <iostream>
+#include <sstream>
+#include <string>
 
 #include "net_ip/net_ip_error.hpp"
 
 #include "net_ip/component/error_delivery.hpp"
 
 #include "queue/wait_queue.hpp"
+#include "utility/repeat.hpp"
 
 #include "net_ip/shared_utility_test.hpp"
 
@@ -69,5 +72,42 @@ SCENARIO ( "Testing ostream_error_sink_with_wait_queue function",
 
 }
 
+SCENARIO ( "Testing ostream_error_sink_with_ring_queue function",
+           "[error_delivery]" ) {
+
+  using namespace chops::test;
 
+  auto ioh1 = std::make_shared<io_handler_mock>();
+  auto ioh2 = std::make_shared<io_handler_mock>();
 
+  auto io1 = io_interface_mock(ioh1);
+  auto io2 = io_interface_mock(ioh2);
+
+  GIVEN ("A ring_queue filled past its capacity before the sink is started") {
+    chops::net::err_ring_q rq(4);
+    auto err_func = chops::net::make_error_func_with_ring_queue<io_handler_mock>(rq);
+    chops::repeat(6, [&] {
+        err_func(io1, std::make_error_code(chops::net::net_ip_errc::tcp_io_handler_stopped));
+      }
+    );
+    REQUIRE (rq.num_dropped() == 2u);
+
+    WHEN ("the sink is started and more errors are delivered") {
+      std::ostringstream os;
+      auto sink_fut = std::async(std::launch::async, 
+                                 chops::net::ostream_error_sink_with_ring_queue,
+                                 std::ref(rq), std::ref(os), 64u);
+      err_func(io2, std::make_error_code(chops::net::net_ip_errc::tcp_connector_stopped));
+      err_func(io1, std::make_error_code(chops::net::net_ip_errc::tcp_acceptor_stopped));
+      while (!rq.empty()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      }
+      rq.close();
+      auto cnt = sink_fut.get();
+      THEN ("the queued errors are streamed along with the drop count") {
+        REQUIRE (cnt == 6u);
+        REQUIRE (os.str().find("error entries dropped: 2") != std::string::npos);
+      }
+    }
+  } // end given
+}
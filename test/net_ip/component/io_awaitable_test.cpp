@@ -0,0 +1,241 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for the coroutine awaitables, only built when coroutines are
+ *  supported by the compiler.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch.hpp"
+
+#include "net_ip/component/io_awaitable.hpp"
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <coroutine>
+#include <exception> // std::terminate
+#include <vector>
+#include <memory>
+#include <future>
+#include <chrono>
+#include <thread>
+
+#include "net_ip/basic_net_entity.hpp"
+#include "net_ip/basic_io_interface.hpp"
+#include "net_ip/net_ip_error.hpp"
+
+#include "net_ip/shared_utility_test.hpp"
+
+#include "utility/shared_buffer.hpp"
+
+// eagerly started coroutine, the frame is destroyed when the coroutine completes
+struct detached_task {
+  struct promise_type {
+    detached_task get_return_object() noexcept { return { }; }
+    std::suspend_never initial_suspend() noexcept { return { }; }
+    std::suspend_never final_suspend() noexcept { return { }; }
+    void return_void() noexcept { }
+    void unhandled_exception() noexcept { std::terminate(); }
+  };
+};
+
+detached_task sum_values(chops::net::awaitable_channel<int> ch, std::vector<int>& vals,
+                         bool& done) {
+  while (auto v = co_await ch.next()) {
+    vals.push_back(*v);
+  }
+  done = true;
+}
+
+detached_task count_msgs(chops::net::io_msg_channel<chops::test::io_handler_mock> ch,
+                         std::size_t& num_bytes, int& num_msgs) {
+  while (auto msg = co_await ch.next()) {
+    num_bytes += msg->buf.size();
+    ++num_msgs;
+  }
+}
+
+detached_task await_state_chgs(
+    chops::net::io_state_chg_channel<chops::test::io_handler_mock> ch,
+    std::promise<std::vector<bool> > prom) {
+  std::vector<bool> chgs;
+  while (auto chg = co_await ch.next()) {
+    chgs.push_back(chg->starting);
+    if (!chg->starting) {
+      break;
+    }
+  }
+  prom.set_value(chgs);
+}
+
+detached_task gated_send(chops::net::output_gate<chops::test::io_handler_mock> gate,
+                         chops::test::io_interface_mock io, bool& sent, bool& done) {
+  std::byte b[4] { };
+  sent = co_await gate.send(io, chops::const_shared_buffer(b, 4));
+  done = true;
+}
+
+SCENARIO ( "Awaitable channel, values pushed before and after the coroutine waits",
+           "[io_awaitable]" ) {
+
+  GIVEN ("A channel with one value pushed before the coroutine starts") {
+    chops::net::awaitable_channel<int> ch;
+    REQUIRE (ch.push(1));
+    std::vector<int> vals;
+    bool done = false;
+    sum_values(ch, vals, done);
+
+    WHEN ("more values are pushed and the channel is closed") {
+      REQUIRE (ch.size() == 0u);
+      ch.push(2);
+      ch.push(3);
+      ch.close();
+      THEN ("the coroutine is resumed inline for each value and completes on the close") {
+        REQUIRE (vals == std::vector<int> { 1, 2, 3 });
+        REQUIRE (done);
+        REQUIRE_FALSE (ch.push(4));
+        REQUIRE (ch.is_closed());
+      }
+    }
+  } // end given
+}
+
+SCENARIO ( "Channel message handler", "[io_awaitable]" ) {
+
+  using namespace chops::test;
+
+  GIVEN ("A message channel and a channel message handler") {
+    chops::net::io_msg_channel<io_handler_mock> ch;
+    auto mh = chops::net::make_channel_msg_hdlr(ch);
+    std::size_t num_bytes = 0;
+    int num_msgs = 0;
+    count_msgs(ch, num_bytes, num_msgs);
+
+    WHEN ("the message handler is invoked") {
+      auto ioh = std::make_shared<io_handler_mock>();
+      std::byte b[4] { };
+      REQUIRE (mh(chops::const_shared_buffer(b, 4), io_interface_mock(ioh),
+                  io_handler_mock::endpoint_type()));
+      REQUIRE (mh(chops::const_shared_buffer(b, 2), io_interface_mock(ioh),
+                  io_handler_mock::endpoint_type()));
+      THEN ("each message is delivered to the coroutine") {
+        REQUIRE (num_msgs == 2);
+        REQUIRE (num_bytes == 6u);
+      }
+      AND_WHEN ("the channel is closed") {
+        ch.close();
+        THEN ("the message handler returns false") {
+          REQUIRE_FALSE (mh(chops::const_shared_buffer(b, 4), io_interface_mock(ioh),
+                            io_handler_mock::endpoint_type()));
+          REQUIRE (num_msgs == 2);
+        }
+      }
+    }
+  } // end given
+}
+
+SCENARIO ( "Starting an entity with an IO state change channel", "[io_awaitable]" ) {
+
+  using namespace chops::test;
+  using basic_net_mock = chops::net::basic_net_entity<net_entity_mock>;
+
+  GIVEN ("An entity object and a coroutine awaiting state changes") {
+    auto ent_ptr = std::make_shared<net_entity_mock>();
+    auto ent = basic_net_mock (ent_ptr);
+    chops::net::io_state_chg_channel<io_handler_mock> ch;
+    std::promise<std::vector<bool> > prom;
+    auto fut = prom.get_future();
+    await_state_chgs(ch, std::move(prom));
+
+    WHEN ("start_with_channel is called") {
+      chops::net::start_with_channel(ent, io_state_chg_mock, ch, err_func_mock);
+      THEN ("the start and stop state changes are delivered to the coroutine") {
+        auto chgs = fut.get();
+        REQUIRE (chgs == std::vector<bool> { true, false });
+        REQUIRE (ent.stop());
+      }
+    }
+  } // end given
+}
+
+SCENARIO ( "Output gate without an IO handler", "[io_awaitable]" ) {
+
+  GIVEN ("An output gate and a default constructed IO interface") {
+    chops::net::output_gate<chops::test::io_handler_mock> gate;
+    std::byte b[4] { };
+    auto aw = gate.send(chops::test::io_interface_mock(), chops::const_shared_buffer(b, 4));
+    THEN ("the send does not suspend and fails") {
+      REQUIRE (aw.await_ready());
+      REQUIRE_FALSE (aw.await_resume());
+    }
+  } // end given
+}
+
+SCENARIO ( "Output gate with a congested IO handler", "[io_awaitable]" ) {
+
+  using namespace chops::test;
+
+  GIVEN ("An output gate with limits set on a congested IO handler") {
+    auto ioh = std::make_shared<io_handler_mock>();
+    io_interface_mock io(ioh);
+    chops::net::output_gate<io_handler_mock> gate;
+    gate.set_limits(io, chops::net::output_queue_limits { 10, 1000 });
+    REQUIRE (ioh->queue_limits_set);
+    ioh->congested = true;
+    bool sent = false;
+    bool done = false;
+    gated_send(gate, io, sent, done);
+
+    WHEN ("the low watermark event is delivered from another thread") {
+      REQUIRE_FALSE (done);
+      REQUIRE_FALSE (ioh->send_called);
+      ioh->congested = false;
+      std::thread thr( [ioh, io] () {
+          ioh->queue_event(io, 
+              std::make_error_code(chops::net::net_ip_errc::output_queue_low_watermark));
+        }
+      );
+      thr.join();
+      THEN ("the coroutine is resumed and the buffer is sent") {
+        REQUIRE (done);
+        REQUIRE (sent);
+        REQUIRE (ioh->send_called);
+      }
+    }
+    AND_WHEN ("the gate is closed") {
+      REQUIRE_FALSE (done);
+      gate.close();
+      THEN ("the coroutine is resumed and the buffer is not sent") {
+        REQUIRE (done);
+        REQUIRE_FALSE (sent);
+        REQUIRE_FALSE (ioh->send_called);
+      }
+    }
+  } // end given
+
+  GIVEN ("An output gate on an IO handler that is not congested") {
+    auto ioh = std::make_shared<io_handler_mock>();
+    io_interface_mock io(ioh);
+    chops::net::output_gate<io_handler_mock> gate;
+    bool sent = false;
+    bool done = false;
+    WHEN ("a send is awaited") {
+      gated_send(gate, io, sent, done);
+      THEN ("the coroutine does not suspend") {
+        REQUIRE (done);
+        REQUIRE (sent);
+        REQUIRE (ioh->send_called);
+      }
+    }
+  } // end given
+}
+
+#endif
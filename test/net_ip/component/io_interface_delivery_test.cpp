@@ -19,6 +19,7 @@
 #include <thread>
 #include <memory>
 #include <future>
+#include <vector>
 
 #include "net_ip/component/io_interface_delivery.hpp"
 #include "net_ip/component/io_state_change.hpp"
@@ -95,4 +96,33 @@ SCENARIO ( "Testing start_with_wait_queue",
   } // end given
 }
 
+SCENARIO ( "Testing start_with_ring_queue",
+           "[io_interface_delivery]" ) {
+
+  using namespace chops::test;
+  using basic_net_mock = chops::net::basic_net_entity<net_entity_mock>;
+
+  GIVEN ("An entity object and a ring_queue") {
+    auto ent_ptr = std::make_shared<net_entity_mock>();
+    auto ent = basic_net_mock (ent_ptr);
+    chops::net::io_ring_q<io_handler_mock> rq(8);
+    WHEN ("start_with_ring_queue is called") {
+      chops::net::start_with_ring_queue<io_handler_mock>(ent, io_state_chg_mock, 
+                                                         rq, err_func_mock);
+      THEN ("io interface objects are delivered through the ring_queue") {
+          std::vector<bool> chgs;
+          while (chgs.size() < 2u) {
+            rq.wait_and_pop_batch([&chgs] (chops::net::io_state_chg_data<io_handler_mock>&& d) {
+                chgs.push_back(d.starting);
+              }, 2u);
+          }
+          REQUIRE (chgs[0]);
+          REQUIRE_FALSE (chgs[1]);
+          REQUIRE (rq.num_dropped() == 0u);
+          ent.stop();
+      }
+    }
+  } // end given
+}
+
 
@@ -0,0 +1,142 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for @c length_field, @c staged_msg_frame and the related
+ *  message frame creation functions.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch.hpp"
+
+#include <experimental/buffer>
+
+#include <cstddef> // std::size_t, std::byte
+#include <vector>
+
+#include "utility/make_byte_array.hpp"
+#include "net_ip/component/length_field_msg_frame.hpp"
+
+using namespace std::experimental::net;
+
+// the first header stage is the width of the length field in the second stage
+struct length_width_stage {
+  std::size_t operator()(const std::byte* p, std::size_t) const noexcept {
+    return static_cast<std::size_t>(*p);
+  }
+};
+
+struct var_width_length_stage {
+  std::size_t operator()(const std::byte* p, std::size_t sz) const noexcept {
+    std::size_t len = 0u;
+    for (std::size_t i = 0u; i < sz; ++i) {
+      len = (len << 8u) | static_cast<std::size_t>(p[i]);
+    }
+    return len;
+  }
+};
+
+// runs a message frame over a byte buffer as the TCP IO handler would, returning the
+// message sizes
+template <typename MF>
+std::vector<std::size_t> frame_msgs(MF& mf, std::size_t hdr_size, std::byte* buf,
+                                    std::size_t sz) {
+  std::vector<std::size_t> sizes;
+  std::size_t idx = 0u;
+  while (idx < sz) {
+    std::size_t msg_sz = 0u;
+    std::size_t next = hdr_size;
+    while (next != 0u) {
+      auto ret = mf(mutable_buffer(buf + idx + msg_sz, next));
+      msg_sz += next;
+      next = ret;
+    }
+    sizes.push_back(msg_sz);
+    idx += msg_sz;
+  }
+  return sizes;
+}
+
+SCENARIO ( "Compile time length field decoding test", "[length_field]" ) {
+
+  using namespace chops::net;
+
+  auto ba = chops::make_byte_array(0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08);
+
+  GIVEN ("A byte array") {
+    WHEN ("unsigned integers are decoded") {
+      THEN ("the width and byte order are applied") {
+        REQUIRE (decode_uint<1>(ba.data()) == 0x01u);
+        REQUIRE (decode_uint<2>(ba.data()) == 0x0102u);
+        REQUIRE (decode_uint<2, byte_order::little>(ba.data()) == 0x0201u);
+        REQUIRE (decode_uint<3>(ba.data() + 1) == 0x020304u);
+        REQUIRE (decode_uint<4, byte_order::little>(ba.data()) == 0x04030201u);
+        REQUIRE (decode_uint<8>(ba.data()) == 0x0102030405060708u);
+      }
+    }
+    AND_WHEN ("length fields are decoded") {
+      THEN ("the offset, header size and length includes header parameters are applied") {
+        REQUIRE (length_field<0, 2>::hdr_size == 2u);
+        REQUIRE (length_field<0, 2>()(ba.data(), 2u) == 0x0102u);
+        REQUIRE (length_field<1, 1, byte_order::big, false, 4>::hdr_size == 4u);
+        REQUIRE (length_field<1, 1, byte_order::big, false, 4>()(ba.data(), 4u) == 2u);
+        REQUIRE (length_field<3, 1, byte_order::big, true>()(ba.data(), 4u) == 0u);
+        REQUIRE (length_field<4, 1, byte_order::big, true, 2 + 4>()(ba.data(), 6u) == 0u);
+        REQUIRE (length_field<7, 1, byte_order::big, true, 8>()(ba.data(), 8u) == 0u);
+        REQUIRE (length_field<0, 2, byte_order::little, true>()(ba.data(), 2u) == 0x0201u - 2u);
+      }
+    }
+  } // end given
+}
+
+SCENARIO ( "Length field and staged message frame test", "[length_field_msg_frame]" ) {
+
+  using namespace chops::net;
+
+  GIVEN ("A 2 byte big endian length header and three messages, one with an empty body") {
+    auto msgs = chops::make_byte_array(0x00, 0x01, 0xBB, 0x00, 0x00,
+                                       0x00, 0x03, 0xAA, 0xDD, 0xEE);
+    auto mf = make_length_field_msg_frame<0, 2>();
+    WHEN ("the message frame is called for each header and body") {
+      auto sizes = frame_msgs(mf, 2u, msgs.data(), msgs.size());
+      THEN ("the message sizes include the header") {
+        REQUIRE (sizes == std::vector<std::size_t> { 3u, 2u, 5u });
+      }
+    }
+  } // end given
+
+  GIVEN ("A type, length, value header with a little endian length including the header") {
+    using tlv_hdr = length_field<1, 2, byte_order::little, true>;
+    auto msgs = chops::make_byte_array(0x07, 0x05, 0x00, 0x11, 0x22,
+                                       0x09, 0x04, 0x00, 0x33);
+    auto mf = make_length_field_msg_frame<tlv_hdr>();
+    auto a = mf; // copies start at the header
+    WHEN ("the message frame is called for each header and body") {
+      auto sizes = frame_msgs(a, tlv_hdr::hdr_size, msgs.data(), msgs.size());
+      THEN ("the message sizes are the length fields") {
+        REQUIRE (sizes == std::vector<std::size_t> { 5u, 4u });
+      }
+    }
+  } // end given
+
+  GIVEN ("A two stage header, a length width followed by a length of that width") {
+    auto msgs = chops::make_byte_array(0x01, 0x02, 0xAA, 0xBB,
+                                       0x02, 0x00, 0x03, 0xCC, 0xDD, 0xEE,
+                                       0x01, 0x00);
+    auto mf = make_staged_msg_frame(length_width_stage(), var_width_length_stage());
+    WHEN ("the message frame is called for each header stage and body") {
+      auto sizes = frame_msgs(mf, 1u, msgs.data(), msgs.size());
+      THEN ("each stage sees its part of the header") {
+        REQUIRE (sizes == std::vector<std::size_t> { 4u, 6u, 2u });
+      }
+    }
+  } // end given
+}
+
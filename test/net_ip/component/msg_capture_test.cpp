@@ -0,0 +1,139 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for the @c msg_capture component.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch.hpp"
+
+#include <experimental/buffer>
+#include <experimental/internet>
+#include <experimental/io_context>
+
+#include <cstddef> // std::size_t
+#include <cstdio> // std::remove
+#include <chrono>
+#include <memory> // std::make_shared
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "net_ip/component/msg_capture.hpp"
+#include "net_ip/basic_io_interface.hpp"
+
+using namespace std::experimental::net;
+
+struct udp_capture_mock {
+  using socket_type = int;
+  using endpoint_type = ip::udp::endpoint;
+};
+
+const char* const cap_file = "msg_capture_test.cap";
+
+SCENARIO ( "Message capture and replay test", "[msg_capture]" ) {
+
+  using namespace chops::net;
+
+  auto endp = ip::udp::endpoint(ip::make_address("127.0.0.1"), 5432);
+  auto endp6 = ip::udp::endpoint(ip::make_address("::1"), 5433);
+
+  GIVEN ("A capture writer and a capturing message handler") {
+    std::size_t num_calls = 0u;
+    {
+      auto cap = std::make_shared<capture_writer>(cap_file, 4096u);
+      auto mh = make_capture_msg_hdlr<udp_capture_mock>(cap,
+          [&num_calls] (const_buffer, basic_io_interface<udp_capture_mock>, ip::udp::endpoint) {
+            ++num_calls;
+            return true;
+          }
+      );
+      std::string a("Hello, capture");
+      std::string b("second");
+      REQUIRE (mh(const_buffer(a.data(), a.size()), basic_io_interface<udp_capture_mock>(), endp));
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      REQUIRE (mh(const_buffer(b.data(), b.size()), basic_io_interface<udp_capture_mock>(), endp6));
+      std::vector<char> big(8192u, 'x');
+      REQUIRE_FALSE (cap->append(big.data(), big.size(), endp));
+      REQUIRE (cap->num_records() == 2u);
+      REQUIRE (cap->num_dropped() == 1u);
+      cap->close();
+    }
+    REQUIRE (num_calls == 2u);
+
+    WHEN ("the capture file is read") {
+      capture_reader rdr(cap_file);
+      capture_record rec;
+      THEN ("the records, timestamps and endpoints are as written") {
+        REQUIRE (rdr.next(rec));
+        REQUIRE (std::string(static_cast<const char*>(rec.data.data()), rec.data.size()) ==
+                 "Hello, capture");
+        REQUIRE (rec.get_endpoint<ip::udp>() == endp);
+        auto ts = rec.timestamp;
+        REQUIRE (rdr.next(rec));
+        REQUIRE (rec.data.size() == 6u);
+        REQUIRE (rec.get_endpoint<ip::udp>() == endp6);
+        REQUIRE ((rec.timestamp - ts) >= std::chrono::milliseconds(20));
+        REQUIRE_FALSE (rdr.next(rec));
+        rdr.rewind();
+        REQUIRE (rdr.next(rec));
+        REQUIRE (rec.data.size() == 14u);
+      }
+    }
+
+    AND_WHEN ("the capture file is replayed at original speed and at maximum speed") {
+      io_context ioc;
+      std::size_t cnt = 0u;
+      std::size_t done_cnt = 0u;
+      auto rp = std::make_shared<capture_replayer>(ioc,
+                                                   std::make_shared<capture_reader>(cap_file));
+      rp->start(make_replay_msg_hdlr_func<udp_capture_mock>(
+          [&cnt] (const_buffer, basic_io_interface<udp_capture_mock>, ip::udp::endpoint) {
+            ++cnt;
+            return true;
+          }), [&done_cnt] (std::size_t n) { done_cnt = n; } );
+      auto start = std::chrono::steady_clock::now();
+      ioc.run();
+      auto elapsed = std::chrono::steady_clock::now() - start;
+
+      io_context ioc2;
+      std::size_t cnt2 = 0u;
+      auto rp2 = std::make_shared<capture_replayer>(ioc2,
+                                                    std::make_shared<capture_reader>(cap_file),
+                                                    0.0);
+      rp2->start([&cnt2] (const capture_record&) { ++cnt2; return false; } );
+      ioc2.run();
+      THEN ("each record is replayed with the original spacing, or until stopped") {
+        REQUIRE (cnt == 2u);
+        REQUIRE (done_cnt == 2u);
+        REQUIRE (elapsed >= std::chrono::milliseconds(20));
+        REQUIRE (cnt2 == 1u);
+      }
+    }
+  } // end given
+
+  GIVEN ("A file that is not a capture file") {
+    {
+      capture_writer w(cap_file, 16u); // truncated to a header only
+    }
+    std::FILE* f = std::fopen(cap_file, "r+b");
+    std::fputc('X', f);
+    std::fclose(f);
+    WHEN ("a reader is created") {
+      THEN ("an exception is thrown") {
+        REQUIRE_THROWS_AS (capture_reader(cap_file), std::system_error);
+      }
+    }
+  } // end given
+
+  std::remove(cap_file);
+}
+
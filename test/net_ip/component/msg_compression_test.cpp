@@ -0,0 +1,232 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for the @c msg_compression component, with a simple run length
+ *  codec.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch.hpp"
+
+#include <experimental/buffer>
+#include <experimental/internet>
+
+#include <cstddef> // std::size_t, std::byte
+#include <cstdint> // std::uint8_t
+#include <memory> // std::make_shared
+#include <vector>
+
+#include "net_ip/component/msg_compression.hpp"
+#include "net_ip/basic_io_interface.hpp"
+#include "net_ip/net_ip_error.hpp"
+
+#include "utility/shared_buffer.hpp"
+
+// (count, byte) pairs
+struct rle_codec {
+  static constexpr std::uint8_t id = 7u;
+
+  std::size_t max_compressed_size(std::size_t sz) const noexcept { return sz * 2u; }
+
+  std::size_t compress(const std::byte* src, std::size_t sz, std::byte* dst, std::size_t cap) {
+    std::size_t out = 0u;
+    std::size_t i = 0u;
+    while (i < sz) {
+      std::size_t run = 1u;
+      while ((i + run) < sz && run < 255u && src[i + run] == src[i]) {
+        ++run;
+      }
+      if ((out + 2u) > cap) {
+        return 0u;
+      }
+      dst[out++] = static_cast<std::byte>(run);
+      dst[out++] = src[i];
+      i += run;
+    }
+    return out;
+  }
+
+  bool decompress(const std::byte* src, std::size_t sz, std::byte* dst, std::size_t orig_sz) {
+    std::size_t out = 0u;
+    for (std::size_t i = 0u; (i + 1u) < sz; i += 2u) {
+      auto run = static_cast<std::size_t>(src[i]);
+      if ((out + run) > orig_sz) {
+        return false;
+      }
+      for (std::size_t j = 0u; j < run; ++j) {
+        dst[out++] = src[i + 1u];
+      }
+    }
+    return out == orig_sz;
+  }
+};
+
+struct io_send_mock {
+  using socket_type = int;
+  using endpoint_type = std::experimental::net::ip::tcp::endpoint;
+
+  std::vector<chops::const_shared_buffer> sent;
+
+  void send(chops::const_shared_buffer buf) { sent.push_back(buf); }
+  void send(chops::const_shared_buffer buf, chops::net::send_priority) { sent.push_back(buf); }
+};
+
+using mock_io_interface = chops::net::basic_io_interface<io_send_mock>;
+using state_type = chops::net::detail::compression_state<rle_codec>;
+
+SCENARIO ( "Message compression envelope and negotiation test", "[msg_compression]" ) {
+
+  using namespace chops::net;
+
+  chops::net::compression_options opts;
+  opts.min_size = 16u;
+  auto iop = std::make_shared<io_send_mock>();
+  auto st = std::make_shared<state_type>(opts);
+  msg_compressor<rle_codec, io_send_mock> comp(st, mock_io_interface(iop));
+
+  std::vector<std::byte> received;
+  auto mh = make_decompressing_msg_hdlr<rle_codec, io_send_mock>(st,
+      [&received] (std::experimental::net::const_buffer buf, mock_io_interface,
+                   io_send_mock::endpoint_type) {
+        auto p = static_cast<const std::byte*>(buf.data());
+        received.assign(p, p + buf.size());
+        return true;
+      }
+  );
+  auto deliver = [&mh, &iop] (const chops::const_shared_buffer& buf) {
+    return mh(std::experimental::net::const_buffer(buf.data(), buf.size()),
+              mock_io_interface(iop), io_send_mock::endpoint_type());
+  };
+
+  std::vector<std::byte> big(100u, std::byte(0x5A));
+  std::byte hello[] { std::byte(2), std::byte(0), std::byte(0), std::byte(0), std::byte(1),
+                      std::byte(rle_codec::id) };
+  std::byte other_hello[] { std::byte(2), std::byte(0), std::byte(0), std::byte(0), std::byte(1),
+                            std::byte(rle_codec::id + 1) };
+
+  GIVEN ("A compressor before the hello message from the other side") {
+    WHEN ("a large message is sent") {
+      comp.send(big.data(), big.size());
+      THEN ("it is sent uncompressed, in a plain envelope") {
+        REQUIRE_FALSE (comp.is_compressing());
+        REQUIRE (iop->sent.size() == 1u);
+        auto& b = iop->sent[0];
+        REQUIRE (b.size() == compression_hdr_size + big.size());
+        REQUIRE (b.data()[0] == std::byte(0));
+        REQUIRE (decode_compression_hdr(b.data(), compression_hdr_size) == big.size());
+        REQUIRE (deliver(b));
+        REQUIRE (received == big);
+      }
+    }
+  } // end given
+
+  GIVEN ("A compressor after a hello message with the same codec") {
+    REQUIRE (deliver(chops::const_shared_buffer(hello, sizeof(hello))));
+    REQUIRE (comp.is_compressing());
+    WHEN ("a large and a small message are sent") {
+      comp.send(big.data(), big.size());
+      comp.send(big.data(), 8u);
+      THEN ("only the large message is compressed, and both decompress") {
+        REQUIRE (iop->sent.size() == 2u);
+        auto& b = iop->sent[0];
+        REQUIRE (b.data()[0] == std::byte(1));
+        REQUIRE (b.size() < big.size());
+        REQUIRE (deliver(b));
+        REQUIRE (received == big);
+        REQUIRE (iop->sent[1].data()[0] == std::byte(0));
+        REQUIRE (deliver(iop->sent[1]));
+        REQUIRE (received.size() == 8u);
+      }
+    }
+    AND_WHEN ("a message that does not shrink is sent") {
+      std::vector<std::byte> mixed;
+      for (std::size_t i = 0u; i < 64u; ++i) {
+        mixed.push_back(static_cast<std::byte>(i));
+      }
+      comp.send(mixed.data(), mixed.size());
+      THEN ("it is sent uncompressed") {
+        REQUIRE (iop->sent.size() == 1u);
+        REQUIRE (iop->sent[0].data()[0] == std::byte(0));
+        REQUIRE (deliver(iop->sent[0]));
+        REQUIRE (received == mixed);
+      }
+    }
+  } // end given
+
+  GIVEN ("A compressor after a hello message with a different codec") {
+    REQUIRE (deliver(chops::const_shared_buffer(other_hello, sizeof(other_hello))));
+    WHEN ("a large message is sent") {
+      comp.send(big.data(), big.size());
+      THEN ("it is sent uncompressed") {
+        REQUIRE_FALSE (comp.is_compressing());
+        REQUIRE (iop->sent[0].data()[0] == std::byte(0));
+      }
+    }
+  } // end given
+
+  GIVEN ("A decompressing message handler") {
+    WHEN ("a compressed message with an original size over the maximum is received") {
+      std::byte bad[] { std::byte(1), std::byte(0), std::byte(0), std::byte(0), std::byte(6),
+                        std::byte(0x7F), std::byte(0), std::byte(0), std::byte(0),
+                        std::byte(1), std::byte(0) };
+      THEN ("the message handler returns false") {
+        REQUIRE_FALSE (deliver(chops::const_shared_buffer(bad, sizeof(bad))));
+      }
+    }
+    AND_WHEN ("a message with a body shorter than the header length is received") {
+      std::byte bad[] { std::byte(0), std::byte(0xFF), std::byte(0xFF), std::byte(0xFF),
+                        std::byte(0xFF) };
+      THEN ("the message handler returns false") {
+        REQUIRE_FALSE (deliver(chops::const_shared_buffer(bad, sizeof(bad))));
+      }
+    }
+    AND_WHEN ("an unknown message type is received") {
+      std::byte bad[] { std::byte(9), std::byte(0), std::byte(0), std::byte(0), std::byte(0) };
+      THEN ("the message handler returns false") {
+        REQUIRE_FALSE (deliver(chops::const_shared_buffer(bad, sizeof(bad))));
+      }
+    }
+  } // end given
+
+  GIVEN ("A compression message frame with a maximum body size of 100") {
+    auto mf = make_compression_msg_frame(100u);
+    std::byte hdr[] { std::byte(0), std::byte(0), std::byte(0), std::byte(0), std::byte(100) };
+    std::byte body[100] { };
+    WHEN ("a header with a body length within the maximum is framed") {
+      THEN ("the body length is returned, then zero after the body") {
+        REQUIRE (mf(std::experimental::net::mutable_buffer(hdr, sizeof(hdr))) == 100u);
+        REQUIRE (mf(std::experimental::net::mutable_buffer(body, sizeof(body))) == 0u);
+        REQUIRE (mf(std::experimental::net::mutable_buffer(hdr, sizeof(hdr))) == 100u);
+      }
+    }
+    AND_WHEN ("a header with a body length over the maximum is framed") {
+      std::byte big_hdr[] { std::byte(1), std::byte(0xFF), std::byte(0xFF), std::byte(0xFF),
+                            std::byte(0xFF) };
+      THEN ("the message ends at the header and the decompressing handler rejects it") {
+        REQUIRE (mf(std::experimental::net::mutable_buffer(big_hdr, sizeof(big_hdr))) == 0u);
+        REQUIRE_FALSE (deliver(chops::const_shared_buffer(big_hdr, sizeof(big_hdr))));
+        REQUIRE (mf(std::experimental::net::mutable_buffer(hdr, sizeof(hdr))) == 100u);
+      }
+    }
+  } // end given
+
+  GIVEN ("A default constructed compressor") {
+    msg_compressor<rle_codec, io_send_mock> empty;
+    WHEN ("send is called") {
+      THEN ("an exception is thrown") {
+        REQUIRE_FALSE (empty.is_valid());
+        REQUIRE_THROWS (empty.send(big.data(), big.size()));
+      }
+    }
+  } // end given
+
+}
+
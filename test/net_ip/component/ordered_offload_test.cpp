@@ -0,0 +1,143 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for @c ordered_offload class template.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch.hpp"
+
+#include <experimental/internet>
+#include <experimental/io_context>
+
+#include <cstddef> // std::size_t
+#include <atomic>
+#include <chrono>
+#include <memory> // std::make_shared
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "net_ip/component/ordered_offload.hpp"
+#include "net_ip/component/worker_pool.hpp"
+
+#include "net_ip/basic_io_interface.hpp"
+#include "utility/shared_buffer.hpp"
+
+namespace {
+
+struct offload_io_mock {
+  using socket_type = int;
+  using endpoint_type = std::experimental::net::ip::tcp::endpoint;
+
+  std::atomic_bool stopped { false };
+
+  bool stop_io() { stopped = true; return true; }
+};
+
+using offload_intf = chops::net::basic_io_interface<offload_io_mock>;
+
+chops::const_shared_buffer make_msg(std::size_t val) {
+  return chops::const_shared_buffer(&val, sizeof(val));
+}
+
+std::size_t msg_val(const chops::const_shared_buffer& buf) {
+  return *reinterpret_cast<const std::size_t*>(buf.data());
+}
+
+void wait_for(const chops::net::ordered_offload<offload_io_mock>& off, std::size_t num) {
+  for (int i = 0; i < 5000 && off.get_num_handled() < num; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+}
+
+SCENARIO ( "Ordered offload, messages of several connections handled by a worker pool",
+           "[ordered_offload]" ) {
+
+  using namespace chops::net;
+
+  constexpr std::size_t num_conns = 4u;
+  constexpr std::size_t num_msgs = 2000u;
+
+  worker_pool wp(4, worker_pool::mode::shared_context);
+  wp.start();
+
+  GIVEN ("An ordered offload with a small ring, so messages are spilled") {
+    ordered_offload<offload_io_mock> off(wp.get_io_context(), 16u, 8u);
+
+    WHEN ("messages of each connection are passed to its message handler") {
+      std::vector<std::shared_ptr<offload_io_mock> > iohs;
+      std::vector<std::vector<std::size_t> > received(num_conns);
+      std::mutex thr_mutex;
+      std::set<std::thread::id> thr_ids;
+      std::vector<std::function<bool (chops::const_shared_buffer, offload_intf,
+                                      offload_io_mock::endpoint_type)> > mhs;
+      for (std::size_t c = 0u; c < num_conns; ++c) {
+        iohs.push_back(std::make_shared<offload_io_mock>());
+        mhs.push_back(off.make_msg_hdlr([&received, &thr_mutex, &thr_ids, c]
+                (chops::const_shared_buffer buf, offload_intf, offload_io_mock::endpoint_type) {
+            received[c].push_back(msg_val(buf));
+            std::lock_guard<std::mutex> lk(thr_mutex);
+            thr_ids.insert(std::this_thread::get_id());
+            return true;
+          }
+        ));
+      }
+      bool all_queued = true;
+      for (std::size_t i = 0u; i < num_msgs; ++i) {
+        for (std::size_t c = 0u; c < num_conns; ++c) {
+          all_queued = mhs[c](make_msg(i), offload_intf(iohs[c]),
+                              offload_io_mock::endpoint_type()) && all_queued;
+        }
+      }
+      wait_for(off, num_conns * num_msgs);
+      THEN ("every message is handled by a worker thread, in order per connection") {
+        REQUIRE (all_queued);
+        REQUIRE (off.get_num_handled() == num_conns * num_msgs);
+        REQUIRE (thr_ids.count(std::this_thread::get_id()) == 0u);
+        for (const auto& r : received) {
+          REQUIRE (r.size() == num_msgs);
+          bool in_order = true;
+          for (std::size_t i = 0u; i < r.size(); ++i) {
+            in_order = in_order && (r[i] == i);
+          }
+          REQUIRE (in_order);
+        }
+      }
+    }
+    AND_WHEN ("the application message handler returns false") {
+      auto ioh = std::make_shared<offload_io_mock>();
+      std::atomic_size_t num_called { 0u };
+      auto mh = off.make_msg_hdlr([&num_called]
+                (chops::const_shared_buffer buf, offload_intf, offload_io_mock::endpoint_type) {
+          ++num_called;
+          return msg_val(buf) < 3u;
+        }
+      );
+      for (std::size_t i = 0u; i < 10u; ++i) {
+        mh(make_msg(i), offload_intf(ioh), offload_io_mock::endpoint_type());
+      }
+      wait_for(off, 4u);
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      THEN ("the IO handler is stopped and the remaining messages are discarded") {
+        REQUIRE (num_called == 4u);
+        REQUIRE (ioh->stopped);
+        REQUIRE_FALSE (mh(make_msg(20u), offload_intf(ioh), offload_io_mock::endpoint_type()));
+      }
+    }
+  } // end given
+
+  wp.reset();
+}
+
@@ -0,0 +1,181 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for @c request_correlator class template.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch.hpp"
+
+#include <experimental/internet>
+#include <experimental/io_context>
+#include <experimental/buffer>
+
+#include <cstddef> // std::size_t, std::byte
+#include <cstdint> // std::uint32_t
+#include <chrono>
+#include <memory> // std::make_shared
+#include <system_error>
+#include <vector>
+
+#include "net_ip/component/request_correlator.hpp"
+#include "net_ip/detail/timer_wheel.hpp"
+
+#include "net_ip/basic_io_interface.hpp"
+#include "net_ip/basic_io_ref.hpp"
+#include "net_ip/net_ip_error.hpp"
+#include "utility/shared_buffer.hpp"
+
+namespace {
+
+struct req_io_mock {
+  using socket_type = int;
+  using endpoint_type = std::experimental::net::ip::tcp::endpoint;
+
+  std::vector<chops::const_shared_buffer> sent;
+
+  void send(chops::const_shared_buffer buf) { sent.push_back(buf); }
+};
+
+// the correlation id is the first byte of each message
+auto first_byte = [] (std::experimental::net::const_buffer buf) {
+  return static_cast<std::uint32_t>(*static_cast<const unsigned char*>(buf.data()));
+};
+
+chops::const_shared_buffer make_msg(unsigned char id, unsigned char val) {
+  unsigned char b[2] = { id, val };
+  return chops::const_shared_buffer(b, 2u);
+}
+
+}
+
+SCENARIO ( "Request correlator, pipelined requests completed out of order",
+           "[request_correlator]" ) {
+
+  using namespace chops::net;
+  using namespace std::experimental::net;
+
+  io_context ioc;
+  auto ioh = std::make_shared<req_io_mock>();
+  auto corr = make_request_correlator<req_io_mock>(ioc, first_byte,
+                                                   std::chrono::milliseconds(1000), 8u);
+  corr->set_io_interface(basic_io_interface<req_io_mock>(ioh));
+
+  std::vector<std::uint32_t> replies;
+  std::vector<std::error_code> errs;
+  auto cb = [&replies, &errs] (std::error_code err, const_buffer buf) {
+    errs.push_back(err);
+    if (!err) {
+      replies.push_back(static_cast<const unsigned char*>(buf.data())[1]);
+    }
+  };
+
+  GIVEN ("A correlator with a max in flight of 8") {
+    WHEN ("8 requests are sent") {
+      for (unsigned char i = 0u; i < 8u; ++i) {
+        REQUIRE (corr->send_request(i, make_msg(i, 0u), cb));
+      }
+      THEN ("all are sent without waiting, and a 9th or a duplicate id is refused") {
+        REQUIRE (ioh->sent.size() == 8u);
+        REQUIRE (corr->in_flight() == 8u);
+        REQUIRE_FALSE (corr->send_request(9u, make_msg(9u, 0u), cb));
+        REQUIRE_FALSE (corr->send_request(3u, make_msg(3u, 0u), cb));
+        REQUIRE (ioh->sent.size() == 8u);
+      }
+    }
+    AND_WHEN ("replies arrive out of order through the message handler, then unmatched") {
+      for (unsigned char i = 0u; i < 8u; ++i) {
+        corr->send_request(i, make_msg(i, 0u), cb);
+      }
+      auto mh = corr->make_msg_handler();
+      req_io_mock dummy;
+      for (unsigned char i : { 5u, 0u, 7u, 2u, 1u, 6u, 3u, 4u }) {
+        auto r = make_msg(i, static_cast<unsigned char>(i + 100u));
+        REQUIRE (mh(const_buffer(r.data(), r.size()), basic_io_ref<req_io_mock>(dummy),
+                    req_io_mock::endpoint_type()));
+      }
+      auto r = make_msg(5u, 0u);
+      REQUIRE (corr->reply_received(const_buffer(r.data(), r.size())));
+      THEN ("each request is completed by its own reply") {
+        REQUIRE (replies == std::vector<std::uint32_t> { 105u, 100u, 107u, 102u, 101u,
+                                                         106u, 103u, 104u });
+        REQUIRE (corr->in_flight() == 0u);
+        REQUIRE (corr->get_num_unmatched() == 1u);
+      }
+    }
+    AND_WHEN ("requests time out or are cancelled") {
+      auto tick = use_service<detail::idle_timer_service>(ioc).current_tick();
+      corr->send_request(1u, make_msg(1u, 0u), cb);
+      corr->send_request(2u, make_msg(2u, 0u), cb, std::chrono::milliseconds(5000));
+      corr->send_request(3u, make_msg(3u, 0u), cb, std::chrono::milliseconds(5000));
+      corr->expire_requests(tick + 5u);
+      REQUIRE (errs.empty());
+      corr->expire_requests(tick + 10u); // 1000 milliseconds is 10 ticks
+      REQUIRE (errs.size() == 1u);
+      auto r = make_msg(2u, 42u);
+      corr->reply_received(const_buffer(r.data(), r.size()));
+      corr->cancel_all();
+      corr->expire_requests(tick + 100u);
+      THEN ("the callbacks are called once, with the timeout or cancelled error") {
+        REQUIRE (errs.size() == 3u);
+        REQUIRE (errs[0] == std::make_error_code(net_ip_errc::request_timeout));
+        REQUIRE_FALSE (errs[1]);
+        REQUIRE (errs[2] == std::make_error_code(net_ip_errc::request_cancelled));
+        REQUIRE (replies == std::vector<std::uint32_t> { 42u });
+        REQUIRE (corr->get_num_timeouts() == 1u);
+        REQUIRE (corr->in_flight() == 0u);
+        REQUIRE (corr->send_request(1u, make_msg(1u, 0u), cb));
+      }
+    }
+    AND_WHEN ("the IO handler is gone") {
+      ioh.reset();
+      THEN ("requests are refused") {
+        REQUIRE_FALSE (corr->send_request(1u, make_msg(1u, 0u), cb));
+        REQUIRE (corr->in_flight() == 0u);
+      }
+    }
+  } // end given
+}
+
+SCENARIO ( "Request correlator, table churn with many ids", "[request_correlator] [churn]" ) {
+
+  using namespace chops::net;
+  using namespace std::experimental::net;
+
+  io_context ioc;
+  auto ioh = std::make_shared<req_io_mock>();
+  auto corr = make_request_correlator<req_io_mock>(ioc,
+                 [] (const_buffer buf) { return *static_cast<const std::uint32_t*>(buf.data()); },
+                 std::chrono::milliseconds(1000), 64u);
+  corr->set_io_interface(basic_io_interface<req_io_mock>(ioh));
+
+  GIVEN ("A window of 64 requests in flight") {
+    WHEN ("many requests are sent and completed in a sliding window") {
+      int num_done = 0;
+      bool all_sent = true;
+      auto cb = [&num_done] (std::error_code err, const_buffer) { if (!err) { ++num_done; } };
+      for (std::uint32_t id = 0u; id < 5000u; ++id) {
+        all_sent = all_sent && corr->send_request(id * 7919u, chops::const_shared_buffer(&id, 4u), cb);
+        if (id >= 63u) {
+          std::uint32_t done_id = (id - 63u) * 7919u;
+          corr->reply_received(const_buffer(&done_id, 4u));
+        }
+      }
+      THEN ("every reply finds its request") {
+        REQUIRE (all_sent);
+        REQUIRE (num_done == 5000 - 63);
+        REQUIRE (corr->in_flight() == 63u);
+        REQUIRE (corr->get_num_unmatched() == 0u);
+      }
+    }
+  } // end given
+}
+
@@ -0,0 +1,114 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for @c ring_queue.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch.hpp"
+
+#include <cstddef> // std::size_t
+#include <string>
+#include <vector>
+#include <thread>
+#include <memory>
+
+#include "net_ip/component/ring_queue.hpp"
+
+SCENARIO ( "Ring queue push and pop, single thread", "[ring_queue]" ) {
+
+  GIVEN ("A ring queue with a capacity that is not a power of 2") {
+    chops::net::ring_queue<std::string> rq(5);
+    REQUIRE (rq.capacity() == 8u);
+    REQUIRE (rq.empty());
+
+    WHEN ("the queue is filled past its capacity") {
+      for (int i = 0; i < 10; ++i) {
+        rq.try_emplace_push(std::to_string(i));
+      }
+      THEN ("the extra values are dropped and counted") {
+        REQUIRE (rq.size() == 8u);
+        REQUIRE (rq.num_dropped() == 2u);
+        auto val = rq.try_pop();
+        REQUIRE (val);
+        REQUIRE (*val == "0");
+        REQUIRE (rq.try_push(std::string("10")));
+      }
+    }
+    AND_WHEN ("values are popped in a batch") {
+      for (int i = 0; i < 6; ++i) {
+        rq.try_push(std::to_string(i));
+      }
+      std::vector<std::string> vals;
+      auto num = rq.pop_batch([&vals] (std::string&& s) { vals.push_back(std::move(s)); }, 4u);
+      THEN ("the batch is limited and in order") {
+        REQUIRE (num == 4u);
+        REQUIRE (vals == std::vector<std::string> { "0", "1", "2", "3" });
+        REQUIRE (rq.size() == 2u);
+      }
+    }
+    AND_WHEN ("the queue is closed") {
+      rq.try_push(std::string("a"));
+      rq.close();
+      THEN ("pushes fail without counting as drops and queued values are still popped") {
+        REQUIRE_FALSE (rq.try_push(std::string("b")));
+        REQUIRE (rq.num_dropped() == 0u);
+        std::size_t cnt = 0;
+        REQUIRE (rq.wait_and_pop_batch([&cnt] (std::string&&) { ++cnt; }, 8u) == 1u);
+        REQUIRE (rq.wait_and_pop_batch([&cnt] (std::string&&) { ++cnt; }, 8u) == 0u);
+        REQUIRE (cnt == 1u);
+      }
+    }
+  } // end given
+}
+
+SCENARIO ( "Ring queue with multiple producer threads", "[ring_queue]" ) {
+
+  constexpr int num_thrs = 4;
+  constexpr int num_vals = 20000;
+
+  GIVEN ("A ring queue and a consumer thread") {
+    chops::net::ring_queue<std::unique_ptr<int> > rq(256);
+    std::size_t total = 0;
+    long long sum = 0;
+    std::thread consumer([&] {
+        while (rq.wait_and_pop_batch([&] (std::unique_ptr<int>&& p) { ++total; sum += *p; },
+                                     64u) > 0u) { }
+      }
+    );
+
+    WHEN ("producers push concurrently") {
+      std::vector<std::thread> producers;
+      for (int t = 0; t < num_thrs; ++t) {
+        producers.emplace_back([&rq] {
+            for (int i = 1; i <= num_vals; ++i) {
+              while (!rq.try_emplace_push(std::make_unique<int>(i))) {
+                std::this_thread::yield();
+              }
+            }
+          }
+        );
+      }
+      for (auto& thr : producers) {
+        thr.join();
+      }
+      while (!rq.empty()) {
+        std::this_thread::yield();
+      }
+      rq.close();
+      consumer.join();
+      THEN ("every value is popped exactly once") {
+        REQUIRE (total == static_cast<std::size_t>(num_thrs * num_vals));
+        REQUIRE (sum == static_cast<long long>(num_thrs) * num_vals * (num_vals + 1) / 2);
+      }
+    }
+  } // end given
+}
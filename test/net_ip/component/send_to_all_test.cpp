@@ -75,6 +75,22 @@ SCENARIO ( "Testing send_to_all class",
         REQUIRE(ioh2->send_called);
       }
     }
+    AND_WHEN ("send is called with congested handlers skipped") {
+      std::byte b(static_cast<std::byte>(0xFD));
+      chops::const_shared_buffer buf(&b, 1);
+      auto ioh1 = std::make_shared<io_handler_mock>();
+      auto ioh2 = std::make_shared<io_handler_mock>();
+      ioh2->congested = true;
+      sta.add_io_interface(io_interface_mock(ioh1));
+      sta.add_io_interface(io_interface_mock(ioh2));
+      sta.set_skip_congested(true);
+      sta.send(buf);
+      THEN ("only the uncongested handler is sent to") {
+        REQUIRE(ioh1->send_called);
+        REQUIRE_FALSE(ioh2->send_called);
+        REQUIRE(sta.get_num_skipped() == 1u);
+      }
+    }
     AND_WHEN ("get_total_output_queue_stats is called") {
       auto ioh1 = std::make_shared<io_handler_mock>();
       auto ioh2 = std::make_shared<io_handler_mock>();
@@ -84,6 +100,8 @@ SCENARIO ( "Testing send_to_all class",
         auto tot = sta.get_total_output_queue_stats();
         REQUIRE(tot.output_queue_size == sta.size() * io_handler_mock::qs_base);
         REQUIRE(tot.bytes_in_output_queue == sta.size() * (io_handler_mock::qs_base + 1));
+        REQUIRE(tot.num_write_batches == 0);
+        REQUIRE(tot.max_bufs_in_write_batch == 0);
       }
     }
   } // end given
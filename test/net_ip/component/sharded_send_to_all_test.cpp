@@ -0,0 +1,153 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenario for @c sharded_send_to_all class template.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0. 
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch.hpp"
+
+#include <experimental/internet>
+#include <experimental/io_context>
+
+#include <cstddef> // std::size_t
+#include <memory> // std::make_shared
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <system_error> // std::error_code
+
+#include "net_ip/component/sharded_send_to_all.hpp"
+#include "net_ip/component/worker_pool.hpp"
+#include "net_ip/component/worker.hpp"
+
+#include "net_ip/detail/udp_entity_io.hpp"
+#include "net_ip/io_interface.hpp"
+
+#include "utility/shared_buffer.hpp"
+#include "utility/make_byte_array.hpp"
+#include "utility/repeat.hpp"
+
+using namespace std::experimental::net;
+
+const char*   test_addr = "127.0.0.1";
+constexpr int test_port_base = 30765;
+constexpr int num_senders = 4;
+constexpr int num_msgs = 20;
+
+SCENARIO ( "Testing sharded_send_to_all class, UDP senders spread across a worker pool",
+           "[sharded_send_to_all]" ) {
+
+  chops::net::worker wk;
+  wk.start();
+  chops::net::worker_pool wp(2);
+  wp.start();
+
+  GIVEN ("A receiving UDP entity and senders on two io_contexts") {
+
+    ip::udp::endpoint recv_endp(ip::make_address(test_addr), test_port_base);
+    auto recv_ptr = std::make_shared<chops::net::detail::udp_entity_io>(wk.get_io_context(), 
+                                                                        recv_endp);
+    std::atomic_int recv_cnt = 0;
+    recv_ptr->start(
+      [&recv_cnt] (chops::net::udp_io_interface io, std::size_t, bool starting) {
+        if (starting) {
+          io.start_io(100, [&recv_cnt] (const_buffer, chops::net::udp_io_interface, ip::udp::endpoint) {
+              ++recv_cnt;
+              return true;
+            }
+          );
+        }
+      },
+      [] (chops::net::udp_io_interface, std::error_code) { }
+    );
+
+    std::vector<chops::net::detail::udp_entity_io_ptr> senders;
+    std::vector<chops::net::udp_io_interface> ios;
+    chops::repeat(num_senders, [&] (int i) {
+        auto p = std::make_shared<chops::net::detail::udp_entity_io>(wp.get_io_context(i), 
+                                     ip::udp::endpoint(ip::make_address(test_addr), 
+                                                       test_port_base+i+1));
+        senders.push_back(p);
+        p->start(
+          [&ios, &recv_endp] (chops::net::udp_io_interface io, std::size_t, bool starting) {
+            if (starting) {
+              io.start_io(recv_endp);
+              ios.push_back(io);
+            }
+          },
+          [] (chops::net::udp_io_interface, std::error_code) { }
+        );
+      }
+    );
+    REQUIRE (ios.size() == static_cast<std::size_t>(num_senders));
+
+    WHEN ("the senders are added with the default chunk size") {
+      chops::net::sharded_send_to_all<chops::net::udp_io> ssta { };
+      for (auto io : ios) {
+        ssta.add_io_interface(io);
+      }
+      THEN ("the senders are grouped by io_context, and removal shrinks the groups") {
+        REQUIRE (ssta.size() == static_cast<std::size_t>(num_senders));
+        REQUIRE (ssta.num_chunks() == 2u);
+        ssta.remove_io_interface(ios[0]);
+        REQUIRE (ssta.size() == static_cast<std::size_t>(num_senders-1));
+        REQUIRE (ssta.num_chunks() == 2u);
+        ssta(ios[2], 0, false);
+        REQUIRE (ssta.num_chunks() == 1u);
+        ssta(ios[0], 1, true);
+        REQUIRE (ssta.num_chunks() == 2u);
+      }
+    }
+
+    AND_WHEN ("the senders are added with a chunk size of 1 and messages are sent") {
+      chops::net::sharded_send_to_all<chops::net::udp_io> ssta { 1u };
+      for (auto io : ios) {
+        ssta(io, 1, true);
+      }
+      REQUIRE (ssta.num_chunks() == static_cast<std::size_t>(num_senders));
+      auto ba = chops::make_byte_array(0x20, 0x21, 0x22, 0x23, 0x24);
+      chops::repeat(num_msgs, [&ssta, &ba] () {
+          ssta.send(chops::const_shared_buffer(ba.data(), ba.size()));
+        }
+      );
+      // delivery is asynchronous, wait for all datagrams to arrive
+      chops::repeat(100, [&recv_cnt] () {
+          if (recv_cnt < num_senders * num_msgs) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+          }
+        }
+      );
+      THEN ("every sender sends every message") {
+        REQUIRE (recv_cnt == num_senders * num_msgs);
+        auto qs = ssta.get_total_output_queue_stats();
+        REQUIRE (qs.total_bufs_sent == static_cast<std::size_t>(num_senders * num_msgs));
+        REQUIRE (qs.total_bytes_sent == static_cast<std::size_t>(num_senders * num_msgs * 5));
+        // every sent buffer is counted in the latency histogram
+        std::size_t hist_tot = 0u;
+        for (auto h : qs.latency_histogram) {
+          hist_tot += h;
+        }
+        REQUIRE (hist_tot == qs.total_bufs_sent);
+      }
+    }
+
+    for (auto p : senders) {
+      p->stop();
+    }
+    recv_ptr->stop();
+  } // end given
+
+  wp.reset();
+  wk.reset();
+}
+
@@ -0,0 +1,163 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for @c worker_pool class.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch.hpp"
+
+#include <experimental/internet>
+#include <experimental/socket>
+#include <experimental/io_context>
+#include <experimental/executor>
+
+#include <cstddef> // std::size_t
+#include <memory> // std::make_shared
+#include <thread>
+#include <future>
+#include <mutex>
+#include <atomic>
+#include <set>
+#include <vector>
+#include <system_error> // std::error_code
+
+#include "net_ip/component/worker_pool.hpp"
+#include "net_ip/detail/tcp_acceptor.hpp"
+#include "net_ip/endpoints_resolver.hpp"
+#include "net_ip/io_interface.hpp"
+
+#include "utility/repeat.hpp"
+
+using namespace std::experimental::net;
+
+const char* test_port = "30777";
+const char* test_host = "";
+
+SCENARIO ( "Worker pool, io_context per thread",
+           "[worker_pool] [context_per_thread]" ) {
+
+  GIVEN ("A worker pool with four threads and four io_contexts") {
+    chops::net::worker_pool wp(4);
+    REQUIRE (wp.size() == 4u);
+    REQUIRE (wp.num_threads() == 4u);
+
+    WHEN ("get_next_io_context is called five times") {
+      std::vector<io_context*> iocs;
+      chops::repeat(5, [&iocs, &wp] () { iocs.push_back(&wp.get_next_io_context()); } );
+      THEN ("the contexts are used in round-robin order") {
+        REQUIRE (std::set<io_context*>(iocs.begin(), iocs.begin()+4).size() == 4u);
+        REQUIRE (iocs[4] == iocs[0]);
+      }
+    }
+    AND_WHEN ("the pool is started and work is posted to each context") {
+      wp.start();
+      std::vector<std::future<std::thread::id> > futs;
+      chops::repeat(4, [&futs, &wp] (int i) {
+          auto prom = std::make_shared<std::promise<std::thread::id> >();
+          futs.push_back(prom->get_future());
+          post(wp.get_io_context(i), [prom] { prom->set_value(std::this_thread::get_id()); } );
+        }
+      );
+      std::set<std::thread::id> ids;
+      for (auto& f : futs) {
+        ids.insert(f.get());
+      }
+      wp.reset();
+      THEN ("each context runs on its own thread") {
+        REQUIRE (ids.size() == 4u);
+      }
+    }
+  } // end given
+}
+
+SCENARIO ( "Worker pool, shared io_context",
+           "[worker_pool] [shared_context]" ) {
+
+  constexpr int num_posts = 1000;
+
+  GIVEN ("A worker pool with four threads pinned to CPUs and a shared io_context") {
+    chops::net::worker_pool wp(4, chops::net::worker_pool::mode::shared_context, true);
+    REQUIRE (wp.size() == 1u);
+    REQUIRE (wp.num_threads() == 4u);
+    REQUIRE (&wp.get_next_io_context() == &wp.get_io_context());
+
+    WHEN ("the pool is started and many handlers are posted") {
+      wp.start();
+      std::atomic_int cnt = 0;
+      chops::repeat(num_posts, [&cnt, &wp] () {
+          post(wp.get_io_context(), [&cnt] { ++cnt; } );
+        }
+      );
+      wp.reset();
+      THEN ("all handlers are run") {
+        REQUIRE (cnt == num_posts);
+      }
+    }
+  } // end given
+}
+
+SCENARIO ( "Worker pool, tcp acceptor distributing connections across io_contexts",
+           "[worker_pool] [tcp_acc]" ) {
+
+  constexpr int num_conns = 4;
+
+  chops::net::worker_pool wp(num_conns);
+  wp.start();
+
+  GIVEN ("A tcp acceptor using the worker pool io_context selector") {
+
+    auto endp_seq =
+        chops::net::endpoints_resolver<ip::tcp>(wp.get_io_context()).make_endpoints(true,
+                                                                        test_host, test_port);
+    auto acc_ptr = std::make_shared<chops::net::detail::tcp_acceptor>(wp.get_io_context(),
+                                  *(endp_seq.cbegin()), true, wp.make_io_context_selector());
+
+    std::mutex mut;
+    std::set<io_context*> iocs;
+    std::promise<void> all_prom;
+    auto all_fut = all_prom.get_future();
+
+    acc_ptr->start(
+      [&mut, &iocs, &all_prom] (chops::net::tcp_io_interface io, std::size_t num, bool starting) {
+        if (starting) {
+          std::lock_guard<std::mutex> lk(mut);
+          iocs.insert(&io.get_socket().get_executor().context());
+          if (num == num_conns) {
+            all_prom.set_value();
+          }
+        }
+      },
+      [] (chops::net::tcp_io_interface, std::error_code) { }
+    );
+
+    WHEN ("multiple connects are made") {
+      io_context conn_ioc;
+      std::vector<ip::tcp::socket> socks;
+      auto conn_endps =
+          chops::net::endpoints_resolver<ip::tcp>(conn_ioc).make_endpoints(true, test_host, test_port);
+      chops::repeat(num_conns, [&socks, &conn_ioc, &conn_endps] () {
+          socks.emplace_back(conn_ioc);
+          connect(socks.back(), conn_endps);
+        }
+      );
+      all_fut.get();
+      THEN ("each connection is placed on a different io_context") {
+        std::lock_guard<std::mutex> lk(mut);
+        REQUIRE (iocs.size() == static_cast<std::size_t>(num_conns));
+      }
+      acc_ptr->stop();
+    }
+  } // end given
+
+  wp.reset();
+}
+
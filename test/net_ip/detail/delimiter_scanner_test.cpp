@@ -0,0 +1,151 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for @c find_delimiter and the @c delimiter_scanner detail class.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch.hpp"
+
+#include <cstddef> // std::size_t, std::byte
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "net_ip/detail/delimiter_scanner.hpp"
+
+namespace {
+
+const std::byte* as_bytes(std::string_view sv) {
+  return reinterpret_cast<const std::byte*>(sv.data());
+}
+
+// scan a stream delivered in chunks, returning the message sizes
+std::vector<std::size_t> scan_chunks(std::string_view stream, std::string_view delim,
+                                     std::size_t chunk_size) {
+  chops::net::detail::delimiter_scanner scanner(delim);
+  std::vector<std::size_t> sizes;
+  std::size_t begin = 0u;
+  for (std::size_t end = chunk_size; begin < stream.size(); end += chunk_size) {
+    end = (end > stream.size()) ? stream.size() : end;
+    std::size_t sz = 0u;
+    while ((sz = scanner.scan(as_bytes(stream) + begin, end - begin)) != 0u) {
+      sizes.push_back(sz);
+      begin += sz;
+    }
+    if (end == stream.size()) {
+      break;
+    }
+  }
+  return sizes;
+}
+
+}
+
+SCENARIO ( "Find delimiter, single and multiple byte delimiters",
+           "[delimiter_scanner] [find_delimiter]" ) {
+
+  using chops::net::detail::find_delimiter;
+
+  GIVEN ("A byte range") {
+    std::string_view s("abc\rdef\r\nghi\n");
+    auto first = as_bytes(s);
+    auto last = first + s.size();
+
+    WHEN ("a single byte delimiter is searched for") {
+      THEN ("the first occurrence is found") {
+        REQUIRE (find_delimiter(first, last, "\n") == first + 8);
+        REQUIRE (find_delimiter(first, last, "d") == first + 4);
+      }
+    }
+    AND_WHEN ("a multiple byte delimiter is searched for") {
+      THEN ("partial matches are skipped") {
+        REQUIRE (find_delimiter(first, last, "\r\n") == first + 7);
+        REQUIRE (find_delimiter(first, last, "ghi\n") == first + 9);
+      }
+    }
+    AND_WHEN ("the delimiter is not present, or only partly at the end") {
+      THEN ("last is returned") {
+        REQUIRE (find_delimiter(first, last, "x") == last);
+        REQUIRE (find_delimiter(first, last, "\nz") == last);
+        REQUIRE (find_delimiter(first, first + 2, "abc") == first + 2);
+        REQUIRE (find_delimiter(first, first, "\n") == first);
+        REQUIRE (find_delimiter(first, last, "") == last);
+      }
+    }
+  } // end given
+}
+
+SCENARIO ( "Delimiter scanner, messages delivered in chunks",
+           "[delimiter_scanner]" ) {
+
+  GIVEN ("A stream of CR / LF delimited messages") {
+    std::string stream;
+    std::vector<std::size_t> expected;
+    for (std::size_t i = 0u; i < 50u; ++i) {
+      std::string msg(i * 7u % 31u, 'a');
+      msg += "\r\n";
+      expected.push_back(msg.size());
+      stream += msg;
+    }
+
+    WHEN ("the stream is scanned in chunks of various sizes") {
+      THEN ("every message is found, including delimiters split across chunks") {
+        for (std::size_t chunk : { 1u, 2u, 3u, 7u, 64u, 4096u }) {
+          REQUIRE (scan_chunks(stream, "\r\n", chunk) == expected);
+        }
+      }
+    }
+  } // end given
+
+  GIVEN ("A default constructed scanner, with no delimiter") {
+    chops::net::detail::delimiter_scanner scanner;
+    std::string_view s("abc\n");
+
+    WHEN ("bytes are scanned") {
+      THEN ("no message is found") {
+        REQUIRE (scanner.scan(as_bytes(s), s.size()) == 0u);
+        REQUIRE (scanner.scanned() == 0u);
+      }
+    }
+  } // end given
+
+  GIVEN ("A scanner for a single byte delimiter") {
+    chops::net::detail::delimiter_scanner scanner("\n");
+    REQUIRE (scanner.delimiter() == "\n");
+    std::string_view s("abcdefgh\n");
+
+    WHEN ("a partial message is scanned") {
+      REQUIRE (scanner.scan(as_bytes(s), 5u) == 0u);
+      THEN ("the scanned bytes are remembered, and the message is found when complete") {
+        REQUIRE (scanner.scanned() == 5u);
+        REQUIRE (scanner.scan(as_bytes(s), s.size()) == s.size());
+        REQUIRE (scanner.scanned() == 0u);
+      }
+    }
+    AND_WHEN ("the scanner is reset with a different delimiter") {
+      REQUIRE (scanner.scan(as_bytes(s), 5u) == 0u);
+      scanner.reset("gh");
+      THEN ("the new delimiter is searched from the start of the message") {
+        REQUIRE (scanner.scanned() == 0u);
+        REQUIRE (scanner.scan(as_bytes(s), s.size()) == 8u);
+      }
+    }
+    AND_WHEN ("the scanner is reset with an empty delimiter") {
+      THEN ("the reset is rejected and the previous delimiter is kept") {
+        REQUIRE_FALSE (scanner.reset(""));
+        REQUIRE (scanner.delimiter() == "\n");
+        REQUIRE (scanner.scan(as_bytes(s), s.size()) == s.size());
+      }
+    }
+  } // end given
+}
+
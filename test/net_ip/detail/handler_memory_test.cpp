@@ -0,0 +1,100 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for @c handler_memory, @c handler_allocator and @c alloc_handler.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch.hpp"
+
+#include <experimental/io_context>
+#include <experimental/executor>
+
+#include <cstddef> // std::size_t
+#include <vector>
+
+#include "net_ip/detail/handler_memory.hpp"
+
+using namespace std::experimental::net;
+
+// each handler posts the next one, so one operation of the chain is outstanding at a time
+struct chain {
+  io_context&                         m_ioc;
+  chops::net::detail::handler_memory& m_mem;
+  int&                                m_cnt;
+  int                                 m_max;
+
+  void operator()() {
+    REQUIRE (m_mem.num_in_use() == 0u); // storage is freed before the upcall
+    if (++m_cnt < m_max) {
+      post(m_ioc, chops::net::detail::make_alloc_handler(m_mem, *this));
+    }
+  }
+};
+
+SCENARIO ( "Handler memory slot reuse and heap fallback",
+           "[handler_memory]" ) {
+
+  using hm = chops::net::detail::handler_memory;
+
+  GIVEN ("A handler memory object") {
+    hm mem;
+    REQUIRE (mem.num_in_use() == 0u);
+
+    WHEN ("more allocations are made than there are slots") {
+      chops::net::detail::handler_allocator<int> alloc(mem);
+      std::vector<int*> ptrs;
+      for (std::size_t i = 0u; i < hm::num_slots + 1u; ++i) {
+        ptrs.push_back(alloc.allocate(4u));
+      }
+      THEN ("the slots are used first, then the heap, and freed slots are reused") {
+        REQUIRE (mem.num_in_use() == hm::num_slots);
+        REQUIRE (mem.num_heap_allocations() == 1u);
+        for (auto p : ptrs) {
+          alloc.deallocate(p, 4u);
+        }
+        REQUIRE (mem.num_in_use() == 0u);
+        REQUIRE (alloc.allocate(1u) == ptrs[0]);
+        REQUIRE (alloc == chops::net::detail::handler_allocator<char>(mem));
+      }
+    }
+    AND_WHEN ("an allocation is larger than the slot") {
+      chops::net::detail::handler_allocator<char> alloc(mem);
+      char* p = alloc.allocate(hm::slot_size + 1u);
+      THEN ("the heap is used") {
+        REQUIRE (mem.num_in_use() == 0u);
+        REQUIRE (mem.num_heap_allocations() == 1u);
+        alloc.deallocate(p, hm::slot_size + 1u);
+      }
+    }
+  } // end given
+}
+
+SCENARIO ( "Alloc handler used as the associated allocator of posted handlers",
+           "[handler_memory] [alloc_handler]" ) {
+
+  GIVEN ("An io_context and a handler memory object") {
+    io_context ioc;
+    chops::net::detail::handler_memory mem;
+    int cnt = 0;
+
+    WHEN ("a chain of handlers is posted") {
+      post(ioc, chops::net::detail::make_alloc_handler(mem, chain { ioc, mem, cnt, 1000 }));
+      ioc.run();
+      THEN ("every handler runs and no operation falls back to the heap") {
+        REQUIRE (cnt == 1000);
+        REQUIRE (mem.num_heap_allocations() == 0u);
+        REQUIRE (mem.num_in_use() == 0u);
+      }
+    }
+  } // end given
+}
+
@@ -0,0 +1,75 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for @c handler_registry.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch.hpp"
+
+#include <memory>
+#include <vector>
+
+#include "net_ip/detail/handler_registry.hpp"
+#include "net_ip/io_handler_id.hpp"
+
+using int_registry = chops::net::detail::handler_registry<std::shared_ptr<int> >;
+
+SCENARIO ( "Handler registry insert, erase and slot reuse", "[handler_registry]" ) {
+
+  GIVEN ("A registry with three entries") {
+    int_registry reg;
+    REQUIRE (reg.empty());
+    auto id0 = reg.insert(std::make_shared<int>(0));
+    auto id1 = reg.insert(std::make_shared<int>(1));
+    auto id2 = reg.insert(std::make_shared<int>(2));
+    REQUIRE (reg.size() == 3u);
+    REQUIRE (id0.is_valid());
+    REQUIRE (id0 != id1);
+    REQUIRE (*reg.find(id1) == 1);
+
+    WHEN ("an entry is erased and a new one inserted") {
+      REQUIRE (reg.erase(id1));
+      auto id3 = reg.insert(std::make_shared<int>(3));
+      THEN ("the slot is reused with a new generation and the old id is stale") {
+        REQUIRE (reg.size() == 3u);
+        REQUIRE (id3.index == id1.index);
+        REQUIRE (id3 != id1);
+        REQUIRE_FALSE (reg.contains(id1));
+        REQUIRE_FALSE (reg.find(id1));
+        REQUIRE_FALSE (reg.erase(id1));
+        REQUIRE (*reg.find(id3) == 3);
+        REQUIRE (*reg.find(id2) == 2);
+      }
+    }
+    AND_WHEN ("every entry is erased while iterating") {
+      std::vector<chops::net::io_handler_id> ids { id0, id1, id2 };
+      int sum = 0;
+      reg.for_each([&] (const std::shared_ptr<int>& p) {
+          sum += *p;
+          reg.erase(ids[*p]);
+        }
+      );
+      THEN ("each entry is visited once and the registry is empty") {
+        REQUIRE (sum == 3);
+        REQUIRE (reg.empty());
+      }
+    }
+    AND_WHEN ("a default constructed id is used") {
+      THEN ("it is not found") {
+        REQUIRE_FALSE (chops::net::io_handler_id().is_valid());
+        REQUIRE_FALSE (reg.contains(chops::net::io_handler_id()));
+        REQUIRE_FALSE (reg.erase(chops::net::io_handler_id()));
+      }
+    }
+  } // end given
+}
+
@@ -18,9 +18,11 @@
 #include <experimental/internet> // endpoint declarations
 #include <experimental/io_context>
 
+#include <cstdint> // std::int64_t
 #include <memory> // std::shared_ptr
 #include <system_error> // std::error_code
 #include <utility> // std::move
+#include <vector>
 
 #include "net_ip/detail/output_queue.hpp"
 #include "net_ip/detail/io_common.hpp"
@@ -106,6 +108,48 @@ void io_common_test(chops::const_shared_buffer buf, int num_bufs,
       THEN ("all bufs but the first one are queued") {
         REQUIRE (iocommon.is_write_in_progress());
         REQUIRE (iocommon.get_output_queue_stats().output_queue_size == (num_bufs-1));
+        REQUIRE (iocommon.get_output_queue_stats().num_queued_while_busy == (num_bufs-1));
+      }
+    }
+
+    AND_WHEN ("Msg_received is called") {
+      chops::repeat(num_bufs, [&iocommon, &buf] () { iocommon.msg_received(buf.size()); } );
+      THEN ("the received totals match") {
+        auto qs = iocommon.get_output_queue_stats();
+        REQUIRE (qs.total_msgs_received == num_bufs);
+        REQUIRE (qs.total_bytes_received == (num_bufs * buf.size()));
+      }
+    }
+
+    AND_WHEN ("Bufs are queued, taken and written") {
+      using chops::net::net_metric;
+      auto before = chops::net::metrics_registry::snapshot();
+      bool ret = iocommon.set_io_started();
+      REQUIRE (ret);
+      chops::repeat(num_bufs, [&iocommon, &buf, &endp] () {
+          iocommon.enqueue_element(buf, endp);
+        }
+      );
+      auto e = iocommon.get_next_element();
+      REQUIRE (e);
+      iocommon.write_complete();
+      auto after = chops::net::metrics_registry::snapshot();
+      THEN ("the metrics registry counts the sent buf and the remaining queue depth") {
+        REQUIRE ((after[net_metric::bufs_sent] - before[net_metric::bufs_sent]) == 1);
+        REQUIRE ((after[net_metric::bytes_sent] - before[net_metric::bytes_sent]) ==
+                 static_cast<std::int64_t>(buf.size()));
+        REQUIRE ((after[net_metric::output_queue_bufs] - before[net_metric::output_queue_bufs]) ==
+                 (num_bufs-1));
+      }
+    }
+
+    AND_WHEN ("Read_buffer_changed is called with a larger and then a smaller size") {
+      iocommon.read_buffer_changed(65536u);
+      iocommon.read_buffer_changed(512u);
+      THEN ("the current and largest read buffer sizes are reported") {
+        auto qs = iocommon.get_output_queue_stats();
+        REQUIRE (qs.read_buffer_bytes == 512u);
+        REQUIRE (qs.max_read_buffer_bytes == 65536u);
       }
     }
 
@@ -145,6 +189,121 @@ void io_common_test(chops::const_shared_buffer buf, int num_bufs,
       }
     }
 
+    AND_WHEN ("Enqueue_element is called before set_io_started") {
+      bool ret = iocommon.enqueue_element(buf);
+      THEN ("the call returns false and nothing is queued") {
+        REQUIRE_FALSE (ret);
+        REQUIRE (iocommon.get_output_queue_stats().output_queue_size == 0);
+      }
+    }
+
+    AND_WHEN ("Enqueue_element is called many times after set_io_started") {
+      bool ret = iocommon.set_io_started();
+      REQUIRE (ret);
+      int num_claims = 0;
+      chops::repeat(num_bufs, [&iocommon, &buf, &endp, &num_claims] () { 
+          if (iocommon.enqueue_element(buf, endp)) {
+            ++num_claims;
+          }
+        }
+      );
+      THEN ("only the first call claims the writer and all bufs are queued") {
+        REQUIRE (num_claims == 1);
+        REQUIRE (iocommon.is_write_in_progress());
+        REQUIRE (iocommon.get_output_queue_stats().output_queue_size == num_bufs);
+        chops::repeat(num_bufs, [&iocommon, &buf] () { 
+            auto e = iocommon.get_next_element();
+            REQUIRE (e);
+            REQUIRE (e->first == buf);
+          }
+        );
+        REQUIRE (iocommon.is_write_in_progress());
+        REQUIRE_FALSE (iocommon.get_next_element());
+        REQUIRE_FALSE (iocommon.is_write_in_progress());
+        REQUIRE (iocommon.enqueue_element(buf));
+      }
+    }
+
+  } // end given
+}
+
+template <typename IOT>
+void queue_limits_test(chops::const_shared_buffer buf, int num_bufs) {
+
+  REQUIRE (num_bufs > 4);
+
+  std::vector<std::error_code> events;
+  auto notify = [&events] (std::error_code e) { events.push_back(e); };
+
+  GIVEN ("An io_common with io started") {
+
+    chops::net::detail::io_common<IOT> iocommon { };
+    iocommon.set_io_started();
+    iocommon.enqueue_element(buf); // writer is busy for the remainder
+    iocommon.get_next_element();
+
+    WHEN ("a buf limit with the drop newest policy is set and many bufs are sent") {
+      iocommon.set_output_queue_limits(chops::net::output_queue_limits { 3, 0 });
+      chops::repeat(num_bufs, [&iocommon, &buf] () { iocommon.enqueue_element(buf); } );
+      THEN ("the queue is held at the limit and the rest are dropped") {
+        auto qs = iocommon.get_output_queue_stats();
+        REQUIRE (qs.output_queue_size == 3);
+        REQUIRE (qs.num_dropped == (num_bufs - 3));
+        REQUIRE (iocommon.is_output_congested());
+        REQUIRE_FALSE (iocommon.claim_queue_events());
+      }
+    }
+    AND_WHEN ("a byte limit with the drop oldest policy is set and many bufs are sent") {
+      iocommon.set_output_queue_limits(chops::net::output_queue_limits { 0, 2 * buf.size(), 0, 0,
+                                            chops::net::overflow_policy::drop_oldest });
+      chops::repeat(num_bufs, [&iocommon, &buf] () { iocommon.enqueue_element(buf); } );
+      REQUIRE (iocommon.claim_queue_events());
+      REQUIRE_FALSE (iocommon.claim_queue_events()); // already claimed
+      REQUIRE (iocommon.process_queue_events(notify));
+      THEN ("the oldest bufs are dropped by the io handler") {
+        auto qs = iocommon.get_output_queue_stats();
+        REQUIRE (qs.output_queue_size == 2);
+        REQUIRE (qs.num_dropped == (num_bufs - 2));
+        REQUIRE (events.empty());
+      }
+    }
+    AND_WHEN ("a buf limit with the coalesce policy is set and many bufs are sent") {
+      iocommon.set_output_queue_limits(chops::net::output_queue_limits { 4, 0, 0, 0,
+                                            chops::net::overflow_policy::coalesce });
+      chops::repeat(num_bufs, [&iocommon, &buf] () { iocommon.enqueue_element(buf); } );
+      REQUIRE (iocommon.process_queue_events(notify));
+      THEN ("only the newest buf is kept") {
+        REQUIRE (iocommon.get_output_queue_stats().output_queue_size == 1);
+      }
+    }
+    AND_WHEN ("a buf limit with the disconnect policy is set and the limit is exceeded") {
+      iocommon.set_output_queue_limits(chops::net::output_queue_limits { 2, 0, 0, 0,
+                                            chops::net::overflow_policy::disconnect });
+      chops::repeat(3, [&iocommon, &buf] () { iocommon.enqueue_element(buf); } );
+      THEN ("event processing signals a disconnect") {
+        REQUIRE_FALSE (iocommon.process_queue_events(notify));
+      }
+    }
+    AND_WHEN ("watermarks are set and the queue is filled and then drained") {
+      iocommon.set_output_queue_limits(chops::net::output_queue_limits { 0, 0, 
+                                            3 * buf.size(), buf.size() });
+      chops::repeat(num_bufs, [&iocommon, &buf] () { iocommon.enqueue_element(buf); } );
+      REQUIRE (iocommon.is_output_congested());
+      REQUIRE (iocommon.claim_queue_events());
+      REQUIRE (iocommon.process_queue_events(notify));
+      REQUIRE (events.size() == 1u);
+      chops::repeat(num_bufs - 1, [&iocommon, &notify] () { 
+          iocommon.get_next_element();
+          iocommon.process_queue_events(notify);
+        }
+      );
+      THEN ("high and then low watermark notifications are delivered") {
+        REQUIRE (events.size() == 2u);
+        REQUIRE (events[0] == std::make_error_code(chops::net::net_ip_errc::output_queue_high_watermark));
+        REQUIRE (events[1] == std::make_error_code(chops::net::net_ip_errc::output_queue_low_watermark));
+        REQUIRE_FALSE (iocommon.is_output_congested());
+      }
+    }
   } // end given
 }
 
@@ -161,3 +320,10 @@ SCENARIO ( "Io common test", "[io_common]" ) {
   io_common_test<io_mock>(chops::const_shared_buffer(std::move(mb)), 20, 42.0);
 }
 
+SCENARIO ( "Io common test, output queue limits and overflow policies", 
+           "[io_common] [queue_limits]" ) {
+
+  auto ba = chops::make_byte_array(0x30, 0x31, 0x32, 0x33);
+  queue_limits_test<io_mock>(chops::const_shared_buffer(ba.data(), ba.size()), 12);
+}
+
@@ -0,0 +1,102 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for @c uring_multishot_recv detail class.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch.hpp"
+
+#include "net_ip/detail/io_uring.hpp"
+
+#ifdef IORING_RECV_MULTISHOT
+
+#include <system_error>
+#include <cstring> // std::memcpy
+#include <cstddef> // std::size_t, std::byte
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+
+SCENARIO ( "Io uring multishot receive, bursts larger than the buffer ring",
+           "[io_uring]" ) {
+
+  constexpr int num_dgrams = 1000;
+  constexpr int num_bursts = 3;
+
+  GIVEN ("A bound UDP socket and a multishot receive with 8 buffers") {
+
+    int rx = ::socket(AF_INET, SOCK_DGRAM, 0);
+    REQUIRE (rx >= 0);
+    int rcv_size = 4 * 1024 * 1024;
+    ::setsockopt(rx, SOL_SOCKET, SO_RCVBUF, &rcv_size, sizeof(rcv_size));
+    ::sockaddr_in addr { };
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    REQUIRE (::bind(rx, reinterpret_cast<::sockaddr*>(&addr), sizeof(addr)) == 0);
+    ::socklen_t len = sizeof(addr);
+    ::getsockname(rx, reinterpret_cast<::sockaddr*>(&addr), &len);
+    int tx = ::socket(AF_INET, SOCK_DGRAM, 0);
+
+    bool have_ring = true;
+    try {
+      chops::net::detail::uring_multishot_recv ring(rx, 8u, 1500u);
+      REQUIRE_FALSE (ring.arm());
+
+      WHEN ("bursts of datagrams arrive without the ring being drained") {
+        int cnt = 0;
+        bool in_order = true;
+        std::error_code ec;
+        for (int b = 0; b < num_bursts; ++b) {
+          for (int i = 0; i < num_dgrams; ++i) {
+            int val = b * num_dgrams + i;
+            ::sendto(tx, &val, sizeof(val), 0, reinterpret_cast<::sockaddr*>(&addr),
+                     sizeof(addr));
+          }
+          // bounded wait, a receive that is not re-armed stops delivering
+          for (int w = 0; w < 500 && cnt < (b + 1) * num_dgrams && !ec; ++w) {
+            ::pollfd pfd { ring.ring_fd(), POLLIN, 0 };
+            ::poll(&pfd, 1, 10);
+            do {
+              ring.drain([&cnt, &in_order] (const std::byte* data, std::size_t sz,
+                                            const void*, std::size_t) {
+                  int val;
+                  std::memcpy(&val, data, sizeof(val));
+                  in_order = in_order && (sz == sizeof(int)) && (val == cnt);
+                  ++cnt;
+                  return true;
+                }, ec);
+            } while (!ec && ring.has_completions());
+          }
+        }
+        THEN ("every datagram is delivered in order") {
+          REQUIRE_FALSE (ec);
+          REQUIRE (cnt == num_bursts * num_dgrams);
+          REQUIRE (in_order);
+        }
+      }
+    }
+    catch (const std::system_error&) { // io_uring not available or not permitted
+      have_ring = false;
+    }
+    if (!have_ring) {
+      WARN ("io_uring multishot receive not available, test skipped");
+    }
+    ::close(tx);
+    ::close(rx);
+  } // end given
+}
+
+#endif
+
@@ -16,6 +16,9 @@
 #include "catch.hpp"
 
 #include <utility> // std::move
+#include <vector>
+#include <thread>
+#include <cstddef> // std::size_t
 
 #include <experimental/internet> // endpoint declarations
 
@@ -83,6 +86,147 @@ void get_next_element_test(chops::const_shared_buffer buf, int num_bufs,
   } // end given
 }
 
+template <typename E>
+void get_next_elements_test(chops::const_shared_buffer buf, int num_bufs) {
+
+  REQUIRE (num_bufs > 4);
+
+  GIVEN ("A default constructed output_queue with bufs added") {
+    chops::net::detail::output_queue<E> outq { };
+    chops::repeat(num_bufs, [&outq, &buf] () { outq.add_element(buf); } );
+    std::vector<chops::const_shared_buffer> bufs;
+
+    WHEN ("get_next_elements is called with a buf count limit") {
+      auto cnt = outq.get_next_elements(bufs, 3, 10000);
+      THEN ("the limit is used and the queue_stats match") {
+        REQUIRE (cnt == 3);
+        REQUIRE (bufs.size() == 3);
+        REQUIRE (bufs[0] == buf);
+        auto qs = outq.get_queue_stats();
+        REQUIRE (qs.output_queue_size == (num_bufs - 3));
+        REQUIRE (qs.bytes_in_output_queue == ((num_bufs - 3) * buf.size()));
+        REQUIRE (qs.num_write_batches == 1);
+        REQUIRE (qs.bufs_in_write_batches == 3);
+        REQUIRE (qs.max_bufs_in_write_batch == 3);
+      }
+    }
+    AND_WHEN ("get_next_elements is called with a byte limit") {
+      auto cnt = outq.get_next_elements(bufs, num_bufs, 2 * buf.size() + 1);
+      THEN ("the byte limit is used") {
+        REQUIRE (cnt == 2);
+        REQUIRE (outq.get_queue_stats().output_queue_size == (num_bufs - 2));
+      }
+    }
+    AND_WHEN ("get_next_elements is called with a byte limit smaller than one buf") {
+      auto cnt = outq.get_next_elements(bufs, num_bufs, 1);
+      THEN ("one buf is always returned") {
+        REQUIRE (cnt == 1);
+        REQUIRE (bufs.size() == 1);
+      }
+    }
+    AND_WHEN ("get_next_elements is called until the queue is empty") {
+      std::size_t tot = 0;
+      while (auto cnt = outq.get_next_elements(bufs, 4, 10000)) {
+        tot += cnt;
+      }
+      THEN ("all bufs are returned and the batch stats match") {
+        REQUIRE (tot == num_bufs);
+        REQUIRE (bufs.size() == num_bufs);
+        auto qs = outq.get_queue_stats();
+        REQUIRE (qs.output_queue_size == 0);
+        REQUIRE (qs.bytes_in_output_queue == 0);
+        REQUIRE (qs.num_write_batches == ((num_bufs + 3) / 4));
+        REQUIRE (qs.bufs_in_write_batches == num_bufs);
+        REQUIRE (qs.max_bufs_in_write_batch == 4);
+        REQUIRE_FALSE (outq.get_next_element());
+      }
+    }
+  } // end given
+}
+
+template <typename E>
+void sent_stats_test(chops::const_shared_buffer buf, int num_bufs) {
+
+  REQUIRE (num_bufs > 4);
+
+  GIVEN ("A default constructed output_queue with bufs added") {
+    chops::net::detail::output_queue<E> outq { };
+    chops::repeat(num_bufs, [&outq, &buf] () { outq.add_element(buf); } );
+
+    WHEN ("some bufs are taken but the write has not completed") {
+      outq.get_next_element();
+      auto qs = outq.get_queue_stats();
+      THEN ("the high-water marks are set and nothing is counted as sent") {
+        REQUIRE (qs.max_output_queue_size == num_bufs);
+        REQUIRE (qs.max_bytes_in_output_queue == (num_bufs * buf.size()));
+        REQUIRE (qs.output_queue_size == (num_bufs - 1));
+        REQUIRE (qs.total_bufs_sent == 0);
+        REQUIRE (qs.total_bytes_sent == 0);
+      }
+    }
+    AND_WHEN ("all bufs are taken, singly and in batches, and each write completes") {
+      std::vector<chops::const_shared_buffer> bufs;
+      outq.get_next_element();
+      outq.write_complete();
+      while (outq.get_next_elements(bufs, 3, 10000) != 0) {
+        outq.write_complete();
+      }
+      outq.write_complete(); // no bufs in flight, no effect
+      auto qs = outq.get_queue_stats();
+      THEN ("the sent totals and latency histogram match") {
+        REQUIRE (qs.total_bufs_sent == num_bufs);
+        REQUIRE (qs.total_bytes_sent == (num_bufs * buf.size()));
+        REQUIRE (qs.max_output_queue_size == num_bufs);
+        std::size_t tot = 0;
+        for (auto c : qs.latency_histogram) {
+          tot += c;
+        }
+        REQUIRE (tot == num_bufs);
+        REQUIRE (qs.output_queue_size == 0);
+      }
+    }
+  } // end given
+}
+
+template <typename E>
+void multi_producer_test(chops::const_shared_buffer buf, int num_producers, int num_bufs) {
+
+  GIVEN ("A default constructed output_queue and multiple producer threads") {
+    chops::net::detail::output_queue<E> outq { };
+
+    WHEN ("the producers add bufs concurrently while the consumer takes them") {
+      std::vector<std::thread> producers;
+      chops::repeat(num_producers, [&producers, &outq, &buf, num_bufs] () {
+          producers.push_back(std::thread([&outq, &buf, num_bufs] () {
+              chops::repeat(num_bufs, [&outq, &buf] () { outq.add_element(buf); } );
+            }
+          ));
+        }
+      );
+      std::size_t tot = 0u;
+      std::size_t expected = static_cast<std::size_t>(num_producers * num_bufs);
+      while (tot < expected) {
+        auto e = outq.get_next_element();
+        if (e) {
+          REQUIRE (e->first == buf);
+          ++tot;
+        }
+      }
+      for (auto& t : producers) {
+        t.join();
+      }
+      THEN ("every buf is taken exactly once and the queue is empty") {
+        REQUIRE (tot == expected);
+        REQUIRE (outq.empty());
+        REQUIRE_FALSE (outq.get_next_element());
+        auto qs = outq.get_queue_stats();
+        REQUIRE (qs.output_queue_size == 0);
+        REQUIRE (qs.bytes_in_output_queue == 0);
+      }
+    }
+  } // end given
+}
+
 SCENARIO ( "Output_queue test, udp endpoint", 
            "[output_queue] [udp]" ) {
   using namespace std::experimental::net;
@@ -105,3 +249,122 @@ SCENARIO ( "Output_queue test, tcp endpoint",
                         ip::tcp::endpoint(ip::tcp::v6(), 9876));
 }
 
+SCENARIO ( "Output_queue test, get_next_elements for gather write batches",
+           "[output_queue] [tcp] [batch]" ) {
+  using namespace std::experimental::net;
+
+  auto ba = chops::make_byte_array(0x50, 0x51, 0x52, 0x53);
+  get_next_elements_test<ip::tcp::endpoint>(chops::const_shared_buffer(ba.data(), ba.size()), 17);
+}
+
+SCENARIO ( "Output_queue test, sent totals, high-water marks and latency histogram",
+           "[output_queue] [tcp] [stats]" ) {
+  using namespace std::experimental::net;
+
+  auto ba = chops::make_byte_array(0x70, 0x71, 0x72, 0x73, 0x74);
+  sent_stats_test<ip::tcp::endpoint>(chops::const_shared_buffer(ba.data(), ba.size()), 11);
+}
+
+
+SCENARIO ( "Output_queue test, multiple producers, single consumer",
+           "[output_queue] [udp] [mpsc]" ) {
+  using namespace std::experimental::net;
+
+  auto ba = chops::make_byte_array(0x60, 0x61, 0x62);
+  multi_producer_test<ip::udp::endpoint>(chops::const_shared_buffer(ba.data(), ba.size()), 16, 5000);
+}
+
+template <typename E>
+void output_lanes_test() {
+
+  using chops::net::send_priority;
+
+  auto bulk = chops::make_byte_array(0x01, 0x02, 0x03, 0x04);
+  auto hi = chops::make_byte_array(0x0A, 0x0B);
+  chops::const_shared_buffer bulk_buf(bulk.data(), bulk.size());
+  chops::const_shared_buffer hi_buf(hi.data(), hi.size());
+
+  GIVEN ("Output_lanes with a bulk backlog, then normal and high priority bufs") {
+    chops::net::detail::output_lanes<E> outq { };
+    chops::repeat(10, [&outq, &bulk_buf] () { outq.add_element(bulk_buf, send_priority::bulk); } );
+    outq.add_element(hi_buf, send_priority::normal);
+    outq.add_element(hi_buf, send_priority::high);
+
+    WHEN ("the lanes are drained with the default strict policy") {
+      auto e1 = outq.get_next_element();
+      auto e2 = outq.get_next_element();
+      auto e3 = outq.get_next_element();
+      THEN ("the high and normal bufs jump the bulk backlog") {
+        REQUIRE (e1->first == hi_buf);
+        REQUIRE (e2->first == hi_buf);
+        REQUIRE (e3->first == bulk_buf);
+        REQUIRE (outq.get_lane_stats(send_priority::high).output_queue_size == 0);
+        REQUIRE (outq.get_lane_stats(send_priority::bulk).output_queue_size == 9);
+        REQUIRE (outq.get_queue_stats().output_queue_size == 9);
+        REQUIRE (outq.get_queue_stats().max_output_queue_size == 12);
+      }
+    }
+    AND_WHEN ("a batch is taken, spanning lanes") {
+      std::vector<chops::const_shared_buffer> bufs;
+      auto cnt = outq.get_next_elements(bufs, 4, 10000);
+      outq.write_complete();
+      THEN ("the batch is in priority order and the stats are per lane") {
+        REQUIRE (cnt == 4);
+        REQUIRE (bufs[0] == hi_buf);
+        REQUIRE (bufs[1] == hi_buf);
+        REQUIRE (bufs[2] == bulk_buf);
+        auto qs = outq.get_queue_stats();
+        REQUIRE (qs.num_write_batches == 1);
+        REQUIRE (qs.bufs_in_write_batches == 4);
+        REQUIRE (qs.total_bufs_sent == 4);
+        REQUIRE (outq.get_lane_stats(send_priority::bulk).total_bufs_sent == 2);
+        REQUIRE (outq.get_lane_stats(send_priority::high).total_bytes_sent == hi_buf.size());
+      }
+    }
+    AND_WHEN ("a batch byte limit is reached within a lane") {
+      std::vector<chops::const_shared_buffer> bufs;
+      auto cnt = outq.get_next_elements(bufs, 10, 2 * hi_buf.size() + bulk_buf.size() + 1);
+      THEN ("the limit applies across lanes") {
+        REQUIRE (cnt == 3);
+      }
+    }
+    AND_WHEN ("the overflow policy drops a buf") {
+      outq.drop_next_element();
+      THEN ("it is dropped from the lowest priority lane") {
+        REQUIRE (outq.get_lane_stats(send_priority::bulk).output_queue_size == 9);
+        REQUIRE (outq.get_lane_stats(send_priority::high).output_queue_size == 1);
+      }
+    }
+  } // end given
+
+  GIVEN ("Output_lanes with weighted round robin, and high and bulk backlogs") {
+    chops::net::detail::output_lanes<E> outq { };
+    chops::net::send_lane_policy pol { chops::net::lane_schedule::weighted_round_robin,
+                                       { { 2u, 1u, 1u } } };
+    outq.set_lane_policy(pol);
+    chops::repeat(6, [&outq, &bulk_buf, &hi_buf] () { 
+        outq.add_element(bulk_buf, send_priority::bulk);
+        outq.add_element(hi_buf, send_priority::high);
+      }
+    );
+
+    WHEN ("the lanes are drained") {
+      std::vector<std::size_t> sizes;
+      while (auto e = outq.get_next_element()) {
+        sizes.push_back(e->first.size());
+      }
+      THEN ("each lane gets its weight of bufs in turn, and the empty lane is skipped") {
+        std::vector<std::size_t> expected { 2, 2, 4, 2, 2, 4, 2, 2, 4, 4, 4, 4 };
+        REQUIRE (sizes == expected);
+        REQUIRE (outq.empty());
+      }
+    }
+  } // end given
+}
+
+SCENARIO ( "Output_lanes test, strict priority and weighted round robin",
+           "[output_queue] [tcp] [lanes]" ) {
+  using namespace std::experimental::net;
+
+  output_lanes_test<ip::tcp::endpoint>();
+}
@@ -0,0 +1,116 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for the socket option classes and @c apply_socket_profile.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch.hpp"
+
+#include <experimental/internet>
+#include <experimental/socket>
+#include <experimental/io_context>
+
+#include <system_error>
+#include <chrono>
+
+#include "net_ip/detail/socket_options.hpp"
+#include "net_ip/socket_profile.hpp"
+
+using namespace std::experimental::net;
+
+SCENARIO ( "Socket profile applied to a TCP socket", "[socket_options]" ) {
+
+  io_context ioc;
+  ip::tcp::socket sock(ioc);
+  sock.open(ip::tcp::v4());
+
+  GIVEN ("A low latency profile with buffer sizes and keep alive") {
+    auto prof = chops::net::make_low_latency_socket_profile();
+    prof.receive_buffer_size = 256 * 1024;
+    prof.send_buffer_size = 256 * 1024;
+    prof.keep_alive = true;
+    prof.keep_alive_idle = std::chrono::seconds(30);
+    prof.keep_alive_count = 3;
+    prof.user_timeout = std::chrono::milliseconds(5000);
+
+    WHEN ("the profile is applied") {
+      std::error_code ec;
+      chops::net::detail::apply_socket_profile(sock, prof, ec);
+      THEN ("the options are set") {
+        REQUIRE_FALSE (ec);
+        ip::tcp::no_delay nd;
+        sock.get_option(nd);
+        REQUIRE (nd.value());
+        socket_base::keep_alive ka;
+        sock.get_option(ka);
+        REQUIRE (ka.value());
+        socket_base::receive_buffer_size rb;
+        sock.get_option(rb);
+        REQUIRE (rb.value() >= prof.receive_buffer_size / 2);
+#ifdef TCP_KEEPCNT
+        chops::net::detail::tcp_keep_count kc;
+        sock.get_option(kc);
+        REQUIRE (kc.value() == 3);
+#endif
+#ifdef TCP_USER_TIMEOUT
+        chops::net::detail::tcp_user_timeout ut;
+        sock.get_option(ut);
+        REQUIRE (ut.value() == 5000);
+#endif
+      }
+    }
+  } // end given
+
+  GIVEN ("A default profile") {
+    WHEN ("the profile is applied") {
+      std::error_code ec;
+      chops::net::detail::apply_socket_profile(sock, chops::net::socket_profile(), ec);
+      THEN ("no options are changed") {
+        REQUIRE_FALSE (ec);
+        ip::tcp::no_delay nd;
+        sock.get_option(nd);
+        REQUIRE_FALSE (nd.value());
+      }
+    }
+  } // end given
+}
+
+SCENARIO ( "Socket profile applied to a UDP socket", "[socket_options]" ) {
+
+  io_context ioc;
+  ip::udp::socket sock(ioc);
+  sock.open(ip::udp::v4());
+
+  GIVEN ("A profile with TCP options, a buffer size and a type of service") {
+    auto prof = chops::net::make_low_latency_socket_profile();
+    prof.keep_alive = true;
+    prof.receive_buffer_size = 512 * 1024;
+    prof.tos = 0x10;
+
+    WHEN ("the profile is applied") {
+      std::error_code ec;
+      chops::net::detail::apply_socket_profile(sock, prof, ec);
+      THEN ("the TCP options are ignored and the other options are set") {
+        REQUIRE_FALSE (ec);
+        socket_base::receive_buffer_size rb;
+        sock.get_option(rb);
+        REQUIRE (rb.value() >= prof.receive_buffer_size / 2);
+#if defined(IP_TOS) && defined(IPV6_TCLASS)
+        chops::net::detail::type_of_service tos;
+        sock.get_option(tos);
+        REQUIRE (tos.value() == 0x10);
+#endif
+      }
+    }
+  } // end given
+}
+
@@ -0,0 +1,98 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for @c spsc_ring detail class template.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch.hpp"
+
+#include <cstddef> // std::size_t
+#include <memory> // std::shared_ptr, std::make_shared
+#include <thread>
+
+#include "net_ip/detail/spsc_ring.hpp"
+
+SCENARIO ( "Spsc ring, single thread push and pop", "[spsc_ring]" ) {
+
+  using ring = chops::net::detail::spsc_ring<std::shared_ptr<int> >;
+
+  GIVEN ("A ring with a capacity of 3, rounded up to 4") {
+    ring r(3u);
+    REQUIRE (r.capacity() == 4u);
+    REQUIRE (r.empty());
+
+    WHEN ("the ring is filled") {
+      auto val = std::make_shared<int>(7);
+      for (int i = 0; i < 4; ++i) {
+        REQUIRE (r.try_push(std::make_shared<int>(i)));
+      }
+      THEN ("a push fails without moving the value, and values are popped in order") {
+        REQUIRE_FALSE (r.try_push(std::move(val)));
+        REQUIRE (val);
+        REQUIRE (r.size() == 4u);
+        for (int i = 0; i < 4; ++i) {
+          auto p = r.try_pop();
+          REQUIRE (p);
+          REQUIRE (**p == i);
+        }
+        REQUIRE_FALSE (r.try_pop());
+        REQUIRE (r.empty());
+      }
+    }
+    AND_WHEN ("values are left in the ring when it is destroyed") {
+      auto val = std::make_shared<int>(7);
+      {
+        ring r2(8u);
+        r2.try_push(std::shared_ptr<int>(val));
+        r2.try_push(std::shared_ptr<int>(val));
+        REQUIRE (val.use_count() == 3);
+      }
+      THEN ("they are destroyed") {
+        REQUIRE (val.use_count() == 1);
+      }
+    }
+  } // end given
+}
+
+SCENARIO ( "Spsc ring, producer and consumer threads", "[spsc_ring] [threads]" ) {
+
+  constexpr std::size_t num_vals = 200000u;
+
+  GIVEN ("A small ring") {
+    chops::net::detail::spsc_ring<std::size_t> r(64u);
+
+    WHEN ("a producer thread pushes many values while the consumer pops") {
+      std::thread prod([&r] () {
+          for (std::size_t i = 0u; i < num_vals; ++i) {
+            while (!r.try_push(std::size_t(i))) {
+              std::this_thread::yield();
+            }
+          }
+        }
+      );
+      std::size_t expected = 0u;
+      bool in_order = true;
+      while (expected < num_vals) {
+        if (auto v = r.try_pop()) {
+          in_order = in_order && (*v == expected);
+          ++expected;
+        }
+      }
+      prod.join();
+      THEN ("every value is popped once, in order") {
+        REQUIRE (in_order);
+        REQUIRE (r.empty());
+      }
+    }
+  } // end given
+}
+
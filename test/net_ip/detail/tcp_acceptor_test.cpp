@@ -35,10 +35,18 @@
 #include <functional> // std::ref, std::cref
 #include <string_view>
 #include <vector>
+#include <set>
+#include <mutex>
+#include <algorithm> // std::max
+#include <cstdio> // std::remove
+
+#include <unistd.h> // access
 
 #include "net_ip/detail/tcp_acceptor.hpp"
+#include "net_ip/local_protocol.hpp"
 
 #include "net_ip/component/worker.hpp"
+#include "net_ip/component/worker_pool.hpp"
 #include "net_ip/endpoints_resolver.hpp"
 
 #include "net_ip/shared_utility_test.hpp"
@@ -288,3 +296,206 @@ SCENARIO ( "Tcp acceptor test,  LF msgs, two-way, interval 0, 25 connectors, man
                   std::string_view("\n"), make_empty_lf_text_msg() );
 
 }
+
+SCENARIO ( "Tcp acceptor test, sharded acceptor, 16 connectors",
+           "[tcp_acc] [sharded]" ) {
+
+  constexpr int num_shards = 4;
+  constexpr int num_conns = 16;
+
+  chops::net::worker_pool wp(num_shards);
+  wp.start();
+
+  GIVEN ("A sharded acceptor with a listener on each io_context of a worker pool") {
+
+    auto endp_seq = chops::net::endpoints_resolver<ip::tcp>(wp.get_io_context()).make_endpoints(true,
+                                                                              test_host, test_port);
+    auto acc_ptr = std::make_shared<chops::net::detail::tcp_acceptor>(wp.get_io_contexts(),
+                                                                      *(endp_seq.cbegin()), true);
+    if (chops::net::detail::reuse_port_supported) {
+      REQUIRE (acc_ptr->num_shards() == num_shards);
+    }
+
+    std::mutex mut;
+    std::set<io_context*> iocs;
+    std::size_t max_num = 0u;
+    std::promise<void> all_prom;
+    auto all_fut = all_prom.get_future();
+
+    acc_ptr->start(
+      [&] (chops::net::tcp_io_interface io, std::size_t num, bool starting) {
+        if (starting) {
+          std::lock_guard<std::mutex> lk(mut);
+          iocs.insert(&io.get_socket().get_executor().context());
+          max_num = num;
+          if (num == num_conns) {
+            all_prom.set_value();
+          }
+        }
+      },
+      [] (chops::net::tcp_io_interface, std::error_code) { }
+    );
+    REQUIRE(acc_ptr->is_started());
+
+    WHEN ("connections are made") {
+      io_context conn_ioc;
+      std::vector<ip::tcp::socket> socks;
+      auto conn_endps =
+          chops::net::endpoints_resolver<ip::tcp>(conn_ioc).make_endpoints(true, test_host, test_port);
+      chops::repeat(num_conns, [&socks, &conn_ioc, &conn_endps] () {
+          socks.emplace_back(conn_ioc);
+          connect(socks.back(), conn_endps);
+        }
+      );
+      all_fut.get();
+      THEN ("the combined connection count is reported and multiple listeners are used") {
+        std::lock_guard<std::mutex> lk(mut);
+        REQUIRE (max_num == num_conns);
+        if (chops::net::detail::reuse_port_supported) {
+          REQUIRE (iocs.size() > 1u);
+        }
+      }
+      acc_ptr->stop();
+      REQUIRE_FALSE(acc_ptr->is_started());
+    }
+  } // end given
+
+  wp.reset();
+}
+
+SCENARIO ( "Tcp acceptor test, connection limit, 6 connectors",
+           "[tcp_acc] [accept_limits]" ) {
+
+  constexpr std::size_t max_conns = 4u;
+  constexpr int num_conns = 6;
+
+  chops::net::worker wk;
+  wk.start();
+  auto& ioc = wk.get_io_context();
+
+  GIVEN ("An acceptor with a connection limit") {
+
+    auto endp_seq = 
+        chops::net::endpoints_resolver<ip::tcp>(ioc).make_endpoints(true, test_host, test_port);
+    auto acc_ptr = std::make_shared<chops::net::detail::tcp_acceptor>(ioc, *(endp_seq.cbegin()), 
+        true, chops::net::detail::tcp_acceptor::io_context_selector(), chops::net::socket_profile(),
+        chops::net::accept_limits { max_conns, 0u, 16u });
+
+    std::mutex mut;
+    int num_starts = 0;
+    std::size_t max_num = 0u;
+    test_counter recv_cnt = 0;
+    std::promise<void> limit_prom;
+    auto limit_fut = limit_prom.get_future();
+    std::promise<void> all_prom;
+    auto all_fut = all_prom.get_future();
+
+    acc_ptr->start(
+      [&] (chops::net::tcp_io_interface io, std::size_t num, bool starting) {
+        if (starting) {
+          tcp_start_io(io, false, std::string_view(), recv_cnt);
+          std::lock_guard<std::mutex> lk(mut);
+          max_num = std::max(max_num, num);
+          if (++num_starts == static_cast<int>(max_conns)) {
+            limit_prom.set_value();
+          }
+          else if (num_starts == num_conns) {
+            all_prom.set_value();
+          }
+        }
+      },
+      [] (chops::net::tcp_io_interface, std::error_code) { }
+    );
+
+    WHEN ("more connections are made than the limit") {
+      io_context conn_ioc;
+      std::vector<ip::tcp::socket> socks;
+      auto conn_endps =
+          chops::net::endpoints_resolver<ip::tcp>(conn_ioc).make_endpoints(true, test_host, test_port);
+      chops::repeat(num_conns, [&socks, &conn_ioc, &conn_endps] () {
+          socks.emplace_back(conn_ioc);
+          connect(socks.back(), conn_endps); // completes in the listen backlog
+        }
+      );
+      limit_fut.get();
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      auto stats = acc_ptr->get_accept_stats();
+      THEN ("accepting pauses at the limit and resumes when connections close") {
+        REQUIRE (stats.num_accepted == max_conns);
+        REQUIRE (stats.paused);
+        REQUIRE (stats.num_deferred >= 1u);
+
+        socks[0].close();
+        socks[1].close();
+        all_fut.get();
+        stats = acc_ptr->get_accept_stats();
+        REQUIRE (stats.num_accepted == static_cast<std::size_t>(num_conns));
+        std::lock_guard<std::mutex> lk(mut);
+        REQUIRE (max_num <= max_conns);
+      }
+      acc_ptr->stop();
+      REQUIRE_FALSE(acc_ptr->is_started());
+    }
+  } // end given
+
+  wk.reset();
+}
+
+
+SCENARIO ( "Local stream acceptor test, socket file left at the path",
+           "[tcp_acc] [local]" ) {
+
+  using local_proto = chops::net::local::stream_protocol;
+  using local_io_interface = chops::net::basic_io_interface<chops::net::detail::local_stream_io>;
+
+  const char* path = "/tmp/chops_acc_test.sock";
+  std::remove(path);
+  local_proto::endpoint endp(path);
+
+  chops::net::worker wk;
+  wk.start();
+  auto& ioc = wk.get_io_context();
+
+  GIVEN ("A listening local socket bound to the path") {
+
+    local_proto::acceptor live(ioc, endp);
+    auto acc_ptr = std::make_shared<chops::net::detail::local_stream_acceptor>(ioc, endp, true);
+    std::error_code start_err;
+
+    WHEN ("an acceptor with reuse_addr is started on the path of the live server") {
+      bool started = acc_ptr->start(
+        [] (local_io_interface, std::size_t, bool) { },
+        [&start_err] (local_io_interface, std::error_code err) {
+          if (!start_err) {
+            start_err = err;
+          }
+        }
+      );
+      THEN ("the start fails and the live server keeps its socket file") {
+        REQUIRE_FALSE (started);
+        REQUIRE (start_err == std::errc::address_in_use);
+        local_proto::socket sock(ioc);
+        std::error_code ec;
+        sock.connect(endp, ec);
+        REQUIRE_FALSE (ec);
+      }
+    }
+
+    AND_WHEN ("the server has gone away, leaving a stale socket file") {
+      live.close();
+      REQUIRE (::access(path, F_OK) == 0);
+      bool started = acc_ptr->start(
+        [] (local_io_interface, std::size_t, bool) { },
+        [] (local_io_interface, std::error_code) { }
+      );
+      THEN ("the stale file is removed and the acceptor starts, then removes its own file") {
+        REQUIRE (started);
+        acc_ptr->stop();
+        REQUIRE (::access(path, F_OK) != 0);
+      }
+    }
+  } // end given
+
+  std::remove(path);
+  wk.reset();
+}
@@ -33,6 +33,7 @@
 #include <functional> // std::ref, std::cref
 #include <string_view>
 #include <vector>
+#include <atomic>
 
 #include "net_ip/detail/tcp_acceptor.hpp"
 #include "net_ip/detail/tcp_connector.hpp"
@@ -63,12 +64,13 @@ constexpr int ReconnTime = 100;
 
 // Catch test framework not thread-safe, all REQUIRE clauses must be in single thread
 
-void start_connectors(const vec_buf& in_msg_vec, io_context& ioc, 
+void start_connectors(const vec_buf& in_msg_vec, io_context& ioc, bool reply,
                       int interval, int num_conns,
                       std::string_view delim, chops::const_shared_buffer empty_msg,
                       test_counter& conn_cnt, chops::net::err_wait_q& err_wq) {
 
   chops::net::send_to_all<chops::net::tcp_io> sta { };
+  std::size_t expected_cnt = conn_cnt + num_conns * in_msg_vec.size();
 
   std::vector<chops::net::detail::tcp_connector_ptr> connectors;
   std::vector<chops::net::tcp_io_interface_future> conn_fut_vec;
@@ -101,6 +103,14 @@ std::cerr << "****** Connectors total output queue size: " << qs.output_queue_si
 std::cerr << "****** Connectors total output queue size: " << qs.output_queue_size << std::endl;
   }
 
+  // the acceptor closes when the shutdown message is received, dropping any queued 
+  // replies, so wait (bounded) for the replies first
+  for (int i = 0; reply && conn_cnt < expected_cnt && i < 1000; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  if (reply) {
+    REQUIRE (conn_cnt == expected_cnt);
+  }
   sta.send(empty_msg);
 
   // wait for stop state change
@@ -143,10 +153,10 @@ void acc_conn_test (const vec_buf& in_msg_vec, bool reply, int interval, int num
         test_counter conn_cnt = 0;
 
         INFO ("Creating first iteration of connectors and futures, num: " << num_conns);
-        start_connectors(in_msg_vec, ioc, interval, num_conns,
+        start_connectors(in_msg_vec, ioc, reply, interval, num_conns,
                       delim, empty_msg, conn_cnt, err_wq);
         INFO ("Creating second iteration of connectors and futures");
-        start_connectors(in_msg_vec, ioc, interval, num_conns,
+        start_connectors(in_msg_vec, ioc, reply, interval, num_conns,
                       delim, empty_msg, conn_cnt, err_wq);
 
         acc_ent.stop();
@@ -314,3 +324,113 @@ SCENARIO ( "Tcp connector test, LF msgs, two-way, interval 0, 25 connectors, man
 
 }
 
+
+SCENARIO ( "Tcp connector test, staggered connect attempts with an unreachable endpoint first",
+           "[tcp_conn] [connect_options]" ) {
+
+  chops::net::worker wk;
+  wk.start();
+  auto& ioc = wk.get_io_context();
+
+  GIVEN ("An acceptor and a connector with an unreachable endpoint before the acceptor endpoint") {
+
+    auto endp_seq = 
+        chops::net::endpoints_resolver<ip::tcp>(ioc).make_endpoints(true, test_host, test_port);
+    auto acc_ptr = 
+        std::make_shared<chops::net::detail::tcp_acceptor>(ioc, *(endp_seq.cbegin()), true);
+    chops::net::tcp_acceptor_net_entity acc_ent(acc_ptr);
+
+    chops::net::err_wait_q err_wq;
+    auto err_fut = std::async(std::launch::async, 
+      chops::net::ostream_error_sink_with_wait_queue, std::ref(err_wq), std::ref(std::cerr));
+
+    test_counter acc_cnt = 0;
+    start_tcp_acceptor(acc_ent, err_wq, false, std::string_view(), acc_cnt);
+
+    auto port = endp_seq.cbegin()->endpoint().port();
+    // a non-routable address, the connect either fails quickly or is never answered
+    std::vector<ip::tcp::endpoint> endps { 
+        ip::tcp::endpoint(ip::make_address("10.255.255.1"), port),
+        ip::tcp::endpoint(ip::make_address("127.0.0.1"), port) };
+
+    chops::net::tcp_connect_options opts;
+    opts.reconn_time = std::chrono::milliseconds(ReconnTime);
+    opts.max_reconn_time = std::chrono::milliseconds(8 * ReconnTime);
+    opts.jitter = 0.5;
+    opts.attempt_timeout = std::chrono::milliseconds(2000);
+    opts.attempt_delay = std::chrono::milliseconds(50);
+
+    WHEN ("the connector is started") {
+      auto conn_ptr = std::make_shared<chops::net::detail::tcp_connector>(ioc,
+                         endps.cbegin(), endps.cend(), opts);
+      test_counter conn_cnt = 0;
+      auto conn_futs = get_tcp_io_futures(chops::net::tcp_connector_net_entity(conn_ptr), err_wq,
+                                          false, std::string_view(), conn_cnt);
+
+      THEN ("the connect completes through the second endpoint well before the attempt timeout") {
+        REQUIRE (conn_futs.start_fut.wait_for(std::chrono::milliseconds(1000)) == 
+                 std::future_status::ready);
+        auto io = conn_futs.start_fut.get();
+        io.send(make_empty_variable_len_msg());
+        conn_futs.stop_fut.get();
+      }
+    }
+
+    acc_ent.stop();
+    while (!err_wq.empty()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    err_wq.close();
+    err_fut.get();
+  } // end given
+
+  wk.reset();
+}
+
+SCENARIO ( "Tcp connector test, staggered connect attempts refused before the attempt delay",
+           "[tcp_conn] [connect_options]" ) {
+
+  chops::net::worker wk;
+  wk.start();
+  auto& ioc = wk.get_io_context();
+
+  GIVEN ("A connector with two endpoints where nothing is listening") {
+
+    // a port that was just in use, so the connects are refused
+    ip::tcp::acceptor tmp_acc(ioc, ip::tcp::endpoint(ip::make_address("127.0.0.1"), 0));
+    auto endp = tmp_acc.local_endpoint();
+    tmp_acc.close();
+    std::vector<ip::tcp::endpoint> endps { endp, endp };
+
+    chops::net::tcp_connect_options opts;
+    opts.reconn_time = std::chrono::milliseconds(5000);
+    opts.attempt_delay = std::chrono::milliseconds(200);
+
+    WHEN ("both attempts fail before the delay of the first one expires") {
+      auto conn_ptr = std::make_shared<chops::net::detail::tcp_connector>(ioc,
+                         endps.cbegin(), endps.cend(), opts);
+      auto num_refused = std::make_shared<std::atomic_int>(0);
+      conn_ptr->start(
+        [] (chops::net::tcp_io_interface, std::size_t, bool) { },
+        [num_refused] (chops::net::tcp_io_interface, std::error_code err) {
+          if (err == std::errc::connection_refused) {
+            ++(*num_refused);
+          }
+        }
+      );
+      // bounded wait well past the attempt delay, but before the reconnect
+      for (int i = 0; i < 100 && *num_refused == 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(500));
+      int cnt = *num_refused;
+      conn_ptr->stop();
+
+      THEN ("the failed round is reported once, the stale delay wait does not report it again") {
+        REQUIRE (cnt == 1);
+      }
+    }
+  } // end given
+
+  wk.reset();
+}
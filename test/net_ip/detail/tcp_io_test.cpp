@@ -30,6 +30,8 @@
 #include <string_view>
 
 #include "net_ip/detail/tcp_io.hpp"
+#include "net_ip/detail/socket_options.hpp" // receive_timestamps_supported
+#include "net_ip/receive_timestamp.hpp"
 
 #include "net_ip/component/worker.hpp"
 #include "net_ip/endpoints_resolver.hpp"
@@ -65,8 +67,9 @@ struct notify_me {
   }
 };
 
-std::size_t connector_func (const vec_buf& in_msg_vec, io_context& ioc, 
-                            int interval, std::string_view delim, chops::const_shared_buffer empty_msg) {
+std::size_t connector_func (const vec_buf& in_msg_vec, io_context& ioc, bool reply,
+                            int interval, std::string_view delim, chops::const_shared_buffer empty_msg,
+                            std::size_t batch_bufs, std::size_t zc_threshold) {
 
   auto endps = 
       chops::net::endpoints_resolver<ip::tcp>(ioc).make_endpoints(true, test_addr, test_port);
@@ -80,6 +83,8 @@ std::size_t connector_func (const vec_buf& in_msg_vec, io_context& ioc,
   auto iohp = std::make_shared<chops::net::detail::tcp_io>(std::move(sock), 
                                                            notify_me(std::move(notify_prom)));
 
+  iohp->set_write_batch_limits(batch_bufs, 0);
+  iohp->set_zero_copy_threshold(zc_threshold);
   test_counter cnt = 0;
   tcp_start_io(chops::net::tcp_io_interface(iohp), false, delim, cnt);
 
@@ -87,6 +92,12 @@ std::size_t connector_func (const vec_buf& in_msg_vec, io_context& ioc,
     iohp->send(buf);
     std::this_thread::sleep_for(std::chrono::milliseconds(interval));
   }
+  // the acceptor closes when the shutdown message is received, dropping any queued replies,
+  // so wait (bounded) for the replies first; the count is checked by the caller, since
+  // this runs in another thread
+  for (int i = 0; reply && cnt < in_msg_vec.size() && i < 10000; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
   iohp->send(empty_msg);
 
   auto err = notify_fut.get();
@@ -97,7 +108,10 @@ std::size_t connector_func (const vec_buf& in_msg_vec, io_context& ioc,
 }
 
 void acc_conn_test (const vec_buf& in_msg_vec, bool reply, int interval, std::string_view delim,
-                    chops::const_shared_buffer empty_msg) {
+                    chops::const_shared_buffer empty_msg, std::size_t batch_bufs = 1,
+                    bool shared_buf = false, std::size_t read_ahead = 0, bool io_ref = false,
+                    std::size_t zc_threshold = 0, bool rx_ts = false,
+                    bool length_field = false) {
 
   chops::net::worker wk;
   wk.start();
@@ -112,18 +126,32 @@ void acc_conn_test (const vec_buf& in_msg_vec, bool reply, int interval, std::st
             chops::net::endpoints_resolver<ip::tcp>(ioc).make_endpoints(true, test_addr, test_port);
         ip::tcp::acceptor acc(ioc, *(endps.cbegin()));
 
-        INFO ("Creating connector asynchronously, msg interval: " << interval);
+        INFO ("Creating connector asynchronously, msg interval: " << interval << 
+              ", write batch bufs: " << batch_bufs << ", shared buf msg hdlr: " << shared_buf <<
+              ", read ahead: " << read_ahead << ", io ref msg hdlr: " << io_ref <<
+              ", zero copy threshold: " << zc_threshold << ", receive timestamps: " << rx_ts <<
+              ", length field msg frame: " << length_field);
 
         auto conn_fut = std::async(std::launch::async, connector_func, std::cref(in_msg_vec), 
-                                   std::ref(ioc), interval, delim, empty_msg);
+                                   std::ref(ioc), reply, interval, delim, empty_msg, batch_bufs,
+                                   zc_threshold);
 
         notify_prom_type notify_prom;
         auto notify_fut = notify_prom.get_future();
 
         auto iohp = std::make_shared<chops::net::detail::tcp_io>(std::move(acc.accept()), 
                                                                  notify_me(std::move(notify_prom)));
+        iohp->set_write_batch_limits(batch_bufs, 0);
+        iohp->set_zero_copy_threshold(zc_threshold);
+        iohp->set_receive_timestamps(rx_ts);
         test_counter cnt = 0;
-        tcp_start_io(chops::net::tcp_io_interface(iohp), reply, delim, cnt);
+        if (length_field) {
+          tcp_start_io_length_field(chops::net::tcp_io_interface(iohp), reply, cnt, read_ahead);
+        }
+        else {
+          tcp_start_io(chops::net::tcp_io_interface(iohp), reply, delim, cnt, shared_buf, read_ahead,
+                       io_ref);
+        }
 
         auto acc_err = notify_fut.get();
 // std::cerr << "Inside acc_conn_test, acc_err: " << acc_err << ", " << acc_err.message() << std::endl;
@@ -252,3 +280,294 @@ SCENARIO ( "Tcp IO handler test, LF msgs, two-way, interval 0, many msgs",
 
 }
 
+
+SCENARIO ( "Tcp IO handler test, variable len msgs, two-way, interval 0, many msgs, batched writes",
+           "[tcp_io] [var_len_msg] [two_way] [interval_0] [many] [batch]" ) {
+
+  acc_conn_test ( make_msg_vec (make_variable_len_msg, "Batch me up!", 'B', 100*NumMsgs),
+                  true, 0, 
+                  std::string_view(), make_empty_variable_len_msg(), 32 );
+
+}
+
+SCENARIO ( "Tcp IO handler test, CR / LF msgs, two-way, interval 0, many msgs, batched writes",
+           "[tcp_io] [cr_lf_msg] [two-way] [interval_0] [many] [batch]" ) {
+
+  acc_conn_test ( make_msg_vec (make_cr_lf_text_msg, "Gather, gather!", 'G', 200*NumMsgs),
+                  true, 0, 
+                  std::string_view("\r\n"), make_empty_cr_lf_text_msg(), 64 );
+
+}
+
+SCENARIO ( "Tcp IO handler test, variable len msgs, two-way, interval 0, shared buf msg hdlr",
+           "[tcp_io] [var_len_msg] [two_way] [interval_0] [shared_buf]" ) {
+
+  acc_conn_test ( make_msg_vec (make_variable_len_msg, "No copies here", 'S', 20*NumMsgs),
+                  true, 0, 
+                  std::string_view(), make_empty_variable_len_msg(), 1, true );
+
+}
+
+SCENARIO ( "Tcp IO handler test, CR / LF msgs, two-way, interval 0, shared buf msg hdlr",
+           "[tcp_io] [cr_lf_msg] [two-way] [interval_0] [shared_buf]" ) {
+
+  acc_conn_test ( make_msg_vec (make_cr_lf_text_msg, "Owned buffers", 'O', 20*NumMsgs),
+                  true, 0, 
+                  std::string_view("\r\n"), make_empty_cr_lf_text_msg(), 1, true );
+
+}
+
+SCENARIO ( "Tcp IO handler test, variable len msgs, two-way, interval 0, io ref msg hdlr",
+           "[tcp_io] [var_len_msg] [two_way] [interval_0] [io_ref]" ) {
+
+  acc_conn_test ( make_msg_vec (make_variable_len_msg, "No ref counts here", 'R', 20*NumMsgs),
+                  true, 0, 
+                  std::string_view(), make_empty_variable_len_msg(), 1, false, 0, true );
+
+}
+
+SCENARIO ( "Tcp IO handler test, LF msgs, two-way, interval 0, io ref msg hdlr",
+           "[tcp_io] [lf_msg] [two_way] [interval_0] [io_ref]" ) {
+
+  acc_conn_test ( make_msg_vec (make_lf_text_msg, "Borrowed io", 'B', 20*NumMsgs),
+                  true, 0, 
+                  std::string_view("\n"), make_empty_lf_text_msg(), 1, false, 0, true );
+
+}
+
+SCENARIO ( "Tcp IO handler test, variable len msgs, one-way, interval 0, many msgs, read ahead",
+           "[tcp_io] [var_len_msg] [one-way] [interval_0] [many] [read_ahead]" ) {
+
+  acc_conn_test ( make_msg_vec (make_variable_len_msg, "Read it all at once", 'A', 100*NumMsgs),
+                  false, 0, 
+                  std::string_view(), make_empty_variable_len_msg(), 1, false, 4096 );
+
+}
+
+SCENARIO ( "Tcp IO handler test, variable len msgs, two-way, interval 5, read ahead",
+           "[tcp_io] [var_len_msg] [two_way] [interval_5] [read_ahead]" ) {
+
+  acc_conn_test ( make_msg_vec (make_variable_len_msg, "Read ahead and reply", 'B', NumMsgs),
+                  true, 5, 
+                  std::string_view(), make_empty_variable_len_msg(), 1, false, 4096 );
+
+}
+
+SCENARIO ( "Tcp IO handler test, variable len msgs, two-way, interval 0, small read ahead",
+           "[tcp_io] [var_len_msg] [two_way] [interval_0] [read_ahead]" ) {
+
+  // read ahead size smaller than a message, the buffer grows as needed
+  acc_conn_test ( make_msg_vec (make_variable_len_msg, "Not enough room for this message", 'Z', 
+                                20*NumMsgs),
+                  true, 0, 
+                  std::string_view(), make_empty_variable_len_msg(), 1, true, 7 );
+
+}
+
+SCENARIO ( "Tcp IO handler test, variable len msgs, two-way, interval 0, length field msg frame",
+           "[tcp_io] [var_len_msg] [two_way] [interval_0] [length_field]" ) {
+
+  acc_conn_test ( make_msg_vec (make_variable_len_msg, "Inline header decoding", 'L', 20*NumMsgs),
+                  true, 0, 
+                  std::string_view(), make_empty_variable_len_msg(), 1, false, 0, false, 0, false,
+                  true );
+
+}
+
+SCENARIO ( "Tcp IO handler test, variable len msgs, two-way, interval 0, length field msg frame, read ahead",
+           "[tcp_io] [var_len_msg] [two_way] [interval_0] [length_field] [read_ahead]" ) {
+
+  acc_conn_test ( make_msg_vec (make_variable_len_msg, "Inline decoding, read ahead", 'M', 20*NumMsgs),
+                  true, 0, 
+                  std::string_view(), make_empty_variable_len_msg(), 1, false, 4096, false, 0, false,
+                  true );
+
+}
+
+SCENARIO ( "Tcp IO handler test, variable len msgs, two-way, interval 0, zero copy sends",
+           "[tcp_io] [var_len_msg] [two_way] [interval_0] [zero_copy]" ) {
+
+  // a threshold of 1 sends every buffer with zero copy (on Linux)
+  acc_conn_test ( make_msg_vec (make_variable_len_msg, "Hands off my bytes", 'H', 20*NumMsgs),
+                  true, 0, 
+                  std::string_view(), make_empty_variable_len_msg(), 1, false, 0, false, 1 );
+
+}
+
+SCENARIO ( "Tcp IO handler test, LF msgs, two-way, interval 0, many msgs, batched zero copy sends",
+           "[tcp_io] [lf_msg] [two_way] [interval_0] [many] [batch] [zero_copy]" ) {
+
+  // only batches of at least 64 bytes are sent with zero copy
+  acc_conn_test ( make_msg_vec (make_lf_text_msg, "Pin these pages", 'P', 100*NumMsgs),
+                  true, 0, 
+                  std::string_view("\n"), make_empty_lf_text_msg(), 32, false, 0, false, 64 );
+
+}
+
+SCENARIO ( "Tcp IO handler test, variable len msgs, two-way, interval 0, receive timestamps",
+           "[tcp_io] [var_len_msg] [two_way] [interval_0] [rx_timestamps]" ) {
+
+  // reads are done with recvmsg (on Linux), for the timestamps control message
+  acc_conn_test ( make_msg_vec (make_variable_len_msg, "What time is it", 'T', 20*NumMsgs),
+                  true, 0, 
+                  std::string_view(), make_empty_variable_len_msg(), 1, false, 0, false, 0, true );
+
+}
+
+SCENARIO ( "Tcp IO handler test, LF msgs, two-way, interval 0, shared buf msg hdlr, receive timestamps",
+           "[tcp_io] [lf_msg] [two_way] [interval_0] [shared_buf] [rx_timestamps]" ) {
+
+  acc_conn_test ( make_msg_vec (make_lf_text_msg, "Stamp every read", 'W', 20*NumMsgs),
+                  true, 0, 
+                  std::string_view("\n"), make_empty_lf_text_msg(), 1, true, 0, false, 0, true );
+
+}
+
+SCENARIO ( "Tcp IO handler test, send coalescing, flushed by size then by delay",
+           "[tcp_io] [lf_msg] [one_way] [coalescing]" ) {
+
+  chops::net::worker wk;
+  wk.start();
+  auto& ioc = wk.get_io_context();
+
+  GIVEN ("A connected IO handler with send coalescing and a plain peer socket") {
+
+    auto endps = 
+        chops::net::endpoints_resolver<ip::tcp>(ioc).make_endpoints(true, test_addr, test_port);
+    ip::tcp::acceptor acc(ioc, *(endps.cbegin()));
+    ip::tcp::socket sock(ioc);
+    sock.connect(*(endps.cbegin()));
+    auto peer = acc.accept();
+
+    notify_prom_type notify_prom;
+    auto notify_fut = notify_prom.get_future();
+    auto iohp = std::make_shared<chops::net::detail::tcp_io>(std::move(sock), 
+                                                             notify_me(std::move(notify_prom)));
+    test_counter cnt = 0;
+    tcp_start_io(chops::net::tcp_io_interface(iohp), false, std::string_view("\n"), cnt);
+
+    auto msgs = make_msg_vec (make_lf_text_msg, "Hold the line", 'C', NumMsgs);
+    std::size_t total = 0u;
+    for (const auto& m : msgs) {
+      total += m.size();
+    }
+    // bounded wait for the peer to have a given number of bytes readable
+    auto wait_bytes = [&peer] (std::size_t num, int max_ms) {
+      std::error_code ec;
+      for (int i = 0; i < max_ms && peer.available(ec) < num && !ec; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      return peer.available(ec);
+    };
+
+    WHEN ("messages are sent with a long delay and a flush size of all of them") {
+      iohp->set_send_coalescing(total, std::chrono::seconds(10));
+      for (std::size_t i = 0u; i < msgs.size() - 1u; ++i) {
+        iohp->send(msgs[i]);
+      }
+      auto held = wait_bytes(1u, 200);
+      auto start = std::chrono::steady_clock::now();
+      iohp->send(msgs.back());
+      auto flushed = wait_bytes(total, 2000);
+      auto size_flush_time = std::chrono::steady_clock::now() - start;
+
+      std::vector<char> rd(total);
+      std::error_code ec;
+      read(peer, buffer(rd), ec);
+
+      AND_WHEN ("a single message is sent with a short delay") {
+        iohp->set_send_coalescing(total, std::chrono::milliseconds(100));
+        start = std::chrono::steady_clock::now();
+        iohp->send(msgs.front());
+        auto delayed = wait_bytes(msgs.front().size(), 2000);
+        auto delay_flush_time = std::chrono::steady_clock::now() - start;
+
+        THEN ("the held messages are written together by size, and the cancelled long delay "
+              "does not hold back the next message") {
+          REQUIRE (held == 0u);
+          REQUIRE (flushed == total);
+          REQUIRE (size_flush_time < std::chrono::seconds(2));
+          REQUIRE_FALSE (ec);
+          REQUIRE (delayed == msgs.front().size());
+          REQUIRE (delay_flush_time >= std::chrono::milliseconds(90));
+          REQUIRE (delay_flush_time < std::chrono::seconds(2));
+        }
+      }
+    }
+
+    iohp->stop_io();
+    notify_fut.get();
+    std::error_code ec;
+    peer.close(ec);
+  } // end given
+
+  wk.reset();
+
+}
+
+SCENARIO ( "Tcp IO handler test, receive timestamps passed to the message handler",
+           "[tcp_io] [lf_msg] [one_way] [rx_timestamps]" ) {
+
+  constexpr int num_msgs = 20;
+
+  chops::net::worker wk;
+  wk.start();
+  auto& ioc = wk.get_io_context();
+
+  GIVEN ("An IO handler with receive timestamps set before start_io, and a plain peer socket") {
+
+    auto endps = 
+        chops::net::endpoints_resolver<ip::tcp>(ioc).make_endpoints(true, test_addr, test_port);
+    ip::tcp::acceptor acc(ioc, *(endps.cbegin()));
+    ip::tcp::socket peer(ioc);
+    peer.connect(*(endps.cbegin()));
+
+    notify_prom_type notify_prom;
+    auto notify_fut = notify_prom.get_future();
+    auto iohp = std::make_shared<chops::net::detail::tcp_io>(acc.accept(), 
+                                                             notify_me(std::move(notify_prom)));
+
+    int recv_cnt = 0;
+    bool stamped = true;
+    std::promise<void> done_prom;
+    auto done_fut = done_prom.get_future();
+
+    iohp->set_receive_timestamps(true);
+    iohp->start_io(std::string_view("\n"), 
+      [&] (const_buffer, chops::net::tcp_io_interface, ip::tcp::endpoint,
+           const chops::net::receive_timestamp& ts) {
+        auto now = std::chrono::system_clock::now();
+        stamped = stamped && ts.has_software() && ts.software_time() <= now &&
+                  (now - ts.software_time()) < std::chrono::seconds(5);
+        if (++recv_cnt == num_msgs) {
+          done_prom.set_value();
+        }
+        return true;
+      }
+    );
+
+    WHEN ("messages are written by the peer, the first one right away") {
+      auto msgs = make_msg_vec (make_lf_text_msg, "Clock in", 'K', num_msgs);
+      std::error_code ec;
+      for (const auto& m : msgs) {
+        peer.send(const_buffer(m.data(), m.size()), ec);
+      }
+      auto st = done_fut.wait_for(std::chrono::seconds(5));
+      THEN ("every message, including the first, has a kernel receive time") {
+        REQUIRE_FALSE (ec);
+        REQUIRE (st == std::future_status::ready);
+        if constexpr (chops::net::detail::receive_timestamps_supported) {
+          REQUIRE (stamped);
+        }
+      }
+    }
+
+    iohp->stop_io();
+    notify_fut.get();
+    std::error_code ec;
+    peer.close(ec);
+  } // end given
+
+  wk.reset();
+
+}
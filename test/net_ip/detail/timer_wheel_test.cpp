@@ -0,0 +1,114 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for @c timer_wheel and @c idle_timer.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch.hpp"
+
+#include <experimental/io_context>
+#include <experimental/executor>
+
+#include <cstdint> // std::uint64_t
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "net_ip/detail/timer_wheel.hpp"
+
+using wheel = chops::net::detail::timer_wheel;
+
+SCENARIO ( "Timer wheel expirations across levels", "[timer_wheel]" ) {
+
+  GIVEN ("A timer wheel with entries in each level") {
+    const std::vector<std::uint64_t> expires { 1u, 63u, 64u, 65u, 4095u, 4096u, 4097u, 
+                                               300000u, 262144u };
+    std::vector<wheel::entry> entries(expires.size());
+    wheel w;
+    for (std::size_t i = 0u; i < expires.size(); ++i) {
+      w.insert(entries[i], expires[i]);
+    }
+    REQUIRE (w.size() == expires.size());
+
+    WHEN ("the wheel is advanced past every expire tick") {
+      std::vector<std::uint64_t> fired;
+      w.advance(400000u, [&w, &fired] (wheel::entry& e) {
+          REQUIRE (e.m_expire == w.now());
+          fired.push_back(w.now());
+        }
+      );
+      THEN ("each entry expires on its tick") {
+        REQUIRE (w.empty());
+        REQUIRE (fired == std::vector<std::uint64_t> { 1u, 63u, 64u, 65u, 4095u, 4096u,
+                                                       4097u, 262144u, 300000u });
+      }
+    }
+    AND_WHEN ("entries are erased after the wheel is partly advanced") {
+      w.advance(100u, [] (wheel::entry&) { } );
+      w.erase(entries[4]); // 4095
+      w.erase(entries[7]); // 300000
+      w.erase(entries[7]);
+      std::vector<std::uint64_t> fired;
+      w.advance(400000u, [&w, &fired] (wheel::entry&) { fired.push_back(w.now()); } );
+      THEN ("the erased entries do not expire") {
+        REQUIRE (fired == std::vector<std::uint64_t> { 4096u, 4097u, 262144u });
+      }
+    }
+    AND_WHEN ("an expired entry is inserted again") {
+      wheel::entry e;
+      wheel w2;
+      int cnt = 0;
+      w2.insert(e, 10u);
+      w2.advance(1000u, [&w2, &cnt] (wheel::entry& x) { ++cnt; w2.insert(x, w2.now() + 10u); } );
+      THEN ("it is periodic") {
+        REQUIRE (cnt == 100);
+        REQUIRE (w2.size() == 1u);
+      }
+    }
+  } // end given
+}
+
+SCENARIO ( "Idle timers on an io_context", "[timer_wheel] [idle_timer]" ) {
+
+  using namespace std::chrono_literals;
+
+  GIVEN ("An io_context run by a thread, and two idle timers") {
+    std::experimental::net::io_context ioc;
+    auto wg = std::experimental::net::make_work_guard(ioc);
+    std::thread thr([&ioc] { ioc.run(); } );
+
+    std::atomic_int idle_cnt { 0 };
+    std::atomic_int busy_cnt { 0 };
+    chops::net::detail::idle_timer idle;
+    chops::net::detail::idle_timer busy;
+
+    WHEN ("one timer is touched more often than its timeout and the other is not") {
+      idle.start(ioc, 300ms, [&idle_cnt] { ++idle_cnt; } );
+      busy.start(ioc, 300ms, [&busy_cnt] { ++busy_cnt; } );
+      for (int i = 0; i < 16; ++i) {
+        std::this_thread::sleep_for(50ms);
+        busy.touch();
+      }
+      idle.stop();
+      busy.stop();
+      THEN ("only the untouched timer expires, once per timeout") {
+        REQUIRE (idle_cnt >= 1);
+        REQUIRE (idle_cnt <= 3);
+        REQUIRE (busy_cnt == 0);
+      }
+    }
+    wg.reset();
+    thr.join();
+  } // end given
+}
+
@@ -0,0 +1,176 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for @c tls_handshake detail class, built when @c CHOPS_NET_TLS
+ *  is defined.
+ *
+ *  A self-signed certificate is created for the server side. Without the Linux @c tls
+ *  kernel module a completed handshake is reported with a @c tls_ktls_unavailable
+ *  error, which is accepted as a completed handshake.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch.hpp"
+
+#ifdef CHOPS_NET_TLS
+
+#include <openssl/ssl.h>
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+#include <openssl/pem.h>
+
+#include <experimental/internet>
+#include <experimental/socket>
+#include <experimental/io_context>
+
+#include <system_error> // std::error_code
+#include <memory> // std::make_shared
+#include <future>
+#include <chrono>
+#include <string>
+#include <cstdio> // std::fopen, std::remove
+
+#include "net_ip/detail/tls_handshake.hpp"
+#include "net_ip/tls_context.hpp"
+#include "net_ip/net_ip_error.hpp"
+
+#include "net_ip/component/worker.hpp"
+
+using namespace std::experimental::net;
+
+namespace {
+
+using hs_type = chops::net::detail::tls_handshake;
+
+// a self-signed certificate for "localhost" and its key, as PEM files
+struct cert_files {
+  std::string cert_file = "tls_handshake_test_cert.pem";
+  std::string key_file = "tls_handshake_test_key.pem";
+
+  cert_files() {
+    EVP_PKEY* pkey = EVP_EC_gen("P-256");
+    X509* x = X509_new();
+    X509_set_version(x, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(x), 1);
+    X509_gmtime_adj(X509_getm_notBefore(x), 0);
+    X509_gmtime_adj(X509_getm_notAfter(x), 3600);
+    X509_set_pubkey(x, pkey);
+    X509_NAME* name = X509_get_subject_name(x);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                               reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0);
+    X509_set_issuer_name(x, name);
+    X509_sign(x, pkey, EVP_sha256());
+    std::FILE* f = std::fopen(cert_file.c_str(), "w");
+    PEM_write_X509(f, x);
+    std::fclose(f);
+    f = std::fopen(key_file.c_str(), "w");
+    PEM_write_PrivateKey(f, pkey, nullptr, nullptr, 0, nullptr, nullptr);
+    std::fclose(f);
+    X509_free(x);
+    EVP_PKEY_free(pkey);
+  }
+
+  ~cert_files() {
+    std::remove(cert_file.c_str());
+    std::remove(key_file.c_str());
+  }
+};
+
+bool handshake_completed(const std::error_code& err) {
+  return !err || err == std::make_error_code(chops::net::net_ip_errc::tls_ktls_unavailable);
+}
+
+// each side is started in a strand of its own, the results are passed through futures
+std::future<std::error_code> start_side(ip::tcp::socket sock, chops::net::tls_context_ptr ctx,
+                                        std::string server_name = std::string()) {
+  auto prom = std::make_shared<std::promise<std::error_code> >();
+  auto fut = prom->get_future();
+  hs_type::strand_type st(sock.get_executor());
+  auto hs = std::make_shared<hs_type>(std::move(sock), std::move(ctx), st,
+                                      "localhost:0", std::move(server_name));
+  hs->start([prom] (std::error_code err, ip::tcp::socket) { prom->set_value(err); } );
+  return fut;
+}
+
+}
+
+SCENARIO ( "Tls handshake test, client and server over loopback",
+           "[tls_handshake]" ) {
+
+  using namespace chops::net;
+
+  cert_files certs;
+
+  chops::net::worker wk;
+  wk.start();
+  auto& ioc = wk.get_io_context();
+
+  GIVEN ("A server context with a self-signed certificate and a connected socket pair") {
+
+    tls_config srv_cfg;
+    srv_cfg.cert_file = certs.cert_file;
+    srv_cfg.key_file = certs.key_file;
+    auto srv_ctx = make_tls_server_context(srv_cfg);
+
+    ip::tcp::acceptor acc(ioc, ip::tcp::endpoint(ip::address_v4::loopback(), 0));
+    ip::tcp::socket cli_sock(ioc);
+    cli_sock.connect(acc.local_endpoint());
+    auto srv_sock = acc.accept();
+
+    WHEN ("a client verifying the certificate and host name performs the handshake") {
+      tls_config cli_cfg;
+      cli_cfg.ca_file = certs.cert_file;
+      auto cli_ctx = make_tls_client_context(cli_cfg);
+      auto srv_fut = start_side(std::move(srv_sock), srv_ctx);
+      auto cli_fut = start_side(std::move(cli_sock), cli_ctx, "localhost");
+      THEN ("both sides complete the handshake, and the client keeps the session") {
+        REQUIRE (srv_fut.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+        REQUIRE (cli_fut.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+        auto srv_err = srv_fut.get();
+        auto cli_err = cli_fut.get();
+        INFO ("server: " << srv_err.message() << ", client: " << cli_err.message());
+        REQUIRE (handshake_completed(srv_err));
+        REQUIRE (handshake_completed(cli_err));
+        if (!cli_err) {
+          REQUIRE (cli_ctx->num_sessions() == 1u);
+        }
+      }
+    }
+
+    AND_WHEN ("a client expecting a different host name performs the handshake") {
+      tls_config cli_cfg;
+      cli_cfg.ca_file = certs.cert_file;
+      auto cli_ctx = make_tls_client_context(cli_cfg);
+      auto srv_fut = start_side(std::move(srv_sock), srv_ctx);
+      auto cli_fut = start_side(std::move(cli_sock), cli_ctx, "not.localhost");
+      THEN ("the client handshake fails") {
+        REQUIRE (cli_fut.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+        REQUIRE (cli_fut.get() == std::make_error_code(net_ip_errc::tls_handshake_failed));
+        REQUIRE (srv_fut.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+        REQUIRE_FALSE (handshake_completed(srv_fut.get()));
+      }
+    }
+
+    AND_WHEN ("only the server side starts the handshake") {
+      srv_cfg.handshake_timeout = std::chrono::milliseconds(100);
+      auto fut = start_side(std::move(srv_sock), make_tls_server_context(srv_cfg));
+      THEN ("the handshake times out") {
+        REQUIRE (fut.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+        REQUIRE (fut.get() == std::make_error_code(net_ip_errc::tls_handshake_timeout));
+      }
+    }
+  } // end given
+
+  wk.reset();
+}
+
+#endif
+
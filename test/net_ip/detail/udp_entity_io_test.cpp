@@ -33,6 +33,8 @@
 #include <chrono>
 #include <vector>
 #include <functional> // std::ref, std::cref
+#include <atomic>
+#include <cstring> // std::memcpy
 
 #include "net_ip/detail/udp_entity_io.hpp"
 
@@ -67,7 +69,8 @@ constexpr int NumMsgs = 50;
 
 void start_udp_senders(const vec_buf& in_msg_vec, bool reply, int interval, int num_senders,
                        test_counter& send_cnt, io_context& ioc, 
-                       chops::net::err_wait_q& err_wq, const ip::udp::endpoint& recv_endp) {
+                       chops::net::err_wait_q& err_wq, const ip::udp::endpoint& recv_endp,
+                       std::size_t batch) {
 
   chops::net::send_to_all<chops::net::udp_io> sta { };
 
@@ -82,6 +85,8 @@ void start_udp_senders(const vec_buf& in_msg_vec, bool reply, int interval, int
       auto sender_futs = get_udp_io_futures(chops::net::udp_net_entity(send_ptr), err_wq,
                                             reply, send_cnt, recv_endp );
       auto send_io = sender_futs.start_fut.get();
+      send_io.set_write_batch_limits(batch, 0);
+      send_io.set_read_batch_size(batch);
       sta.add_io_interface(send_io);
       sender_fut_vec.emplace_back(std::move(sender_futs.stop_fut));
     }
@@ -109,7 +114,8 @@ std::cerr << "****** Senders total output queue size: " << qs.output_queue_size
   }
 }
 
-void udp_test (const vec_buf& in_msg_vec, bool reply, int interval, int num_senders) {
+void udp_test (const vec_buf& in_msg_vec, bool reply, int interval, int num_senders,
+               std::size_t batch = 1) {
 
   chops::net::worker wk;
   wk.start();
@@ -138,15 +144,17 @@ void udp_test (const vec_buf& in_msg_vec, bool reply, int interval, int num_send
                                                reply, recv_cnt);
 
         auto recv_io = recv_io_futs.start_fut.get(); // UDP receiver is started
+        recv_io.set_read_batch_size(batch);
+        recv_io.set_write_batch_limits(batch, 0);
 
         test_counter send_cnt = 0;
 
         INFO ("Starting first iteration of UDP senders, num: " << num_senders);
         start_udp_senders(in_msg_vec, reply, interval, num_senders,
-                          send_cnt, ioc, err_wq, recv_endp);
+                          send_cnt, ioc, err_wq, recv_endp, batch);
         INFO ("Starting second iteration of UDP senders");
         start_udp_senders(in_msg_vec, reply, interval, num_senders,
-                          send_cnt, ioc, err_wq, recv_endp);
+                          send_cnt, ioc, err_wq, recv_endp, batch);
 
 
         INFO ("Stopping receiver");
@@ -208,6 +216,342 @@ SCENARIO ( "Udp IO test, checking flexibility in ipv4 vs ipv6 sending",
 
 }
 
+SCENARIO ( "Udp IO test, message handler taking ownership of a shared buffer",
+           "[udp_io] [shared_buf]" ) {
+
+  auto ba = chops::make_byte_array(0x30, 0x31, 0x32, 0x33, 0x34);
+
+  chops::net::worker wk;
+  wk.start();
+  auto& ioc = wk.get_io_context();
+
+  GIVEN ("A UDP entity started with a shared buffer message handler") {
+
+    auto recv_endp = make_udp_endpoint(test_addr, test_port_base+50);
+    auto recv_ptr = std::make_shared<chops::net::detail::udp_entity_io>(ioc, recv_endp);
+
+    std::promise<chops::const_shared_buffer> buf_prom;
+    auto buf_fut = buf_prom.get_future();
+    std::promise<void> start_prom;
+    auto start_fut = start_prom.get_future();
+
+    recv_ptr->start(
+      [&buf_prom, &start_prom] (chops::net::udp_io_interface io, std::size_t, bool starting) {
+        if (!starting) {
+          return;
+        }
+        io.start_io(udp_max_buf_size, 
+          [&buf_prom] (chops::const_shared_buffer buf, chops::net::udp_io_interface, 
+                       ip::udp::endpoint) {
+            buf_prom.set_value(buf);
+            return false;
+          }
+        );
+        start_prom.set_value();
+      },
+      [] (chops::net::udp_io_interface, std::error_code) { }
+    );
+    start_fut.get();
+
+    WHEN ("a datagram is sent to the entity") {
+      ip::udp::socket sock(ioc);
+      sock.open(ip::udp::v4());
+      sock.send_to(const_buffer(ba.data(), ba.size()), recv_endp);
+      auto buf = buf_fut.get();
+      THEN ("the shared buffer holds exactly the datagram") {
+        REQUIRE (buf.size() == ba.size());
+        REQUIRE (buf == chops::const_shared_buffer(ba.data(), ba.size()));
+      }
+    }
+    recv_ptr->stop();
+  } // end given
+
+  wk.reset();
+}
+
+SCENARIO ( "Udp IO test, io_uring multishot reads",
+           "[udp_io] [io_uring]" ) {
+
+  constexpr int num_dgrams = 200;
+
+  chops::net::worker wk;
+  wk.start();
+  auto& ioc = wk.get_io_context();
+
+  GIVEN ("A UDP entity started with io_uring reads and fewer buffers than datagrams") {
+
+    auto recv_endp = make_udp_endpoint(test_addr, test_port_base+51);
+    auto recv_ptr = std::make_shared<chops::net::detail::udp_entity_io>(ioc, recv_endp);
+
+    int recv_cnt = 0;
+    bool in_order = true;
+    ip::udp::endpoint last_sender;
+    std::promise<void> done_prom;
+    auto done_fut = done_prom.get_future();
+    std::promise<void> start_prom;
+    auto start_fut = start_prom.get_future();
+
+    recv_ptr->start(
+      [&] (chops::net::udp_io_interface io, std::size_t, bool starting) {
+        if (!starting) {
+          return;
+        }
+        io.set_io_uring_read(8);
+        io.start_io(udp_max_buf_size, 
+          [&] (const_buffer buf, chops::net::udp_io_interface, ip::udp::endpoint endp) {
+            in_order = in_order && (buf.size() == sizeof(int)) && 
+                       (*static_cast<const int*>(buf.data()) == recv_cnt);
+            last_sender = endp;
+            if (++recv_cnt == num_dgrams) {
+              done_prom.set_value();
+            }
+            return true;
+          }
+        );
+        start_prom.set_value();
+      },
+      [] (chops::net::udp_io_interface, std::error_code) { }
+    );
+    start_fut.get();
+
+    WHEN ("datagrams are sent to the entity in bursts") {
+      ip::udp::socket sock(ioc);
+      sock.open(ip::udp::v4());
+      sock.bind(make_udp_endpoint(test_addr, test_port_base+52));
+      for (int i = 0; i < num_dgrams; ++i) {
+        sock.send_to(const_buffer(&i, sizeof(i)), recv_endp);
+        if (i % 20 == 19) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+      }
+      auto st = done_fut.wait_for(std::chrono::seconds(5));
+      THEN ("each datagram is delivered in order with the sender endpoint") {
+        REQUIRE (st == std::future_status::ready);
+        REQUIRE (in_order);
+        REQUIRE (last_sender == sock.local_endpoint());
+      }
+    }
+    recv_ptr->stop();
+  } // end given
+
+  wk.reset();
+}
+
+SCENARIO ( "Udp IO test, send and receive segmentation offload",
+           "[udp_io] [gso]" ) {
+
+  constexpr int num_dgrams = 500;
+  constexpr std::size_t dgram_size = 200u;
+
+  chops::net::worker wk;
+  wk.start();
+  auto& ioc = wk.get_io_context();
+
+  GIVEN ("A receiving UDP entity with receive offload and a sender with send offload") {
+
+    auto recv_endp = make_udp_endpoint(test_addr, test_port_base+55);
+    auto recv_ptr = std::make_shared<chops::net::detail::udp_entity_io>(ioc, recv_endp);
+    auto send_ptr = std::make_shared<chops::net::detail::udp_entity_io>(ioc, 
+                                       make_udp_endpoint(test_addr, test_port_base+56));
+
+    int recv_cnt = 0;
+    bool in_order = true;
+    std::promise<void> done_prom;
+    auto done_fut = done_prom.get_future();
+    std::promise<chops::net::udp_io_interface> recv_prom;
+    auto recv_fut = recv_prom.get_future();
+    std::promise<chops::net::udp_io_interface> send_prom;
+    auto send_fut = send_prom.get_future();
+
+    recv_ptr->start(
+      [&] (chops::net::udp_io_interface io, std::size_t, bool starting) {
+        if (!starting) {
+          return;
+        }
+        io.set_segmentation_offload(0u, true);
+        io.set_read_batch_size(8u);
+        io.start_io(dgram_size, 
+          [&] (const_buffer buf, chops::net::udp_io_interface, ip::udp::endpoint) {
+            in_order = in_order && (buf.size() == dgram_size) && 
+                       (*static_cast<const int*>(buf.data()) == recv_cnt);
+            if (++recv_cnt == num_dgrams) {
+              done_prom.set_value();
+            }
+            return true;
+          }
+        );
+        recv_prom.set_value(io);
+      },
+      [] (chops::net::udp_io_interface, std::error_code) { }
+    );
+    send_ptr->start(
+      [&] (chops::net::udp_io_interface io, std::size_t, bool starting) {
+        if (!starting) {
+          return;
+        }
+        io.set_segmentation_offload(32u, false);
+        io.start_io(recv_endp);
+        send_prom.set_value(io);
+      },
+      [] (chops::net::udp_io_interface, std::error_code) { }
+    );
+    recv_fut.get();
+    auto send_io = send_fut.get();
+
+    WHEN ("equal sized datagrams are queued on the sender in bursts") {
+      for (int i = 0; i < num_dgrams; ++i) {
+        chops::mutable_shared_buffer buf(dgram_size);
+        std::memcpy(buf.data(), &i, sizeof(i));
+        send_io.send(chops::const_shared_buffer(std::move(buf)));
+        if (i % 50 == 49) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+      }
+      auto st = done_fut.wait_for(std::chrono::seconds(5));
+      THEN ("each datagram is delivered separately and in order") {
+        REQUIRE (st == std::future_status::ready);
+        REQUIRE (in_order);
+      }
+    }
+    send_ptr->stop();
+    recv_ptr->stop();
+  } // end given
+
+  wk.reset();
+}
+
+SCENARIO ( "Udp IO test, segmentation offload set before the entity is started",
+           "[udp_io] [gso]" ) {
+
+  constexpr int num_dgrams = 64;
+  constexpr std::size_t dgram_size = 100u;
+
+  chops::net::worker wk;
+  wk.start();
+  auto& ioc = wk.get_io_context();
+
+  GIVEN ("Receive and send offload set on entities whose sockets are not yet open") {
+
+    auto recv_endp = make_udp_endpoint(test_addr, test_port_base+61);
+    auto recv_ptr = std::make_shared<chops::net::detail::udp_entity_io>(ioc, recv_endp);
+    auto send_ptr = std::make_shared<chops::net::detail::udp_entity_io>(ioc, 
+                                       make_udp_endpoint(test_addr, test_port_base+62));
+    recv_ptr->set_segmentation_offload(0u, true);
+    send_ptr->set_segmentation_offload(num_dgrams, false);
+
+    int recv_cnt = 0;
+    bool in_order = true;
+    std::promise<void> done_prom;
+    auto done_fut = done_prom.get_future();
+    std::promise<chops::net::udp_io_interface> recv_prom;
+    auto recv_fut = recv_prom.get_future();
+    std::promise<chops::net::udp_io_interface> send_prom;
+    auto send_fut = send_prom.get_future();
+
+    recv_ptr->start(
+      [&] (chops::net::udp_io_interface io, std::size_t, bool starting) {
+        if (!starting) {
+          return;
+        }
+        io.start_io(dgram_size, 
+          [&] (const_buffer buf, chops::net::udp_io_interface, ip::udp::endpoint) {
+            in_order = in_order && (buf.size() == dgram_size) && 
+                       (*static_cast<const int*>(buf.data()) == recv_cnt);
+            if (++recv_cnt == num_dgrams) {
+              done_prom.set_value();
+            }
+            return true;
+          }
+        );
+        recv_prom.set_value(io);
+      },
+      [] (chops::net::udp_io_interface, std::error_code) { }
+    );
+    send_ptr->start(
+      [&] (chops::net::udp_io_interface io, std::size_t, bool starting) {
+        if (starting) {
+          io.start_io(recv_endp);
+          send_prom.set_value(io);
+        }
+      },
+      [] (chops::net::udp_io_interface, std::error_code) { }
+    );
+    recv_fut.get();
+    auto send_io = send_fut.get();
+
+    WHEN ("one burst of equal sized datagrams is sent, so the first read can be coalesced") {
+      for (int i = 0; i < num_dgrams; ++i) {
+        chops::mutable_shared_buffer buf(dgram_size);
+        std::memcpy(buf.data(), &i, sizeof(i));
+        send_io.send(chops::const_shared_buffer(std::move(buf)));
+      }
+      auto st = done_fut.wait_for(std::chrono::seconds(5));
+      THEN ("each datagram is delivered separately and in order") {
+        REQUIRE (st == std::future_status::ready);
+        REQUIRE (in_order);
+      }
+    }
+    send_ptr->stop();
+    recv_ptr->stop();
+  } // end given
+
+  wk.reset();
+}
+
+SCENARIO ( "Udp IO test, read idle timeout and heartbeats",
+           "[udp_io] [idle_timeouts]" ) {
+
+  using namespace std::chrono_literals;
+
+  chops::net::worker wk;
+  wk.start();
+  auto& ioc = wk.get_io_context();
+
+  GIVEN ("A UDP entity with a default destination, idle timeouts and a heartbeat") {
+
+    auto peer_endp = make_udp_endpoint(test_addr, test_port_base+54);
+    ip::udp::socket peer(ioc);
+    peer.open(ip::udp::v4());
+    peer.bind(peer_endp);
+
+    auto ent_ptr = std::make_shared<chops::net::detail::udp_entity_io>(ioc,
+                                           make_udp_endpoint(test_addr, test_port_base+53));
+    std::atomic_int num_read_idle { 0 };
+    int hb = 42;
+    chops::net::idle_timeouts to { 200ms, 200ms, chops::const_shared_buffer(&hb, sizeof(hb)) };
+
+    ent_ptr->start(
+      [&] (chops::net::udp_io_interface io, std::size_t, bool starting) {
+        if (starting) {
+          io.start_io(peer_endp, udp_max_buf_size, 
+            [] (const_buffer, chops::net::udp_io_interface, ip::udp::endpoint) { return true; }
+          );
+          io.set_idle_timeouts(to);
+        }
+      },
+      [&num_read_idle] (chops::net::udp_io_interface, std::error_code err) {
+        if (err == std::make_error_code(chops::net::net_ip_errc::read_idle_timeout)) {
+          ++num_read_idle;
+        }
+      }
+    );
+
+    WHEN ("nothing is sent or received for several timeouts") {
+      int val = 0;
+      peer.receive(mutable_buffer(&val, sizeof(val))); // blocks until the first heartbeat
+      std::this_thread::sleep_for(700ms);
+      THEN ("heartbeats are sent and read idle timeouts are reported, the entity keeps running") {
+        REQUIRE (val == hb);
+        REQUIRE (num_read_idle >= 2);
+        REQUIRE (ent_ptr->is_started());
+      }
+    }
+    ent_ptr->stop();
+  } // end given
+
+  wk.reset();
+}
+
 SCENARIO ( "Udp IO handler test, var len msgs, one-way, interval 30, senders 1",
            "[udp_io] [var_len_msg] [one_way] [interval_30] [senders_1]" ) {
 
@@ -264,6 +608,22 @@ SCENARIO ( "Udp IO handler test, CR / LF msgs, two-way, interval 0, senders 1, m
 
 }
 
+SCENARIO ( "Udp IO handler test, CR / LF msgs, one-way, interval 0, senders 1, batched",
+           "[udp_io] [cr_lf_msg] [one-way] [interval_0] [senders_1] [batch]" ) {
+
+  udp_test ( make_msg_vec (make_cr_lf_text_msg, "Batch, batch, fast!", 'B', 2*NumMsgs),
+             false, 0, 1, 32);
+
+}
+
+SCENARIO ( "Udp IO handler test, var len msgs, two-way, interval 20, senders 10, batched",
+           "[udp_io] [var_len_msg] [two-way] [interval_20] [senders_10] [batch]" ) {
+
+  udp_test ( make_msg_vec (make_variable_len_msg, "Batch yowser!", 'Y', NumMsgs),
+             true, 20, 10, 8);
+
+}
+
 SCENARIO ( "Udp IO handler test, LF msgs, one-way, interval 30, senders 1",
            "[udp_io] [lf_msg] [two-way] [interval_30] [senders_1]" ) {
 
@@ -289,3 +649,161 @@ SCENARIO ( "Udp IO handler test, LF msgs, two-way, interval 50, senders 2, many
 }
 
 
+SCENARIO ( "Udp IO test, multicast entity with per group stats",
+           "[udp_io] [multicast]" ) {
+
+  constexpr int num_grp1 = 5;
+  constexpr int num_grp2 = 3;
+
+  auto grp1 = ip::make_address("239.255.7.1");
+  auto grp2 = ip::make_address("239.255.7.2");
+  auto ba = chops::make_byte_array(0x40, 0x41, 0x42, 0x43);
+
+  chops::net::worker wk;
+  wk.start();
+  auto& ioc = wk.get_io_context();
+
+  GIVEN ("A multicast entity joined to two groups on the loopback interface") {
+
+    chops::net::multicast_options opts;
+    opts.interface_addr = ip::make_address_v4(test_addr);
+    auto mc_port = static_cast<unsigned short>(test_port_base+60);
+    auto mc_ptr = std::make_shared<chops::net::detail::udp_entity_io>(ioc, 
+                            ip::udp::endpoint(ip::udp::v4(), mc_port), 
+                            std::vector<ip::address> { grp1, grp2 }, opts);
+    chops::net::udp_net_entity mc_ent(mc_ptr);
+
+    test_counter recv_cnt = 0;
+    std::promise<void> all_prom;
+    auto all_fut = all_prom.get_future();
+    std::promise<chops::net::udp_io_interface> start_prom;
+    auto start_fut = start_prom.get_future();
+
+    mc_ent.start(
+      [&] (chops::net::udp_io_interface io, std::size_t, bool starting) {
+        if (!starting) {
+          return;
+        }
+        io.start_io(udp_max_buf_size, 
+          [&] (const_buffer, chops::net::udp_io_interface, ip::udp::endpoint) {
+            if (++recv_cnt == (num_grp1 + num_grp2)) {
+              all_prom.set_value();
+            }
+            return true;
+          }
+        );
+        start_prom.set_value(io);
+      },
+      [] (chops::net::udp_io_interface, std::error_code) { }
+    );
+    auto io = start_fut.get();
+
+    WHEN ("datagrams are sent to each group through the entity, with loopback enabled") {
+      chops::repeat(num_grp1, [&] () { io.send(ba.data(), ba.size(), ip::udp::endpoint(grp1, mc_port)); } );
+      chops::repeat(num_grp2, [&] () { io.send(ba.data(), ba.size(), ip::udp::endpoint(grp2, mc_port)); } );
+      all_fut.get();
+      THEN ("the datagrams are counted per group") {
+        auto st = mc_ent.get_multicast_stats();
+        REQUIRE (st.groups.size() == 2u);
+        REQUIRE (st.groups[0].group == grp1);
+        REQUIRE (st.groups[0].num_packets == static_cast<std::size_t>(num_grp1));
+        REQUIRE (st.groups[0].num_bytes == num_grp1 * ba.size());
+        REQUIRE (st.groups[1].group == grp2);
+        REQUIRE (st.groups[1].num_packets == static_cast<std::size_t>(num_grp2));
+        REQUIRE (st.num_unmatched == 0u);
+      }
+    }
+    AND_WHEN ("a group is left") {
+      mc_ent.leave_group(grp2);
+      mc_ent.join_group(grp1);
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      THEN ("only the remaining group is in the stats") {
+        auto st = mc_ent.get_multicast_stats();
+        REQUIRE (st.groups.size() == 1u);
+        REQUIRE (st.groups[0].group == grp1);
+      }
+    }
+    mc_ent.stop();
+  } // end given
+
+  wk.reset();
+}
+
+SCENARIO ( "Udp IO test, kernel receive timestamps passed to the message handler",
+           "[udp_io] [rx_timestamps]" ) {
+
+  constexpr int num_dgrams = 20;
+
+  chops::net::worker wk;
+  wk.start();
+  auto& ioc = wk.get_io_context();
+
+  GIVEN ("A receiving UDP entity with receive timestamps enabled") {
+
+    auto recv_endp = make_udp_endpoint(test_addr, test_port_base+57);
+    auto recv_ptr = std::make_shared<chops::net::detail::udp_entity_io>(ioc, recv_endp);
+    auto send_ptr = std::make_shared<chops::net::detail::udp_entity_io>(ioc, 
+                                       make_udp_endpoint(test_addr, test_port_base+58));
+
+    int recv_cnt = 0;
+    bool stamped = true;
+    std::promise<void> done_prom;
+    auto done_fut = done_prom.get_future();
+    std::promise<chops::net::udp_io_interface> recv_prom;
+    auto recv_fut = recv_prom.get_future();
+    std::promise<chops::net::udp_io_interface> send_prom;
+    auto send_fut = send_prom.get_future();
+
+    recv_ptr->start(
+      [&] (chops::net::udp_io_interface io, std::size_t, bool starting) {
+        if (!starting) {
+          return;
+        }
+        io.set_receive_timestamps(true);
+        io.start_io(64u, 
+          [&] (const_buffer, chops::net::udp_io_interface, ip::udp::endpoint,
+               const chops::net::receive_timestamp& ts) {
+            auto now = std::chrono::system_clock::now();
+            stamped = stamped && ts.has_software() && ts.software_time() <= now &&
+                      (now - ts.software_time()) < std::chrono::seconds(5);
+            if (++recv_cnt == num_dgrams) {
+              done_prom.set_value();
+            }
+            return true;
+          }
+        );
+        recv_prom.set_value(io);
+      },
+      [] (chops::net::udp_io_interface, std::error_code) { }
+    );
+    send_ptr->start(
+      [&] (chops::net::udp_io_interface io, std::size_t, bool starting) {
+        if (starting) {
+          io.start_io(recv_endp);
+          send_prom.set_value(io);
+        }
+      },
+      [] (chops::net::udp_io_interface, std::error_code) { }
+    );
+    recv_fut.get();
+    auto send_io = send_fut.get();
+
+    WHEN ("datagrams are sent over loopback") {
+      for (int i = 0; i < num_dgrams; ++i) {
+        send_io.send(&i, sizeof(i));
+      }
+      auto st = done_fut.wait_for(std::chrono::seconds(5));
+      THEN ("each datagram has a kernel receive time, before the message handler is called") {
+        REQUIRE (st == std::future_status::ready);
+        if constexpr (chops::net::detail::receive_timestamps_supported) {
+          REQUIRE (stamped);
+        }
+      }
+    }
+    send_ptr->stop();
+    recv_ptr->stop();
+  } // end given
+
+  wk.reset();
+}
+
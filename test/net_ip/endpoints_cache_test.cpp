@@ -0,0 +1,133 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for @c endpoints_cache.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch.hpp"
+
+#include <experimental/internet>
+#include <experimental/io_context>
+
+#include <system_error> // std::error_code
+#include <memory> // std::make_shared
+#include <chrono>
+#include <vector>
+
+#include "net_ip/endpoints_cache.hpp"
+
+using namespace std::experimental::net;
+
+constexpr int NumLookups = 20;
+
+SCENARIO ( "Endpoints cache, coalesced async lookups and cache hits",
+           "[endpoints_cache] [tcp]" ) {
+
+  using cache_t = chops::net::endpoints_cache<ip::tcp>;
+
+  io_context ioc;
+  auto cache = std::make_shared<cache_t>(ioc);
+
+  GIVEN ("An endpoints cache and an io_context that is not yet running") {
+    WHEN ("many async lookups for the same key are made before the io_context runs") {
+      int good = 0;
+      for (int i = 0; i < NumLookups; ++i) {
+        cache->make_endpoints(false, "localhost", "23000",
+          [&good] (std::error_code err, cache_t::endpoints endps) {
+            if (!err && !endps.empty()) {
+              ++good;
+            }
+          }
+        );
+      }
+      ioc.run();
+      THEN ("every callback gets the endpoints from a single resolve") {
+        REQUIRE (good == NumLookups);
+        REQUIRE (cache->num_resolves() == 1u);
+        REQUIRE (cache->size() == 1u);
+      }
+      AND_THEN ("later async and sync lookups for the key are cache hits") {
+        cache->make_endpoints(false, "localhost", "23000",
+          [&good] (std::error_code err, cache_t::endpoints) {
+            if (!err) {
+              ++good;
+            }
+          }
+        );
+        ioc.restart();
+        ioc.run();
+        auto endps = cache->make_endpoints(false, "localhost", "23000");
+        REQUIRE_FALSE (endps.empty());
+        REQUIRE (good == NumLookups + 1);
+        REQUIRE (cache->num_resolves() == 1u);
+      }
+    }
+    AND_WHEN ("a sync lookup for a local key is made twice") {
+      auto endps1 = cache->make_endpoints(true, "", "23000");
+      auto endps2 = cache->make_endpoints(true, "", "23000");
+      THEN ("the second lookup is a cache hit") {
+        REQUIRE_FALSE (endps1.empty());
+        REQUIRE (endps1 == endps2);
+        REQUIRE (cache->num_resolves() == 1u);
+        cache_t::endpoints endps3;
+        REQUIRE (cache->cached_endpoints(true, "", "23000", endps3));
+        REQUIRE (endps3 == endps1);
+        REQUIRE_FALSE (cache->cached_endpoints(false, "", "23000", endps3));
+      }
+    }
+  } // end given
+}
+
+SCENARIO ( "Endpoints cache, stale entries and refresh",
+           "[endpoints_cache] [udp]" ) {
+
+  using cache_t = chops::net::endpoints_cache<ip::udp>;
+
+  io_context ioc;
+  // every entry is stale as soon as it is resolved, refresh is never rate limited
+  auto cache = std::make_shared<cache_t>(ioc, std::chrono::milliseconds(0),
+                                              std::chrono::milliseconds(0));
+
+  GIVEN ("An endpoints cache with a stale entry") {
+    auto endps = cache->make_endpoints(true, "", "23001");
+    REQUIRE (cache->num_resolves() == 1u);
+
+    WHEN ("an async lookup is made") {
+      bool good = false;
+      cache->make_endpoints(true, "", "23001",
+        [&good, &endps] (std::error_code err, cache_t::endpoints e) {
+          good = !err && e == endps;
+        }
+      );
+      ioc.run();
+      THEN ("the stale endpoints are delivered and a background resolve refreshes the entry") {
+        REQUIRE (good);
+        REQUIRE (cache->num_resolves() == 2u);
+      }
+    }
+    AND_WHEN ("refresh is called several times before the io_context runs") {
+      cache->refresh(true, "", "23001");
+      cache->refresh(true, "", "23001");
+      ioc.run();
+      THEN ("only one resolve is started") {
+        REQUIRE (cache->num_resolves() == 2u);
+      }
+    }
+    AND_WHEN ("clear is called") {
+      cache->clear();
+      THEN ("the cache is empty") {
+        REQUIRE (cache->size() == 0u);
+      }
+    }
+  } // end given
+}
+
@@ -0,0 +1,116 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for @c file_segment and @c mapped_region.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstddef> // std::size_t
+#include <cstdio> // std::remove, std::fopen
+#include <string>
+#include <system_error>
+
+#include "net_ip/file_segment.hpp"
+#include "net_ip/detail/out_buffer.hpp"
+
+#include "utility/shared_buffer.hpp"
+
+const char* const seg_file = "file_segment_test.dat";
+
+SCENARIO ( "File segment and mapped region test", "[file_segment]" ) {
+
+  using namespace chops::net;
+
+  std::string contents;
+  for (std::size_t i = 0u; i < 10000u; ++i) {
+    contents.push_back(static_cast<char>('a' + (i % 26u)));
+  }
+  {
+    std::FILE* f = std::fopen(seg_file, "wb");
+    std::fwrite(contents.data(), 1u, contents.size(), f);
+    std::fclose(f);
+  }
+
+  GIVEN ("A file") {
+    WHEN ("file segments are created") {
+      auto all = make_file_segment(seg_file);
+      auto part = make_file_segment(seg_file, 5000u, 100u);
+      THEN ("a length of 0 is the rest of the file") {
+        REQUIRE (all.native_handle() >= 0);
+        REQUIRE (all.size() == contents.size());
+        REQUIRE (part.offset() == 5000u);
+        REQUIRE (part.size() == 100u);
+        REQUIRE (make_file_segment(seg_file, 9000u).size() == 1000u);
+        REQUIRE (file_segment().empty());
+      }
+    }
+    AND_WHEN ("a file segment is created from an open descriptor") {
+      int fd = ::open(seg_file, O_RDONLY);
+      {
+        auto seg = make_file_segment(fd, 10u, 0u);
+        REQUIRE (seg.native_handle() == fd);
+        REQUIRE (seg.size() == contents.size() - 10u);
+      }
+      THEN ("the descriptor is not closed by the segment") {
+        char c;
+        REQUIRE (::pread(fd, &c, 1u, 0) == 1);
+        REQUIRE (c == 'a');
+        ::close(fd);
+      }
+    }
+    AND_WHEN ("memory mapped regions are created, at page and non page aligned offsets") {
+      auto reg = make_mapped_region(seg_file);
+      auto reg2 = make_mapped_region(seg_file, 4100u, 50u);
+      auto sub = reg.subregion(27u, 3u);
+      THEN ("the region contents are the file contents") {
+        REQUIRE (reg.size() == contents.size());
+        REQUIRE (std::string(reinterpret_cast<const char*>(reg.data()), reg.size()) == contents);
+        REQUIRE (std::string(reinterpret_cast<const char*>(reg2.data()), reg2.size()) ==
+                 contents.substr(4100u, 50u));
+        REQUIRE (std::string(reinterpret_cast<const char*>(sub.data()), sub.size()) == "bcd");
+      }
+    }
+    AND_WHEN ("out of range segments or regions are requested") {
+      THEN ("an exception is thrown") {
+        REQUIRE_THROWS_AS (make_file_segment(seg_file, 20000u), std::system_error);
+        REQUIRE_THROWS_AS (make_file_segment(seg_file, 9990u, 11u), std::system_error);
+        REQUIRE_THROWS_AS (make_mapped_region(seg_file, 0u, 10001u), std::system_error);
+        REQUIRE_THROWS_AS (make_mapped_region(seg_file).subregion(9999u, 2u), std::system_error);
+        REQUIRE_THROWS_AS (make_file_segment("no_such_file.dat"), std::system_error);
+      }
+    }
+    AND_WHEN ("output queue buffers are created from each kind") {
+      std::string s("Hello");
+      chops::net::detail::out_buffer b1(chops::const_shared_buffer(s.data(), s.size()));
+      chops::net::detail::out_buffer b2(make_mapped_region(seg_file, 1u, 4u));
+      chops::net::detail::out_buffer b3(make_file_segment(seg_file, 0u, 42u));
+      THEN ("the memory buffers have data and the file segment is written from the file") {
+        REQUIRE_FALSE (b1.is_file());
+        REQUIRE (b1.size() == 5u);
+        REQUIRE_FALSE (b2.is_file());
+        REQUIRE (b2.size() == 4u);
+        REQUIRE (std::string(reinterpret_cast<const char*>(b2.data()), b2.size()) == "bcde");
+        REQUIRE (b3.is_file());
+        REQUIRE (b3.size() == 42u);
+        REQUIRE (b3.data() == nullptr);
+        REQUIRE (b3.get_file_segment().size() == 42u);
+      }
+    }
+  } // end given
+
+  std::remove(seg_file);
+}
+
@@ -0,0 +1,176 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for the instrumentation policies, with the counting policy
+ *  compiled in.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+// must be defined before any Chops Net IP header is included
+#define CHOPS_NET_IP_INSTRUMENTATION
+
+#include "catch.hpp"
+
+#include <experimental/internet>
+#include <experimental/socket>
+#include <experimental/io_context>
+
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint64_t
+#include <chrono>
+#include <future>
+#include <thread>
+#include <numeric> // std::accumulate
+#include <type_traits> // std::is_same_v
+#include <vector>
+
+#include "net_ip/instrumentation.hpp"
+#include "net_ip/net_ip.hpp"
+#include "net_ip/net_entity.hpp"
+#include "net_ip/component/worker.hpp"
+
+#include "net_ip/shared_utility_test.hpp"
+#include "net_ip/shared_utility_func_test.hpp"
+
+#include "utility/repeat.hpp"
+
+#include <iostream> // std::cerr for error sink
+
+using namespace chops::test;
+using chops::net::io_event;
+
+const char* test_port = "30987";
+const char* test_host = "";
+constexpr int NumMsgs = 100;
+
+static_assert(std::is_same_v<chops::net::io_instrumentation, chops::net::counting_instrumentation>);
+static_assert(!chops::net::null_instrumentation::enabled);
+
+namespace {
+
+std::uint64_t hist_total(const chops::net::io_event_stats& st) {
+  return std::accumulate(st.duration_histogram.cbegin(), st.duration_histogram.cend(),
+                         std::uint64_t(0u));
+}
+
+}
+
+SCENARIO ( "Counting instrumentation, events recorded from multiple threads",
+           "[instrumentation] [counting]" ) {
+
+  using ci = chops::net::counting_instrumentation;
+  constexpr int num_thrs = 4;
+  constexpr int num_events = 1000;
+
+  GIVEN ("A snapshot of the current counts") {
+    auto before = ci::snapshot()[io_event::connect_retry];
+
+    WHEN ("multiple threads record events, with and without durations") {
+      std::vector<std::thread> thrs;
+      chops::repeat(num_thrs, [&thrs] () {
+          thrs.push_back(std::thread( [] () {
+              chops::repeat(num_events, [] (int i) {
+                  ci::record(io_event::connect_retry, 10u, std::chrono::steady_clock::now(),
+                             std::chrono::nanoseconds(i % 2 == 0 ? 0 : 100));
+                }
+              );
+            }
+          ));
+        }
+      );
+      for (auto& t : thrs) {
+        t.join();
+      }
+      THEN ("the snapshot aggregates the counts of every thread") {
+        auto after = ci::snapshot()[io_event::connect_retry];
+        REQUIRE (ci::num_threads() >= static_cast<std::size_t>(num_thrs));
+        REQUIRE ((after.count - before.count) == num_thrs * num_events);
+        REQUIRE ((after.total_bytes - before.total_bytes) == 10u * num_thrs * num_events);
+        REQUIRE ((after.total_duration_nsec - before.total_duration_nsec) ==
+                 100u * num_thrs * num_events / 2u);
+        REQUIRE (after.max_duration_nsec >= 100u);
+        // 100 nanoseconds is in the 64 to 128 bucket
+        REQUIRE ((after.duration_histogram[7] - before.duration_histogram[7]) ==
+                 num_thrs * num_events / 2u);
+      }
+    }
+  } // end given
+}
+
+SCENARIO ( "Counting instrumentation, TCP acceptor and connector events",
+           "[instrumentation] [tcp]" ) {
+
+  chops::net::worker wk;
+  wk.start();
+
+  GIVEN ("A TCP acceptor and connector echoing variable length messages") {
+    auto before = chops::net::counting_instrumentation::snapshot();
+    auto msgs = make_msg_vec (make_variable_len_msg, "Count me!", 'C', NumMsgs);
+
+    chops::net::net_ip nip(wk.get_io_context());
+    chops::net::err_wait_q err_wq;
+    auto err_fut = std::async(std::launch::async,
+      chops::net::ostream_error_sink_with_wait_queue, std::ref(err_wq), std::ref(std::cerr));
+
+    test_counter acc_cnt = 0;
+    auto acc = nip.make_tcp_acceptor(test_port, test_host);
+    start_tcp_acceptor(acc, err_wq, true, std::string_view(), acc_cnt);
+
+    test_counter conn_cnt = 0;
+    auto conn = nip.make_tcp_connector(test_port, test_host, std::chrono::milliseconds(100));
+    auto conn_futs = get_tcp_io_futures(conn, err_wq, false, std::string_view(), conn_cnt);
+
+    WHEN ("messages are sent and the replies received") {
+      auto io = conn_futs.start_fut.get();
+      for (const auto& buf : msgs) {
+        io.send(buf);
+      }
+      while (conn_cnt < static_cast<std::size_t>(NumMsgs)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+      io.send(make_empty_variable_len_msg());
+      conn_futs.stop_fut.get();
+
+      nip.stop_all();
+      nip.remove_all();
+      while (!err_wq.empty()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      }
+      err_wq.close();
+      err_fut.get();
+
+      THEN ("each event type is counted") {
+        auto after = chops::net::counting_instrumentation::snapshot();
+        auto diff = [&before, &after] (io_event ev) {
+          return after[ev].count - before[ev].count;
+        };
+        REQUIRE (diff(io_event::accepted) == 1u);
+        REQUIRE (diff(io_event::connect_attempt) >= 1u);
+        REQUIRE (diff(io_event::read_completed) >= 2u);
+        // a header and a body frame for each message, on both sides
+        REQUIRE (diff(io_event::frame_decoded) >= 4u * NumMsgs);
+        REQUIRE (diff(io_event::handler_invoked) >= 2u * NumMsgs);
+        REQUIRE (diff(io_event::write_queued) >= 2u * NumMsgs);
+        REQUIRE (diff(io_event::write_completed) >= 1u);
+        REQUIRE ((after[io_event::write_completed].total_bytes -
+                  before[io_event::write_completed].total_bytes) >=
+                 2u * msgs.size() * msgs.front().size());
+        REQUIRE ((hist_total(after[io_event::handler_invoked]) -
+                  hist_total(before[io_event::handler_invoked])) > 0u);
+        REQUIRE (std::string_view(chops::net::io_event_name(io_event::write_queued)) ==
+                 "write_queued");
+      }
+    }
+  } // end given
+
+  wk.reset();
+}
+
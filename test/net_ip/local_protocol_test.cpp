@@ -0,0 +1,128 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for the local (Unix domain) protocols and file descriptor passing.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch.hpp"
+
+#include <experimental/io_context>
+#include <experimental/socket>
+
+#include <cstddef> // offsetof
+#include <cstring> // std::memcpy
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include <sys/socket.h> // socketpair
+#include <unistd.h> // pipe, read, write, close
+
+#include "net_ip/local_protocol.hpp"
+
+SCENARIO ( "Local protocol endpoints, file system paths and abstract names", "[local]" ) {
+
+  using namespace chops::net::local;
+
+  GIVEN ("Local stream and datagram endpoints") {
+    WHEN ("an endpoint is created from a file system path") {
+      stream_protocol::endpoint endp("/tmp/chops_local.sock");
+      THEN ("the path, family and size include the terminating NUL") {
+        REQUIRE (endp.path() == "/tmp/chops_local.sock");
+        REQUIRE_FALSE (endp.is_abstract());
+        REQUIRE (endp.protocol().family() == AF_UNIX);
+        REQUIRE (endp.protocol().type() == SOCK_STREAM);
+        REQUIRE (endp.size() == offsetof(::sockaddr_un, sun_path) + endp.path().size() + 1u);
+      }
+    }
+    AND_WHEN ("an endpoint is created from an abstract name") {
+      datagram_protocol::endpoint endp(std::string_view("\0chops", 6u));
+      THEN ("the name has no terminating NUL") {
+        REQUIRE (endp.is_abstract());
+        REQUIRE (endp.path().size() == 6u);
+        REQUIRE (endp.protocol().type() == SOCK_DGRAM);
+        REQUIRE (endp.size() == offsetof(::sockaddr_un, sun_path) + 6u);
+      }
+    }
+    AND_WHEN ("an endpoint is resized, as by the socket classes after a system call") {
+      stream_protocol::endpoint endp("/tmp/a.sock");
+      stream_protocol::endpoint copy;
+      std::memcpy(copy.data(), endp.data(), endp.size());
+      copy.resize(endp.size());
+      stream_protocol::endpoint unnamed;
+      unnamed.resize(sizeof(::sa_family_t));
+      THEN ("the path is the same, and an unbound peer has an empty path") {
+        REQUIRE (copy == endp);
+        REQUIRE (copy.path() == "/tmp/a.sock");
+        REQUIRE (unnamed.path().empty());
+        REQUIRE (unnamed < endp);
+      }
+    }
+    AND_WHEN ("a path is too long") {
+      std::string long_path(200u, 'x');
+      THEN ("an exception is thrown") {
+        REQUIRE_THROWS_AS (stream_protocol::endpoint(long_path), std::system_error);
+      }
+    }
+  } // end given
+}
+
+SCENARIO ( "Local stream sockets, passing a file descriptor", "[local] [scm_rights]" ) {
+
+  using namespace chops::net::local;
+
+  std::experimental::net::io_context ioc;
+
+  GIVEN ("A connected pair of local stream sockets") {
+    int fds[2];
+    REQUIRE (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    stream_protocol::socket s0(ioc, stream_protocol(), fds[0]);
+    stream_protocol::socket s1(ioc, stream_protocol(), fds[1]);
+
+    WHEN ("the read end of a pipe is sent, and the write end is closed after a write") {
+      int pfds[2];
+      REQUIRE (::pipe(pfds) == 0);
+      std::error_code ec;
+      send_native_handle(s0, pfds[0], ec);
+      REQUIRE_FALSE (ec);
+      ::close(pfds[0]);
+      int rfd = receive_native_handle(s1, ec);
+      REQUIRE_FALSE (ec);
+      REQUIRE (::write(pfds[1], "hi", 2) == 2);
+      ::close(pfds[1]);
+      char buf[8] { };
+      auto nb = ::read(rfd, buf, sizeof(buf));
+      ::close(rfd);
+      THEN ("the received descriptor reads from the same pipe") {
+        REQUIRE (rfd >= 0);
+        REQUIRE (nb == 2);
+        REQUIRE (std::string(buf, 2u) == "hi");
+      }
+    }
+    AND_WHEN ("a plain byte is received instead, or the peer closes") {
+      char b = 'x';
+      REQUIRE (::send(s0.native_handle(), &b, 1, 0) == 1);
+      std::error_code ec1;
+      int fd1 = receive_native_handle(s1, ec1);
+      s0.close();
+      std::error_code ec2;
+      int fd2 = receive_native_handle(s1, ec2);
+      THEN ("no descriptor is returned, with an error") {
+        REQUIRE (fd1 == -1);
+        REQUIRE (ec1 == std::make_error_code(std::errc::bad_message));
+        REQUIRE (fd2 == -1);
+        REQUIRE (ec2 == std::make_error_code(std::errc::connection_reset));
+      }
+    }
+  } // end given
+}
+
@@ -0,0 +1,106 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for the metrics registry and the Prometheus text export.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch.hpp"
+
+#include <cstdint> // std::int64_t
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "net_ip/net_ip_metrics.hpp"
+#include "net_ip/net_ip_error.hpp"
+
+#include "utility/repeat.hpp"
+
+SCENARIO ( "Metrics registry, values recorded from multiple threads", "[metrics]" ) {
+
+  using namespace chops::net;
+  constexpr int num_thrs = 4;
+  constexpr int num_recs = 1000;
+
+  GIVEN ("A snapshot of the current values") {
+    auto before = metrics_registry::snapshot();
+
+    WHEN ("multiple threads record metrics and errors") {
+      std::vector<std::thread> thrs;
+      chops::repeat(num_thrs, [&thrs] () {
+          thrs.push_back(std::thread( [] () {
+              chops::repeat(num_recs, [] () {
+                  detail::record_metric(net_metric::bytes_received, 10);
+                  detail::record_metric(net_metric::io_handlers_opened);
+                  detail::record_metric(net_metric::output_queue_bufs, 2);
+                  detail::record_metric(net_metric::output_queue_bufs, -1);
+                  detail::record_error_metric(std::make_error_code(net_ip_errc::read_idle_timeout));
+                  detail::record_error_metric(std::make_error_code(std::errc::connection_reset));
+                }
+              );
+            }
+          ));
+        }
+      );
+      for (auto& t : thrs) {
+        t.join();
+      }
+      detail::record_metric(net_metric::io_handlers_closed, 3);
+      auto after = metrics_registry::snapshot();
+
+      THEN ("the snapshot includes the values of all threads") {
+        std::int64_t n = num_thrs * num_recs;
+        REQUIRE ((after[net_metric::bytes_received] - before[net_metric::bytes_received]) == 10 * n);
+        REQUIRE ((after[net_metric::output_queue_bufs] - before[net_metric::output_queue_bufs]) == n);
+        REQUIRE ((after.open_io_handlers() - before.open_io_handlers()) == n - 3);
+        REQUIRE ((after.num_errors(net_ip_errc::read_idle_timeout) -
+                  before.num_errors(net_ip_errc::read_idle_timeout)) == n);
+        REQUIRE ((after.errors[0] - before.errors[0]) == n);
+        REQUIRE (after[net_metric::connects] == before[net_metric::connects]);
+      }
+    }
+  } // end given
+}
+
+SCENARIO ( "Metrics Prometheus text export", "[metrics] [prometheus]" ) {
+
+  using namespace chops::net;
+
+  GIVEN ("A snapshot with a few values") {
+    metrics_snapshot snap { };
+    snap.values[static_cast<std::size_t>(net_metric::accepts)] = 42;
+    snap.values[static_cast<std::size_t>(net_metric::io_handlers_opened)] = 5;
+    snap.values[static_cast<std::size_t>(net_metric::io_handlers_closed)] = 2;
+    snap.values[static_cast<std::size_t>(net_metric::output_queue_bytes)] = 1024;
+    snap.errors[static_cast<std::size_t>(net_ip_errc::tcp_connect_timeout)] = 7;
+
+    WHEN ("the snapshot is formatted") {
+      auto txt = metrics_to_prometheus(snap);
+      auto txt2 = metrics_to_prometheus(snap, "app_");
+
+      THEN ("each metric has a type line and a sample") {
+        REQUIRE (txt.find("# TYPE chops_net_ip_accepts_total counter\n") != std::string::npos);
+        REQUIRE (txt.find("\nchops_net_ip_accepts_total 42\n") != std::string::npos);
+        REQUIRE (txt.find("# TYPE chops_net_ip_output_queue_bytes gauge\n") != std::string::npos);
+        REQUIRE (txt.find("\nchops_net_ip_output_queue_bytes 1024\n") != std::string::npos);
+        REQUIRE (txt.find("\nchops_net_ip_io_handlers_open 3\n") != std::string::npos);
+        REQUIRE (txt.find("chops_net_ip_errors_total{error=\"tcp_connect_timeout\"} 7\n") !=
+                 std::string::npos);
+        REQUIRE (txt.find("chops_net_ip_errors_total{error=\"other\"} 0\n") != std::string::npos);
+        REQUIRE (txt2.find("\napp_accepts_total 42\n") != std::string::npos);
+        REQUIRE (txt2.find("chops_net_ip_") == std::string::npos);
+      }
+    }
+  } // end given
+}
+
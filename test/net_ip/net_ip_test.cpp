@@ -115,6 +115,14 @@ void acc_conn_test (const vec_buf& in_msg_vec, bool reply, int interval, int num
         for (auto buf : in_msg_vec) {
           sta.send(buf);
         }
+        // the acceptor closes when the shutdown message is received, dropping any queued 
+        // replies, so wait (bounded) for the replies first
+        for (int i = 0; reply && conn_cnt < num_conns * in_msg_vec.size() && i < 1000; ++i) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        if (reply) {
+          REQUIRE (conn_cnt == num_conns * in_msg_vec.size());
+        }
         sta.send(empty_msg);
 
         for (auto& fut : conn_fut_vec) {
@@ -0,0 +1,84 @@
+/** @file
+ *
+ *  @ingroup test_module
+ *
+ *  @brief Test scenarios for @c tls_context, built when @c CHOPS_NET_TLS is defined.
+ *
+ *  @author Cliff Green
+ *
+ *  Copyright (c) 2018 by Cliff Green
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
+
+#include "catch.hpp"
+
+#ifdef CHOPS_NET_TLS
+
+#include <openssl/ssl.h>
+
+#include "net_ip/tls_context.hpp"
+#include "net_ip/net_ip_error.hpp"
+
+SCENARIO ( "Tls context creation and session cache test", "[tls_context]" ) {
+
+  using namespace chops::net;
+
+  GIVEN ("A server side tls config without a certificate") {
+    tls_config cfg;
+    WHEN ("a server context is created") {
+      THEN ("an exception is thrown") {
+        REQUIRE_THROWS_AS (make_tls_server_context(cfg), net_ip_exception);
+      }
+    }
+  } // end given
+
+  GIVEN ("A client side tls config with a session cache size of 2") {
+    tls_config cfg;
+    cfg.verify_peer = false;
+    cfg.session_cache_size = 2u;
+    auto ctx = make_tls_client_context(cfg);
+    REQUIRE_FALSE (ctx->is_server());
+    REQUIRE (ctx->native_handle());
+    REQUIRE (ctx->num_sessions() == 0u);
+
+    WHEN ("three sessions are saved") {
+      ctx->save_session("a:1", tls_context::session_ptr(SSL_SESSION_new()));
+      ctx->save_session("b:1", tls_context::session_ptr(SSL_SESSION_new()));
+      ctx->save_session("c:1", tls_context::session_ptr(SSL_SESSION_new()));
+      THEN ("the oldest session is evicted") {
+        REQUIRE (ctx->num_sessions() == 2u);
+        REQUIRE_FALSE (ctx->find_session("a:1"));
+        REQUIRE (ctx->find_session("b:1"));
+        REQUIRE (ctx->find_session("c:1"));
+      }
+    }
+    AND_WHEN ("a session is replaced") {
+      ctx->save_session("a:1", tls_context::session_ptr(SSL_SESSION_new()));
+      ctx->save_session("a:1", tls_context::session_ptr(SSL_SESSION_new()));
+      THEN ("only one session is kept for the key") {
+        REQUIRE (ctx->num_sessions() == 1u);
+        REQUIRE (ctx->find_session("a:1"));
+        REQUIRE_FALSE (ctx->find_session("b:1"));
+      }
+    }
+  } // end given
+
+  GIVEN ("A client side tls config with session resumption disabled") {
+    tls_config cfg;
+    cfg.verify_peer = false;
+    cfg.session_cache_size = 0u;
+    auto ctx = make_tls_client_context(cfg);
+    WHEN ("a session is saved") {
+      ctx->save_session("a:1", tls_context::session_ptr(SSL_SESSION_new()));
+      THEN ("it is not kept") {
+        REQUIRE (ctx->num_sessions() == 0u);
+      }
+    }
+  } // end given
+
+}
+
+#endif